@@ -34,6 +34,23 @@ CHAR GetMountPoint(_In_ DWORD argc, _In_ char* argv[])
     return 'M';
 }
 
+/*
+* Retrieve the per-plugin directory cache ttls from the command line arguments.
+* -- argc
+* -- argv
+* -- return = the '-vfsttl' value, or NULL if not given.
+*/
+LPSTR GetVfsCacheTtl(_In_ DWORD argc, _In_ char* argv[])
+{
+    DWORD i;
+    for(i = 0; i < argc - 1; i++) {
+        if(0 == strcmp(argv[i], "-vfsttl")) {
+            return argv[i + 1];
+        }
+    }
+    return NULL;
+}
+
 /*
 * Call the VMMDLL_Close() function in a separate newly create thread.
 * This will allow the main thread to exit even if the VMMDLL_Close()
@@ -129,7 +146,7 @@ int main(_In_ int argc, _In_ char* argv[])
     }
     SetConsoleCtrlHandler(MemProcFsCtrlHandler, TRUE);
     g_VfsMountPoint = GetMountPoint(argc, argv);
-    VfsInitializeAndMount(g_VfsMountPoint, &VmmDll);
+    VfsInitializeAndMount(g_VfsMountPoint, GetVfsCacheTtl(argc, argv), &VmmDll);
     CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)MemProcFsCtrlHandler_TryShutdownThread, NULL, 0, NULL);
     Sleep(250);
     TerminateProcess(GetCurrentProcess(), 1);
@@ -25,31 +25,48 @@ DWORD g_dbg_c = 0;
 // DEFINES, TYPEDEFS AND FORWARD DECLARATIONS BELOW:
 //-------------------------------------------------------------------------------
 
-#define VFS_CONFIG_FILELIST_ITEMS   12
-#define VFS_CONFIG_FILELIST_MAGIC   0x7f646555caffee66
+#define VFS_CONFIG_FILELIST_ITEMS       16
+#define VFS_CONFIG_FILELIST_ITEMS_MAX   0x1000
+#define VFS_CONFIG_FILELIST_MAGIC       0x7f646555caffee66
+
+/*
+* File lists are arena-like chains of blocks. Each block is allocated with
+* capacity for twice the items of the previous block (up to a max) and the
+* head keeps track of the last block so that appending is O(1).
+*/
 typedef struct tdVFS_FILELIST {
     QWORD magic;
-    struct tdVFS_FILELIST* FLink;
+    struct tdVFS_FILELIST *FLink;
+    struct tdVFS_FILELIST *pLast;   // last block in chain (only valid in head)
     DWORD cFiles;
-    WIN32_FIND_DATAW pFiles[VFS_CONFIG_FILELIST_ITEMS];
+    DWORD cFilesMax;
+    WIN32_FIND_DATAW pFiles[];
 } VFS_FILELIST, *PVFS_FILELIST;
 
 BOOL VfsListVmmDirectory(_In_ LPWSTR wszDirectoryName);
+DWORD Vfs_UtilHashStringUpperW(_In_opt_ LPCWSTR wsz);
 
 //-------------------------------------------------------------------------------
 // FILELIST FUNCTIONALITY BELOW:
 // (directory listing functions/structs for communicating between vfs and vfsproc).
 //-------------------------------------------------------------------------------
 
-PVFS_FILELIST VfsFileList_Alloc()
+PVFS_FILELIST VfsFileList_AllocBlock(_In_ DWORD cFilesMax)
 {
-    PVFS_FILELIST pFileList = LocalAlloc(LMEM_ZEROINIT, sizeof(VFS_FILELIST));
+    PVFS_FILELIST pFileList = LocalAlloc(LMEM_ZEROINIT, sizeof(VFS_FILELIST) + cFilesMax * sizeof(WIN32_FIND_DATAW));
     if(pFileList) {
         pFileList->magic = VFS_CONFIG_FILELIST_MAGIC;
+        pFileList->pLast = pFileList;
+        pFileList->cFilesMax = cFilesMax;
     }
     return pFileList;
 }
 
+PVFS_FILELIST VfsFileList_Alloc()
+{
+    return VfsFileList_AllocBlock(VFS_CONFIG_FILELIST_ITEMS);
+}
+
 VOID VfsFileList_Free(_Inout_ PVFS_FILELIST pFileList)
 {
     PVFS_FILELIST pFileListFlink;
@@ -67,19 +84,15 @@ VOID VfsFileList_AddDirectoryFileInternal(_Inout_ PVFS_FILELIST pFileList, _In_
     WCHAR c;
     DWORD i = 0;
     PWIN32_FIND_DATAW pFindData;
-    // 1: check if required to allocate more FileList items
-    while(pFileList->cFiles == VFS_CONFIG_FILELIST_ITEMS) {
-        if(pFileList->FLink) {
-            pFileList = pFileList->FLink;
-            continue;
-        }
-        pFileList->FLink = VfsFileList_Alloc();
-        if(!pFileList->FLink) { return; }
-        pFileList = pFileList->FLink;
+    PVFS_FILELIST pFileListLast = pFileList->pLast;
+    // 1: check if required to allocate a new (larger) FileList block
+    if(pFileListLast->cFiles == pFileListLast->cFilesMax) {
+        if(!(pFileListLast->FLink = VfsFileList_AllocBlock(min(2 * pFileListLast->cFilesMax, VFS_CONFIG_FILELIST_ITEMS_MAX)))) { return; }
+        pFileListLast = pFileList->pLast = pFileListLast->FLink;
     }
     // 2: locate item to fill into
-    pFindData = pFileList->pFiles + pFileList->cFiles;
-    pFileList->cFiles++;
+    pFindData = pFileListLast->pFiles + pFileListLast->cFiles;
+    pFileListLast->cFiles++;
     // 3: fill
     pFindData->dwFileAttributes = dwFileAttributes;
     pFindData->ftCreationTime = ftCreationTime;
@@ -140,50 +153,103 @@ VOID VfsFileList_DokanFillAll(PVFS_FILELIST pFileList, PDOKAN_FILE_INFO DokanFil
     } while(pFileList);
 }
 
-PWIN32_FIND_DATAW VfsFileList_FindSingle(_In_ PVFS_FILELIST pFileList, _In_ LPWSTR wszFile)
-{
-    DWORD i;
-    do {
-        for(i = 0; i < pFileList->cFiles; i++) {
-            if(!wcscmp(wszFile, pFileList->pFiles[i].cFileName)) {
-                return pFileList->pFiles + i;
-            }
-        }
-        pFileList = pFileList->FLink;
-    } while(pFileList);
-    return NULL;
-}
-
 //-------------------------------------------------------------------------------
 // DIRECTORY LISTINGS READ CACHE BELOW:
 // (caching is used to cache vmmproc directory listings for performance reasons)
+// Cached directories are kept in a hash table keyed on the directory name hash.
+// Each cached directory has a file name hash map for fast single file lookups.
+// The cache is protected by a reader-writer lock - lookups are shared.
 //-------------------------------------------------------------------------------
 
+typedef struct tdVFS_CACHE_FILEMAP_ENTRY {
+    DWORD dwHash;
+    PWIN32_FIND_DATAW pFindData;
+} VFS_CACHE_FILEMAP_ENTRY, *PVFS_CACHE_FILEMAP_ENTRY;
+
+typedef struct tdVFS_CACHE_DIRECTORY {
+    struct tdVFS_CACHE_DIRECTORY *FLink;    // next entry in hash bucket
+    QWORD qwExpireTickCount64;
+    DWORD dwHash;                           // directory name hash
+    DWORD cFileMap;                         // # file map slots (power of 2)
+    PVFS_FILELIST pFileList;
+    WCHAR wszDirectoryName[MAX_PATH];
+    VFS_CACHE_FILEMAP_ENTRY FileMap[];
+} VFS_CACHE_DIRECTORY, *PVFS_CACHE_DIRECTORY;
+
+/*
+* Retrieve the directory cache ttl of a directory. The ttl is looked up on the
+* plugin name - i.e. the 1st path component or the 3rd path component of the
+* per-process directories '\pid\<pid>\<plugin>' and '\name\<name>\<plugin>'.
+* -- wszPath
+* -- return = ttl in ms.
+*/
+DWORD VfsCacheDirectory_GetTtl(_In_ LPCWSTR wszPath)
+{
+    DWORD i, dwHash;
+    WCHAR wszPlugin[32];
+    LPCWSTR wsz = wszPath;
+    if(!ctxVfs->CacheDirectory.cTtl) { return ctxVfs->CacheDirectory.dwTtlDefaultMs; }
+    if(!_wcsnicmp(wszPath, L"\\pid\\", 5) || !_wcsnicmp(wszPath, L"\\name\\", 6)) {
+        wsz = wcschr(wcschr(wszPath + 1, '\\') + 1, '\\');
+        if(!wsz) { wsz = wszPath; }
+    }
+    while(*wsz == '\\') { wsz++; }
+    for(i = 0; (i < _countof(wszPlugin) - 1) && wsz[i] && (wsz[i] != '\\'); i++) {
+        wszPlugin[i] = wsz[i];
+    }
+    wszPlugin[i] = 0;
+    dwHash = Vfs_UtilHashStringUpperW(wszPlugin);
+    for(i = 0; i < ctxVfs->CacheDirectory.cTtl; i++) {
+        if(ctxVfs->CacheDirectory.Ttl[i].dwHash == dwHash) {
+            return ctxVfs->CacheDirectory.Ttl[i].dwTtlMs;
+        }
+    }
+    return ctxVfs->CacheDirectory.dwTtlDefaultMs;
+}
+
+/*
+* Retrieve a non-expired cached directory - CacheDirectoryLock must be held.
+* -- wszPath
+* -- qwCurrentTickCount
+* -- return
+*/
+PVFS_CACHE_DIRECTORY VfsCacheDirectory_GetDirectory(_In_ LPCWSTR wszPath, _In_ QWORD qwCurrentTickCount)
+{
+    DWORD dwHash = Vfs_UtilHashStringUpperW(wszPath);
+    PVFS_CACHE_DIRECTORY pe = ctxVfs->CacheDirectory.Bucket[dwHash & (VMMVFS_CACHE_DIRECTORY_BUCKETS - 1)];
+    while(pe) {
+        if((pe->dwHash == dwHash) && (qwCurrentTickCount <= pe->qwExpireTickCount64) && !wcscmp(wszPath, pe->wszDirectoryName)) {
+            return pe;
+        }
+        pe = pe->FLink;
+    }
+    return NULL;
+}
+
 _Success_(return)
 BOOL VfsCacheDirectory_GetSingle2(_In_ LPWSTR wszPath, _In_ LPWSTR wszFile, _Out_ PWIN32_FIND_DATAW pFindData, _Out_ PBOOL pIsDirectoryExisting)
 {
-    QWORD i, qwCurrentTickCount;
-    PWIN32_FIND_DATAW pFindDataCache;
-    qwCurrentTickCount = GetTickCount64();
+    BOOL fResult = FALSE;
+    DWORD i, dwHash;
+    PVFS_CACHE_DIRECTORY pe;
+    PVFS_CACHE_FILEMAP_ENTRY pme;
     *pIsDirectoryExisting = FALSE;
-    EnterCriticalSection(&ctxVfs->CacheDirectoryLock);
-    for(i = 0; i < VMMVFS_CACHE_DIRECTORY_ENTRIES; i++) {
-        if(wcscmp(wszPath, ctxVfs->CacheDirectory[i].wszDirectoryName)) { continue; }
-        if(qwCurrentTickCount > ctxVfs->CacheDirectory[i].qwExpireTickCount64) { continue; }
+    AcquireSRWLockShared(&ctxVfs->CacheDirectoryLock);
+    if((pe = VfsCacheDirectory_GetDirectory(wszPath, GetTickCount64()))) {
         *pIsDirectoryExisting = TRUE;
-        pFindDataCache = VfsFileList_FindSingle(ctxVfs->CacheDirectory[i].pFileList, wszFile);
-        if(!pFindDataCache) {
-            LeaveCriticalSection(&ctxVfs->CacheDirectoryLock);
-            return FALSE;
-        }
-        if(pFindData) {
-            memcpy(pFindData, pFindDataCache, sizeof(WIN32_FIND_DATAW));
+        dwHash = Vfs_UtilHashStringUpperW(wszFile);
+        for(i = dwHash; (pme = pe->FileMap + (i & (pe->cFileMap - 1)))->pFindData; i++) {
+            if((pme->dwHash == dwHash) && !wcscmp(wszFile, pme->pFindData->cFileName)) {
+                if(pFindData) {
+                    memcpy(pFindData, pme->pFindData, sizeof(WIN32_FIND_DATAW));
+                }
+                fResult = TRUE;
+                break;
+            }
         }
-        LeaveCriticalSection(&ctxVfs->CacheDirectoryLock);
-        return TRUE;
     }
-    LeaveCriticalSection(&ctxVfs->CacheDirectoryLock);
-    return FALSE;
+    ReleaseSRWLockShared(&ctxVfs->CacheDirectoryLock);
+    return fResult;
 }
 
 BOOL VfsCacheDirectory_GetSingle(_In_ LPWSTR wszPath, _In_ LPWSTR wszFile, _Out_ PWIN32_FIND_DATAW pFindData, _Out_ PBOOL pfIsDirectoryExisting)
@@ -197,41 +263,313 @@ BOOL VfsCacheDirectory_GetSingle(_In_ LPWSTR wszPath, _In_ LPWSTR wszFile, _Out_
 
 BOOL VfsCacheDirectory_DokanFillDirectory(_In_ LPCWSTR wcsPathFileName, _In_ PFillFindData FillFindData, _Inout_ PDOKAN_FILE_INFO DokanFileInfo)
 {
-    QWORD i, qwCurrentTickCount;
-    qwCurrentTickCount = GetTickCount64();
-    EnterCriticalSection(&ctxVfs->CacheDirectoryLock);
-    for(i = 0; i < VMMVFS_CACHE_DIRECTORY_ENTRIES; i++) {
-        if(wcscmp(wcsPathFileName, ctxVfs->CacheDirectory[i].wszDirectoryName)) { continue; }
-        if(qwCurrentTickCount > ctxVfs->CacheDirectory[i].qwExpireTickCount64) { continue; }
-        VfsFileList_DokanFillAll(ctxVfs->CacheDirectory[i].pFileList, DokanFileInfo, FillFindData);
-        LeaveCriticalSection(&ctxVfs->CacheDirectoryLock);
-        return TRUE;
+    PVFS_CACHE_DIRECTORY pe;
+    AcquireSRWLockShared(&ctxVfs->CacheDirectoryLock);
+    if((pe = VfsCacheDirectory_GetDirectory(wcsPathFileName, GetTickCount64()))) {
+        VfsFileList_DokanFillAll(pe->pFileList, DokanFileInfo, FillFindData);
+    }
+    ReleaseSRWLockShared(&ctxVfs->CacheDirectoryLock);
+    return pe ? TRUE : FALSE;
+}
+
+/*
+* Remove and free expired cached directories and any cached directory matching
+* pe - CacheDirectoryLock must be held exclusive. Only the hash bucket of pe is
+* processed unless the cache is full; in which case all buckets are processed
+* and the entry closest to expiry is evicted if nothing else was removed.
+* -- peNew = entry about to be inserted.
+*/
+VOID VfsCacheDirectory_Remove(_In_ PVFS_CACHE_DIRECTORY peNew)
+{
+    QWORD qwCurrentTickCount = GetTickCount64();
+    PVFS_CACHE_DIRECTORY pe, *ppe, *ppeEvict = NULL;
+    BOOL fFull = ctxVfs->CacheDirectory.c >= VMMVFS_CACHE_DIRECTORY_ENTRIES_MAX;
+    DWORD i = fFull ? 0 : (peNew->dwHash & (VMMVFS_CACHE_DIRECTORY_BUCKETS - 1));
+    DWORD iMax = fFull ? VMMVFS_CACHE_DIRECTORY_BUCKETS : i + 1;
+    for(; i < iMax; i++) {
+        ppe = (PVFS_CACHE_DIRECTORY*)&ctxVfs->CacheDirectory.Bucket[i];
+        while((pe = *ppe)) {
+            if((qwCurrentTickCount > pe->qwExpireTickCount64) || ((pe->dwHash == peNew->dwHash) && !wcscmp(pe->wszDirectoryName, peNew->wszDirectoryName))) {
+                *ppe = pe->FLink;
+                VfsFileList_Free(pe->pFileList);
+                LocalFree(pe);
+                ctxVfs->CacheDirectory.c--;
+                continue;
+            }
+            if(!ppeEvict || (pe->qwExpireTickCount64 < (*ppeEvict)->qwExpireTickCount64)) {
+                ppeEvict = ppe;
+            }
+            ppe = &pe->FLink;
+        }
+    }
+    if((ctxVfs->CacheDirectory.c >= VMMVFS_CACHE_DIRECTORY_ENTRIES_MAX) && ppeEvict) {
+        pe = *ppeEvict;
+        *ppeEvict = pe->FLink;
+        VfsFileList_Free(pe->pFileList);
+        LocalFree(pe);
+        ctxVfs->CacheDirectory.c--;
     }
-    LeaveCriticalSection(&ctxVfs->CacheDirectoryLock);
-    return FALSE;
 }
 
 VOID VfsCacheDirectory_Put(_In_ LPCWSTR wcsDirectoryName, _In_ PVFS_FILELIST pFileList)
 {
-    EnterCriticalSection(&ctxVfs->CacheDirectoryLock);
-    ctxVfs->CacheDirectory[ctxVfs->CacheDirectoryIndex].qwExpireTickCount64 = GetTickCount64() + VMMVFS_CACHE_DIRECTORY_LIFETIME_PROC_MS;
-    wcsncpy_s(ctxVfs->CacheDirectory[ctxVfs->CacheDirectoryIndex].wszDirectoryName, MAX_PATH, wcsDirectoryName, _TRUNCATE);
-    VfsFileList_Free(ctxVfs->CacheDirectory[ctxVfs->CacheDirectoryIndex].pFileList);
-    ctxVfs->CacheDirectory[ctxVfs->CacheDirectoryIndex].pFileList = pFileList;
-    ctxVfs->CacheDirectoryIndex = (ctxVfs->CacheDirectoryIndex + 1) % VMMVFS_CACHE_DIRECTORY_ENTRIES;
-    LeaveCriticalSection(&ctxVfs->CacheDirectoryLock);
+    DWORD i, iMap, dwHash, cFiles = 0, cFileMap = 16;
+    PVFS_FILELIST pFileListIter;
+    PVFS_CACHE_DIRECTORY pe, *ppeBucket;
+    PVFS_CACHE_FILEMAP_ENTRY pme;
+    // 1: allocate and fill cache entry and its file name hash map (max 50% fill)
+    for(pFileListIter = pFileList; pFileListIter; pFileListIter = pFileListIter->FLink) {
+        cFiles += pFileListIter->cFiles;
+    }
+    while(cFileMap < 2 * cFiles) { cFileMap <<= 1; }
+    pe = LocalAlloc(LMEM_ZEROINIT, sizeof(VFS_CACHE_DIRECTORY) + cFileMap * sizeof(VFS_CACHE_FILEMAP_ENTRY));
+    if(!pe) {
+        VfsFileList_Free(pFileList);
+        return;
+    }
+    wcsncpy_s(pe->wszDirectoryName, MAX_PATH, wcsDirectoryName, _TRUNCATE);
+    pe->dwHash = Vfs_UtilHashStringUpperW(pe->wszDirectoryName);
+    pe->qwExpireTickCount64 = GetTickCount64() + VfsCacheDirectory_GetTtl(pe->wszDirectoryName);
+    pe->pFileList = pFileList;
+    pe->cFileMap = cFileMap;
+    for(pFileListIter = pFileList; pFileListIter; pFileListIter = pFileListIter->FLink) {
+        for(i = 0; i < pFileListIter->cFiles; i++) {
+            dwHash = Vfs_UtilHashStringUpperW(pFileListIter->pFiles[i].cFileName);
+            iMap = dwHash;
+            while((pme = pe->FileMap + (iMap & (cFileMap - 1)))->pFindData) { iMap++; }
+            pme->dwHash = dwHash;
+            pme->pFindData = pFileListIter->pFiles + i;
+        }
+    }
+    // 2: insert into cache - replacing any existing entry and evicting if full
+    AcquireSRWLockExclusive(&ctxVfs->CacheDirectoryLock);
+    VfsCacheDirectory_Remove(pe);
+    ppeBucket = (PVFS_CACHE_DIRECTORY*)&ctxVfs->CacheDirectory.Bucket[pe->dwHash & (VMMVFS_CACHE_DIRECTORY_BUCKETS - 1)];
+    pe->FLink = *ppeBucket;
+    *ppeBucket = pe;
+    ctxVfs->CacheDirectory.c++;
+    ReleaseSRWLockExclusive(&ctxVfs->CacheDirectoryLock);
+}
+
+/*
+* Initialize the per-plugin directory cache ttls.
+* -- szCacheTtl = <plugin>=<ms>[,<plugin>=<ms>]* - plugin '*' sets the default.
+*/
+VOID VfsCacheDirectory_InitializeTtl(_In_opt_ LPSTR szCacheTtl)
+{
+    CHAR szTtl[MAX_PATH];
+    WCHAR wszName[32];
+    LPSTR szToken, szContext = NULL, szValue;
+    ctxVfs->CacheDirectory.dwTtlDefaultMs = VMMVFS_CACHE_DIRECTORY_LIFETIME_PROC_MS;
+    if(!szCacheTtl) { return; }
+    strncpy_s(szTtl, MAX_PATH, szCacheTtl, _TRUNCATE);
+    szToken = strtok_s(szTtl, ",", &szContext);
+    while(szToken) {
+        if((szValue = strchr(szToken, '='))) {
+            *szValue++ = 0;
+            if(!strcmp(szToken, "*")) {
+                ctxVfs->CacheDirectory.dwTtlDefaultMs = strtoul(szValue, NULL, 0);
+            } else if(ctxVfs->CacheDirectory.cTtl < VMMVFS_CACHE_DIRECTORY_TTL_MAX) {
+                _snwprintf_s(wszName, _countof(wszName), _TRUNCATE, L"%S", szToken);
+                ctxVfs->CacheDirectory.Ttl[ctxVfs->CacheDirectory.cTtl].dwHash = Vfs_UtilHashStringUpperW(wszName);
+                ctxVfs->CacheDirectory.Ttl[ctxVfs->CacheDirectory.cTtl].dwTtlMs = strtoul(szValue, NULL, 0);
+                ctxVfs->CacheDirectory.cTtl++;
+            }
+        }
+        szToken = strtok_s(NULL, ",", &szContext);
+    }
 }
 
 VOID VfsCacheDirectory_Close()
 {
     DWORD i;
-    EnterCriticalSection(&ctxVfs->CacheDirectoryLock);
-    for(i = 0; i < VMMVFS_CACHE_DIRECTORY_ENTRIES; i++) {
-        ctxVfs->CacheDirectory[i].qwExpireTickCount64 = 0;
-        VfsFileList_Free(ctxVfs->CacheDirectory[i].pFileList);
-        ctxVfs->CacheDirectory[i].pFileList = NULL;
+    PVFS_CACHE_DIRECTORY pe;
+    AcquireSRWLockExclusive(&ctxVfs->CacheDirectoryLock);
+    for(i = 0; i < VMMVFS_CACHE_DIRECTORY_BUCKETS; i++) {
+        while((pe = ctxVfs->CacheDirectory.Bucket[i])) {
+            ctxVfs->CacheDirectory.Bucket[i] = pe->FLink;
+            VfsFileList_Free(pe->pFileList);
+            LocalFree(pe);
+        }
     }
-    LeaveCriticalSection(&ctxVfs->CacheDirectoryLock);
+    ctxVfs->CacheDirectory.c = 0;
+    ReleaseSRWLockExclusive(&ctxVfs->CacheDirectoryLock);
+}
+
+//-------------------------------------------------------------------------------
+// PER-HANDLE SEQUENTIAL READ-AHEAD BELOW:
+// (large files opened through dokan are read in small requests - once a handle
+//  is detected as being read sequentially data is read in large chunks into a
+//  per-handle double buffer; the next chunk being read asynchronously ahead).
+//-------------------------------------------------------------------------------
+
+typedef struct tdVFS_READAHEAD_CHUNK {
+    HANDLE hEventIdle;                      // manual reset - signalled when no read is pending
+    BOOL fValid;
+    DWORD cb;                               // valid bytes of completed read
+    QWORD qwOffset;
+    PBYTE pb;
+    struct tdVFS_READAHEAD *pReadAhead;
+} VFS_READAHEAD_CHUNK, *PVFS_READAHEAD_CHUNK;
+
+typedef struct tdVFS_READAHEAD {
+    CRITICAL_SECTION Lock;
+    QWORD qwOffsetNext;                     // expected offset of next sequential read
+    DWORD cSequential;                      // # consecutive sequential reads
+    VFS_READAHEAD_CHUNK Chunk[2];
+    WCHAR wszFileName[MAX_PATH];
+} VFS_READAHEAD, *PVFS_READAHEAD;
+
+/*
+* Create a read-ahead context for a newly opened file handle.
+* -- wcsFileName
+* -- return = the context, or NULL on failure. Free with VfsReadAhead_Close.
+*/
+PVFS_READAHEAD VfsReadAhead_Open(_In_ LPCWSTR wcsFileName)
+{
+    DWORD i;
+    PVFS_READAHEAD ctx;
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(VFS_READAHEAD)))) { return NULL; }
+    for(i = 0; i < 2; i++) {
+        ctx->Chunk[i].pReadAhead = ctx;
+        if(!(ctx->Chunk[i].hEventIdle = CreateEvent(NULL, TRUE, TRUE, NULL))) {
+            if(i) { CloseHandle(ctx->Chunk[0].hEventIdle); }
+            LocalFree(ctx);
+            return NULL;
+        }
+    }
+    wcsncpy_s(ctx->wszFileName, MAX_PATH, wcsFileName, _TRUNCATE);
+    InitializeCriticalSection(&ctx->Lock);
+    return ctx;
+}
+
+/*
+* Close a read-ahead context - waiting for any pending asynchronous read.
+* -- ctx
+*/
+VOID VfsReadAhead_Close(_In_opt_ PVFS_READAHEAD ctx)
+{
+    DWORD i;
+    if(!ctx) { return; }
+    for(i = 0; i < 2; i++) {
+        WaitForSingleObject(ctx->Chunk[i].hEventIdle, INFINITE);
+        CloseHandle(ctx->Chunk[i].hEventIdle);
+    }
+    DeleteCriticalSection(&ctx->Lock);
+    LocalFree(ctx->Chunk[0].pb);
+    LocalFree(ctx);
+}
+
+DWORD WINAPI VfsReadAhead_ThreadProc(_In_ PVFS_READAHEAD_CHUNK pc)
+{
+    DWORD cbRead = 0;
+    ctxVfs->pVmmDll->VfsRead(pc->pReadAhead->wszFileName, pc->pb, VMMVFS_READAHEAD_CHUNK_SIZE, &cbRead, pc->qwOffset);
+    pc->cb = min(cbRead, VMMVFS_READAHEAD_CHUNK_SIZE);
+    pc->fValid = TRUE;
+    SetEvent(pc->hEventIdle);
+    return 0;
+}
+
+/*
+* Fetch a chunk - asynchronously (if possible) or synchronously.
+* -- pc
+* -- qwOffset
+* -- fAsync
+*/
+VOID VfsReadAhead_ChunkFetch(_In_ PVFS_READAHEAD_CHUNK pc, _In_ QWORD qwOffset, _In_ BOOL fAsync)
+{
+    WaitForSingleObject(pc->hEventIdle, INFINITE);
+    pc->fValid = FALSE;
+    pc->cb = 0;
+    pc->qwOffset = qwOffset;
+    ResetEvent(pc->hEventIdle);
+    if(!fAsync || !QueueUserWorkItem((LPTHREAD_START_ROUTINE)VfsReadAhead_ThreadProc, pc, WT_EXECUTEDEFAULT)) {
+        VfsReadAhead_ThreadProc(pc);
+    }
+}
+
+/*
+* Retrieve the chunk (completed or pending) containing data at qwOffset.
+* -- ctx
+* -- qwOffset
+* -- return = the chunk if it contains data at qwOffset, otherwise NULL.
+*/
+PVFS_READAHEAD_CHUNK VfsReadAhead_ChunkGet(_In_ PVFS_READAHEAD ctx, _In_ QWORD qwOffset)
+{
+    DWORD i;
+    PVFS_READAHEAD_CHUNK pc;
+    for(i = 0; i < 2; i++) {
+        pc = ctx->Chunk + i;
+        if((qwOffset < pc->qwOffset) || (qwOffset >= pc->qwOffset + VMMVFS_READAHEAD_CHUNK_SIZE)) { continue; }
+        WaitForSingleObject(pc->hEventIdle, INFINITE);
+        if(pc->fValid && (qwOffset < pc->qwOffset + pc->cb)) { return pc; }
+    }
+    return NULL;
+}
+
+/*
+* Read from a file using the read-ahead buffer if the handle is being read
+* sequentially. Non-sequential reads are left to the caller.
+* -- ctx
+* -- pb
+* -- cb
+* -- pcbRead
+* -- qwOffset
+* -- return = TRUE if the read was served from the read-ahead buffer.
+*/
+_Success_(return)
+BOOL VfsReadAhead_Read(_In_ PVFS_READAHEAD ctx, _Out_writes_(cb) PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD qwOffset)
+{
+    QWORD o;
+    DWORD cbRead = 0, cbCopy;
+    PVFS_READAHEAD_CHUNK pc, pcNext;
+    EnterCriticalSection(&ctx->Lock);
+    ctx->cSequential = (qwOffset == ctx->qwOffsetNext) ? ctx->cSequential + 1 : 0;
+    ctx->qwOffsetNext = qwOffset + cb;
+    if((ctx->cSequential < VMMVFS_READAHEAD_SEQUENTIAL_TRIGGER) || (cb >= VMMVFS_READAHEAD_CHUNK_SIZE)) { goto finish; }
+    if(!ctx->Chunk[0].pb) {
+        if(!(ctx->Chunk[0].pb = LocalAlloc(0, 2 * VMMVFS_READAHEAD_CHUNK_SIZE))) { goto finish; }
+        ctx->Chunk[1].pb = ctx->Chunk[0].pb + VMMVFS_READAHEAD_CHUNK_SIZE;
+    }
+    while(cbRead < cb) {
+        o = qwOffset + cbRead;
+        if(!(pc = VfsReadAhead_ChunkGet(ctx, o))) {
+            pc = ctx->Chunk;
+            VfsReadAhead_ChunkFetch(pc, o, FALSE);
+            if(!pc->cb) { break; }
+        }
+        cbCopy = (DWORD)min(cb - cbRead, pc->qwOffset + pc->cb - o);
+        memcpy(pb + cbRead, pc->pb + (o - pc->qwOffset), cbCopy);
+        cbRead += cbCopy;
+        // read next chunk ahead (unless end of file or already fetched)
+        pcNext = ctx->Chunk + ((pc == ctx->Chunk) ? 1 : 0);
+        if((pc->cb == VMMVFS_READAHEAD_CHUNK_SIZE) && (pcNext->qwOffset != pc->qwOffset + VMMVFS_READAHEAD_CHUNK_SIZE)) {
+            VfsReadAhead_ChunkFetch(pcNext, pc->qwOffset + VMMVFS_READAHEAD_CHUNK_SIZE, TRUE);
+        }
+        if(pc->cb < VMMVFS_READAHEAD_CHUNK_SIZE) { break; }
+    }
+finish:
+    LeaveCriticalSection(&ctx->Lock);
+    *pcbRead = cbRead;
+    return cbRead ? TRUE : FALSE;
+}
+
+/*
+* Invalidate any read-ahead data - i.e. after a write to the file.
+* -- ctx
+*/
+VOID VfsReadAhead_Invalidate(_In_ PVFS_READAHEAD ctx)
+{
+    DWORD i;
+    EnterCriticalSection(&ctx->Lock);
+    for(i = 0; i < 2; i++) {
+        WaitForSingleObject(ctx->Chunk[i].hEventIdle, INFINITE);
+        ctx->Chunk[i].fValid = FALSE;
+        ctx->Chunk[i].qwOffset = 0;
+        ctx->Chunk[i].cb = 0;
+    }
+    ctx->cSequential = 0;
+    LeaveCriticalSection(&ctx->Lock);
 }
 
 //-------------------------------------------------------------------------------
@@ -317,6 +655,9 @@ VfsCallback_CreateFile_Impl(LPCWSTR wcsFileName, PDOKAN_IO_SECURITY_CONTEXT Secu
     DokanFileInfo->IsDirectory = (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? TRUE : FALSE;
     DokanFileInfo->Nocache = TRUE;
     if(!DokanFileInfo->IsDirectory && (CreateOptions & FILE_DIRECTORY_FILE)) { return STATUS_NOT_A_DIRECTORY; }     // fail upon open normal file as directory
+    if(!DokanFileInfo->IsDirectory && !DokanFileInfo->Context && ((((QWORD)FindData.nFileSizeHigh << 32) | FindData.nFileSizeLow) >= VMMVFS_READAHEAD_MIN_FILESIZE)) {
+        DokanFileInfo->Context = (ULONG64)VfsReadAhead_Open(wcsFileName);
+    }
     return (CreateDisposition == OPEN_ALWAYS) ? STATUS_OBJECT_NAME_COLLISION : STATUS_SUCCESS;
 }
 
@@ -400,7 +741,11 @@ VfsCallback_ReadFile(LPCWSTR wcsFileName, LPVOID Buffer, DWORD BufferLength, LPD
     UINT64 tmStart = dbg_GetTickCount64();
     NTSTATUS nt;
     dbg_wprintf_init(L"DEBUG::%08x -------- VfsCallback_ReadFile:\t\t\t 0x%08x %s\n", 0, wcsFileName);
-    nt = ctxVfs->pVmmDll->VfsRead(wcsFileName, Buffer, BufferLength, ReadLength, Offset);
+    if(DokanFileInfo->Context && VfsReadAhead_Read((PVFS_READAHEAD)DokanFileInfo->Context, Buffer, BufferLength, ReadLength, Offset)) {
+        nt = STATUS_SUCCESS;
+    } else {
+        nt = ctxVfs->pVmmDll->VfsRead(wcsFileName, Buffer, BufferLength, ReadLength, Offset);
+    }
     dbg_wprintf(L"DEBUG::%08x %8x VfsCallback_ReadFile:\t\t\t 0x%08x %s\t [ %016llx %08x %08x ]\n", (DWORD)(dbg_GetTickCount64() - tmStart), nt, wcsFileName, Offset, BufferLength, *ReadLength);
     return nt;
 }
@@ -411,11 +756,22 @@ VfsCallback_WriteFile(LPCWSTR wcsFileName, LPCVOID Buffer, DWORD NumberOfBytesTo
     UINT64 tmStart = dbg_GetTickCount64();
     NTSTATUS nt;
     dbg_wprintf_init(L"DEBUG::%08x -------- VfsCallback_WriteFile:\t\t\t 0x%08x %s\n", 0, wcsFileName);
+    if(DokanFileInfo->Context) {
+        VfsReadAhead_Invalidate((PVFS_READAHEAD)DokanFileInfo->Context);
+    }
     nt = ctxVfs->pVmmDll->VfsWrite(wcsFileName, (PBYTE)Buffer, NumberOfBytesToWrite, NumberOfBytesWritten, Offset);
     dbg_wprintf(L"DEBUG::%08x %8x VfsCallback_WriteFile:\t\t\t 0x%08x %s\t [ %016llx %08x %08x ]\n", (DWORD)(dbg_GetTickCount64() - tmStart), nt, wcsFileName, Offset, NumberOfBytesToWrite, *NumberOfBytesWritten);
     return nt;
 }
 
+void DOKAN_CALLBACK
+VfsCallback_CloseFile(LPCWSTR wcsFileName, PDOKAN_FILE_INFO DokanFileInfo)
+{
+    UNREFERENCED_PARAMETER(wcsFileName);
+    VfsReadAhead_Close((PVFS_READAHEAD)DokanFileInfo->Context);
+    DokanFileInfo->Context = 0;
+}
+
 //-------------------------------------------------------------------------------
 // VFS INITIALIZATION FUNCTIONALITY BELOW:
 //-------------------------------------------------------------------------------
@@ -437,7 +793,6 @@ VOID VfsClose(_In_ CHAR chMountPoint)
             }
         }
         VfsCacheDirectory_Close();
-        DeleteCriticalSection(&ctxVfs->CacheDirectoryLock);
     }
     LocalFree(ctxVfs);
     ctxVfs = NULL;
@@ -472,7 +827,7 @@ VOID VfsInitializeAndMount_DisplayInfo(LPWSTR wszMountPoint, _In_ PVMMDLL_FUNCTI
     printf("==========================================================================\n\n");
 }
 
-VOID VfsInitializeAndMount(_In_ CHAR chMountPoint, _In_ PVMMDLL_FUNCTIONS pVmmDll)
+VOID VfsInitializeAndMount(_In_ CHAR chMountPoint, _In_opt_ LPSTR szCacheTtl, _In_ PVMMDLL_FUNCTIONS pVmmDll)
 {
     int status;
     HMODULE hModuleDokan = NULL;
@@ -507,7 +862,8 @@ VOID VfsInitializeAndMount(_In_ CHAR chMountPoint, _In_ PVMMDLL_FUNCTIONS pVmmDl
     // set vfs context
     GetSystemTime(&SystemTimeNow);
     SystemTimeToFileTime(&SystemTimeNow, &ctxVfs->ftDefaultTime);
-    InitializeCriticalSection(&ctxVfs->CacheDirectoryLock);
+    InitializeSRWLock(&ctxVfs->CacheDirectoryLock);
+    VfsCacheDirectory_InitializeTtl(szCacheTtl);
     ctxVfs->DokanNtStatusFromWin32 = (NTSTATUS(*)(DWORD))GetProcAddress(hModuleDokan, "DokanNtStatusFromWin32");
     ctxVfs->fInitialized = TRUE;
     // set options
@@ -523,6 +879,7 @@ VOID VfsInitializeAndMount(_In_ CHAR chMountPoint, _In_ PVMMDLL_FUNCTIONS pVmmDl
     pDokanOperations->FindFiles = VfsCallback_FindFiles;
     pDokanOperations->ReadFile = VfsCallback_ReadFile;
     pDokanOperations->WriteFile = VfsCallback_WriteFile;
+    pDokanOperations->CloseFile = VfsCallback_CloseFile;
     // print system information to console
     VfsInitializeAndMount_DisplayInfo(wszMountPoint, pVmmDll);
     // mount file system
@@ -10,8 +10,13 @@
 
 typedef unsigned __int64                QWORD, *PQWORD;
 
-#define VMMVFS_CACHE_DIRECTORY_ENTRIES          15
-#define VMMVFS_CACHE_DIRECTORY_LIFETIME_PROC_MS 500
+#define VMMVFS_CACHE_DIRECTORY_BUCKETS          0x40    // # hash buckets (power of 2)
+#define VMMVFS_CACHE_DIRECTORY_ENTRIES_MAX      0x100   // max # cached directories
+#define VMMVFS_CACHE_DIRECTORY_LIFETIME_PROC_MS 500     // default directory ttl
+#define VMMVFS_CACHE_DIRECTORY_TTL_MAX          16      // max # per-plugin ttls
+#define VMMVFS_READAHEAD_MIN_FILESIZE           0x01000000  // only read-ahead files >= 16MB
+#define VMMVFS_READAHEAD_CHUNK_SIZE             0x00400000  // read-ahead chunk size (x2 buffers per handle)
+#define VMMVFS_READAHEAD_SEQUENTIAL_TRIGGER     2           // # sequential reads before read-ahead starts
 
 typedef struct tdVMMDLL_FUNCTIONS {
     BOOL(*Initialize)(_In_ DWORD argc, _In_ LPSTR argv[]);
@@ -27,14 +32,18 @@ typedef struct tdVMMVFS_CONFIG {
     PVMMDLL_FUNCTIONS pVmmDll;
     FILETIME ftDefaultTime;
     NTSTATUS(*DokanNtStatusFromWin32)(DWORD Error);
-    CRITICAL_SECTION CacheDirectoryLock;
+    SRWLOCK CacheDirectoryLock;
     BOOL fInitialized;
-    QWORD CacheDirectoryIndex;
     struct {
-        QWORD qwExpireTickCount64;
-        WCHAR wszDirectoryName[MAX_PATH];
-        PVOID pFileList;
-    } CacheDirectory[VMMVFS_CACHE_DIRECTORY_ENTRIES];
+        DWORD c;
+        DWORD dwTtlDefaultMs;
+        PVOID Bucket[VMMVFS_CACHE_DIRECTORY_BUCKETS];
+        DWORD cTtl;
+        struct {
+            DWORD dwHash;                   // plugin name hash (Vfs_UtilHashStringUpperW)
+            DWORD dwTtlMs;
+        } Ttl[VMMVFS_CACHE_DIRECTORY_TTL_MAX];
+    } CacheDirectory;
 } VMMVFS_CONFIG, *PVMMVFS_CONFIG;
 
 PVMMVFS_CONFIG ctxVfs;
@@ -48,9 +57,11 @@ PVMMVFS_CONFIG ctxVfs;
 * This also initializes the globalcontext ctxVfs that should be closed by
 * calling VfsClose on exit.
 * -- chMountPoint
+* -- szCacheTtl = optional per-plugin directory cache ttls in the format:
+*       <plugin>=<ms>[,<plugin>=<ms>]* - plugin '*' sets the default ttl.
 * -- pVmmDll
 */
-VOID VfsInitializeAndMount(_In_ CHAR chMountPoint, _In_ PVMMDLL_FUNCTIONS pVmmDll);
+VOID VfsInitializeAndMount(_In_ CHAR chMountPoint, _In_opt_ LPSTR szCacheTtl, _In_ PVMMDLL_FUNCTIONS pVmmDll);
 
 /*
 * Close a vfs sub-context in ctxVfs - if exists.
@@ -66,6 +66,14 @@ VMMPY_WINREG_RESOURCE_REQUIREMENTS_LIST = 0x0A
 VMMPY_WINREG_QWORD =                    0x0B
 
 VMMPY_PID_PROCESS_CLONE_WITH_KERNELMEMORY   = 0x80000000
+VMMPY_MEMSEARCH_PID_ALL                     = 0xfffffffe
+
+# struct formats of entries returned by the VmmPy_*Packed functions
+# (use with struct.iter_unpack or numpy.frombuffer).
+VMMPY_PACKED_FORMAT_PTE =               '<QQQII'        # va, pages, flags-pte, pages-sw, wow64
+VMMPY_PACKED_FORMAT_VAD =               '<QQQIIIIQQQ'   # start, end, va-vad, dw0, dw1, u2, prototype-len, prototype, subsection, va-fileobject
+VMMPY_PACKED_FORMAT_HANDLE =            '<QQQQQIIIIII'  # va-object, chandle, cpointer, va-object-creatinfo, va-securitydescriptor, handle, access, typeindex, pid, pooltag, reserved
+VMMPY_PACKED_FORMAT_PFN =               '<IIQQQIIII'    # pfn, pid, va, va-pte, pte-original, tp, tpex, flags, reserved
 
 #------------------------------------------------------------------------------
 # VmmPy INITIALIZATION FUNCTIONALITY BELOW:
@@ -154,6 +162,40 @@ VMMPY_OPT_CONFIG_VMM_VERSION_MINOR            = 0x2000000A00000000  # R
 VMMPY_OPT_CONFIG_VMM_VERSION_REVISION         = 0x2000000B00000000  # R
 VMMPY_OPT_CONFIG_STATISTICS_FUNCTIONCALL      = 0x2000000C00000000  # RW - enable function call statistics (.status/statistics_fncall file)
 VMMPY_OPT_CONFIG_IS_PAGING_ENABLED            = 0x2000000D00000000  # RW - 1/0
+VMMPY_OPT_CONFIG_CACHESIZE_PHYS               = 0x2000000E00000000  # RW - physical memory cache size (in MB)
+VMMPY_OPT_CONFIG_CACHESIZE_TLB                = 0x2000000F00000000  # RW - page table (tlb) cache size (in MB)
+VMMPY_OPT_CONFIG_CACHESIZE_PAGING             = 0x2000001000000000  # RW - virtual memory 'paging' cache size (in MB)
+VMMPY_OPT_CONFIG_CACHE_PHYS_2Q                = 0x2000001100000000  # RW - 1/0 - scan resistant physical memory cache
+VMMPY_OPT_CONFIG_READAHEAD_MAX                = 0x2000001200000000  # RW - max physical memory read-ahead (in pages), 0 = disabled
+VMMPY_OPT_CONFIG_TLBCACHE_REVALIDATE          = 0x2000001300000000  # RW - 1/0 - revalidate page table (tlb) cache on refresh instead of clear
+VMMPY_OPT_CONFIG_STAT_CACHE_HIT               = 0x2000001400000000  # R - cache hits - low dword = cache table: 1=PHYS 2=TLB 3=PAGING
+VMMPY_OPT_CONFIG_STAT_CACHE_MISS              = 0x2000001500000000  # R - cache misses - low dword = cache table
+VMMPY_OPT_CONFIG_STAT_CACHE_EVICT             = 0x2000001600000000  # R - cache evictions - low dword = cache table
+VMMPY_OPT_CONFIG_STAT_CACHE_RESFAIL           = 0x2000001700000000  # R - cache reserve failures - low dword = cache table
+VMMPY_OPT_CONFIG_STAT_CACHE_INUSE             = 0x2000001800000000  # R - cache entries in use - low dword = cache table
+VMMPY_OPT_CONFIG_STAT_DEVICE_LATENCY          = 0x2000001900000000  # R - device reads with latency < 2^n uS - low dword = n [0-15]
+VMMPY_OPT_CONFIG_READ_COALESCE_US             = 0x2000001A00000000  # RW - small read coalescing window in uS - 0 = disabled
+VMMPY_OPT_CONFIG_CACHE_COMPRESS_MB            = 0x2000001B00000000  # RW - compressed physical memory cache tier budget in MB - 0 = disabled
+VMMPY_OPT_CONFIG_PHYS2VIRT_INDEX              = 0x2000001C00000000  # R/W: global phys2virt reverse index enabled (0/1)
+VMMPY_OPT_CONFIG_CACHE_PROTOTYPEPTE_MB        = 0x2000001D00000000  # RW - prototype pte array cache budget in MB - 0 = default
+VMMPY_OPT_CONFIG_WARMUP_MAPS                  = 0x2000001E00000000  # RW - map types to pre-build after process refresh - bitmask: 1=vad 2=module 4=handle 8=thread
+VMMPY_OPT_CONFIG_REGISTRY_LAZY                = 0x2000001F00000000  # RW - 1/0 - lazy registry hive snapshots - hive data fetched and keys built on demand
+VMMPY_OPT_CONFIG_PLUGIN_LAZY                  = 0x2000002000000000  # RW - 1/0 - lazy plugin loading - set before VMMDLL_InitializePlugins
+VMMPY_OPT_CONFIG_REMOTE_PROFILE               = 0x2000002100000000  # RW - 1/0 - remote device profile - pipelined bulk reads and round-trip time tuned coalescing and read-ahead
+VMMPY_OPT_CONFIG_STAT_DEVICE_RTT_US           = 0x2000002200000000  # R - smoothed round-trip time of small device reads in uS (remote profile only)
+VMMPY_OPT_CONFIG_STAT_FNCALL_COUNT            = 0x2000002300000000  # R - function call count - low dword = id as in statistics_fncall.json
+VMMPY_OPT_CONFIG_STAT_FNCALL_P50_US           = 0x2000002400000000  # R - function call median latency in uS - low dword = STATISTICS_ID
+VMMPY_OPT_CONFIG_STAT_FNCALL_P95_US           = 0x2000002500000000  # R - function call 95th percentile latency in uS - low dword = STATISTICS_ID
+VMMPY_OPT_CONFIG_STAT_FNCALL_P99_US           = 0x2000002600000000  # R - function call 99th percentile latency in uS - low dword = STATISTICS_ID
+VMMPY_OPT_CONFIG_STAT_FNCALL_MAX_US           = 0x2000002700000000  # R - function call max latency in uS - low dword = STATISTICS_ID
+VMMPY_OPT_CONFIG_MEMORY_BUDGET_MB             = 0x2000002800000000  # RW - global memory budget in MB - 0 = no budget
+VMMPY_OPT_CONFIG_STAT_MEMORY_USAGE            = 0x2000002900000000  # R - memory in use by budgeted subsystems in bytes
+VMMPY_OPT_CONFIG_TLB_VERIFY_VECTOR            = 0x2000002A00000000  # RW - 1/0 - vectorized x64 page table verify (0 = scalar, x64 only)
+VMMPY_OPT_FORENSIC_SCAN_CHUNKS                = 0x2000020200000000  # RW - forensic physical memory scan pipeline depth (# chunks in flight) - 0 = default (4)
+VMMPY_OPT_FORENSIC_SCAN_CHUNK_MB              = 0x2000020300000000  # RW - forensic physical memory scan chunk size in MB - 0 = default (16)
+VMMPY_OPT_FORENSIC_MEMORY_BUDGET_MB           = 0x2000020400000000  # RW - in-memory forensic database (mode 5) spill-to-disk budget in MB - 0 = default (4096)
+VMMPY_OPT_FORENSIC_DATABASE_SAVE              = 0x2000020500000000  # W - save in-memory forensic database (mode 5) to its temp file
+VMMPY_OPT_FORENSIC_INIT_STATUS                = 0x2000020600000000  # R - forensic initialization status - 0 = not started, 1 = in progress, 2 = completed
 
 VMMDLL_OPT_WIN_VERSION_MAJOR                  = 0x2000010100000000  # R
 VMMDLL_OPT_WIN_VERSION_MINOR                  = 0x2000010200000000  # R
@@ -239,6 +281,24 @@ def VmmPy_MemRead(pid, address, length, flags = 0):
 
 
 
+def VmmPy_MemReadInto(pid, address, buffer, flags = 0):
+    """Read memory given a pid and a (64-bit) address into a bytearray without intermediate copies. The length of the read is the length of the bytearray. Return number of bytes read.
+    NB! the python buffer protocol is unavailable in the limited api (3.6) used by vmmpyc - other python threads are therefore blocked (the GIL is held) during the read.
+
+    Keyword arguments:
+    pid -- int: the process identifier (pid) when reading process virtual memory. -1 when reading physical memory.
+    address -- int: the address to read.
+    buffer -- bytearray: to receive the memory.
+    flags -- int: optional flags as specified by VMMPY_FLAG* constants.
+    return -- int: number of bytes read.
+    
+    Example:
+    VmmPy_MemReadInto(-1, 0x1000, bytearray(4)) --> 4
+    """
+    return VMMPYC_MemReadInto(pid, address, buffer, flags)
+
+
+
 def VmmPy_MemReadScatter(pid, address_list, flags = 0):
     """Read page (4kB) sized & aligned memory given a pid and a list of (64-bit) addresses. Return result in list of dict.
 
@@ -256,6 +316,63 @@ def VmmPy_MemReadScatter(pid, address_list, flags = 0):
 
 
 
+def VmmPy_MemReadScatterInto(pid, address_list, buffer, flags = 0):
+    """Read page (4kB) sized & aligned memory given a pid and a list of (64-bit) addresses into a bytearray without intermediate copies. Page i is written to buffer offset i * 0x1000. Return list of per-page success.
+    NB! the python buffer protocol is unavailable in the limited api (3.6) used by vmmpyc - other python threads are therefore blocked (the GIL is held) during the read.
+
+    Keyword arguments:
+    pid -- int: the process identifier (pid) when reading process virtual memory. -1 when reading physical memory.
+    address_list -- list: a list of page (4kB/0x1000) aligned addresses.
+    buffer -- bytearray: of at least len(address_list) * 0x1000 bytes.
+    flags -- int: optional flags as specified by VMMPY_FLAG* constants.
+    return -- list: of bool - True if the page was read successfully.
+    
+    Example:
+    VmmPy_MemReadScatterInto(-1, [0x1000, 0x2000], bytearray(0x2000)) --> [True, True]
+    """
+
+    return VMMPYC_MemReadScatterInto(pid, address_list, buffer, flags)
+
+
+
+def VmmPy_MemReadScatterEx(pid, range_list, flags = 0):
+    """Read multiple arbitrary sized & aligned memory ranges in one batch given a pid and a list of (address, size) tuples. Unreadable memory is zero-filled.
+
+    Keyword arguments:
+    pid -- int: the process identifier (pid) when reading process virtual memory. -1 when reading physical memory.
+    range_list -- list: a list of (address, size) tuples.
+    flags -- int: optional flags as specified by VMMPY_FLAG* constants.
+    return -- list: of bytes in the same order as range_list.
+    
+    Example:
+    VmmPy_MemReadScatterEx(4, [(0xfffff8034be00000, 4), (0xfffff8034be01008, 2)]) --> [b'MZ\x90\x00', b'\x00\x00']
+    """
+
+    return VMMPYC_MemReadScatterEx(pid, range_list, flags)
+
+
+
+def VmmPy_MemSearch(pid, search_list, address_min = 0, address_max = 0, max_results = 0x10000, flags = 0, is_writable = False, is_executable = False):
+    """Search memory for up to 16 byte patterns in one parallel pass. Return list of hits as (pid, address, search_index) tuples.
+
+    Keyword arguments:
+    pid -- int: the process identifier (pid) when searching process virtual memory. -1 when searching physical memory. 0xfffffffe (VMMPY_MEMSEARCH_PID_ALL) when searching all processes.
+    search_list -- list: of bytes (max 32 bytes each) or (bytes, skip_mask_bytes_or_None, alignment) tuples. Bits set in the skip mask are wildcards.
+    address_min -- int: (optional) min address to search.
+    address_max -- int: (optional) max address to search, 0 = no limit.
+    max_results -- int: (optional) stop after this number of hits.
+    flags -- int: optional flags as specified by VMMPY_FLAG* constants.
+    is_writable -- bool: (optional) virtual memory: only search writable memory.
+    is_executable -- bool: (optional) virtual memory: only search executable memory.
+    return -- list: of (pid, address, search_index) tuples.
+    
+    Example:
+    VmmPy_MemSearch(4, [b'MZ\x90\x00', (b'\x48\x8b\x05\x00\x00\x00\x00', b'\x00\x00\x00\xff\xff\xff\xff', 1)], is_executable = True) --> [(4, 18446735288168595456, 0), ...]
+    """
+    return VMMPYC_MemSearch(pid, search_list, address_min, address_max, max_results, flags, is_writable, is_executable)
+
+
+
 def VmmPy_MemWrite(pid, address, bytes_data):
     """Write memory given a pid, a (64-bit) address and length. No return.
 
@@ -332,6 +449,18 @@ def VmmPy_ProcessGetPteMap(pid, is_identify_modules = False):
     """
     return VMMPYC_ProcessGetPteMap(pid, is_identify_modules)
 
+def VmmPy_ProcessGetPteMapPacked(pid):
+    """Retrieve the pte memory map for a specific pid as packed bytes of VMMPY_PACKED_FORMAT_PTE entries (no tags).
+
+    Keyword arguments:
+    pid -- int: the process identifier (pid).
+    return -- bytes: packed PTE memory map entries.
+    
+    Example:
+    list(struct.iter_unpack(VMMPY_PACKED_FORMAT_PTE, VmmPy_ProcessGetPteMapPacked(4))) --> [(140715078701056, 2, 9223372036854775812, 0, 0), ...]
+    """
+    return VMMPYC_ProcessGetPteMapPacked(pid)
+
 def VmmPy_ProcessGetMemoryMap(pid, is_identify_modules = False):
     """Deprecated - use VmmPy_ProcessGetPteMap instead!"""
     return VMMPYC_ProcessGetPteMap(pid, is_identify_modules)
@@ -351,6 +480,19 @@ def VmmPy_ProcessGetVadMap(pid, is_identify_modules = False):
     """
     return VMMPYC_ProcessGetVadMap(pid, is_identify_modules)
 
+def VmmPy_ProcessGetVadMapPacked(pid):
+    """Retrieve the virtual address descriptor (VAD) memory map for a specific pid as packed bytes of VMMPY_PACKED_FORMAT_VAD entries (no tags).
+    dw0/dw1 are the raw VAD flag bitfields: VadType bits 0-2, Protection bits 3-7, fImage bit 8, fFile bit 9, fPageFile bit 10, fPrivateMemory bit 11, fTeb bit 12, fStack bit 13, HeapNum bits 16-22, fHeap bit 23 / CommitCharge bits 0-30, MemCommit bit 31.
+
+    Keyword arguments:
+    pid -- int: the process identifier (pid).
+    return -- bytes: packed VAD memory map entries.
+    
+    Example:
+    list(struct.iter_unpack(VMMPY_PACKED_FORMAT_VAD, VmmPy_ProcessGetVadMapPacked(4))) --> [(140715077140480, 140715079172095, 18446644053817718800, 956301592, 17, 0, 3968, 18446663847518789648, 18446644053817718944, 18446644053817719104), ...]
+    """
+    return VMMPYC_ProcessGetVadMapPacked(pid)
+
 
 
 def VmmPy_ProcessGetHeapMap(pid):
@@ -393,6 +535,18 @@ def VmmPy_ProcessGetHandleMap(pid):
     """
     return VMMPYC_ProcessGetHandleMap(pid)
 
+def VmmPy_ProcessGetHandleMapPacked(pid):
+    """Retrieve information about handles for a specific pid as packed bytes of VMMPY_PACKED_FORMAT_HANDLE entries (no tag/type names).
+
+    Keyword arguments:
+    pid -- int: the process identifier (pid).
+    return -- bytes: packed handle entries.
+    
+    Example:
+    list(struct.iter_unpack(VMMPY_PACKED_FORMAT_HANDLE, VmmPy_ProcessGetHandleMapPacked(4))) --> [(18446644053936528592, 1, 1, 18446644053883285568, 0, 12268, 1180063, 37, 4280, 1701603654, 0), ...]
+    """
+    return VMMPYC_ProcessGetHandleMapPacked(pid)
+
 
 
 def VmmPy_ProcessGetModuleMap(pid):
@@ -600,6 +754,23 @@ def VmmPy_WinReg_ValueRead(keyvalue):
 
 
 
+def VmmPy_WinReg_ValueReadBatch(keyvalues):
+    """Read multiple registry values in one call. Values located in the same
+    registry key are read with a single key lookup.
+
+    Keyword arguments:
+    keyvalues -- list: of str paths of registry values to read - same format as
+                 in VmmPy_WinReg_ValueRead.
+    return -- dict: of path -> dict of 'type' and 'data'. Values that could not
+              be read are not included.
+
+    Example:
+    VmmPy_WinReg_ValueReadBatch(['HKLM\\SYSTEM\\Setup\\SystemPartition', 'HKLM\\SYSTEM\\Setup\\SetupType']) --> {'HKLM\\SYSTEM\\Setup\\SystemPartition': {'type': 1, 'data': b'...'}, 'HKLM\\SYSTEM\\Setup\\SetupType': {'type': 4, 'data': b'\\x00\\x00\\x00\\x00'}}
+    """
+    return VMMPYC_WinReg_QueryValueBatch(keyvalues)
+
+
+
 #------------------------------------------------------------------------------
 # VmmPy VFS (Virtual File System) FUNCTIONALITY BELOW:
 #------------------------------------------------------------------------------
@@ -808,6 +979,20 @@ def VmmPy_MapGetPfns(pfns):
     """
     return VMMPYC_MapGetPfns(pfns)
 
+def VmmPy_MapGetPfnsPacked(pfn_start, pfn_count):
+    """Retrieve information about a range of page frame numbers (PFNs) as packed bytes of VMMPY_PACKED_FORMAT_PFN entries.
+    tp and tpex are the numeric page location and extended type (see VmmPy_MapGetPfns for names).
+
+    Keyword arguments:
+    pfn_start -- int: the first page frame number of the range.
+    pfn_count -- int: the number of page frame numbers in the range.
+    return -- bytes: packed PFN entries.
+    
+    Example:
+    list(struct.iter_unpack(VMMPY_PACKED_FORMAT_PFN, VmmPy_MapGetPfnsPacked(0x58f4c, 1))) --> [(364364, 10744, 1977593008128, 18446607188374379848, 0, 6, 2, 1, 0)]
+    """
+    return VMMPYC_MapGetPfnsPacked(pfn_start, pfn_count)
+
 
 
 def VmmPy_WinGetThunkInfoEAT(pid, module_name, exported_function):
@@ -13,6 +13,13 @@
 # be used in plugins, but also in ordinary stand-alone python for convenient
 # and easy vmm integration.
 #
+# File system requests into the python plugins are made from many threads at
+# the same time. The vmmpy functions release the GIL while executing in the
+# native vmm - requests of other threads are processed meanwhile. A plugin not
+# able to handle concurrent requests may set the module global variable:
+# 'Concurrency = VMMPYPLUGIN_CONCURRENCY_SERIAL' - calls into that plugin are
+# then serialized by a per-plugin lock without affecting any other plugins.
+#
 # https://github.com/ufrisk/
 #
 # (c) Ulf Frisk, 2018-2020
@@ -23,6 +30,10 @@
 
 from vmmpy import *
 from vmmpycc import *
+import threading
+
+VMMPYPLUGIN_CONCURRENCY_PARALLEL = 0    # plugin calls may execute concurrently (default).
+VMMPYPLUGIN_CONCURRENCY_SERIAL   = 1    # plugin calls are serialized by a per-plugin lock.
 
 VmmPyPlugin_fPrint =    False   # print statements enable.
 VmmPyPlugin_fPrintV =   False   # verbose print statements enable.
@@ -102,10 +113,14 @@ def VmmPyPlugin_InternalInitializePlugins():
     for f in plugin_files:
         f_split = f.replace(path, '').replace('\\', '/').split('/')
         plugin_names.add(f_split[0] + '.' + f_split[1])
+    global VmmPyPlugin_PluginLocks
     VmmPyPlugin_PluginModules = []
+    VmmPyPlugin_PluginLocks = {}
     for e in plugin_names:
         try:
             module = importlib.import_module(e)
+            if getattr(module, 'Concurrency', VMMPYPLUGIN_CONCURRENCY_PARALLEL) == VMMPYPLUGIN_CONCURRENCY_SERIAL:
+                VmmPyPlugin_PluginLocks[module.__name__] = threading.RLock()
             module.Initialize(VmmPyPlugin_TargetSystem, VmmPyPlugin_TargetMemoryModel)
             VmmPyPlugin_PluginModules.append(module)
             if VmmPyPlugin_fPrintV:
@@ -117,6 +132,24 @@ def VmmPyPlugin_InternalInitializePlugins():
 
 
 
+def VmmPyPlugin_InternalCall(fn, *args):
+    """Internal Use Only!
+    Call a plugin callback function - serialized by the per-plugin lock if
+    the plugin owning the function has requested serial concurrency.
+
+    Keyword arguments:
+    fn -- function: the plugin callback function.
+    args -- the arguments to the callback function.
+    return -- the return value of the callback function.
+    """
+    lock = VmmPyPlugin_PluginLocks.get(getattr(fn, '__module__', None))
+    if lock == None:
+        return fn(*args)
+    with lock:
+        return fn(*args)
+
+
+
 def VmmPyPlugin_InternalCallback_List(pid, path):
     """Internal Use Only!
     For a given path return list of dicts containing info for each entry.
@@ -135,7 +168,7 @@ def VmmPyPlugin_InternalCallback_List(pid, path):
             if not 'list' in dir_entry[e]:
                 return []
             if dir_entry[e]['list'] != None:
-                dir_entry = dir_entry[e]['list'](pid, path)
+                dir_entry = VmmPyPlugin_InternalCall(dir_entry[e]['list'], pid, path)
                 break
             else:
                 dir_entry = dir_entry[e]['dirs']
@@ -174,7 +207,7 @@ def VmmPyPlugin_InternalCallback_Read(pid, path, bytes_length, bytes_offset):
             return b''
         if bytes_length + bytes_offset > file_attr['size']:
             bytes_length = file_attr['size'] - bytes_offset
-        return file_attr['read'](pid, file_name, file_attr, bytes_length, bytes_offset)
+        return VmmPyPlugin_InternalCall(file_attr['read'], pid, file_name, file_attr, bytes_length, bytes_offset)
     except Exception as e:
         if VmmPyPlugin_fPrintV:
             print("VmmPyPlugin_InternalCallback_Read: Exception: " + str(e))
@@ -202,7 +235,7 @@ def VmmPyPlugin_InternalCallback_Write(pid, path, bytes_data, bytes_offset):
             return VMMPY_STATUS_END_OF_FILE
         if bytes_length + bytes_offset > file_attr['size']:
             bytes_length = file_attr['size'] - bytes_offset
-        return file_attr['write'](pid, file_name, file_attr, bytes_data, bytes_offset)
+        return VmmPyPlugin_InternalCall(file_attr['write'], pid, file_name, file_attr, bytes_data, bytes_offset)
     except Exception as e:
         if VmmPyPlugin_fPrintV:
             print("VmmPyPlugin_InternalCallback_Write: Exception: " + str(e))
@@ -238,7 +271,7 @@ def VmmPyPlugin_InternalCallback_Notify(fEvent, bytesData):
         VmmPyPlugin_InternalSetVerbosity()
     for module in VmmPyPlugin_PluginModules:
         if hasattr(module, 'Notify'):
-            module.Notify(fEvent, bytesData)
+            VmmPyPlugin_InternalCall(module.Notify, fEvent, bytesData)
 
 
 
@@ -340,7 +373,7 @@ def VmmPyPlugin_FileRetrieve(pid, path):
         if not path_item in dir_entry:
             raise RuntimeError('VmmPyPlugin_FileRetrieve: not found.')
         if dir_entry[path_item]['list'] != None:
-            dir_entry = dir_entry[path_item]['list'](pid, dir_path)
+            dir_entry = VmmPyPlugin_InternalCall(dir_entry[path_item]['list'], pid, dir_path)
             break
         else:
             dir_entry = dir_entry[path_item]['dirs']
@@ -10,6 +10,31 @@
 
 VMMDLL_MEMORYMODEL_TP g_VMemD_TpMemoryModel = VMMDLL_MEMORYMODEL_NA;
 
+#define VMEMD_MAPCACHE_ENTRIES          4
+#define VMEMD_MAPCACHE_TTL_MS           500
+
+/*
+* Cached copy of a process PTE or VAD map. Sequential reads of a vmemd file
+* are done in smaller chunks - caching the map saves re-copying the whole
+* map on each read. The cache holds one reference of each cached entry.
+*/
+typedef struct tdVMEMD_MAPCACHE_ENTRY {
+    volatile LONG cRef;
+    DWORD dwPID;
+    BOOL fVad;
+    DWORD _Reserved;
+    QWORD qwExpireTickCount64;
+    union {
+        PVMMDLL_MAP_PTE pPteMap;
+        PVMMDLL_MAP_VAD pVadMap;
+    };
+    BYTE pbMap[];
+} VMEMD_MAPCACHE_ENTRY, *PVMEMD_MAPCACHE_ENTRY;
+
+SRWLOCK g_VMemD_MapCacheLock = SRWLOCK_INIT;
+PVMEMD_MAPCACHE_ENTRY g_VMemD_MapCache[VMEMD_MAPCACHE_ENTRIES] = { 0 };
+DWORD g_VMemD_MapCacheNext = 0;
+
 #define UTIL_ASCIIFILENAME_ALLOW \
     "0000000000000000000000000000000011011111111111101111111111010100" \
     "1111111111111111111111111111011111111111111111111111111111110111" \
@@ -92,6 +117,77 @@ PVOID VMemD_Util_qfind(_In_ PVOID pvFind, _In_ DWORD cMap, _In_ PVOID pvMap, _In
     return NULL;
 }
 
+VOID VMemD_MapCache_Release(_In_opt_ PVMEMD_MAPCACHE_ENTRY pe)
+{
+    if(pe && !InterlockedDecrement(&pe->cRef)) {
+        LocalFree(pe);
+    }
+}
+
+/*
+* Retrieve a referenced PTE or VAD map of a process. The map is retrieved from
+* the cache if a non-expired entry exists, otherwise it's fetched from vmm.dll
+* and cached. The caller must release the entry with VMemD_MapCache_Release.
+* -- dwPID
+* -- fVad
+* -- return
+*/
+PVMEMD_MAPCACHE_ENTRY VMemD_MapCache_Get(_In_ DWORD dwPID, _In_ BOOL fVad)
+{
+    DWORD i, cbMap = 0;
+    QWORD qwTickCount64 = GetTickCount64();
+    PVMEMD_MAPCACHE_ENTRY pe, peOld = NULL;
+    // 1: try retrieve from cache
+    AcquireSRWLockExclusive(&g_VMemD_MapCacheLock);
+    for(i = 0; i < VMEMD_MAPCACHE_ENTRIES; i++) {
+        pe = g_VMemD_MapCache[i];
+        if(pe && (pe->dwPID == dwPID) && (pe->fVad == fVad) && (pe->qwExpireTickCount64 > qwTickCount64)) {
+            InterlockedIncrement(&pe->cRef);
+            ReleaseSRWLockExclusive(&g_VMemD_MapCacheLock);
+            return pe;
+        }
+    }
+    ReleaseSRWLockExclusive(&g_VMemD_MapCacheLock);
+    // 2: fetch map
+    if(fVad ? !VMMDLL_ProcessMap_GetVad(dwPID, NULL, &cbMap, FALSE) : !VMMDLL_ProcessMap_GetPte(dwPID, NULL, &cbMap, FALSE)) { return NULL; }
+    if(!(pe = LocalAlloc(0, sizeof(VMEMD_MAPCACHE_ENTRY) + cbMap))) { return NULL; }
+    pe->cRef = 2;
+    pe->dwPID = dwPID;
+    pe->fVad = fVad;
+    pe->qwExpireTickCount64 = qwTickCount64 + VMEMD_MAPCACHE_TTL_MS;
+    pe->pPteMap = (PVMMDLL_MAP_PTE)pe->pbMap;
+    if(fVad ? !VMMDLL_ProcessMap_GetVad(dwPID, pe->pVadMap, &cbMap, FALSE) : !VMMDLL_ProcessMap_GetPte(dwPID, pe->pPteMap, &cbMap, FALSE)) {
+        LocalFree(pe);
+        return NULL;
+    }
+    // 3: insert into cache - replacing any existing entry of the same map
+    AcquireSRWLockExclusive(&g_VMemD_MapCacheLock);
+    for(i = 0; i < VMEMD_MAPCACHE_ENTRIES; i++) {
+        if(g_VMemD_MapCache[i] && (g_VMemD_MapCache[i]->dwPID == dwPID) && (g_VMemD_MapCache[i]->fVad == fVad)) { break; }
+    }
+    if(i == VMEMD_MAPCACHE_ENTRIES) {
+        i = g_VMemD_MapCacheNext++ % VMEMD_MAPCACHE_ENTRIES;
+    }
+    peOld = g_VMemD_MapCache[i];
+    g_VMemD_MapCache[i] = pe;
+    ReleaseSRWLockExclusive(&g_VMemD_MapCacheLock);
+    VMemD_MapCache_Release(peOld);
+    return pe;
+}
+
+VOID VMemD_MapCache_Clear()
+{
+    DWORD i;
+    PVMEMD_MAPCACHE_ENTRY pe;
+    for(i = 0; i < VMEMD_MAPCACHE_ENTRIES; i++) {
+        AcquireSRWLockExclusive(&g_VMemD_MapCacheLock);
+        pe = g_VMemD_MapCache[i];
+        g_VMemD_MapCache[i] = NULL;
+        ReleaseSRWLockExclusive(&g_VMemD_MapCacheLock);
+        VMemD_MapCache_Release(pe);
+    }
+}
+
 /*
 * Comparator function for VMemD_Util_qfind to serach entries in PTEMAP.
 */
@@ -120,16 +216,13 @@ NTSTATUS VMemD_ReadWritePte(_In_ DWORD dwPID, _In_ QWORD vaBase, _In_ BOOL fRead
     NTSTATUS nt = VMMDLL_STATUS_FILE_INVALID;
     BOOL result;
     QWORD cbMax;
-    DWORD cbPteMap = 0;
-    PVMMDLL_MAP_PTE pPteMap = NULL;
+    PVMEMD_MAPCACHE_ENTRY pMapEntry = NULL;
     PVMMDLL_MAP_PTEENTRY pe = NULL;
     // read memory from "vmemd" directory file - "pte mapped"
     *pcbReadWrite = 0;
     result =
-        VMMDLL_ProcessMap_GetPte(dwPID, NULL, &cbPteMap, FALSE) &&
-        (pPteMap = LocalAlloc(0, cbPteMap)) &&
-        VMMDLL_ProcessMap_GetPte(dwPID, pPteMap, &cbPteMap, FALSE) &&
-        (pe = VMemD_Util_qfind((PVOID)vaBase, pPteMap->cMap, pPteMap->pMap, sizeof(VMMDLL_MAP_PTEENTRY), (int(*)(PVOID, PVOID))VMemD_ReadPte_CmpFind));
+        (pMapEntry = VMemD_MapCache_Get(dwPID, FALSE)) &&
+        (pe = VMemD_Util_qfind((PVOID)vaBase, pMapEntry->pPteMap->cMap, pMapEntry->pPteMap->pMap, sizeof(VMMDLL_MAP_PTEENTRY), (int(*)(PVOID, PVOID))VMemD_ReadPte_CmpFind));
     if(!result) { goto fail; }
     if(pe->vaBase + (pe->cPages << 12) <= vaBase + cbOffset) {
         nt = VMMDLL_STATUS_END_OF_FILE;
@@ -146,7 +239,7 @@ NTSTATUS VMemD_ReadWritePte(_In_ DWORD dwPID, _In_ QWORD vaBase, _In_ BOOL fRead
         nt = VMMDLL_STATUS_SUCCESS;
     }
 fail:
-    LocalFree(pPteMap);
+    VMemD_MapCache_Release(pMapEntry);
     return nt;
 }
 
@@ -158,16 +251,13 @@ NTSTATUS VMemD_ReadWriteVad(_In_ DWORD dwPID, _In_ QWORD vaBase, _In_ BOOL fRead
     NTSTATUS nt = VMMDLL_STATUS_FILE_INVALID;
     BOOL result;
     QWORD cbMax;
-    DWORD cbVadMap = 0;
-    PVMMDLL_MAP_VAD pVadMap = NULL;
+    PVMEMD_MAPCACHE_ENTRY pMapEntry = NULL;
     PVMMDLL_MAP_VADENTRY pe = NULL;
     // read memory from "vmemd" directory file - "pte mapped"
     *pcbReadWrite = 0;
     result =
-        VMMDLL_ProcessMap_GetVad(dwPID, NULL, &cbVadMap, FALSE) &&
-        (pVadMap = LocalAlloc(0, cbVadMap)) &&
-        VMMDLL_ProcessMap_GetVad(dwPID, pVadMap, &cbVadMap, FALSE) &&
-        (pe = VMemD_Util_qfind((PVOID)vaBase, pVadMap->cMap, pVadMap->pMap, sizeof(VMMDLL_MAP_VADENTRY), (int(*)(PVOID, PVOID))VMemD_ReadVad_CmpFind));
+        (pMapEntry = VMemD_MapCache_Get(dwPID, TRUE)) &&
+        (pe = VMemD_Util_qfind((PVOID)vaBase, pMapEntry->pVadMap->cMap, pMapEntry->pVadMap->pMap, sizeof(VMMDLL_MAP_VADENTRY), (int(*)(PVOID, PVOID))VMemD_ReadVad_CmpFind));
     if(!result) { goto fail; }
     if(pe->vaEnd <= vaBase + cbOffset) {
         nt = VMMDLL_STATUS_END_OF_FILE;
@@ -184,7 +274,7 @@ NTSTATUS VMemD_ReadWriteVad(_In_ DWORD dwPID, _In_ QWORD vaBase, _In_ BOOL fRead
         nt = VMMDLL_STATUS_SUCCESS;
     }
 fail:
-    LocalFree(pVadMap);
+    VMemD_MapCache_Release(pMapEntry);
     return nt;
 }
 
@@ -315,6 +405,28 @@ fail:
     return fResult;
 }
 
+/*
+* Notify : function as specified by the module manager. Cached maps may be
+* stale after a total process refresh - clear them.
+* -- fEvent
+* -- pvEvent
+* -- cbEvent
+*/
+VOID VMemD_Notify(_In_ DWORD fEvent, _In_opt_ PVOID pvEvent, _In_opt_ DWORD cbEvent)
+{
+    if(fEvent == VMMDLL_PLUGIN_EVENT_REFRESH_PROCESS_TOTAL) {
+        VMemD_MapCache_Clear();
+    }
+}
+
+/*
+* Close : function as specified by the module manager.
+*/
+VOID VMemD_Close()
+{
+    VMemD_MapCache_Clear();
+}
+
 /*
 * Initialization function for the vmemd native plugin module.
 * It's important that the function is exported in the DLL and that it is
@@ -337,5 +449,7 @@ VOID InitializeVmmPlugin(_In_ PVMMDLL_PLUGIN_REGINFO pRegInfo)
     pRegInfo->reg_fn.pfnList = VMemD_List;                      // List function supported.
     pRegInfo->reg_fn.pfnRead = VMemD_Read;                      // Read function supported.
     pRegInfo->reg_fn.pfnWrite = VMemD_WritePte;                    // Write function supported.
+    pRegInfo->reg_fn.pfnNotify = VMemD_Notify;                  // Notify function supported.
+    pRegInfo->reg_fn.pfnClose = VMemD_Close;                    // Close function supported.
     pRegInfo->pfnPluginManager_Register(pRegInfo);              // Register with the plugin maanger.
 }
@@ -33,9 +33,6 @@ static LPSTR FC_SQL_SCHEMA_NTFS =
     "DROP VIEW IF EXISTS v_ntfs; " \
     "DROP TABLE IF EXISTS ntfs; " \
     "CREATE TABLE ntfs ( id INTEGER PRIMARY KEY, id_parent INTEGER, id_str INTEGER, hash INTEGER, hash_parent INTEGER, addr_phys INTEGER, inode INTEGER, mft_flags INTEGER, depth INTEGER, size_file INTEGER, size_fileres INTEGER, time_create INTEGER, time_modify INTEGER, time_read INTEGER, name_seq INTEGER, oln_u INTEGER, oln_j INTEGER );" \
-    "CREATE INDEX idx_ntfs_hash ON ntfs(hash); " \
-    "CREATE INDEX idx_ntfs_hash_parent ON ntfs(hash_parent); " \
-    "CREATE INDEX idx_oln_u ON ntfs(oln_u); " \
     "CREATE VIEW v_ntfs AS SELECT *, SUBSTR(sz, osz+1) AS sz_sub FROM ntfs, str WHERE ntfs.id_str = str.id; ";
 static LPSTR FC_SQL_SCHEMA_PROCESS =
     "DROP TABLE IF EXISTS process; " \
@@ -52,6 +49,19 @@ static LPSTR FC_SQL_SCHEMA_REGISTRY =
     "DROP TABLE IF EXISTS registry; " \
     "CREATE TABLE registry ( id INTEGER PRIMARY KEY AUTOINCREMENT, id_str INTEGER, hive INTEGER, cell INTEGER, cell_parent INTEGER, time INTEGER ); " \
     "CREATE VIEW v_registry AS SELECT *, SUBSTR(sz, osz+1) AS sz_sub FROM registry, str WHERE registry.id_str = str.id; ";
+static LPSTR FC_SQL_SCHEMA_PATTERN =
+    "DROP TABLE IF EXISTS pattern; " \
+    "CREATE TABLE pattern ( id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT, pa INTEGER, pid INTEGER, va INTEGER, tp INTEGER, tpex INTEGER ); ";
+static LPSTR FC_SQL_SCHEMA_META =
+    "CREATE TABLE IF NOT EXISTS fc_meta ( id INTEGER PRIMARY KEY, version INTEGER, pa_max INTEGER, build INTEGER, dtb INTEGER, hash_header BLOB, phase INTEGER, enable INTEGER ); ";
+// secondary indexes - created by Fc_SqlInitializeDatabaseIndexes() once the
+// ingestion phase has completed instead of being maintained on every insert.
+static LPSTR FC_SQL_INDEX[] = {
+    "CREATE INDEX IF NOT EXISTS idx_ntfs_hash ON ntfs(hash); ",
+    "CREATE INDEX IF NOT EXISTS idx_ntfs_hash_parent ON ntfs(hash_parent); ",
+    "CREATE INDEX IF NOT EXISTS idx_oln_u ON ntfs(oln_u); ",
+    "CREATE INDEX IF NOT EXISTS idx_pattern_name ON pattern(name); ",
+};
 
 
 
@@ -66,9 +76,9 @@ static LPSTR FC_SQL_SCHEMA_REGISTRY =
 PVOID FcNtfs_SetupInitialize();
 
 /*
-* Analyze a POB_FC_SCANPHYSMEM_CHUNK 16MB memory chunk for MFT file candidates
-* and add any found to the internal data sets. This function is meant to be
-* called asynchronously by a worker thread (VmmWork). Function is thread-safe.
+* Analyze a POB_FC_SCANPHYSMEM_CHUNK memory chunk for MFT file candidates and
+* add any found to the internal data sets. This function is meant to be called
+* asynchronously by a worker thread (VmmWork). Function is thread-safe.
 * -- pc
 */
 VOID FcNtfs_Setup_ThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc);
@@ -82,6 +92,28 @@ VOID FcNtfs_Setup_ThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc);
 */
 VOID FcNtfs_SetupFinalize(_In_opt_ PVOID pvSetupContextNtfs, _In_ BOOL fScanSuccess);
 
+/*
+* Initialize a new PFCPATTERN_SETUP_CONTEXT from the pattern file given by the
+* -forensicpattern configuration option.
+* -- return = the initialized context, or NULL on fail or if not configured.
+*/
+PVOID FcPattern_SetupInitialize();
+
+/*
+* Scan a POB_FC_SCANPHYSMEM_CHUNK memory chunk for all configured patterns.
+* This function is meant to be called asynchronously by a worker thread
+* (VmmWork). Function is thread-safe.
+* -- pc
+*/
+VOID FcPattern_Setup_ThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc);
+
+/*
+* Finalize the pattern scan - save all hits to the forensic database.
+* -- pvSetupContextPattern
+* -- fScanSuccess
+*/
+VOID FcPattern_SetupFinalize(_In_opt_ PVOID pvSetupContextPattern, _In_ BOOL fScanSuccess);
+
 /*
 * Initialize the timelining functionality. Before the timelining functionality
 * is initialized processes, threads, registry and ntfs must be initialized.
@@ -91,6 +123,30 @@ VOID FcNtfs_SetupFinalize(_In_opt_ PVOID pvSetupContextNtfs, _In_ BOOL fScanSucc
 _Success_(return)
 BOOL FcTimeline_Initialize();
 
+/*
+* Populate the in-memory timeline info from an already existing timeline_info
+* table - used when the timeline is re-used from a previous session.
+* -- return
+*/
+_Success_(return)
+BOOL FcTimeline_InitializeInfo();
+
+/*
+* Build the in-memory file offset indexes of the timeline files.
+*/
+VOID FcTimeline_InitializeOffsetIndex();
+
+/*
+* Build the in-memory file offset index of the ntfs info file.
+*/
+VOID FcNtfs_InitializeOffsetIndex();
+
+/*
+* Initialize / close the memory budgeted ntfs directory listing cache.
+*/
+VOID FcNtfs_DirCache_Initialize();
+VOID FcNtfs_DirCache_Close();
+
 
 
 // ----------------------------------------------------------------------------
@@ -251,40 +307,555 @@ int Fc_SqlBindMultiInt64(_In_ sqlite3_stmt *hStmt, _In_ DWORD iFirstBind, _In_ D
     return rc;
 }
 
+/*
+* Create a file offset index from an sql query returning (id, offset) rows of
+* contiguous ids ordered by id. The query is run once in a single pass.
+* -- szSqlCount = query returning the row count and the minimum id.
+* -- szSqlSelect = query returning the (id, offset) rows.
+* -- cQueryValues
+* -- pqwQueryValues
+* -- return = the index object, or NULL on fail (i.e. non-contiguous ids).
+*/
+_Success_(return != NULL)
+PFCOB_OFFSETINDEX FcOffsetIndex_Create(_In_ LPSTR szSqlCount, _In_ LPSTR szSqlSelect, _In_ DWORD cQueryValues, _In_reads_(cQueryValues) PQWORD pqwQueryValues)
+{
+    int rc;
+    DWORD i, cBlock;
+    QWORD qwId, qwOffset, qwOffsetPrev = 0, pqwResult[2];
+    PFCOB_OFFSETINDEX pObIndex = NULL;
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hStmt = NULL;
+    rc = Fc_SqlQueryN(szSqlCount, cQueryValues, pqwQueryValues, 2, pqwResult, NULL);
+    if((rc != SQLITE_OK) || !pqwResult[0] || (pqwResult[0] > 0x7fffffff)) { goto fail; }
+    cBlock = (DWORD)((pqwResult[0] + FC_OFFSETINDEX_BLOCK - 1) / FC_OFFSETINDEX_BLOCK);
+    pObIndex = Ob_Alloc('Fidx', LMEM_ZEROINIT, sizeof(FCOB_OFFSETINDEX) + ((pqwResult[0] + 1) & ~1) * sizeof(DWORD) + cBlock * sizeof(QWORD), NULL, NULL);
+    if(!pObIndex) { goto fail; }
+    pObIndex->qwIdBase = pqwResult[1];
+    pObIndex->cId = (DWORD)pqwResult[0];
+    pObIndex->cBlock = cBlock;
+    pObIndex->pqwBlock = (PQWORD)((PBYTE)pObIndex + sizeof(FCOB_OFFSETINDEX) + ((pqwResult[0] + 1) & ~1) * sizeof(DWORD));
+    if(!(hSql = Fc_SqlReserve())) { goto fail; }
+    rc = sqlite3_prepare_v2(hSql, szSqlSelect, -1, &hStmt, 0);
+    if(rc != SQLITE_OK) { goto fail; }
+    for(i = 0; i < cQueryValues; i++) {
+        sqlite3_bind_int64(hStmt, i + 1, pqwQueryValues[i]);
+    }
+    for(i = 0; i < pObIndex->cId; i++) {
+        if(SQLITE_ROW != sqlite3_step(hStmt)) { goto fail; }
+        qwId = sqlite3_column_int64(hStmt, 0);
+        qwOffset = sqlite3_column_int64(hStmt, 1);
+        if((qwId != pObIndex->qwIdBase + i) || (qwOffset < qwOffsetPrev)) { goto fail; }
+        if(0 == (i % FC_OFFSETINDEX_BLOCK)) {
+            pObIndex->pqwBlock[i / FC_OFFSETINDEX_BLOCK] = qwOffset;
+        }
+        if(qwOffset - pObIndex->pqwBlock[i / FC_OFFSETINDEX_BLOCK] > 0xffffffff) { goto fail; }
+        pObIndex->pdwOffset[i] = (DWORD)(qwOffset - pObIndex->pqwBlock[i / FC_OFFSETINDEX_BLOCK]);
+        qwOffsetPrev = qwOffset;
+    }
+    Ob_INCREF(pObIndex);
+fail:
+    sqlite3_finalize(hStmt);
+    Fc_SqlReserveReturn(hSql);
+    return Ob_DECREF(pObIndex);
+}
+
+/*
+* Retrieve the id of the entry (line) which contains a file position.
+* -- pIndex
+* -- qwFilePos
+* -- return = the id.
+*/
+QWORD FcOffsetIndex_GetId(_In_ PFCOB_OFFSETINDEX pIndex, _In_ QWORD qwFilePos)
+{
+    DWORD iLo = 0, iHi, iMid;
+    QWORD qwBlockPos;
+    // 1: binary search for the last block starting at or before qwFilePos.
+    iHi = pIndex->cBlock;
+    while(iHi - iLo > 1) {
+        iMid = (iLo + iHi) / 2;
+        if(pIndex->pqwBlock[iMid] <= qwFilePos) {
+            iLo = iMid;
+        } else {
+            iHi = iMid;
+        }
+    }
+    qwBlockPos = (qwFilePos > pIndex->pqwBlock[iLo]) ? (qwFilePos - pIndex->pqwBlock[iLo]) : 0;
+    // 2: binary search for the last entry within the block starting at or before qwFilePos.
+    iHi = min(pIndex->cId, (iLo + 1) * FC_OFFSETINDEX_BLOCK);
+    iLo = iLo * FC_OFFSETINDEX_BLOCK;
+    while(iHi - iLo > 1) {
+        iMid = (iLo + iHi) / 2;
+        if(pIndex->pdwOffset[iMid] <= qwBlockPos) {
+            iLo = iMid;
+        } else {
+            iHi = iMid;
+        }
+    }
+    return pIndex->qwIdBase + iLo;
+}
+
+/*
+* Retrieve the pragma statements applying (or reverting) the bulk-load mode on
+* a database connection given the current database type.
+* -- fEnable
+* -- return = the pragma statements, or NULL if nothing should be applied.
+*/
+LPSTR Fc_SqlBulkLoad_GetPragma(_In_ BOOL fEnable)
+{
+    BOOL fThrowaway = (ctxFc->db.tp == FC_DATABASE_TYPE_MEMORY) || (ctxFc->db.tp == FC_DATABASE_TYPE_TEMPFILE_CLOSE) || ((ctxFc->db.tp == FC_DATABASE_TYPE_MEMORY_SPILL) && !ctxFc->db.fSpilled);
+    if(fEnable) {
+        return fThrowaway ?
+            "PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF; PRAGMA temp_store = MEMORY; PRAGMA cache_size = -"STRINGIZE(FC_SQL_BULKLOAD_CACHE_KB)";" :
+            "PRAGMA journal_mode = TRUNCATE; PRAGMA synchronous = OFF; PRAGMA temp_store = MEMORY; PRAGMA cache_size = -"STRINGIZE(FC_SQL_BULKLOAD_CACHE_KB)";";
+    }
+    return fThrowaway ? NULL : "PRAGMA journal_mode = DELETE; PRAGMA synchronous = NORMAL;";
+}
+
+/*
+* Apply (or revert) the bulk-load settings on all pooled database connections.
+* Bulk-load mode is active during the INSERT-bound initialization phase and
+* skips fsync. Throwaway databases (memory & delete-on-close) also skip the
+* rollback journal and keep the fast settings after initialization. Persisted
+* databases keep an on-disk journal so that completed phases checkpointed in
+* fc_meta survive a crash of the process and may be re-used.
+* -- fEnable
+*/
+VOID Fc_SqlBulkLoad(_In_ BOOL fEnable)
+{
+    DWORD i;
+    LPSTR szSql;
+    if(!(szSql = Fc_SqlBulkLoad_GetPragma(fEnable))) { return; }
+    for(i = 0; i < FC_SQL_POOL_CONNECTION_NUM; i++) {
+        WaitForSingleObject(ctxFc->db.hEvent[i], INFINITE);
+        sqlite3_exec(ctxFc->db.hSql[i], szSql, NULL, NULL, NULL);
+        SetEvent(ctxFc->db.hEvent[i]);
+    }
+}
+
+/*
+* Move the in-memory database (FC_DATABASE_TYPE_MEMORY_SPILL) to its temp file
+* and re-open all pooled connections towards the file. The database is copied
+* with the sqlite online backup api while all pooled connections are held, i.e
+* no transaction is in progress. Once saved the temp file remains upon exit.
+* -- return
+*/
+_Success_(return)
+BOOL Fc_SqlMemorySpill()
+{
+    int rc;
+    DWORD i;
+    BOOL fResult = FALSE;
+    LPSTR szSql;
+    QWORD tmStart, tmEnd, qwFreq;
+    sqlite3 *hSqlDisk[FC_SQL_POOL_CONNECTION_NUM] = { 0 };
+    sqlite3_backup *hBackup;
+    if(ctxFc->db.tp != FC_DATABASE_TYPE_MEMORY_SPILL) { return FALSE; }
+    EnterCriticalSection(&ctxFc->Lock);
+    if(ctxFc->db.fSpilled) {
+        LeaveCriticalSection(&ctxFc->Lock);
+        return TRUE;
+    }
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmStart);
+    for(i = 0; i < FC_SQL_POOL_CONNECTION_NUM; i++) {
+        WaitForSingleObject(ctxFc->db.hEvent[i], INFINITE);
+    }
+    for(i = 0; i < FC_SQL_POOL_CONNECTION_NUM; i++) {
+        if(SQLITE_OK != sqlite3_open_v2(ctxFc->db.szuSpill, &hSqlDisk[i], SQLITE_OPEN_URI | SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_SHAREDCACHE | SQLITE_OPEN_NOMUTEX, NULL)) { goto fail; }
+    }
+    if(!(hBackup = sqlite3_backup_init(hSqlDisk[0], "main", ctxFc->db.hSql[0], "main"))) { goto fail; }
+    rc = sqlite3_backup_step(hBackup, -1);
+    sqlite3_backup_finish(hBackup);
+    if(rc != SQLITE_DONE) { goto fail; }
+    // swap pooled connections - closing the last memory connection frees the in-memory database.
+    for(i = 0; i < FC_SQL_POOL_CONNECTION_NUM; i++) {
+        sqlite3_close(ctxFc->db.hSql[i]);
+        ctxFc->db.hSql[i] = hSqlDisk[i];
+        hSqlDisk[i] = NULL;
+    }
+    wcscpy_s(ctxFc->db.wszDatabaseWinPath, _countof(ctxFc->db.wszDatabaseWinPath), ctxFc->db.wszSpillWinPath);
+    strcpy_s(ctxFc->db.szuDatabase, _countof(ctxFc->db.szuDatabase), ctxFc->db.szuSpill);
+    ctxFc->db.fSpilled = TRUE;
+    if((szSql = Fc_SqlBulkLoad_GetPragma(!ctxFc->fInitFinish))) {
+        for(i = 0; i < FC_SQL_POOL_CONNECTION_NUM; i++) {
+            sqlite3_exec(ctxFc->db.hSql[i], szSql, NULL, NULL, NULL);
+        }
+    }
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmEnd);
+    QueryPerformanceFrequency((PLARGE_INTEGER)&qwFreq);
+    vmmprintfv("FORENSIC: In-memory database saved to disk: %lli ms\n", (tmEnd - tmStart) * 1000 / qwFreq);
+    fResult = TRUE;
+fail:
+    for(i = 0; i < FC_SQL_POOL_CONNECTION_NUM; i++) {
+        if(hSqlDisk[i]) { sqlite3_close(hSqlDisk[i]); }
+    }
+    if(!fResult) {
+        DeleteFileW(ctxFc->db.wszSpillWinPath);
+    }
+    for(i = 0; i < FC_SQL_POOL_CONNECTION_NUM; i++) {
+        SetEvent(ctxFc->db.hEvent[i]);
+    }
+    LeaveCriticalSection(&ctxFc->Lock);
+    return fResult;
+}
+
+/*
+* Spill the in-memory database (FC_DATABASE_TYPE_MEMORY_SPILL) to disk if the
+* sqlite memory use exceeds the configured budget. Checked at each phase
+* checkpoint and after each batch flush. The caller must not hold a reserved
+* pooled connection since the spill waits for all of them.
+*/
+VOID Fc_SqlMemorySpillCheck()
+{
+    QWORD cbBudget = (QWORD)(ctxMain->cfg.cMBFcMemoryBudget ? ctxMain->cfg.cMBFcMemoryBudget : FC_SQL_MEMORY_BUDGET_MB_DEFAULT) << 20;
+    if((ctxFc->db.tp == FC_DATABASE_TYPE_MEMORY_SPILL) && !ctxFc->db.fSpilled && ((QWORD)sqlite3_memory_used() > cbBudget)) {
+        vmmprintfv("FORENSIC: In-memory database exceeds budget (%i MB) - spilling to disk.\n", (DWORD)(cbBudget >> 20));
+        Fc_SqlMemorySpill();
+    }
+}
+
+/*
+* Create the tables of all phases not already completed. Tables of completed
+* phases (and the shared str table) are kept as-is.
+* -- dwPhaseComplete = FC_PHASE_* already completed.
+* -- return
+*/
 _Success_(return)
-BOOL Fc_SqlInitializeDatabaseTables()
-{
-    if(SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_PFN)) { return FALSE; }
-    if(SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_STR)) { return FALSE; }
-    if(SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_NTFS)) { return FALSE; }
-    if(SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_PROCESS)) { return FALSE; }
-    if(SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_THREAD)) { return FALSE; }
-    if(SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_REGISTRY)) { return FALSE; }
+BOOL Fc_SqlInitializeDatabaseTables(_In_ DWORD dwPhaseComplete)
+{
+    if(!dwPhaseComplete && (SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_STR))) { return FALSE; }
+    if(!(dwPhaseComplete & FC_PHASE_PROCESS) && (SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_PROCESS))) { return FALSE; }
+    if(!(dwPhaseComplete & FC_PHASE_THREAD) && (SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_THREAD))) { return FALSE; }
+    if(!(dwPhaseComplete & FC_PHASE_REGISTRY) && (SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_REGISTRY))) { return FALSE; }
+    if(!(dwPhaseComplete & FC_PHASE_SCANPHYSMEM)) {
+        if(SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_PFN)) { return FALSE; }
+        if(SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_NTFS)) { return FALSE; }
+        if(SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_PATTERN)) { return FALSE; }
+    }
     return TRUE;
 }
 
+// FC_PHASE_* owning each fEnable* flag - flags are persisted as a bitmask in
+// fc_meta and only restored for phases which are re-used.
+static struct {
+    DWORD dwPhase;
+    SIZE_T oFlag;
+} FC_META_ENABLE[] = {
+    { FC_PHASE_SCANPHYSMEM, FIELD_OFFSET(FC_CONTEXT, fEnablePfn) },
+    { FC_PHASE_SCANPHYSMEM, FIELD_OFFSET(FC_CONTEXT, fEnableNtfs) },
+    { FC_PHASE_TIMELINE,    FIELD_OFFSET(FC_CONTEXT, fEnableTimeline) },
+    { FC_PHASE_PROCESS,     FIELD_OFFSET(FC_CONTEXT, fEnableProcess) },
+    { FC_PHASE_THREAD,      FIELD_OFFSET(FC_CONTEXT, fEnableThread) },
+    { FC_PHASE_REGISTRY,    FIELD_OFFSET(FC_CONTEXT, fEnableRegistry) },
+    { FC_PHASE_SCANPHYSMEM, FIELD_OFFSET(FC_CONTEXT, fEnablePattern) },
+};
+
+/*
+* Calculate the identity of the analyzed memory dump: a SHA-256 over the first
+* physical page, the kernel DTB page and - if the device is a dump file - the
+* file path, size and last write time. Together with the max physical address
+* and kernel build this identifies a dump without reading all of it.
+* -- pbHash
+*/
+VOID Fc_SqlMetaIdentity(_Out_writes_(32) PBYTE pbHash)
+{
+    BOOL fResult = FALSE;
+    BYTE pb[0x2000] = { 0 };
+    LPSTR szFile = ctxMain->dev.szDevice;
+    WIN32_FILE_ATTRIBUTE_DATA FileInfo = { 0 };
+    BCRYPT_HASH_HANDLE hHash = NULL;
+    VmmReadPage(NULL, 0, pb);
+    VmmReadPage(NULL, ctxVmm->kernel.paDTB & ~0xfff, pb + 0x1000);
+    if(!_strnicmp(szFile, "file://", 7)) { szFile += 7; }
+    if(!GetFileAttributesExA(szFile, GetFileExInfoStandard, &FileInfo) || (FileInfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        ZeroMemory(&FileInfo, sizeof(WIN32_FILE_ATTRIBUTE_DATA));
+        szFile = "";
+    }
+    if(BCRYPT_SUCCESS(BCryptCreateHash(BCRYPT_SHA256_ALG_HANDLE, &hHash, NULL, 0, NULL, 0, 0))) {
+        fResult =
+            BCRYPT_SUCCESS(BCryptHashData(hHash, pb, sizeof(pb), 0)) &&
+            BCRYPT_SUCCESS(BCryptHashData(hHash, (PBYTE)&FileInfo.nFileSizeHigh, 2 * sizeof(DWORD), 0)) &&
+            BCRYPT_SUCCESS(BCryptHashData(hHash, (PBYTE)&FileInfo.ftLastWriteTime, sizeof(FILETIME), 0)) &&
+            BCRYPT_SUCCESS(BCryptHashData(hHash, (PBYTE)szFile, (ULONG)strlen(szFile), 0)) &&
+            BCRYPT_SUCCESS(BCryptFinishHash(hHash, pbHash, 32, 0));
+        BCryptDestroyHash(hHash);
+    }
+    if(!fResult) {
+        ZeroMemory(pbHash, 32);
+    }
+}
+
+/*
+* Attach the forensic meta data to the database. If the database is persisted
+* at the static location and its meta data matches the current memory dump the
+* completed phases are re-used; otherwise a fresh meta data row is written.
+* -- fForceReInit = never re-use previous results.
+* -- return
+*/
+_Success_(return)
+BOOL Fc_SqlMetaAttach(_In_ BOOL fForceReInit)
+{
+    int rc;
+    DWORD i, dw, dwEnable;
+    BOOL fMatch = FALSE;
+    BYTE pbHash[32];
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hStmt = NULL;
+    if(SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_META)) { return FALSE; }
+    Fc_SqlMetaIdentity(pbHash);
+    if(!(hSql = Fc_SqlReserve())) { return FALSE; }
+    // 1: check for a matching previous session (static database only).
+    if((ctxFc->db.tp == FC_DATABASE_TYPE_TEMPFILE_STATIC) && !fForceReInit) {
+        rc = sqlite3_prepare_v2(hSql, "SELECT phase, enable FROM fc_meta WHERE id = 1 AND version = ? AND pa_max = ? AND build = ? AND dtb = ? AND hash_header = ?;", -1, &hStmt, NULL);
+        if(SQLITE_OK == rc) {
+            sqlite3_bind_int64(hStmt, 1, FC_META_VERSION);
+            sqlite3_bind_int64(hStmt, 2, ctxMain->dev.paMax);
+            sqlite3_bind_int64(hStmt, 3, ctxVmm->kernel.dwVersionBuild);
+            sqlite3_bind_int64(hStmt, 4, ctxVmm->kernel.paDTB);
+            sqlite3_bind_blob(hStmt, 5, pbHash, sizeof(pbHash), SQLITE_STATIC);
+            if(SQLITE_ROW == sqlite3_step(hStmt)) {
+                // phases run in order - only re-use the leading completed phases.
+                dw = (DWORD)sqlite3_column_int64(hStmt, 0);
+                for(i = 1; (i & FC_PHASE_ALL) && (dw & i); i <<= 1);
+                ctxFc->db.dwPhaseComplete = dw & (i - 1);
+                dwEnable = (DWORD)sqlite3_column_int64(hStmt, 1);
+                for(i = 0; i < sizeof(FC_META_ENABLE) / sizeof(FC_META_ENABLE[0]); i++) {
+                    if((ctxFc->db.dwPhaseComplete & FC_META_ENABLE[i].dwPhase) && (dwEnable & (1 << i))) {
+                        *(PBOOL)((PBYTE)ctxFc + FC_META_ENABLE[i].oFlag) = TRUE;
+                    }
+                }
+                fMatch = TRUE;
+            }
+        }
+        sqlite3_finalize(hStmt);
+        hStmt = NULL;
+    }
+    // 2: no match - start a fresh meta data row for this dump.
+    if(!fMatch) {
+        ctxFc->db.dwPhaseComplete = 0;
+        rc = sqlite3_prepare_v2(hSql, "INSERT OR REPLACE INTO fc_meta (id, version, pa_max, build, dtb, hash_header, phase, enable) VALUES (1, ?, ?, ?, ?, ?, 0, 0);", -1, &hStmt, NULL);
+        if(SQLITE_OK == rc) {
+            sqlite3_bind_int64(hStmt, 1, FC_META_VERSION);
+            sqlite3_bind_int64(hStmt, 2, ctxMain->dev.paMax);
+            sqlite3_bind_int64(hStmt, 3, ctxVmm->kernel.dwVersionBuild);
+            sqlite3_bind_int64(hStmt, 4, ctxVmm->kernel.paDTB);
+            sqlite3_bind_blob(hStmt, 5, pbHash, sizeof(pbHash), SQLITE_STATIC);
+            rc = sqlite3_step(hStmt);
+        }
+        sqlite3_finalize(hStmt);
+    }
+    Fc_SqlReserveReturn(hSql);
+    if(fMatch) {
+        Fc_SqlQueryN("SELECT MAX(id) FROM str;", 0, NULL, 1, &ctxFc->db.qwIdStr, NULL);
+        return TRUE;
+    }
+    return rc == SQLITE_DONE;
+}
+
+/*
+* Checkpoint a completed forensic initialization phase in the fc_meta table.
+* Only called once a phase has succeeded; a phase interrupted by shutdown is
+* not marked as completed. Phase boundaries
+* are also the points at which the in-memory database may spill to disk.
+* -- dwPhase = FC_PHASE_*
+*/
+VOID Fc_SqlMetaCheckpoint(_In_ DWORD dwPhase)
+{
+    DWORD i, dwEnable = 0;
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hStmt = NULL;
+    if(!ctxVmm->Work.fEnabled) { return; }
+    ctxFc->db.dwPhaseComplete |= dwPhase;
+    for(i = 0; i < sizeof(FC_META_ENABLE) / sizeof(FC_META_ENABLE[0]); i++) {
+        if(*(PBOOL)((PBYTE)ctxFc + FC_META_ENABLE[i].oFlag)) {
+            dwEnable |= 1 << i;
+        }
+    }
+    if(!(hSql = Fc_SqlReserve())) { return; }
+    if(SQLITE_OK == sqlite3_prepare_v2(hSql, "UPDATE fc_meta SET phase = ?, enable = ? WHERE id = 1;", -1, &hStmt, NULL)) {
+        sqlite3_bind_int64(hStmt, 1, ctxFc->db.dwPhaseComplete);
+        sqlite3_bind_int64(hStmt, 2, dwEnable);
+        sqlite3_step(hStmt);
+    }
+    sqlite3_finalize(hStmt);
+    Fc_SqlReserveReturn(hSql);
+    Fc_SqlMemorySpillCheck();
+}
+
+/*
+* Create the secondary indexes after the ingestion phase has completed. Each
+* index is built from the already populated table in one sorted pass. SQLite
+* allows a single writer per database only so the indexes are built one after
+* another on the same connection.
+* -- return
+*/
+_Success_(return)
+BOOL Fc_SqlInitializeDatabaseIndexes()
+{
+    int rc;
+    DWORD i;
+    BOOL fResult = TRUE;
+    QWORD tmStart, tmEnd;
+    sqlite3 *hSql = NULL;
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmStart);
+    if(!(hSql = Fc_SqlReserve())) { return FALSE; }
+    for(i = 0; i < sizeof(FC_SQL_INDEX) / sizeof(LPSTR); i++) {
+        if(SQLITE_OK != (rc = sqlite3_exec(hSql, FC_SQL_INDEX[i], NULL, NULL, NULL))) {
+            vmmprintf_fn("FAIL CREATE INDEX WITH SQLITE ERROR CODE %i, QUERY: %s\n", rc, FC_SQL_INDEX[i]);
+            fResult = FALSE;
+        }
+    }
+    Fc_SqlReserveReturn(hSql);
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmEnd);
+    ctxFc->ScanPhysMemStat.tmIndex = tmEnd - tmStart;
+    return fResult;
+}
+
 
 
 // ----------------------------------------------------------------------------
 // PFN / PAGE HASHING FUNCTIONALITY:
+// Each physical memory scan chunk is hashed and its pfn rows are aggregated
+// into a private per-chunk buffer by the worker thread processing the chunk.
+// Buffers are pushed onto a lock-free list which is flushed into the database
+// by whichever worker fills it up - bounding the number of live buffers - and
+// finally in FcPfn_Finalize.
 // ----------------------------------------------------------------------------
 
+#define FCPFN_SETUP_FLUSH_BUFFERS       32
+
+typedef struct tdFCPFN_SETUP_ENTRY {
+    DWORD dwPfn;
+    DWORD dwPid;
+    QWORD va;
+    BYTE tp;
+    BYTE tpex;
+    BOOL fHash;
+    BYTE pbHash[32];
+} FCPFN_SETUP_ENTRY, *PFCPFN_SETUP_ENTRY;
+
+typedef struct tdFCPFN_SETUP_BUFFER {
+    struct tdFCPFN_SETUP_BUFFER *FLink;
+    DWORD c;
+    FCPFN_SETUP_ENTRY e[];
+} FCPFN_SETUP_BUFFER, *PFCPFN_SETUP_BUFFER;
+
 typedef struct tdFCPFN_SETUP_CONTEXT {
-    BCRYPT_HASH_HANDLE hMultiHash;
+    PFCPFN_SETUP_BUFFER volatile pBufferHead;   // lock-free list of per-chunk results
+    DWORD volatile cBuffer;
+    BOOL fFail;                                 // a flush has failed (protected by LockFlush)
+    CRITICAL_SECTION LockFlush;
 } FCPFN_SETUP_CONTEXT, *PFCPFN_SETUP_CONTEXT;
 
 VOID FcPfn_InitializeClose(_Frees_ptr_opt_ PFCPFN_SETUP_CONTEXT ctx)
 {
-    if(ctx && ctx->hMultiHash) {
-        BCryptDestroyHash(ctx->hMultiHash);
+    PFCPFN_SETUP_BUFFER pBuffer;
+    if(!ctx) { return; }
+    while((pBuffer = ctx->pBufferHead)) {
+        ctx->pBufferHead = pBuffer->FLink;
+        LocalFree(pBuffer);
     }
+    DeleteCriticalSection(&ctx->LockFlush);
     LocalFree(ctx);
 }
 
+/*
+* qsort comparator - order per-chunk buffers by their first pfn.
+*/
+int FcPfn_Finalize_CmpBuffer(const void *v1, const void *v2)
+{
+    PFCPFN_SETUP_BUFFER p1 = *(PFCPFN_SETUP_BUFFER*)v1;
+    PFCPFN_SETUP_BUFFER p2 = *(PFCPFN_SETUP_BUFFER*)v2;
+    return (p1->e[0].dwPfn < p2->e[0].dwPfn) ? -1 : ((p1->e[0].dwPfn > p2->e[0].dwPfn) ? 1 : 0);
+}
+
+/*
+* Merge per-chunk buffers into the pfn database table, in pfn order, in a
+* single transaction.
+* -- pBufferHead = list of buffers to merge.
+* -- cBuffer = number of buffers in pBufferHead.
+* -- return
+*/
+_Success_(return)
+BOOL FcPfn_Finalize_Merge(_In_opt_ PFCPFN_SETUP_BUFFER pBufferHead, _In_ DWORD cBuffer)
+{
+    int rc;
+    BOOL fResult = FALSE;
+    DWORD i, j;
+    PFCPFN_SETUP_ENTRY pe;
+    PFCPFN_SETUP_BUFFER *ppBuffers = NULL;
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hSqlStmt = NULL;
+    if(!cBuffer) { return TRUE; }
+    if(!(ppBuffers = LocalAlloc(0, cBuffer * sizeof(PFCPFN_SETUP_BUFFER)))) { goto fail; }
+    for(i = 0; pBufferHead && (i < cBuffer); pBufferHead = pBufferHead->FLink) {
+        ppBuffers[i++] = pBufferHead;
+    }
+    cBuffer = i;
+    qsort(ppBuffers, cBuffer, sizeof(PFCPFN_SETUP_BUFFER), FcPfn_Finalize_CmpBuffer);
+    if(!(hSql = Fc_SqlReserve())) { goto fail; }
+    rc = sqlite3_prepare_v2(hSql, "INSERT INTO pfn (pfn, tp, tpex, pid, va, hash) VALUES (?, ?, ?, ?, ?, ?);", -1, &hSqlStmt, NULL);
+    if(rc != SQLITE_OK) { goto fail; }
+    sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    for(i = 0; i < cBuffer; i++) {
+        for(j = 0; j < ppBuffers[i]->c; j++) {
+            pe = ppBuffers[i]->e + j;
+            sqlite3_reset(hSqlStmt);
+            sqlite3_bind_int(hSqlStmt, 1, pe->dwPfn);
+            sqlite3_bind_int(hSqlStmt, 2, pe->tp);
+            sqlite3_bind_int(hSqlStmt, 3, pe->tpex);
+            sqlite3_bind_int(hSqlStmt, 4, pe->dwPid);
+            sqlite3_bind_int64(hSqlStmt, 5, pe->va);
+            if(pe->fHash) {
+                sqlite3_bind_blob(hSqlStmt, 6, pe->pbHash, 32, NULL);
+            } else {
+                sqlite3_bind_null(hSqlStmt, 6);
+            }
+            sqlite3_step(hSqlStmt);
+        }
+    }
+    sqlite3_exec(hSql, "COMMIT TRANSACTION", NULL, NULL, NULL);
+    fResult = TRUE;
+fail:
+    sqlite3_finalize(hSqlStmt);
+    Fc_SqlReserveReturn(hSql);
+    Fc_SqlMemorySpillCheck();
+    LocalFree(ppBuffers);
+    return fResult;
+}
+
+/*
+* Detach the pending per-chunk buffers from the lock-free list and merge them
+* into the database. Caller must hold ctx->LockFlush.
+* -- ctx
+*/
+VOID FcPfn_Flush(_In_ PFCPFN_SETUP_CONTEXT ctx)
+{
+    DWORD cBuffer = 0;
+    PFCPFN_SETUP_BUFFER pBuffer, pBufferHead;
+    pBufferHead = InterlockedExchangePointer((PVOID volatile*)&ctx->pBufferHead, NULL);
+    for(pBuffer = pBufferHead; pBuffer; pBuffer = pBuffer->FLink) {
+        cBuffer++;
+    }
+    InterlockedExchangeAdd((PLONG)&ctx->cBuffer, -(LONG)cBuffer);
+    if(!ctx->fFail && !FcPfn_Finalize_Merge(pBufferHead, cBuffer)) {
+        ctx->fFail = TRUE;
+    }
+    while((pBuffer = pBufferHead)) {
+        pBufferHead = pBuffer->FLink;
+        LocalFree(pBuffer);
+    }
+}
+
 VOID FcPfn_Finalize(_In_opt_ PVOID pvSetupContextPfn, _In_ BOOL fScanSuccess)
 {
-    FcPfn_InitializeClose((PFCPFN_SETUP_CONTEXT)pvSetupContextPfn);
-    ctxFc->fEnablePfn = fScanSuccess;
+    PFCPFN_SETUP_CONTEXT ctx = (PFCPFN_SETUP_CONTEXT)pvSetupContextPfn;
+    if(ctx && fScanSuccess) {
+        EnterCriticalSection(&ctx->LockFlush);
+        FcPfn_Flush(ctx);
+        LeaveCriticalSection(&ctx->LockFlush);
+    }
+    ctxFc->fEnablePfn = ctx && fScanSuccess && !ctx->fFail;
+    FcPfn_InitializeClose(ctx);
 }
 
 /*
@@ -293,92 +864,82 @@ VOID FcPfn_Finalize(_In_opt_ PVOID pvSetupContextPfn, _In_ BOOL fScanSuccess)
 */
 PVOID FcPfn_Initialize()
 {
-    NTSTATUS nt;
-    PFCPFN_SETUP_CONTEXT ctx = NULL;
-    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(FCPFN_SETUP_CONTEXT)))) { goto fail; }
-    // CREATE BCRYPT MULTI HASH
-    nt = BCryptCreateMultiHash(
-        BCRYPT_SHA256_ALG_HANDLE,
-        &ctx->hMultiHash,
-        FC_PHYSMEM_NUM_CHUNKS,
-        NULL,
-        0,
-        NULL,
-        0,
-        BCRYPT_HASH_REUSABLE_FLAG
-    );
-    if(nt != STATUS_SUCCESS) { goto fail; }
+    PFCPFN_SETUP_CONTEXT ctx;
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(FCPFN_SETUP_CONTEXT)))) { return NULL; }
+    InitializeCriticalSection(&ctx->LockFlush);
     return ctx;
-fail:
-    FcPfn_InitializeClose(ctx);
-    return NULL;
 }
 
 /*
-* Analyze a POB_FC_SCANPHYSMEM_CHUNK 16MB memory chunk for MFT file candidates
-* and add any found to the internal data sets. This function is meant to be
-* called asynchronously by a worker thread (VmmWork). This function is thread-safe.
+* Hash the pages of a POB_FC_SCANPHYSMEM_CHUNK memory chunk and aggregate the
+* resulting pfn rows into a private buffer which is merged into the database
+* by the worker filling up the pending list, or by FcPfn_Finalize. This function
+* is meant to be called asynchronously by a worker thread (VmmWork). This
+* function is thread-safe.
 * -- pc
 */
 VOID FcPfn_Setup_ThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc)
 {
     PFCPFN_SETUP_CONTEXT ctx = (PFCPFN_SETUP_CONTEXT)pc->ctx_PFN;
+    BCRYPT_HASH_HANDLE hMultiHash = NULL;
     BCRYPT_MULTI_HASH_OPERATION *pMultiFinishOps, *pMultiHashOps = NULL;
-    PBYTE pbMultiHash = NULL;
-    DWORD i, iHash = 0;
+    PFCPFN_SETUP_BUFFER pBuffer = NULL;
+    PFCPFN_SETUP_ENTRY pe;
+    DWORD i, iHash = 0, cEntry;
     NTSTATUS nt;
-    int rc;
-    sqlite3 *hSql = NULL;
-    sqlite3_stmt *hSqlStmt = NULL;
     PMMPFN_MAP_ENTRY pePfn;
-    // 1: INITIALIZE HASHING
-    if(!(pbMultiHash = LocalAlloc(0, 32 * FC_PHYSMEM_NUM_CHUNKS))) { goto fail; }
-    if(!(pMultiHashOps = LocalAlloc(0, 2 * FC_PHYSMEM_NUM_CHUNKS * sizeof(BCRYPT_MULTI_HASH_OPERATION)))) { goto fail; }
-    pMultiFinishOps = pMultiHashOps + FC_PHYSMEM_NUM_CHUNKS;
-    for(i = 0; i < FC_PHYSMEM_NUM_CHUNKS; i++) {
-        if((pc->ppMEMs[i]->qwA != (QWORD)-1) && pc->ppMEMs[i]->f && (pc->ppMEMs[i]->cb == 0x1000)) {
+    if(!pc->pPfnMap || !pc->pPfnMap->cMap) { return; }
+    cEntry = min(pc->cMEMs, pc->pPfnMap->cMap);
+    // 1: INITIALIZE BUFFER & HASHING
+    if(!(pBuffer = LocalAlloc(0, sizeof(FCPFN_SETUP_BUFFER) + cEntry * sizeof(FCPFN_SETUP_ENTRY)))) { goto fail; }
+    if(!(pMultiHashOps = LocalAlloc(0, 2ULL * cEntry * sizeof(BCRYPT_MULTI_HASH_OPERATION)))) { goto fail; }
+    pMultiFinishOps = pMultiHashOps + cEntry;
+    nt = BCryptCreateMultiHash(BCRYPT_SHA256_ALG_HANDLE, &hMultiHash, cEntry, NULL, 0, NULL, 0, 0);
+    if(nt != STATUS_SUCCESS) { goto fail; }
+    for(i = 0; i < cEntry; i++) {
+        pePfn = pc->pPfnMap->pMap + i;
+        pe = pBuffer->e + i;
+        pe->dwPfn = pePfn->dwPfn;
+        pe->dwPid = pePfn->AddressInfo.dwPid;
+        pe->va = pePfn->AddressInfo.va;
+        pe->tp = (BYTE)pePfn->PageLocation;
+        pe->tpex = (BYTE)pePfn->tpExtended;
+        pe->fHash = (pc->ppMEMs[i]->qwA != (QWORD)-1) && pc->ppMEMs[i]->f && (pc->ppMEMs[i]->cb == 0x1000);
+        if(pe->fHash) {
             pMultiHashOps[iHash].iHash = iHash;
             pMultiHashOps[iHash].hashOperation = BCRYPT_OPERATION_TYPE_HASH;
             pMultiHashOps[iHash].pbBuffer = pc->ppMEMs[i]->pb;
             pMultiHashOps[iHash].cbBuffer = 0x1000;
             pMultiFinishOps[iHash].iHash = iHash;
             pMultiFinishOps[iHash].hashOperation = BCRYPT_HASH_OPERATION_FINISH_HASH;
-            pMultiFinishOps[iHash].pbBuffer = pbMultiHash + 32ULL * i;
+            pMultiFinishOps[iHash].pbBuffer = pe->pbHash;
             pMultiFinishOps[iHash].cbBuffer = 32;
             iHash++;
         }
     }
+    pBuffer->c = cEntry;
     // 2: HASH
-    nt = BCryptProcessMultiOperations(ctx->hMultiHash, BCRYPT_OPERATION_TYPE_HASH, pMultiHashOps, iHash * sizeof(BCRYPT_MULTI_HASH_OPERATION), 0);
-    if(nt != STATUS_SUCCESS) { goto fail; }
-    nt = BCryptProcessMultiOperations(ctx->hMultiHash, BCRYPT_OPERATION_TYPE_HASH, pMultiFinishOps, iHash * sizeof(BCRYPT_MULTI_HASH_OPERATION), 0);
-    if(nt != STATUS_SUCCESS) { goto fail; }
-    // 3: INSERT INTO DATABASE
-    if(!(hSql = Fc_SqlReserve())) { goto fail; }
-    rc = sqlite3_prepare_v2(hSql, "INSERT INTO pfn (pfn, tp, tpex, pid, va, hash) VALUES (?, ?, ?, ?, ?, ?);", -1, &hSqlStmt, NULL);
-    if(rc != SQLITE_OK) { goto fail; }
-    sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL);
-    for(i = 0; i < pc->pPfnMap->cMap; i++) {
-        pePfn = pc->pPfnMap->pMap + i;
-        sqlite3_reset(hSqlStmt);
-        sqlite3_bind_int(hSqlStmt, 1, pePfn->dwPfn);
-        sqlite3_bind_int(hSqlStmt, 2, pePfn->PageLocation);
-        sqlite3_bind_int(hSqlStmt, 3, pePfn->tpExtended);
-        sqlite3_bind_int(hSqlStmt, 4, pePfn->AddressInfo.dwPid);
-        sqlite3_bind_int64(hSqlStmt, 5, pePfn->AddressInfo.va);
-        if((pc->ppMEMs[i]->qwA != (QWORD)-1) && pc->ppMEMs[i]->f && (pc->ppMEMs[i]->cb == 0x1000)) {
-            sqlite3_bind_blob(hSqlStmt, 6, pbMultiHash + 32ULL * i, 32, NULL);
-        } else {
-            sqlite3_bind_null(hSqlStmt, 6);
-        }
-        sqlite3_step(hSqlStmt);
+    if(iHash) {
+        nt = BCryptProcessMultiOperations(hMultiHash, BCRYPT_OPERATION_TYPE_HASH, pMultiHashOps, iHash * sizeof(BCRYPT_MULTI_HASH_OPERATION), 0);
+        if(nt != STATUS_SUCCESS) { goto fail; }
+        nt = BCryptProcessMultiOperations(hMultiHash, BCRYPT_OPERATION_TYPE_HASH, pMultiFinishOps, iHash * sizeof(BCRYPT_MULTI_HASH_OPERATION), 0);
+        if(nt != STATUS_SUCCESS) { goto fail; }
+    }
+    // 3: PUSH BUFFER ONTO LOCK-FREE RESULT LIST
+    do {
+        pBuffer->FLink = ctx->pBufferHead;
+    } while(InterlockedCompareExchangePointer((PVOID volatile*)&ctx->pBufferHead, pBuffer, pBuffer->FLink) != pBuffer->FLink);
+    pBuffer = NULL;
+    // 4: FLUSH PENDING BUFFERS INTO DATABASE IF LIST IS FULL (unless another
+    //    worker is already flushing).
+    if((InterlockedIncrement(&ctx->cBuffer) >= FCPFN_SETUP_FLUSH_BUFFERS) && TryEnterCriticalSection(&ctx->LockFlush)) {
+        FcPfn_Flush(ctx);
+        LeaveCriticalSection(&ctx->LockFlush);
     }
-    sqlite3_exec(hSql, "COMMIT TRANSACTION", NULL, NULL, NULL);
 fail:
-    sqlite3_finalize(hSqlStmt);
-    Fc_SqlReserveReturn(hSql);
+    if(hMultiHash) { BCryptDestroyHash(hMultiHash); }
     LocalFree(pMultiHashOps);
-    LocalFree(pbMultiHash);
+    LocalFree(pBuffer);
 }
 
 
@@ -406,25 +967,125 @@ VOID FcWinReg_Initialize_CallbackAddEntry(_In_ HANDLE hCallback1, _In_ HANDLE hC
     sqlite3_step(hStmt);
 }
 
+/*
+* Context for parallel registry hive snapshots. Hives are sorted largest first
+* and claimed through pObWork by worker threads and by the forensic thread. The
+* forensic thread inserts each hive into the database once its snapshot state
+* is set to ready - hEventReady is set on each snapshot completion.
+*/
+typedef struct tdFCOB_WINREG_PARALLEL {
+    OB ObHdr;
+    HANDLE hEventReady;
+    DWORD c;
+    PVMMOB_WORK_PARALLEL pObWork;
+    POB_REGISTRY_HIVE *ppObHive;
+    volatile BYTE *pbState;     // FCWINREG_STATE_*
+} FCOB_WINREG_PARALLEL, *PFCOB_WINREG_PARALLEL;
+
+#define FCWINREG_STATE_PENDING      0
+#define FCWINREG_STATE_READY        1
+#define FCWINREG_STATE_INSERTED     2
+
+VOID FcWinReg_Parallel_CloseObCallback(_In_ PVOID pOb)
+{
+    DWORD i;
+    PFCOB_WINREG_PARALLEL ctx = (PFCOB_WINREG_PARALLEL)pOb;
+    VmmWorkParallel_Finish(ctx->pObWork);
+    if(ctx->hEventReady) { CloseHandle(ctx->hEventReady); }
+    if(ctx->ppObHive) {
+        for(i = 0; i < ctx->c; i++) {
+            Ob_DECREF(ctx->ppObHive[i]);
+        }
+        LocalFree(ctx->ppObHive);
+    }
+    LocalFree((PBYTE)ctx->pbState);
+}
+
+int FcWinReg_Parallel_CmpSort(POB_REGISTRY_HIVE *pp1, POB_REGISTRY_HIVE *pp2)
+{
+    return ((*pp1)->cbLength < (*pp2)->cbLength) ? 1 : (((*pp1)->cbLength > (*pp2)->cbLength) ? -1 : 0);
+}
+
+/*
+* Snapshot one claimed hive.
+* -- ctx
+* -- i
+*/
+VOID FcWinReg_Parallel_Item(_In_ PFCOB_WINREG_PARALLEL ctx, _In_ DWORD i)
+{
+    VmmWinReg_HiveSnapshotEnsureFull(ctx->ppObHive[i]);
+    ctx->pbState[i] = FCWINREG_STATE_READY;
+    SetEvent(ctx->hEventReady);
+}
+
+/*
+* Create the parallel hive snapshot context and start worker threads on the
+* work thread pool. If no workers are started the hives are snapshotted one
+* by one by the caller through VmmWorkParallel_ClaimOne. The worker threads
+* are waited for when the context is released.
+* CALLER DECREF: return
+* -- return
+*/
+PFCOB_WINREG_PARALLEL FcWinReg_Parallel_Start()
+{
+    DWORD cMax;
+    PFCOB_WINREG_PARALLEL pObCtx;
+    POB_REGISTRY_HIVE pObHive = NULL;
+    if(!(pObCtx = Ob_Alloc(OB_TAG_FC_WINREG_PARALLEL, LMEM_ZEROINIT, sizeof(FCOB_WINREG_PARALLEL), FcWinReg_Parallel_CloseObCallback, NULL))) { return NULL; }
+    cMax = VmmWinReg_HiveCount();
+    if(!(pObCtx->hEventReady = CreateEvent(NULL, FALSE, FALSE, NULL))) { goto fail; }
+    if(!(pObCtx->ppObHive = LocalAlloc(LMEM_ZEROINIT, (cMax + 1) * sizeof(POB_REGISTRY_HIVE)))) { goto fail; }
+    if(!(pObCtx->pbState = LocalAlloc(LMEM_ZEROINIT, cMax + 1))) { goto fail; }
+    while((pObHive = VmmWinReg_HiveGetNext(pObHive)) && (pObCtx->c < cMax)) {
+        pObCtx->ppObHive[pObCtx->c++] = Ob_INCREF(pObHive);
+    }
+    Ob_DECREF_NULL(&pObHive);
+    qsort(pObCtx->ppObHive, pObCtx->c, sizeof(POB_REGISTRY_HIVE), (_CoreCrtNonSecureSearchSortCompareFunction)FcWinReg_Parallel_CmpSort);
+    if(!(pObCtx->pObWork = VmmWorkParallel_Start(pObCtx->c, FC_WINREG_PARALLEL_THREADS, (VOID(*)(PVOID, DWORD))FcWinReg_Parallel_Item, pObCtx))) { goto fail; }
+    return pObCtx;
+fail:
+    Ob_DECREF(pObCtx);
+    return NULL;
+}
+
+/*
+* Ingest all registry keys into the database. The expensive part - reading
+* and indexing of the hives - takes place in parallel on the work thread pool
+* with the largest hives started first. Database inserts are made on a single
+* connection as ready hives become available since the database only allows
+* a single writer - ingestion time is bounded by the largest hive.
+* -- return
+*/
 _Success_(return)
 BOOL FcWinReg_Initialize()
 {
+    DWORD i, cInserted = 0;
     BOOL fResult = FALSE;
-    POB_REGISTRY_HIVE pObHive = NULL;
+    PFCOB_WINREG_PARALLEL pObCtx = NULL;
     sqlite3 *hSql = NULL;
     sqlite3_stmt *hStmt = NULL, *hStmtStr = NULL;
     if(!(hSql = Fc_SqlReserve())) { goto fail; }
     if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO registry (id_str, hive, cell, cell_parent, time) VALUES (?, ?, ?, ?, ?);", -1, &hStmt, NULL)) { goto fail; }
     if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO str (id, osz, csz, cbu, cbj, sz) VALUES (?, ?, ?, ?, ?, ?);", -1, &hStmtStr, NULL)) { goto fail; }
+    if(!(pObCtx = FcWinReg_Parallel_Start())) { goto fail; }
     sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL);
-    while(pObHive = VmmWinReg_HiveGetNext(pObHive)) {
-        VmmWinReg_ForensicGetAllKeys(pObHive, hStmt, hStmtStr, FcWinReg_Initialize_CallbackAddEntry);
+    while(cInserted < pObCtx->c) {
+        for(i = 0; i < pObCtx->c; i++) {
+            if(pObCtx->pbState[i] == FCWINREG_STATE_READY) {
+                VmmWinReg_ForensicGetAllKeys(pObCtx->ppObHive[i], hStmt, hStmtStr, FcWinReg_Initialize_CallbackAddEntry);
+                pObCtx->pbState[i] = FCWINREG_STATE_INSERTED;
+                cInserted++;
+            }
+        }
+        if((cInserted < pObCtx->c) && !VmmWorkParallel_ClaimOne(pObCtx->pObWork)) {
+            WaitForSingleObject(pObCtx->hEventReady, INFINITE);
+        }
     }
     sqlite3_exec(hSql, "COMMIT TRANSACTION", NULL, NULL, NULL);
     ctxFc->fEnableRegistry = TRUE;
     fResult = TRUE;
 fail:
-    Ob_DECREF(pObHive);
+    Ob_DECREF(pObCtx);
     sqlite3_finalize(hStmt);
     sqlite3_finalize(hStmtStr);
     Fc_SqlReserveReturn(hSql);
@@ -495,25 +1156,69 @@ fail_transact:
     goto fail;
 }
 
+/*
+* Parallel part of the thread initialization - build the (cached) thread map of
+* a single process. Database inserts are done afterwards in one transaction.
+*/
 VOID FcThread_ThreadProc(_In_ PVMM_PROCESS pProcess, _In_ PVOID pv)
+{
+    PVMMOB_MAP_THREAD pObThreadMap = NULL;
+    VmmMap_GetThread(pProcess, &pObThreadMap);
+    Ob_DECREF(pObThreadMap);
+}
+
+/*
+* Resolve the kernel symbols of the thread start addresses of a thread map in
+* one batch lookup. Only start addresses inside the kernel image are resolved.
+* CALLER LocalFree: return
+* -- pThreadMap
+* -- return = array of pThreadMap->cMap symbols, or NULL on fail.
+*/
+PPDB_SYMBOLNAME FcThread_StartSymbols(_In_ PVMMOB_MAP_THREAD pThreadMap)
+{
+    DWORD i;
+    QWORD va;
+    PPDB_SYMBOLNAME pSymbols;
+    if(!pThreadMap->cMap || !(pSymbols = LocalAlloc(LMEM_ZEROINIT, pThreadMap->cMap * sizeof(PDB_SYMBOLNAME)))) { return NULL; }
+    for(i = 0; i < pThreadMap->cMap; i++) {
+        va = pThreadMap->pMap[i].vaStartAddress;
+        if((va > ctxVmm->kernel.vaBase) && (va < ctxVmm->kernel.vaBase + ctxVmm->kernel.cbSize)) {
+            pSymbols[i].dwSymbolOffset = (DWORD)(va - ctxVmm->kernel.vaBase);
+        }
+    }
+    PDB_GetSymbolFromOffsetBatch(PDB_HANDLE_KERNEL, pSymbols, pThreadMap->cMap);
+    return pSymbols;
+}
+
+/*
+* Insert all threads of a single process into the 'thread' table using the
+* already prepared statements and the already open transaction.
+* -- pProcess
+* -- hStmt
+* -- hStmtStr
+* -- return
+*/
+_Success_(return)
+BOOL FcThread_InsertProcess(_In_ PVMM_PROCESS pProcess, _In_ sqlite3_stmt *hStmt, _In_ sqlite3_stmt *hStmtStr)
 {
     int rc;
-    sqlite3 *hSql = NULL;
-    sqlite3_stmt *hStmt = NULL, *hStmtStr = NULL;
+    BOOL fResult = FALSE;
     DWORD i;
     PVMMOB_MAP_THREAD pObThreadMap = NULL;
     PVMM_MAP_THREADENTRY pe;
+    PPDB_SYMBOLNAME pSymbols = NULL;
     WCHAR wszStr[MAX_PATH];
     FCSQL_INSERTSTRTABLE SqlStrInsert;
     if(!VmmMap_GetThread(pProcess, &pObThreadMap)) { goto fail; }
-    if(!(hSql = Fc_SqlReserve())) { goto fail; }
-    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO thread (id_str, pid, tid, ethread, teb, state, exitstatus, running, prio, priobase, startaddr, stackbase_u, stacklimit_u, stackbase_k, stacklimit_k, trapframe, sp, ip, time_create, time_exit) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);", -1, &hStmt, NULL)) { goto fail; }
-    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO str (id, osz, csz, cbu, cbj, sz) VALUES (?, ?, ?, ?, ?, ?);", -1, &hStmtStr, NULL)) { goto fail; }
-    sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    pSymbols = FcThread_StartSymbols(pObThreadMap);
     for(i = 0; i < pObThreadMap->cMap; i++) {
         pe = pObThreadMap->pMap + i;
-        swprintf(wszStr, _countof(wszStr), L"TID: %i", pe->dwTID);
-        if(!Fc_SqlInsertStr(hStmtStr, wszStr, 0, &SqlStrInsert)) { goto fail_transact; }
+        if(pSymbols && pSymbols[i].dwSymbolOffset && pSymbols[i].fResult) {
+            swprintf(wszStr, _countof(wszStr), L"TID: %i [nt!%.200S+%x]", pe->dwTID, pSymbols[i].szSymbolName, pSymbols[i].dwSymbolDisplacement);
+        } else {
+            swprintf(wszStr, _countof(wszStr), L"TID: %i", pe->dwTID);
+        }
+        if(!Fc_SqlInsertStr(hStmtStr, wszStr, 0, &SqlStrInsert)) { goto fail; }
         sqlite3_reset(hStmt);
         rc = Fc_SqlBindMultiInt64(hStmt, 1, 20,
             SqlStrInsert.id,
@@ -537,25 +1242,45 @@ VOID FcThread_ThreadProc(_In_ PVMM_PROCESS pProcess, _In_ PVOID pv)
             pe->ftCreateTime,
             pe->ftExitTime
         );
-        if(SQLITE_OK != rc) { goto fail_transact; }
+        if(SQLITE_OK != rc) { goto fail; }
         sqlite3_step(hStmt);
     }
-fail_transact:
-    sqlite3_exec(hSql, "COMMIT TRANSACTION", NULL, NULL, NULL);
+    fResult = TRUE;
 fail:
-    sqlite3_finalize(hStmt);
-    sqlite3_finalize(hStmtStr);
-    Fc_SqlReserveReturn(hSql);
+    LocalFree(pSymbols);
     Ob_DECREF(pObThreadMap);
-    return;
+    return fResult;
 }
 
 _Success_(return)
 BOOL FcThread_Initialize()
 {
+    BOOL fResult = FALSE;
+    PVMM_PROCESS pObProcess = NULL;
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hStmt = NULL, *hStmtStr = NULL;
+    // 1: build thread maps of all processes in one batched pass - processes
+    //    skipped by it (being initialized elsewhere) are waited for in parallel.
+    VmmWinThread_InitializeAll(NULL, NULL);
     VmmProcessActionForeachParallel(NULL, VmmProcessActionForeachParallel_CriteriaActiveOnly, FcThread_ThreadProc);
+    // 2: insert all threads in a single transaction.
+    if(!(hSql = Fc_SqlReserve())) { goto fail; }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO thread (id_str, pid, tid, ethread, teb, state, exitstatus, running, prio, priobase, startaddr, stackbase_u, stacklimit_u, stackbase_k, stacklimit_k, trapframe, sp, ip, time_create, time_exit) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);", -1, &hStmt, NULL)) { goto fail; }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO str (id, osz, csz, cbu, cbj, sz) VALUES (?, ?, ?, ?, ?, ?);", -1, &hStmtStr, NULL)) { goto fail; }
+    sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    while((pObProcess = VmmProcessGetNext(pObProcess, VMM_FLAG_PROCESS_SHOW_TERMINATED))) {
+        if(VmmProcessActionForeachParallel_CriteriaActiveOnly(pObProcess, NULL)) {
+            FcThread_InsertProcess(pObProcess, hStmt, hStmtStr);
+        }
+    }
+    sqlite3_exec(hSql, "COMMIT TRANSACTION", NULL, NULL, NULL);
     ctxFc->fEnableThread = TRUE;
-    return TRUE;
+    fResult = TRUE;
+fail:
+    sqlite3_finalize(hStmt);
+    sqlite3_finalize(hStmtStr);
+    Fc_SqlReserveReturn(hSql);
+    return fResult;
 }
 
 
@@ -566,115 +1291,210 @@ BOOL FcThread_Initialize()
 // the physical memory consumers are:
 // - PFN / HASH
 // - NTFS MFT ANALYZE
+// - PATTERN SCAN (if patterns are configured)
 // ----------------------------------------------------------------------------
 
 VOID FcScanPhysMem_CallbackCleanup_ObChunk(POB_FC_SCANPHYSMEM_CHUNK pOb)
 {
-    for(DWORD i = 0; i < sizeof(pOb->hEventFinish) / sizeof(HANDLE); i++) {
-        if(pOb->hEventFinish[i]) {
-            CloseHandle(pOb->hEventFinish[i]);
-        }
+    if(pOb->hEventFinish) {
+        CloseHandle(pOb->hEventFinish);
     }
+    Ob_DECREF(pOb->pPfnMap);
     LcMemFree(pOb->ppMEMs);
 }
 
 /*
-* Physical Memory Scan Loop - function is meant to be running in asynchronously
-* with one thread calling only. The function allocates two 16MB chunks and will
-* begin to loop-read physical memory into a chunk, call consumers asynchronously
-* and continue to read next 16MB chunk (if consumers are finished processing).
+* Read and process a single physical memory scan chunk. This function is meant
+* to be called by a worker thread (VmmWork) - multiple chunks are processed in
+* parallel, each by its own worker, which calls all consumers in turn.
 * Currently the consumers are:
 * - NTFS MFT SCAN
-* - SHA256 PAGE HASHING
+* - SHA256 PAGE HASHING / PFN
+* - MULTI-PATTERN SCAN
+* -- pc
 */
-VOID FcScanPhysMem()
+VOID FcScanPhysMem_ChunkThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc)
 {
-    BOOL fValidMEMs, fValidAddr, fScanSuccess = FALSE;
-    QWORD i, j, iChunk = 0, pa, paBase;
-    POB_FC_SCANPHYSMEM_CHUNK pc, pObScanChunk[2] = { 0 };
-    PVOID ctx_Pfn = NULL, ctx_Ntfs = NULL;
+    BOOL fValidMEMs, fValidAddr;
+    QWORD i, pa, cbRead = 0, tmStart, tmRead, tmPfn, tmNtfs, tmPattern;
     PMMPFN_MAP_ENTRY pePfn;
-    // 1: initialize two 16MB physical memory scan chunks
-    for(i = 0; i < 2; i++) {
-        if(!(pObScanChunk[i] = Ob_Alloc('FSCN', LMEM_ZEROINIT, sizeof(OB_FC_SCANPHYSMEM_CHUNK), FcScanPhysMem_CallbackCleanup_ObChunk, NULL))) { goto fail; }
-        if(!LcAllocScatter1(FC_PHYSMEM_NUM_CHUNKS, &pObScanChunk[i]->ppMEMs)) { goto fail; }
-        for(j = 0; j < FC_PHYSMEMSCAN_CONSUMERS; j++) {
-            if(!(pObScanChunk[i]->hEventFinish[j] = CreateEvent(NULL, TRUE, TRUE, NULL))) { goto fail; }
+    PFC_SCANPHYSMEM_STATISTICS pStat = &ctxFc->ScanPhysMemStat;
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmStart);
+    // 1: init pfn map
+    Ob_DECREF_NULL(&pc->pPfnMap);
+    MmPfn_Map_GetPfn((DWORD)(pc->paBase >> 12), pc->cMEMs, &pc->pPfnMap, TRUE);
+    // 2: init addresses & read
+    for(i = 0, fValidMEMs = FALSE; i < pc->cMEMs; i++) {
+        pa = pc->paBase + (i << 12);
+        fValidAddr = (pa <= ctxMain->dev.paMax);
+        if(fValidAddr) {
+            pePfn = (pc->pPfnMap && (i < pc->pPfnMap->cMap)) ? (pc->pPfnMap->pMap + i) : NULL;
+            fValidAddr =
+                !pePfn ||
+                (pePfn->PageLocation == MmPfnTypeStandby) ||
+                (pePfn->PageLocation == MmPfnTypeModified) ||
+                (pePfn->PageLocation == MmPfnTypeModifiedNoWrite) ||
+                (pePfn->PageLocation == MmPfnTypeTransition) ||
+                (pePfn->PageLocation == MmPfnTypeActive);
+        }
+        pc->ppMEMs[i]->qwA = fValidAddr ? pa : (QWORD)-1;
+        pc->ppMEMs[i]->cb = 0x1000;
+        pc->ppMEMs[i]->f = FALSE;
+        fValidMEMs = fValidMEMs || fValidAddr;
+    }
+    if(fValidMEMs) {
+        VmmReadScatterPhysical(pc->ppMEMs, pc->cMEMs, VMM_FLAG_NOCACHEPUT | VMM_FLAG_PRIORITY_BULK);
+        for(i = 0; i < pc->cMEMs; i++) {
+            if(pc->ppMEMs[i]->f) { cbRead += 0x1000; }
         }
     }
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmRead);
+    if(!ctxVmm->Work.fEnabled) { return; }
+    // 3: call consumers
+    if(pc->ctx_PFN) {
+        FcPfn_Setup_ThreadProc(pc);
+    }
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmPfn);
+    if(pc->ctx_NTFS) {
+        FcNtfs_Setup_ThreadProc(pc);
+    }
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmNtfs);
+    if(pc->ctx_PATTERN) {
+        FcPattern_Setup_ThreadProc(pc);
+    }
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmPattern);
+    InterlockedIncrement64(&pStat->cChunks);
+    InterlockedAdd64(&pStat->cbRead, cbRead);
+    InterlockedAdd64(&pStat->tmRead, tmRead - tmStart);
+    InterlockedAdd64(&pStat->tmPfn, tmPfn - tmRead);
+    InterlockedAdd64(&pStat->tmNtfs, tmNtfs - tmPfn);
+    InterlockedAdd64(&pStat->tmPattern, tmPattern - tmNtfs);
+}
+
+/*
+* Retrieve the physical memory scan statistics as a human readable text.
+* -- sz = buffer to receive text, or NULL to retrieve required size.
+* -- cch
+* -- return = number of chars (excl. NULL) written, or required.
+*/
+DWORD FcScanPhysMem_StatisticsText(_Out_writes_opt_(cch) LPSTR sz, _In_ DWORD cch)
+{
+    QWORD qwFreq, cMsRead, cMsPfn, cMsNtfs, cMsPattern, cMsWall, cMsIndex, cMB;
+    PFC_SCANPHYSMEM_STATISTICS pStat;
+    CHAR szBuffer[0x200];
+    int o;
+    if(!ctxFc) { return 0; }
+    pStat = &ctxFc->ScanPhysMemStat;
+    QueryPerformanceFrequency((PLARGE_INTEGER)&qwFreq);
+    cMsRead = pStat->tmRead * 1000 / qwFreq;
+    cMsPfn = pStat->tmPfn * 1000 / qwFreq;
+    cMsNtfs = pStat->tmNtfs * 1000 / qwFreq;
+    cMsPattern = pStat->tmPattern * 1000 / qwFreq;
+    cMsWall = pStat->tmWall * 1000 / qwFreq;
+    cMsIndex = pStat->tmIndex * 1000 / qwFreq;
+    cMB = pStat->cbRead >> 20;
+    o = snprintf(
+        szBuffer,
+        sizeof(szBuffer),
+        "PHYSICAL MEMORY SCAN STATISTICS:\n" \
+        "  PIPELINE: %i chunks x %i MB\n" \
+        "  CHUNKS:   %lli\n" \
+        "  READ:     %lli MB  %lli ms  %lli MB/s (per worker)\n" \
+        "  PFN:      %lli ms  %lli MB/s (per worker)\n" \
+        "  NTFS:     %lli ms  %lli MB/s (per worker)\n" \
+        "  PATTERN:  %lli ms  %lli MB/s (per worker)\n" \
+        "  TOTAL:    %lli ms  %lli MB/s\n" \
+        "  INDEX:    %lli ms (deferred, after ingestion)\n",
+        pStat->cChunksInFlight, pStat->cPagesChunk >> 8,
+        pStat->cChunks,
+        cMB, cMsRead, cMsRead ? (cMB * 1000 / cMsRead) : 0,
+        cMsPfn, cMsPfn ? (cMB * 1000 / cMsPfn) : 0,
+        cMsNtfs, cMsNtfs ? (cMB * 1000 / cMsNtfs) : 0,
+        cMsPattern, cMsPattern ? (cMB * 1000 / cMsPattern) : 0,
+        cMsWall, cMsWall ? (cMB * 1000 / cMsWall) : 0,
+        cMsIndex
+    );
+    if(o < 0) { return 0; }
+    if(sz && cch) {
+        strncpy_s(sz, cch, szBuffer, _TRUNCATE);
+    }
+    return (DWORD)o;
+}
+
+/*
+* Physical Memory Scan Loop - function is meant to be running in asynchronously
+* with one thread calling only. The function allocates a configurable number of
+* chunks of configurable size (VMMDLL_OPT_FORENSIC_SCAN_*). Each chunk is read
+* and handed to its consumers by a worker thread - multiple chunks are read and
+* processed in parallel. This loop only dispatches chunks to workers once the
+* previous use of the chunk has finished.
+* -- return = TRUE if the whole physical address space was scanned.
+*/
+_Success_(return)
+BOOL FcScanPhysMem()
+{
+    BOOL fScanSuccess = FALSE;
+    DWORD i, cChunks, cPagesChunk;
+    QWORD iChunk = 0, paBase, tmStart, tmEnd;
+    POB_FC_SCANPHYSMEM_CHUNK pc, pObScanChunk[FC_PHYSMEMSCAN_CHUNKS_MAX] = { 0 };
+    PVOID ctx_Pfn = NULL, ctx_Ntfs = NULL, ctx_Pattern = NULL;
+    cChunks = ctxMain->cfg.cFcScanChunks ? min(FC_PHYSMEMSCAN_CHUNKS_MAX, max(2, ctxMain->cfg.cFcScanChunks)) : FC_PHYSMEMSCAN_CHUNKS_DEFAULT;
+    cPagesChunk = ctxMain->cfg.cMBFcScanChunk ? min(FC_PHYSMEMSCAN_CHUNK_PAGES_MAX, max(FC_PHYSMEMSCAN_CHUNK_PAGES_MIN, ctxMain->cfg.cMBFcScanChunk << 8)) : FC_PHYSMEM_NUM_CHUNKS;
+    ZeroMemory(&ctxFc->ScanPhysMemStat, sizeof(FC_SCANPHYSMEM_STATISTICS));
+    ctxFc->ScanPhysMemStat.cChunksInFlight = cChunks;
+    ctxFc->ScanPhysMemStat.cPagesChunk = cPagesChunk;
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmStart);
+    // 1: initialize physical memory scan chunks
+    for(i = 0; i < cChunks; i++) {
+        if(!(pObScanChunk[i] = Ob_Alloc('FSCN', LMEM_ZEROINIT, sizeof(OB_FC_SCANPHYSMEM_CHUNK), FcScanPhysMem_CallbackCleanup_ObChunk, NULL))) { goto fail; }
+        if(!LcAllocScatter1(cPagesChunk, &pObScanChunk[i]->ppMEMs)) { goto fail; }
+        if(!(pObScanChunk[i]->hEventFinish = CreateEvent(NULL, TRUE, TRUE, NULL))) { goto fail; }
+        pObScanChunk[i]->cMEMs = cPagesChunk;
+    }
     // 2: initialize scan consumers
     ctx_Pfn = FcPfn_Initialize();
     ctx_Ntfs = FcNtfs_SetupInitialize();
-    for(i = 0; i < 2; i++) {
+    ctx_Pattern = FcPattern_SetupInitialize();
+    for(i = 0; i < cChunks; i++) {
         pObScanChunk[i]->ctx_PFN = ctx_Pfn;
         pObScanChunk[i]->ctx_NTFS = ctx_Ntfs;
+        pObScanChunk[i]->ctx_PATTERN = ctx_Pattern;
     }
-    // 3: main physical memory scan loop
-    for(paBase = 0; paBase < ctxMain->dev.paMax; paBase += 0x1000 * FC_PHYSMEM_NUM_CHUNKS) {
+    // 3: main physical memory scan loop - dispatch chunks onto workers
+    for(paBase = 0; paBase < ctxMain->dev.paMax; paBase += 0x1000ULL * cPagesChunk) {
         vmmprintfvv_fn("PhysicalAddress=%016llx\n", paBase);
-        // 3.1: get entry and wait for previous consumers to finish
-        pc = pObScanChunk[++iChunk % 2];
-        WaitForMultipleObjects(FC_PHYSMEMSCAN_CONSUMERS, pc->hEventFinish, TRUE, INFINITE);
-        if(!ctxVmm->Work.fEnabled) { goto fail; }
-        // 3.2: init pfn map
-        Ob_DECREF_NULL(&pc->pPfnMap);
-        MmPfn_Map_GetPfn((DWORD)(paBase >> 12), FC_PHYSMEM_NUM_CHUNKS, &pc->pPfnMap, TRUE);
-        // 3.3: init addresses & read
-        for(i = 0, fValidMEMs = FALSE; i < FC_PHYSMEM_NUM_CHUNKS; i++) {
-            pa = paBase + (i << 12);
-            fValidAddr = (pa <= ctxMain->dev.paMax);
-            if(fValidAddr) {
-                pePfn = (pc->pPfnMap && (i < pc->pPfnMap->cMap)) ? (pc->pPfnMap->pMap + i) : NULL;
-                fValidAddr =
-                    !pePfn ||
-                    (pePfn->PageLocation == MmPfnTypeStandby) ||
-                    (pePfn->PageLocation == MmPfnTypeModified) ||
-                    (pePfn->PageLocation == MmPfnTypeModifiedNoWrite) ||
-                    (pePfn->PageLocation == MmPfnTypeTransition) ||
-                    (pePfn->PageLocation == MmPfnTypeActive);
-            }
-            pc->ppMEMs[i]->qwA = fValidAddr ? pa : (QWORD)-1;
-            pc->ppMEMs[i]->cb = 0x1000;
-            pc->ppMEMs[i]->f = FALSE;
-            fValidMEMs = fValidMEMs || fValidAddr;
-        }
-        if(fValidMEMs) {
-            VmmReadScatterPhysical(pc->ppMEMs, FC_PHYSMEM_NUM_CHUNKS, VMM_FLAG_NOCACHEPUT);
-        }
+        // 3.1: get chunk and wait for its previous use to finish
+        pc = pObScanChunk[iChunk++ % cChunks];
+        WaitForSingleObject(pc->hEventFinish, INFINITE);
         if(!ctxVmm->Work.fEnabled) { goto fail; }
-        // 3.4: schedule work onto consumers
-        //if(pc->ctx_PFN) {
-        //    ResetEvent(pc->hEventFinish_PFN);
-        //    VmmWork((LPTHREAD_START_ROUTINE)FcPfn_Setup_ThreadProc, pc, pc->hEventFinish_PFN);
-        //}
-        if(pc->ctx_NTFS) {
-            ResetEvent(pc->hEventFinish_NTFS);
-            VmmWork((LPTHREAD_START_ROUTINE)FcNtfs_Setup_ThreadProc, pc, pc->hEventFinish_NTFS);
+        // 3.2: schedule read & consumers onto worker
+        pc->paBase = paBase;
+        ResetEvent(pc->hEventFinish);
+        if(!VmmWorkEx((LPTHREAD_START_ROUTINE)FcScanPhysMem_ChunkThreadProc, pc, pc->hEventFinish, VMMWORK_PRIORITY_NORMAL)) {
+            FcScanPhysMem_ChunkThreadProc(pc);
+            SetEvent(pc->hEventFinish);
         }
     }
     // 4: finalize scan consumers
     fScanSuccess = TRUE;
 fail:
     // 5: wait for any worker sub-threads to finish
-    for(i = 0; i < 2; i++) {
-        if(pObScanChunk[i] && pObScanChunk[i]->hEventFinish[FC_PHYSMEMSCAN_CONSUMERS - 1]) {
-            WaitForMultipleObjects(FC_PHYSMEMSCAN_CONSUMERS, pObScanChunk[i]->hEventFinish, TRUE, INFINITE);
+    for(i = 0; i < cChunks; i++) {
+        if(pObScanChunk[i] && pObScanChunk[i]->hEventFinish) {
+            WaitForSingleObject(pObScanChunk[i]->hEventFinish, INFINITE);
         }
     }
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmEnd);
+    ctxFc->ScanPhysMemStat.tmWall = tmEnd - tmStart;
     // 6: call work customer finalize functionality
     FcPfn_Finalize(ctx_Pfn, fScanSuccess);
     FcNtfs_SetupFinalize(ctx_Ntfs, fScanSuccess);
+    FcPattern_SetupFinalize(ctx_Pattern, fScanSuccess);
     // 7: clean up / close
-    for(i = 0; i < 2; i++) {
-        if(!(pc = pObScanChunk[i])) { continue; }
-        for(j = 0; j < FC_PHYSMEMSCAN_CONSUMERS; j++) {
-            if(pc->hEventFinish[j]) {
-                CloseHandle(pc->hEventFinish[j]);
-            }
-        }
-        LcMemFree(pc->ppMEMs);
-        Ob_DECREF(pc->pPfnMap);
+    for(i = 0; i < cChunks; i++) {
+        Ob_DECREF(pObScanChunk[i]);
     }
+    return fScanSuccess;
 }
 
 
@@ -688,12 +1508,52 @@ fail:
 */
 VOID FcInitialize_ThreadProc(_In_ PVOID pvContext)
 {
-    Fc_SqlInitializeDatabaseTables();
-    FcProcess_Initialize();
-    FcThread_Initialize();
-    FcWinReg_Initialize();
-    FcScanPhysMem();
-    FcTimeline_Initialize();
+    CHAR szStatistics[0x200];
+    DWORD dwPhaseReuse = ctxFc->db.dwPhaseComplete;
+    if(dwPhaseReuse) {
+        vmmprintfv("FORENSIC: Re-using previous results from database (phases: 0x%02x).\n", dwPhaseReuse);
+    }
+    Fc_SqlInitializeDatabaseTables(dwPhaseReuse);
+    if(!(dwPhaseReuse & FC_PHASE_PROCESS)) {
+        if(FcProcess_Initialize()) {
+            Fc_SqlMetaCheckpoint(FC_PHASE_PROCESS);
+        }
+    }
+    if(!(dwPhaseReuse & FC_PHASE_THREAD)) {
+        if(FcThread_Initialize()) {
+            Fc_SqlMetaCheckpoint(FC_PHASE_THREAD);
+        }
+    }
+    if(!(dwPhaseReuse & FC_PHASE_REGISTRY)) {
+        if(FcWinReg_Initialize()) {
+            Fc_SqlMetaCheckpoint(FC_PHASE_REGISTRY);
+        }
+    }
+    if(!(dwPhaseReuse & FC_PHASE_SCANPHYSMEM)) {
+        if(FcScanPhysMem()) {
+            Fc_SqlMetaCheckpoint(FC_PHASE_SCANPHYSMEM);
+        }
+    }
+    if(!(dwPhaseReuse & FC_PHASE_INDEX)) {
+        if(Fc_SqlInitializeDatabaseIndexes()) {
+            Fc_SqlMetaCheckpoint(FC_PHASE_INDEX);
+        }
+    }
+    if(!(dwPhaseReuse & FC_PHASE_SCANPHYSMEM) && FcScanPhysMem_StatisticsText(szStatistics, sizeof(szStatistics))) {
+        vmmprintfv("%s", szStatistics);
+    }
+    if(!(dwPhaseReuse & FC_PHASE_TIMELINE)) {
+        if(FcTimeline_Initialize()) {
+            Fc_SqlMetaCheckpoint(FC_PHASE_TIMELINE);
+        }
+    } else if(!FcTimeline_InitializeInfo()) {
+        ctxFc->fEnableTimeline = FALSE;
+    }
+    FcNtfs_InitializeOffsetIndex();
+    if(ctxFc->fEnableTimeline) {
+        FcTimeline_InitializeOffsetIndex();
+    }
+    Fc_SqlBulkLoad(FALSE);
     ctxFc->db.fSingleThread = FALSE;
     ctxFc->fInitFinish = TRUE;
     PluginManager_Notify(VMMDLL_PLUGIN_EVENT_FORENSIC_INIT, NULL, 100);
@@ -719,6 +1579,16 @@ VOID FcClose()
     if(ctxFc->db.tp == FC_DATABASE_TYPE_TEMPFILE_CLOSE) {
         DeleteFileW(ctxFc->db.wszDatabaseWinPath);
     }
+    if(ctxFc->Timeline.ppObIndex) {
+        for(i = 0; i < ctxFc->Timeline.cTp; i++) {
+            Ob_DECREF(ctxFc->Timeline.ppObIndex[i]);
+        }
+        LocalFree(ctxFc->Timeline.ppObIndex);
+    }
+    Ob_DECREF(ctxFc->Timeline.pObCMapBatch);
+    Ob_DECREF(ctxFc->Ntfs.pObIndex);
+    Ob_DECREF(ctxFc->Ntfs.pObCMapBatch);
+    FcNtfs_DirCache_Close();
     LocalFree(ctxFc->Timeline.pInfo);
     LeaveCriticalSection(&ctxFc->Lock);
     DeleteCriticalSection(&ctxFc->Lock);
@@ -746,7 +1616,7 @@ BOOL FcInitialize_SetPath(_In_ DWORD dwDatabaseType)
     if(!cch || cch > 128) { return FALSE; }
     cch = GetLongPathNameW(wszTempShort, wszTemp, _countof(wszTemp));
     if(!cch || cch > 128) { return FALSE; }
-    if((dwDatabaseType == FC_DATABASE_TYPE_TEMPFILE_CLOSE) || (dwDatabaseType == FC_DATABASE_TYPE_TEMPFILE_NOCLOSE)) {
+    if((dwDatabaseType == FC_DATABASE_TYPE_TEMPFILE_CLOSE) || (dwDatabaseType == FC_DATABASE_TYPE_TEMPFILE_NOCLOSE) || (dwDatabaseType == FC_DATABASE_TYPE_MEMORY_SPILL)) {
         GetLocalTime(&st);
         _snwprintf_s(
             wszTemp + wcslen(wszTemp),
@@ -772,6 +1642,13 @@ BOOL FcInitialize_SetPath(_In_ DWORD dwDatabaseType)
     strcpy_s(ctxFc->db.szuDatabase, _countof(ctxFc->db.szuDatabase), "file:///");
     strcat_s(ctxFc->db.szuDatabase, _countof(ctxFc->db.szuDatabase), szu8);
     LocalFree(szu8);
+    if(dwDatabaseType == FC_DATABASE_TYPE_MEMORY_SPILL) {
+        // the temp file is only used if the in-memory database is spilled.
+        wcscpy_s(ctxFc->db.wszSpillWinPath, _countof(ctxFc->db.wszSpillWinPath), ctxFc->db.wszDatabaseWinPath);
+        strcpy_s(ctxFc->db.szuSpill, _countof(ctxFc->db.szuSpill), ctxFc->db.szuDatabase);
+        ctxFc->db.wszDatabaseWinPath[0] = 0;
+        strcpy_s(ctxFc->db.szuDatabase, _countof(ctxFc->db.szuDatabase), "file:///memorydb?mode=memory");
+    }
     ctxFc->db.tp = dwDatabaseType;
     return TRUE;
 }
@@ -796,6 +1673,9 @@ BOOL FcInitialize_Impl(_In_ DWORD dwDatabaseType, _In_ BOOL fForceReInit)
     if(ctxFc) { FcClose(); }
     if(!(ctxFc = (PFC_CONTEXT)LocalAlloc(LMEM_ZEROINIT, sizeof(FC_CONTEXT)))) { goto fail; }
     InitializeCriticalSection(&ctxFc->Lock);
+    if(!(ctxFc->Timeline.pObCMapBatch = ObContainer_New(NULL))) { goto fail; }
+    if(!(ctxFc->Ntfs.pObCMapBatch = ObContainer_New(NULL))) { goto fail; }
+    FcNtfs_DirCache_Initialize();
     // 2: SQLITE INIT:
     if(SQLITE_CONFIG_MULTITHREAD != sqlite3_threadsafe()) {
         vmmprintf_fn("CRITICAL: WRONG SQLITE THREADING MODE - TERMINATING!\n");
@@ -810,6 +1690,11 @@ BOOL FcInitialize_Impl(_In_ DWORD dwDatabaseType, _In_ BOOL fForceReInit)
         if(!(ctxFc->db.hEvent[i] = CreateEvent(NULL, FALSE, TRUE, NULL))) { goto fail; }
         if(SQLITE_OK != sqlite3_open_v2(ctxFc->db.szuDatabase, &ctxFc->db.hSql[i], SQLITE_OPEN_URI | SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_SHAREDCACHE | SQLITE_OPEN_NOMUTEX, NULL)) { goto fail; }
     }
+    Fc_SqlBulkLoad(TRUE);
+    if(!Fc_SqlMetaAttach(fForceReInit)) {
+        vmmprintf("FORENSIC: Fail. Unable to initialize database meta data.\n");
+        goto fail;
+    }
     VmmWork((LPTHREAD_START_ROUTINE)FcInitialize_ThreadProc, NULL, 0);
     ctxFc->fInitStart = TRUE;
     return TRUE;
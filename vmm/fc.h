@@ -20,8 +20,33 @@
 #include "include/sqlite3.h"
 
 #define FC_SQL_POOL_CONNECTION_NUM          4
-#define FC_PHYSMEM_NUM_CHUNKS               0x1000
-#define FC_PHYSMEMSCAN_CONSUMERS            2
+#define FC_SQL_BULKLOAD_CACHE_KB            65536       // page cache size during bulk-load (64MB)
+#define FC_SQL_MEMORY_BUDGET_MB_DEFAULT     4096        // in-memory database spill-to-disk budget
+#define FC_PHYSMEM_NUM_CHUNKS               0x1000      // default # pages per physical memory scan chunk (16MB)
+#define FC_PHYSMEMSCAN_CHUNK_PAGES_MIN      0x100       // 1MB
+#define FC_PHYSMEMSCAN_CHUNK_PAGES_MAX      0x4000      // 64MB
+#define FC_PHYSMEMSCAN_CHUNKS_DEFAULT       4           // default pipeline depth (# chunks in flight)
+#define FC_PHYSMEMSCAN_CHUNKS_MAX           32
+#define FC_PATTERN_MAX                      0x100       // max # patterns in -forensicpattern file
+#define FC_PATTERN_LENGTH_MAX               0x40        // max pattern length in bytes
+#define FC_PATTERN_NAME_MAX                 32
+#define FC_PATTERN_HITS_MAX                 0x00100000  // max # pattern hits saved to database
+#define FC_OFFSETINDEX_BLOCK                0x100       // # entries per absolute offset in offset index
+#define FC_MAP_BATCH_ENTRIES                0x2000      // # entries fetched per batch by sequential file reads
+#define FC_WINREG_PARALLEL_THREADS          4           // max # worker threads snapshotting registry hives
+#define FC_NTFS_DIRCACHE_MB                 16          // memory budget of ntfs directory listing cache
+#define FC_NTFS_DIRCACHE_CB_OVERHEAD        0x60        // per entry accounting overhead (map + ob header)
+#define FC_META_VERSION                     1           // bump on database schema change to invalidate re-use
+
+// forensic initialization phases - checkpointed in the fc_meta table so that a
+// persisted database may be re-used by a later session on the same dump.
+#define FC_PHASE_PROCESS                    0x01
+#define FC_PHASE_THREAD                     0x02
+#define FC_PHASE_REGISTRY                   0x04
+#define FC_PHASE_SCANPHYSMEM                0x08
+#define FC_PHASE_INDEX                      0x10
+#define FC_PHASE_TIMELINE                   0x20
+#define FC_PHASE_ALL                        0x3f
 
 typedef struct tdFCSQL_INSERTSTRTABLE {
     QWORD id;
@@ -30,6 +55,21 @@ typedef struct tdFCSQL_INSERTSTRTABLE {
     DWORD cbj;      // UTF-8 JSON string count (excl. NULL)
 } FCSQL_INSERTSTRTABLE, *PFCSQL_INSERTSTRTABLE;
 
+/*
+* Compact in-memory index mapping a byte offset within a generated text file
+* to the id of the line (record) at that offset. Ids are contiguous starting at
+* qwIdBase. Offsets are stored as an absolute QWORD per FC_OFFSETINDEX_BLOCK
+* entries and a DWORD relative to its block per entry.
+*/
+typedef struct tdFCOB_OFFSETINDEX {
+    OB ObHdr;
+    QWORD qwIdBase;
+    DWORD cId;
+    DWORD cBlock;
+    PQWORD pqwBlock;                // absolute offset of first entry in block
+    DWORD pdwOffset[];              // offset relative to start of block
+} FCOB_OFFSETINDEX, *PFCOB_OFFSETINDEX;
+
 /*
 * Context struct for communicating between physical memory scan activity and
 * its worker thread consumers which resides in other c-files. This struct is
@@ -38,20 +78,33 @@ typedef struct tdFCSQL_INSERTSTRTABLE {
 typedef struct tdOB_FC_SCANPHYSMEM_CHUNK {
     OB ObHdr;
     QWORD paBase;
+    DWORD cMEMs;                    // # pages in chunk
     PMMPFNOB_MAP pPfnMap;
     PPMEM_SCATTER ppMEMs;
-    union {
-        HANDLE hEventFinish[FC_PHYSMEMSCAN_CONSUMERS];
-        struct {
-            HANDLE hEventFinish_PFN;
-            HANDLE hEventFinish_NTFS;
-        };
-    };
+    HANDLE hEventFinish;            // set when chunk is read & processed by all consumers
     // consumer contexts (must be individually thread safe)
     PVOID ctx_PFN;
     PVOID ctx_NTFS;
+    PVOID ctx_PATTERN;
 } OB_FC_SCANPHYSMEM_CHUNK, *POB_FC_SCANPHYSMEM_CHUNK;
 
+/*
+* Physical memory scan statistics - times are accumulated across all worker
+* threads (in QueryPerformanceCounter ticks) and may exceed wall time.
+*/
+typedef struct tdFC_SCANPHYSMEM_STATISTICS {
+    DWORD cChunksInFlight;
+    DWORD cPagesChunk;
+    QWORD cChunks;
+    QWORD cbRead;                   // bytes successfully read
+    QWORD tmRead;
+    QWORD tmNtfs;
+    QWORD tmPfn;
+    QWORD tmPattern;
+    QWORD tmWall;
+    QWORD tmIndex;                  // deferred secondary index build (after ingestion)
+} FC_SCANPHYSMEM_STATISTICS, *PFC_SCANPHYSMEM_STATISTICS;
+
 typedef struct tdFC_TIMELINE_INFO {
     DWORD dwId;
     DWORD dwFileSizeUTF8;
@@ -70,12 +123,17 @@ typedef struct tdFC_CONTEXT {
     BOOL fEnableProcess;
     BOOL fEnableThread;
     BOOL fEnableRegistry;
+    BOOL fEnablePattern;
     CRITICAL_SECTION Lock;
     struct {
         DWORD tp;                           // type as specified in FC_DATABASE_TYPE_*
         WCHAR wszDatabaseWinPath[MAX_PATH]; // Windows file path
         CHAR szuDatabase[MAX_PATH];         // Sqlite3 database path in UTF-8
         BOOL fSingleThread;                 // enforce single-thread access (used during insert-bound init phase)
+        DWORD dwPhaseComplete;              // FC_PHASE_* completed (re-used from a previous session or this one)
+        BOOL fSpilled;                      // FC_DATABASE_TYPE_MEMORY_SPILL: database moved to szuSpill
+        WCHAR wszSpillWinPath[MAX_PATH];    // FC_DATABASE_TYPE_MEMORY_SPILL: spill file path
+        CHAR szuSpill[MAX_PATH];            // FC_DATABASE_TYPE_MEMORY_SPILL: spill file path in UTF-8
         HANDLE hEvent[FC_SQL_POOL_CONNECTION_NUM];
         sqlite3 *hSql[FC_SQL_POOL_CONNECTION_NUM];
         QWORD qwIdStr;
@@ -83,7 +141,23 @@ typedef struct tdFC_CONTEXT {
     struct {
         DWORD cTp;
         PFC_TIMELINE_INFO pInfo;    // array of cTp items
+        struct tdFCTIMELINE_BUILD *pBuild;  // transient - only valid during FcTimeline_Initialize()
+        PFCOB_OFFSETINDEX *ppObIndex;       // utf-8 file offset index per type (cTp items)
+        POB_CONTAINER pObCMapBatch;         // last batch map fetched by file read
     } Timeline;
+    struct {
+        PFCOB_OFFSETINDEX pObIndex;         // utf-8 file offset index
+        POB_CONTAINER pObCMapBatch;         // last batch map fetched by file read
+        struct {
+            CRITICAL_SECTION Lock;
+            QWORD cbMax;                    // memory budget in bytes
+            QWORD cb;                       // memory currently in use (incl. overhead)
+            DWORD iClock;                   // clock hand - index into pm
+            POB_MAP pm;                     // parent hash -> FCOB_MAP_NTFS of children
+            POB_SET psReferenced;           // entries (parent hashes) referenced since last clock pass
+        } DirCache;
+    } Ntfs;
+    FC_SCANPHYSMEM_STATISTICS ScanPhysMemStat;
 } FC_CONTEXT, *PFC_CONTEXT;
 
 
@@ -104,7 +178,8 @@ PFC_CONTEXT ctxFc;
 #define FC_DATABASE_TYPE_TEMPFILE_CLOSE         2
 #define FC_DATABASE_TYPE_TEMPFILE_NOCLOSE       3
 #define FC_DATABASE_TYPE_TEMPFILE_STATIC        4
-#define FC_DATABASE_TYPE_MAX                    4
+#define FC_DATABASE_TYPE_MEMORY_SPILL           5       // in-memory - spilled to temp file past budget or on save
+#define FC_DATABASE_TYPE_MAX                    5
 
 /*
 * Initialize (or re-initialize) the forensic sub-system.
@@ -120,6 +195,28 @@ BOOL FcInitialize(_In_ DWORD dwDatabaseType, _In_ BOOL fForceReInit);
 */
 VOID FcClose();
 
+/*
+* Save the in-memory database (FC_DATABASE_TYPE_MEMORY_SPILL) to its temp file.
+* Further database access is made towards the file. Function is thread-safe.
+* -- return
+*/
+_Success_(return)
+BOOL Fc_SqlMemorySpill();
+
+/*
+* Spill the in-memory database to disk if it exceeds the memory budget. Must
+* not be called while holding a reserved pooled connection.
+*/
+VOID Fc_SqlMemorySpillCheck();
+
+/*
+* Retrieve the physical memory scan statistics as a human readable text.
+* -- sz = buffer to receive text, or NULL to retrieve required size.
+* -- cch
+* -- return = number of chars (excl. NULL) written, or required.
+*/
+DWORD FcScanPhysMem_StatisticsText(_Out_writes_opt_(cch) LPSTR sz, _In_ DWORD cch);
+
 
 
 // ----------------------------------------------------------------------------
@@ -208,6 +305,34 @@ int Fc_SqlBindMultiInt64(
     ...
 );
 
+/*
+* Create a file offset index from an sql query returning (id, offset) rows of
+* contiguous ids ordered by id. The query is run once in a single pass.
+* -- szSqlCount = query returning the row count and the minimum id.
+* -- szSqlSelect = query returning the (id, offset) rows.
+* -- cQueryValues
+* -- pqwQueryValues
+* -- return = the index object, or NULL on fail (i.e. non-contiguous ids).
+*/
+_Success_(return != NULL)
+PFCOB_OFFSETINDEX FcOffsetIndex_Create(
+    _In_ LPSTR szSqlCount,
+    _In_ LPSTR szSqlSelect,
+    _In_ DWORD cQueryValues,
+    _In_reads_(cQueryValues) PQWORD pqwQueryValues
+);
+
+/*
+* Retrieve the id of the entry (line) which contains a file position.
+* -- pIndex
+* -- qwFilePos
+* -- return = the id.
+*/
+QWORD FcOffsetIndex_GetId(
+    _In_ PFCOB_OFFSETINDEX pIndex,
+    _In_ QWORD qwFilePos
+);
+
 
 
 // ----------------------------------------------------------------------------
@@ -250,6 +375,7 @@ typedef struct tdFCOB_MAP_TIMELINE {
     OB ObHdr;
     LPWSTR wszMultiText;            // multi-wstr pointed into by FC_MAP_TIMELINEENTRY.wszText
     DWORD cbMultiText;
+    DWORD dwTimelineType;           // timeline type of map, 0 for all.
     DWORD cMap;                     // # map entries.
     FC_MAP_TIMELINEENTRY pMap[];    // map entries.
 } FCOB_MAP_TIMELINE, *PFCOB_MAP_TIMELINE;
@@ -270,6 +396,27 @@ BOOL FcTimelineMap_GetFromIdRange(
     _Out_ PFCOB_MAP_TIMELINE *ppObTimelineMap
 );
 
+/*
+* Retrieve a timeline map object containing at least the entries within the
+* range [qwId, qwId + cId). Entries are fetched in batches of
+* FC_MAP_BATCH_ENTRIES so that sequential file reads are mostly served from
+* the previously fetched map without any database access.
+* -- dwTimelineType = the timeline type, 0 for all.
+* -- qwId = the minimum timeline id of the entries to retrieve.
+* -- cId = the number of timeline entries to retrieve.
+* -- ppObTimelineMap
+* -- piMap = index of the entry with id qwId in the map.
+* -- return
+*/
+_Success_(return)
+BOOL FcTimelineMap_GetFromIdRangeBatch(
+    _In_ DWORD dwTimelineType,
+    _In_ QWORD qwId,
+    _In_ QWORD cId,
+    _Out_ PFCOB_MAP_TIMELINE *ppObTimelineMap,
+    _Out_ PDWORD piMap
+);
+
 /*
 * Retrieve the minimum timeline id that exists within a byte range inside a
 * timeline file of a specific type.
@@ -356,7 +503,8 @@ BOOL FcNtfsMap_GetFromHash(
 
 /*
 * Retrieve a FCOB_MAP_NTFS map object containing entries which have the same
-* file system parent given by its parent hash.
+* file system parent given by its parent hash. Once forensic initialization
+* has completed listings are served from a memory budgeted cache.
 * -- qwHashParent
 * -- ppObNtfsMap
 * -- return
@@ -381,6 +529,24 @@ BOOL FcNtfsMap_GetFromIdRange(
     _Out_ PFCOB_MAP_NTFS * ppObNtfsMap
 );
 
+/*
+* Retrieve a FCOB_MAP_NTFS map object containing at least the entries within
+* the range [qwId, qwId + cId). Entries are fetched in batches to serve most
+* sequential file reads from the previously fetched map.
+* -- qwId
+* -- cId
+* -- ppObNtfsMap
+* -- piMap = index of the entry with id qwId in the map.
+* -- return
+*/
+_Success_(return)
+BOOL FcNtfsMap_GetFromIdRangeBatch(
+    _In_ QWORD qwId,
+    _In_ QWORD cId,
+    _Out_ PFCOB_MAP_NTFS *ppObNtfsMap,
+    _Out_ PDWORD piMap
+);
+
 /*
 * Retieve the file size of the ntfs information file either in JSON or UTF8.
 * -- pcRecords = number of entries/lines/records.
@@ -409,4 +575,14 @@ BOOL FcNtfs_GetIdFromPosition(
     _Out_ PQWORD pqwId
 );
 
+/*
+* Export a forensic database table to a file in the Apache Arrow IPC streaming
+* format. The table is streamed from the database in record batches.
+* -- szTable = timeline, ntfs, process, thread, registry, pattern or pfn.
+* -- wszFileName
+* -- return
+*/
+_Success_(return)
+BOOL FcExport_Table(_In_ LPSTR szTable, _In_ LPWSTR wszFileName);
+
 #endif /* __FC_H__ */
@@ -0,0 +1,469 @@
+// fc_export.c : implementation of the streaming columnar export of forensic
+//               database tables.
+//
+// Forensic tables are exported straight from the sqlite connection pool into
+// the Apache Arrow IPC streaming format (.arrows) which is directly readable
+// by pyarrow, polars, duckdb, spark and similar tools. Rows are written in
+// record batches of at most FCEXPORT_BATCH_ROWS rows (and FCEXPORT_BATCH_CB
+// bytes per variable length column) so that memory use is bounded regardless
+// of the table size.
+//
+// The Arrow IPC metadata (schema and record batch headers) are flatbuffers.
+// These are encoded by the minimal forward-only builder below which supports
+// what is needed by the Arrow metadata only. Columns are exported as Int64,
+// Utf8 or Binary depending on the declared sqlite column type.
+//
+// (c) MemProcFS contributors, 2020
+// Author: MemProcFS contributors
+//
+
+#include "fc.h"
+#include "vmm.h"
+#include "util.h"
+
+#define FCEXPORT_BATCH_ROWS             0x00010000  // max # rows per record batch
+#define FCEXPORT_BATCH_CB               0x00400000  // max # bytes per variable length column per record batch
+#define FCEXPORT_COLUMNS_MAX            0x40
+#define FCEXPORT_FB_CB_MAX              0x4000      // max size of flatbuffer encoded message metadata
+#define FCEXPORT_FB_FIELDS_MAX          8
+
+// Arrow constants as defined by Schema.fbs and Message.fbs
+#define FCEXPORT_ARROW_METADATA_V5      4
+#define FCEXPORT_ARROW_HEADER_SCHEMA    1
+#define FCEXPORT_ARROW_HEADER_BATCH     3
+#define FCEXPORT_ARROW_TYPE_INT         2
+#define FCEXPORT_ARROW_TYPE_BINARY      4
+#define FCEXPORT_ARROW_TYPE_UTF8        5
+
+static struct {
+    LPSTR szName;
+    LPSTR szSql;
+} FCEXPORT_TABLES[] = {
+    { "timeline", "SELECT t.id, t.tp, t.tp_id, t.ft, t.ac, t.pid, t.data64, s.sz AS text FROM timeline t, str s WHERE t.id_str = s.id ORDER BY t.id" },
+    { "ntfs",     "SELECT n.id, n.id_parent, n.addr_phys, n.inode, n.mft_flags, n.depth, n.size_file, n.size_fileres, n.time_create, n.time_modify, n.time_read, s.sz AS path FROM ntfs n, str s WHERE n.id_str = s.id ORDER BY n.id" },
+    { "process",  "SELECT p.id, p.pid, p.ppid, p.eprocess, p.dtb, p.dtb_user, p.state, p.wow64, p.peb, p.peb32, p.time_create, p.time_exit, sn.sz AS name, sp.sz AS path, su.sz AS user FROM process p, str sn, str sp, str su WHERE p.id_str_name = sn.id AND p.id_str_path = sp.id AND p.id_str_user = su.id ORDER BY p.id" },
+    { "thread",   "SELECT id, pid, tid, ethread, teb, state, exitstatus, running, prio, priobase, startaddr, stackbase_u, stacklimit_u, stackbase_k, stacklimit_k, trapframe, sp, ip, time_create, time_exit FROM thread ORDER BY id" },
+    { "registry", "SELECT r.id, r.hive, r.cell, r.cell_parent, r.time, s.sz AS path FROM registry r, str s WHERE r.id_str = s.id ORDER BY r.id" },
+    { "pattern",  "SELECT id, name, pa, pid, va, tp, tpex FROM pattern ORDER BY id" },
+    { "pfn",      "SELECT pfn, tp, tpex, pid, va, hash FROM pfn ORDER BY pfn" },
+};
+
+typedef struct tdFCEXPORT_FB {
+    BOOL fError;
+    DWORD cb;
+    BYTE pb[FCEXPORT_FB_CB_MAX];
+} FCEXPORT_FB, *PFCEXPORT_FB;
+
+typedef struct tdFCEXPORT_FB_FIELD {
+    BYTE cb;                        // field size: 1, 2, 4 or 8 - 0 = absent (default value)
+    QWORD v;                        // field value (uoffset fields are patched later)
+    DWORD o;                        // out: field position in flatbuffer
+} FCEXPORT_FB_FIELD, *PFCEXPORT_FB_FIELD;
+
+typedef struct tdFCEXPORT_COLUMN {
+    DWORD tp;                       // FCEXPORT_ARROW_TYPE_*
+    LPSTR szName;
+    PQWORD pqw;                     // TYPE_INT: values
+    PDWORD pdwOffset;               // TYPE_UTF8/BINARY: value offsets into pb
+    PBYTE pb;                       // TYPE_UTF8/BINARY: value data
+    DWORD cb;
+} FCEXPORT_COLUMN, *PFCEXPORT_COLUMN;
+
+typedef struct tdFCEXPORT_CONTEXT {
+    HANDLE hFile;
+    BOOL fError;
+    DWORD cRow;
+    DWORD cColumn;
+    FCEXPORT_COLUMN Column[FCEXPORT_COLUMNS_MAX];
+    FCEXPORT_FB fb;
+} FCEXPORT_CONTEXT, *PFCEXPORT_CONTEXT;
+
+
+
+// ----------------------------------------------------------------------------
+// MINIMAL FORWARD-ONLY FLATBUFFER BUILDER:
+// Objects are written in the order they are referenced - i.e. all uoffsets
+// point forward and are patched once the referenced object is written.
+// Each table is preceded by its vtable.
+// ----------------------------------------------------------------------------
+
+VOID FcExport_FbPad(_In_ PFCEXPORT_FB fb, _In_ DWORD cbAlign, _In_ DWORD cbMod)
+{
+    while((fb->cb % cbAlign) != cbMod) {
+        if(fb->cb >= FCEXPORT_FB_CB_MAX) {
+            fb->fError = TRUE;
+            return;
+        }
+        fb->pb[fb->cb++] = 0;
+    }
+}
+
+DWORD FcExport_FbWrite(_In_ PFCEXPORT_FB fb, _In_reads_opt_(cb) PVOID pv, _In_ DWORD cb)
+{
+    DWORD o = fb->cb;
+    if(fb->cb + cb > FCEXPORT_FB_CB_MAX) {
+        fb->fError = TRUE;
+        return 0;
+    }
+    if(pv) {
+        memcpy(fb->pb + o, pv, cb);
+    } else {
+        ZeroMemory(fb->pb + o, cb);
+    }
+    fb->cb += cb;
+    return o;
+}
+
+VOID FcExport_FbPatch(_In_ PFCEXPORT_FB fb, _In_ DWORD oField, _In_ DWORD oTarget)
+{
+    if(fb->fError || (oTarget <= oField)) {
+        fb->fError = TRUE;
+        return;
+    }
+    *(PDWORD)(fb->pb + oField) = oTarget - oField;
+}
+
+/*
+* Write a flatbuffer table together with its vtable. Fields are laid out by
+* decreasing size after the soffset so that all fields are naturally aligned.
+* -- fb
+* -- cField = number of fields in pFields (= field ids 0..cField-1).
+* -- pFields
+* -- return = position of the table.
+*/
+DWORD FcExport_FbTable(_In_ PFCEXPORT_FB fb, _In_ DWORD cField, _Inout_updates_(cField) PFCEXPORT_FB_FIELD pFields)
+{
+    DWORD i, oVt, oTable, cbSize;
+    WORD vt[2 + FCEXPORT_FB_FIELDS_MAX] = { 0 };
+    INT32 soVt;
+    if(cField > FCEXPORT_FB_FIELDS_MAX) {
+        fb->fError = TRUE;
+        return 0;
+    }
+    vt[0] = (WORD)(4 + 2 * cField);
+    vt[1] = 4;
+    for(cbSize = 8; cbSize; cbSize >>= 1) {
+        for(i = 0; i < cField; i++) {
+            if(pFields[i].cb == cbSize) {
+                vt[2 + i] = vt[1];
+                vt[1] += (WORD)cbSize;
+            }
+        }
+    }
+    FcExport_FbPad(fb, 2, 0);
+    oVt = FcExport_FbWrite(fb, vt, vt[0]);
+    FcExport_FbPad(fb, 8, 4);
+    oTable = fb->cb;
+    soVt = (INT32)(oTable - oVt);
+    FcExport_FbWrite(fb, &soVt, sizeof(INT32));
+    FcExport_FbWrite(fb, NULL, vt[1] - 4);
+    if(fb->fError) { return 0; }
+    for(i = 0; i < cField; i++) {
+        if(pFields[i].cb) {
+            pFields[i].o = oTable + vt[2 + i];
+            memcpy(fb->pb + pFields[i].o, &pFields[i].v, pFields[i].cb);
+        }
+    }
+    return oTable;
+}
+
+/*
+* Write a flatbuffer vector of scalars or structs.
+* -- fb
+* -- cElement
+* -- cbElement
+* -- pv = element data, or NULL for zero (i.e. uoffset elements patched later).
+* -- return = position of the vector.
+*/
+DWORD FcExport_FbVector(_In_ PFCEXPORT_FB fb, _In_ DWORD cElement, _In_ DWORD cbElement, _In_opt_ PVOID pv)
+{
+    DWORD oVector;
+    FcExport_FbPad(fb, (cbElement >= 8) ? 8 : 4, (cbElement >= 8) ? 4 : 0);
+    oVector = FcExport_FbWrite(fb, &cElement, sizeof(DWORD));
+    FcExport_FbWrite(fb, pv, cElement * cbElement);
+    return oVector;
+}
+
+DWORD FcExport_FbString(_In_ PFCEXPORT_FB fb, _In_ LPSTR sz)
+{
+    DWORD oString, cch = (DWORD)strlen(sz);
+    FcExport_FbPad(fb, 4, 0);
+    oString = FcExport_FbWrite(fb, &cch, sizeof(DWORD));
+    FcExport_FbWrite(fb, sz, cch + 1);
+    return oString;
+}
+
+/*
+* Begin a new Arrow Message flatbuffer.
+* -- fb
+* -- bHeaderType = FCEXPORT_ARROW_HEADER_*
+* -- cbBody
+* -- return = position of the Message.header field to patch.
+*/
+DWORD FcExport_FbMessageBegin(_In_ PFCEXPORT_FB fb, _In_ BYTE bHeaderType, _In_ QWORD cbBody)
+{
+    FCEXPORT_FB_FIELD pMessage[] = { { 2, FCEXPORT_ARROW_METADATA_V5 }, { 1, bHeaderType }, { 4, 0 }, { 8, cbBody } };
+    fb->fError = FALSE;
+    fb->cb = 0;
+    FcExport_FbWrite(fb, NULL, sizeof(DWORD));      // root uoffset
+    FcExport_FbPatch(fb, 0, FcExport_FbTable(fb, _countof(pMessage), pMessage));
+    return pMessage[2].o;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// ARROW IPC STREAM WRITER:
+// ----------------------------------------------------------------------------
+
+VOID FcExport_FileWrite(_In_ PFCEXPORT_CONTEXT ctx, _In_reads_(cb) PVOID pv, _In_ DWORD cb)
+{
+    DWORD cbWrite;
+    if(ctx->fError || !cb) { return; }
+    if(!WriteFile(ctx->hFile, pv, cb, &cbWrite, NULL) || (cb != cbWrite)) {
+        ctx->fError = TRUE;
+    }
+}
+
+VOID FcExport_FileWritePad(_In_ PFCEXPORT_CONTEXT ctx, _In_ DWORD cb)
+{
+    BYTE pbZero[8] = { 0 };
+    FcExport_FileWrite(ctx, pbZero, (8 - (cb & 7)) & 7);
+}
+
+/*
+* Write the encapsulated message (continuation marker, metadata length and the
+* metadata flatbuffer padded to 8 bytes) currently held in ctx->fb.
+*/
+VOID FcExport_WriteMessage(_In_ PFCEXPORT_CONTEXT ctx)
+{
+    DWORD dwHdr[2];
+    if(ctx->fb.fError) {
+        ctx->fError = TRUE;
+        return;
+    }
+    dwHdr[0] = 0xffffffff;
+    dwHdr[1] = (ctx->fb.cb + 7) & ~7;
+    FcExport_FileWrite(ctx, dwHdr, sizeof(dwHdr));
+    FcExport_FileWrite(ctx, ctx->fb.pb, ctx->fb.cb);
+    FcExport_FileWritePad(ctx, ctx->fb.cb);
+}
+
+VOID FcExport_WriteSchema(_In_ PFCEXPORT_CONTEXT ctx)
+{
+    DWORD i, oVector, oType;
+    PFCEXPORT_FB fb = &ctx->fb;
+    PFCEXPORT_COLUMN pc;
+    FCEXPORT_FB_FIELD pSchema[2], pField[6], pInt[2];
+    DWORD oHeader = FcExport_FbMessageBegin(fb, FCEXPORT_ARROW_HEADER_SCHEMA, 0);
+    // Schema { endianness: Little, fields: [Field] }
+    ZeroMemory(pSchema, sizeof(pSchema));
+    pSchema[1].cb = 4;
+    FcExport_FbPatch(fb, oHeader, FcExport_FbTable(fb, _countof(pSchema), pSchema));
+    oVector = FcExport_FbVector(fb, ctx->cColumn, sizeof(DWORD), NULL);
+    FcExport_FbPatch(fb, pSchema[1].o, oVector);
+    for(i = 0; i < ctx->cColumn; i++) {
+        pc = ctx->Column + i;
+        // Field { name, nullable, type_type, type, dictionary (absent), children }
+        ZeroMemory(pField, sizeof(pField));
+        pField[0].cb = 4;
+        pField[1].cb = 1; pField[1].v = 1;
+        pField[2].cb = 1; pField[2].v = pc->tp;
+        pField[3].cb = 4;
+        pField[5].cb = 4;
+        FcExport_FbPatch(fb, oVector + 4 + 4 * i, FcExport_FbTable(fb, _countof(pField), pField));
+        FcExport_FbPatch(fb, pField[0].o, FcExport_FbString(fb, pc->szName));
+        if(pc->tp == FCEXPORT_ARROW_TYPE_INT) {
+            // Int { bitWidth: 64, is_signed: true }
+            pInt[0].cb = 4; pInt[0].v = 64;
+            pInt[1].cb = 1; pInt[1].v = 1;
+            oType = FcExport_FbTable(fb, _countof(pInt), pInt);
+        } else {
+            // Utf8 {} / Binary {}
+            oType = FcExport_FbTable(fb, 0, NULL);
+        }
+        FcExport_FbPatch(fb, pField[3].o, oType);
+        FcExport_FbPatch(fb, pField[5].o, FcExport_FbVector(fb, 0, sizeof(DWORD), NULL));
+    }
+    FcExport_WriteMessage(ctx);
+}
+
+/*
+* Write all buffered rows as one record batch and reset the row buffers.
+*/
+VOID FcExport_WriteBatch(_In_ PFCEXPORT_CONTEXT ctx)
+{
+    DWORD i, iBuffer = 0, oHeader;
+    QWORD cbBody = 0, pqwNode[FCEXPORT_COLUMNS_MAX * 2], pqwBuffer[FCEXPORT_COLUMNS_MAX * 3 * 2];
+    PFCEXPORT_FB fb = &ctx->fb;
+    PFCEXPORT_COLUMN pc;
+    FCEXPORT_FB_FIELD pBatch[3] = { { 8, ctx->cRow }, { 4, 0 }, { 4, 0 } };
+    if(!ctx->cRow) { return; }
+    // 1: body layout - FieldNode { length, null_count } and Buffer { offset, length }.
+#define FCEXPORT_BUFFER_ADD(cb)     { pqwBuffer[iBuffer++] = cbBody; pqwBuffer[iBuffer++] = (cb); cbBody += ((cb) + 7) & ~7; }
+    for(i = 0; i < ctx->cColumn; i++) {
+        pc = ctx->Column + i;
+        pqwNode[i * 2 + 0] = ctx->cRow;
+        pqwNode[i * 2 + 1] = 0;
+        FCEXPORT_BUFFER_ADD(0);                                             // validity bitmap (all valid)
+        if(pc->tp == FCEXPORT_ARROW_TYPE_INT) {
+            FCEXPORT_BUFFER_ADD(ctx->cRow * sizeof(QWORD));
+        } else {
+            FCEXPORT_BUFFER_ADD((ctx->cRow + 1) * sizeof(DWORD));
+            FCEXPORT_BUFFER_ADD(pc->cb);
+        }
+    }
+#undef FCEXPORT_BUFFER_ADD
+    // 2: metadata - RecordBatch { length, nodes, buffers }.
+    oHeader = FcExport_FbMessageBegin(fb, FCEXPORT_ARROW_HEADER_BATCH, cbBody);
+    FcExport_FbPatch(fb, oHeader, FcExport_FbTable(fb, _countof(pBatch), pBatch));
+    FcExport_FbPatch(fb, pBatch[1].o, FcExport_FbVector(fb, ctx->cColumn, 2 * sizeof(QWORD), pqwNode));
+    FcExport_FbPatch(fb, pBatch[2].o, FcExport_FbVector(fb, iBuffer / 2, 2 * sizeof(QWORD), pqwBuffer));
+    FcExport_WriteMessage(ctx);
+    // 3: body.
+    for(i = 0; i < ctx->cColumn; i++) {
+        pc = ctx->Column + i;
+        if(pc->tp == FCEXPORT_ARROW_TYPE_INT) {
+            FcExport_FileWrite(ctx, pc->pqw, ctx->cRow * sizeof(QWORD));
+        } else {
+            FcExport_FileWrite(ctx, pc->pdwOffset, (ctx->cRow + 1) * sizeof(DWORD));
+            FcExport_FileWritePad(ctx, (ctx->cRow + 1) * sizeof(DWORD));
+            FcExport_FileWrite(ctx, pc->pb, pc->cb);
+            FcExport_FileWritePad(ctx, pc->cb);
+        }
+        pc->cb = 0;
+    }
+    ctx->cRow = 0;
+}
+
+/*
+* Initialize the columns of the export from the prepared sql statement. The
+* column type is derived from the declared sqlite column type.
+* -- ctx
+* -- hStmt
+* -- return
+*/
+_Success_(return)
+BOOL FcExport_InitializeColumns(_In_ PFCEXPORT_CONTEXT ctx, _In_ sqlite3_stmt *hStmt)
+{
+    DWORD i;
+    LPCSTR szDeclType;
+    PFCEXPORT_COLUMN pc;
+    ctx->cColumn = sqlite3_column_count(hStmt);
+    if(!ctx->cColumn || (ctx->cColumn > FCEXPORT_COLUMNS_MAX)) { return FALSE; }
+    for(i = 0; i < ctx->cColumn; i++) {
+        pc = ctx->Column + i;
+        pc->szName = (LPSTR)sqlite3_column_name(hStmt, i);
+        szDeclType = sqlite3_column_decltype(hStmt, i);
+        if(szDeclType && ((szDeclType[0] == 'I') || (szDeclType[0] == 'i'))) {
+            pc->tp = FCEXPORT_ARROW_TYPE_INT;
+            if(!(pc->pqw = LocalAlloc(0, FCEXPORT_BATCH_ROWS * sizeof(QWORD)))) { return FALSE; }
+        } else {
+            pc->tp = (szDeclType && ((szDeclType[0] == 'B') || (szDeclType[0] == 'b'))) ? FCEXPORT_ARROW_TYPE_BINARY : FCEXPORT_ARROW_TYPE_UTF8;
+            if(!(pc->pdwOffset = LocalAlloc(0, (FCEXPORT_BATCH_ROWS + 1) * sizeof(DWORD)))) { return FALSE; }
+            if(!(pc->pb = LocalAlloc(0, FCEXPORT_BATCH_CB))) { return FALSE; }
+        }
+        if(!pc->szName) { return FALSE; }
+    }
+    return TRUE;
+}
+
+/*
+* Append the current result row to the row buffers. If a variable length value
+* does not fit the buffered rows are flushed as a record batch first.
+* -- ctx
+* -- hStmt
+* -- return
+*/
+_Success_(return)
+BOOL FcExport_AppendRow(_In_ PFCEXPORT_CONTEXT ctx, _In_ sqlite3_stmt *hStmt)
+{
+    DWORD i, cb[FCEXPORT_COLUMNS_MAX];
+    PVOID pv[FCEXPORT_COLUMNS_MAX];
+    PFCEXPORT_COLUMN pc;
+    BOOL fFlush = FALSE;
+    // 1: retrieve variable length values and check if row fits in batch.
+    for(i = 0; i < ctx->cColumn; i++) {
+        pc = ctx->Column + i;
+        if(pc->tp == FCEXPORT_ARROW_TYPE_INT) { continue; }
+        pv[i] = (pc->tp == FCEXPORT_ARROW_TYPE_UTF8) ? (PVOID)sqlite3_column_text(hStmt, i) : (PVOID)sqlite3_column_blob(hStmt, i);
+        cb[i] = pv[i] ? sqlite3_column_bytes(hStmt, i) : 0;
+        if(cb[i] > FCEXPORT_BATCH_CB) { return FALSE; }
+        if(pc->cb + cb[i] > FCEXPORT_BATCH_CB) { fFlush = TRUE; }
+    }
+    if(fFlush) {
+        FcExport_WriteBatch(ctx);
+    }
+    // 2: append row.
+    for(i = 0; i < ctx->cColumn; i++) {
+        pc = ctx->Column + i;
+        if(pc->tp == FCEXPORT_ARROW_TYPE_INT) {
+            pc->pqw[ctx->cRow] = sqlite3_column_int64(hStmt, i);
+        } else {
+            pc->pdwOffset[ctx->cRow] = pc->cb;
+            if(cb[i]) {
+                memcpy(pc->pb + pc->cb, pv[i], cb[i]);
+            }
+            pc->cb += cb[i];
+            pc->pdwOffset[ctx->cRow + 1] = pc->cb;
+        }
+    }
+    if(++ctx->cRow == FCEXPORT_BATCH_ROWS) {
+        FcExport_WriteBatch(ctx);
+    }
+    return !ctx->fError;
+}
+
+/*
+* Export a forensic database table to a file in the Apache Arrow IPC streaming
+* format. The table is streamed from the database in record batches.
+* -- szTable = timeline, ntfs, process, thread, registry, pattern or pfn.
+* -- wszFileName
+* -- return
+*/
+_Success_(return)
+BOOL FcExport_Table(_In_ LPSTR szTable, _In_ LPWSTR wszFileName)
+{
+    int rc = SQLITE_ERROR;
+    DWORD i, dwEOS[2] = { 0xffffffff, 0 };
+    BOOL fResult = FALSE;
+    LPSTR szSql = NULL;
+    PFCEXPORT_CONTEXT ctx = NULL;
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hStmt = NULL;
+    for(i = 0; i < _countof(FCEXPORT_TABLES); i++) {
+        if(!_stricmp(szTable, FCEXPORT_TABLES[i].szName)) {
+            szSql = FCEXPORT_TABLES[i].szSql;
+            break;
+        }
+    }
+    if(!szSql) { return FALSE; }
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(FCEXPORT_CONTEXT)))) { return FALSE; }
+    ctx->hFile = CreateFileW(wszFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(ctx->hFile == INVALID_HANDLE_VALUE) { goto fail; }
+    if(!(hSql = Fc_SqlReserve())) { goto fail; }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, szSql, -1, &hStmt, NULL)) { goto fail; }
+    if(!FcExport_InitializeColumns(ctx, hStmt)) { goto fail; }
+    FcExport_WriteSchema(ctx);
+    while(!ctx->fError && (SQLITE_ROW == (rc = sqlite3_step(hStmt)))) {
+        if(!FcExport_AppendRow(ctx, hStmt)) { goto fail; }
+    }
+    if(rc != SQLITE_DONE) { goto fail; }
+    FcExport_WriteBatch(ctx);
+    FcExport_FileWrite(ctx, dwEOS, sizeof(dwEOS));
+    fResult = !ctx->fError;
+fail:
+    sqlite3_finalize(hStmt);
+    Fc_SqlReserveReturn(hSql);
+    for(i = 0; i < FCEXPORT_COLUMNS_MAX; i++) {
+        LocalFree(ctx->Column[i].pqw);
+        LocalFree(ctx->Column[i].pdwOffset);
+        LocalFree(ctx->Column[i].pb);
+    }
+    if(ctx->hFile && (ctx->hFile != INVALID_HANDLE_VALUE)) {
+        CloseHandle(ctx->hFile);
+        if(!fResult) { DeleteFileW(wszFileName); }
+    }
+    LocalFree(ctx);
+    return fResult;
+}
@@ -12,6 +12,7 @@
 #include "mm_pfn.h"
 #include "pluginmanager.h"
 #include "util.h"
+#include <intrin.h>
 
 //-----------------------------------------------------------------------------
 // NTFS MFT WINDOWS DEFINES AND TYPEDEFS BELOW:
@@ -184,6 +185,7 @@ typedef struct tdFCNTFS_COUNTX {
 } FCNTFS_COUNTX, *PFCNTFS_COUNTX;
 
 #define NTFS_LAST_VA_MAX    0x40
+#define FCNTFS_SETUP_PREFETCH_DISTANCE      8       // # pages ahead to prefetch in the chunk filter
 
 typedef struct tdFCNTFS_SETUP_CONTEXT {
     CRITICAL_SECTION LockUpdate;
@@ -417,17 +419,40 @@ VOID FcNtfs_SetupMftEntry(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ QWORD qwPhysicalA
     );
 }
 
+/*
+* Retrieve the 1kB MFT record slots of a page that are candidates for parsing.
+* The four record signatures are compared in one SSE2 operation and only the
+* slots with a 'FILE' signature have their header sanity checked. This is the
+* prefilter of the scalar record parser - it does not require any locks.
+* -- pbPage
+* -- return = bit mask of candidate record slots (bit0 = offset 0x000 .. bit3 = offset 0xc00).
+*/
+DWORD FcNtfs_SetupMftPageCandidates(_In_reads_(0x1000) PBYTE pbPage)
+{
+    DWORD i, dwMask;
+    PNTFS_FILE_RECORD pr;
+    __m128i vSig = _mm_set_epi32(*(PDWORD)(pbPage + 0xc00), *(PDWORD)(pbPage + 0x800), *(PDWORD)(pbPage + 0x400), *(PDWORD)pbPage);
+    dwMask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(vSig, _mm_set1_epi32('ELIF'))));
+    for(i = 0; i < 4; i++) {
+        if(!(dwMask & (1 << i))) { continue; }
+        pr = (PNTFS_FILE_RECORD)(pbPage + ((QWORD)i << 10));
+        if((pr->UpdateSequenceArrayOffset > 0x100) || (pr->UpdateSequenceArraySize > 0x100) || pr->BaseFileRecordSegment.SegmentNumber || (pr->FirstAttributeOffset > 0x300)) {
+            dwMask &= ~(1 << i);
+        }
+    }
+    return dwMask;
+}
+
 /*
 * Try add a physical memory page to the NTFS MFT dataset.
 * -- ctx
 * -- pa
 * -- pbPage
+* -- dwMask = candidate record slots as retrieved by FcNtfs_SetupMftPageCandidates().
 */
-VOID FcNtfs_SetupMftPage(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ QWORD pa, _In_reads_(0x1000) PBYTE pbPage)
+VOID FcNtfs_SetupMftPage(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ QWORD pa, _In_reads_(0x1000) PBYTE pbPage, _In_ DWORD dwMask)
 {
     QWORD i, va = 0;
-    PNTFS_FILE_RECORD pr;
-    if(*(PDWORD)pbPage != 'ELIF') { return; }     // file signature
     // virtual address correlation is effective for reducing the number of file
     // system fragments and hence lowers the risk of incorrect mergers across
     // file systems if multiple file systems exists. But it's very resource
@@ -444,18 +469,17 @@ VOID FcNtfs_SetupMftPage(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ QWORD pa, _In_read
     }
     */
     for(i = 0; i < 0x1000; i += 0x400) {
-        pr = (PNTFS_FILE_RECORD)(pbPage + i);
-        if(pr->Signature != 'ELIF') { continue; }
-        if((pr->UpdateSequenceArrayOffset > 0x100) || (pr->UpdateSequenceArraySize > 0x100)) { continue; }
-        if(pr->BaseFileRecordSegment.SegmentNumber) { continue; }
-        if(pr->FirstAttributeOffset > 0x300) { continue; }
-        FcNtfs_SetupMftEntry(ctx, pa + i, (va ? va + i : 0), pbPage + i);
+        if(dwMask & (1 << (i >> 10))) {
+            FcNtfs_SetupMftEntry(ctx, pa + i, (va ? va + i : 0), pbPage + i);
+        }
     }
 }
 
 /*
 * Filter incoming POB_FC_SCANPHYSMEM_CHUNK to retrieve potential MFT entry
-* physical page addresses and their data in a map [pa -> pb].
+* physical page addresses and their data in a map [pa | candidate mask -> pb].
+* The candidate record slot mask is stored in the low bits of the page aligned
+* physical address key so that the prefilter is only run once per page.
 * CALLER DECREF: return
 * -- pc
 * -- return = MAP or NULL if no candidate pages found.
@@ -463,12 +487,17 @@ VOID FcNtfs_SetupMftPage(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ QWORD pa, _In_read
 POB_MAP FcNtfs_SetupGetValidAddrMap(_In_ POB_FC_SCANPHYSMEM_CHUNK pc)
 {
     BOOL fPfnValidForMft;
-    DWORD i;
+    DWORD i, dwMask;
     POB_MAP pmObAddr;
     PMMPFN_MAP_ENTRY pePfn;
     if(!(pmObAddr = ObMap_New(0))) { return NULL; }
-    for(i = 0; i < 0x1000; i++) {
-        if((pc->ppMEMs[i]->qwA != (QWORD)-1) && pc->ppMEMs[i]->f && (pc->ppMEMs[i]->cb == 0x1000) && (*(PDWORD)pc->ppMEMs[i]->pb == 'ELIF')) {
+    for(i = 0; i < pc->cMEMs; i++) {
+        // the chunk pages are individual scatter buffers - prefetch the first
+        // cache line of an upcoming page since the scan is memory bound.
+        if(i + FCNTFS_SETUP_PREFETCH_DISTANCE < pc->cMEMs) {
+            _mm_prefetch((const char*)pc->ppMEMs[i + FCNTFS_SETUP_PREFETCH_DISTANCE]->pb, _MM_HINT_T0);
+        }
+        if((pc->ppMEMs[i]->qwA != (QWORD)-1) && pc->ppMEMs[i]->f && (pc->ppMEMs[i]->cb == 0x1000) && (*(PDWORD)pc->ppMEMs[i]->pb == 'ELIF') && (dwMask = FcNtfs_SetupMftPageCandidates(pc->ppMEMs[i]->pb))) {
             pePfn = (pc->pPfnMap && (i < pc->pPfnMap->cMap)) ? (pc->pPfnMap->pMap + i) : NULL;
             fPfnValidForMft =
                 !pePfn || (pePfn->dwPfn != (pc->ppMEMs[i]->qwA >> 12)) ||
@@ -478,7 +507,7 @@ POB_MAP FcNtfs_SetupGetValidAddrMap(_In_ POB_FC_SCANPHYSMEM_CHUNK pc)
                 (pePfn->PageLocation == MmPfnTypeTransition) ||
                 ((pePfn->PageLocation == MmPfnTypeActive) && (pePfn->Priority == 5));
             if(fPfnValidForMft) {
-                ObMap_Push(pmObAddr, pc->ppMEMs[i]->qwA, pc->ppMEMs[i]->pb);
+                ObMap_Push(pmObAddr, (pc->ppMEMs[i]->qwA & ~0xfff) | dwMask, pc->ppMEMs[i]->pb);
             }
         }
     }
@@ -490,22 +519,22 @@ POB_MAP FcNtfs_SetupGetValidAddrMap(_In_ POB_FC_SCANPHYSMEM_CHUNK pc)
 }
 
 /*
-* Analyze a POB_FC_SCANPHYSMEM_CHUNK 16MB memory chunk for MFT file candidates
-* and add any found to the internal data sets. This function is meant to be
-* called asynchronously by a worker thread (VmmWork). Function is thread-safe.
+* Analyze a POB_FC_SCANPHYSMEM_CHUNK memory chunk for MFT file candidates and
+* add any found to the internal data sets. This function is meant to be called
+* asynchronously by a worker thread (VmmWork). Function is thread-safe; chunks
+* are filtered in parallel and only candidate pages are added under lock.
 * -- pc
 */
 VOID FcNtfs_Setup_ThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc)
 {
-    QWORD pa;
+    QWORD qwKey;
     PBYTE pb;
     POB_MAP pmObAddr;
     PFCNTFS_SETUP_CONTEXT ctx = (PFCNTFS_SETUP_CONTEXT)pc->ctx_NTFS;
+    if(!(pmObAddr = FcNtfs_SetupGetValidAddrMap(pc))) { return; }
     EnterCriticalSection(&ctx->LockUpdate);
-    if((pmObAddr = FcNtfs_SetupGetValidAddrMap(pc))) {
-        while((pb = ObMap_PopWithKey(pmObAddr, &pa))) {
-            FcNtfs_SetupMftPage(ctx, pa, pb);
-        }
+    while((pb = ObMap_PopWithKey(pmObAddr, &qwKey))) {
+        FcNtfs_SetupMftPage(ctx, qwKey & ~0xfff, pb, (DWORD)(qwKey & 0xf));
     }
     LeaveCriticalSection(&ctx->LockUpdate);
     Ob_DECREF(pmObAddr);
@@ -984,10 +1013,24 @@ fail:
     sqlite3_finalize(ctxFinal.st);
     sqlite3_finalize(ctxFinal.st_str);
     Fc_SqlReserveReturn(ctxFinal.hSql);
+    Fc_SqlMemorySpillCheck();
     Ob_DECREF(psObHashPath);
     FcNtfs_SetupClose(ctx);
 }
 
+/*
+* Build the in-memory utf-8 file offset index of the ntfs info file so that
+* file reads may locate entries without querying the database.
+*/
+VOID FcNtfs_InitializeOffsetIndex()
+{
+    if(!ctxFc->fEnableNtfs || ctxFc->Ntfs.pObIndex) { return; }
+    ctxFc->Ntfs.pObIndex = FcOffsetIndex_Create(
+        "SELECT COUNT(*), MIN(id) FROM ntfs",
+        "SELECT id, oln_u FROM ntfs ORDER BY id",
+        0, NULL);
+}
+
 
 
 //-----------------------------------------------------------------------------
@@ -1036,6 +1079,74 @@ BOOL FcNtfs_GetMftResidentData(_In_ PFC_MAP_NTFSENTRY pNtfsEntry, _Out_writes_op
     return FALSE;
 }
 
+/*
+* Evict directory listings from the cache until cbExtra additional bytes fits
+* within the memory budget (second-chance clock, see VmmCacheClockEvict).
+* NB! caller must hold ctxFc->Ntfs.DirCache.Lock.
+* -- cbExtra
+*/
+VOID FcNtfs_DirCache_EvictBudget(_In_ QWORD cbExtra)
+{
+    VmmCacheClockEvict(ctxFc->Ntfs.DirCache.pm, ctxFc->Ntfs.DirCache.psReferenced, &ctxFc->Ntfs.DirCache.iClock, &ctxFc->Ntfs.DirCache.cb, ctxFc->Ntfs.DirCache.cbMax, cbExtra, FC_NTFS_DIRCACHE_CB_OVERHEAD);
+}
+
+/*
+* Insert a directory listing into the memory budgeted directory cache. Only
+* completed forensic databases are cached since the listing is otherwise not
+* yet final.
+* -- qwHashParent
+* -- e
+*/
+VOID FcNtfs_DirCache_Push(_In_ QWORD qwHashParent, _In_ PFCOB_MAP_NTFS e)
+{
+    QWORD cb = FC_NTFS_DIRCACHE_CB_OVERHEAD + e->ObHdr.cbData;
+    if(!ctxFc->fInitFinish || !ctxFc->Ntfs.DirCache.pm || (cb > ctxFc->Ntfs.DirCache.cbMax)) { return; }
+    EnterCriticalSection(&ctxFc->Ntfs.DirCache.Lock);
+    if(!ObMap_ExistsKey(ctxFc->Ntfs.DirCache.pm, qwHashParent)) {
+        FcNtfs_DirCache_EvictBudget(cb);
+        if(ObMap_Push(ctxFc->Ntfs.DirCache.pm, qwHashParent, e)) {
+            ctxFc->Ntfs.DirCache.cb += cb;
+        }
+    }
+    LeaveCriticalSection(&ctxFc->Ntfs.DirCache.Lock);
+}
+
+/*
+* Retrieve a directory listing from the directory cache and mark it as
+* recently used.
+* CALLER DECREF: return
+* -- qwHashParent
+* -- return
+*/
+PFCOB_MAP_NTFS FcNtfs_DirCache_Get(_In_ QWORD qwHashParent)
+{
+    PFCOB_MAP_NTFS e;
+    if(!ctxFc->Ntfs.DirCache.pm) { return NULL; }
+    EnterCriticalSection(&ctxFc->Ntfs.DirCache.Lock);
+    if((e = ObMap_GetByKey(ctxFc->Ntfs.DirCache.pm, qwHashParent))) {
+        ObSet_Push(ctxFc->Ntfs.DirCache.psReferenced, qwHashParent);
+    }
+    LeaveCriticalSection(&ctxFc->Ntfs.DirCache.Lock);
+    return e;
+}
+
+VOID FcNtfs_DirCache_Initialize()
+{
+    InitializeCriticalSection(&ctxFc->Ntfs.DirCache.Lock);
+    ctxFc->Ntfs.DirCache.cbMax = (QWORD)FC_NTFS_DIRCACHE_MB << 20;
+    ctxFc->Ntfs.DirCache.pm = ObMap_New(OB_MAP_FLAGS_OBJECT_OB);
+    ctxFc->Ntfs.DirCache.psReferenced = ObSet_New();
+}
+
+VOID FcNtfs_DirCache_Close()
+{
+    if(!ctxFc->Ntfs.DirCache.cbMax) { return; }
+    Ob_DECREF_NULL(&ctxFc->Ntfs.DirCache.pm);
+    Ob_DECREF_NULL(&ctxFc->Ntfs.DirCache.psReferenced);
+    DeleteCriticalSection(&ctxFc->Ntfs.DirCache.Lock);
+    ctxFc->Ntfs.DirCache.cbMax = 0;
+}
+
 #define FCNTFS_SQL_SELECT_FIELDS " csz, osz, sz, id, id_parent, addr_phys, inode, mft_flags, depth, name_seq, time_create, time_modify, time_read, size_file, size_fileres, oln_u, oln_j "
 
 _Success_(return)
@@ -1125,7 +1236,8 @@ BOOL FcNtfsMap_GetFromHash(_In_ QWORD qwHash, _Out_ PFCOB_MAP_NTFS *ppObNtfsMap)
 
 /*
 * Retrieve a FCOB_MAP_NTFS map object containing entries which have the same
-* file system parent given by its parent hash.
+* file system parent given by its parent hash. Once forensic initialization
+* has completed listings are served from a memory budgeted cache.
 * -- qwHashParent
 * -- ppObNtfsMap
 * -- return
@@ -1133,13 +1245,17 @@ BOOL FcNtfsMap_GetFromHash(_In_ QWORD qwHash, _Out_ PFCOB_MAP_NTFS *ppObNtfsMap)
 _Success_(return)
 BOOL FcNtfsMap_GetFromHashParent(_In_ QWORD qwHashParent, _Out_ PFCOB_MAP_NTFS *ppObNtfsMap)
 {
-    return FcNtfsMap_CreateInternal(
+    if((*ppObNtfsMap = FcNtfs_DirCache_Get(qwHashParent))) { return TRUE; }
+    if(!FcNtfsMap_CreateInternal(
         "SELECT COUNT(*), SUM(csz) FROM v_ntfs WHERE hash_parent = ?",
         "SELECT "FCNTFS_SQL_SELECT_FIELDS" FROM v_ntfs WHERE hash_parent = ?",
         1,
         &qwHashParent,
-        ppObNtfsMap
-    );
+        ppObNtfsMap)) {
+        return FALSE;
+    }
+    FcNtfs_DirCache_Push(qwHashParent, *ppObNtfsMap);
+    return TRUE;
 }
 
 /*
@@ -1162,6 +1278,46 @@ BOOL FcNtfsMap_GetFromIdRange(_In_ QWORD qwId, _In_ QWORD cId, _Out_ PFCOB_MAP_N
     );
 }
 
+/*
+* Retrieve a FCOB_MAP_NTFS map object containing at least the entries within
+* the range [qwId, qwId + cId). Entries are fetched in batches to serve most
+* sequential file reads from the previously fetched map. Only batches with
+* contiguous ids are kept - if the ids of a batch have gaps the requested
+* range is fetched as-is and the map index is then always zero.
+* -- qwId
+* -- cId
+* -- ppObNtfsMap
+* -- piMap = index of the entry with id qwId in the map.
+* -- return
+*/
+_Success_(return)
+BOOL FcNtfsMap_GetFromIdRangeBatch(_In_ QWORD qwId, _In_ QWORD cId, _Out_ PFCOB_MAP_NTFS *ppObNtfsMap, _Out_ PDWORD piMap)
+{
+    PFCOB_MAP_NTFS pObMap = ObContainer_GetOb(ctxFc->Ntfs.pObCMapBatch);
+    if(!pObMap || !pObMap->cMap || (qwId < pObMap->pMap[0].qwId) || (qwId + cId > pObMap->pMap[0].qwId + pObMap->cMap)) {
+        Ob_DECREF_NULL(&pObMap);
+        if(!FcNtfsMap_GetFromIdRange(qwId, max(cId, FC_MAP_BATCH_ENTRIES), &pObMap) || !pObMap->cMap) {
+            Ob_DECREF(pObMap);
+            return FALSE;
+        }
+        if((pObMap->pMap[0].qwId != qwId) || (pObMap->pMap[pObMap->cMap - 1].qwId - pObMap->pMap[0].qwId != pObMap->cMap - 1)) {
+            // ids are not contiguous -> per-range lookup without batching.
+            Ob_DECREF_NULL(&pObMap);
+            if(!FcNtfsMap_GetFromIdRange(qwId, cId, &pObMap) || !pObMap->cMap) {
+                Ob_DECREF(pObMap);
+                return FALSE;
+            }
+            *piMap = 0;
+            *ppObNtfsMap = pObMap;
+            return TRUE;
+        }
+        ObContainer_SetOb(ctxFc->Ntfs.pObCMapBatch, pObMap);
+    }
+    *piMap = (DWORD)(qwId - pObMap->pMap[0].qwId);
+    *ppObNtfsMap = pObMap;
+    return TRUE;
+}
+
 /*
 * Retieve the file size of the ntfs information file either in JSON or UTF8.
 * -- pcRecords = number of entries/lines/records.
@@ -1191,6 +1347,10 @@ BOOL FcNtfs_GetFileSize(_Out_opt_ PQWORD pcRecords, _Out_opt_ PQWORD pcbUTF8, _O
 _Success_(return)
 BOOL FcNtfs_GetIdFromPosition(_In_ QWORD qwFilePos, _In_ BOOL fJSON, _Out_ PQWORD pqwId)
 {
+    if(!fJSON && ctxFc->Ntfs.pObIndex) {
+        *pqwId = FcOffsetIndex_GetId(ctxFc->Ntfs.pObIndex, qwFilePos);
+        return TRUE;
+    }
     QWORD v[] = { max(2048, qwFilePos) - 2048, qwFilePos};
     return fJSON ?
         (SQLITE_OK == Fc_SqlQueryN("SELECT MAX(id) FROM ntfs WHERE oln_j >= ? AND oln_j <= ?", 2, v, 1, pqwId, NULL)) :
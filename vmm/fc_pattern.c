@@ -0,0 +1,373 @@
+// fc_pattern.c : implementation of the forensic multi-pattern physical memory
+//                scanner consumer.
+//
+// User supplied byte- and string signatures are loaded from the file given in
+// the -forensicpattern option and compiled into an Aho-Corasick automaton. The
+// automaton is run over every page of the forensic physical memory scan in the
+// same pass as the other scan consumers. Hits are attributed to a process and
+// virtual address (when known from the PFN database) and saved to the forensic
+// database table 'pattern'.
+//
+// Pattern file format - one pattern per line, '#' starts a comment line:
+//   <name> hex   <hex bytes>       example: mz_header hex 4d5a9000
+//   <name> ascii <text>            example: pwd_prompt ascii Password:
+//   <name> utf16 <text>            example: pwd_prompt_w utf16 Password:
+//
+// (c) MemProcFS contributors, 2020
+// Author: MemProcFS contributors
+//
+
+#include "fc.h"
+#include "vmm.h"
+#include "mm_pfn.h"
+#include "util.h"
+
+#define FCPATTERN_FILE_SIZE_MAX         0x00100000
+#define FCPATTERN_HITS_PER_BUFFER       0x1000
+
+typedef struct tdFCPATTERN_ENTRY {
+    CHAR szName[FC_PATTERN_NAME_MAX];
+    DWORD cb;
+    BYTE pb[FC_PATTERN_LENGTH_MAX];
+} FCPATTERN_ENTRY, *PFCPATTERN_ENTRY;
+
+typedef struct tdFCPATTERN_STATE {
+    DWORD dwNext[256];          // automaton transition (failure transitions already resolved)
+    DWORD dwOut;                // next state in suffix chain which ends a pattern (0 = none)
+    WORD iPattern;              // pattern index + 1 ending in this state (0 = none)
+    WORD fOutput;               // pattern ends in this state or in its suffix chain
+} FCPATTERN_STATE, *PFCPATTERN_STATE;
+
+typedef struct tdFCPATTERN_HIT {
+    QWORD pa;
+    QWORD va;
+    DWORD dwPid;
+    WORD iPattern;
+    BYTE tp;
+    BYTE tpex;
+} FCPATTERN_HIT, *PFCPATTERN_HIT;
+
+typedef struct tdFCPATTERN_HIT_BUFFER {
+    struct tdFCPATTERN_HIT_BUFFER *FLink;
+    DWORD c;
+    FCPATTERN_HIT e[FCPATTERN_HITS_PER_BUFFER];
+} FCPATTERN_HIT_BUFFER, *PFCPATTERN_HIT_BUFFER;
+
+typedef struct tdFCPATTERN_SETUP_CONTEXT {
+    PFCPATTERN_HIT_BUFFER volatile pBufferHead;     // lock-free list of per-chunk results
+    DWORD volatile cHit;
+    DWORD cPattern;
+    DWORD cState;
+    PFCPATTERN_ENTRY pPattern;
+    PFCPATTERN_STATE pState;
+} FCPATTERN_SETUP_CONTEXT, *PFCPATTERN_SETUP_CONTEXT;
+
+VOID FcPattern_SetupClose(_Frees_ptr_opt_ PFCPATTERN_SETUP_CONTEXT ctx)
+{
+    PFCPATTERN_HIT_BUFFER pBuffer;
+    if(!ctx) { return; }
+    while((pBuffer = ctx->pBufferHead)) {
+        ctx->pBufferHead = pBuffer->FLink;
+        LocalFree(pBuffer);
+    }
+    LocalFree(ctx->pPattern);
+    LocalFree(ctx->pState);
+    LocalFree(ctx);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// PATTERN FILE PARSING AND AUTOMATON BUILD FUNCTIONALITY BELOW:
+// ----------------------------------------------------------------------------
+
+/*
+* Parse a single pattern file line into a pattern entry.
+* -- szLine = the line, modified by the function.
+* -- pe
+* -- return
+*/
+_Success_(return)
+BOOL FcPattern_ParseLine(_In_ LPSTR szLine, _Out_ PFCPATTERN_ENTRY pe)
+{
+    LPSTR szName, szType, szValue, szContext = NULL;
+    DWORD i, cch;
+    CHAR ch;
+    ZeroMemory(pe, sizeof(FCPATTERN_ENTRY));
+    if(!(szName = strtok_s(szLine, " \t", &szContext))) { return FALSE; }
+    if(!(szType = strtok_s(NULL, " \t", &szContext))) { return FALSE; }
+    szValue = szContext;
+    while(szValue && ((szValue[0] == ' ') || (szValue[0] == '\t'))) { szValue++; }
+    if(!szValue || !szValue[0]) { return FALSE; }
+    strncpy_s(pe->szName, _countof(pe->szName), szName, _TRUNCATE);
+    cch = (DWORD)strlen(szValue);
+    if(!_stricmp(szType, "ascii")) {
+        if(cch > FC_PATTERN_LENGTH_MAX) { return FALSE; }
+        memcpy(pe->pb, szValue, cch);
+        pe->cb = cch;
+        return TRUE;
+    }
+    if(!_stricmp(szType, "utf16")) {
+        if(2 * cch > FC_PATTERN_LENGTH_MAX) { return FALSE; }
+        for(i = 0; i < cch; i++) {
+            pe->pb[2 * i] = szValue[i];
+        }
+        pe->cb = 2 * cch;
+        return TRUE;
+    }
+    if(!_stricmp(szType, "hex")) {
+        for(i = 0; i < cch; i++) {
+            ch = szValue[i];
+            if((ch == ' ') || (ch == '\t')) { continue; }
+            if(!isxdigit((UCHAR)ch) || (pe->cb >= 2 * FC_PATTERN_LENGTH_MAX)) { return FALSE; }
+            ch = (ch <= '9') ? (ch - '0') : ((ch | 0x20) - 'a' + 10);
+            pe->pb[pe->cb >> 1] |= (pe->cb & 1) ? ch : (ch << 4);
+            pe->cb++;
+        }
+        if(!pe->cb || (pe->cb & 1)) { return FALSE; }
+        pe->cb >>= 1;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+* Load all patterns from the pattern file given in the configuration.
+* -- ctx
+* -- return
+*/
+_Success_(return)
+BOOL FcPattern_LoadFile(_In_ PFCPATTERN_SETUP_CONTEXT ctx)
+{
+    BOOL fResult = FALSE;
+    FILE *hFile = NULL;
+    DWORD i, cb, iLine = 0;
+    LPSTR sz = NULL, szLine, szContext = NULL;
+    if(!(sz = LocalAlloc(LMEM_ZEROINIT, FCPATTERN_FILE_SIZE_MAX + 1))) { goto fail; }
+    if(fopen_s(&hFile, ctxMain->cfg.szForensicPattern, "rb") || !hFile) { goto fail; }
+    cb = (DWORD)fread(sz, 1, FCPATTERN_FILE_SIZE_MAX, hFile);
+    if(!cb || (cb == FCPATTERN_FILE_SIZE_MAX)) { goto fail; }
+    if(!(ctx->pPattern = LocalAlloc(LMEM_ZEROINIT, FC_PATTERN_MAX * sizeof(FCPATTERN_ENTRY)))) { goto fail; }
+    szLine = strtok_s(sz, "\r\n", &szContext);
+    while(szLine) {
+        iLine++;
+        if(szLine[0] && (szLine[0] != '#')) {
+            if(ctx->cPattern == FC_PATTERN_MAX) {
+                vmmprintf("FORENSIC: Pattern file: too many patterns - max %i allowed.\n", FC_PATTERN_MAX);
+                break;
+            }
+            if(!FcPattern_ParseLine(szLine, ctx->pPattern + ctx->cPattern)) {
+                vmmprintf("FORENSIC: Pattern file: invalid pattern on line %i - skipping.\n", iLine);
+            } else {
+                for(i = 0; i < ctx->cPattern; i++) {
+                    if((ctx->pPattern[i].cb == ctx->pPattern[ctx->cPattern].cb) && !memcmp(ctx->pPattern[i].pb, ctx->pPattern[ctx->cPattern].pb, ctx->pPattern[i].cb)) { break; }
+                }
+                if(i == ctx->cPattern) {
+                    ctx->cPattern++;
+                } else {
+                    vmmprintf("FORENSIC: Pattern file: duplicate pattern on line %i - skipping.\n", iLine);
+                }
+            }
+        }
+        szLine = strtok_s(NULL, "\r\n", &szContext);
+    }
+    fResult = (ctx->cPattern > 0);
+fail:
+    if(hFile) { fclose(hFile); }
+    LocalFree(sz);
+    return fResult;
+}
+
+/*
+* Build the Aho-Corasick automaton from the loaded patterns. All failure
+* transitions are resolved at build time so that the scan is one transition
+* table lookup per byte.
+* -- ctx
+* -- return
+*/
+_Success_(return)
+BOOL FcPattern_BuildAutomaton(_In_ PFCPATTERN_SETUP_CONTEXT ctx)
+{
+    BOOL fResult = FALSE;
+    DWORD i, j, c, s, r, u, cStateMax = 1, iQueueHead = 0, iQueueTail = 0;
+    PDWORD pdwFail = NULL, pdwQueue = NULL;
+    PFCPATTERN_STATE pState;
+    for(i = 0; i < ctx->cPattern; i++) {
+        cStateMax += ctx->pPattern[i].cb;
+    }
+    if(!(ctx->pState = LocalAlloc(LMEM_ZEROINIT, cStateMax * sizeof(FCPATTERN_STATE)))) { goto fail; }
+    if(!(pdwFail = LocalAlloc(LMEM_ZEROINIT, 2ULL * cStateMax * sizeof(DWORD)))) { goto fail; }
+    pdwQueue = pdwFail + cStateMax;
+    pState = ctx->pState;
+    ctx->cState = 1;
+    // 1: build trie
+    for(i = 0; i < ctx->cPattern; i++) {
+        for(j = 0, s = 0; j < ctx->pPattern[i].cb; j++) {
+            c = ctx->pPattern[i].pb[j];
+            if(!pState[s].dwNext[c]) {
+                pState[s].dwNext[c] = ctx->cState++;
+            }
+            s = pState[s].dwNext[c];
+        }
+        pState[s].iPattern = (WORD)(i + 1);
+        pState[s].fOutput = TRUE;
+    }
+    // 2: breadth-first resolve of failure links and transitions
+    for(c = 0; c < 256; c++) {
+        if((u = pState[0].dwNext[c])) {
+            pdwFail[u] = 0;
+            pdwQueue[iQueueTail++] = u;
+        }
+    }
+    while(iQueueHead < iQueueTail) {
+        r = pdwQueue[iQueueHead++];
+        for(c = 0; c < 256; c++) {
+            if((u = pState[r].dwNext[c])) {
+                pdwFail[u] = pState[pdwFail[r]].dwNext[c];
+                pState[u].dwOut = pState[pdwFail[u]].iPattern ? pdwFail[u] : pState[pdwFail[u]].dwOut;
+                pState[u].fOutput = pState[u].iPattern || pState[u].dwOut;
+                pdwQueue[iQueueTail++] = u;
+            } else {
+                pState[r].dwNext[c] = pState[pdwFail[r]].dwNext[c];
+            }
+        }
+    }
+    fResult = TRUE;
+fail:
+    LocalFree(pdwFail);
+    return fResult;
+}
+
+/*
+* Initialize a new PFCPATTERN_SETUP_CONTEXT from the pattern file given by the
+* -forensicpattern configuration option.
+* -- return = the initialized context, or NULL on fail or if not configured.
+*/
+PVOID FcPattern_SetupInitialize()
+{
+    PFCPATTERN_SETUP_CONTEXT ctx = NULL;
+    if(!ctxMain->cfg.szForensicPattern[0]) { return NULL; }
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(FCPATTERN_SETUP_CONTEXT)))) { goto fail; }
+    if(!FcPattern_LoadFile(ctx)) {
+        vmmprintf("FORENSIC: Failed to load patterns from: '%s'.\n", ctxMain->cfg.szForensicPattern);
+        goto fail;
+    }
+    if(!FcPattern_BuildAutomaton(ctx)) { goto fail; }
+    vmmprintfv("FORENSIC: Pattern scan: %i patterns, %i automaton states.\n", ctx->cPattern, ctx->cState);
+    return ctx;
+fail:
+    FcPattern_SetupClose(ctx);
+    return NULL;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// PATTERN SCAN FUNCTIONALITY BELOW:
+// ----------------------------------------------------------------------------
+
+/*
+* Push a hit buffer onto the lock-free result list of the context.
+*/
+VOID FcPattern_SetupPushBuffer(_In_ PFCPATTERN_SETUP_CONTEXT ctx, _In_ PFCPATTERN_HIT_BUFFER pBuffer)
+{
+    do {
+        pBuffer->FLink = ctx->pBufferHead;
+    } while(InterlockedCompareExchangePointer((PVOID volatile*)&ctx->pBufferHead, pBuffer, pBuffer->FLink) != pBuffer->FLink);
+}
+
+/*
+* Scan a POB_FC_SCANPHYSMEM_CHUNK memory chunk for all patterns. Hits are kept
+* in private buffers which are pushed onto a lock-free result list. Patterns
+* spanning a page boundary are not matched since physically adjacent pages are
+* usually unrelated. This function is meant to be called asynchronously by a
+* worker thread (VmmWork). Function is thread-safe.
+* -- pc
+*/
+VOID FcPattern_Setup_ThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc)
+{
+    PFCPATTERN_SETUP_CONTEXT ctx = (PFCPATTERN_SETUP_CONTEXT)pc->ctx_PATTERN;
+    PFCPATTERN_STATE pState = ctx->pState;
+    PFCPATTERN_HIT_BUFFER pBuffer = NULL;
+    PFCPATTERN_HIT pe;
+    PMMPFN_MAP_ENTRY pePfn;
+    PBYTE pb;
+    DWORD i, o, s, t;
+    QWORD pa;
+    for(i = 0; i < pc->cMEMs; i++) {
+        if((pc->ppMEMs[i]->qwA == (QWORD)-1) || !pc->ppMEMs[i]->f || (pc->ppMEMs[i]->cb != 0x1000)) { continue; }
+        pb = pc->ppMEMs[i]->pb;
+        for(o = 0, s = 0; o < 0x1000; o++) {
+            s = pState[s].dwNext[pb[o]];
+            if(!pState[s].fOutput) { continue; }
+            for(t = pState[s].iPattern ? s : pState[s].dwOut; t; t = pState[t].dwOut) {
+                // hit slot is claimed atomically - counts past the max mark truncation.
+                if(InterlockedIncrement(&ctx->cHit) > FC_PATTERN_HITS_MAX) { goto finish; }
+                if(!pBuffer || (pBuffer->c == FCPATTERN_HITS_PER_BUFFER)) {
+                    if(pBuffer) { FcPattern_SetupPushBuffer(ctx, pBuffer); }
+                    if(!(pBuffer = LocalAlloc(0, sizeof(FCPATTERN_HIT_BUFFER)))) { return; }
+                    pBuffer->c = 0;
+                }
+                pa = pc->ppMEMs[i]->qwA + o + 1 - ctx->pPattern[pState[t].iPattern - 1].cb;
+                pePfn = (pc->pPfnMap && (i < pc->pPfnMap->cMap)) ? (pc->pPfnMap->pMap + i) : NULL;
+                if(pePfn && (pePfn->dwPfn != (pc->ppMEMs[i]->qwA >> 12))) { pePfn = NULL; }
+                pe = pBuffer->e + pBuffer->c++;
+                pe->pa = pa;
+                pe->iPattern = pState[t].iPattern - 1;
+                pe->dwPid = pePfn ? pePfn->AddressInfo.dwPid : 0;
+                pe->va = (pePfn && pePfn->AddressInfo.va) ? (pePfn->AddressInfo.va + (pa & 0xfff)) : 0;
+                pe->tp = pePfn ? (BYTE)pePfn->PageLocation : 0;
+                pe->tpex = pePfn ? (BYTE)pePfn->tpExtended : 0;
+            }
+        }
+    }
+finish:
+    if(pBuffer) {
+        FcPattern_SetupPushBuffer(ctx, pBuffer);
+    }
+}
+
+/*
+* Finalize the pattern scan - save all hits to the forensic database.
+* -- pvSetupContextPattern
+* -- fScanSuccess
+*/
+VOID FcPattern_SetupFinalize(_In_opt_ PVOID pvSetupContextPattern, _In_ BOOL fScanSuccess)
+{
+    PFCPATTERN_SETUP_CONTEXT ctx = (PFCPATTERN_SETUP_CONTEXT)pvSetupContextPattern;
+    PFCPATTERN_HIT_BUFFER pBuffer;
+    PFCPATTERN_HIT pe;
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hStmt = NULL;
+    DWORD i;
+    if(!ctx || !fScanSuccess) { goto fail; }
+    if(ctx->cHit > FC_PATTERN_HITS_MAX) {
+        vmmprintf("FORENSIC: Pattern scan: hit limit reached - results are truncated.\n");
+    }
+    if(!(hSql = Fc_SqlReserve())) { goto fail; }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO pattern (name, pa, pid, va, tp, tpex) VALUES (?, ?, ?, ?, ?, ?);", -1, &hStmt, NULL)) { goto fail; }
+    sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    for(pBuffer = ctx->pBufferHead; pBuffer; pBuffer = pBuffer->FLink) {
+        for(i = 0; i < pBuffer->c; i++) {
+            pe = pBuffer->e + i;
+            sqlite3_reset(hStmt);
+            sqlite3_bind_text(hStmt, 1, ctx->pPattern[pe->iPattern].szName, -1, NULL);
+            Fc_SqlBindMultiInt64(hStmt, 2, 5,
+                pe->pa,
+                (QWORD)pe->dwPid,
+                pe->va,
+                (QWORD)pe->tp,
+                (QWORD)pe->tpex
+            );
+            sqlite3_step(hStmt);
+        }
+    }
+    sqlite3_exec(hSql, "COMMIT TRANSACTION", NULL, NULL, NULL);
+    vmmprintfv("FORENSIC: Pattern scan: %i hits.\n", min(ctx->cHit, FC_PATTERN_HITS_MAX));
+    ctxFc->fEnablePattern = TRUE;
+fail:
+    sqlite3_finalize(hStmt);
+    Fc_SqlReserveReturn(hSql);
+    Fc_SqlMemorySpillCheck();
+    FcPattern_SetupClose(ctx);
+}
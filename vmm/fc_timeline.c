@@ -1,8 +1,10 @@
 // fc_timeline.c : implementation of functions related to timelining.
 //
 // The timeline initialization should be run after all other forensic database
-// table populating actions have been run. The initialization process merges
-// various results into multiple timelines mostly by relying on sqlite queries.
+// table populating actions have been run. The initialization process collects
+// the timeline entries of each source (built-in tables and plugins) into an
+// in-memory run, sorts the runs in parallel and k-way merges them into the
+// timeline table while calculating the UTF-8/JSON line offsets on the fly.
 // Once the timeline is initialized various modules may query the timeline.
 //
 // (c) Ulf Frisk, 2020
@@ -11,13 +13,288 @@
 #include "fc.h"
 #include "pluginmanager.h"
 
+#define FCTIMELINE_RUN_ENTRIES_MIN      0x1000
+
+typedef struct tdFCTIMELINE_RUN_ENTRY {
+    QWORD ft;
+    QWORD data64;
+    QWORD id_str;
+    DWORD dwSeq;                // insertion order - tie-break for equal ft
+    DWORD tp;
+    DWORD ac;
+    DWORD pid;
+    DWORD cbu;
+    DWORD cbj;
+} FCTIMELINE_RUN_ENTRY, *PFCTIMELINE_RUN_ENTRY;
+
+typedef struct tdFCTIMELINE_RUN {
+    struct tdFCTIMELINE_RUN *FLink;
+    HANDLE hEventSorted;
+    DWORD c;
+    DWORD cMax;
+    PFCTIMELINE_RUN_ENTRY pe;
+} FCTIMELINE_RUN, *PFCTIMELINE_RUN;
+
+typedef struct tdFCTIMELINE_BUILD {
+    DWORD dwSeq;
+    DWORD cRun;
+    PFCTIMELINE_RUN pRunHead;
+} FCTIMELINE_BUILD, *PFCTIMELINE_BUILD;
+
 typedef struct tdFCTIMELINE_PLUGIN_CONTEXT {
     DWORD dwId;
     sqlite3 *hSql;
-    sqlite3_stmt *hStmt;
     sqlite3_stmt *hStmtStr;
+    PFCTIMELINE_RUN pRun;
 } FCTIMELINE_PLUGIN_CONTEXT, *PFCTIMELINE_PLUGIN_CONTEXT;
 
+
+
+// ----------------------------------------------------------------------------
+// TIMELINE RUN FUNCTIONALITY BELOW:
+// A run holds all entries of a single timeline source. Runs are sorted on
+// worker threads as soon as they are complete and are finally k-way merged.
+// ----------------------------------------------------------------------------
+
+/*
+* Allocate a new empty run and link it into the timeline build context.
+* -- pBuild
+* -- return = the run, owned by pBuild.
+*/
+PFCTIMELINE_RUN FcTimeline_RunNew(_In_ PFCTIMELINE_BUILD pBuild)
+{
+    PFCTIMELINE_RUN pRun;
+    if(!(pRun = LocalAlloc(LMEM_ZEROINIT, sizeof(FCTIMELINE_RUN)))) { return NULL; }
+    pRun->FLink = pBuild->pRunHead;
+    pBuild->pRunHead = pRun;
+    pBuild->cRun++;
+    return pRun;
+}
+
+/*
+* Append an entry to a run - growing the run if required.
+* -- pBuild
+* -- pRun
+* -- pe = the entry to copy, the dwSeq member is assigned by this function.
+* -- return
+*/
+_Success_(return)
+BOOL FcTimeline_RunAppend(_In_ PFCTIMELINE_BUILD pBuild, _In_ PFCTIMELINE_RUN pRun, _In_ PFCTIMELINE_RUN_ENTRY pe)
+{
+    DWORD cMaxNew;
+    PFCTIMELINE_RUN_ENTRY peNew;
+    if(pRun->c == pRun->cMax) {
+        cMaxNew = max(FCTIMELINE_RUN_ENTRIES_MIN, pRun->cMax << 1);
+        if(!(peNew = LocalAlloc(0, (SIZE_T)cMaxNew * sizeof(FCTIMELINE_RUN_ENTRY)))) { return FALSE; }
+        if(pRun->c) {
+            memcpy(peNew, pRun->pe, (SIZE_T)pRun->c * sizeof(FCTIMELINE_RUN_ENTRY));
+        }
+        LocalFree(pRun->pe);
+        pRun->pe = peNew;
+        pRun->cMax = cMaxNew;
+    }
+    pe->dwSeq = pBuild->dwSeq++;
+    pRun->pe[pRun->c++] = *pe;
+    return TRUE;
+}
+
+/*
+* qsort comparator - timeline order is newest first, then insertion order.
+*/
+int FcTimeline_RunCmp(const void *v1, const void *v2)
+{
+    PFCTIMELINE_RUN_ENTRY p1 = (PFCTIMELINE_RUN_ENTRY)v1;
+    PFCTIMELINE_RUN_ENTRY p2 = (PFCTIMELINE_RUN_ENTRY)v2;
+    if(p1->ft != p2->ft) { return (p1->ft > p2->ft) ? -1 : 1; }
+    return (p1->dwSeq < p2->dwSeq) ? -1 : ((p1->dwSeq > p2->dwSeq) ? 1 : 0);
+}
+
+VOID FcTimeline_RunSortThreadProc(_In_ PFCTIMELINE_RUN pRun)
+{
+    if(pRun->c > 1) {
+        qsort(pRun->pe, pRun->c, sizeof(FCTIMELINE_RUN_ENTRY), FcTimeline_RunCmp);
+    }
+}
+
+/*
+* Mark a run as complete and sort it on a worker thread. The sort completes
+* asynchronously - the caller must wait for pRun->hEventSorted (if set).
+* -- pRun
+*/
+VOID FcTimeline_RunComplete(_In_ PFCTIMELINE_RUN pRun)
+{
+    if(!(pRun->hEventSorted = CreateEvent(NULL, TRUE, FALSE, NULL))) {
+        FcTimeline_RunSortThreadProc(pRun);
+        return;
+    }
+    if(!VmmWorkEx((LPTHREAD_START_ROUTINE)FcTimeline_RunSortThreadProc, pRun, pRun->hEventSorted, VMMWORK_PRIORITY_NORMAL)) {
+        FcTimeline_RunSortThreadProc(pRun);
+        SetEvent(pRun->hEventSorted);
+    }
+}
+
+/*
+* Wait for all outstanding sorts to complete and free all runs.
+* -- pBuild
+*/
+VOID FcTimeline_RunFreeAll(_In_ PFCTIMELINE_BUILD pBuild)
+{
+    PFCTIMELINE_RUN pRun;
+    while((pRun = pBuild->pRunHead)) {
+        pBuild->pRunHead = pRun->FLink;
+        if(pRun->hEventSorted) {
+            WaitForSingleObject(pRun->hEventSorted, INFINITE);
+            CloseHandle(pRun->hEventSorted);
+        }
+        LocalFree(pRun->pe);
+        LocalFree(pRun);
+    }
+    pBuild->cRun = 0;
+}
+
+/*
+* Populate a run from a built-in table. The query must return the columns:
+* ft, ac, pid, data64, id_str, cbu, cbj - in that order.
+* -- pBuild
+* -- pRun
+* -- hSql
+* -- tp
+* -- szSql
+* -- return
+*/
+_Success_(return)
+BOOL FcTimeline_RunFromSql(_In_ PFCTIMELINE_BUILD pBuild, _In_ PFCTIMELINE_RUN pRun, _In_ sqlite3 *hSql, _In_ DWORD tp, _In_ LPSTR szSql)
+{
+    int rc;
+    BOOL fResult = FALSE;
+    sqlite3_stmt *hStmt = NULL;
+    FCTIMELINE_RUN_ENTRY e = { 0 };
+    if(SQLITE_OK != (rc = sqlite3_prepare_v2(hSql, szSql, -1, &hStmt, NULL))) { goto fail; }
+    e.tp = tp;
+    while(SQLITE_ROW == (rc = sqlite3_step(hStmt))) {
+        e.ft = sqlite3_column_int64(hStmt, 0);
+        e.ac = sqlite3_column_int(hStmt, 1);
+        e.pid = sqlite3_column_int(hStmt, 2);
+        e.data64 = sqlite3_column_int64(hStmt, 3);
+        e.id_str = sqlite3_column_int64(hStmt, 4);
+        e.cbu = sqlite3_column_int(hStmt, 5);
+        e.cbj = sqlite3_column_int(hStmt, 6);
+        if(!FcTimeline_RunAppend(pBuild, pRun, &e)) { goto fail; }
+    }
+    fResult = (rc == SQLITE_DONE);
+fail:
+    if(!fResult) {
+        vmmprintf_fn("FAIL INITIALIZE TIMELINE WITH SQLITE ERROR CODE %i, QUERY: %s\n", rc, szSql);
+    }
+    sqlite3_finalize(hStmt);
+    return fResult;
+}
+
+/*
+* K-way merge all sorted runs directly into the timeline table. The ids, the
+* per-type ids and the UTF-8/JSON line offsets (global and per-type) are
+* calculated during the merge. The resulting file sizes are written to the
+* timeline_info table.
+* -- pBuild
+* -- cTp = number of timeline types (entry 0 is 'all').
+* -- return
+*/
+_Success_(return)
+BOOL FcTimeline_MergeRuns(_In_ PFCTIMELINE_BUILD pBuild, _In_ DWORD cTp)
+{
+    typedef struct tdFCTIMELINE_MERGE_TP {
+        QWORD cId;
+        QWORD oU;
+        QWORD oJ;
+    } FCTIMELINE_MERGE_TP, *PFCTIMELINE_MERGE_TP;
+    BOOL fResult = FALSE;
+    DWORD i, iRun = 0, cRun = 0;
+    PFCTIMELINE_RUN pRun, *ppRun = NULL;
+    PDWORD piRun = NULL;
+    PFCTIMELINE_RUN_ENTRY pe, peBest;
+    PFCTIMELINE_MERGE_TP pTpAll, pTp, pTpMap = NULL;
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hStmt = NULL, *hStmtInfo = NULL;
+    // 1: wait for the parallel sorts and set up merge state.
+    if(!(ppRun = LocalAlloc(LMEM_ZEROINIT, (pBuild->cRun + 1) * (sizeof(PFCTIMELINE_RUN) + sizeof(DWORD))))) { goto fail; }
+    piRun = (PDWORD)(ppRun + pBuild->cRun + 1);
+    if(!(pTpMap = LocalAlloc(LMEM_ZEROINIT, cTp * sizeof(FCTIMELINE_MERGE_TP)))) { goto fail; }
+    for(pRun = pBuild->pRunHead; pRun; pRun = pRun->FLink) {
+        if(pRun->hEventSorted) {
+            WaitForSingleObject(pRun->hEventSorted, INFINITE);
+        }
+        if(pRun->c) {
+            ppRun[cRun++] = pRun;
+        }
+    }
+    // 2: merge into the timeline table in a single transaction.
+    if(!(hSql = Fc_SqlReserve())) { goto fail; }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO timeline (id, tp, tp_id, id_str, ft, ac, pid, data64, oln_u, oln_j, oln_utp, oln_jtp) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);", -1, &hStmt, NULL)) { goto fail; }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "UPDATE timeline_info SET file_size_u = ?, file_size_j = ? WHERE id = ?;", -1, &hStmtInfo, NULL)) { goto fail; }
+    sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    pTpAll = pTpMap;
+    while(TRUE) {
+        // the number of runs is small (one per source) - a linear scan of the
+        // run heads is cheaper than maintaining a heap.
+        peBest = NULL;
+        for(i = 0; i < cRun; i++) {
+            if(piRun[i] == ppRun[i]->c) { continue; }
+            pe = ppRun[i]->pe + piRun[i];
+            if(!peBest || (FcTimeline_RunCmp(pe, peBest) < 0)) {
+                peBest = pe;
+                iRun = i;
+            }
+        }
+        if(!peBest) { break; }
+        piRun[iRun]++;
+        if(!peBest->tp || (peBest->tp >= cTp)) { continue; }
+        pTp = pTpMap + peBest->tp;
+        pTpAll->cId++;
+        pTp->cId++;
+        sqlite3_reset(hStmt);
+        Fc_SqlBindMultiInt64(hStmt, 1, 12,
+            pTpAll->cId,
+            (QWORD)peBest->tp,
+            pTp->cId,
+            peBest->id_str,
+            peBest->ft,
+            (QWORD)peBest->ac,
+            (QWORD)peBest->pid,
+            peBest->data64,
+            pTpAll->oU,
+            pTpAll->oJ,
+            pTp->oU,
+            pTp->oJ
+        );
+        sqlite3_step(hStmt);
+        pTpAll->oU += peBest->cbu + FC_LINELENGTH_TIMELINE_UTF8;
+        pTpAll->oJ += peBest->cbj + FC_LINELENGTH_TIMELINE_JSON;
+        pTp->oU += peBest->cbu + FC_LINELENGTH_TIMELINE_UTF8;
+        pTp->oJ += peBest->cbj + FC_LINELENGTH_TIMELINE_JSON;
+    }
+    // 3: file sizes are the end offsets of the respective timeline.
+    for(i = 0; i < cTp; i++) {
+        sqlite3_reset(hStmtInfo);
+        Fc_SqlBindMultiInt64(hStmtInfo, 1, 3, pTpMap[i].oU, pTpMap[i].oJ, (QWORD)i);
+        sqlite3_step(hStmtInfo);
+    }
+    sqlite3_exec(hSql, "COMMIT TRANSACTION", NULL, NULL, NULL);
+    fResult = TRUE;
+fail:
+    sqlite3_finalize(hStmt);
+    sqlite3_finalize(hStmtInfo);
+    Fc_SqlReserveReturn(hSql);
+    LocalFree(pTpMap);
+    LocalFree(ppRun);
+    return fResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// TIMELINE PLUGIN CALLBACK FUNCTIONALITY BELOW:
+// ----------------------------------------------------------------------------
+
 /*
 * Callback function to add a single plugin module timeline entry.
 * -- hTimeline
@@ -31,19 +308,19 @@ VOID FcTimeline_Callback_PluginAddEntry(_In_ HANDLE hTimeline, _In_ QWORD ft, _I
 {
     PFCTIMELINE_PLUGIN_CONTEXT ctxPlugin = (PFCTIMELINE_PLUGIN_CONTEXT)hTimeline;
     FCSQL_INSERTSTRTABLE SqlStrInsert;
+    FCTIMELINE_RUN_ENTRY e;
     // build and insert string data into 'str' table.
     if(!Fc_SqlInsertStr(ctxPlugin->hStmtStr, wszText, 0, &SqlStrInsert)) { return; }
-    // insert into 'timeline_data' table.
-    sqlite3_reset(ctxPlugin->hStmt);
-    Fc_SqlBindMultiInt64(ctxPlugin->hStmt, 1, 6,
-        SqlStrInsert.id,
-        (QWORD)ctxPlugin->dwId,
-        ft,
-        (QWORD)dwAction,
-        (QWORD)dwPID,
-        qwValue
-    );
-    sqlite3_step(ctxPlugin->hStmt);
+    // append to the in-memory run of the plugin.
+    e.ft = ft;
+    e.data64 = qwValue;
+    e.id_str = SqlStrInsert.id;
+    e.tp = ctxPlugin->dwId;
+    e.ac = dwAction;
+    e.pid = dwPID;
+    e.cbu = SqlStrInsert.cbu;
+    e.cbj = SqlStrInsert.cbj;
+    FcTimeline_RunAppend(ctxFc->Timeline.pBuild, ctxPlugin->pRun, &e);
 }
 
 /*
@@ -55,8 +332,9 @@ VOID FcTimeline_Callback_PluginClose(_In_ HANDLE hTimeline)
     PFCTIMELINE_PLUGIN_CONTEXT ctxPlugin = (PFCTIMELINE_PLUGIN_CONTEXT)hTimeline;
     sqlite3_exec(ctxPlugin->hSql, "COMMIT TRANSACTION", NULL, NULL, NULL);
     sqlite3_finalize(ctxPlugin->hStmtStr);
-    sqlite3_finalize(ctxPlugin->hStmt);
     Fc_SqlReserveReturn(ctxPlugin->hSql);
+    FcTimeline_RunComplete(ctxPlugin->pRun);
+    LocalFree(ctxPlugin);
 }
 
 /*
@@ -81,20 +359,94 @@ HANDLE FcTimeline_Callback_PluginRegister(_In_reads_(6) LPSTR sNameShort, _In_re
     hSql = Fc_SqlReserveReturn(hSql);
     Fc_SqlQueryN("SELECT MAX(id) FROM timeline_info;", 0, NULL, 1, &v, NULL);
     if(!(ctxPlugin = LocalAlloc(LMEM_ZEROINIT, sizeof(FCTIMELINE_PLUGIN_CONTEXT)))) { goto fail; }
+    if(!(ctxPlugin->pRun = FcTimeline_RunNew(ctxFc->Timeline.pBuild))) { goto fail; }
     ctxPlugin->dwId = (DWORD)v;
     ctxPlugin->hSql = Fc_SqlReserve();
-    sqlite3_prepare_v2(ctxPlugin->hSql, "INSERT INTO timeline_data (id_str, tp, ft, ac, pid, data64) VALUES (?, ?, ?, ?, ?, ?);", -1, &ctxPlugin->hStmt, NULL);
     sqlite3_prepare_v2(ctxPlugin->hSql, "INSERT INTO str (id, osz, csz, cbu, cbj, sz) VALUES (?, ?, ?, ?, ?, ?);", -1, &ctxPlugin->hStmtStr, NULL);
     sqlite3_exec(ctxPlugin->hSql, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    sqlite3_finalize(hStmt);
+    return (HANDLE)ctxPlugin;
 fail:
     sqlite3_finalize(hStmt);
-    if(ctxPlugin) {
-        return (HANDLE)ctxPlugin;
-    }
+    LocalFree(ctxPlugin);
     Fc_SqlReserveReturn(hSql);
     return NULL;
 }
 
+
+
+// ----------------------------------------------------------------------------
+// TIMELINE INITIALIZATION FUNCTIONALITY BELOW:
+// ----------------------------------------------------------------------------
+
+/*
+* Populate the in-memory timeline info (ctxFc->Timeline) from an already built
+* timeline_info database table.
+* -- return
+*/
+_Success_(return)
+BOOL FcTimeline_InitializeInfo()
+{
+    BOOL f, fResult = FALSE;
+    DWORD i, j;
+    QWORD v = 0;
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hStmt = NULL;
+    PFC_TIMELINE_INFO pi;
+    if(SQLITE_OK != Fc_SqlQueryN("SELECT MAX(id) FROM timeline_info;", 0, NULL, 1, &v, NULL)) { goto fail; }
+    ctxFc->Timeline.cTp = (DWORD)v + 1;
+    LocalFree(ctxFc->Timeline.pInfo);
+    if(!(ctxFc->Timeline.pInfo = LocalAlloc(LMEM_ZEROINIT, (ctxFc->Timeline.cTp) * sizeof(FC_TIMELINE_INFO)))) { goto fail; }
+    if(!(hSql = Fc_SqlReserve())) { goto fail; }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "SELECT * FROM timeline_info", -1, &hStmt, 0)) { goto fail; }
+    for(i = 0; i < ctxFc->Timeline.cTp; i++) {
+        pi = ctxFc->Timeline.pInfo + i;
+        if(SQLITE_ROW != sqlite3_step(hStmt)) { goto fail; }
+        pi->dwId = sqlite3_column_int(hStmt, 0);
+        strncpy_s(pi->szNameShort, _countof(pi->szNameShort), sqlite3_column_text(hStmt, 1), _TRUNCATE);
+        for(j = 0, f = FALSE; j < _countof(pi->szNameShort) - 1; j++) {
+            if(f || (pi->szNameShort[j] == 0)) {
+                pi->szNameShort[j] = ' ';
+                f = TRUE;
+            }
+        }
+        pi->szNameShort[_countof(pi->szNameShort) - 1] = 0;
+        wcsncpy_s(pi->wszNameFileUTF8, _countof(pi->wszNameFileUTF8), sqlite3_column_text16(hStmt, 2), _TRUNCATE);
+        wcsncpy_s(pi->wszNameFileJSON, _countof(pi->wszNameFileJSON), sqlite3_column_text16(hStmt, 3), _TRUNCATE);
+        pi->dwFileSizeUTF8 = sqlite3_column_int(hStmt, 4);
+        pi->dwFileSizeJSON = sqlite3_column_int(hStmt, 5);
+    }
+    fResult = TRUE;
+fail:
+    sqlite3_finalize(hStmt);
+    Fc_SqlReserveReturn(hSql);
+    return fResult;
+}
+
+/*
+* Build the in-memory utf-8 file offset indexes of all timeline types so that
+* file reads may locate entries without querying the database. A type whose
+* index cannot be built falls back to database lookups.
+*/
+VOID FcTimeline_InitializeOffsetIndex()
+{
+    DWORD i;
+    QWORD v;
+    if(!ctxFc->Timeline.cTp || ctxFc->Timeline.ppObIndex) { return; }
+    if(!(ctxFc->Timeline.ppObIndex = LocalAlloc(LMEM_ZEROINIT, ctxFc->Timeline.cTp * sizeof(PFCOB_OFFSETINDEX)))) { return; }
+    ctxFc->Timeline.ppObIndex[0] = FcOffsetIndex_Create(
+        "SELECT COUNT(*), MIN(id) FROM timeline",
+        "SELECT id, oln_u FROM timeline ORDER BY id",
+        0, NULL);
+    for(i = 1; i < ctxFc->Timeline.cTp; i++) {
+        v = i;
+        ctxFc->Timeline.ppObIndex[i] = FcOffsetIndex_Create(
+            "SELECT COUNT(*), MIN(tp_id) FROM timeline WHERE tp = ?",
+            "SELECT tp_id, oln_utp FROM timeline WHERE tp = ? ORDER BY tp_id",
+            1, &v);
+    }
+}
+
 /*
 * Initialize the timelining functionality. Before the timelining functionality
 * is initialized processes, threads, registry and ntfs must be initialized.
@@ -104,13 +456,14 @@ fail:
 _Success_(return)
 BOOL FcTimeline_Initialize()
 {
-    BOOL f, fResult = FALSE;
+    BOOL fResult = FALSE;
     int rc;
-    DWORD i, j;
-    QWORD k, v = 0;
+    DWORD i;
+    QWORD v = 0, tmStart, tmEnd, qwFreq;
     sqlite3 *hSql = NULL;
-    sqlite3_stmt *hStmt = NULL;
-    PFC_TIMELINE_INFO pi;
+    PFCTIMELINE_RUN pRun = NULL;
+    FCTIMELINE_BUILD Build = { 0 };
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmStart);
     LPSTR szTIMELINE_SQL1[] = {
         // populate timeline_info with basic information:
         "DROP TABLE IF EXISTS timeline_info;",
@@ -120,89 +473,78 @@ BOOL FcTimeline_Initialize()
         "INSERT INTO timeline_info VALUES(2, 'THRD', 'timeline_thread.txt',   'timeline_thread.json',   0, 0); ",
         "INSERT INTO timeline_info VALUES(3, 'REG' , 'timeline_registry.txt', 'timeline_registry.json', 0, 0); ",
         "INSERT INTO timeline_info VALUES(4, 'NTFS', 'timeline_ntfs.txt',     'timeline_ntfs.json',     0, 0); ",
-        // populate timeline_data temporary table - with basic data.
+        // main timeline table - populated by the run merge.
         "DROP TABLE IF EXISTS timeline_data;",
-        "CREATE TABLE timeline_data ( id INTEGER PRIMARY KEY AUTOINCREMENT, id_str INTEGER, tp INT, ft INTEGER, ac INT, pid INT, data64 INTEGER );",
-        "INSERT INTO timeline_data (id_str, tp, ft, ac, pid, data64) SELECT id_str_all, 1, time_create, "STRINGIZE(FC_TIMELINE_ACTION_CREATE)", pid, eprocess FROM process WHERE time_create > 0;",
-        "INSERT INTO timeline_data (id_str, tp, ft, ac, pid, data64) SELECT id_str_all, 1, time_exit,   "STRINGIZE(FC_TIMELINE_ACTION_DELETE)", pid, eprocess FROM process WHERE time_exit > 0;",
-        "INSERT INTO timeline_data (id_str, tp, ft, ac, pid, data64) SELECT id_str,     2, time_create, "STRINGIZE(FC_TIMELINE_ACTION_CREATE)", pid, ethread FROM thread WHERE time_create > 0;",
-        "INSERT INTO timeline_data (id_str, tp, ft, ac, pid, data64) SELECT id_str,     2, time_exit,   "STRINGIZE(FC_TIMELINE_ACTION_DELETE)", pid, ethread FROM thread WHERE time_exit > 0;",
-        "INSERT INTO timeline_data (id_str, tp, ft, ac, pid, data64) SELECT id_str,     3, time,        "STRINGIZE(FC_TIMELINE_ACTION_MODIFY)", 0, 0 FROM registry WHERE time > 0;",
-        "INSERT INTO timeline_data (id_str, tp, ft, ac, pid, data64) SELECT id_str,     4, time_create, "STRINGIZE(FC_TIMELINE_ACTION_CREATE)", 0, size_file FROM ntfs WHERE time_create > 0;",
-        "INSERT INTO timeline_data (id_str, tp, ft, ac, pid, data64) SELECT id_str,     4, time_modify, "STRINGIZE(FC_TIMELINE_ACTION_MODIFY)", 0, size_file FROM ntfs WHERE time_modify > 0 AND time_modify != time_create;",
-        "INSERT INTO timeline_data (id_str, tp, ft, ac, pid, data64) SELECT id_str,     4, time_read,   "STRINGIZE(FC_TIMELINE_ACTION_READ)"  , 0, size_file FROM ntfs WHERE time_read   > 0 AND time_read != time_create AND time_read != time_modify;"
-    };
-    for(i = 0; i < sizeof(szTIMELINE_SQL1) / sizeof(LPCSTR); i++) {
-        if(SQLITE_OK != (rc = Fc_SqlExec(szTIMELINE_SQL1[i]))) {
-            vmmprintf_fn("FAIL INITIALIZE TIMELINE WITH SQLITE ERROR CODE %i, QUERY: %s\n", rc, szTIMELINE_SQL1[i]);
-            goto fail;
-        }
-    }
-    // populate timeline_data temporary table - with plugins.
-    PluginManager_Timeline(FcTimeline_Callback_PluginRegister, FcTimeline_Callback_PluginClose, FcTimeline_Callback_PluginAddEntry);
-    LPSTR szTIMELINE_SQL2[] = {
-        // populate main timeline table:
         "DROP TABLE IF EXISTS timeline;",
         "DROP VIEW IF EXISTS v_timeline;",
-        "CREATE TABLE timeline ( id INTEGER PRIMARY KEY AUTOINCREMENT, tp INT, tp_id INTEGER, id_str INTEGER, ft INTEGER, ac INT, pid INT, data64 INTEGER, oln_u INTEGER, oln_j INTEGER, oln_utp INTEGER, oln_jtp INTEGER );"
+        "CREATE TABLE timeline ( id INTEGER PRIMARY KEY AUTOINCREMENT, tp INT, tp_id INTEGER, id_str INTEGER, ft INTEGER, ac INT, pid INT, data64 INTEGER, oln_u INTEGER, oln_j INTEGER, oln_utp INTEGER, oln_jtp INTEGER );",
         "CREATE VIEW v_timeline AS SELECT * FROM timeline, str WHERE timeline.id_str = str.id;",
+    };
+    // built-in timeline sources - one run per timeline type, each query returns: ft, ac, pid, data64, id_str, cbu, cbj.
+    struct {
+        DWORD tp;
+        LPSTR szSql;
+    } TIMELINE_SQL_RUN[] = {
+        { 1, "SELECT time_create, "STRINGIZE(FC_TIMELINE_ACTION_CREATE)", pid, eprocess, id_str_all, cbu, cbj FROM process, str WHERE str.id = process.id_str_all AND time_create > 0;" },
+        { 1, "SELECT time_exit,   "STRINGIZE(FC_TIMELINE_ACTION_DELETE)", pid, eprocess, id_str_all, cbu, cbj FROM process, str WHERE str.id = process.id_str_all AND time_exit > 0;" },
+        { 2, "SELECT time_create, "STRINGIZE(FC_TIMELINE_ACTION_CREATE)", pid, ethread, id_str, cbu, cbj FROM thread, str WHERE str.id = thread.id_str AND time_create > 0;" },
+        { 2, "SELECT time_exit,   "STRINGIZE(FC_TIMELINE_ACTION_DELETE)", pid, ethread, id_str, cbu, cbj FROM thread, str WHERE str.id = thread.id_str AND time_exit > 0;" },
+        { 3, "SELECT time,        "STRINGIZE(FC_TIMELINE_ACTION_MODIFY)", 0, 0, id_str, cbu, cbj FROM registry, str WHERE str.id = registry.id_str AND time > 0;" },
+        { 4, "SELECT time_create, "STRINGIZE(FC_TIMELINE_ACTION_CREATE)", 0, size_file, id_str, cbu, cbj FROM ntfs, str WHERE str.id = ntfs.id_str AND time_create > 0;" },
+        { 4, "SELECT time_modify, "STRINGIZE(FC_TIMELINE_ACTION_MODIFY)", 0, size_file, id_str, cbu, cbj FROM ntfs, str WHERE str.id = ntfs.id_str AND time_modify > 0 AND time_modify != time_create;" },
+        { 4, "SELECT time_read,   "STRINGIZE(FC_TIMELINE_ACTION_READ)"  , 0, size_file, id_str, cbu, cbj FROM ntfs, str WHERE str.id = ntfs.id_str AND time_read   > 0 AND time_read != time_create AND time_read != time_modify;" },
+    };
+    LPSTR szTIMELINE_SQL2[] = {
+        // indexes are built after the merge has populated the table.
         "CREATE UNIQUE INDEX idx_timeline_tpid     ON timeline(tp, tp_id);",
         "CREATE UNIQUE INDEX idx_timeline_oln_u    ON timeline(oln_u);",
-        "CREATE UNIQUE INDEX idx_timeline_oln_j    ON timeline(oln_j);"
+        "CREATE UNIQUE INDEX idx_timeline_oln_j    ON timeline(oln_j);",
         "CREATE UNIQUE INDEX idx_timeline_oln_utp  ON timeline(tp, oln_utp);",
         "CREATE UNIQUE INDEX idx_timeline_oln_jtp  ON timeline(tp, oln_jtp);",
-        "INSERT INTO timeline (tp, tp_id, id_str, ft, ac, pid, data64, oln_u, oln_j, oln_utp, oln_jtp) SELECT td.tp, (SUM(1) OVER (PARTITION BY td.tp ORDER BY td.ft DESC, td.id)), td.id_str, td.ft, td.ac, td.pid, td.data64, (SUM(str.cbu+"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)")  OVER (ORDER BY td.ft DESC, td.id) - str.cbu-"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)"), (SUM(str.cbj+"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)") OVER (ORDER BY td.ft DESC, td.id) - str.cbj-"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)"), (SUM(str.cbu+"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)")  OVER (PARTITION BY td.tp ORDER BY td.ft DESC, td.id) - str.cbu-"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)"), (SUM(str.cbj+"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)") OVER (PARTITION BY td.tp ORDER BY td.ft DESC, td.id) - str.cbj-"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)") FROM timeline_data td, str WHERE str.id = td.id_str ORDER BY td.ft DESC, td.id;",
-        "DROP TABLE timeline_data;"
-        // update timeline_info with sizes for 'all' file (utf8 and json).
-        "UPDATE timeline_info SET file_size_u = (SELECT oln_u+cbu+"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)" AS cbu_tot FROM v_timeline WHERE id = (SELECT MAX(id) FROM v_timeline)) WHERE id = 0;",
-        "UPDATE timeline_info SET file_size_j = (SELECT oln_j+cbj+"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)" AS cbj_tot FROM v_timeline WHERE id = (SELECT MAX(id) FROM v_timeline)) WHERE id = 0;",
     };
-    for(i = 0; i < sizeof(szTIMELINE_SQL2) / sizeof(LPCSTR); i++) {
-        if(SQLITE_OK != (rc = Fc_SqlExec(szTIMELINE_SQL2[i]))) {
-            vmmprintf_fn("FAIL INITIALIZE TIMELINE WITH SQLITE ERROR CODE %i, QUERY: %s\n", rc, szTIMELINE_SQL2[i]);
+    for(i = 0; i < sizeof(szTIMELINE_SQL1) / sizeof(LPCSTR); i++) {
+        if(SQLITE_OK != (rc = Fc_SqlExec(szTIMELINE_SQL1[i]))) {
+            vmmprintf_fn("FAIL INITIALIZE TIMELINE WITH SQLITE ERROR CODE %i, QUERY: %s\n", rc, szTIMELINE_SQL1[i]);
             goto fail;
         }
     }
-    // update timeline_info with sizes for individual types (utf8 and json).
-    LPSTR szTIMELINE_SQL_TIMELINE_UPD[] = {
-        "UPDATE timeline_info SET file_size_u = (SELECT oln_utp+cbu+"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)" FROM v_timeline WHERE tp = ? AND tp_id = (SELECT MAX(tp_id) FROM v_timeline WHERE tp = ?)) WHERE id = ?;",
-        "UPDATE timeline_info SET file_size_j = (SELECT oln_jtp+cbj+"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)" FROM v_timeline WHERE tp = ? AND tp_id = (SELECT MAX(tp_id) FROM v_timeline WHERE tp = ?)) WHERE id = ?;",
-    };
+    // 1: collect built-in runs - each run is sorted in the background as soon
+    //    as it is complete while the remaining sources are being collected.
+    if(!(hSql = Fc_SqlReserve())) { goto fail; }
+    for(i = 0; i < sizeof(TIMELINE_SQL_RUN) / sizeof(TIMELINE_SQL_RUN[0]); i++) {
+        if(!pRun || (TIMELINE_SQL_RUN[i].tp != TIMELINE_SQL_RUN[i - 1].tp)) {
+            if(pRun) { FcTimeline_RunComplete(pRun); }
+            if(!(pRun = FcTimeline_RunNew(&Build))) { goto fail; }
+        }
+        if(!FcTimeline_RunFromSql(&Build, pRun, hSql, TIMELINE_SQL_RUN[i].tp, TIMELINE_SQL_RUN[i].szSql)) { goto fail; }
+    }
+    if(pRun) { FcTimeline_RunComplete(pRun); }
+    hSql = Fc_SqlReserveReturn(hSql);
+    // 2: collect plugin runs.
+    ctxFc->Timeline.pBuild = &Build;
+    PluginManager_Timeline(FcTimeline_Callback_PluginRegister, FcTimeline_Callback_PluginClose, FcTimeline_Callback_PluginAddEntry);
+    ctxFc->Timeline.pBuild = NULL;
+    // 3: k-way merge sorted runs into the timeline table and build indexes.
     Fc_SqlQueryN("SELECT MAX(id) FROM timeline_info;", 0, NULL, 1, &v, NULL);
     ctxFc->Timeline.cTp = (DWORD)v + 1;
-    for(k = 1; k < ctxFc->Timeline.cTp; k++) {
-        for(j = 0; j < 2; j++) {
-            if(SQLITE_DONE != (rc = Fc_SqlQueryN(szTIMELINE_SQL_TIMELINE_UPD[j], 3, (QWORD[]) { k, k, k }, 0, NULL, NULL))) {
-                vmmprintf_fn("FAIL INITIALIZE TIMELINE WITH SQLITE ERROR CODE %i, QUERY: %s\n", rc, szTIMELINE_SQL_TIMELINE_UPD[j]);
-                goto fail;
-            }
+    if(!FcTimeline_MergeRuns(&Build, ctxFc->Timeline.cTp)) { goto fail; }
+    FcTimeline_RunFreeAll(&Build);
+    for(i = 0; i < sizeof(szTIMELINE_SQL2) / sizeof(LPCSTR); i++) {
+        if(SQLITE_OK != (rc = Fc_SqlExec(szTIMELINE_SQL2[i]))) {
+            vmmprintf_fn("FAIL INITIALIZE TIMELINE WITH SQLITE ERROR CODE %i, QUERY: %s\n", rc, szTIMELINE_SQL2[i]);
+            goto fail;
         }
     }
     // populate timeline info struct
-    if(!(ctxFc->Timeline.pInfo = LocalAlloc(LMEM_ZEROINIT, (ctxFc->Timeline.cTp) * sizeof(FC_TIMELINE_INFO)))) { goto fail; }
-    if(!(hSql = Fc_SqlReserve())) { goto fail; }
-    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "SELECT * FROM timeline_info", -1, &hStmt, 0)) { goto fail; }
-    for(i = 0; i < ctxFc->Timeline.cTp; i++) {
-        pi = ctxFc->Timeline.pInfo + i;
-        if(SQLITE_ROW != sqlite3_step(hStmt)) { goto fail; }
-        pi->dwId = sqlite3_column_int(hStmt, 0);
-        strncpy_s(pi->szNameShort, _countof(pi->szNameShort), sqlite3_column_text(hStmt, 1), _TRUNCATE);
-        for(j = 0, f = FALSE; j < _countof(pi->szNameShort) - 1; j++) {
-            if(f || (pi->szNameShort[j] == 0)) {
-                pi->szNameShort[j] = ' ';
-                f = TRUE;
-            }
-        }
-        pi->szNameShort[_countof(pi->szNameShort) - 1] = 0;
-        wcsncpy_s(pi->wszNameFileUTF8, _countof(pi->wszNameFileUTF8), sqlite3_column_text16(hStmt, 2), _TRUNCATE);
-        wcsncpy_s(pi->wszNameFileJSON, _countof(pi->wszNameFileJSON), sqlite3_column_text16(hStmt, 3), _TRUNCATE);
-        pi->dwFileSizeUTF8 = sqlite3_column_int(hStmt, 4);
-        pi->dwFileSizeJSON = sqlite3_column_int(hStmt, 5);
-    }
+    if(!FcTimeline_InitializeInfo()) { goto fail; }
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmEnd);
+    QueryPerformanceFrequency((PLARGE_INTEGER)&qwFreq);
+    vmmprintfv("FORENSIC: Timeline initialized: %i types, %lli ms\n", ctxFc->Timeline.cTp, (tmEnd - tmStart) * 1000 / qwFreq);
     ctxFc->fEnableTimeline = TRUE;
     fResult = TRUE;
 fail:
-    sqlite3_finalize(hStmt);
+    ctxFc->Timeline.pBuild = NULL;
+    FcTimeline_RunFreeAll(&Build);
     Fc_SqlReserveReturn(hSql);
     return fResult;
 }
@@ -297,7 +639,51 @@ BOOL FcTimelineMap_GetFromIdRange(_In_ DWORD dwTimelineType, _In_ QWORD qwId, _I
         "SELECT COUNT(*), SUM(csz) FROM v_timeline WHERE tp_id >= ? AND tp_id < ? AND tp = ?",
         "SELECT "FCTIMELINE_SQL_SELECT_FIELDS_TP" FROM v_timeline WHERE tp_id >= ? AND tp_id < ? AND tp = ? ORDER BY tp_id"
     };
-    return FcTimelineMap_CreateInternal(szSQL[iSQL], szSQL[iSQL + 1], (dwTimelineType ? 3 : 2), v, ppObTimelineMap);
+    if(!FcTimelineMap_CreateInternal(szSQL[iSQL], szSQL[iSQL + 1], (dwTimelineType ? 3 : 2), v, ppObTimelineMap)) { return FALSE; }
+    (*ppObTimelineMap)->dwTimelineType = dwTimelineType;
+    return TRUE;
+}
+
+/*
+* Retrieve a timeline map object containing at least the entries within the
+* range [qwId, qwId + cId). Entries are fetched in batches of
+* FC_MAP_BATCH_ENTRIES so that sequential file reads are mostly served from
+* the previously fetched map without any database access. Only batches with
+* contiguous ids are kept - if the ids of a batch have gaps the requested
+* range is fetched as-is and the map index is then always zero.
+* -- dwTimelineType = the timeline type, 0 for all.
+* -- qwId = the minimum timeline id of the entries to retrieve.
+* -- cId = the number of timeline entries to retrieve.
+* -- ppObTimelineMap
+* -- piMap = index of the entry with id qwId in the map.
+* -- return
+*/
+_Success_(return)
+BOOL FcTimelineMap_GetFromIdRangeBatch(_In_ DWORD dwTimelineType, _In_ QWORD qwId, _In_ QWORD cId, _Out_ PFCOB_MAP_TIMELINE *ppObTimelineMap, _Out_ PDWORD piMap)
+{
+    PFCOB_MAP_TIMELINE pObMap = ObContainer_GetOb(ctxFc->Timeline.pObCMapBatch);
+    if(!pObMap || !pObMap->cMap || (pObMap->dwTimelineType != dwTimelineType) || (qwId < pObMap->pMap[0].id) || (qwId + cId > pObMap->pMap[0].id + pObMap->cMap)) {
+        Ob_DECREF_NULL(&pObMap);
+        if(!FcTimelineMap_GetFromIdRange(dwTimelineType, qwId, max(cId, FC_MAP_BATCH_ENTRIES), &pObMap) || !pObMap->cMap) {
+            Ob_DECREF(pObMap);
+            return FALSE;
+        }
+        if((pObMap->pMap[0].id != qwId) || (pObMap->pMap[pObMap->cMap - 1].id - pObMap->pMap[0].id != pObMap->cMap - 1)) {
+            // ids are not contiguous -> per-range lookup without batching.
+            Ob_DECREF_NULL(&pObMap);
+            if(!FcTimelineMap_GetFromIdRange(dwTimelineType, qwId, cId, &pObMap) || !pObMap->cMap) {
+                Ob_DECREF(pObMap);
+                return FALSE;
+            }
+            *piMap = 0;
+            *ppObTimelineMap = pObMap;
+            return TRUE;
+        }
+        ObContainer_SetOb(ctxFc->Timeline.pObCMapBatch, pObMap);
+    }
+    *piMap = (DWORD)(qwId - pObMap->pMap[0].id);
+    *ppObTimelineMap = pObMap;
+    return TRUE;
 }
 
 /*
@@ -312,6 +698,10 @@ BOOL FcTimelineMap_GetFromIdRange(_In_ DWORD dwTimelineType, _In_ QWORD qwId, _I
 _Success_(return)
 BOOL FcTimeline_GetIdFromPosition(_In_ DWORD dwTimelineType, _In_ BOOL fJSON, _In_ QWORD qwFilePos, _Out_ PQWORD pqwId)
 {
+    if(!fJSON && ctxFc->Timeline.ppObIndex && (dwTimelineType < ctxFc->Timeline.cTp) && ctxFc->Timeline.ppObIndex[dwTimelineType]) {
+        *pqwId = FcOffsetIndex_GetId(ctxFc->Timeline.ppObIndex[dwTimelineType], qwFilePos);
+        return TRUE;
+    }
     QWORD v[] = { max(2048, qwFilePos) - 2048, qwFilePos, dwTimelineType };
     DWORD iSQL = (dwTimelineType ? 2 : 0) + (fJSON ? 1 : 0);
     LPSTR szSQL[4] = {
@@ -41,6 +41,7 @@ LPCSTR szMFC_README =
 NTSTATUS M_Fc_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
 {
     BYTE btp;
+    CHAR szStatistics[0x200] = { 0 };
     if(!wcscmp(ctx->wszPath, L"readme.txt")) {
         return Util_VfsReadFile_FromPBYTE((PBYTE)szMFC_README, strlen(szMFC_README), pb, cb, pcbRead, cbOffset);
     }
@@ -48,6 +49,10 @@ NTSTATUS M_Fc_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWORD c
         btp = '0' + (ctxFc ? (BYTE)ctxFc->db.tp : 0);
         return Util_VfsReadFile_FromPBYTE(&btp, 1, pb, cb, pcbRead, cbOffset);
     }
+    if(!_wcsicmp(ctx->wszPath, L"scan_statistics.txt")) {
+        FcScanPhysMem_StatisticsText(szStatistics, sizeof(szStatistics));
+        return Util_VfsReadFile_FromPBYTE((PBYTE)szStatistics, strlen(szStatistics), pb, cb, pcbRead, cbOffset);
+    }
     if(!_wcsicmp(ctx->wszPath, L"database.txt")) {
         if(ctxFc) {
             return Util_VfsReadFile_FromTextWtoU8(ctxFc->db.wszDatabaseWinPath, pb, cb, pcbRead, cbOffset);
@@ -75,6 +80,7 @@ BOOL M_Fc_List(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Inout_ PHANDLE pFileList)
     VMMDLL_VfsList_AddFile(pFileList, L"forensic_enable.txt", 1, NULL);
     VMMDLL_VfsList_AddFile(pFileList, L"database.txt", ctxFc ? wcslen_u8(ctxFc->db.wszDatabaseWinPath) : 0, NULL);
     VMMDLL_VfsList_AddFile(pFileList, L"readme.txt", strlen(szMFC_README), NULL);
+    VMMDLL_VfsList_AddFile(pFileList, L"scan_statistics.txt", FcScanPhysMem_StatisticsText(NULL, 0), NULL);
     return TRUE;
 }
 
@@ -20,18 +20,18 @@ NTSTATUS M_FcNtfs_ReadInfo(_Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead,
     PFC_MAP_NTFSENTRY pe;
     PFCOB_MAP_NTFS pObNtfsMap = NULL;
     QWORD i, o, qwIdBase, qwIdTop, cId, cszuBuffer, cbOffsetBuffer;
-    DWORD iDirDepth;
+    DWORD iMap, iDirDepth;
     LPSTR szuBuffer = NULL;
     CHAR szTimeCreate[24], szTimeModify[24];
     if(!FcNtfs_GetIdFromPosition(cbOffset, FALSE, &qwIdBase)) { goto fail; }
     if(!FcNtfs_GetIdFromPosition(cbOffset + cb, FALSE, &qwIdTop)) { goto fail; }
     cId = min(cb / M_NTFS_INFO_LINELENGTH_UTF8, qwIdTop - qwIdBase) + 1;
-    if(!FcNtfsMap_GetFromIdRange(qwIdBase, cId, &pObNtfsMap) || !pObNtfsMap->cMap) { goto fail; }
-    cbOffsetBuffer = pObNtfsMap->pMap[0].cszuOffset;
+    if(!FcNtfsMap_GetFromIdRangeBatch(qwIdBase, cId, &pObNtfsMap, &iMap)) { goto fail; }
+    cbOffsetBuffer = pObNtfsMap->pMap[iMap].cszuOffset;
     if((cbOffsetBuffer > cbOffset) || (cbOffset - cbOffsetBuffer > 0x10000)) { goto fail; }
     cszuBuffer = 0x01000000;
     if(!(szuBuffer = LocalAlloc(0, cszuBuffer))) { goto fail; }
-    for(i = 0, o = 0; (i < pObNtfsMap->cMap) && (o < cszuBuffer - 0x1000); i++) {
+    for(i = iMap, o = 0; (i < iMap + cId) && (i < pObNtfsMap->cMap) && (o < cszuBuffer - 0x1000); i++) {
         pe = pObNtfsMap->pMap + i;
         Util_FileTime2String((PFILETIME)&pe->ftCreate, szTimeCreate);
         Util_FileTime2String((PFILETIME)&pe->ftModify, szTimeModify);
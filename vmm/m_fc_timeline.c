@@ -18,17 +18,17 @@ NTSTATUS M_FcTimeline_ReadInfo(_In_ DWORD dwTimelineType, _Out_ PBYTE pb, _In_ D
     PFCOB_MAP_TIMELINE pObMap = NULL;
     QWORD i, o, qwIdBase, qwIdTop, cId, cszuBuffer, cbOffsetBuffer;
     LPSTR szuBuffer = NULL;
-    DWORD dwEntryType, dwEntryAction;
+    DWORD iMap, dwEntryType, dwEntryAction;
     CHAR szTime[24];
     if(!FcTimeline_GetIdFromPosition(dwTimelineType, FALSE, cbOffset, &qwIdBase)) { goto fail; }
     if(!FcTimeline_GetIdFromPosition(dwTimelineType, FALSE, cbOffset + cb, &qwIdTop)) { goto fail; }
     cId = min(cb / FC_LINELENGTH_TIMELINE_UTF8, qwIdTop - qwIdBase) + 1;
-    if(!FcTimelineMap_GetFromIdRange(dwTimelineType, qwIdBase, cId, &pObMap) || !pObMap->cMap) { goto fail; }
-    cbOffsetBuffer = pObMap->pMap[0].cszuOffset;
+    if(!FcTimelineMap_GetFromIdRangeBatch(dwTimelineType, qwIdBase, cId, &pObMap, &iMap)) { goto fail; }
+    cbOffsetBuffer = pObMap->pMap[iMap].cszuOffset;
     if((cbOffsetBuffer > cbOffset) || (cbOffset - cbOffsetBuffer > 0x10000)) { goto fail; }
     cszuBuffer = 0x01000000;
     if(!(szuBuffer = LocalAlloc(0, cszuBuffer))) { goto fail; }
-    for(i = 0, o = 0; (i < pObMap->cMap) && (o < cszuBuffer - 0x1000); i++) {
+    for(i = iMap, o = 0; (i < iMap + cId) && (i < pObMap->cMap) && (o < cszuBuffer - 0x1000); i++) {
         pe = pObMap->pMap + i;
         Util_FileTime2String((PFILETIME)&pe->ft, szTime);
         dwEntryType = (pe->tp < ctxFc->Timeline.cTp) ? pe->tp : 0;
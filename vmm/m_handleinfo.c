@@ -11,47 +11,40 @@
 
 #define HANDLEINFO_LINELENGTH       222ULL
 
-_Success_(return == 0)
-NTSTATUS HandleInfo_Read_HandleMap(_In_ PVMMOB_MAP_HANDLE pHandleMap, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
+VOID HandleInfo_Read_HandleMap_LineCB(_In_opt_ PVOID ctx, _In_ DWORD cbLineLength, _In_ DWORD ie, _In_ PVMM_MAP_HANDLEENTRY pH, _Out_writes_(cbLineLength + 1) LPSTR szu8)
 {
-    NTSTATUS nt;
-    LPSTR sz;
-    QWORD i, o = 0, cbMax, cStart, cEnd, cbLINELENGTH;
-    PVMM_MAP_HANDLEENTRY pH;
     PVMMWIN_OBJECT_TYPE pOT;
     CHAR szType[MAX_PATH] = { 0 };
-    cbLINELENGTH = HANDLEINFO_LINELENGTH;
-    cStart = (DWORD)(cbOffset / cbLINELENGTH);
-    cEnd = (DWORD)min(pHandleMap->cMap - 1, (cb + cbOffset + cbLINELENGTH - 1) / cbLINELENGTH);
-    cbMax = 1 + (1 + cEnd - cStart) * cbLINELENGTH;
-    if(!pHandleMap->cMap || (cStart > pHandleMap->cMap)) { return VMMDLL_STATUS_END_OF_FILE; }
-    if(!(sz = LocalAlloc(LMEM_ZEROINIT, cbMax))) { return VMMDLL_STATUS_FILE_INVALID; }
-    for(i = cStart; i <= cEnd; i++) {
-        pH = pHandleMap->pMap + i;
-        if((pOT = VmmWin_ObjectTypeGet((BYTE)pH->iType))) {
-            snprintf(szType, _MAX_PATH, "%S", pOT->wsz);
-            szType[16] = 0;
-        } else {
-            *(PDWORD)szType = pH->dwPoolTag;
-            szType[4] = 0;
-        }
-        o += Util_snprintf_ln(
-            sz + o,
-            cbMax - o,
-            cbLINELENGTH,
-            "%04x%7i%8x %16llx %6x %-16s %-160S\n",
-            (DWORD)i,
-            pH->dwPID,
-            pH->dwHandle,
-            pH->vaObject,
-            pH->dwGrantedAccess,
-            szType,
-            pH->wszText + pH->cwszText - min(128, pH->cwszText)
-        );
+    if((pOT = VmmWin_ObjectTypeGet((BYTE)pH->iType))) {
+        snprintf(szType, _MAX_PATH, "%S", pOT->wsz);
+        szType[16] = 0;
+    } else {
+        *(PDWORD)szType = pH->dwPoolTag;
+        szType[4] = 0;
     }
-    nt = Util_VfsReadFile_FromPBYTE(sz, cbMax - 1, pb, cb, pcbRead, cbOffset - cStart * cbLINELENGTH);
-    LocalFree(sz);
-    return nt;
+    Util_snprintf_ln(
+        szu8,
+        cbLineLength + 1,
+        cbLineLength,
+        "%04x%7i%8x %16llx %6x %-16s %-160S\n",
+        ie,
+        pH->dwPID,
+        pH->dwHandle,
+        pH->vaObject,
+        pH->dwGrantedAccess,
+        szType,
+        pH->wszText + pH->cwszText - min(128, pH->cwszText)
+    );
+}
+
+_Success_(return == 0)
+NTSTATUS HandleInfo_Read_HandleMap(_In_ PVMMOB_MAP_HANDLE pHandleMap, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
+{
+    return Util_VfsLineFixed_Read(
+        (UTIL_VFSLINEFIXED_PFN_CB)HandleInfo_Read_HandleMap_LineCB, NULL, (DWORD)HANDLEINFO_LINELENGTH,
+        pHandleMap->cMap, pHandleMap->pMap, sizeof(VMM_MAP_HANDLEENTRY),
+        pb, cb, pcbRead, cbOffset
+    );
 }
 
 /*
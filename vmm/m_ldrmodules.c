@@ -105,6 +105,38 @@ fail:
     return nt;
 }
 
+VOID LdrModules_ReadModulesFile_LineCB(_In_ PVMM_PROCESS pProcess, _In_ DWORD cbLineLength, _In_ DWORD ie, _In_ PVMM_MAP_MODULEENTRY pModule, _Out_writes_(cbLineLength + 1) LPSTR szu8)
+{
+    if(ctxVmm->f32) {
+        Util_snprintf_ln(
+            szu8,
+            cbLineLength + 1,
+            cbLineLength,
+            "%04x%7i %8x %08x-%08x %-64S\n",
+            ie,
+            pProcess->dwPID,
+            pModule->cbImageSize >> 12,
+            (DWORD)pModule->vaBase,
+            (DWORD)(pModule->vaBase + pModule->cbImageSize - 1),
+            pModule->wszText + pModule->cwszText - min(64, pModule->cwszText)
+        );
+    } else {
+        Util_snprintf_ln(
+            szu8,
+            cbLineLength + 1,
+            cbLineLength,
+            "%04x%7i %8x %016llx-%016llx %s %-64S\n",
+            ie,
+            pProcess->dwPID,
+            pModule->cbImageSize >> 12,
+            pModule->vaBase,
+            pModule->vaBase + pModule->cbImageSize - 1,
+            pModule->fWoW64 ? "32" : "  ",
+            pModule->wszText + pModule->cwszText - min(64, pModule->cwszText)
+        );
+    }
+}
+
 /*
 * Dynamically generate the file \modules.txt.
 * -- pModuleMap
@@ -117,50 +149,11 @@ fail:
 _Success_(return == 0)
 NTSTATUS LdrModules_ReadModulesFile(_In_ PVMM_PROCESS pProcess, _In_ PVMMOB_MAP_MODULE pModuleMap, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
 {
-    NTSTATUS nt;
-    LPSTR sz;
-    QWORD i, o = 0, cbMax, cStart, cEnd, cbLINELENGTH;
-    PVMM_MAP_MODULEENTRY pModule;
-    cbLINELENGTH = ctxVmm->f32 ? LDRMODULES_LINELENGTH_X86 : LDRMODULES_LINELENGTH_X64;
-    cStart = (DWORD)(cbOffset / cbLINELENGTH);
-    cEnd = (DWORD)min(pModuleMap->cMap - 1, (cb + cbOffset + cbLINELENGTH - 1) / cbLINELENGTH);
-    cbMax = 1 + (1 + cEnd - cStart) * cbLINELENGTH;
-    if(!pModuleMap->cMap || (cStart > pModuleMap->cMap)) { return VMMDLL_STATUS_END_OF_FILE; }
-    if(!(sz = LocalAlloc(LMEM_ZEROINIT, cbMax))) { return VMMDLL_STATUS_FILE_INVALID; }
-    for(i = cStart; i <= cEnd; i++) {
-        pModule = pModuleMap->pMap + i;
-        if(ctxVmm->f32) {
-            o += Util_snprintf_ln(
-                sz + o,
-                cbMax - o,
-                cbLINELENGTH,
-                "%04x%7i %8x %08x-%08x %-64S\n",
-                (DWORD)i,
-                pProcess->dwPID,
-                pModule->cbImageSize >> 12,
-                (DWORD)pModule->vaBase,
-                (DWORD)(pModule->vaBase + pModule->cbImageSize - 1),
-                pModule->wszText + pModule->cwszText - min(64, pModule->cwszText)
-            );
-        } else {
-            o += Util_snprintf_ln(
-                sz + o,
-                cbMax - o,
-                cbLINELENGTH,
-                "%04x%7i %8x %016llx-%016llx %s %-64S\n",
-                (DWORD)i,
-                pProcess->dwPID,
-                pModule->cbImageSize >> 12,
-                pModule->vaBase,
-                pModule->vaBase + pModule->cbImageSize - 1,
-                pModule->fWoW64 ? "32" : "  ",
-                pModule->wszText + pModule->cwszText - min(64, pModule->cwszText)
-            );
-        }
-    }
-    nt = Util_VfsReadFile_FromPBYTE(sz, cbMax - 1, pb, cb, pcbRead, cbOffset - cStart * cbLINELENGTH);
-    LocalFree(sz);
-    return nt;
+    return Util_VfsLineFixed_Read(
+        (UTIL_VFSLINEFIXED_PFN_CB)LdrModules_ReadModulesFile_LineCB, pProcess, (DWORD)(ctxVmm->f32 ? LDRMODULES_LINELENGTH_X86 : LDRMODULES_LINELENGTH_X64),
+        pModuleMap->cMap, pModuleMap->pMap, sizeof(VMM_MAP_MODULEENTRY),
+        pb, cb, pcbRead, cbOffset
+    );
 }
 
 /*
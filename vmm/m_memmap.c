@@ -12,6 +12,8 @@
 #define MEMMAP_PTE_LINELENGTH_X64       128ULL
 #define MEMMAP_VAD_LINELENGTH_X86       137ULL
 #define MEMMAP_VAD_LINELENGTH_X64       161ULL
+#define MEMMAP_ADDRESS_LINELENGTH_X86   115ULL
+#define MEMMAP_ADDRESS_LINELENGTH_X64   131ULL
 
 VOID MemMap_Read_VadMap_Protection(_In_ PVMM_MAP_VADENTRY pVad, _Out_writes_(6) LPSTR sz)
 {
@@ -45,119 +47,130 @@ LPSTR MemMap_Read_VadMap_Type(_In_ PVMM_MAP_VADENTRY pVad)
     }
 }
 
-_Success_(return == 0)
-NTSTATUS MemMap_Read_VadMap(_In_ PVMM_PROCESS pProcess, _In_ PVMMOB_MAP_VAD pVadMap, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
+VOID MemMap_Read_VadMap_LineCB(_In_ PVMM_PROCESS pProcess, _In_ DWORD cbLineLength, _In_ DWORD ie, _In_ PVMM_MAP_VADENTRY pVad, _Out_writes_(cbLineLength + 1) LPSTR szu8)
 {
-    NTSTATUS nt;
-    LPSTR sz;
-    QWORD i, o = 0, cbMax, cStart, cVad, cbLINELENGTH;
-    PVMM_MAP_VADENTRY pVad;
     CHAR szProtection[7] = { 0 };
-    cbLINELENGTH = ctxVmm->f32 ? MEMMAP_VAD_LINELENGTH_X86 : MEMMAP_VAD_LINELENGTH_X64;
-    cStart = (DWORD)(cbOffset / cbLINELENGTH);
-    cVad = (DWORD)min(pVadMap->cMap - 1, (cb + cbOffset + cbLINELENGTH - 1) / cbLINELENGTH);
-    cbMax = 1 + (1 + cVad - cStart) * cbLINELENGTH;
-    if(!pVadMap->cMap || (cStart > pVadMap->cMap)) { return VMMDLL_STATUS_END_OF_FILE; }
-    if(!(sz = LocalAlloc(LMEM_ZEROINIT, cbMax))) { return VMMDLL_STATUS_FILE_INVALID; }
-    for(i = cStart; i <= cVad; i++) {
-        pVad = pVadMap->pMap + i;
-        MemMap_Read_VadMap_Protection(pVad, szProtection);
-        if(ctxVmm->f32) {
-            o += Util_snprintf_ln(
-                sz + o,
-                cbMax - o,
-                cbLINELENGTH,
-                "%04x%7i %08x %8x %8x %i %08x-%08x %s %s %-64S\n",
-                (DWORD)i,
-                pProcess->dwPID,
-                (DWORD)pVad->vaVad,
-                (DWORD)((pVad->vaEnd - pVad->vaStart + 1) >> 12),
-                pVad->CommitCharge,
-                pVad->MemCommit ? 1 : 0,
-                (DWORD)pVad->vaStart,
-                (DWORD)pVad->vaEnd,
-                MemMap_Read_VadMap_Type(pVad),
-                szProtection,
-                pVad->wszText + pVad->cwszText - min(64, pVad->cwszText)
-            );
-        } else {
-            o += Util_snprintf_ln(
-                sz + o,
-                cbMax - o,
-                cbLINELENGTH,
-                "%04x%7i %016llx %8x %8x %i %016llx-%016llx %s %s %-64S\n",
-                (DWORD)i,
-                pProcess->dwPID,
-                pVad->vaVad,
-                (DWORD)((pVad->vaEnd - pVad->vaStart + 1) >> 12),
-                pVad->CommitCharge,
-                pVad->MemCommit ? 1 : 0,
-                pVad->vaStart,
-                pVad->vaEnd,
-                MemMap_Read_VadMap_Type(pVad),
-                szProtection,
-                pVad->wszText + pVad->cwszText - min(64, pVad->cwszText)
-            );
-        }
+    MemMap_Read_VadMap_Protection(pVad, szProtection);
+    if(ctxVmm->f32) {
+        Util_snprintf_ln(
+            szu8,
+            cbLineLength + 1,
+            cbLineLength,
+            "%04x%7i %08x %8x %8x %i %08x-%08x %s %s %-64S\n",
+            ie,
+            pProcess->dwPID,
+            (DWORD)pVad->vaVad,
+            (DWORD)((pVad->vaEnd - pVad->vaStart + 1) >> 12),
+            pVad->CommitCharge,
+            pVad->MemCommit ? 1 : 0,
+            (DWORD)pVad->vaStart,
+            (DWORD)pVad->vaEnd,
+            MemMap_Read_VadMap_Type(pVad),
+            szProtection,
+            pVad->wszText + pVad->cwszText - min(64, pVad->cwszText)
+        );
+    } else {
+        Util_snprintf_ln(
+            szu8,
+            cbLineLength + 1,
+            cbLineLength,
+            "%04x%7i %016llx %8x %8x %i %016llx-%016llx %s %s %-64S\n",
+            ie,
+            pProcess->dwPID,
+            pVad->vaVad,
+            (DWORD)((pVad->vaEnd - pVad->vaStart + 1) >> 12),
+            pVad->CommitCharge,
+            pVad->MemCommit ? 1 : 0,
+            pVad->vaStart,
+            pVad->vaEnd,
+            MemMap_Read_VadMap_Type(pVad),
+            szProtection,
+            pVad->wszText + pVad->cwszText - min(64, pVad->cwszText)
+        );
     }
-    nt = Util_VfsReadFile_FromPBYTE(sz, cbMax - 1, pb, cb, pcbRead, cbOffset - cStart * cbLINELENGTH);
-    LocalFree(sz);
-    return nt;
 }
 
-_Success_(return == 0)
-NTSTATUS MemMap_Read_PteMap(_In_ PVMM_PROCESS pProcess, _In_ PVMMOB_MAP_PTE pPteMap, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
+VOID MemMap_Read_PteMap_LineCB(_In_ PVMM_PROCESS pProcess, _In_ DWORD cbLineLength, _In_ DWORD ie, _In_ PVMM_MAP_PTEENTRY pPte, _Out_writes_(cbLineLength + 1) LPSTR szu8)
 {
-    NTSTATUS nt;
-    LPSTR sz;
-    QWORD i, o = 0, cbMax, cStart, cEnd, cbLINELENGTH;
-    PVMM_MAP_PTEENTRY pPte;
-    cbLINELENGTH = ctxVmm->f32 ? MEMMAP_PTE_LINELENGTH_X86 : MEMMAP_PTE_LINELENGTH_X64;
-    cStart = (DWORD)(cbOffset / cbLINELENGTH);
-    cEnd = (DWORD)min(pPteMap->cMap - 1, (cb + cbOffset + cbLINELENGTH - 1) / cbLINELENGTH);
-    cbMax = 1 + (1 + cEnd - cStart) * cbLINELENGTH;
-    if(!pPteMap->cMap || (cStart > pPteMap->cMap)) { return VMMDLL_STATUS_END_OF_FILE; }
-    if(!(sz = LocalAlloc(LMEM_ZEROINIT, cbMax))) { return VMMDLL_STATUS_FILE_INVALID; }
-    for(i = cStart; i <= cEnd; i++) {
-        pPte = pPteMap->pMap + i;
-        if(ctxVmm->f32) {
-            o += Util_snprintf_ln(
-                sz + o,
-                cbMax - o,
-                cbLINELENGTH,
-                "%04x%7i %8x %08x-%08x %sr%s%s %-64S\n",
-                (DWORD)i,
-                pProcess->dwPID,
-                (DWORD)pPte->cPages,
-                (DWORD)pPte->vaBase,
-                (DWORD)(pPte->vaBase + (pPte->cPages << 12) - 1),
-                pPte->fPage & VMM_MEMMAP_PAGE_NS ? "-" : "s",
-                pPte->fPage & VMM_MEMMAP_PAGE_W ? "w" : "-",
-                pPte->fPage & VMM_MEMMAP_PAGE_NX ? "-" : "x",
-                pPte->wszText + pPte->cwszText - min(64, pPte->cwszText)
-            );
-        } else {
-            o += Util_snprintf_ln(
-                sz + o,
-                cbMax - o,
-                cbLINELENGTH,
-                "%04x%7i %8x %016llx-%016llx %sr%s%s%s%-64S\n",
-                (DWORD)i,
-                pProcess->dwPID,
-                (DWORD)pPte->cPages,
-                pPte->vaBase,
-                pPte->vaBase + (pPte->cPages << 12) - 1,
-                pPte->fPage & VMM_MEMMAP_PAGE_NS ? "-" : "s",
-                pPte->fPage & VMM_MEMMAP_PAGE_W ? "w" : "-",
-                pPte->fPage & VMM_MEMMAP_PAGE_NX ? "-" : "x",
-                pPte->cwszText ? (pPte->fWoW64 ? " 32 " : "    ") : "    ",
-                pPte->wszText + pPte->cwszText - min(64, pPte->cwszText)
-            );
-        }
+    if(ctxVmm->f32) {
+        Util_snprintf_ln(
+            szu8,
+            cbLineLength + 1,
+            cbLineLength,
+            "%04x%7i %8x %08x-%08x %sr%s%s %-64S\n",
+            ie,
+            pProcess->dwPID,
+            (DWORD)pPte->cPages,
+            (DWORD)pPte->vaBase,
+            (DWORD)(pPte->vaBase + (pPte->cPages << 12) - 1),
+            pPte->fPage & VMM_MEMMAP_PAGE_NS ? "-" : "s",
+            pPte->fPage & VMM_MEMMAP_PAGE_W ? "w" : "-",
+            pPte->fPage & VMM_MEMMAP_PAGE_NX ? "-" : "x",
+            pPte->wszText + pPte->cwszText - min(64, pPte->cwszText)
+        );
+    } else {
+        Util_snprintf_ln(
+            szu8,
+            cbLineLength + 1,
+            cbLineLength,
+            "%04x%7i %8x %016llx-%016llx %sr%s%s%s%-64S\n",
+            ie,
+            pProcess->dwPID,
+            (DWORD)pPte->cPages,
+            pPte->vaBase,
+            pPte->vaBase + (pPte->cPages << 12) - 1,
+            pPte->fPage & VMM_MEMMAP_PAGE_NS ? "-" : "s",
+            pPte->fPage & VMM_MEMMAP_PAGE_W ? "w" : "-",
+            pPte->fPage & VMM_MEMMAP_PAGE_NX ? "-" : "x",
+            pPte->cwszText ? (pPte->fWoW64 ? " 32 " : "    ") : "    ",
+            pPte->wszText + pPte->cwszText - min(64, pPte->cwszText)
+        );
     }
-    nt = Util_VfsReadFile_FromPBYTE(sz, cbMax - 1, pb, cb, pcbRead, cbOffset - cStart * cbLINELENGTH);
-    LocalFree(sz);
-    return nt;
+}
+
+typedef struct tdMEMMAP_ADDRESS_CONTEXT {
+    PVMM_PROCESS pProcess;
+    DWORD cMap;
+} MEMMAP_ADDRESS_CONTEXT, *PMEMMAP_ADDRESS_CONTEXT;
+
+/*
+* Retrieve the upper bound of the number of entries of an address map built
+* from the given source maps - each source entry adds at most two segment
+* boundaries. The address.txt file is listed and read with this number of
+* lines (the lines after the actual entries are blank) to avoid building the
+* merged address map on directory listings.
+*/
+DWORD MemMap_AddressMapBound(_In_opt_ PVMMOB_MAP_PTE pPte, _In_opt_ PVMMOB_MAP_VAD pVad, _In_opt_ PVMMOB_MAP_MODULE pModule, _In_opt_ PVMMOB_MAP_HEAP pHeap)
+{
+    return 2 * ((pPte ? pPte->cMap : 0) + (pVad ? pVad->cMap : 0) + (pModule ? pModule->cMap : 0) + (pHeap ? pHeap->cMap : 0));
+}
+
+VOID MemMap_Read_AddressMap_LineCB(_In_ PMEMMAP_ADDRESS_CONTEXT ctx, _In_ DWORD cbLineLength, _In_ DWORD ie, _In_ PVMM_MAP_ADDRESSENTRY pe, _Out_writes_(cbLineLength + 1) LPSTR szu8)
+{
+    CHAR szSource[5];
+    if(ie >= ctx->cMap) {
+        Util_snprintf_ln2(szu8, cbLineLength, "");
+        return;
+    }
+    szSource[0] = pe->pPte ? 'P' : '-';
+    szSource[1] = pe->pVad ? 'V' : '-';
+    szSource[2] = pe->pModule ? 'M' : '-';
+    szSource[3] = pe->pHeap ? 'H' : '-';
+    szSource[4] = 0;
+    Util_snprintf_ln(
+        szu8,
+        cbLineLength + 1,
+        cbLineLength,
+        ctxVmm->f32 ? "%04x%7i %08llx-%08llx %8x %s %s %-64S\n" : "%04x%7i %016llx-%016llx %8x %s %s %-64S\n",
+        ie,
+        ctx->pProcess->dwPID,
+        pe->vaStart,
+        pe->vaEnd,
+        (DWORD)((pe->vaEnd - pe->vaStart + 1) >> 12),
+        szSource,
+        pe->pVad ? MemMap_Read_VadMap_Type(pe->pVad) : "     ",
+        pe->pModule ? pe->pModule->wszText : L""
+    );
 }
 
 /*
@@ -176,21 +189,46 @@ NTSTATUS MemMap_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWORD
     NTSTATUS nt = VMMDLL_STATUS_FILE_INVALID;
     PVMMOB_MAP_PTE pObMemMapPte = NULL;
     PVMMOB_MAP_VAD pObMemMapVad = NULL;
+    PVMMOB_MAP_ADDRESS pObMemMapAddress = NULL;
+    MEMMAP_ADDRESS_CONTEXT ctxAddress;
     // read page table memory map.
     if(!_wcsicmp(ctx->wszPath, L"pte.txt")) {
         if(VmmMap_GetPte(ctx->pProcess, &pObMemMapPte, TRUE)) {
-            nt = MemMap_Read_PteMap(ctx->pProcess, pObMemMapPte, pb, cb, pcbRead, cbOffset);
+            nt = Util_VfsLineFixed_Read(
+                (UTIL_VFSLINEFIXED_PFN_CB)MemMap_Read_PteMap_LineCB, ctx->pProcess, (DWORD)(ctxVmm->f32 ? MEMMAP_PTE_LINELENGTH_X86 : MEMMAP_PTE_LINELENGTH_X64),
+                pObMemMapPte->cMap, pObMemMapPte->pMap, sizeof(VMM_MAP_PTEENTRY),
+                pb, cb, pcbRead, cbOffset
+            );
             Ob_DECREF(pObMemMapPte);
         }
         return nt;
     }
     if(!_wcsicmp(ctx->wszPath, L"vad.txt")) {
         if(VmmMap_GetVad(ctx->pProcess, &pObMemMapVad, TRUE)) {
-            nt = MemMap_Read_VadMap(ctx->pProcess, pObMemMapVad, pb, cb, pcbRead, cbOffset);
+            nt = Util_VfsLineFixed_Read(
+                (UTIL_VFSLINEFIXED_PFN_CB)MemMap_Read_VadMap_LineCB, ctx->pProcess, (DWORD)(ctxVmm->f32 ? MEMMAP_VAD_LINELENGTH_X86 : MEMMAP_VAD_LINELENGTH_X64),
+                pObMemMapVad->cMap, pObMemMapVad->pMap, sizeof(VMM_MAP_VADENTRY),
+                pb, cb, pcbRead, cbOffset
+            );
             Ob_DECREF(pObMemMapVad);
         }
         return nt;
     }
+    // read merged pte/vad/module/heap address map.
+    if(!_wcsicmp(ctx->wszPath, L"address.txt")) {
+        if(VmmMap_GetAddress(ctx->pProcess, &pObMemMapAddress)) {
+            ctxAddress.pProcess = ctx->pProcess;
+            ctxAddress.cMap = pObMemMapAddress->cMap;
+            nt = Util_VfsLineFixed_Read(
+                (UTIL_VFSLINEFIXED_PFN_CB)MemMap_Read_AddressMap_LineCB, &ctxAddress, (DWORD)(ctxVmm->f32 ? MEMMAP_ADDRESS_LINELENGTH_X86 : MEMMAP_ADDRESS_LINELENGTH_X64),
+                MemMap_AddressMapBound(pObMemMapAddress->pObPte, pObMemMapAddress->pObVad, pObMemMapAddress->pObModule, pObMemMapAddress->pObHeap),
+                pObMemMapAddress->pMap, sizeof(VMM_MAP_ADDRESSENTRY),
+                pb, cb, pcbRead, cbOffset
+            );
+            Ob_DECREF(pObMemMapAddress);
+        }
+        return nt;
+    }
     return nt;
 }
 
@@ -206,16 +244,27 @@ BOOL MemMap_List(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Inout_ PHANDLE pFileList)
 {
     PVMMOB_MAP_PTE pObMemMapPte = NULL;
     PVMMOB_MAP_VAD pObMemMapVad = NULL;
+    PVMMOB_MAP_MODULE pObMemMapModule = NULL;
+    PVMMOB_MAP_HEAP pObMemMapHeap = NULL;
+    DWORD cAddress;
     // list page table memory map.
     if(VmmMap_GetPte(ctx->pProcess, &pObMemMapPte, FALSE)) {
         VMMDLL_VfsList_AddFile(pFileList, L"pte.txt", pObMemMapPte->cMap * (ctxVmm->f32 ? MEMMAP_PTE_LINELENGTH_X86 : MEMMAP_PTE_LINELENGTH_X64), NULL);
-        Ob_DECREF_NULL(&pObMemMapPte);
     }
     // list vad memory map.
     if(VmmMap_GetVad(ctx->pProcess, &pObMemMapVad, FALSE)) {
         VMMDLL_VfsList_AddFile(pFileList, L"vad.txt", pObMemMapVad->cMap * (ctxVmm->f32 ? MEMMAP_VAD_LINELENGTH_X86 : MEMMAP_VAD_LINELENGTH_X64), NULL);
-        Ob_DECREF_NULL(&pObMemMapVad);
     }
+    // list merged address map (upper bound size - the map is built on read).
+    VmmMap_GetModule(ctx->pProcess, &pObMemMapModule);
+    VmmMap_GetHeap(ctx->pProcess, &pObMemMapHeap);
+    if((cAddress = MemMap_AddressMapBound(pObMemMapPte, pObMemMapVad, pObMemMapModule, pObMemMapHeap))) {
+        VMMDLL_VfsList_AddFile(pFileList, L"address.txt", cAddress * (ctxVmm->f32 ? MEMMAP_ADDRESS_LINELENGTH_X86 : MEMMAP_ADDRESS_LINELENGTH_X64), NULL);
+    }
+    Ob_DECREF(pObMemMapPte);
+    Ob_DECREF(pObMemMapVad);
+    Ob_DECREF(pObMemMapModule);
+    Ob_DECREF(pObMemMapHeap);
     return TRUE;
 }
 
@@ -23,11 +23,27 @@ LPCSTR szMMINIDUMP_README =
 "  - symbols from Microsoft symbol server must be downloaded and active.      \n" \
 "  - process must be an active user-mode (non-kernel) process.                \n";
 
+//
+// The minidump is laid out on first access - when its size is needed. Only
+// the stream sizes and the memory ranges are decided at layout time. Streams
+// which require reads of process memory (module list with PE timestamps and
+// codeview info, thread list with cpu contexts) and the registry (misc info)
+// are populated into their reserved space upon first read of the stream.
+// Memory ranges are read from the process at minidump read time.
+//
+
 typedef struct tdOB_M_MINIDUMP_CONTEXT {
     OB ObHdr;
     DWORD cb;
     PBYTE pb;
     QWORD cbMemory;
+    PVMMOB_MAP_THREAD pObThreadMap;     // thread map used at layout time
+    PVMMOB_MAP_MODULE pObModuleMap;     // module map used at layout time
+    struct {
+        BOOL fThreadList;
+        BOOL fModuleList;
+        BOOL fMiscInfo;
+    } Lazy;                             // lazy streams populated
     struct {
         DWORD cb;
         DWORD rva;
@@ -42,6 +58,8 @@ typedef struct tdOB_M_MINIDUMP_CONTEXT {
         DWORD cb;
         DWORD rva;
         PMINIDUMP_THREAD_LIST p;
+        DWORD rvaContext;               // reserved: cpu context per thread
+        DWORD cbContext;
     } ThreadList;
     struct {
         DWORD cb;
@@ -53,6 +71,8 @@ typedef struct tdOB_M_MINIDUMP_CONTEXT {
         DWORD cb;
         DWORD rva;
         PMINIDUMP_MODULE_LIST p;
+        DWORD rvaCodeView;              // reserved: codeview record per module
+        DWORD cbCodeView;
     } ModuleList;
     struct {
         DWORD cb;
@@ -99,11 +119,10 @@ UCHAR M_MiniDump_Initialize_GetThreadPriorityClass(PVMM_MAP_THREADENTRY peT)
     return 32;
 }
 
-DWORD M_MiniDump_Initialize_AddBinary(_Inout_ POB_M_MINIDUMP_CONTEXT ctx, _In_ PBYTE pb, _In_ DWORD cb)
+DWORD M_MiniDump_Initialize_AddReserved(_Inout_ POB_M_MINIDUMP_CONTEXT ctx, _In_ DWORD cb)
 {
     ctx->cb = (ctx->cb + 3) & ~3;       // DWORD ALIGN START
     if((ctx->cb >> 23) || (cb >> 23)) { return 0; }
-    memcpy(ctx->pb + ctx->cb, pb, cb);
     ctx->cb += cb;
     return ctx->cb - cb;
 }
@@ -120,7 +139,7 @@ DWORD M_MiniDump_Initialize_AddText(_Inout_ POB_M_MINIDUMP_CONTEXT ctx, _In_ LPW
     return rva;
 }
 
-VOID M_MiniDump_Initialize_ThreadList_CpuContext32(_In_ PVMM_PROCESS pSystemProcess, _Inout_ POB_M_MINIDUMP_CONTEXT mdCtx, _In_ PVMM_MAP_THREADENTRY peT, _Inout_ PMINIDUMP_THREAD pmdT)
+VOID M_MiniDump_Initialize_ThreadList_CpuContext32(_In_ PVMM_PROCESS pSystemProcess, _Inout_ POB_M_MINIDUMP_CONTEXT mdCtx, _In_ PVMM_MAP_THREADENTRY peT, _Inout_ PMINIDUMP_THREAD pmdT, _In_ DWORD rvaContext)
 {
     CPU_CONTEXT32 ctx = { 0 };
     CPU_KTRAP_FRAME32 trap = { 0 };
@@ -147,11 +166,13 @@ VOID M_MiniDump_Initialize_ThreadList_CpuContext32(_In_ PVMM_PROCESS pSystemProc
     ctx.EFlags = trap.EFlags;
     ctx.Esp = trap.HardwareEsp;
     ctx.SegSs = trap.HardwareSegSs;
+    if(!rvaContext) { return; }
+    memcpy(mdCtx->pb + rvaContext, &ctx, sizeof(CPU_CONTEXT32));
     pmdT->ThreadContext.DataSize = sizeof(CPU_CONTEXT32);
-    pmdT->ThreadContext.Rva = M_MiniDump_Initialize_AddBinary(mdCtx, (PBYTE)&ctx, sizeof(CPU_CONTEXT32));
+    pmdT->ThreadContext.Rva = rvaContext;
 }
 
-VOID M_MiniDump_Initialize_ThreadList_CpuContext64(_In_ PVMM_PROCESS pSystemProcess, _Inout_ POB_M_MINIDUMP_CONTEXT mdCtx, _In_ PVMM_MAP_THREADENTRY peT, _Inout_ PMINIDUMP_THREAD pmdT)
+VOID M_MiniDump_Initialize_ThreadList_CpuContext64(_In_ PVMM_PROCESS pSystemProcess, _Inout_ POB_M_MINIDUMP_CONTEXT mdCtx, _In_ PVMM_MAP_THREADENTRY peT, _Inout_ PMINIDUMP_THREAD pmdT, _In_ DWORD rvaContext)
 {
     CPU_CONTEXT64 ctx = { 0 };
     CPU_KTRAP_FRAME64 trap = { 0 };
@@ -194,21 +215,24 @@ VOID M_MiniDump_Initialize_ThreadList_CpuContext64(_In_ PVMM_PROCESS pSystemProc
     ctx.Xmm3 = trap.Xmm3;
     ctx.Xmm4 = trap.Xmm4;
     ctx.Xmm5 = trap.Xmm5;
+    if(!rvaContext) { return; }
+    memcpy(mdCtx->pb + rvaContext, &ctx, sizeof(CPU_CONTEXT64));
     pmdT->ThreadContext.DataSize = sizeof(CPU_CONTEXT64);
-    pmdT->ThreadContext.Rva = M_MiniDump_Initialize_AddBinary(mdCtx, (PBYTE)&ctx, sizeof(CPU_CONTEXT64));
+    pmdT->ThreadContext.Rva = rvaContext;
 }
 
 VOID M_MiniDump_CallbackCleanup_ObMiniDumpContext(POB_M_MINIDUMP_CONTEXT pOb)
 {
+    Ob_DECREF(pOb->pObThreadMap);
+    Ob_DECREF(pOb->pObModuleMap);
     LocalFree(pOb->pb);
 }
 
 VOID M_MiniDump_Initialize_Internal(_In_ PVMM_PROCESS pProcess)
 {
     BOOL f, f32 = ctxVmm->f32;
-    DWORD i, j, iPte, iVad, iMR, dwCpuMhz, cThreadActive = 0;
+    DWORD i, j, iPte, iVad, iMR, cThreadActive = 0;
     QWORD qw;
-    PVMM_PROCESS pObSystemProcess = NULL;
     POB_M_MINIDUMP_CONTEXT ctx = NULL;
     PMINIDUMP_THREAD pmdT;
     PMINIDUMP_THREAD_INFO pmdTI;
@@ -217,8 +241,6 @@ VOID M_MiniDump_Initialize_Internal(_In_ PVMM_PROCESS pProcess)
     PMINIDUMP_MODULE pmdM;
     PVMMOB_MAP_MODULE pObModuleMap = NULL;
     PVMM_MAP_MODULEENTRY peM;
-    POB_SET psObPrefetch = NULL;
-    PE_CODEVIEW_INFO CodeViewInfo;
     PVMMOB_MAP_PTE pObPteMap = NULL;
     PVMMOB_MAP_VAD pObVadMap = NULL;
     PVMM_MAP_PTEENTRY peP;
@@ -227,8 +249,6 @@ VOID M_MiniDump_Initialize_Internal(_In_ PVMM_PROCESS pProcess)
     PMINIDUMP_MEMORY_INFO pmdMI, pmdMIprev;
     WCHAR wszComment[0x80];
     // initialization
-    if(!(psObPrefetch = ObSet_New())) { goto fail; }
-    if(!(pObSystemProcess = VmmProcessGet(4))) { goto fail; }
     if(!VmmMap_GetPte(pProcess, &pObPteMap, FALSE) || !pObPteMap->cMap || (pObPteMap->cMap > 0x4000)) { goto fail; }
     if(!VmmMap_GetVad(pProcess, &pObVadMap, TRUE) || !pObVadMap->cMap || (pObVadMap->cMap > 0x1000)) { goto fail; }
     if(!VmmMap_GetThread(pProcess, &pObThreadMap) || !pObThreadMap->cMap || (pObThreadMap->cMap > 0x4000)) { goto fail; }
@@ -308,14 +328,7 @@ VOID M_MiniDump_Initialize_Internal(_In_ PVMM_PROCESS pProcess)
         ctx->MiscInfoStream.p->ProcessCreateTime = (DWORD)((*(PQWORD)(pProcess->win.EPROCESS.pb + ctxVmm->offset.EPROCESS.opt.CreateTime) - 11644473600000 * 10000) / 10000000);
         ctx->MiscInfoStream.p->ProcessUserTime = *(PDWORD)(pProcess->win.EPROCESS.pb + ctxVmm->offset.EPROCESS.opt.UserTime);
         ctx->MiscInfoStream.p->ProcessKernelTime = *(PDWORD)(pProcess->win.EPROCESS.pb + ctxVmm->offset.EPROCESS.opt.KernelTime);
-        if(VmmWinReg_ValueQuery2(L"HKLM\\HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0\\~MHz", NULL, (PBYTE)&dwCpuMhz, sizeof(DWORD), NULL)) {
-            ctx->MiscInfoStream.p->Flags1 = ctx->MiscInfoStream.p->Flags1 | MINIDUMP_MISC1_PROCESSOR_POWER_INFO;
-            ctx->MiscInfoStream.p->ProcessorMaxMhz = dwCpuMhz;
-            ctx->MiscInfoStream.p->ProcessorCurrentMhz = dwCpuMhz;
-            ctx->MiscInfoStream.p->ProcessorMhzLimit = dwCpuMhz;
-            ctx->MiscInfoStream.p->ProcessorMaxIdleState = 2;       // DUMMY VALUE
-            ctx->MiscInfoStream.p->ProcessorCurrentIdleState = 2;   // DUMMY VALUE
-        }
+        // PROCESSOR POWER INFO ADDED LATER (lazy stream)
         // TODO: ADD TIMEZONE INFO AND OTHER MISC INFO
     }
 
@@ -345,7 +358,8 @@ VOID M_MiniDump_Initialize_Internal(_In_ PVMM_PROCESS pProcess)
             pmdM = &ctx->ModuleList.p->Modules[i];
             pmdM->BaseOfImage = peM->vaBase;
             pmdM->SizeOfImage = peM->cbImageSize;
-            PE_GetTimeDateStampCheckSum(pProcess, peM->vaBase, &pmdM->TimeDateStamp, &pmdM->CheckSum);
+            //pmdM->TimeDateStamp       // ADDED LATER (lazy stream)
+            //pmdM->CheckSum            // ADDED LATER (lazy stream)
             pmdM->ModuleNameRva = M_MiniDump_Initialize_AddText(ctx, peM->wszFullName);
             //pmdM->VersionInfo. ...    // TODO:
             //pmdM->CvRecord            // ADDED LATER
@@ -390,34 +404,22 @@ VOID M_MiniDump_Initialize_Internal(_In_ PVMM_PROCESS pProcess)
                 if((peT->vaStackBaseUser > peT->vaRSP) && (peT->vaStackLimitUser < peT->vaRSP)) {
                     pmdT->Stack.StartOfMemoryRange = peT->vaRSP;
                     pmdT->Stack.Memory.DataSize = (DWORD)(peT->vaStackBaseUser - peT->vaRSP);
-                    ObSet_Push(psObPrefetch, peT->vaTrapFrame);
-                }
-            }
-        }
-        VmmCachePrefetchPages3(pObSystemProcess, psObPrefetch, sizeof(CPU_KTRAP_FRAME64), 0);
-        ObSet_Clear(psObPrefetch);
-        for(i = 0, j = 0; i < pObThreadMap->cMap; i++) {
-            if((peT = &pObThreadMap->pMap[i])->ftExitTime) { continue; }
-            pmdT = &ctx->ThreadList.p->Threads[j++];
-            if(pmdT->Stack.StartOfMemoryRange) {
-                if(f32) {
-                    M_MiniDump_Initialize_ThreadList_CpuContext32(pObSystemProcess, ctx, peT, pmdT);
-                } else {
-                    M_MiniDump_Initialize_ThreadList_CpuContext64(pObSystemProcess, ctx, peT, pmdT);
                 }
             }
+            //pmdT->ThreadContext       // ADDED LATER (lazy stream)
         }
     }
 
-    // populate: MINIDUMP_MODULE_LIST #2 - CODEVIEW PDB DEBUG INFO
+    // reserve: MINIDUMP_THREAD_LIST - CPU CONTEXT (one per thread)
     {
-        for(i = 0; i < ctx->ModuleList.p->NumberOfModules; i++) {
-            pmdM = &ctx->ModuleList.p->Modules[i];
-            if(PE_GetCodeViewInfo(pProcess, pmdM->BaseOfImage, NULL, &CodeViewInfo)) {
-                pmdM->CvRecord.DataSize = CodeViewInfo.SizeCodeView;
-                pmdM->CvRecord.Rva = M_MiniDump_Initialize_AddBinary(ctx, (PBYTE)&CodeViewInfo.CodeView, CodeViewInfo.SizeCodeView);
-            }
-        }
+        ctx->ThreadList.cbContext = cThreadActive * (f32 ? sizeof(CPU_CONTEXT32) : sizeof(CPU_CONTEXT64));
+        ctx->ThreadList.rvaContext = M_MiniDump_Initialize_AddReserved(ctx, ctx->ThreadList.cbContext);
+    }
+
+    // reserve: MINIDUMP_MODULE_LIST - CODEVIEW PDB DEBUG INFO (one per module)
+    {
+        ctx->ModuleList.cbCodeView = pObModuleMap->cMap * sizeof(PE_CODEVIEW);
+        ctx->ModuleList.rvaCodeView = M_MiniDump_Initialize_AddReserved(ctx, ctx->ModuleList.cbCodeView);
     }
 
 // populate: MINIDUMP_UNLOADED_MODULE_LIST
@@ -591,13 +593,15 @@ VOID M_MiniDump_Initialize_Internal(_In_ PVMM_PROCESS pProcess)
     ctx->MemoryList.p->BaseRva = ctx->cb;
     if(ctx->pb != LocalReAlloc(ctx->pb, ctx->cb, LMEM_FIXED)) { goto fail; }
 
-    // finish
+    // finish - maps are kept for the lazy streams
+    ctx->pObThreadMap = pObThreadMap;
+    ctx->pObModuleMap = pObModuleMap;
+    pObThreadMap = NULL;
+    pObModuleMap = NULL;
     ObContainer_SetOb(pProcess->pObPersistent->Plugin.pObCMiniDump, ctx);
 fail:
-    Ob_DECREF(pObSystemProcess);
     Ob_DECREF(pObPteMap);
     Ob_DECREF(pObVadMap);
-    Ob_DECREF(psObPrefetch);
     Ob_DECREF(pObThreadMap);
     Ob_DECREF(pObModuleMap);
     Ob_DECREF(ctx);
@@ -617,17 +621,196 @@ POB_M_MINIDUMP_CONTEXT M_MiniDump_GetContext(_In_ PVMM_PROCESS pProcess)
     return pObCtx;
 }
 
+/*
+* Populate lazy stream: MINIDUMP_THREAD_LIST - CPU CONTEXT (from trap frames).
+*/
+VOID M_MiniDump_Lazy_ThreadList(_Inout_ POB_M_MINIDUMP_CONTEXT ctx)
+{
+    DWORD i, j, cbContext;
+    PMINIDUMP_THREAD pmdT;
+    PVMM_MAP_THREADENTRY peT;
+    PVMM_PROCESS pObSystemProcess = NULL;
+    POB_SET psObPrefetch = NULL;
+    PVMMOB_MAP_THREAD pThreadMap = ctx->pObThreadMap;
+    if(!(pObSystemProcess = VmmProcessGet(4)) || !(psObPrefetch = ObSet_New())) { goto fail; }
+    cbContext = ctxVmm->f32 ? sizeof(CPU_CONTEXT32) : sizeof(CPU_CONTEXT64);
+    for(i = 0; i < pThreadMap->cMap; i++) {
+        if(!pThreadMap->pMap[i].ftExitTime) {
+            ObSet_Push(psObPrefetch, pThreadMap->pMap[i].vaTrapFrame);
+        }
+    }
+    VmmCachePrefetchPages3(pObSystemProcess, psObPrefetch, sizeof(CPU_KTRAP_FRAME64), 0);
+    for(i = 0, j = 0; i < pThreadMap->cMap; i++) {
+        if((peT = &pThreadMap->pMap[i])->ftExitTime) { continue; }
+        pmdT = &ctx->ThreadList.p->Threads[j];
+        if(pmdT->Stack.StartOfMemoryRange && ctx->ThreadList.rvaContext) {
+            if(ctxVmm->f32) {
+                M_MiniDump_Initialize_ThreadList_CpuContext32(pObSystemProcess, ctx, peT, pmdT, ctx->ThreadList.rvaContext + j * cbContext);
+            } else {
+                M_MiniDump_Initialize_ThreadList_CpuContext64(pObSystemProcess, ctx, peT, pmdT, ctx->ThreadList.rvaContext + j * cbContext);
+            }
+        }
+        j++;
+    }
+fail:
+    Ob_DECREF(psObPrefetch);
+    Ob_DECREF(pObSystemProcess);
+}
+
+/*
+* Populate lazy stream: MINIDUMP_MODULE_LIST - PE TIMESTAMP/CHECKSUM AND
+* CODEVIEW PDB DEBUG INFO (from module PE headers).
+*/
+VOID M_MiniDump_Lazy_ModuleList(_In_ PVMM_PROCESS pProcess, _Inout_ POB_M_MINIDUMP_CONTEXT ctx)
+{
+    DWORD i, rva;
+    PMINIDUMP_MODULE pmdM;
+    PE_CODEVIEW_INFO CodeViewInfo;
+    for(i = 0; i < ctx->ModuleList.p->NumberOfModules; i++) {
+        pmdM = &ctx->ModuleList.p->Modules[i];
+        PE_GetTimeDateStampCheckSum(pProcess, pmdM->BaseOfImage, &pmdM->TimeDateStamp, &pmdM->CheckSum);
+        if(ctx->ModuleList.rvaCodeView && PE_GetCodeViewInfo(pProcess, pmdM->BaseOfImage, NULL, &CodeViewInfo)) {
+            rva = ctx->ModuleList.rvaCodeView + i * sizeof(PE_CODEVIEW);
+            memcpy(ctx->pb + rva, &CodeViewInfo.CodeView, min(CodeViewInfo.SizeCodeView, sizeof(PE_CODEVIEW)));
+            pmdM->CvRecord.DataSize = min(CodeViewInfo.SizeCodeView, sizeof(PE_CODEVIEW));
+            pmdM->CvRecord.Rva = rva;
+        }
+    }
+}
+
+/*
+* Populate lazy stream: MINIDUMP_MISC_INFO_3 - PROCESSOR POWER INFO (registry).
+*/
+VOID M_MiniDump_Lazy_MiscInfo(_Inout_ POB_M_MINIDUMP_CONTEXT ctx)
+{
+    DWORD dwCpuMhz;
+    if(VmmWinReg_ValueQuery2(L"HKLM\\HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0\\~MHz", NULL, (PBYTE)&dwCpuMhz, sizeof(DWORD), NULL)) {
+        ctx->MiscInfoStream.p->Flags1 = ctx->MiscInfoStream.p->Flags1 | MINIDUMP_MISC1_PROCESSOR_POWER_INFO;
+        ctx->MiscInfoStream.p->ProcessorMaxMhz = dwCpuMhz;
+        ctx->MiscInfoStream.p->ProcessorCurrentMhz = dwCpuMhz;
+        ctx->MiscInfoStream.p->ProcessorMhzLimit = dwCpuMhz;
+        ctx->MiscInfoStream.p->ProcessorMaxIdleState = 2;       // DUMMY VALUE
+        ctx->MiscInfoStream.p->ProcessorCurrentIdleState = 2;   // DUMMY VALUE
+    }
+}
+
+/*
+* Check whether the range [rva, rva+cb) overlaps the read [cbOffset, cbOffset+cbRead).
+*/
+#define M_MINIDUMP_OVERLAP(rva, cb, cbOffset, cbRead)   ((cb) && ((QWORD)(rva) < (cbOffset) + (cbRead)) && ((cbOffset) < (QWORD)(rva) + (cb)))
+
+/*
+* Ensure lazy streams overlapping the header read [cbOffset, cbOffset+cb) are
+* populated before they are read.
+* -- pProcess
+* -- ctx
+* -- cbOffset
+* -- cb
+*/
+VOID M_MiniDump_Lazy_Ensure(_In_ PVMM_PROCESS pProcess, _Inout_ POB_M_MINIDUMP_CONTEXT ctx, _In_ QWORD cbOffset, _In_ DWORD cb)
+{
+    BOOL fThreadList, fModuleList, fMiscInfo;
+    fThreadList = !ctx->Lazy.fThreadList && (M_MINIDUMP_OVERLAP(ctx->ThreadList.rva, ctx->ThreadList.cb, cbOffset, cb) || M_MINIDUMP_OVERLAP(ctx->ThreadList.rvaContext, ctx->ThreadList.cbContext, cbOffset, cb));
+    fModuleList = !ctx->Lazy.fModuleList && (M_MINIDUMP_OVERLAP(ctx->ModuleList.rva, ctx->ModuleList.cb, cbOffset, cb) || M_MINIDUMP_OVERLAP(ctx->ModuleList.rvaCodeView, ctx->ModuleList.cbCodeView, cbOffset, cb));
+    fMiscInfo = !ctx->Lazy.fMiscInfo && M_MINIDUMP_OVERLAP(ctx->MiscInfoStream.rva, ctx->MiscInfoStream.cb, cbOffset, cb);
+    if(!fThreadList && !fModuleList && !fMiscInfo) { return; }
+    EnterCriticalSection(&pProcess->LockPlugin);
+    if(fThreadList && !ctx->Lazy.fThreadList) {
+        M_MiniDump_Lazy_ThreadList(ctx);
+        ctx->Lazy.fThreadList = TRUE;
+    }
+    if(fModuleList && !ctx->Lazy.fModuleList) {
+        M_MiniDump_Lazy_ModuleList(pProcess, ctx);
+        ctx->Lazy.fModuleList = TRUE;
+    }
+    if(fMiscInfo && !ctx->Lazy.fMiscInfo) {
+        M_MiniDump_Lazy_MiscInfo(ctx);
+        ctx->Lazy.fMiscInfo = TRUE;
+    }
+    LeaveCriticalSection(&pProcess->LockPlugin);
+}
+
+/*
+* Read minidump memory ranges. All memory ranges overlapping the read are read
+* in one single scatter read. Unreadable memory is zero padded.
+* -- pProcess
+* -- ctx
+* -- pb
+* -- cb
+* -- cbOffset = offset from start of minidump memory (BaseRva).
+* -- return = number of bytes read.
+*/
+DWORD M_MiniDump_ReadMemory(_In_ PVMM_PROCESS pProcess, _In_ POB_M_MINIDUMP_CONTEXT ctx, _Out_writes_(cb) PBYTE pb, _In_ DWORD cb, _In_ QWORD cbOffset)
+{
+    BOOL fPrepare;
+    DWORD i, iStart, iPass, cMEMs = 0, cbRead, cbPiece, cbCopy, cbStart;
+    QWORD va, vaPage, vaCopy, cbBase = 0, cbBaseStart, cbIntraOffset;
+    PBYTE pbBuffer = NULL;
+    PMEM_SCATTER pMEMs = NULL, *ppMEMs = NULL;
+    PMINIDUMP_MEMORY_DESCRIPTOR64 pmd;
+    PMINIDUMP_MEMORY64_LIST pml = ctx->MemoryList.p;
+    // 1: locate first memory range
+    for(iStart = 0; iStart < pml->NumberOfMemoryRanges; iStart++) {
+        if(cbBase + pml->MemoryRanges[iStart].DataSize > cbOffset) { break; }
+        cbBase += pml->MemoryRanges[iStart].DataSize;
+    }
+    if(iStart == pml->NumberOfMemoryRanges) { return 0; }
+    cbBaseStart = cbBase;
+    // 2: count pages (1st pass), prepare scatter (2nd pass) and copy read result (3rd pass)
+    for(iPass = 0; iPass < 3; iPass++) {
+        fPrepare = (iPass == 1);
+        cbBase = cbBaseStart;
+        cbRead = 0;
+        cMEMs = 0;
+        for(i = iStart; (i < pml->NumberOfMemoryRanges) && (cbRead < cb); i++) {
+            pmd = &pml->MemoryRanges[i];
+            cbIntraOffset = (cbBase < cbOffset) ? cbOffset - cbBase : 0;
+            cbPiece = (DWORD)min(cb - cbRead, pmd->DataSize - cbIntraOffset);
+            va = pmd->StartOfMemoryRange + cbIntraOffset;
+            for(vaPage = va & ~0xfff; vaPage < va + cbPiece; vaPage += 0x1000, cMEMs++) {
+                if(fPrepare) {
+                    ppMEMs[cMEMs] = &pMEMs[cMEMs];
+                    pMEMs[cMEMs].version = MEM_SCATTER_VERSION;
+                    pMEMs[cMEMs].qwA = vaPage;
+                    pMEMs[cMEMs].cb = 0x1000;
+                    pMEMs[cMEMs].pb = pbBuffer + ((QWORD)cMEMs << 12);
+                } else if(pbBuffer) {
+                    vaCopy = max(va, vaPage);
+                    cbCopy = (DWORD)(min(va + cbPiece, vaPage + 0x1000) - vaCopy);
+                    cbStart = cbRead + (DWORD)(vaCopy - va);
+                    if(pMEMs[cMEMs].f) {
+                        memcpy(pb + cbStart, pMEMs[cMEMs].pb + (vaCopy - vaPage), cbCopy);
+                    } else {
+                        ZeroMemory(pb + cbStart, cbCopy);
+                    }
+                }
+            }
+            cbRead += cbPiece;
+            cbBase += pmd->DataSize;
+        }
+        if(iPass == 0) {
+            if(!cMEMs || !(pbBuffer = LocalAlloc(LMEM_ZEROINIT, cMEMs * (0x1000 + sizeof(MEM_SCATTER) + sizeof(PMEM_SCATTER))))) { return 0; }
+            pMEMs = (PMEM_SCATTER)(pbBuffer + ((QWORD)cMEMs << 12));
+            ppMEMs = (PPMEM_SCATTER)(pbBuffer + ((QWORD)cMEMs << 12) + cMEMs * sizeof(MEM_SCATTER));
+        }
+        if(iPass == 1) {
+            VmmReadScatterVirtual(pProcess, ppMEMs, cMEMs, 0);
+        }
+    }
+    LocalFree(pbBuffer);
+    return cbRead;
+}
+
 _Success_(return == STATUS_SUCCESS)
 NTSTATUS M_MiniDump_ReadMiniDump(_In_ PVMM_PROCESS pProcess, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
 {
-    DWORD i, cbHead = 0, cbReadMem = 0, dwIntraSize;
-    QWORD cbBase = 0, cbIntraOffset;
-    PMINIDUMP_MEMORY_DESCRIPTOR64 pmd;
+    DWORD cbHead = 0, cbReadMem = 0;
     POB_M_MINIDUMP_CONTEXT pObMiniDump = NULL;
     if(!(pObMiniDump = M_MiniDump_GetContext(pProcess))) { return VMMDLL_STATUS_FILE_INVALID; }
     // read minidmump header
     if(cbOffset < pObMiniDump->cb) {
         cbHead = min(cb, pObMiniDump->cb - (DWORD)cbOffset);
+        M_MiniDump_Lazy_Ensure(pProcess, pObMiniDump, cbOffset, cbHead);
         memcpy(pb, pObMiniDump->pb + cbOffset, cbHead);
         pb += cbHead;
         cb -= cbHead;
@@ -636,21 +819,7 @@ NTSTATUS M_MiniDump_ReadMiniDump(_In_ PVMM_PROCESS pProcess, _Out_ PBYTE pb, _In
     if(cb == 0) { goto finish; }
     cbOffset -= pObMiniDump->cb;
     // read memory
-    for(i = 0; i < pObMiniDump->MemoryList.p->NumberOfMemoryRanges; i++) {
-        pmd = &pObMiniDump->MemoryList.p->MemoryRanges[i];
-        if(i) {
-            cbBase += pObMiniDump->MemoryList.p->MemoryRanges[i - 1].DataSize;
-        }
-        if(cbBase + pmd->DataSize <= cbOffset) { continue; }
-        if(cbBase >= cbOffset + cbReadMem + cb) { break; }
-        cbIntraOffset = (cbBase < cbOffset) ? cbOffset - cbBase : 0;
-        dwIntraSize = (DWORD)min(cb, pmd->DataSize - cbIntraOffset);
-        VmmReadEx(pProcess, pmd->StartOfMemoryRange + cbIntraOffset, pb, dwIntraSize, NULL, VMM_FLAG_ZEROPAD_ON_FAIL);
-        cbReadMem += dwIntraSize;
-        pb += dwIntraSize;
-        cb -= dwIntraSize;
-        if(cb == 0) { break; }
-    }
+    cbReadMem = M_MiniDump_ReadMemory(pProcess, pObMiniDump, pb, cb, cbOffset);
 finish:
     if(pcbRead) { *pcbRead = cbHead + cbReadMem; }
     Ob_DECREF(pObMiniDump);
@@ -14,6 +14,8 @@ LPCSTR szMPHYS2VIRT_README =
     "scan of process page tables for corresponding virtual addresses.   Up to four\n" \
     "virtual addresses which map to physical address will be presented in the file\n" \
     "'virt' (per process).                                                        \n" \
+    "If started with -phys2virtindex a global index is used  and all  virtual      \n" \
+    "addresses are shown in the root module 'virt' file.                          \n" \
     "The phys2virt module may take time to execute  - especially if using the root\n" \
     "module (scan all process page tables) instead of individual processes.       \n" \
     "For more information please visit: https://github.com/ufrisk/MemProcFS/wiki  \n";
@@ -49,6 +51,32 @@ VOID Phys2Virt_GetUpdateAll_CallbackAction(_In_ PVMM_PROCESS pProcess, _In_opt_
     Ob_DECREF(pObPhys2Virt);
 }
 
+/*
+* Retrieve all virtual addresses from the global phys2virt index. There is no
+* per-process limit on the number of results in this case.
+* CALLER LocalFree: return
+* -- pObIndex
+* -- pa
+* -- return
+*/
+PM_PHYS2VIRT_MULTIENTRY_CONTEXT Phys2Virt_GetUpdateAll_FromIndex(_In_ PVMMOB_PHYS2VIRT_INDEX pObIndex, _In_ QWORD pa)
+{
+    DWORD i, c;
+    PVMM_PHYS2VIRT_INDEX_ENTRY pe;
+    PM_PHYS2VIRT_MULTIENTRY_CONTEXT ctx = NULL;
+    c = pa ? VmmPhys2VirtIndex_Lookup(pObIndex, pa, &pe) : 0;
+    ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(M_PHYS2VIRT_MULTIENTRY_CONTEXT) + (c + 1ULL) * sizeof(M_PHYS2VIRT_MULTIENTRY));
+    if(!ctx) { return NULL; }
+    ctx->pa = pa;
+    ctx->c = c;
+    ctx->cMax = c + 1;
+    for(i = 0; i < c; i++) {
+        ctx->e[i + 1].dwPID = pe[i].dwPID;
+        ctx->e[i + 1].va = pe[i].va | (pa & 0xfff);
+    }
+    return ctx;
+}
+
 /*
 * CALLER LocalFree: ppMultiEntry
 */
@@ -56,7 +84,14 @@ _Success_(return)
 BOOL Phys2Virt_GetUpdateAll(_Out_opt_ PM_PHYS2VIRT_MULTIENTRY_CONTEXT *ppMultiEntry, _Out_opt_ PDWORD pcMultiEntry)
 {
     PM_PHYS2VIRT_MULTIENTRY_CONTEXT ctx = NULL;
+    PVMMOB_PHYS2VIRT_INDEX pObIndex = NULL;
     SIZE_T cPIDs = 0;
+    if((pObIndex = VmmPhys2VirtIndex_Get())) {
+        ctx = Phys2Virt_GetUpdateAll_FromIndex(pObIndex, ctxVmm->paPluginPhys2VirtRoot);
+        Ob_DECREF(pObIndex);
+        if(!ctx) { return FALSE; }
+        goto finish;
+    }
     VmmProcessListPIDs(NULL, &cPIDs, 0);
     ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(M_PHYS2VIRT_MULTIENTRY_CONTEXT) + cPIDs * 4 * sizeof(M_PHYS2VIRT_MULTIENTRY));
     if(!ctx) { return FALSE; }
@@ -64,6 +99,7 @@ BOOL Phys2Virt_GetUpdateAll(_Out_opt_ PM_PHYS2VIRT_MULTIENTRY_CONTEXT *ppMultiEn
     ctx->cMax = (DWORD)cPIDs * 4;
     VmmProcessActionForeachParallel(ctx, VmmProcessActionForeachParallel_CriteriaActiveOnly, Phys2Virt_GetUpdateAll_CallbackAction);
     ctx->c = min(ctx->c, ctx->cMax - 1);
+finish:
     if(pcMultiEntry) { *pcMultiEntry = ctx->c; }
     if(ppMultiEntry) {
         *ppMultiEntry = ctx;
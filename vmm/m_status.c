@@ -19,9 +19,114 @@
 #include "util.h"
 #include "vmm.h"
 #include "vmmproc.h"
+#include "vmmmembudget.h"
 #include "vmmwinreg.h"
 #include "statistics.h"
 
+/*
+* Render the per cache table and device read statistics ('statistics_cache').
+* -- sz = buffer of at least 0x1000 chars.
+* -- return = number of chars written (excluding terminating null).
+*/
+DWORD MStatus_CacheStatistics(_Out_writes_(0x1000) LPSTR sz)
+{
+    DWORD i, o = 0;
+    CHAR szLabel[0x20];
+    PVMM_CACHE_TABLE t[] = { &ctxVmm->Cache.PHYS, &ctxVmm->Cache.TLB, &ctxVmm->Cache.PAGING };
+    o += snprintf(sz + o, 0x1000 - o,
+        "CACHE STATISTICS  (4kB PAGES / COUNTS - HEXADECIMAL)               \n" \
+        "===================================================================\n" \
+        "                             PHYS              TLB           PAGING\n" \
+        "MAX ENTRIES:     %16llx %16llx %16llx\n" \
+        "IN USE:          %16llx %16llx %16llx\n" \
+        "HIT:             %16llx %16llx %16llx\n" \
+        "MISS:            %16llx %16llx %16llx\n" \
+        "EVICT:           %16llx %16llx %16llx\n" \
+        "RESERVE FAIL:    %16llx %16llx %16llx\n" \
+        "DEVICE READ (LcReadScatter):                                       \n" \
+        "  CALLS:         %16llx                                  \n" \
+        "  PAGES:         %16llx                                  \n" \
+        "  TIME (uS):     %16llx                                  \n" \
+        "  BULK SLICES:   %16llx                                  \n" \
+        "  BULK YIELDS:   %16llx                                  \n" \
+        "  COALESCED:     %16llx                                  \n" \
+        "  COALESCED DUP: %16llx                                  \n" \
+        "COMPRESSED TIER (PHYS):                                            \n" \
+        "  BUDGET (BYTES):%16llx                                  \n" \
+        "  USED (BYTES):  %16llx                                  \n" \
+        "  PAGES:         %16llx                                  \n" \
+        "  STORE:         %16llx                                  \n" \
+        "  REJECT:        %16llx                                  \n" \
+        "  HIT:           %16llx                                  \n" \
+        "  EVICT:         %16llx                                  \n" \
+        "PROTOTYPE PTE ARRAYS:                                              \n" \
+        "  BUDGET (BYTES):%16llx                                  \n" \
+        "  USED (BYTES):  %16llx                                  \n" \
+        "  ARRAYS:        %16llx                                  \n" \
+        "  HIT:           %16llx                                  \n" \
+        "  MISS:          %16llx                                  \n" \
+        "  EVICT:         %16llx                                  \n" \
+        "MODULE PARSE CACHE (EAT / SIZE / CODEVIEW):                        \n" \
+        "  ENTRIES:       %16llx %16llx %16llx\n" \
+        "  EXPORT INDEX:  %16llx                                  \n" \
+        "  HIT:           %16llx                                  \n" \
+        "  MISS:          %16llx                                  \n",
+        (QWORD)t[0]->cMaxEntries, (QWORD)t[1]->cMaxEntries, (QWORD)t[2]->cMaxEntries,
+        (QWORD)(t[0]->cTotal - t[0]->cEmpty), (QWORD)(t[1]->cTotal - t[1]->cEmpty), (QWORD)(t[2]->cTotal - t[2]->cEmpty),
+        t[0]->stat.cHit, t[1]->stat.cHit, t[2]->stat.cHit,
+        t[0]->stat.cMiss, t[1]->stat.cMiss, t[2]->stat.cMiss,
+        t[0]->stat.cEvict, t[1]->stat.cEvict, t[2]->stat.cEvict,
+        t[0]->stat.cReserveFail, t[1]->stat.cReserveFail, t[2]->stat.cReserveFail,
+        ctxVmm->stat.cDeviceRead, ctxVmm->stat.cDeviceReadPages, ctxVmm->stat.tmDeviceReadUs,
+        ctxVmm->stat.cDeviceReadBulkSlice, ctxVmm->stat.cDeviceReadBulkYield, ctxVmm->stat.cDeviceReadCoalesced, ctxVmm->stat.cDeviceReadCoalescedDup,
+        ctxVmm->CacheCompress.cbMax, ctxVmm->CacheCompress.cb, (QWORD)ObMap_Size(ctxVmm->CacheCompress.pm),
+        ctxVmm->stat.cCacheCompressStore, ctxVmm->stat.cCacheCompressReject, ctxVmm->stat.cCacheCompressHit, ctxVmm->stat.cCacheCompressEvict,
+        ctxVmm->CachePrototypePte.cbMax, ctxVmm->CachePrototypePte.cb, (QWORD)ObMap_Size(ctxVmm->Cache.pmPrototypePte),
+        ctxVmm->stat.cCachePrototypePteHit, ctxVmm->stat.cCachePrototypePteMiss, ctxVmm->stat.cCachePrototypePteEvict,
+        (QWORD)ObMap_Size(ctxVmm->ModuleCache.pm[0]), (QWORD)ObMap_Size(ctxVmm->ModuleCache.pm[1]), (QWORD)ObMap_Size(ctxVmm->ModuleCache.pm[2]),
+        (QWORD)ObMap_Size(ctxVmm->ModuleCache.pm[3]),
+        ctxVmm->stat.cModuleCacheHit, ctxVmm->stat.cModuleCacheMiss
+    );
+    for(i = 0; i < VMM_LATENCY_HISTOGRAM_BUCKETS; i++) {
+        if(i < VMM_LATENCY_HISTOGRAM_BUCKETS - 1) {
+            snprintf(szLabel, _countof(szLabel), "<  %5i uS:", 1 << i);
+        } else {
+            snprintf(szLabel, _countof(szLabel), ">= %5i uS:", 1 << (i - 1));
+        }
+        o += snprintf(sz + o, 0x1000 - o, "  %-14s %16llx                                  \n", szLabel, ctxVmm->stat.cDeviceReadLatency[i]);
+    }
+    return o;
+}
+
+/*
+* Render the per subsystem memory usage and memory budget ('statistics_memory').
+* -- sz = buffer of at least 0x1000 chars.
+* -- return = number of chars written (excluding terminating null).
+*/
+DWORD MStatus_MemoryStatistics(_Out_writes_(0x1000) LPSTR sz)
+{
+    DWORD i, o = 0;
+    CHAR szLabel[0x20];
+    VMMMEMBUDGET_USAGE Usage;
+    VmmMemBudget_Usage(&Usage);
+    o += snprintf(sz + o, 0x1000 - o,
+        "MEMORY USAGE  (BYTES / COUNTS - HEXADECIMAL)                       \n" \
+        "===================================================================\n" \
+        "BUDGET:          %16llx                                  \n" \
+        "TOTAL:           %16llx                                  \n" \
+        "BUDGETED TOTAL:  %16llx                                  \n" \
+        "EVICTIONS:       %16llx                                  \n" \
+        "SUBSYSTEM                BUDGETED          OBJECTS            BYTES\n",
+        Usage.cbMax, Usage.cbTotal, Usage.cbEnforced, Usage.cEvict
+    );
+    for(i = 0; i < VMMMEMBUDGET_SUBSYSTEM_MAX; i++) {
+        snprintf(szLabel, _countof(szLabel), "%s:", Usage.Subsystem[i].szName);
+        o += snprintf(sz + o, 0x1000 - o, "%-17s%16s %16llx %16llx\n",
+            szLabel, (Usage.Subsystem[i].fEnforced ? "yes" : "no"), Usage.Subsystem[i].c, Usage.Subsystem[i].cb);
+    }
+    return o;
+}
+
 /*
 * Read : function as specified by the module manager. The module manager will
 * call into this callback function whenever a read shall occur from a "file".
@@ -38,6 +143,7 @@ NTSTATUS MStatus_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWOR
     CHAR szBuffer[0x800];
     DWORD cbCallStatistics = 0;
     PBYTE pbCallStatistics = NULL;
+    LPSTR szCacheStatistics = NULL;
     QWORD cPageReadTotal, cPageFailTotal;
     NTSTATUS nt;
     if(!_wcsicmp(ctx->wszPath, L"config_process_show_terminated")) {
@@ -64,6 +170,9 @@ NTSTATUS MStatus_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWOR
     if(!_wcsicmp(ctx->wszPath, L"config_refresh_tlb")) {
         return Util_VfsReadFile_FromDWORD(ctxVmm->ThreadProcCache.cTick_TLB, pb, cb, pcbRead, cbOffset, FALSE);
     }
+    if(!_wcsicmp(ctx->wszPath, L"config_refresh_tlb_revalidate")) {
+        return Util_VfsReadFile_FromBOOL(ctxVmm->ThreadProcCache.fTlbRevalidate, pb, cb, pcbRead, cbOffset);
+    }
     if(!_wcsicmp(ctx->wszPath, L"config_refresh_proc_partial")) {
         return Util_VfsReadFile_FromDWORD(ctxVmm->ThreadProcCache.cTick_ProcPartial, pb, cb, pcbRead, cbOffset, FALSE);
     }
@@ -73,6 +182,15 @@ NTSTATUS MStatus_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWOR
     if(!_wcsicmp(ctx->wszPath, L"config_refresh_registry")) {
         return Util_VfsReadFile_FromDWORD(ctxVmm->ThreadProcCache.cTick_Registry, pb, cb, pcbRead, cbOffset, FALSE);
     }
+    if(!_wcsicmp(ctx->wszPath, L"config_refresh_warmup_maps")) {
+        return Util_VfsReadFile_FromDWORD(ctxVmm->ThreadProcCache.dwWarmupMaps, pb, cb, pcbRead, cbOffset, FALSE);
+    }
+    if(!_wcsicmp(ctx->wszPath, L"config_refresh_warmup_ms")) {
+        return Util_VfsReadFile_FromDWORD(ctxVmm->ThreadProcCache.cMs_WarmupBudget, pb, cb, pcbRead, cbOffset, FALSE);
+    }
+    if(!_wcsicmp(ctx->wszPath, L"config_refresh_warmup_pages")) {
+        return Util_VfsReadFile_FromDWORD(ctxVmm->ThreadProcCache.cPages_WarmupBudget, pb, cb, pcbRead, cbOffset, FALSE);
+    }
     if(!_wcsicmp(ctx->wszPath, L"statistics")) {
         cPageReadTotal = ctxVmm->stat.page.cPrototype + ctxVmm->stat.page.cTransition + ctxVmm->stat.page.cDemandZero + ctxVmm->stat.page.cVAD + ctxVmm->stat.page.cCacheHit + ctxVmm->stat.page.cPageFile + ctxVmm->stat.page.cCompressed;
         cPageFailTotal = ctxVmm->stat.page.cFailCacheHit + ctxVmm->stat.page.cFailVAD + ctxVmm->stat.page.cFailPageFile + ctxVmm->stat.page.cFailCompressed + ctxVmm->stat.page.cFail;
@@ -84,6 +202,10 @@ NTSTATUS MStatus_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWOR
             "  READ RETRIEVED:               %16llx\n" \
             "  READ FAIL:                    %16llx\n" \
             "  WRITE:                        %16llx\n" \
+            "  READ-AHEAD:                   %16llx\n" \
+            "    HIT:                        %16llx\n" \
+            "    MISS:                       %16llx\n" \
+            "  READ IN-FLIGHT WAIT:          %16llx\n" \
             "PAGED VIRTUAL MEMORY:                 \n" \
             "  READ SUCCESS:                 %16llx\n" \
             "    Prototype:                  %16llx\n" \
@@ -102,18 +224,42 @@ NTSTATUS MStatus_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWOR
             "  CACHE HIT:                    %16llx\n" \
             "  RETRIEVED:                    %16llx\n" \
             "  FAILED:                       %16llx\n" \
+            "  REVALIDATED:                  %16llx\n" \
+            "  INVALIDATED:                  %16llx\n" \
+            "  LARGE PAGE TRANSLATE:         %16llx\n" \
+            "  SOFTWARE TLB HIT:             %16llx\n" \
+            "CACHE LOCKS:                          \n" \
+            "  READ LOCK FALLBACK:           %16llx\n" \
+            "  LOCK CONTENTION:              %16llx\n" \
             "PHYSICAL MEMORY REFRESH:        %16llx\n" \
             "TLB MEMORY REFRESH:             %16llx\n" \
             "PROCESS PARTIAL REFRESH:        %16llx\n" \
-            "PROCESS FULL REFRESH:           %16llx\n",
+            "PROCESS FULL REFRESH:           %16llx\n" \
+            "PROCESS MAP WARMUP:             %16llx\n",
             ctxVmm->stat.cPhysCacheHit, ctxVmm->stat.cPhysReadSuccess, ctxVmm->stat.cPhysReadFail, ctxVmm->stat.cPhysWrite,
+            ctxVmm->stat.cPhysReadAhead, ctxVmm->stat.cPhysReadAheadHit, ctxVmm->stat.cPhysReadAheadMiss, ctxVmm->stat.cPhysReadInFlightWait,
             cPageReadTotal, ctxVmm->stat.page.cPrototype, ctxVmm->stat.page.cTransition, ctxVmm->stat.page.cDemandZero, ctxVmm->stat.page.cVAD, ctxVmm->stat.page.cCacheHit, ctxVmm->stat.page.cPageFile, ctxVmm->stat.page.cCompressed,
             cPageFailTotal, ctxVmm->stat.page.cFailCacheHit, ctxVmm->stat.page.cFailVAD, ctxVmm->stat.page.cFailPageFile, ctxVmm->stat.page.cFailCompressed,
-            ctxVmm->stat.cTlbCacheHit, ctxVmm->stat.cTlbReadSuccess, ctxVmm->stat.cTlbReadFail,
-            ctxVmm->stat.cPhysRefreshCache, ctxVmm->stat.cTlbRefreshCache, ctxVmm->stat.cProcessRefreshPartial, ctxVmm->stat.cProcessRefreshFull
+            ctxVmm->stat.cTlbCacheHit, ctxVmm->stat.cTlbReadSuccess, ctxVmm->stat.cTlbReadFail, ctxVmm->stat.cTlbRevalidate, ctxVmm->stat.cTlbRevalidateInvalid, ctxVmm->stat.cVirt2PhysLargePage, ctxVmm->stat.cVirt2PhysSoftTlbHit,
+            ctxVmm->stat.cCacheReadLockFallback, ctxVmm->stat.cCacheLockContention,
+            ctxVmm->stat.cPhysRefreshCache, ctxVmm->stat.cTlbRefreshCache, ctxVmm->stat.cProcessRefreshPartial, ctxVmm->stat.cProcessRefreshFull, ctxVmm->stat.cProcessWarmup
         );
         return Util_VfsReadFile_FromPBYTE(szBuffer, cchBuffer, pb, cb, pcbRead, cbOffset);
     }
+    if(!_wcsicmp(ctx->wszPath, L"statistics_cache")) {
+        if(!(szCacheStatistics = LocalAlloc(0, 0x1000))) { return VMMDLL_STATUS_FILE_INVALID; }
+        cchBuffer = MStatus_CacheStatistics(szCacheStatistics);
+        nt = Util_VfsReadFile_FromPBYTE((PBYTE)szCacheStatistics, cchBuffer, pb, cb, pcbRead, cbOffset);
+        LocalFree(szCacheStatistics);
+        return nt;
+    }
+    if(!_wcsicmp(ctx->wszPath, L"statistics_memory")) {
+        if(!(szCacheStatistics = LocalAlloc(0, 0x1000))) { return VMMDLL_STATUS_FILE_INVALID; }
+        cchBuffer = MStatus_MemoryStatistics(szCacheStatistics);
+        nt = Util_VfsReadFile_FromPBYTE((PBYTE)szCacheStatistics, cchBuffer, pb, cb, pcbRead, cbOffset);
+        LocalFree(szCacheStatistics);
+        return nt;
+    }
     if(!_wcsicmp(ctx->wszPath, L"statistics_fncall")) {
         Statistics_CallToString(NULL, 0, &cbCallStatistics);
         pbCallStatistics = LocalAlloc(0, cbCallStatistics);
@@ -123,6 +269,24 @@ NTSTATUS MStatus_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWOR
         LocalFree(pbCallStatistics);
         return nt;
     }
+    if(!_wcsicmp(ctx->wszPath, L"statistics_fncall.json")) {
+        Statistics_CallToJson(NULL, 0, &cbCallStatistics);
+        pbCallStatistics = LocalAlloc(0, cbCallStatistics);
+        if(!pbCallStatistics) { return VMMDLL_STATUS_FILE_INVALID; }
+        Statistics_CallToJson(pbCallStatistics, cbCallStatistics, &cbCallStatistics);
+        nt = Util_VfsReadFile_FromPBYTE(pbCallStatistics, cbCallStatistics, pb, cb, pcbRead, cbOffset);
+        LocalFree(pbCallStatistics);
+        return nt;
+    }
+    if(!_wcsicmp(ctx->wszPath, L"startup_timeline")) {
+        Statistics_StartupToString(NULL, 0, &cbCallStatistics);
+        pbCallStatistics = LocalAlloc(0, cbCallStatistics + 1);
+        if(!pbCallStatistics) { return VMMDLL_STATUS_FILE_INVALID; }
+        Statistics_StartupToString(pbCallStatistics, cbCallStatistics + 1, &cbCallStatistics);
+        nt = Util_VfsReadFile_FromPBYTE(pbCallStatistics, cbCallStatistics, pb, cb, pcbRead, cbOffset);
+        LocalFree(pbCallStatistics);
+        return nt;
+    }
     if(!_wcsicmp(ctx->wszPath, L"config_printf_enable")) {
         return Util_VfsReadFile_FromBOOL(ctxMain->cfg.fVerboseDll, pb, cb, pcbRead, cbOffset);
     }
@@ -217,6 +381,9 @@ NTSTATUS MStatus_Write(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _In_ PBYTE pb, _In_ DWOR
     if(!_wcsicmp(ctx->wszPath, L"config_refresh_tlb")) {
         return Util_VfsWriteFile_DWORD(&ctxVmm->ThreadProcCache.cTick_TLB, pb, cb, pcbWrite, cbOffset, 1, 0);
     }
+    if(!_wcsicmp(ctx->wszPath, L"config_refresh_tlb_revalidate")) {
+        return Util_VfsWriteFile_BOOL(&ctxVmm->ThreadProcCache.fTlbRevalidate, pb, cb, pcbWrite, cbOffset);
+    }
     if(!_wcsicmp(ctx->wszPath, L"config_refresh_proc_partial")) {
         return Util_VfsWriteFile_DWORD(&ctxVmm->ThreadProcCache.cTick_ProcPartial, pb, cb, pcbWrite, cbOffset, 1, 0);
     }
@@ -227,6 +394,15 @@ NTSTATUS MStatus_Write(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _In_ PBYTE pb, _In_ DWOR
         VmmWinReg_Refresh();
         return Util_VfsWriteFile_DWORD(&ctxVmm->ThreadProcCache.cTick_Registry, pb, cb, pcbWrite, cbOffset, 1, 0);
     }
+    if(!_wcsicmp(ctx->wszPath, L"config_refresh_warmup_maps")) {
+        return Util_VfsWriteFile_DWORD(&ctxVmm->ThreadProcCache.dwWarmupMaps, pb, cb, pcbWrite, cbOffset, 0, VMM_WARMUP_MAP_ALL);
+    }
+    if(!_wcsicmp(ctx->wszPath, L"config_refresh_warmup_ms")) {
+        return Util_VfsWriteFile_DWORD(&ctxVmm->ThreadProcCache.cMs_WarmupBudget, pb, cb, pcbWrite, cbOffset, 1, 0);
+    }
+    if(!_wcsicmp(ctx->wszPath, L"config_refresh_warmup_pages")) {
+        return Util_VfsWriteFile_DWORD(&ctxVmm->ThreadProcCache.cPages_WarmupBudget, pb, cb, pcbWrite, cbOffset, 1, 0);
+    }
     if(!_wcsicmp(ctx->wszPath, L"config_printf_enable")) {
         return MStatus_Write_NotifyVerbosityChange(
             Util_VfsWriteFile_BOOL(&ctxMain->cfg.fVerboseDll, pb, cb, pcbWrite, cbOffset));
@@ -273,7 +449,7 @@ NTSTATUS MStatus_Write(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _In_ PBYTE pb, _In_ DWOR
 */
 BOOL MStatus_List(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Inout_ PHANDLE pFileList)
 {
-    DWORD cbCallStatistics = 0;
+    DWORD cbCallStatistics = 0, cbStartup = 0;
     // not module root directory -> fail!
     if(ctx->wszPath[0]) { return FALSE; }
     // "root" view
@@ -285,14 +461,18 @@ BOOL MStatus_List(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Inout_ PHANDLE pFileList)
         VMMDLL_VfsList_AddFile(pFileList, L"config_refresh_tick_period_ms", 8, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_refresh_read", 8, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_refresh_tlb", 8, NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"config_refresh_tlb_revalidate", 1, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_refresh_proc_partial", 8, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_refresh_proc_total", 8, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_refresh_registry", 8, NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"config_refresh_warmup_maps", 8, NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"config_refresh_warmup_ms", 8, NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"config_refresh_warmup_pages", 8, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_symbol_enable", 1, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_symbolcache", strlen(ctxMain->pdb.szLocal), NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_symbolserver", strlen(ctxMain->pdb.szServer), NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_symbolserver_enable", 1, NULL);
-        VMMDLL_VfsList_AddFile(pFileList, L"statistics", 1103, NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"statistics", 1974, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_printf_enable", 1, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_printf_v", 1, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_printf_vv", 1, NULL);
@@ -301,6 +481,12 @@ BOOL MStatus_List(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Inout_ PHANDLE pFileList)
         VMMDLL_VfsList_AddFile(pFileList, L"native_max_address", 16, NULL);
         Statistics_CallToString(NULL, 0, &cbCallStatistics);
         VMMDLL_VfsList_AddFile(pFileList, L"statistics_fncall", cbCallStatistics, NULL);
+        Statistics_CallToJson(NULL, 0, &cbCallStatistics);
+        VMMDLL_VfsList_AddFile(pFileList, L"statistics_fncall.json", cbCallStatistics, NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"statistics_cache", 68 * (37 + VMM_LATENCY_HISTOGRAM_BUCKETS), NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"statistics_memory", 68 * (7 + VMMMEMBUDGET_SUBSYSTEM_MAX), NULL);
+        Statistics_StartupToString(NULL, 0, &cbStartup);
+        VMMDLL_VfsList_AddFile(pFileList, L"startup_timeline", cbStartup, NULL);
     }
     return TRUE;
 }
@@ -63,13 +63,29 @@ VOID MSysInfoCert_CallbackCleanup(PMSYSINFOCERT_OB_ENTRY pOb)
     LocalFree(pOb->wszSubjectCN);
 }
 
-VOID MSysInfoCert_GetContext_UserAddSingleCert(_In_ POB_REGISTRY_HIVE pHive, _In_ POB_REGISTRY_KEY pkStore, _In_ POB_REGISTRY_KEY pkCert, _In_opt_ PVMM_MAP_USERENTRY pUser, _Inout_ POB_MAP pmCtx)
+/*
+* Certificate to decode - the registry blob is read when the certificate
+* stores are walked, the (CPU bound) decode takes place afterwards.
+*/
+typedef struct tdMSYSINFOCERT_DECODE_ENTRY {
+    QWORD vaHive;
+    DWORD oRegCellValue;
+    DWORD dwHashUserSID;
+    DWORD cb;
+    PMSYSINFOCERT_OB_ENTRY pObResult;
+    WCHAR wszIdHash[41];
+    WCHAR wszStore[MAX_PATH];
+    BYTE pb[];
+} MSYSINFOCERT_DECODE_ENTRY, *PMSYSINFOCERT_DECODE_ENTRY;
+
+#define MSYSINFOCERT_DECODE_PARALLEL_MIN        8
+
+VOID MSysInfoCert_GetContext_UserAddSingleCert(_In_ POB_REGISTRY_HIVE pHive, _In_ POB_REGISTRY_KEY pkStore, _In_ POB_REGISTRY_KEY pkCert, _In_opt_ PVMM_MAP_USERENTRY pUser, _Inout_ POB_MAP pmDecode)
 {
-    DWORD o, cb, cch;
+    DWORD cb;
     BYTE pb[0x1800];
-    PCCERT_CONTEXT pCertContext = NULL;
     POB_REGISTRY_VALUE pObValue = NULL;
-    PMSYSINFOCERT_OB_ENTRY pObResult = NULL;
+    PMSYSINFOCERT_DECODE_ENTRY pe = NULL;
     VMM_REGISTRY_VALUE_INFO ValueInfo = { 0 };
     VMM_REGISTRY_KEY_INFO KeyCertInfo = { 0 };
     VMM_REGISTRY_KEY_INFO KeyStoreInfo = { 0 };
@@ -85,6 +101,35 @@ VOID MSysInfoCert_GetContext_UserAddSingleCert(_In_ POB_REGISTRY_HIVE pHive, _In
     if(wcslen(KeyCertInfo.wszName) != 40) {
         goto fail;
     }
+    if(!(pe = LocalAlloc(LMEM_ZEROINIT, sizeof(MSYSINFOCERT_DECODE_ENTRY) + cb + 10))) {
+        goto fail;
+    }
+    pe->vaHive = pHive->vaCMHIVE;
+    pe->oRegCellValue = ValueInfo.raValueCell;
+    pe->dwHashUserSID = pUser ? pUser->dwHashSID : 0;
+    pe->cb = cb;
+    memcpy(pe->pb, pb, cb);
+    wcsncpy_s(pe->wszIdHash, _countof(pe->wszIdHash), KeyCertInfo.wszName, _TRUNCATE);
+    wcsncpy_s(pe->wszStore, _countof(pe->wszStore), KeyStoreInfo.wszName, _TRUNCATE);
+    if(ObMap_Push(pmDecode, ObMap_Size(pmDecode) + 1ULL, pe)) {
+        pe = NULL;      // map will free allocation when cleared
+    }
+fail:
+    LocalFree(pe);
+    Ob_DECREF(pObValue);
+}
+
+/*
+* Decode a single certificate registry blob into a certificate entry.
+* May be called in parallel from multiple threads.
+* -- pe
+*/
+VOID MSysInfoCert_GetContext_Decode(_Inout_ PMSYSINFOCERT_DECODE_ENTRY pe)
+{
+    DWORD o, cb = pe->cb, cch;
+    PBYTE pb = pe->pb;
+    PCCERT_CONTEXT pCertContext = NULL;
+    PMSYSINFOCERT_OB_ENTRY pObResult = NULL;
     // locate certificate part in registry blob
     // https://blog.nviso.eu/2019/08/28/extracting-certificates-from-the-windows-registry/
     for(o = 0; o < cb - 0x20; o++) {
@@ -113,24 +158,53 @@ VOID MSysInfoCert_GetContext_UserAddSingleCert(_In_ POB_REGISTRY_HIVE pHive, _In
     CertGetNameStringW(pCertContext, CERT_NAME_SIMPLE_DISPLAY_TYPE, CERT_NAME_ISSUER_FLAG, NULL, pObResult->wszIssuerCN, cch);
     if(cch > 64) { pObResult->wszIssuerCN[64] = 0; }    // max 64 characters length
     // hash and store
-    if(!(pObResult->wszIdHash = Util_StrDupW(KeyCertInfo.wszName))) { goto fail; }
-    if(!(pObResult->wszStore = Util_StrDupW(KeyStoreInfo.wszName))) { goto fail; }
+    if(!(pObResult->wszIdHash = Util_StrDupW(pe->wszIdHash))) { goto fail; }
+    if(!(pObResult->wszStore = Util_StrDupW(pe->wszStore))) { goto fail; }
     if(wcslen(pObResult->wszStore) > 32) { pObResult->wszStore[32] = 0; }
     // other values and finish
     pObResult->qwIdMapKey = wcstoull(pObResult->wszIdHash + 24, NULL, 16);
-    pObResult->vaHive = pHive->vaCMHIVE;
+    pObResult->vaHive = pe->vaHive;
     pObResult->oRegBlob = o;
-    pObResult->oRegCellValue = ValueInfo.raValueCell;
+    pObResult->oRegCellValue = pe->oRegCellValue;
     pObResult->cbCert = cb;
-    pObResult->dwHashUserSID = pUser ? pUser->dwHashSID : 0;
-    ObMap_Push(pmCtx, pObResult->qwIdMapKey, pObResult);
+    pObResult->dwHashUserSID = pe->dwHashUserSID;
+    pe->pObResult = pObResult;
+    pObResult = NULL;
 fail:
     if(pCertContext) { CertFreeCertificateContext(pCertContext); }
     Ob_DECREF(pObResult);
-    Ob_DECREF(pObValue);
 }
 
-VOID MSysInfoCert_GetContext_UserAddCerts(_In_ POB_REGISTRY_HIVE pHive, _In_ POB_REGISTRY_KEY pKeySystemCertificates, _In_opt_ PVMM_MAP_USERENTRY pUserEntry, _Inout_ POB_MAP pmCtx)
+VOID MSysInfoCert_GetContext_DecodeItem(_In_ POB_MAP pmDecode, _In_ DWORD i)
+{
+    MSysInfoCert_GetContext_Decode(ObMap_GetByIndex(pmDecode, i));
+}
+
+/*
+* Decode all certificate blobs collected from the certificate stores and add
+* the successfully decoded certificates to the context map. Larger number of
+* certificates are decoded in parallel on the work thread pool. The calling
+* thread takes part itself and only waits for entries in progress elsewhere.
+* -- pmDecode
+* -- pmCtx
+*/
+VOID MSysInfoCert_GetContext_DecodeAll(_In_ POB_MAP pmDecode, _Inout_ POB_MAP pmCtx)
+{
+    DWORD i, c;
+    PMSYSINFOCERT_DECODE_ENTRY pe;
+    if(!(c = ObMap_Size(pmDecode))) { return; }
+    VmmWorkParallel(c, (c >= MSYSINFOCERT_DECODE_PARALLEL_MIN) ? ctxVmm->Work.cThread : 0, (VOID(*)(PVOID, DWORD))MSysInfoCert_GetContext_DecodeItem, pmDecode);
+    // commit results in certificate store order.
+    for(i = 0; i < c; i++) {
+        pe = ObMap_GetByIndex(pmDecode, i);
+        if(pe->pObResult) {
+            ObMap_Push(pmCtx, pe->pObResult->qwIdMapKey, pe->pObResult);
+            Ob_DECREF_NULL(&pe->pObResult);
+        }
+    }
+}
+
+VOID MSysInfoCert_GetContext_UserAddCerts(_In_ POB_REGISTRY_HIVE pHive, _In_ POB_REGISTRY_KEY pKeySystemCertificates, _In_opt_ PVMM_MAP_USERENTRY pUserEntry, _Inout_ POB_MAP pmDecode)
 {
     POB_REGISTRY_KEY pkObCertStore = NULL, pkObCertStoreCerts = NULL, pkObCert = NULL;
     POB_MAP pmkObCertStores = NULL, pmObCerts = NULL;
@@ -140,7 +214,7 @@ VOID MSysInfoCert_GetContext_UserAddCerts(_In_ POB_REGISTRY_HIVE pHive, _In_ POB
         if(!pkObCertStoreCerts) { continue; }
         if((pmObCerts = VmmWinReg_KeyList(pHive, pkObCertStoreCerts))) {
             while((pkObCert = ObMap_GetNext(pmObCerts, pkObCert))) {
-                MSysInfoCert_GetContext_UserAddSingleCert(pHive, pkObCertStore, pkObCert, pUserEntry, pmCtx);
+                MSysInfoCert_GetContext_UserAddSingleCert(pHive, pkObCertStore, pkObCert, pUserEntry, pmDecode);
             }
             Ob_DECREF_NULL(&pmObCerts);
         }
@@ -151,6 +225,7 @@ VOID MSysInfoCert_GetContext_UserAddCerts(_In_ POB_REGISTRY_HIVE pHive, _In_ POB
 
 /*
 * Retrieve the context map containing information about the certificates.
+* The context is cached until the next registry refresh.
 * CALLER DECREF: return
 * -- return
 */
@@ -158,19 +233,20 @@ POB_MAP MSysInfoCert_GetContext()
 {
     LPWSTR wszCertStoresUSER[] = { L"ROOT\\Software\\Microsoft\\SystemCertificates", L"ROOT\\Software\\Policies\\Microsoft\\SystemCertificates" };
     LPWSTR wszCertStoresSYSTEM[] = { L"HKLM\\SOFTWARE\\Microsoft\\SystemCertificates", L"HKLM\\SOFTWARE\\Policies\\Microsoft\\SystemCertificates" };
-    DWORD i;
-    POB_MAP pObCtx = NULL;
+    DWORD i, j;
+    POB_MAP pObCtx = NULL, pmObDecode = NULL;
     PVMMOB_MAP_USER pObUserMap = NULL;
     POB_REGISTRY_KEY pObKey = NULL;
     POB_REGISTRY_HIVE pObHive = NULL;
     if((pObCtx = ObContainer_GetOb(gp_MSYSINFO_OB_CERTCONTEXT))) { return pObCtx; }
     EnterCriticalSection(&ctxVmm->LockUpdateModule);
     if((pObCtx = ObContainer_GetOb(gp_MSYSINFO_OB_CERTCONTEXT))) { goto finish; }
+    if(!(pmObDecode = ObMap_New(OB_MAP_FLAGS_OBJECT_LOCALFREE))) { goto finish; }
     if(!(pObCtx = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) { goto finish; }
     // Retrieve system (local machine) certificates:
     for(i = 0; i < sizeof(wszCertStoresSYSTEM) / sizeof(LPWSTR); i++) {
         if(VmmWinReg_KeyHiveGetByFullPath(wszCertStoresSYSTEM[i], &pObHive, &pObKey)) {
-            MSysInfoCert_GetContext_UserAddCerts(pObHive, pObKey, NULL, pObCtx);
+            MSysInfoCert_GetContext_UserAddCerts(pObHive, pObKey, NULL, pmObDecode);
             Ob_DECREF_NULL(&pObKey);
             Ob_DECREF_NULL(&pObHive);
         }
@@ -179,9 +255,9 @@ POB_MAP MSysInfoCert_GetContext()
     if(VmmMap_GetUser(&pObUserMap)) {
         for(i = 0; i < pObUserMap->cMap; i++) {
             if((pObHive = VmmWinReg_HiveGetByAddress(pObUserMap->pMap[i].vaRegHive))) {
-                for(i = 0; i < sizeof(wszCertStoresUSER) / sizeof(LPWSTR); i++) {
-                    if((pObKey = VmmWinReg_KeyGetByPath(pObHive, wszCertStoresUSER[i]))) {
-                        MSysInfoCert_GetContext_UserAddCerts(pObHive, pObKey, pObUserMap->pMap + i, pObCtx);
+                for(j = 0; j < sizeof(wszCertStoresUSER) / sizeof(LPWSTR); j++) {
+                    if((pObKey = VmmWinReg_KeyGetByPath(pObHive, wszCertStoresUSER[j]))) {
+                        MSysInfoCert_GetContext_UserAddCerts(pObHive, pObKey, pObUserMap->pMap + i, pmObDecode);
                         Ob_DECREF_NULL(&pObKey);
                     }
                 }
@@ -190,9 +266,12 @@ POB_MAP MSysInfoCert_GetContext()
         }
         Ob_DECREF_NULL(&pObUserMap);
     }
+    // Decode the certificate blobs:
+    MSysInfoCert_GetContext_DecodeAll(pmObDecode, pObCtx);
     ObContainer_SetOb(gp_MSYSINFO_OB_CERTCONTEXT, pObCtx);
 finish:
     LeaveCriticalSection(&ctxVmm->LockUpdateModule);
+    Ob_DECREF(pmObDecode);
     return pObCtx;
 }
 
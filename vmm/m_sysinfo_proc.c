@@ -14,8 +14,9 @@
 
 // ----------------------------------------------------------------------------
 // ProcTree functionality below:
-// NB! The proctree text files are re-generated for each read. This is not
-// efficient, but the file is not read often so it should be OK.
+// NB! The proctree text files are rendered from the shared process tree map
+// (parent/child index) and cached until the process tree map is replaced at
+// the next process refresh.
 // ----------------------------------------------------------------------------
 
 #define MSYSINFOPROC_TREE_LINE_LENGTH_BASE              62
@@ -32,24 +33,14 @@ const LPSTR szMSYSINFOPROC_WHITELIST_WINDOWS_PATHS_AND_BINARIES[] = {
     "\\WINDOWS\\system32\\"
 };
 
-typedef struct tdMSYSINFOPROC_TREE_ENTRY {
-    DWORD dwPPID;
-    DWORD dwPID;
-    BYTE iLevel;
-    BOOL fProcessed;
-    PVMM_PROCESS pObProcess;
-} MSYSINFOPROC_TREE_ENTRY, *PMSYSINFOPROC_TREE_ENTRY;
+typedef struct tdOB_MSYSINFOPROC_TREE {
+    OB ObHdr;
+    PVMMOB_MAP_PROCTREE pObProcTree;    // process tree map the text is rendered from
+    DWORD cb;
+    BYTE pb[];
+} OB_MSYSINFOPROC_TREE, *POB_MSYSINFOPROC_TREE;
 
-BOOL MSysInfoProc_Tree_ExistsUnprocessed(PMSYSINFOPROC_TREE_ENTRY pPidList, DWORD cPidList, DWORD dwPID)
-{
-    DWORD i;
-    for(i = 0; i < cPidList; i++) {
-        if(pPidList[i].dwPID == dwPID) {
-            return !pPidList[i].fProcessed;
-        }
-    }
-    return FALSE;
-}
+POB_CONTAINER gp_MSYSINFOPROC_OB_TREE[2] = { 0 };  // [0] = tree.txt, [1] = tree-v.txt
 
 VOID MSysInfoProc_Tree_ProcessItems_GetUserName(_In_ PVMM_PROCESS pProcess, _Out_writes_(17) LPSTR szUserName, _Out_ PBOOL fAccountUser)
 {
@@ -63,7 +54,7 @@ VOID MSysInfoProc_Tree_ProcessItems_GetUserName(_In_ PVMM_PROCESS pProcess, _Out
     *fAccountUser = f && !fWellKnownAccount;
 }
 
-DWORD MSysInfoProc_Tree_ProcessItems(_In_ PMSYSINFOPROC_TREE_ENTRY pProcessEntry, _In_ PMSYSINFOPROC_TREE_ENTRY pList, _In_ DWORD cList, _In_ PBYTE pb, _In_ DWORD cb, _In_ BYTE iLevel, _In_ BOOL fVerbose)
+DWORD MSysInfoProc_Tree_ProcessItem(_In_ PVMM_PROCESS pProcess, _In_ PVMM_MAP_PROCTREEENTRY pe, _In_ PBYTE pb, _In_ DWORD cb, _In_ BOOL fVerbose)
 {
     LPCSTR szINDENT[] = { "-", "--", "---", "----", "-----", "------", "-------", "--------", "--------+" };
     CHAR szUserName[17];
@@ -73,113 +64,113 @@ DWORD MSysInfoProc_Tree_ProcessItems(_In_ PMSYSINFOPROC_TREE_ENTRY pProcessEntry
         vmmprintf_fn("WARNING: BUFFER MAY BE TOO SMALL - SHOULD NOT HAPPEN! %i\n", cb);
         return 0;
     }
-    fStateTerminated = (pProcessEntry->pObProcess->dwState != 0);
-    fWinNativeProc = (pProcessEntry->dwPID == 4) || (pProcessEntry->dwPPID == 4);
+    if(fVerbose) {
+        VmmWin_UserProcessParameters_Get(pProcess);
+    }
+    fStateTerminated = (pProcess->dwState != 0);
+    fWinNativeProc = (pe->dwPID == 4) || (pe->dwPPID == 4);
     for(i = 0; !fWinNativeProc && (i < (sizeof(szMSYSINFOPROC_WHITELIST_WINDOWS_PATHS_AND_BINARIES) / sizeof(LPSTR))); i++) {
-        fWinNativeProc = (NULL != strstr(pProcessEntry->pObProcess->pObPersistent->uszPathKernel, szMSYSINFOPROC_WHITELIST_WINDOWS_PATHS_AND_BINARIES[i]));
+        fWinNativeProc = (NULL != strstr(pProcess->pObPersistent->uszPathKernel, szMSYSINFOPROC_WHITELIST_WINDOWS_PATHS_AND_BINARIES[i]));
     }
-    MSysInfoProc_Tree_ProcessItems_GetUserName(pProcessEntry->pObProcess, szUserName, &fAccountUser);
+    MSysInfoProc_Tree_ProcessItems_GetUserName(pProcess, szUserName, &fAccountUser);
     o = snprintf(
         pb,
         cb,
         "%s %-15s%*s%6i %6i  %c%c%c %-16s %s\n",
-        szINDENT[min(8, iLevel)],
-        pProcessEntry->pObProcess->szName,
-        8 - min(7, iLevel),
+        szINDENT[min(8, pe->iLevel)],
+        pProcess->szName,
+        8 - min(7, pe->iLevel),
         "",
-        pProcessEntry->dwPID,
-        pProcessEntry->dwPPID,
+        pe->dwPID,
+        pe->dwPPID,
         fStateTerminated ? 'T' : ' ',
         fAccountUser ? 'U' : ' ',
         fWinNativeProc ? ' ' : '*',
         szUserName,
-        fVerbose ? pProcessEntry->pObProcess->pObPersistent->uszPathKernel : ""
+        fVerbose ? pProcess->pObPersistent->uszPathKernel : ""
     );
     if(fVerbose) {
-        if(pProcessEntry->pObProcess->pObPersistent->UserProcessParams.uszImagePathName) {
+        if(pProcess->pObPersistent->UserProcessParams.uszImagePathName) {
             o += snprintf(pb + o, cb - o, "%61s%-*s\n", "",
-                pProcessEntry->pObProcess->pObPersistent->UserProcessParams.cuszImagePathName,
-                pProcessEntry->pObProcess->pObPersistent->UserProcessParams.uszImagePathName);
+                pProcess->pObPersistent->UserProcessParams.cuszImagePathName,
+                pProcess->pObPersistent->UserProcessParams.uszImagePathName);
         }
-        if(pProcessEntry->pObProcess->pObPersistent->UserProcessParams.uszCommandLine) {
+        if(pProcess->pObPersistent->UserProcessParams.uszCommandLine) {
             o += snprintf(pb + o, cb - o, "%61s%-*s\n", "",
-                pProcessEntry->pObProcess->pObPersistent->UserProcessParams.cuszCommandLine,
-                pProcessEntry->pObProcess->pObPersistent->UserProcessParams.uszCommandLine);
+                pProcess->pObPersistent->UserProcessParams.cuszCommandLine,
+                pProcess->pObPersistent->UserProcessParams.uszCommandLine);
         }
         o += snprintf(pb + o, cb - o, "\n");
     }
-    pProcessEntry->iLevel = iLevel;
-    pProcessEntry->fProcessed = TRUE;
-    // 2: fetch and process sub-items (child processes)
-    for(i = 0; i < cList; i++) {
-        if(pList[i].fProcessed) { continue; }
-        if(pList[i].dwPPID == pProcessEntry->dwPID) {
-            o += MSysInfoProc_Tree_ProcessItems(pList + i, pList, cList, pb + o, cb - o, iLevel + 1, fVerbose);
-        }
-    }
     return o;
 }
 
-int MSysInfoProc_Tree_CmpSort(PMSYSINFOPROC_TREE_ENTRY a, PMSYSINFOPROC_TREE_ENTRY b)
+VOID MSysInfoProc_Tree_CloseObCallback(_In_ POB_MSYSINFOPROC_TREE pOb)
 {
-    if(a->dwPPID - b->dwPPID) {
-        return a->dwPID - b->dwPID;
-    }
-    return a->dwPPID - b->dwPPID;
+    Ob_DECREF(pOb->pObProcTree);
 }
 
-_Success_(return)
-BOOL MSysInfoProc_Tree(_In_ BOOL fVerbose, _Out_ PBYTE * ppb, _Out_ PDWORD pcb)
+/*
+* Render the process tree text from the process tree map. Processes are
+* rendered in the pre-computed depth-first order of the process tree map.
+* CALLER DECREF: return
+* -- pProcTree
+* -- fVerbose
+* -- return
+*/
+POB_MSYSINFOPROC_TREE MSysInfoProc_Tree_Render(_In_ PVMMOB_MAP_PROCTREE pProcTree, _In_ BOOL fVerbose)
 {
-    BOOL fResult = FALSE;
-    PVMM_PROCESS pObProcess = NULL;
-    PMSYSINFOPROC_TREE_ENTRY pPidEntry, pPidList = NULL;
-    DWORD iPidList = 0, i;
-    SIZE_T cPidList = 0;
+    DWORD i, cb = 0x00100000, o = 0;    // 1MB should be enough to hold any process list ...
     PBYTE pb;
-    DWORD cb = 0x00100000, o = 0;   // 1MB should be enough to hold any process list ...
-    // 1: retrieve process information into "pid list"
-    VmmProcessListPIDs(NULL, &cPidList, VMM_FLAG_PROCESS_SHOW_TERMINATED);
-    if(!cPidList) { return FALSE; }
-    if(!(pPidList = LocalAlloc(LMEM_ZEROINIT, cPidList * sizeof(MSYSINFOPROC_TREE_ENTRY)))) { return FALSE; }
-    while((iPidList < cPidList) && (pObProcess = VmmProcessGetNext(pObProcess, VMM_FLAG_PROCESS_SHOW_TERMINATED | VMM_FLAG_PROCESS_TOKEN))) {
-        pPidEntry = pPidList + iPidList++;
-        pPidEntry->dwPID = pObProcess->dwPID;
-        pPidEntry->dwPPID = pObProcess->dwPPID;
-        pPidEntry->pObProcess = (PVMM_PROCESS)Ob_INCREF(pObProcess);    // INCREF process object and assign to array
-    }
-    Ob_DECREF_NULL(&pObProcess);
-    pb = LocalAlloc(0, cb);
-    if(pb) {
-        // 3: iterate over top level items - processes with no parent
-        qsort(pPidList, cPidList, sizeof(MSYSINFOPROC_TREE_ENTRY), (int(*)(const void *, const void *))MSysInfoProc_Tree_CmpSort);
-        o = snprintf(pb, cb, fVerbose ?
-            "  Process                   Pid Parent Flag User             Path / Command Line\n--------------------------------------------------------------------------------\n" :
-            "  Process                   Pid Parent Flag User             \n-------------------------------------------------------------\n");
-        // 3.1 process items
-        for(i = 0; i < cPidList; i++) {
-            pPidEntry = pPidList + i;
-            if(pPidEntry->fProcessed) { continue; }
-            if(MSysInfoProc_Tree_ExistsUnprocessed(pPidList, (DWORD)cPidList, pPidEntry->dwPPID)) { continue; }
-            o += MSysInfoProc_Tree_ProcessItems(pPidEntry, pPidList, (DWORD)cPidList, pb + o, cb - o, 0, fVerbose);
-        }
-        // 3.2 process remaining items (in case of PPID-loop which ideally should not happen)
-        //     the remaining items are processed without regards for order.
-        for(i = 0; i < cPidList; i++) {
-            pPidEntry = pPidList + i;
-            if(pPidEntry->fProcessed) { continue; }
-            o += MSysInfoProc_Tree_ProcessItems(pPidEntry, pPidList, (DWORD)cPidList, pb + o, cb - o, 0, fVerbose);
+    PVMM_PROCESS pObProcess;
+    PVMM_MAP_PROCTREEENTRY pe;
+    POB_MSYSINFOPROC_TREE pObTree = NULL;
+    if(!(pb = LocalAlloc(0, cb))) { return NULL; }
+    o = snprintf(pb, cb, fVerbose ?
+        "  Process                   Pid Parent Flag User             Path / Command Line\n--------------------------------------------------------------------------------\n" :
+        "  Process                   Pid Parent Flag User             \n-------------------------------------------------------------\n");
+    for(i = 0; i < pProcTree->cMap; i++) {
+        pe = pProcTree->pMap + pProcTree->piTree[i];
+        if((pObProcess = VmmProcessGetEx(NULL, pe->dwPID, VMM_FLAG_PROCESS_TOKEN))) {
+            o += MSysInfoProc_Tree_ProcessItem(pObProcess, pe, pb + o, cb - o, fVerbose);
+            Ob_DECREF_NULL(&pObProcess);
         }
-        // 4: finish!
-        *ppb = pb;
-        *pcb = o;
-        fResult = TRUE;
     }
-    for(i = 0; i < cPidList; i++) {
-        Ob_DECREF(pPidList[i].pObProcess);  // DECREF array assigned process object.
+    if((pObTree = Ob_Alloc(OB_TAG_MOD_SYSINFOPROC_TREE, 0, sizeof(OB_MSYSINFOPROC_TREE) + o, (VOID(*)(PVOID))MSysInfoProc_Tree_CloseObCallback, NULL))) {
+        pObTree->pObProcTree = Ob_INCREF(pProcTree);
+        pObTree->cb = o;
+        memcpy(pObTree->pb, pb, o);
+    }
+    LocalFree(pb);
+    return pObTree;
+}
+
+/*
+* Retrieve the process tree text. The text is re-rendered only if the process
+* tree map has changed since the text was last rendered.
+* CALLER DECREF: return
+* -- fVerbose
+* -- return
+*/
+POB_MSYSINFOPROC_TREE MSysInfoProc_Tree(_In_ BOOL fVerbose)
+{
+    POB_CONTAINER pObC = gp_MSYSINFOPROC_OB_TREE[fVerbose ? 1 : 0];
+    PVMMOB_MAP_PROCTREE pObProcTree = NULL;
+    POB_MSYSINFOPROC_TREE pObTree = NULL;
+    if(!VmmMap_GetProcTree(&pObProcTree)) { return NULL; }
+    if((pObTree = ObContainer_GetOb(pObC)) && (pObTree->pObProcTree == pObProcTree)) { goto finish; }
+    Ob_DECREF_NULL(&pObTree);
+    EnterCriticalSection(&ctxVmm->LockUpdateModule);
+    if((pObTree = ObContainer_GetOb(pObC)) && (pObTree->pObProcTree != pObProcTree)) {
+        Ob_DECREF_NULL(&pObTree);
+    }
+    if(!pObTree && (pObTree = MSysInfoProc_Tree_Render(pObProcTree, fVerbose))) {
+        ObContainer_SetOb(pObC, pObTree);
     }
-    LocalFree(pPidList);
-    return fResult;
+    LeaveCriticalSection(&ctxVmm->LockUpdateModule);
+finish:
+    Ob_DECREF(pObProcTree);
+    return pObTree;
 }
 
 VOID MSysInfoProc_ListTree_ProcessUserParams_CallbackAction(_In_ PVMM_PROCESS pProcess, _In_ PDWORD pcTotalBytes)
@@ -198,18 +189,12 @@ VOID MSysInfoProc_ListTree_ProcessUserParams_CallbackAction(_In_ PVMM_PROCESS pP
 NTSTATUS MSysInfoProc_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
 {
     NTSTATUS nt;
-    DWORD cbFile = 0;
-    PBYTE pbFile = NULL;
-    if(!wcscmp(ctx->wszPath, L"tree.txt")) {
-        MSysInfoProc_Tree(FALSE, &pbFile, &cbFile);
-        nt = Util_VfsReadFile_FromPBYTE(pbFile, cbFile, pb, cb, pcbRead, cbOffset);
-        LocalFree(pbFile);
-        return nt;
-    }
-    if(!wcscmp(ctx->wszPath, L"tree-v.txt")) {
-        MSysInfoProc_Tree(TRUE, &pbFile, &cbFile);
-        nt = Util_VfsReadFile_FromPBYTE(pbFile, cbFile, pb, cb, pcbRead, cbOffset);
-        LocalFree(pbFile);
+    BOOL fVerbose;
+    POB_MSYSINFOPROC_TREE pObTree;
+    if((fVerbose = !wcscmp(ctx->wszPath, L"tree-v.txt")) || !wcscmp(ctx->wszPath, L"tree.txt")) {
+        pObTree = MSysInfoProc_Tree(fVerbose);
+        nt = Util_VfsReadFile_FromPBYTE(pObTree ? pObTree->pb : NULL, pObTree ? pObTree->cb : 0, pb, cb, pcbRead, cbOffset);
+        Ob_DECREF(pObTree);
         return nt;
     }
     return VMMDLL_STATUS_FILE_INVALID;
@@ -231,13 +216,22 @@ BOOL MSysInfoProc_List(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Inout_ PHANDLE pFileLis
     return TRUE;
 }
 
+VOID MSysInfoProc_Close()
+{
+    Ob_DECREF_NULL(&gp_MSYSINFOPROC_OB_TREE[0]);
+    Ob_DECREF_NULL(&gp_MSYSINFOPROC_OB_TREE[1]);
+}
+
 VOID M_SysInfoProc_Initialize(_Inout_ PVMMDLL_PLUGIN_REGINFO pRI)
 {
     if((pRI->magic != VMMDLL_PLUGIN_REGINFO_MAGIC) || (pRI->wVersion != VMMDLL_PLUGIN_REGINFO_VERSION)) { return; }
     if((pRI->tpSystem != VMM_SYSTEM_WINDOWS_X64) && (pRI->tpSystem != VMM_SYSTEM_WINDOWS_X86)) { return; }
+    if(!(gp_MSYSINFOPROC_OB_TREE[0] = ObContainer_New(NULL))) { return; }
+    if(!(gp_MSYSINFOPROC_OB_TREE[1] = ObContainer_New(NULL))) { Ob_DECREF_NULL(&gp_MSYSINFOPROC_OB_TREE[0]); return; }
     wcscpy_s(pRI->reg_info.wszPathName, 128, L"\\sysinfo\\proc");   // module name
     pRI->reg_info.fRootModule = TRUE;                               // module shows in root directory
     pRI->reg_fn.pfnList = MSysInfoProc_List;                        // List function supported
     pRI->reg_fn.pfnRead = MSysInfoProc_Read;                        // Read function supported
+    pRI->reg_fn.pfnClose = MSysInfoProc_Close;                      // Close function supported
     pRI->pfnPluginManager_Register(pRI);
 }
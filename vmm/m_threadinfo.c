@@ -66,48 +66,42 @@ NTSTATUS ThreadInfo_Read_ThreadInfo(_In_ PVMM_MAP_THREADENTRY pThreadEntry, _Out
     return Util_VfsReadFile_FromPBYTE(sz, THREADINFO_INFOFILE_LENGTH, pb, cb, pcbRead, cbOffset);
 }
 
+VOID ThreadInfo_Read_ThreadMap_LineCB(_In_opt_ PVOID ctx, _In_ DWORD cbLineLength, _In_ DWORD ie, _In_ PVMM_MAP_THREADENTRY pT, _Out_writes_(cbLineLength + 1) LPSTR szu8)
+{
+    CHAR szTimeCreate[MAX_PATH] = { 0 }, szTimeExit[MAX_PATH] = { 0 };
+    Util_FileTime2String((PFILETIME)&pT->ftCreateTime, szTimeCreate);
+    Util_FileTime2String((PFILETIME)&pT->ftExitTime, szTimeExit);
+    Util_snprintf_ln(
+        szu8,
+        cbLineLength + 1,
+        cbLineLength,
+        "%04x%7i%8i %16llx %2x %2x %2x %2x %8x %16llx -- %16llx : %16llx > %16llx [%s :: %s]\n",
+        ie,
+        pT->dwPID,
+        pT->dwTID,
+        pT->vaETHREAD,
+        pT->bState,
+        pT->bRunning,
+        pT->bBasePriority,
+        pT->bPriority,
+        pT->dwExitStatus,
+        pT->vaStartAddress,
+        pT->vaTeb,
+        pT->vaStackBaseUser,
+        pT->vaStackLimitUser,
+        szTimeCreate,
+        szTimeExit
+    );
+}
+
 _Success_(return == 0)
 NTSTATUS ThreadInfo_Read_ThreadMap(_In_ PVMMOB_MAP_THREAD pThreadMap, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
 {
-    NTSTATUS nt;
-    LPSTR sz;
-    QWORD i, o = 0, cbMax, cStart, cEnd, cbLINELENGTH;
-    PVMM_MAP_THREADENTRY pT;
-    CHAR szTimeCreate[MAX_PATH] = { 0 }, szTimeExit[MAX_PATH] = { 0 };
-    cbLINELENGTH = THREADINFO_LINELENGTH;
-    cStart = (DWORD)(cbOffset / cbLINELENGTH);
-    cEnd = (DWORD)min(pThreadMap->cMap - 1, (cb + cbOffset + cbLINELENGTH - 1) / cbLINELENGTH);
-    cbMax = 1 + (1 + cEnd - cStart) * cbLINELENGTH;
-    if(!pThreadMap->cMap || (cStart > pThreadMap->cMap)) { return VMMDLL_STATUS_END_OF_FILE; }
-    if(!(sz = LocalAlloc(LMEM_ZEROINIT, cbMax))) { return VMMDLL_STATUS_FILE_INVALID; }
-    for(i = cStart; i <= cEnd; i++) {
-        pT = pThreadMap->pMap + i;
-        Util_FileTime2String((PFILETIME)&pT->ftCreateTime, szTimeCreate);
-        Util_FileTime2String((PFILETIME)&pT->ftExitTime, szTimeExit);
-        o += snprintf(
-            sz + o,
-            cbMax - o,
-            "%04x%7i%8i %16llx %2x %2x %2x %2x %8x %16llx -- %16llx : %16llx > %16llx [%s :: %s]\n",
-            (DWORD)i,
-            pT->dwPID,
-            pT->dwTID,
-            pT->vaETHREAD,
-            pT->bState,
-            pT->bRunning,
-            pT->bBasePriority,
-            pT->bPriority,
-            pT->dwExitStatus,
-            pT->vaStartAddress,
-            pT->vaTeb,
-            pT->vaStackBaseUser,
-            pT->vaStackLimitUser,
-            szTimeCreate,
-            szTimeExit
-        );
-    }
-    nt = Util_VfsReadFile_FromPBYTE(sz, cbMax - 1, pb, cb, pcbRead, cbOffset - cStart * cbLINELENGTH);
-    LocalFree(sz);
-    return nt;
+    return Util_VfsLineFixed_Read(
+        (UTIL_VFSLINEFIXED_PFN_CB)ThreadInfo_Read_ThreadMap_LineCB, NULL, (DWORD)THREADINFO_LINELENGTH,
+        pThreadMap->cMap, pThreadMap->pMap, sizeof(VMM_MAP_THREADENTRY),
+        pb, cb, pcbRead, cbOffset
+    );
 }
 
 /*
@@ -19,6 +19,16 @@
 
 #define _PHYSICAL_MEMORY_MAX_RUNS   0x20
 
+#define MVFSROOT_READ_BATCH_SIZE    0x00100000      // device-friendly physical read batch size
+#define MVFSROOT_READ_BATCH_MAX     0x20            // max # batches in flight per read
+
+typedef struct tdMVFSROOT_READ_BATCH {
+    HANDLE hEventFinish;
+    QWORD pa;
+    DWORD cb;
+    PBYTE pb;
+} MVFSROOT_READ_BATCH, *PMVFSROOT_READ_BATCH;
+
 typedef struct {
     QWORD BasePage;
     QWORD PageCount;
@@ -352,6 +362,85 @@ POB_VMMVFS_DUMP_CONTEXT MVfsRoot_GetDumpContext()
     return ctx;
 }
 
+VOID MVfsRoot_ReadPhysical_BatchThreadProc(_In_ PMVFSROOT_READ_BATCH pBatch)
+{
+    VmmReadEx(NULL, pBatch->pa, pBatch->pb, pBatch->cb, NULL, VMM_FLAG_ZEROPAD_ON_FAIL);
+}
+
+/*
+* Dispatch physical read batches onto the worker threads and wait for them to
+* finish. The last batch is read by the calling thread.
+* -- pBatches
+* -- cBatches
+*/
+VOID MVfsRoot_ReadPhysical_Batches(_In_ PMVFSROOT_READ_BATCH pBatches, _In_ DWORD cBatches)
+{
+    DWORD i;
+    for(i = 0; i + 1 < cBatches; i++) {
+        pBatches[i].hEventFinish = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if(!pBatches[i].hEventFinish || !VmmWorkEx((LPTHREAD_START_ROUTINE)MVfsRoot_ReadPhysical_BatchThreadProc, pBatches + i, pBatches[i].hEventFinish, VMMWORK_PRIORITY_HIGH)) {
+            MVfsRoot_ReadPhysical_BatchThreadProc(pBatches + i);
+            if(pBatches[i].hEventFinish) { SetEvent(pBatches[i].hEventFinish); }
+        }
+    }
+    if(cBatches) {
+        MVfsRoot_ReadPhysical_BatchThreadProc(pBatches + cBatches - 1);
+    }
+    for(i = 0; i + 1 < cBatches; i++) {
+        if(pBatches[i].hEventFinish) {
+            WaitForSingleObject(pBatches[i].hEventFinish, INFINITE);
+            CloseHandle(pBatches[i].hEventFinish);
+            pBatches[i].hEventFinish = NULL;
+        }
+    }
+}
+
+/*
+* Read physical memory backing the memory.pmem and memory.dmp files. Ranges
+* not in the physical memory map are zero-filled without any device reads.
+* Remaining ranges are split into device-friendly batches read in parallel.
+* -- pb
+* -- cb
+* -- pa
+* -- return = number of bytes of file data (incl. zero-filled), i.e. cb
+*             clamped to the end of physical memory.
+*/
+DWORD MVfsRoot_ReadPhysical(_Out_writes_(cb) PBYTE pb, _In_ DWORD cb, _In_ QWORD pa)
+{
+    DWORD i, cMap, cBatches = 0;
+    QWORD paMax = ctxMain->dev.paMax, paRangeBase, paRangeTop, paBatch, paBatchTop;
+    PVMMOB_MAP_PHYSMEM pObPhysMemMap = NULL;
+    PMVFSROOT_READ_BATCH pBatch;
+    MVFSROOT_READ_BATCH Batches[MVFSROOT_READ_BATCH_MAX] = { 0 };
+    if(pa >= paMax) { return 0; }
+    cb = (DWORD)min(cb, paMax - pa);
+    ZeroMemory(pb, cb);
+    if(!VmmMap_GetPhysMem(&pObPhysMemMap) || !pObPhysMemMap->cMap) {
+        Ob_DECREF_NULL(&pObPhysMemMap);
+    }
+    cMap = pObPhysMemMap ? pObPhysMemMap->cMap : 1;
+    for(i = 0; i < cMap; i++) {
+        paRangeBase = pObPhysMemMap ? pObPhysMemMap->pMap[i].pa : 0;
+        paRangeTop = pObPhysMemMap ? pObPhysMemMap->pMap[i].pa + pObPhysMemMap->pMap[i].cb : paMax;
+        paRangeBase = max(paRangeBase, pa);
+        paRangeTop = min(paRangeTop, pa + cb);
+        for(paBatch = paRangeBase; paBatch < paRangeTop; paBatch = paBatchTop) {
+            paBatchTop = min(paRangeTop, (paBatch + MVFSROOT_READ_BATCH_SIZE) & ~(QWORD)(MVFSROOT_READ_BATCH_SIZE - 1));
+            if(cBatches == MVFSROOT_READ_BATCH_MAX) {
+                MVfsRoot_ReadPhysical_Batches(Batches, cBatches);
+                cBatches = 0;
+            }
+            pBatch = Batches + cBatches++;
+            pBatch->pa = paBatch;
+            pBatch->cb = (DWORD)(paBatchTop - paBatch);
+            pBatch->pb = pb + (paBatch - pa);
+        }
+    }
+    MVfsRoot_ReadPhysical_Batches(Batches, cBatches);
+    Ob_DECREF(pObPhysMemMap);
+    return cb;
+}
+
 /*
 * Read from memory dump files in the virtual file system root.
 * -- ctx
@@ -370,8 +459,9 @@ NTSTATUS MVfsRoot_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWO
     DWORD cbOverlayOffset, cbOverlay;
     QWORD cbOverlayAdjust;
     if(!_wcsicmp(ctx->wszPath, L"memory.pmem")) {
-        VmmReadEx(NULL, cbOffset, pb, cb, pcbRead, VMM_FLAG_ZEROPAD_ON_FAIL);
-        return VMM_STATUS_SUCCESS;
+        cbReadMem = MVfsRoot_ReadPhysical(pb, cb, cbOffset);
+        if(pcbRead) { *pcbRead = cbReadMem; }
+        return cbReadMem ? VMM_STATUS_SUCCESS : VMM_STATUS_END_OF_FILE;
     }
     if(!_wcsicmp(ctx->wszPath, L"memory.dmp")) {
         if(!(pObDumpCtx = MVfsRoot_GetDumpContext())) { goto finish; }
@@ -390,7 +480,7 @@ NTSTATUS MVfsRoot_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWO
         }
         cbOffset -= pObDumpCtx->cbHdr;
         // read memory
-        VmmReadEx(NULL, cbOffset, pb, cb, &cbReadMem, VMM_FLAG_ZEROPAD_ON_FAIL);
+        cbReadMem = MVfsRoot_ReadPhysical(pb, cb, cbOffset);
         if(pcbRead) { *pcbRead = cbHead + cbReadMem; }
         // overlay decrypted KDBG, KdpDataBlockEncoded (if encrypted) and ProcessorContext0
         for(io = 0; io < sizeof(pObDumpCtx->OVERLAY) / sizeof(VMMVFS_DUMP_CONTEXT_OVERLAY); io++) {
@@ -28,6 +28,24 @@ VOID MmX86PAE_Initialize();
 */
 VOID MmX64_Initialize();
 
+/*
+* Switch the X64 page table verify function between the scalar version and
+* the fastest vectorized version supported by the CPU. Used for benchmarking
+* and diagnostics - the vectorized version is selected on initialization.
+* -- fVector
+* -- return = FALSE if the X64 memory model is not active.
+*/
+_Success_(return)
+BOOL MmX64_TlbPageTableVerifyConfigure(_In_ BOOL fVector);
+
+/*
+* Retrieve whether the vectorized X64 page table verify function is in use.
+* -- pfVector
+* -- return = FALSE if the X64 memory model is not active.
+*/
+_Success_(return)
+BOOL MmX64_TlbPageTableVerifyIsVector(_Out_ PBOOL pfVector);
+
 /*
 * Initialize the paging sub-system for Windows in a limited or full fashion.
 * In full mode Win10 memory decompression will be initialized.
@@ -62,4 +80,32 @@ BOOL MmVad_MapInitialize(_In_ PVMM_PROCESS pProcess, _In_ BOOL fExtendedText, _I
 */
 QWORD MmVad_PrototypePte(_In_ PVMM_PROCESS pProcess, _In_ QWORD va, _Out_opt_ PBOOL pfInRange, _In_ QWORD fVmmRead);
 
+/*
+* Initialize the memory budget of the prototype pte array cache. The cache map
+* ctxVmm->Cache.pmPrototypePte must already be allocated.
+*/
+VOID MmVad_PrototypePteCache_Initialize();
+
+/*
+* Close the prototype pte array cache memory budget accounting. Should only be
+* called on shutdown.
+*/
+VOID MmVad_PrototypePteCache_Close();
+
+/*
+* Set the memory budget of the prototype pte array cache. If the cache is
+* larger than the new budget entries are evicted immediately.
+* -- cMB = budget in MB, 0 = default.
+* -- return
+*/
+_Success_(return)
+BOOL MmVad_PrototypePteCache_Configure(_In_ DWORD cMB);
+
+/*
+* Release memory held by the prototype pte array cache under memory pressure.
+* Entries are evicted in the regular clock order of the cache.
+* -- cb = number of bytes to release.
+*/
+VOID MmVad_PrototypePteCache_Shrink(_In_ QWORD cb);
+
 #endif /* __MM_H__ */
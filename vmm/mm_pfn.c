@@ -14,6 +14,7 @@ typedef struct tdOB_MMPFN_CONTEXT {
     QWORD vaPfnDatabase;
     CRITICAL_SECTION Lock;
     POB_CONTAINER pObCProcTableDTB;
+    POB_CONTAINER pObCBlockCache;   // POB_MAP of PMMPFN_OB_BLOCK - cleared on refresh
     struct {
         WORD cb;
         WORD oOriginalPte;
@@ -23,12 +24,28 @@ typedef struct tdOB_MMPFN_CONTEXT {
         WORD ou4;
     } _MMPFN;
     DWORD iPfnMax;
+    volatile LONG cBlockSeq;
 } OB_MMPFN_CONTEXT, *POB_MMPFN_CONTEXT;
 
 #define MMPFN_PFN_TO_VA(ctx, i)     (ctx->vaPfnDatabase + (QWORD)i * ctx->_MMPFN.cb)
 
+#define MMPFN_BLOCK_PFN             0x1000      // # PFNs per decoded block (16MB physical memory)
+#define MMPFN_BLOCK_CACHE_MAX       64          // max # decoded blocks cached per refresh
+#define MMPFN_BLOCK_SMALL_REQUEST   0x100       // ranges smaller than this are not decoded as full blocks
+
+typedef struct tdMMPFN_OB_BLOCK {
+    OB ObHdr;
+    DWORD iPfnBase;
+    DWORD cPfn;
+    DWORD dwSeq;
+    BOOL fExtended;
+    MMPFN_MAP_ENTRY pMap[];
+} MMPFN_OB_BLOCK, *PMMPFN_OB_BLOCK;
+
 VOID MmPfn_CallbackCleanup_ObContext(POB_MMPFN_CONTEXT ctx)
 {
+    Ob_DECREF(ctx->pObCProcTableDTB);
+    Ob_DECREF(ctx->pObCBlockCache);
     DeleteCriticalSection(&ctx->Lock);
 }
 
@@ -37,6 +54,7 @@ VOID MmPfn_Refresh()
     POB_MMPFN_CONTEXT ctx = (POB_MMPFN_CONTEXT)ctxVmm->pObPfnContext;
     if(!ctx) { return; }
     ObContainer_SetOb(ctx->pObCProcTableDTB, NULL);
+    ObContainer_SetOb(ctx->pObCBlockCache, NULL);
 }
 
 VOID MmPfn_Initialize(_In_ PVMM_PROCESS pSystemProcess)
@@ -46,6 +64,7 @@ VOID MmPfn_Initialize(_In_ PVMM_PROCESS pSystemProcess)
     if(!(ctx = Ob_Alloc(OB_TAG_PFN_CONTEXT, LMEM_ZEROINIT, sizeof(OB_MMPFN_CONTEXT), MmPfn_CallbackCleanup_ObContext, NULL))) { return; }
     InitializeCriticalSection(&ctx->Lock);
     f = (ctx->pObCProcTableDTB = ObContainer_New(NULL)) &&
+        (ctx->pObCBlockCache = ObContainer_New(NULL)) &&
         PDB_GetSymbolPTR(PDB_HANDLE_KERNEL, "MmPfnDatabase", pSystemProcess, &ctx->vaPfnDatabase) &&
         PDB_GetTypeSizeShort(PDB_HANDLE_KERNEL, "_MMPFN", &ctx->_MMPFN.cb) &&
         PDB_GetTypeChildOffsetShort(PDB_HANDLE_KERNEL, "_MMPFN", L"OriginalPte", &ctx->_MMPFN.oOriginalPte) &&
@@ -275,17 +294,224 @@ VOID MmPfn_Map_GetPfn_GetVaX86(_In_ POB_MMPFN_CONTEXT ctx, _In_ PVMM_PROCESS pSy
     }
 }
 
+/*
+* Decode the MMPFN fields of a single PFN database entry into a map entry.
+* Entries with a resolvable virtual address are queued for enrichment.
+* -- ctx
+* -- pbPfn = the raw _MMPFN entry.
+* -- pe
+* -- fExtended
+* -- psEnrichAddress
+* -- psPrefetch
+*/
+VOID MmPfn_Map_DecodeEntry(_In_ POB_MMPFN_CONTEXT ctx, _In_ PBYTE pbPfn, _Inout_ PMMPFN_MAP_ENTRY pe, _In_ BOOL fExtended, _In_ POB_SET psEnrichAddress, _In_ POB_SET psPrefetch)
+{
+    BOOL f32 = ctxVmm->f32;
+    QWORD qw;
+    DWORD tp;
+    pe->_u3 = *(PDWORD)(pbPfn + ctx->_MMPFN.ou3);
+    qw = *(PQWORD)(pbPfn + ctx->_MMPFN.ou4);
+    if(f32) {
+        pe->PteFrame = qw & 0x00ffffff;
+        pe->PteFrameHigh = (qw >> 20) & 0xf;
+        pe->PrototypePte = (qw >> 27) & 0x1;
+        pe->PageColor = (qw >> 28) & 0xf;
+    } else {
+        pe->_u4 = qw;
+    }
+    pe->vaPte = VMM_PTR_OFFSET(f32, pbPfn, ctx->_MMPFN.oPteAddress);
+    pe->OriginalPte = VMM_PTR_OFFSET(f32, pbPfn, ctx->_MMPFN.oOriginalPte);
+    tp = pe->PageLocation;
+    if(fExtended && (tp == MmPfnTypeActive) || (tp == MmPfnTypeStandby) || (tp == MmPfnTypeModified) || (tp == MmPfnTypeModifiedNoWrite)) {
+        if(!pe->PrototypePte && !pe->PteFrameHigh && (pe->PteFrame <= ctx->iPfnMax)) {
+            pe->AddressInfo.va = ((pe->vaPte << 9) & 0x1ff000) | 0xfff;
+            pe->AddressInfo.dwPfnPte[1] = pe->PteFrame;
+            ObSet_Push(psEnrichAddress, (QWORD)pe);
+            ObSet_Push_PageAlign(psPrefetch, MMPFN_PFN_TO_VA(ctx, pe->AddressInfo.dwPfnPte[1]), ctx->_MMPFN.cb);
+        } else if((tp == MmPfnTypeActive) && (pe->PteFrameHigh == 0xf)) {
+            pe->tpExtended = MmPfnExType_DriverLocked;
+        } else if(pe->PrototypePte) {
+            if(pe->Modified) {
+                pe->tpExtended = MmPfnExType_Shareable;
+            } else {
+                pe->tpExtended = MmPfnExType_File;
+            }
+        }
+    } else if((tp == MmPfnTypeZero) || (tp == MmPfnTypeFree) || (tp == MmPfnTypeBad)) {
+        pe->tpExtended = MmPfnExType_Unused;
+    }
+}
+
+/*
+* Enrich decoded map entries with virtual addresses and additional info.
+* -- ctx
+* -- pSystemProcess
+* -- psEnrichAddress
+* -- psPrefetch
+*/
+VOID MmPfn_Map_EnrichAddress(_In_ POB_MMPFN_CONTEXT ctx, _In_ PVMM_PROCESS pSystemProcess, _In_ POB_SET psEnrichAddress, _In_ POB_SET psPrefetch)
+{
+    if(!ObSet_Size(psEnrichAddress)) { return; }
+    if(ctxVmm->tpMemoryModel == VMMDLL_MEMORYMODEL_X64) {
+        MmPfn_Map_GetPfn_GetVaX64(ctx, pSystemProcess, psEnrichAddress, psPrefetch, 1);
+    } else if(ctxVmm->tpMemoryModel == VMMDLL_MEMORYMODEL_X86PAE) {
+        MmPfn_Map_GetPfn_GetVaX86PAE(ctx, pSystemProcess, psEnrichAddress, psPrefetch, 1);
+    } else if(ctxVmm->tpMemoryModel == VMMDLL_MEMORYMODEL_X86) {
+        MmPfn_Map_GetPfn_GetVaX86(ctx, pSystemProcess, psEnrichAddress, psPrefetch);
+    }
+}
+
+/*
+* Retrieve the block cache of the current refresh period.
+* CALLER DECREF: return
+* -- ctx
+* -- return
+*/
+POB_MAP MmPfn_BlockCache_Get(_In_ POB_MMPFN_CONTEXT ctx)
+{
+    POB_MAP pmObBlockCache;
+    if((pmObBlockCache = ObContainer_GetOb(ctx->pObCBlockCache))) { return pmObBlockCache; }
+    EnterCriticalSection(&ctx->Lock);
+    if(!(pmObBlockCache = ObContainer_GetOb(ctx->pObCBlockCache)) && (pmObBlockCache = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) {
+        ObContainer_SetOb(ctx->pObCBlockCache, pmObBlockCache);
+    }
+    LeaveCriticalSection(&ctx->Lock);
+    return pmObBlockCache;
+}
+
+/*
+* Read and decode a block of MMPFN_BLOCK_PFN consecutive PFNs. The PFN database
+* entries of the whole block are read in one scatter read and then decoded in
+* one pass over the contiguous buffer. Entries not fully readable are left
+* undecoded (only dwPfn is set).
+* CALLER DECREF: return
+* -- ctx
+* -- pSystemProcess
+* -- iBlock
+* -- fExtended
+* -- return
+*/
+PMMPFN_OB_BLOCK MmPfn_Block_Create(_In_ POB_MMPFN_CONTEXT ctx, _In_ PVMM_PROCESS pSystemProcess, _In_ DWORD iBlock, _In_ BOOL fExtended)
+{
+    DWORD i, o, cPfn, cMEMs, iPfnBase;
+    QWORD va, vaBase;
+    PBYTE pbDb = NULL;
+    PPMEM_SCATTER ppMEMs = NULL;
+    PMMPFN_MAP_ENTRY pe;
+    PMMPFN_OB_BLOCK pObBlock = NULL, pObResult = NULL;
+    POB_SET psObEnrichAddress = NULL, psObPrefetch = NULL;
+    iPfnBase = iBlock * MMPFN_BLOCK_PFN;
+    if(iPfnBase > ctx->iPfnMax) { goto fail; }
+    cPfn = min(MMPFN_BLOCK_PFN, ctx->iPfnMax - iPfnBase + 1);
+    va = MMPFN_PFN_TO_VA(ctx, iPfnBase);
+    vaBase = va & ~0xfff;
+    cMEMs = (DWORD)((va + (QWORD)cPfn * ctx->_MMPFN.cb - vaBase + 0xfff) >> 12);
+    if(!(psObEnrichAddress = ObSet_New())) { goto fail; }
+    if(!(psObPrefetch = ObSet_New())) { goto fail; }
+    if(!(pbDb = LocalAlloc(0, (SIZE_T)cMEMs << 12))) { goto fail; }
+    if(!LcAllocScatter2(cMEMs << 12, pbDb, cMEMs, &ppMEMs)) { goto fail; }
+    if(!(pObBlock = Ob_Alloc(OB_TAG_PFN_BLOCK, LMEM_ZEROINIT, sizeof(MMPFN_OB_BLOCK) + cPfn * sizeof(MMPFN_MAP_ENTRY), NULL, NULL))) { goto fail; }
+    pObBlock->iPfnBase = iPfnBase;
+    pObBlock->cPfn = cPfn;
+    pObBlock->dwSeq = (DWORD)InterlockedIncrement(&ctx->cBlockSeq);
+    pObBlock->fExtended = fExtended;
+    // 1: read the pfn database entries of the block
+    for(i = 0; i < cMEMs; i++) {
+        ppMEMs[i]->qwA = vaBase + ((QWORD)i << 12);
+    }
+    VmmReadScatterVirtual(pSystemProcess, ppMEMs, cMEMs, 0);
+    // 2: decode the pfn database entries of the block
+    for(i = 0, o = (DWORD)(va - vaBase); i < cPfn; i++, o += ctx->_MMPFN.cb) {
+        pe = pObBlock->pMap + i;
+        pe->dwPfn = iPfnBase + i;
+        if(!ppMEMs[o >> 12]->f || !ppMEMs[(o + ctx->_MMPFN.cb - 1) >> 12]->f) { continue; }
+        MmPfn_Map_DecodeEntry(ctx, pbDb + o, pe, fExtended, psObEnrichAddress, psObPrefetch);
+    }
+    // 3: encrich result with virtual addresses and additional info
+    MmPfn_Map_EnrichAddress(ctx, pSystemProcess, psObEnrichAddress, psObPrefetch);
+    pObResult = Ob_INCREF(pObBlock);
+fail:
+    LcMemFree(ppMEMs);
+    LocalFree(pbDb);
+    Ob_DECREF(pObBlock);
+    Ob_DECREF(psObPrefetch);
+    Ob_DECREF(psObEnrichAddress);
+    return pObResult;
+}
+
+/*
+* Evict the oldest (first created) block from the block cache. The map moves
+* its last entry into the slot of a removed entry so the map index does not
+* reflect the age of a block - the creation sequence number is used instead.
+* NB! caller must hold ctx->Lock.
+* -- pmBlockCache
+*/
+VOID MmPfn_Block_EvictOldest(_In_ POB_MAP pmBlockCache)
+{
+    DWORD i, c;
+    QWORD qwKeyOldest = 0;
+    BOOL fOldest = FALSE;
+    DWORD dwSeqOldest = 0;
+    PMMPFN_OB_BLOCK pObBlock;
+    for(i = 0, c = ObMap_Size(pmBlockCache); i < c; i++) {
+        if(!(pObBlock = ObMap_GetByIndex(pmBlockCache, i))) { continue; }
+        if(!fOldest || ((LONG)(pObBlock->dwSeq - dwSeqOldest) < 0)) {
+            fOldest = TRUE;
+            dwSeqOldest = pObBlock->dwSeq;
+            qwKeyOldest = ((QWORD)(pObBlock->iPfnBase / MMPFN_BLOCK_PFN) << 1) | (pObBlock->fExtended ? 1 : 0);
+        }
+        Ob_DECREF(pObBlock);
+    }
+    if(fOldest) {
+        Ob_DECREF(ObMap_RemoveByKey(pmBlockCache, qwKeyOldest));
+    }
+}
+
+/*
+* Retrieve a decoded block of PFNs from the block cache. If the block is not
+* already cached it is optionally created and cached. Blocks are cached until
+* the next pfn refresh, at most MMPFN_BLOCK_CACHE_MAX blocks are cached - the
+* oldest block is evicted first.
+* CALLER DECREF: return
+* -- ctx
+* -- pSystemProcess
+* -- pmBlockCache
+* -- iBlock
+* -- fExtended
+* -- fCreate
+* -- return
+*/
+PMMPFN_OB_BLOCK MmPfn_Block_Get(_In_ POB_MMPFN_CONTEXT ctx, _In_ PVMM_PROCESS pSystemProcess, _In_ POB_MAP pmBlockCache, _In_ DWORD iBlock, _In_ BOOL fExtended, _In_ BOOL fCreate)
+{
+    QWORD qwKey = ((QWORD)iBlock << 1) | (fExtended ? 1 : 0);
+    PMMPFN_OB_BLOCK pObBlock;
+    if((pObBlock = ObMap_GetByKey(pmBlockCache, qwKey)) || !fCreate) { return pObBlock; }
+    if((pObBlock = MmPfn_Block_Create(ctx, pSystemProcess, iBlock, fExtended))) {
+        EnterCriticalSection(&ctx->Lock);
+        if(!ObMap_ExistsKey(pmBlockCache, qwKey)) {
+            if(ObMap_Size(pmBlockCache) >= MMPFN_BLOCK_CACHE_MAX) {
+                MmPfn_Block_EvictOldest(pmBlockCache);
+            }
+            ObMap_Push(pmBlockCache, qwKey, pObBlock);
+        }
+        LeaveCriticalSection(&ctx->Lock);
+    }
+    return pObBlock;
+}
+
 _Success_(return)
 BOOL MmPfn_Map_GetPfnScatter(_In_ POB_SET psPfn, _Out_ PMMPFNOB_MAP *ppObPfnMap, _In_ BOOL fExtended)
 {
     POB_MMPFN_CONTEXT ctx = (POB_MMPFN_CONTEXT)ctxVmm->pObPfnContext;
-    BOOL fResult = FALSE, f32 = ctxVmm->f32;
+    BOOL fResult = FALSE;
     BYTE pbPfn[0x30] = { 0 };
+    PBYTE pfCached = NULL;
     PVMM_PROCESS pObSystemProcess = NULL;
     PMMPFNOB_MAP pObPfnMap = NULL;
     PMMPFN_MAP_ENTRY pe;
-    QWORD qw;
-    DWORD cPfn, i, tp, cbRead;
+    PMMPFN_OB_BLOCK pObBlock = NULL;
+    DWORD cPfn, i, cbRead;
+    POB_MAP pmObBlockCache = NULL;
     POB_SET psObEnrichAddress = NULL, psObPrefetch = NULL;
     if(!ctx) { goto fail; }
     // initialization
@@ -293,12 +519,25 @@ BOOL MmPfn_Map_GetPfnScatter(_In_ POB_SET psPfn, _Out_ PMMPFNOB_MAP *ppObPfnMap,
     if(!(pObSystemProcess = VmmProcessGet(4))) { goto fail; }
     if(!(psObEnrichAddress = ObSet_New())) { goto fail; }
     if(!(psObPrefetch = ObSet_New())) { goto fail; }
+    if(!(pfCached = LocalAlloc(LMEM_ZEROINIT, cPfn))) { goto fail; }
     if(!(pObPfnMap = Ob_Alloc(OB_TAG_MAP_PFN, LMEM_ZEROINIT, sizeof(MMPFNOB_MAP) + cPfn * sizeof(MMPFN_MAP_ENTRY), NULL, NULL))) { goto fail; }
     pObPfnMap->cMap = cPfn;
-    // translate pfn# to pfn va and prefetch
+    pmObBlockCache = MmPfn_BlockCache_Get(ctx);
+    // translate pfn# to pfn va and prefetch - pfns in already decoded blocks
+    // are copied from the block cache.
     for(i = 0; i < cPfn; i++) {
         pe = pObPfnMap->pMap + i;
         pe->dwPfn = (DWORD)ObSet_Get(psPfn, i);
+        if(pe->dwPfn > ctx->iPfnMax) { continue; }
+        if(pmObBlockCache && (!pObBlock || (pe->dwPfn - pObBlock->iPfnBase >= pObBlock->cPfn))) {
+            Ob_DECREF_NULL(&pObBlock);
+            pObBlock = MmPfn_Block_Get(ctx, pObSystemProcess, pmObBlockCache, pe->dwPfn / MMPFN_BLOCK_PFN, fExtended, FALSE);
+        }
+        if(pObBlock && (pe->dwPfn - pObBlock->iPfnBase < pObBlock->cPfn)) {
+            memcpy(pe, pObBlock->pMap + (pe->dwPfn - pObBlock->iPfnBase), sizeof(MMPFN_MAP_ENTRY));
+            pfCached[i] = TRUE;
+            continue;
+        }
         ObSet_Push_PageAlign(psObPrefetch, MMPFN_PFN_TO_VA(ctx, pe->dwPfn), ctx->_MMPFN.cb);
     }
     VmmCachePrefetchPages(pObSystemProcess, psObPrefetch, 0);
@@ -306,57 +545,22 @@ BOOL MmPfn_Map_GetPfnScatter(_In_ POB_SET psPfn, _Out_ PMMPFNOB_MAP *ppObPfnMap,
     // iterate and fetch pfns
     for(i = 0; i < cPfn; i++) {
         pe = pObPfnMap->pMap + i;
-        if(pe->dwPfn > ctx->iPfnMax) { continue; }
+        if(pfCached[i] || (pe->dwPfn > ctx->iPfnMax)) { continue; }
         // TODO: reinstate VMM_FLAG_FORCECACHE_READ when caching algo is fixed.
         VmmReadEx(pObSystemProcess, MMPFN_PFN_TO_VA(ctx, pe->dwPfn), pbPfn, ctx->_MMPFN.cb, &cbRead, 0 /*VMM_FLAG_FORCECACHE_READ*/);
         if(!cbRead) { continue; }
-        pe->_u3 = *(PDWORD)(pbPfn + ctx->_MMPFN.ou3);
-        qw = *(PQWORD)(pbPfn + ctx->_MMPFN.ou4);
-        if(f32) {
-            pe->PteFrame = qw & 0x00ffffff;
-            pe->PteFrameHigh = (qw >> 20) & 0xf;
-            pe->PrototypePte = (qw >> 27) & 0x1;
-            pe->PageColor = (qw >> 28) & 0xf;
-        } else {
-            pe->_u4 = qw;
-        }
-        pe->vaPte = VMM_PTR_OFFSET(f32, pbPfn, ctx->_MMPFN.oPteAddress);
-        pe->OriginalPte = VMM_PTR_OFFSET(f32, pbPfn, ctx->_MMPFN.oOriginalPte);
-        tp = pe->PageLocation;
-        if(fExtended && (tp == MmPfnTypeActive) || (tp == MmPfnTypeStandby) || (tp == MmPfnTypeModified) || (tp == MmPfnTypeModifiedNoWrite)) {
-            if(!pe->PrototypePte && !pe->PteFrameHigh && (pe->PteFrame <= ctx->iPfnMax)) {
-                pe->AddressInfo.va = ((pe->vaPte << 9) & 0x1ff000) | 0xfff;
-                pe->AddressInfo.dwPfnPte[1] = pe->PteFrame;
-                ObSet_Push(psObEnrichAddress, (QWORD)pe);
-                ObSet_Push_PageAlign(psObPrefetch, MMPFN_PFN_TO_VA(ctx, pe->AddressInfo.dwPfnPte[1]), ctx->_MMPFN.cb);
-            } else if((tp == MmPfnTypeActive) && (pe->PteFrameHigh == 0xf)) {
-                pe->tpExtended = MmPfnExType_DriverLocked;
-            } else if(pe->PrototypePte) {
-                if(pe->Modified) {
-                    pe->tpExtended = MmPfnExType_Shareable;
-                } else {
-                    pe->tpExtended = MmPfnExType_File;
-                }
-            }
-        } else if((tp == MmPfnTypeZero) || (tp == MmPfnTypeFree) || (tp == MmPfnTypeBad)) {
-            pe->tpExtended = MmPfnExType_Unused;
-        }
+        MmPfn_Map_DecodeEntry(ctx, pbPfn, pe, fExtended, psObEnrichAddress, psObPrefetch);
     }
     // encrich result with virtual addresses and additional info
-    if(ObSet_Size(psObEnrichAddress)) {
-        if(ctxVmm->tpMemoryModel == VMMDLL_MEMORYMODEL_X64) {
-            MmPfn_Map_GetPfn_GetVaX64(ctx, pObSystemProcess, psObEnrichAddress, psObPrefetch, 1);
-        } else if(ctxVmm->tpMemoryModel == VMMDLL_MEMORYMODEL_X86PAE) {
-            MmPfn_Map_GetPfn_GetVaX86PAE(ctx, pObSystemProcess, psObEnrichAddress, psObPrefetch, 1);
-        } else if(ctxVmm->tpMemoryModel == VMMDLL_MEMORYMODEL_X86) {
-            MmPfn_Map_GetPfn_GetVaX86(ctx, pObSystemProcess, psObEnrichAddress, psObPrefetch);
-        }
-    }
+    MmPfn_Map_EnrichAddress(ctx, pObSystemProcess, psObEnrichAddress, psObPrefetch);
     *ppObPfnMap = Ob_INCREF(pObPfnMap);
     fResult = TRUE;
     // fall through to cleanup
 fail:
+    LocalFree(pfCached);
+    Ob_DECREF(pObBlock);
     Ob_DECREF(pObPfnMap);
+    Ob_DECREF(pmObBlockCache);
     Ob_DECREF(pObSystemProcess);
     Ob_DECREF(psObPrefetch);
     Ob_DECREF(psObEnrichAddress);
@@ -366,14 +570,71 @@ fail:
 _Success_(return)
 BOOL MmPfn_Map_GetPfn(_In_ DWORD dwPfnStart, _In_ DWORD cPfn, _Out_ PMMPFNOB_MAP *ppObPfnMap, _In_ BOOL fExtended)
 {
-    BOOL fResult;
-    POB_SET psObPfn;
-    QWORD iPfn, iPfnEnd;
-    if(!(psObPfn = ObSet_New())) { return FALSE; }
-    for(iPfn = dwPfnStart, iPfnEnd = (QWORD)dwPfnStart + cPfn; iPfn < iPfnEnd; iPfn++) {
-        ObSet_Push(psObPfn, 0x80000000'00000000 | iPfn);
+    POB_MMPFN_CONTEXT ctx = (POB_MMPFN_CONTEXT)ctxVmm->pObPfnContext;
+    BOOL fResult = FALSE, fSmall;
+    BYTE pbPfn[0x30] = { 0 };
+    DWORD i, j, c, cCopy, cbRead;
+    QWORD iPfn;
+    PBYTE pfRead = NULL;
+    PVMM_PROCESS pObSystemProcess = NULL;
+    PMMPFNOB_MAP pObPfnMap = NULL;
+    PMMPFN_MAP_ENTRY pe;
+    PMMPFN_OB_BLOCK pObBlock = NULL;
+    POB_MAP pmObBlockCache = NULL;
+    POB_SET psObEnrichAddress = NULL, psObPrefetch = NULL;
+    if(!ctx || !cPfn) { goto fail; }
+    fSmall = (cPfn < MMPFN_BLOCK_SMALL_REQUEST);
+    if(!(pObSystemProcess = VmmProcessGet(4))) { goto fail; }
+    if(!(pmObBlockCache = MmPfn_BlockCache_Get(ctx))) { goto fail; }
+    if(fSmall && !(pfRead = LocalAlloc(LMEM_ZEROINIT, cPfn))) { goto fail; }
+    if(!(pObPfnMap = Ob_Alloc(OB_TAG_MAP_PFN, LMEM_ZEROINIT, sizeof(MMPFNOB_MAP) + cPfn * sizeof(MMPFN_MAP_ENTRY), NULL, NULL))) { goto fail; }
+    pObPfnMap->cMap = cPfn;
+    // copy the range from the decoded (and cached) blocks it overlaps. small
+    // ranges only use already cached blocks - other pfns are read below.
+    for(i = 0; i < cPfn; i += c) {
+        iPfn = (QWORD)dwPfnStart + i;
+        c = (DWORD)min(cPfn - i, MMPFN_BLOCK_PFN - (iPfn % MMPFN_BLOCK_PFN));
+        cCopy = 0;
+        if((iPfn <= ctx->iPfnMax) && (pObBlock = MmPfn_Block_Get(ctx, pObSystemProcess, pmObBlockCache, (DWORD)(iPfn / MMPFN_BLOCK_PFN), fExtended, !fSmall))) {
+            cCopy = min(c, pObBlock->cPfn - (DWORD)(iPfn - pObBlock->iPfnBase));
+            memcpy(pObPfnMap->pMap + i, pObBlock->pMap + (iPfn - pObBlock->iPfnBase), cCopy * sizeof(MMPFN_MAP_ENTRY));
+            Ob_DECREF_NULL(&pObBlock);
+        }
+        for(j = cCopy; j < c; j++) {
+            pObPfnMap->pMap[i + j].dwPfn = (DWORD)(iPfn + j);
+            if(fSmall && (iPfn + j <= ctx->iPfnMax)) {
+                pfRead[i + j] = TRUE;
+            }
+        }
     }
-    fResult = MmPfn_Map_GetPfnScatter(psObPfn, ppObPfnMap, fExtended);
-    Ob_DECREF(psObPfn);
+    // small range: read and decode the requested uncached pfns only.
+    if(fSmall) {
+        if(!(psObEnrichAddress = ObSet_New())) { goto fail; }
+        if(!(psObPrefetch = ObSet_New())) { goto fail; }
+        for(i = 0; i < cPfn; i++) {
+            if(pfRead[i]) {
+                ObSet_Push_PageAlign(psObPrefetch, MMPFN_PFN_TO_VA(ctx, pObPfnMap->pMap[i].dwPfn), ctx->_MMPFN.cb);
+            }
+        }
+        VmmCachePrefetchPages(pObSystemProcess, psObPrefetch, 0);
+        ObSet_Clear(psObPrefetch);
+        for(i = 0; i < cPfn; i++) {
+            if(!pfRead[i]) { continue; }
+            pe = pObPfnMap->pMap + i;
+            VmmReadEx(pObSystemProcess, MMPFN_PFN_TO_VA(ctx, pe->dwPfn), pbPfn, ctx->_MMPFN.cb, &cbRead, 0);
+            if(!cbRead) { continue; }
+            MmPfn_Map_DecodeEntry(ctx, pbPfn, pe, fExtended, psObEnrichAddress, psObPrefetch);
+        }
+        MmPfn_Map_EnrichAddress(ctx, pObSystemProcess, psObEnrichAddress, psObPrefetch);
+    }
+    *ppObPfnMap = Ob_INCREF(pObPfnMap);
+    fResult = TRUE;
+fail:
+    LocalFree(pfRead);
+    Ob_DECREF(pObPfnMap);
+    Ob_DECREF(pmObBlockCache);
+    Ob_DECREF(pObSystemProcess);
+    Ob_DECREF(psObPrefetch);
+    Ob_DECREF(psObEnrichAddress);
     return fResult;
 }
@@ -89,13 +89,16 @@ typedef struct tdMMPFNOB_MAP {
 VOID MmPfn_Initialize(_In_ PVMM_PROCESS pSystemProcess);
 
 /*
-* Refresh the PFN (page frame number) subsystem.
+* Refresh the PFN (page frame number) subsystem - clears the cached blocks.
 * This should be performed after each process list refresh.
 */
 VOID MmPfn_Refresh();
 
 /*
-* Retrieve information about a sequential number of PFNs.
+* Retrieve information about a sequential number of PFNs. The PFNs are decoded
+* in large blocks which are cached until the next pfn refresh - overlapping or
+* repeated queries are served from the cache. Small ranges are copied from the
+* cache where possible - the remaining PFNs are read and decoded one by one.
 * CALLER DECREF: pObPfnMap
 * -- dwPfnStart = starting PFN. PFN = physical address / 0x1000.
 * -- cPfn
@@ -108,7 +111,8 @@ BOOL MmPfn_Map_GetPfn(_In_ DWORD dwPfnStart, _In_ DWORD cPfn, _Out_ PMMPFNOB_MAP
 
 /*
 * Retrieve information about scattered PFNs. The PFNs are returned in order of
-* in which they are stored in the psPfn set.
+* in which they are stored in the psPfn set. PFNs in blocks already cached by
+* MmPfn_Map_GetPfn are copied from the cache.
 * NB! POB_SET does not support ZERO, for PFN zero use 0x80000000'00000000.
 * CALLER DECREF: pObPfnMap
 * -- psPfn = Set of PFNs. PFN = physical address / 0x1000.
@@ -6,6 +6,7 @@
 #include "vmm.h"
 #include "mm.h"
 #include "vmmwindef.h"
+#include "vmmwin.h"
 
 #define MMVAD_POOLTAG_VAD       'Vad '
 #define MMVAD_POOLTAG_VADF      'VadF'
@@ -379,6 +380,119 @@ VOID VmmVad_MemMapVad_CloseObCallback(_In_ PVOID pVmmOb)
     LocalFree(pOb->wszMultiText);
 }
 
+// ----------------------------------------------------------------------------
+// INCREMENTAL VAD MAP:
+// The raw VAD nodes of each VAD map build are saved in the persistent process
+// data together with the resulting map. When the VAD map is rebuilt after a
+// process refresh the previous VAD nodes are re-read in one batch (they are
+// prefetched anyway) and compared to the saved nodes. If no node has changed
+// the previous map object (including its text) is re-used as-is. Otherwise
+// the tree is spidered and file names of unchanged VADs are copied from the
+// previous map at text fetch - only changed VADs are resolved from memory.
+// ----------------------------------------------------------------------------
+
+#define MMVAD_INCREMENTAL_NODE_MAX      0x100
+
+typedef struct tdMMVAD_OB_INCREMENTAL {
+    OB ObHdr;
+    PVMMOB_MAP_VAD pObMap;          // resulting VAD map of the build
+    PVMMOB_MAP_VAD pObMapPrevious;  // previous VAD map with text (until text fetch of pObMap)
+    PDWORD piPrevious;              // per map entry: 1 + index of unchanged entry in pObMapPrevious (or 0)
+    DWORD cVads;                    // # VADs according to EPROCESS at time of build
+    DWORD cRoot;
+    QWORD vaRoot[3];
+    DWORD cbNode;
+    BYTE pbNode[];                  // raw VAD nodes (cbNode bytes per map entry)
+} MMVAD_OB_INCREMENTAL, *PMMVAD_OB_INCREMENTAL;
+
+VOID MmVad_Incremental_CloseObCallback(_In_ PVOID pOb)
+{
+    PMMVAD_OB_INCREMENTAL pi = (PMMVAD_OB_INCREMENTAL)pOb;
+    Ob_DECREF(pi->pObMap);
+    Ob_DECREF(pi->pObMapPrevious);
+}
+
+/*
+* Check whether all VAD nodes of a previous build are unchanged in memory. The
+* nodes should already be prefetched into the cache by the caller.
+* -- pSystemProcess
+* -- pi = previous build.
+* -- fVmmRead
+* -- return
+*/
+BOOL MmVad_Incremental_IsUnchanged(_In_ PVMM_PROCESS pSystemProcess, _In_ PMMVAD_OB_INCREMENTAL pi, _In_ QWORD fVmmRead)
+{
+    DWORD i;
+    BYTE pb[MMVAD_INCREMENTAL_NODE_MAX];
+    QWORD oNode = ctxVmm->f32 ? 8 : 0x10;
+    for(i = 0; i < pi->pObMap->cMap; i++) {
+        if(!VmmRead2(pSystemProcess, pi->pObMap->pMap[i].vaVad - oNode, pb, pi->cbNode, fVmmRead | VMM_FLAG_FORCECACHE_READ)) { return FALSE; }
+        if(memcmp(pb, pi->pbNode + (QWORD)i * pi->cbNode, pi->cbNode)) { return FALSE; }
+    }
+    return TRUE;
+}
+
+/*
+* Create the incremental object of a new VAD map build by reading the raw VAD
+* nodes of the map and matching them against the previous build (if any).
+* -- pSystemProcess
+* -- pmVad = the new VAD map.
+* -- piPrev = previous build (if any).
+* -- cVads
+* -- cRoot
+* -- pvaRoot
+* -- cbNode
+* -- fVmmRead
+* -- return = incremental object of the new build or NULL on fail.
+*/
+PMMVAD_OB_INCREMENTAL MmVad_Incremental_New(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMMOB_MAP_VAD pmVad, _In_opt_ PMMVAD_OB_INCREMENTAL piPrev, _In_ DWORD cVads, _In_ DWORD cRoot, _In_reads_(cRoot) PQWORD pvaRoot, _In_ DWORD cbNode, _In_ QWORD fVmmRead)
+{
+    DWORD i, cReuse = 0;
+    PBYTE pbNode;
+    PVMM_MAP_VADENTRY pePrev;
+    PMMVAD_OB_INCREMENTAL pi;
+    QWORD oNode = ctxVmm->f32 ? 8 : 0x10;
+    if(!(pi = Ob_Alloc(OB_TAG_MAP_VAD_INCREMENTAL, LMEM_ZEROINIT, sizeof(MMVAD_OB_INCREMENTAL) + (QWORD)pmVad->cMap * (cbNode + sizeof(DWORD)), MmVad_Incremental_CloseObCallback, NULL))) { return NULL; }
+    pi->cVads = cVads;
+    pi->cRoot = cRoot;
+    memcpy(pi->vaRoot, pvaRoot, cRoot * sizeof(QWORD));
+    pi->cbNode = cbNode;
+    pi->piPrevious = (PDWORD)(pi->pbNode + (QWORD)pmVad->cMap * cbNode);
+    for(i = 0; i < pmVad->cMap; i++) {
+        pbNode = pi->pbNode + (QWORD)i * cbNode;
+        if(!VmmRead2(pSystemProcess, pmVad->pMap[i].vaVad - oNode, pbNode, cbNode, fVmmRead | VMM_FLAG_FORCECACHE_READ)) { continue; }
+        // unchanged entry in previous map with text?
+        if(piPrev && piPrev->pObMap->wszMultiText && (piPrev->cbNode == cbNode) && (pePrev = VmmMap_GetVadEntry(piPrev->pObMap, pmVad->pMap[i].vaStart))) {
+            if((pePrev->vaStart == pmVad->pMap[i].vaStart) && (pePrev->vaVad == pmVad->pMap[i].vaVad) && !memcmp(pbNode, piPrev->pbNode + (pePrev - piPrev->pObMap->pMap) * cbNode, cbNode)) {
+                pi->piPrevious[i] = 1 + (DWORD)(pePrev - piPrev->pObMap->pMap);
+                cReuse++;
+            }
+        }
+    }
+    if(cReuse) {
+        pi->pObMapPrevious = Ob_INCREF(piPrev->pObMap);
+    }
+    pi->pObMap = Ob_INCREF(pmVad);
+    return pi;
+}
+
+/*
+* Retrieve the unchanged previous VAD entry of a map entry if the previous
+* entry has a fully resolved file name which may be re-used as-is.
+* -- pmPrev
+* -- piPrevious
+* -- i = index of entry in new map.
+* -- return
+*/
+PVMM_MAP_VADENTRY MmVad_Incremental_PreviousEntry(_In_opt_ PVMMOB_MAP_VAD pmPrev, _In_opt_ PDWORD piPrevious, _In_ QWORD i)
+{
+    PVMM_MAP_VADENTRY pePrev;
+    if(!pmPrev || !piPrevious || !piPrevious[i]) { return NULL; }
+    pePrev = pmPrev->pMap + piPrevious[i] - 1;
+    if(!(pePrev->fFile || pePrev->fImage) || !pePrev->cwszText || (pePrev->wszText == pmPrev->wszMultiText)) { return NULL; }
+    return pePrev;
+}
+
 // ----------------------------------------------------------------------------
 // IMPLEMENTATION OF VAD PARSING FUNCTIONALITY FOR DIFFERENT WINDOWS VERSIONS:
 // ----------------------------------------------------------------------------
@@ -686,11 +800,12 @@ PVMM_MAP_VADENTRY MmVad_Spider_MMVAD64_10(_In_ PVMM_PROCESS pSystemProcess, _In_
 VOID MmVad_Spider_DoWork(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pProcess, _In_ QWORD fVmmRead)
 {
     BOOL f;
-    QWORD i, va;
-    DWORD cMax, cVads, dwFlagsBitMask = 0;
+    QWORD i, va, vaRoot[3];
+    DWORD cMax, cVads, cRoot = 0, cbNode, dwFlagsBitMask = 0;
     PVMM_MAP_VADENTRY eVad;
     PVMMOB_MAP_VAD pmObVad = NULL, pmObVadTemp;
     POB_SET psObAll = NULL, psObTry1 = NULL, psObTry2 = NULL, psObPrefetch = NULL;
+    PMMVAD_OB_INCREMENTAL piObPrev = NULL, piObNext = NULL;
     PVMM_MAP_VADENTRY(*pfnMmVad_Spider)(PVMM_PROCESS, QWORD, PVMMOB_MAP_VAD, POB_SET, POB_SET, POB_SET, QWORD, DWORD);
     if(!(ctxVmm->tpSystem == VMM_SYSTEM_WINDOWS_X64 || ctxVmm->tpSystem == VMM_SYSTEM_WINDOWS_X86)) { goto fail; }
     // 1: retrieve # of VAD entries and sanity check.
@@ -729,11 +844,13 @@ VOID MmVad_Spider_DoWork(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pPr
         va -= ctxVmm->f32 ? 8 : 0x10;
         ObSet_Push(psObAll, va);
         ObSet_Push(psObTry2, va);
+        vaRoot[cRoot++] = va;
     }
     if(!ObSet_Size(psObTry2)) { goto fail; }
     if(ctxVmm->kernel.dwVersionBuild >= 9600) {
         // Win8.1 and later
         pfnMmVad_Spider = ctxVmm->f32 ? MmVad_Spider_MMVAD32_10 : MmVad_Spider_MMVAD64_10;
+        cbNode = ctxVmm->f32 ? sizeof(_MMVAD32_10) : sizeof(_MMVAD64_10);
         if(ctxVmm->kernel.dwVersionBuild >= 18362) {    // bitmask offset for empty:PrivateMemory:Protection:VadType
             dwFlagsBitMask = 0x00140704;
         } else if(ctxVmm->kernel.dwVersionBuild >= 17134) {
@@ -744,18 +861,33 @@ VOID MmVad_Spider_DoWork(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pPr
     } else if(ctxVmm->kernel.dwVersionBuild >= 9200) {
         // Win8.0
         pfnMmVad_Spider = ctxVmm->f32 ? MmVad_Spider_MMVAD32_80 : MmVad_Spider_MMVAD64_80;
+        cbNode = ctxVmm->f32 ? sizeof(_MMVAD32_80) : sizeof(_MMVAD64_80);
     } else if(ctxVmm->kernel.dwVersionBuild >= 6000) {
         // WinVista :: Win7
         pfnMmVad_Spider = ctxVmm->f32 ? MmVad_Spider_MMVAD32_7 : MmVad_Spider_MMVAD64_7;
+        cbNode = ctxVmm->f32 ? sizeof(_MMVAD32_7) : sizeof(_MMVAD64_7);
     } else {
         // WinXP
         pfnMmVad_Spider = MmVad_Spider_MMVAD32_XP;
+        cbNode = sizeof(_MMVAD32_XP);
     }
     // 4: cache: prefetch previous addresses
     if((psObPrefetch = ObContainer_GetOb(pProcess->pObPersistent->pObCMapVadPrefetch))) {
         VmmCachePrefetchPages3(pSystemProcess, psObPrefetch, sizeof(_MMVAD64_10), fVmmRead);
         Ob_DECREF_NULL(&psObPrefetch);
     }
+    // 4.1: incremental: re-use previous map (incl. text) if no vad node is
+    //      changed. not for cloned processes since they share the persistent
+    //      data with their parent.
+    if(!pProcess->pObProcessCloneParent && (cbNode <= MMVAD_INCREMENTAL_NODE_MAX)) {
+        piObPrev = (PMMVAD_OB_INCREMENTAL)ObContainer_GetOb(pProcess->pObPersistent->pObCMapVadIncremental);
+        if(piObPrev && (piObPrev->cVads == cVads) && (piObPrev->pObMap->cMap == cVads) && (piObPrev->cbNode == cbNode) && piObPrev->pObMap->wszMultiText) {
+            if((piObPrev->cRoot == cRoot) && !memcmp(piObPrev->vaRoot, vaRoot, cRoot * sizeof(QWORD)) && MmVad_Incremental_IsUnchanged(pSystemProcess, piObPrev, fVmmRead)) {
+                pProcess->Map.pObVad = Ob_INCREF(piObPrev->pObMap);
+                goto fail;
+            }
+        }
+    }
     // 5: spider vad tree in an efficient way (minimize non-cached reads)
     while((pmObVad->cMap < cMax) && ObSet_Size(psObTry2)) {
         // fetch vad entries 2nd attempt
@@ -791,8 +923,16 @@ VOID MmVad_Spider_DoWork(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pPr
         memcpy(((POB_DATA)pmObVad)->pb, ((POB_DATA)pmObVadTemp)->pb, pmObVad->ObHdr.cbData);
         Ob_DECREF_NULL(&pmObVadTemp);
     }
+    // 9: incremental: save raw vad nodes for change detection at next build
+    if(!pProcess->pObProcessCloneParent && (cbNode <= MMVAD_INCREMENTAL_NODE_MAX)) {
+        if((piObNext = MmVad_Incremental_New(pSystemProcess, pmObVad, piObPrev, cVads, cRoot, vaRoot, cbNode, fVmmRead))) {
+            ObContainer_SetOb(pProcess->pObPersistent->pObCMapVadIncremental, piObNext);
+        }
+    }
     pProcess->Map.pObVad = Ob_INCREF(pmObVad);
 fail:
+    Ob_DECREF(piObPrev);
+    Ob_DECREF(piObNext);
     Ob_DECREF(pmObVad);
     Ob_DECREF(psObAll);
     Ob_DECREF(psObTry1);
@@ -817,27 +957,47 @@ VOID MmVad_TextFetch(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pProces
     BYTE pb[MAX_PATH*2+2], *pb2;
     PQWORD pva = NULL;
     LPWSTR wszMultiText = NULL;
-    QWORD i, j, va, cVads = 0;
-    PVMM_MAP_VADENTRY pVad, *ppVads;
+    QWORD i, j, va, cVads = 0, cReuse = 0;
+    PVMM_MAP_VADENTRY pVad, pePrev, *ppVads = NULL;
+    PVMMWIN_OB_OBJECTNAME *ppObName = NULL;
     PVMMOB_MAP_HEAP pObHeapMap = NULL;
     PVMMOB_MAP_THREAD pObThreadMap = NULL;
+    PVMMOB_MAP_VAD pmObPrev = NULL;
+    PDWORD piPrevious = NULL;
+    PMMVAD_OB_INCREMENTAL piOb = NULL;
     VmmMap_GetThreadAsync(pProcess);        // thread map async initialization to speed up later retrieval.
+    // incremental: retrieve previous map with unchanged vad entries (if any).
+    // the previous map is only required until text is fetched - release it.
+    if(!pProcess->pObProcessCloneParent && (piOb = (PMMVAD_OB_INCREMENTAL)ObContainer_GetOb(pProcess->pObPersistent->pObCMapVadIncremental))) {
+        if(piOb->pObMap == pProcess->Map.pObVad) {
+            pmObPrev = (PVMMOB_MAP_VAD)InterlockedExchangePointer((PVOID*)&piOb->pObMapPrevious, NULL);
+            piPrevious = piOb->piPrevious;
+        }
+    }
     // count max potential vads and allocate.
     {
         for(i = 0, cMax = pProcess->Map.pObVad->cMap; i < cMax; i++) {
             va = pProcess->Map.pObVad->pMap[i].vaSubsection;
             if(VMM_KADDR_4_8(va)) {
+                if((pePrev = MmVad_Incremental_PreviousEntry(pmObPrev, piPrevious, i))) {
+                    cReuse++;
+                    cwszMultiText += pePrev->cwszText + 1;
+                    continue;
+                }
                 cVads++;
             }
         }
-        if(!cVads || !(pva = LocalAlloc(LMEM_ZEROINIT, cVads * 0x18))) { goto fail; }
-        ppVads = (PVMM_MAP_VADENTRY*)(pva + 2 * cVads);
+        if(!(cVads + cReuse) || (cVads && !(pva = LocalAlloc(LMEM_ZEROINIT, cVads * 0x20)))) { goto fail; }
+        if(cVads) {
+            ppVads = (PVMM_MAP_VADENTRY*)(pva + 2 * cVads);
+            ppObName = (PVMMWIN_OB_OBJECTNAME*)(pva + 3 * cVads);
+        }
     }
-    // get subsection addresses from vad.
+    // get subsection addresses from vad (excluding re-used entries).
     {
         for(i = 0, j = 0, cMax = pProcess->Map.pObVad->cMap; (i < cMax) && (j < cVads); i++) {
             va = pProcess->Map.pObVad->pMap[i].vaSubsection;
-            if(VMM_KADDR_4_8(va)) {
+            if(VMM_KADDR_4_8(va) && !MmVad_Incremental_PreviousEntry(pmObPrev, piPrevious, i)) {
                 ppVads[j] = pProcess->Map.pObVad->pMap + i;
                 pva[j++] = va;
             }
@@ -885,6 +1045,16 @@ VOID MmVad_TextFetch(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pProces
         pb2 = pb + (f32 ? 0x30 : 0x58);     // pb2 = offset into _FILE_OBJECT.FileName _UNICODE_STRING (pb)
         VmmCachePrefetchPages4(pSystemProcess, (DWORD)cVads, pva, 0x68, fVmmRead);
         for(i = 0, va = 0; i < cVads; i++) {
+            // file name may already be resolved by the object name cache (from handles)
+            if(pva[i] && (ppObName[i] = VmmWinHandle_ObjectNameGet(pva[i]))) {
+                if(ppObName[i]->cwszText && ((ppObName[i]->e.dwPoolTag & 0x00ffffff) == 'liF')) {
+                    ppVads[i]->cwszText = min(0xff, ppObName[i]->cwszText);
+                    cwszMultiText += ppVads[i]->cwszText + 1;
+                    pva[i] = 0;
+                    continue;
+                }
+                Ob_DECREF_NULL(&ppObName[i]);
+            }
             // fetch _FILE_OBJECT
             f = pva[i] &&
                 VmmRead2(pSystemProcess, pva[i], pb, 0x68, fVmmRead | VMM_FLAG_FORCECACHE_READ) &&
@@ -913,7 +1083,12 @@ VOID MmVad_TextFetch(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pProces
         VmmCachePrefetchPages4(pSystemProcess, (DWORD)cVads * 2, pva, MAX_PATH * 2, fVmmRead);
         for(i = 0; i < cVads; i++) {
             // _UNICODE_STRING.Buffer
-            f = pva[i] && VmmRead2(pSystemProcess, pva[i], (PBYTE)(wszMultiText + oMultiText), ppVads[i]->cwszText << 1, fVmmRead | VMM_FLAG_FORCECACHE_READ);
+            if(ppObName[i]) {
+                memcpy(wszMultiText + oMultiText, ppObName[i]->wszText, (SIZE_T)ppVads[i]->cwszText << 1);
+                f = TRUE;
+            } else {
+                f = pva[i] && VmmRead2(pSystemProcess, pva[i], (PBYTE)(wszMultiText + oMultiText), ppVads[i]->cwszText << 1, fVmmRead | VMM_FLAG_FORCECACHE_READ);
+            }
             if(f) {
                 ppVads[i]->wszText = wszMultiText + oMultiText;
                 oMultiText += 1 + ppVads[i]->cwszText;
@@ -922,6 +1097,21 @@ VOID MmVad_TextFetch(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pProces
             }
         }
     }
+    // [ incremental: re-use file name of unchanged vads from previous map ]
+    if(cReuse) {
+        for(i = 0, cMax = pProcess->Map.pObVad->cMap; i < cMax; i++) {
+            if(!VMM_KADDR_4_8(pProcess->Map.pObVad->pMap[i].vaSubsection) || !(pePrev = MmVad_Incremental_PreviousEntry(pmObPrev, piPrevious, i))) { continue; }
+            pVad = pProcess->Map.pObVad->pMap + i;
+            pVad->fFile = pePrev->fFile;
+            pVad->fImage = pePrev->fImage;
+            pVad->fPageFile = pePrev->fPageFile;
+            pVad->vaFileObject = pePrev->vaFileObject;
+            pVad->cwszText = pePrev->cwszText;
+            memcpy(wszMultiText + oMultiText, pePrev->wszText, (SIZE_T)pVad->cwszText << 1);
+            pVad->wszText = wszMultiText + oMultiText;
+            oMultiText += 1 + pVad->cwszText;
+        }
+    }
     // [ heap map parse ]
     if(pObHeapMap) {
         for(i = 0; i < pObHeapMap->cMap; i++) {
@@ -968,8 +1158,15 @@ VOID MmVad_TextFetch(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pProces
     fResult = TRUE;
 fail:
     if(!fResult) { LocalFree(wszMultiText); }
+    Ob_DECREF(pmObPrev);
+    Ob_DECREF(piOb);
     Ob_DECREF(pObThreadMap);
     Ob_DECREF(pObHeapMap);
+    if(ppObName) {
+        for(i = 0; i < cVads; i++) {
+            Ob_DECREF(ppObName[i]);
+        }
+    }
     LocalFree(pva);
 }
 
@@ -986,6 +1183,95 @@ BOOL MmVad_PrototypePteArray_FetchNew_PoolHdrVerify(_In_ PBYTE pb, _In_ DWORD cb
     return FALSE;
 }
 
+/*
+* Evict prototype pte arrays from the cache until cbExtra additional bytes fits
+* within the memory budget (second-chance clock, see VmmCacheClockEvict).
+* NB! caller must hold ctxVmm->CachePrototypePte.Lock.
+* -- cbExtra
+*/
+VOID MmVad_PrototypePteCache_EvictBudget(_In_ QWORD cbExtra)
+{
+    DWORD cEvict;
+    cEvict = VmmCacheClockEvict(ctxVmm->Cache.pmPrototypePte, ctxVmm->CachePrototypePte.psReferenced, &ctxVmm->CachePrototypePte.iClock, &ctxVmm->CachePrototypePte.cb, ctxVmm->CachePrototypePte.cbMax, cbExtra, VMM_CACHE_PROTOTYPEPTE_CB_OVERHEAD);
+    InterlockedAdd64(&ctxVmm->stat.cCachePrototypePteEvict, cEvict);
+}
+
+/*
+* Insert a prototype pte array into the budgeted cache.
+* -- vaPrototypePte
+* -- e
+*/
+VOID MmVad_PrototypePteCache_Push(_In_ QWORD vaPrototypePte, _In_ POB_DATA e)
+{
+    QWORD cb = VMM_CACHE_PROTOTYPEPTE_CB_OVERHEAD + e->ObHdr.cbData;
+    if(!ctxVmm->CachePrototypePte.fInitialized) { return; }
+    EnterCriticalSection(&ctxVmm->CachePrototypePte.Lock);
+    if(!ObMap_ExistsKey(ctxVmm->Cache.pmPrototypePte, vaPrototypePte)) {
+        MmVad_PrototypePteCache_EvictBudget(cb);
+        if(ObMap_Push(ctxVmm->Cache.pmPrototypePte, vaPrototypePte, e)) {
+            ctxVmm->CachePrototypePte.cb += cb;
+        }
+    }
+    LeaveCriticalSection(&ctxVmm->CachePrototypePte.Lock);
+}
+
+/*
+* Retrieve a prototype pte array from the budgeted cache and mark it as
+* recently used.
+* CALLER DECREF: return
+* -- vaPrototypePte
+* -- return
+*/
+POB_DATA MmVad_PrototypePteCache_Get(_In_ QWORD vaPrototypePte)
+{
+    POB_DATA e;
+    if((e = ObMap_GetByKey(ctxVmm->Cache.pmPrototypePte, vaPrototypePte))) {
+        ObSet_Push(ctxVmm->CachePrototypePte.psReferenced, vaPrototypePte);
+    }
+    return e;
+}
+
+VOID MmVad_PrototypePteCache_Initialize()
+{
+    if(!(ctxVmm->CachePrototypePte.psReferenced = ObSet_New())) { return; }
+    InitializeCriticalSection(&ctxVmm->CachePrototypePte.Lock);
+    ctxVmm->CachePrototypePte.cbMax = (QWORD)(ctxMain->cfg.cMBCachePrototypePte ? ctxMain->cfg.cMBCachePrototypePte : VMM_CACHE_PROTOTYPEPTE_MB_DEFAULT) << 20;
+    ctxVmm->CachePrototypePte.fInitialized = TRUE;
+}
+
+VOID MmVad_PrototypePteCache_Close()
+{
+    if(!ctxVmm->CachePrototypePte.fInitialized) { return; }
+    ctxVmm->CachePrototypePte.fInitialized = FALSE;
+    Ob_DECREF_NULL(&ctxVmm->CachePrototypePte.psReferenced);
+    DeleteCriticalSection(&ctxVmm->CachePrototypePte.Lock);
+}
+
+_Success_(return)
+BOOL MmVad_PrototypePteCache_Configure(_In_ DWORD cMB)
+{
+    if(!ctxVmm->CachePrototypePte.fInitialized) { return FALSE; }
+    EnterCriticalSection(&ctxVmm->CachePrototypePte.Lock);
+    ctxVmm->CachePrototypePte.cbMax = (QWORD)(cMB ? cMB : VMM_CACHE_PROTOTYPEPTE_MB_DEFAULT) << 20;
+    MmVad_PrototypePteCache_EvictBudget(0);
+    LeaveCriticalSection(&ctxVmm->CachePrototypePte.Lock);
+    return TRUE;
+}
+
+/*
+* Release memory held by the prototype pte array cache under memory pressure.
+* -- cb = number of bytes to release.
+*/
+VOID MmVad_PrototypePteCache_Shrink(_In_ QWORD cb)
+{
+    QWORD cbCache;
+    if(!ctxVmm->CachePrototypePte.fInitialized) { return; }
+    EnterCriticalSection(&ctxVmm->CachePrototypePte.Lock);
+    cbCache = min(ctxVmm->CachePrototypePte.cb, ctxVmm->CachePrototypePte.cbMax);
+    MmVad_PrototypePteCache_EvictBudget(ctxVmm->CachePrototypePte.cbMax - cbCache + cb);
+    LeaveCriticalSection(&ctxVmm->CachePrototypePte.Lock);
+}
+
 /*
 * Fetch an array of prototype pte's into the cache.
 * -- pSystemProcess
@@ -1027,7 +1313,7 @@ VOID MmVad_PrototypePteArray_FetchNew(_In_ PVMM_PROCESS pSystemProcess, _In_ PVM
         e = Ob_Alloc('MmSt', 0, sizeof(OB), NULL, NULL);
     }
     if(e) {
-        ObMap_Push(ctxVmm->Cache.pmPrototypePte, pVad->vaPrototypePte, e);
+        MmVad_PrototypePteCache_Push(pVad->vaPrototypePte, e);
         Ob_DECREF(e);
     }
     LocalFree(pbData);
@@ -1050,12 +1336,17 @@ POB_DATA MmVad_PrototypePteArray_Get(_In_ PVMM_PROCESS pProcess, _In_ PVMM_MAP_V
     PVMM_PROCESS pObSystemProcess = NULL;
     PVMMOB_MAP_VAD pVadMap;
     if(!pVad->vaPrototypePte || !pVad->cbPrototypePte) { return NULL; }
-    if((e = ObMap_GetByKey(ctxVmm->Cache.pmPrototypePte, pVad->vaPrototypePte))) { return e; }
+    if((e = MmVad_PrototypePteCache_Get(pVad->vaPrototypePte))) {
+        InterlockedIncrement64(&ctxVmm->stat.cCachePrototypePteHit);
+        return e;
+    }
     EnterCriticalSection(&pProcess->LockUpdate);
-    if((e = ObMap_GetByKey(ctxVmm->Cache.pmPrototypePte, pVad->vaPrototypePte))) {
+    if((e = MmVad_PrototypePteCache_Get(pVad->vaPrototypePte))) {
         LeaveCriticalSection(&pProcess->LockUpdate);
+        InterlockedIncrement64(&ctxVmm->stat.cCachePrototypePteHit);
         return e;
     }
+    InterlockedIncrement64(&ctxVmm->stat.cCachePrototypePteMiss);
     if((pObSystemProcess = VmmProcessGet(4))) {
         if(!pProcess->Map.pObVad->fSpiderPrototypePte && pVad->cbPrototypePte < 0x1000 && (psObPrefetch = ObSet_New())) {
             pVadMap = pProcess->Map.pObVad;
@@ -1082,7 +1373,7 @@ POB_DATA MmVad_PrototypePteArray_Get(_In_ PVMM_PROCESS pProcess, _In_ PVMM_MAP_V
         Ob_DECREF(pObSystemProcess);
     }
     LeaveCriticalSection(&pProcess->LockUpdate);
-    return ObMap_GetByKey(ctxVmm->Cache.pmPrototypePte, pVad->vaPrototypePte);
+    return MmVad_PrototypePteCache_Get(pVad->vaPrototypePte);
 }
 
 
@@ -62,8 +62,24 @@ typedef struct tdMMWIN_MEMCOMPRESS_CONTEXT {
     QWORD vaSmGlobals;
     QWORD vaKeyToStoreTree;
     MMWIN_MEMCOMPRESS_OFFSET O;
+    POB_MAP pmObStore;          // resolved SmkmStore metadata by store index (PMMWIN_OB_MEMCOMPRESS_STORE)
 } MMWIN_MEMCOMPRESS_CONTEXT, *PMMWIN_MEMCOMPRESS_CONTEXT;
 
+#define MMWIN_PFBATCH_PARALLEL_MIN                  4
+#define MMWIN_PFBATCH_PARALLEL_THREADS              8
+
+// resolved and validated SmkmStore metadata - shared by all compressed pages
+// in the same store. re-read after MMWIN_MEMCOMPRESS_STORE_MAX_AGE_MS.
+#define MMWIN_MEMCOMPRESS_STORE_MAX_AGE_MS          1000
+
+typedef struct tdMMWIN_OB_MEMCOMPRESS_STORE {
+    OB ObHdr;
+    QWORD tcCreateTime;
+    QWORD vaSmkmStore;
+    QWORD vaEPROCESS;
+    BYTE pbSmkm[0x2000];
+} MMWIN_OB_MEMCOMPRESS_STORE, *PMMWIN_OB_MEMCOMPRESS_STORE;
+
 typedef struct tdMMWIN_CONTEXT {
     CRITICAL_SECTION Lock;
     FILE *pPageFile[10];
@@ -622,6 +638,7 @@ typedef struct tdMMWINX64_COMPRESS_CONTEXT {
         QWORD vaSmkmStore;
         QWORD vaEPROCESS;
         QWORD vaOwnerEPROCESS;
+        BOOL fSmkmCached;                   // vaSmkmStore, vaEPROCESS and pbSmkm from store cache
         BYTE pbSmkm[0x2000];
         DWORD dwRegionKey;
         QWORD vaPageRecord;
@@ -759,8 +776,8 @@ BOOL MmWin_MemCompress3_SmkmStoreAndPageRecord32(_In_ PMMWINX64_COMPRESS_CONTEXT
     DWORD i, dwEncodedMetadata, iChunkPtr = 0, iChunkArray, dwPoolHdr = 0;
     P_SMHP_CHUNK_METADATA32 pc;
     PMMWIN_MEMCOMPRESS_OFFSET po = &((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.O;
-    // 1: Load SmkmStore
-    if(!VmmRead2(ctx->pSystemProcess, ctx->e.vaSmkmStore, ctx->e.pbSmkm, sizeof(ctx->e.pbSmkm), ctx->fVmmRead)) {
+    // 1: Load SmkmStore (if not cached)
+    if(!ctx->e.fSmkmCached && !VmmRead2(ctx->pSystemProcess, ctx->e.vaSmkmStore, ctx->e.pbSmkm, sizeof(ctx->e.pbSmkm), ctx->fVmmRead)) {
         return MmWin_MemCompress_LogError(ctx, "#31 ReadSmkmStore");
     }
     // 2: Validate
@@ -821,8 +838,8 @@ BOOL MmWin_MemCompress3_SmkmStoreAndPageRecord64(_In_ PMMWINX64_COMPRESS_CONTEXT
     DWORD i, dwEncodedMetadata, iChunkPtr = 0, iChunkArray, dwPoolHdr = 0;
     P_SMHP_CHUNK_METADATA64 pc;
     PMMWIN_MEMCOMPRESS_OFFSET po = &((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.O;
-    // 1: Load SmkmStore
-    if(!VmmRead2(ctx->pSystemProcess, ctx->e.vaSmkmStore, ctx->e.pbSmkm, sizeof(ctx->e.pbSmkm), ctx->fVmmRead)) {
+    // 1: Load SmkmStore (if not cached)
+    if(!ctx->e.fSmkmCached && !VmmRead2(ctx->pSystemProcess, ctx->e.vaSmkmStore, ctx->e.pbSmkm, sizeof(ctx->e.pbSmkm), ctx->fVmmRead)) {
         return MmWin_MemCompress_LogError(ctx, "#31 ReadSmkmStore");
     }
     // 2: Validate
@@ -947,6 +964,44 @@ BOOL MmWin_MemCompress5_DecompressPage(_In_ PMMWINX64_COMPRESS_CONTEXT ctx, _Out
     return TRUE;
 }
 
+/*
+* Retrieve the SmkmStore metadata of the store index from the store cache.
+* -- ctx
+* -- return = TRUE if the metadata was retrieved from cache.
+*/
+BOOL MmWin_MemCompress_StoreCacheGet(_In_ PMMWINX64_COMPRESS_CONTEXT ctx)
+{
+    PMMWIN_OB_MEMCOMPRESS_STORE pObStore;
+    if(!(pObStore = ObMap_GetByKey(((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.pmObStore, ctx->e.iSmkm))) { return FALSE; }
+    if(pObStore->tcCreateTime + MMWIN_MEMCOMPRESS_STORE_MAX_AGE_MS > GetTickCount64()) {
+        ctx->e.vaSmkmStore = pObStore->vaSmkmStore;
+        ctx->e.vaEPROCESS = pObStore->vaEPROCESS;
+        memcpy(ctx->e.pbSmkm, pObStore->pbSmkm, sizeof(ctx->e.pbSmkm));
+        ctx->e.fSmkmCached = TRUE;
+    }
+    Ob_DECREF(pObStore);
+    return ctx->e.fSmkmCached;
+}
+
+/*
+* Store validated SmkmStore metadata in the store cache.
+* -- ctx
+*/
+VOID MmWin_MemCompress_StoreCachePut(_In_ PMMWINX64_COMPRESS_CONTEXT ctx)
+{
+    POB_MAP pmObStore = ((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.pmObStore;
+    PMMWIN_OB_MEMCOMPRESS_STORE pObStore;
+    if(ctx->e.fSmkmCached || !pmObStore) { return; }
+    if(!(pObStore = Ob_Alloc(OB_TAG_MM_MEMCOMPRESS_STORE, 0, sizeof(MMWIN_OB_MEMCOMPRESS_STORE), NULL, NULL))) { return; }
+    pObStore->tcCreateTime = GetTickCount64();
+    pObStore->vaSmkmStore = ctx->e.vaSmkmStore;
+    pObStore->vaEPROCESS = ctx->e.vaEPROCESS;
+    memcpy(pObStore->pbSmkm, ctx->e.pbSmkm, sizeof(pObStore->pbSmkm));
+    Ob_DECREF(ObMap_RemoveByKey(pmObStore, ctx->e.iSmkm));
+    ObMap_Push(pmObStore, ctx->e.iSmkm, pObStore);
+    Ob_DECREF(pObStore);
+}
+
 /*
 * Decompress a page.
 * -- pProcess
@@ -975,7 +1030,7 @@ BOOL MmWin_MemCompress(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD
             (ctx->pSystemProcess = pObSystemProcess = VmmProcessGet(4)) &&
             (ctx->pProcessMemCompress = pObMemCompressProcess = VmmProcessGet(((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.dwPid)) &&
             MmWin_MemCompress1_SmkmStoreIndex(ctx) &&
-            MmWin_MemCompress2_SmkmStoreMetadata32(ctx) &&
+            (MmWin_MemCompress_StoreCacheGet(ctx) || MmWin_MemCompress2_SmkmStoreMetadata32(ctx)) &&
             MmWin_MemCompress3_SmkmStoreAndPageRecord32(ctx) &&
             MmWin_MemCompress4_CompressedRegionData(ctx) &&
             MmWin_MemCompress5_DecompressPage(ctx, pbPage);
@@ -987,11 +1042,14 @@ BOOL MmWin_MemCompress(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD
             (ctx->pSystemProcess = pObSystemProcess = VmmProcessGet(4)) &&
             (ctx->pProcessMemCompress = pObMemCompressProcess = VmmProcessGet(((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.dwPid)) &&
             MmWin_MemCompress1_SmkmStoreIndex(ctx) &&
-            MmWin_MemCompress2_SmkmStoreMetadata64(ctx) &&
+            (MmWin_MemCompress_StoreCacheGet(ctx) || MmWin_MemCompress2_SmkmStoreMetadata64(ctx)) &&
             MmWin_MemCompress3_SmkmStoreAndPageRecord64(ctx) &&
             MmWin_MemCompress4_CompressedRegionData(ctx) &&
             MmWin_MemCompress5_DecompressPage(ctx, pbPage);
     }
+    if(fResult) {
+        MmWin_MemCompress_StoreCachePut(ctx);
+    }
 fail:
     LocalFree(ctx);
     Ob_DECREF(pObSystemProcess);
@@ -1019,11 +1077,35 @@ BOOL MmWin_PfReadFile(_In_ DWORD dwPfNumber, _In_ DWORD dwPfOffset, _Out_writes_
     return cb == 0x1000;
 }
 
+/*
+* Update the paging cache (or failed paging cache) with the result of a read.
+* -- pte
+* -- pbPage
+* -- fResult
+* -- return = fResult
+*/
+BOOL MmWin_PfReadFinish(_In_ QWORD pte, _In_reads_(4096) PBYTE pbPage, _In_ BOOL fResult)
+{
+    PVMMOB_MEM pObCacheEntry;
+    if(fResult) {
+        if((pObCacheEntry = VmmCacheReserve(VMM_CACHE_TAG_PAGING))) {
+            pObCacheEntry->h.f = TRUE;
+            pObCacheEntry->h.qwA = pte;
+            memcpy(pObCacheEntry->pb, pbPage, 0x1000);
+            VmmCacheReserveReturn(pObCacheEntry);
+        }
+        return TRUE;
+    }
+    ObSet_Push(ctxVmm->Cache.PAGING_FAILED, pte);
+    return FALSE;
+}
+
 _Success_(return)
-BOOL MmWin_PfRead(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte, _In_ QWORD fVmmRead, _In_ DWORD dwPfNumber, _In_ DWORD dwPfOffset, _Out_writes_(4096) PBYTE pbPage)
+BOOL MmWin_PfRead(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte, _In_ QWORD fVmmRead, _In_ DWORD dwPfNumber, _In_ DWORD dwPfOffset, _Out_writes_(4096) PBYTE pbPage, _Inout_opt_ PVMM_PAGING_BATCH pBatch)
 {
     BOOL fResult;
     PVMMOB_MEM pObCacheEntry;
+    PVMM_PAGING_BATCH_ENTRY pe;
     // cached page?
     if((pObCacheEntry = VmmCacheGet(VMM_CACHE_TAG_PAGING, pte))) {
         memcpy(pbPage, pObCacheEntry->pb, 0x1000);
@@ -1041,6 +1123,21 @@ BOOL MmWin_PfRead(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte,
     if(!ctxVmm->pMmContext || (dwPfNumber >= 10)) { return FALSE; }
     // dispatch to page file or compressed virtual store
     if(((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.fValid && (dwPfNumber == ((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.dwPageFileNumber)) {
+        // defer decompression to batch (if possible) - decompressed in
+        // parallel by the caller in MmWin_PfReadBatch.
+        if(pBatch && pBatch->pMEMCurrent && (pBatch->c < pBatch->cMax)) {
+            pe = pBatch->e + pBatch->c++;
+            pe->fCompressed = TRUE;
+            pe->dwPfNumber = dwPfNumber;
+            pe->dwPfOffset = dwPfOffset;
+            pe->pte = pte;
+            pe->pbPage = pbPage;
+            pe->pMEM = pBatch->pMEMCurrent;
+            pe->pProcess = pProcess;
+            pe->va = va;
+            pe->fVmmRead = fVmmRead;
+            return TRUE;
+        }
         fResult = MmWin_MemCompress(pProcess, va, pte, pbPage, fVmmRead);
         if(fResult) {
             InterlockedIncrement64(&ctxVmm->stat.page.cCompressed);
@@ -1048,6 +1145,18 @@ BOOL MmWin_PfRead(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte,
             InterlockedIncrement64(&ctxVmm->stat.page.cFailCompressed);
         }
     } else {
+        // defer page file read to batch (if possible) - completed by the
+        // caller in MmWin_PfReadBatch.
+        if(pBatch && pBatch->pMEMCurrent && (pBatch->c < pBatch->cMax) && ((PMMWIN_CONTEXT)ctxVmm->pMmContext)->pPageFile[dwPfNumber]) {
+            pe = pBatch->e + pBatch->c++;
+            pe->fCompressed = FALSE;
+            pe->dwPfNumber = dwPfNumber;
+            pe->dwPfOffset = dwPfOffset;
+            pe->pte = pte;
+            pe->pbPage = pbPage;
+            pe->pMEM = pBatch->pMEMCurrent;
+            return TRUE;
+        }
         fResult = MmWin_PfReadFile(dwPfNumber, dwPfOffset, pbPage);
         if(fResult) {
             InterlockedIncrement64(&ctxVmm->stat.page.cPageFile);
@@ -1055,18 +1164,92 @@ BOOL MmWin_PfRead(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte,
             InterlockedIncrement64(&ctxVmm->stat.page.cFailPageFile);
         }
     }
-    // update cache
-    if(fResult) {
-        if((pObCacheEntry = VmmCacheReserve(VMM_CACHE_TAG_PAGING))) {
-            pObCacheEntry->h.f = TRUE;
-            pObCacheEntry->h.qwA = pte;
-            memcpy(pObCacheEntry->pb, pbPage, 0x1000);
-            VmmCacheReserveReturn(pObCacheEntry);
+    return MmWin_PfReadFinish(pte, pbPage, fResult);
+}
+
+int MmWin_PfReadBatch_CmpSort(PVMM_PAGING_BATCH_ENTRY a, PVMM_PAGING_BATCH_ENTRY b)
+{
+    if(a->fCompressed != b->fCompressed) { return a->fCompressed ? 1 : -1; }
+    if(a->dwPfNumber != b->dwPfNumber) { return (a->dwPfNumber < b->dwPfNumber) ? -1 : 1; }
+    if(a->dwPfOffset != b->dwPfOffset) { return (a->dwPfOffset < b->dwPfOffset) ? -1 : 1; }
+    return 0;
+}
+
+VOID MmWin_PfReadBatch_Compressed_Item(_In_ PVMM_PAGING_BATCH_ENTRY peBatch, _In_ DWORD i)
+{
+    PVMM_PAGING_BATCH_ENTRY pe = peBatch + i;
+    pe->pMEM->f = MmWin_MemCompress(pe->pProcess, pe->va, pe->pte, pe->pbPage, pe->fVmmRead);
+    if(pe->pMEM->f) {
+        InterlockedIncrement64(&ctxVmm->stat.page.cCompressed);
+    } else {
+        InterlockedIncrement64(&ctxVmm->stat.page.cFailCompressed);
+    }
+}
+
+/*
+* Decompress batched compressed pages. Larger batches are decompressed in
+* parallel on the work thread pool. The calling thread takes part itself and
+* only waits for pages already in progress by other threads.
+* -- pe
+* -- c
+*/
+VOID MmWin_PfReadBatch_Compressed(_Inout_updates_(c) PVMM_PAGING_BATCH_ENTRY pe, _In_ DWORD c)
+{
+    VmmWorkParallel(c, (c >= MMWIN_PFBATCH_PARALLEL_MIN) ? MMWIN_PFBATCH_PARALLEL_THREADS : 0, (VOID(*)(PVOID, DWORD))MmWin_PfReadBatch_Compressed_Item, pe);
+}
+
+/*
+* Complete page file reads and decompressions deferred into a batch. The page
+* file reads are sorted on page file and offset and read in one pass per page
+* file - seeks only take place between non-adjacent pages which allows the C
+* runtime to read ahead. Reads of the same page file offset are only read once.
+* Compressed pages are sorted last and decompressed by MmWin_PfReadBatch_Compressed.
+* -- pBatch
+*/
+VOID MmWin_PfReadBatch(_Inout_ PVMM_PAGING_BATCH pBatch)
+{
+    PMMWIN_CONTEXT ctx = (PMMWIN_CONTEXT)ctxVmm->pMmContext;
+    DWORD i, iCompressed, cPageFile = 0, cFailPageFile = 0;
+    BOOL fResult = FALSE;
+    FILE *hFile;
+    QWORD qwOffsetNext = (QWORD)-1;
+    PVMM_PAGING_BATCH_ENTRY pe, pePrev = NULL;
+    if(!ctx || !pBatch->c) { return; }
+    qsort(pBatch->e, pBatch->c, sizeof(VMM_PAGING_BATCH_ENTRY), (_CoreCrtNonSecureSearchSortCompareFunction)MmWin_PfReadBatch_CmpSort);
+    // 1: page file reads
+    EnterCriticalSection(&ctx->Lock);
+    for(i = 0; (i < pBatch->c) && !pBatch->e[i].fCompressed; i++) {
+        pe = pBatch->e + i;
+        if(pePrev && (pePrev->dwPfNumber == pe->dwPfNumber) && (pePrev->dwPfOffset == pe->dwPfOffset)) {
+            // same page as previous - copy result
+            if(fResult) { memcpy(pe->pbPage, pePrev->pbPage, 0x1000); }
+        } else {
+            if(pePrev && (pePrev->dwPfNumber != pe->dwPfNumber)) { qwOffsetNext = (QWORD)-1; }
+            hFile = ctx->pPageFile[pe->dwPfNumber];
+            fResult = (qwOffsetNext == ((QWORD)pe->dwPfOffset << 12)) || !_fseeki64(hFile, (QWORD)pe->dwPfOffset << 12, SEEK_SET);
+            fResult = fResult && (0x1000 == fread(pe->pbPage, 1, 0x1000, hFile));
+            qwOffsetNext = fResult ? (((QWORD)pe->dwPfOffset + 1) << 12) : (QWORD)-1;
         }
-        return TRUE;
+        pe->pMEM->f = fResult;
+        if(fResult) { cPageFile++; } else { cFailPageFile++; }
+        pePrev = pe;
     }
-    ObSet_Push(ctxVmm->Cache.PAGING_FAILED, pte);
-    return FALSE;
+    LeaveCriticalSection(&ctx->Lock);
+    InterlockedAdd64(&ctxVmm->stat.page.cPageFile, cPageFile);
+    InterlockedAdd64(&ctxVmm->stat.page.cFailPageFile, cFailPageFile);
+    // 2: compressed pages
+    iCompressed = i;
+    if(iCompressed < pBatch->c) {
+        MmWin_PfReadBatch_Compressed(pBatch->e + iCompressed, pBatch->c - iCompressed);
+    }
+    // 3: update paging cache
+    for(i = 0; i < pBatch->c; i++) {
+        pe = pBatch->e + i;
+        if((i == 0) || (pe->pte != pBatch->e[i - 1].pte)) {
+            MmWin_PfReadFinish(pe->pte, pe->pbPage, pe->pMEM->f);
+        }
+    }
+    pBatch->c = 0;
 }
 
 
@@ -1102,10 +1285,11 @@ fail:
 * -- pte
 * -- pbPage
 * -- ppa
+* -- pBatch = optional batch to defer page file reads into.
 * -- return
 */
 _Success_(return)
-BOOL MmWinX86_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ DWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _In_ QWORD flags)
+BOOL MmWinX86_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ DWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _Inout_opt_ PVMM_PAGING_BATCH pBatch, _In_ QWORD flags)
 {
     BOOL f;
     DWORD dwPfNumber, dwPfOffset;
@@ -1149,7 +1333,7 @@ BOOL MmWinX86_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ DWOR
             *ppa = pte & 0xfffff000;
             return FALSE;
         }
-        return MmWinX86_ReadPaged(pProcess, va, pte, pbPage, ppa, flags | VMM_FLAG_NOVAD);
+        return MmWinX86_ReadPaged(pProcess, va, pte, pbPage, ppa, pBatch, flags | VMM_FLAG_NOVAD);
     }
     if(!pte || !pbPage) { return FALSE; }
     // demand zero virtual memory [ nt!_MMPTE_SOFTWARE ]
@@ -1159,7 +1343,7 @@ BOOL MmWinX86_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ DWOR
         return TRUE;
     }
     // retrive from page file or compressed store
-    return MmWin_PfRead(pProcess, va, pte, flags, dwPfNumber, dwPfOffset, pbPage);
+    return MmWin_PfRead(pProcess, va, pte, flags, dwPfNumber, dwPfOffset, pbPage, pBatch);
 fail:
     InterlockedIncrement64(&ctxVmm->stat.page.cFail);
     return FALSE;
@@ -1199,10 +1383,11 @@ fail:
 * -- pte
 * -- pbPage
 * -- ppa
+* -- pBatch = optional batch to defer page file reads into.
 * -- return
 */
 _Success_(return)
-BOOL MmWinX86PAE_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _In_ QWORD flags)
+BOOL MmWinX86PAE_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _Inout_opt_ PVMM_PAGING_BATCH pBatch, _In_ QWORD flags)
 {
     BOOL f;
     DWORD dwPfNumber, dwPfOffset;
@@ -1246,7 +1431,7 @@ BOOL MmWinX86PAE_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ Q
             *ppa = pte & 0x0000003f'fffff000;
             return FALSE;
         }
-        return MmWinX86PAE_ReadPaged(pProcess, va, pte, pbPage, ppa, flags | VMM_FLAG_NOVAD);
+        return MmWinX86PAE_ReadPaged(pProcess, va, pte, pbPage, ppa, pBatch, flags | VMM_FLAG_NOVAD);
     }
     if(!pte || !pbPage) { return FALSE; }
     // demand zero virtual memory [ nt!_MMPTE_SOFTWARE ]
@@ -1256,7 +1441,7 @@ BOOL MmWinX86PAE_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ Q
         return TRUE;
     }
     // retrive from page file or compressed store
-    return MmWin_PfRead(pProcess, va, pte, flags, dwPfNumber, dwPfOffset, pbPage);
+    return MmWin_PfRead(pProcess, va, pte, flags, dwPfNumber, dwPfOffset, pbPage, pBatch);
 fail:
     InterlockedIncrement64(&ctxVmm->stat.page.cFail);
     return FALSE;
@@ -1296,11 +1481,12 @@ fail:
 * -- pte
 * -- pbPage
 * -- ppa
+* -- pBatch = optional batch to defer page file reads into.
 * -- flags
 * -- return
 */
 _Success_(return)
-BOOL MmWinX64_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _In_ QWORD flags)
+BOOL MmWinX64_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _Inout_opt_ PVMM_PAGING_BATCH pBatch, _In_ QWORD flags)
 {
     BOOL f;
     DWORD dwPfNumber, dwPfOffset;
@@ -1344,7 +1530,7 @@ BOOL MmWinX64_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWOR
             *ppa = pte & 0x0000ffff'fffff000;
             return FALSE;
         }
-        return MmWinX64_ReadPaged(pProcess, va, pte, pbPage, ppa, flags | VMM_FLAG_NOVAD);
+        return MmWinX64_ReadPaged(pProcess, va, pte, pbPage, ppa, pBatch, flags | VMM_FLAG_NOVAD);
     }
     if(!pte || !pbPage) { return FALSE; }
     // demand zero virtual memory [ nt!_MMPTE_SOFTWARE ]
@@ -1354,7 +1540,7 @@ BOOL MmWinX64_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWOR
         return TRUE;
     }
     // retrive from page file or compressed store
-    return MmWin_PfRead(pProcess, va, pte, flags, dwPfNumber, dwPfOffset, pbPage);
+    return MmWin_PfRead(pProcess, va, pte, flags, dwPfNumber, dwPfOffset, pbPage, pBatch);
 fail:
     InterlockedIncrement64(&ctxVmm->stat.page.cFail);
     return FALSE;
@@ -1376,6 +1562,7 @@ VOID MmWin_PagingClose()
                 fclose(ctx->pPageFile[i]);
             }
         }
+        Ob_DECREF(ctx->MemCompress.pmObStore);
         LocalFree(ctx);
     }
 }
@@ -1390,19 +1577,21 @@ VOID MmWin_PagingInitialize(_In_ BOOL fModeFull)
             ctxVmm->fnMemoryModel.pfnPagedRead = MmWinX64_ReadPaged;
             break;
         case VMM_MEMORYMODEL_X86PAE:
-            ctxVmm->fnMemoryModel.pfnPagedRead = (BOOL(*)(PVMM_PROCESS, QWORD, QWORD, PBYTE, PQWORD, QWORD))MmWinX86PAE_ReadPaged;
+            ctxVmm->fnMemoryModel.pfnPagedRead = (BOOL(*)(PVMM_PROCESS, QWORD, QWORD, PBYTE, PQWORD, PVMM_PAGING_BATCH, QWORD))MmWinX86PAE_ReadPaged;
             break;
         case VMM_MEMORYMODEL_X86:
-            ctxVmm->fnMemoryModel.pfnPagedRead = (BOOL(*)(PVMM_PROCESS, QWORD, QWORD, PBYTE, PQWORD, QWORD))MmWinX86_ReadPaged;
+            ctxVmm->fnMemoryModel.pfnPagedRead = (BOOL(*)(PVMM_PROCESS, QWORD, QWORD, PBYTE, PQWORD, PVMM_PAGING_BATCH, QWORD))MmWinX86_ReadPaged;
             break;
         default:
             return;
     }
+    ctxVmm->fnMemoryModel.pfnPagedReadBatch = MmWin_PfReadBatch;
     // 2: Initialize Page Files (if any)
     if(!ctx) {
         ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(MMWIN_CONTEXT));
         if(!ctx) { return; }
         InitializeCriticalSection(&ctx->Lock);
+        ctx->MemCompress.pmObStore = ObMap_New(OB_MAP_FLAGS_OBJECT_OB);
         for(i = 0; i < 10; i++) {
             if(ctxMain->cfg.szPageFile[i][0]) {
                 if(fopen_s(&ctx->pPageFile[i], ctxMain->cfg.szPageFile[i], "rb")) {
@@ -5,10 +5,14 @@
 //
 #include "vmm.h"
 #include "vmmproc.h"
+#include "util.h"
+#include <intrin.h>
 
 #define MMX64_MEMMAP_DISPLAYBUFFER_LINE_LENGTH      89
 #define MMX64_PTE_IS_TRANSITION(pte, iPML)          ((((pte & 0x0c01) == 0x0800) && (iPML == 1) && ctxVmm && (ctxVmm->tpSystem == VMM_SYSTEM_WINDOWS_X64)) ? ((pte & 0xffffdfff'fffff000) | 0x005) : 0)
 #define MMX64_PTE_IS_VALID(pte, iPML)               (pte & 0x01)
+#define MMX64_TLBSPIDER_PARALLEL_MIN                4
+#define MMX64_TLBSPIDER_PARALLEL_THREADS            8
 
 /*
 * Tries to verify that a loaded page table is correct. If just a bit strange
@@ -49,6 +53,105 @@ BOOL MmX64_TlbPageTableVerify(_Inout_ PBYTE pb, _In_ QWORD pa, _In_ BOOL fSelfRe
     return TRUE;
 }
 
+typedef BOOL(*PMMX64_TLBPAGETABLEVERIFY)(_Inout_ PBYTE pb, _In_ QWORD pa, _In_ BOOL fSelfRefReq);
+
+/*
+* Vectorized scan of a page table page. Checks for valid PTEs pointing above
+* the physical address max and for a self-referencing entry in one pass.
+* -- ptes
+* -- pa
+* -- paMax
+* -- pfSelfRef
+* -- return = TRUE if no bad PTEs exist, FALSE if the scalar verify must run.
+*/
+BOOL MmX64_TlbPageTableVerify_ScanAVX2(_In_reads_(512) PQWORD ptes, _In_ QWORD pa, _In_ QWORD paMax, _Out_ PBOOL pfSelfRef)
+{
+    DWORD i;
+    __m256i v, vBad = _mm256_setzero_si256(), vSelf = _mm256_setzero_si256();
+    const __m256i vOne = _mm256_set1_epi64x(1);
+    const __m256i vMaskAddr = _mm256_set1_epi64x(0x000fffffffffffff);
+    const __m256i vMaskPage = _mm256_set1_epi64x(0x0000fffffffff000);
+    const __m256i vPaMax = _mm256_set1_epi64x(paMax);
+    const __m256i vPa = _mm256_set1_epi64x(pa);
+    for(i = 0; i < 512; i += 4) {
+        v = _mm256_loadu_si256((const __m256i*)(ptes + i));
+        // addresses are masked to 52 bits - signed compare is ok.
+        vBad = _mm256_or_si256(vBad, _mm256_and_si256(_mm256_cmpeq_epi64(_mm256_and_si256(v, vOne), vOne), _mm256_cmpgt_epi64(_mm256_and_si256(v, vMaskAddr), vPaMax)));
+        vSelf = _mm256_or_si256(vSelf, _mm256_cmpeq_epi64(_mm256_and_si256(v, vMaskPage), vPa));
+    }
+    *pfSelfRef = !_mm256_testz_si256(vSelf, vSelf);
+    return _mm256_testz_si256(vBad, vBad);
+}
+
+BOOL MmX64_TlbPageTableVerify_ScanSSE42(_In_reads_(512) PQWORD ptes, _In_ QWORD pa, _In_ QWORD paMax, _Out_ PBOOL pfSelfRef)
+{
+    DWORD i;
+    __m128i v, vBad = _mm_setzero_si128(), vSelf = _mm_setzero_si128();
+    const __m128i vOne = _mm_set1_epi64x(1);
+    const __m128i vMaskAddr = _mm_set1_epi64x(0x000fffffffffffff);
+    const __m128i vMaskPage = _mm_set1_epi64x(0x0000fffffffff000);
+    const __m128i vPaMax = _mm_set1_epi64x(paMax);
+    const __m128i vPa = _mm_set1_epi64x(pa);
+    for(i = 0; i < 512; i += 2) {
+        v = _mm_loadu_si128((const __m128i*)(ptes + i));
+        vBad = _mm_or_si128(vBad, _mm_and_si128(_mm_cmpeq_epi64(_mm_and_si128(v, vOne), vOne), _mm_cmpgt_epi64(_mm_and_si128(v, vMaskAddr), vPaMax)));
+        vSelf = _mm_or_si128(vSelf, _mm_cmpeq_epi64(_mm_and_si128(v, vMaskPage), vPa));
+    }
+    *pfSelfRef = !_mm_testz_si128(vSelf, vSelf);
+    return _mm_testz_si128(vBad, vBad);
+}
+
+/*
+* Verify a page table page using a vectorized scan. The common case of a page
+* without bad PTEs is fully handled by the scan. Otherwise the scalar verify
+* is used to clean up (or discard) the page.
+*/
+BOOL MmX64_TlbPageTableVerify_Vector(_Inout_ PBYTE pb, _In_ QWORD pa, _In_ BOOL fSelfRefReq, _In_ BOOL fAVX2)
+{
+    BOOL fOK, fSelfRef;
+    QWORD paMax;
+    if(!pb) { return FALSE; }
+    paMax = max(0xffffffff, ctxMain->dev.paMax);
+    fOK = fAVX2 ?
+        MmX64_TlbPageTableVerify_ScanAVX2((PQWORD)pb, pa, paMax, &fSelfRef) :
+        MmX64_TlbPageTableVerify_ScanSSE42((PQWORD)pb, pa, paMax, &fSelfRef);
+    if(!fOK || (fSelfRefReq && !fSelfRef)) {
+        return MmX64_TlbPageTableVerify(pb, pa, fSelfRefReq);
+    }
+    return TRUE;
+}
+
+BOOL MmX64_TlbPageTableVerify_AVX2(_Inout_ PBYTE pb, _In_ QWORD pa, _In_ BOOL fSelfRefReq)
+{
+    return MmX64_TlbPageTableVerify_Vector(pb, pa, fSelfRefReq, TRUE);
+}
+
+BOOL MmX64_TlbPageTableVerify_SSE42(_Inout_ PBYTE pb, _In_ QWORD pa, _In_ BOOL fSelfRefReq)
+{
+    return MmX64_TlbPageTableVerify_Vector(pb, pa, fSelfRefReq, FALSE);
+}
+
+/*
+* Select the fastest page table verify function supported by the CPU.
+* -- return
+*/
+PMMX64_TLBPAGETABLEVERIFY MmX64_TlbPageTableVerify_Select()
+{
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 0);
+    if(cpuInfo[0] >= 7) {
+        __cpuid(cpuInfo, 1);
+        // OSXSAVE && AVX && OS saves YMM state
+        if((cpuInfo[2] & (1 << 27)) && (cpuInfo[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6)) {
+            __cpuidex(cpuInfo, 7, 0);
+            if(cpuInfo[1] & (1 << 5)) { return MmX64_TlbPageTableVerify_AVX2; }
+        }
+    }
+    __cpuid(cpuInfo, 1);
+    if(cpuInfo[2] & (1 << 20)) { return MmX64_TlbPageTableVerify_SSE42; }
+    return MmX64_TlbPageTableVerify;
+}
+
 VOID MmX64_TlbSpider_Stage(_In_ QWORD pa, _In_ BYTE iPML, _In_ BOOL fUserOnly, _In_ POB_SET pPageSet)
 {
     QWORD i, pe;
@@ -74,6 +177,65 @@ VOID MmX64_TlbSpider_Stage(_In_ QWORD pa, _In_ BYTE iPML, _In_ BOOL fUserOnly, _
     Ob_DECREF(ptObMEM);
 }
 
+/*
+* Context for a parallel TLB spider. Top-level (PML4) subtrees are claimed by
+* the calling thread and by worker threads through VmmWorkParallel.
+*/
+typedef struct tdMMX64_TLBSPIDER_PARALLEL {
+    BOOL fUserOnly;
+    DWORD c;
+    QWORD pa[512];
+} MMX64_TLBSPIDER_PARALLEL, *PMMX64_TLBSPIDER_PARALLEL;
+
+/*
+* Spider a single PDPT subtree with its own prefetch set.
+*/
+VOID MmX64_TlbSpider_Subtree(_In_ QWORD paPDPT, _In_ BOOL fUserOnly)
+{
+    DWORD i;
+    POB_SET pObPageSet = NULL;
+    if(!(pObPageSet = ObSet_New())) { return; }
+    for(i = 0; i < 3; i++) {
+        MmX64_TlbSpider_Stage(paPDPT, 3, fUserOnly, pObPageSet);
+        if(!ObSet_Size(pObPageSet)) { break; }
+        VmmTlbPrefetch(pObPageSet);
+    }
+    Ob_DECREF(pObPageSet);
+}
+
+VOID MmX64_TlbSpider_Parallel_Item(_In_ PMMX64_TLBSPIDER_PARALLEL ctx, _In_ DWORD i)
+{
+    MmX64_TlbSpider_Subtree(ctx->pa[i], ctx->fUserOnly);
+}
+
+/*
+* Spider the PML4 subtrees in parallel on the work thread pool. The calling
+* thread takes part in the spidering itself and only waits for subtrees that
+* are already in progress by other threads - this prevents deadlocks if the
+* spider is called from within a work pool thread.
+* -- pProcess
+* -- pObPML4
+* -- return = TRUE if spidered in parallel, FALSE if too few subtrees exists.
+*/
+BOOL MmX64_TlbSpider_Parallel(_In_ PVMM_PROCESS pProcess, _In_ PVMMOB_MEM pObPML4)
+{
+    DWORD i;
+    QWORD pe;
+    MMX64_TLBSPIDER_PARALLEL ctx = { 0 };
+    if(!ctxVmm->Work.fEnabled) { return FALSE; }
+    ctx.fUserOnly = pProcess->fUserOnly;
+    for(i = 0; i < 512; i++) {
+        pe = pObPML4->pqw[i];
+        if(!(pe & 0x01)) { continue; }  // not valid
+        if(pe & 0x80) { continue; }     // not valid ptr to PDPT
+        if(ctx.fUserOnly && !(pe & 0x04)) { continue; }
+        ctx.pa[ctx.c++] = pe & 0x0000fffffffff000;
+    }
+    if(ctx.c < MMX64_TLBSPIDER_PARALLEL_MIN) { return FALSE; }
+    VmmWorkParallel(ctx.c, MMX64_TLBSPIDER_PARALLEL_THREADS, (VOID(*)(PVOID, DWORD))MmX64_TlbSpider_Parallel_Item, &ctx);
+    return TRUE;
+}
+
 /*
 * Iterate over PML4, PTPT, PD (3 times in total) to first stage uncached pages
 * and then commit them to the cache.
@@ -81,10 +243,18 @@ VOID MmX64_TlbSpider_Stage(_In_ QWORD pa, _In_ BYTE iPML, _In_ BOOL fUserOnly, _
 VOID MmX64_TlbSpider(_In_ PVMM_PROCESS pProcess)
 {
     DWORD i;
+    PVMMOB_MEM pObPML4 = NULL;
     POB_SET pObPageSet = NULL;
     if(pProcess->fTlbSpiderDone) { return; }
+    if((pObPML4 = VmmTlbGetPageTable(pProcess->paDTB, FALSE))) {
+        if(MmX64_TlbSpider_Parallel(pProcess, pObPML4)) {
+            pProcess->fTlbSpiderDone = TRUE;
+            Ob_DECREF(pObPML4);
+            return;
+        }
+        Ob_DECREF(pObPML4);
+    }
     if(!(pObPageSet = ObSet_New())) { return; }
-    Ob_DECREF(VmmTlbGetPageTable(pProcess->paDTB, FALSE));
     for(i = 0; i < 3; i++) {
         MmX64_TlbSpider_Stage(pProcess->paDTB, 4, pProcess->fUserOnly, pObPageSet);
         VmmTlbPrefetch(pObPageSet);
@@ -97,7 +267,146 @@ const QWORD MMX64_PAGETABLEMAP_PML_REGION_SIZE[5] = { 0, 12, 21, 30, 39 };
 const QWORD MMX64_PAGETABLEMAP_PML_REGION_MASK_PG[5] = { 0, 0x0000fffffffff000, 0x0000ffffffe00000, 0x0000ffffc0000000, 0 };
 const QWORD MMX64_PAGETABLEMAP_PML_REGION_MASK_AD[5] = { 0, 0xfff, 0x1fffff, 0x3fffffff, 0 };
 
-VOID MmX64_MapInitialize_Index(_In_ PVMM_PROCESS pProcess, _In_ PVMM_MAP_PTEENTRY pMemMap, _In_ PDWORD pcMemMap, _In_ QWORD vaBase, _In_ BYTE iPML, _In_ QWORD PTEs[512], _In_ BOOL fSupervisorPML, _In_ QWORD paMax)
+// ----------------------------------------------------------------------------
+// INCREMENTAL PTE MAP:
+// The PTE map is built one 1GB region (one page directory) at a time. The map
+// entries of each region are saved together with a hash of the page tables of
+// the region (PD + PTs) in the persistent process data. When the PTE map is
+// rebuilt after a process refresh only regions with changed page tables are
+// walked - entries of unchanged regions are copied from the previous build.
+// If the resulting map is identical to the previous map (including its text)
+// the previous map object is re-used as-is.
+// ----------------------------------------------------------------------------
+
+typedef struct tdMMX64_PTEMAP_REGION {
+    QWORD qwHash;                   // hash of PDPTE + supervisor flag + PD + PTs of the region
+    BOOL fFirstPagedOut;            // first page of the region is paged out
+    DWORD cMap;
+    VMM_MAP_PTEENTRY pMap[];        // region entries (non sign extended va)
+} MMX64_PTEMAP_REGION, *PMMX64_PTEMAP_REGION;
+
+typedef struct tdMMX64_OB_PTEMAP_INCREMENTAL {
+    OB ObHdr;
+    QWORD paDTB;
+    PVMMOB_MAP_PTE pObMap;          // resulting PTE map of the build
+    POB_MAP pmRegion;               // region va -> PMMX64_PTEMAP_REGION
+} MMX64_OB_PTEMAP_INCREMENTAL, *PMMX64_OB_PTEMAP_INCREMENTAL;
+
+typedef struct tdMMX64_PTEMAP_CONTEXT {
+    PMMX64_OB_PTEMAP_INCREMENTAL pPrev;     // previous build (if any)
+    PMMX64_OB_PTEMAP_INCREMENTAL pNext;     // current build (if any)
+    DWORD cRegionWalk;                      // # regions walked
+    DWORD cRegionReuse;                     // # regions re-used from previous build
+    BOOL fRegionFirstPagedOut;              // first page of the walked region is paged out
+} MMX64_PTEMAP_CONTEXT, *PMMX64_PTEMAP_CONTEXT;
+
+VOID MmX64_PteMapIncremental_CloseObCallback(_In_ PVOID pOb)
+{
+    PMMX64_OB_PTEMAP_INCREMENTAL pi = (PMMX64_OB_PTEMAP_INCREMENTAL)pOb;
+    Ob_DECREF(pi->pObMap);
+    Ob_DECREF(pi->pmRegion);
+}
+
+/*
+* Hash the page tables of a 1GB region. All PTs referenced by the PD are loaded
+* into the TLB cache - which a walk of a changed region would require anyway.
+* -- pObPD
+* -- pte = PDPTE of the region.
+* -- fSupervisorPML
+* -- return
+*/
+QWORD MmX64_MapInitialize_RegionHash(_In_ PVMMOB_MEM pObPD, _In_ QWORD pte, _In_ BOOL fSupervisorPML)
+{
+    DWORD i, j;
+    QWORD pde, qwHash = 0xcbf29ce484222325 ^ pte;
+    PVMMOB_MEM pObPT;
+    qwHash = (qwHash ^ (fSupervisorPML ? 1 : 0)) * 0x100000001b3;
+    for(i = 0; i < 512; i++) {
+        pde = pObPD->pqw[i];
+        qwHash = (qwHash ^ pde) * 0x100000001b3;
+        if(!(pde & 0x01) || (pde & 0x80)) { continue; }
+        if(!(pObPT = VmmTlbGetPageTable(pde & 0x0000fffffffff000, FALSE))) {
+            qwHash = (qwHash ^ 0xffffffffffffffff) * 0x100000001b3;
+            continue;
+        }
+        for(j = 0; j < 512; j++) {
+            qwHash = (qwHash ^ pObPT->pqw[j]) * 0x100000001b3;
+        }
+        Ob_DECREF(pObPT);
+    }
+    return qwHash;
+}
+
+VOID MmX64_MapInitialize_Index(_In_ PVMM_PROCESS pProcess, _In_opt_ PMMX64_PTEMAP_CONTEXT ctx, _In_ PVMM_MAP_PTEENTRY pMemMap, _In_ PDWORD pcMemMap, _In_ DWORD cMemMapMax, _In_ QWORD vaBase, _In_ BYTE iPML, _In_ QWORD PTEs[512], _In_ BOOL fSupervisorPML, _In_ QWORD paMax);
+
+/*
+* Add the map entries of a 1GB region (one page directory) to the map. The
+* entries are copied from the previous build if the region page tables are
+* unchanged - otherwise the region is walked. The first region entry is merged
+* with the last map entry using the same rule as the full walk: contiguous and
+* identical flags, or contiguous and a paged out first page. In the latter case
+* the flags of the following pages are compared against the last map entry -
+* the region is then walked in place on top of the map to match the full walk.
+*/
+VOID MmX64_MapInitialize_Region(_In_ PVMM_PROCESS pProcess, _In_ PMMX64_PTEMAP_CONTEXT ctx, _In_ PVMM_MAP_PTEENTRY pMemMap, _In_ PDWORD pcMemMap, _In_ DWORD cMemMapMax, _In_ QWORD va, _In_ QWORD pte, _In_ BOOL fSupervisorPML, _In_ QWORD paMax)
+{
+    DWORD c = 0, cMax = cMemMapMax - *pcMemMap;
+    QWORD qwHash;
+    PVMMOB_MEM pObPD;
+    PVMM_MAP_PTEENTRY pe, pePrev;
+    PMMX64_PTEMAP_REGION pr = NULL;
+    BOOL fFirstPagedOut;
+    if(!(pObPD = VmmTlbGetPageTable(pte & 0x0000fffffffff000, FALSE))) { return; }
+    qwHash = MmX64_MapInitialize_RegionHash(pObPD, pte, fSupervisorPML);
+    pe = pMemMap + *pcMemMap;
+    if(ctx->pPrev && (pr = ObMap_RemoveByKey(ctx->pPrev->pmRegion, va)) && (pr->qwHash == qwHash) && (pr->cMap < cMax)) {
+        // unchanged region -> re-use entries from previous build
+        c = pr->cMap;
+        fFirstPagedOut = pr->fFirstPagedOut;
+        memcpy(pe, pr->pMap, c * sizeof(VMM_MAP_PTEENTRY));
+        ctx->cRegionReuse++;
+    } else {
+        LocalFree(pr);
+        pr = NULL;
+        ctx->fRegionFirstPagedOut = FALSE;
+        MmX64_MapInitialize_Index(pProcess, ctx, pe, &c, cMax, va, 2, pObPD->pqw, fSupervisorPML, paMax);
+        fFirstPagedOut = ctx->fRegionFirstPagedOut;
+        if(ctx->pNext && (pr = LocalAlloc(0, sizeof(MMX64_PTEMAP_REGION) + c * sizeof(VMM_MAP_PTEENTRY)))) {
+            pr->qwHash = qwHash;
+            pr->fFirstPagedOut = fFirstPagedOut;
+            pr->cMap = c;
+            memcpy(pr->pMap, pe, c * sizeof(VMM_MAP_PTEENTRY));
+        }
+        ctx->cRegionWalk++;
+    }
+    if(pr && !(ctx->pNext && ObMap_Push(ctx->pNext->pmRegion, va, pr))) {
+        LocalFree(pr);
+    }
+    // merge first region entry with last map entry (if possible)
+    if(c && *pcMemMap) {
+        pePrev = pe - 1;
+        if(pePrev->vaBase + (pePrev->cPages << 12) == pe->vaBase) {
+            if(pePrev->fPage == pe->fPage) {
+                pePrev->cPages += pe->cPages;
+                pePrev->cSoftware += pe->cSoftware;
+                memmove(pe, pe + 1, (c - 1) * sizeof(VMM_MAP_PTEENTRY));
+                ZeroMemory(pe + c - 1, sizeof(VMM_MAP_PTEENTRY));
+                c--;
+            } else if(fFirstPagedOut) {
+                // paged out first page continues the last map entry -> walk
+                // the region in place so that its pages are compared against
+                // the last map entry just like in the full walk.
+                ZeroMemory(pe, c * sizeof(VMM_MAP_PTEENTRY));
+                c = 0;
+                MmX64_MapInitialize_Index(pProcess, ctx, pMemMap, pcMemMap, cMemMapMax, va, 2, pObPD->pqw, fSupervisorPML, paMax);
+            }
+        }
+    }
+    Ob_DECREF(pObPD);
+    *pcMemMap += c;
+}
+
+VOID MmX64_MapInitialize_Index(_In_ PVMM_PROCESS pProcess, _In_opt_ PMMX64_PTEMAP_CONTEXT ctx, _In_ PVMM_MAP_PTEENTRY pMemMap, _In_ PDWORD pcMemMap, _In_ DWORD cMemMapMax, _In_ QWORD vaBase, _In_ BYTE iPML, _In_ QWORD PTEs[512], _In_ BOOL fSupervisorPML, _In_ QWORD paMax)
 {
     PVMMOB_MEM pObNextPT;
     QWORD i, pte, va, cPages;
@@ -130,15 +439,16 @@ VOID MmX64_MapInitialize_Index(_In_ PVMM_PROCESS pProcess, _In_ PVMM_MAP_PTEENTR
             if((*pcMemMap == 0) ||
                 ((pMemMapEntry->fPage != (pte & VMM_MEMMAP_PAGE_MASK)) && !fPagedOut) ||
                 (va != pMemMapEntry->vaBase + (pMemMapEntry->cPages << 12))) {
-                if(*pcMemMap + 1 >= VMM_MEMMAP_ENTRIES_MAX) { return; }
+                if(*pcMemMap + 1 >= cMemMapMax) { return; }
                 pMemMapEntry = pMemMap + *pcMemMap;
                 pMemMapEntry->vaBase = va;
                 pMemMapEntry->fPage = pte & VMM_MEMMAP_PAGE_MASK;
                 cPages = 1ULL << (MMX64_PAGETABLEMAP_PML_REGION_SIZE[iPML] - 12);
                 if(fPagedOut) { pMemMapEntry->cSoftware += (DWORD)cPages; }
                 pMemMapEntry->cPages = cPages;
+                if(ctx && (*pcMemMap == 0)) { ctx->fRegionFirstPagedOut = fPagedOut; }
                 *pcMemMap = *pcMemMap + 1;
-                if(*pcMemMap >= VMM_MEMMAP_ENTRIES_MAX - 1) {
+                if(*pcMemMap >= cMemMapMax - 1) {
                     return;
                 }
                 continue;
@@ -155,14 +465,41 @@ VOID MmX64_MapInitialize_Index(_In_ PVMM_PROCESS pProcess, _In_ PVMM_MAP_PTEENTR
         }
         // maps page table (PDPT, PD, PT)
         fNextSupervisorPML = !(pte & 0x04);
+        if(ctx && (iPML == 3)) {
+            MmX64_MapInitialize_Region(pProcess, ctx, pMemMap, pcMemMap, cMemMapMax, va, pte, fNextSupervisorPML, paMax);
+            pMemMapEntry = pMemMap + *pcMemMap - 1;
+            if(*pcMemMap >= cMemMapMax - 1) { return; }
+            continue;
+        }
         pObNextPT = VmmTlbGetPageTable(pte & 0x0000fffffffff000, FALSE);
         if(!pObNextPT) { continue; }
-        MmX64_MapInitialize_Index(pProcess, pMemMap, pcMemMap, va, iPML - 1, pObNextPT->pqw, fNextSupervisorPML, paMax);
+        MmX64_MapInitialize_Index(pProcess, ctx, pMemMap, pcMemMap, cMemMapMax, va, iPML - 1, pObNextPT->pqw, fNextSupervisorPML, paMax);
         Ob_DECREF(pObNextPT);
         pMemMapEntry = pMemMap + *pcMemMap - 1;
     }
 }
 
+/*
+* Check whether a previous PTE map (with text) is identical to a new build.
+* -- pObMap
+* -- pMemMap
+* -- cMemMap
+* -- return
+*/
+BOOL MmX64_PteMapInitialize_IsEqual(_In_ PVMMOB_MAP_PTE pObMap, _In_ PVMM_MAP_PTEENTRY pMemMap, _In_ DWORD cMemMap)
+{
+    DWORD i;
+    PVMM_MAP_PTEENTRY pe;
+    if(!pObMap->fTagScan || (pObMap->cMap != cMemMap)) { return FALSE; }
+    for(i = 0; i < cMemMap; i++) {
+        pe = pObMap->pMap + i;
+        if((pe->vaBase != pMemMap[i].vaBase) || (pe->cPages != pMemMap[i].cPages) || (pe->fPage != pMemMap[i].fPage) || (pe->cSoftware != pMemMap[i].cSoftware)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
 _Success_(return)
 BOOL MmX64_PteMapInitialize(_In_ PVMM_PROCESS pProcess)
 {
@@ -171,6 +508,7 @@ BOOL MmX64_PteMapInitialize(_In_ PVMM_PROCESS pProcess)
     PVMMOB_MEM pObPML4;
     PVMM_MAP_PTEENTRY pMemMap = NULL;
     PVMMOB_MAP_PTE pObMap = NULL;
+    MMX64_PTEMAP_CONTEXT ctx = { 0 };
     // already existing?
     if(pProcess->Map.pObPte) { return TRUE; }
     EnterCriticalSection(&pProcess->LockUpdate);
@@ -178,12 +516,26 @@ BOOL MmX64_PteMapInitialize(_In_ PVMM_PROCESS pProcess)
         LeaveCriticalSection(&pProcess->LockUpdate);
         return TRUE;
     }
+    // retrieve previous build (if any) - not for cloned processes since they
+    // share the persistent data with their parent but may have other flags.
+    if(!pProcess->pObProcessCloneParent) {
+        ctx.pPrev = (PMMX64_OB_PTEMAP_INCREMENTAL)ObContainer_GetOb(pProcess->pObPersistent->pObCMapPteIncremental);
+        if(ctx.pPrev && (ctx.pPrev->paDTB != pProcess->paDTB)) {
+            Ob_DECREF_NULL(&ctx.pPrev);
+        }
+        if((ctx.pNext = Ob_Alloc(OB_TAG_MAP_PTE_INCREMENTAL, LMEM_ZEROINIT, sizeof(MMX64_OB_PTEMAP_INCREMENTAL), MmX64_PteMapIncremental_CloseObCallback, NULL))) {
+            ctx.pNext->paDTB = pProcess->paDTB;
+            if(!(ctx.pNext->pmRegion = ObMap_New(OB_MAP_FLAGS_OBJECT_LOCALFREE))) {
+                Ob_DECREF_NULL(&ctx.pNext);
+            }
+        }
+    }
     // allocate temporary buffer and walk page tables
     pObPML4 = VmmTlbGetPageTable(pProcess->paDTB, FALSE);
     if(pObPML4) {
         pMemMap = (PVMM_MAP_PTEENTRY)LocalAlloc(LMEM_ZEROINIT, VMM_MEMMAP_ENTRIES_MAX * sizeof(VMM_MAP_PTEENTRY));
         if(pMemMap) {
-            MmX64_MapInitialize_Index(pProcess, pMemMap, &cMemMap, 0, 4, pObPML4->pqw, FALSE, ctxMain->dev.paMax);
+            MmX64_MapInitialize_Index(pProcess, &ctx, pMemMap, &cMemMap, VMM_MEMMAP_ENTRIES_MAX, 0, 4, pObPML4->pqw, FALSE, ctxMain->dev.paMax);
             for(i = 0; i < cMemMap; i++) { // fixup sign extension for kernel addresses
                 if(pMemMap[i].vaBase & 0x0000800000000000) {
                     pMemMap[i].vaBase |= 0xffff000000000000;
@@ -192,12 +544,19 @@ BOOL MmX64_PteMapInitialize(_In_ PVMM_PROCESS pProcess)
         }
         Ob_DECREF(pObPML4);
     }
+    // re-use previous map object (incl. text) if nothing changed
+    if(pMemMap && ctx.pPrev && ctx.pPrev->pObMap && !ctx.cRegionWalk && MmX64_PteMapInitialize_IsEqual(ctx.pPrev->pObMap, pMemMap, cMemMap)) {
+        pObMap = Ob_INCREF(ctx.pPrev->pObMap);
+        goto finish;
+    }
     // allocate VmmOb depending on result
     pObMap = Ob_Alloc(OB_TAG_MAP_PTE, 0, sizeof(VMMOB_MAP_PTE) + cMemMap * sizeof(VMM_MAP_PTEENTRY), NULL, NULL);
     if(!pObMap) {
         pProcess->Map.pObPte = Ob_Alloc(OB_TAG_MAP_PTE, LMEM_ZEROINIT, sizeof(VMMOB_MAP_PTE), NULL, NULL);
         LeaveCriticalSection(&pProcess->LockUpdate);
         LocalFree(pMemMap);
+        Ob_DECREF(ctx.pPrev);
+        Ob_DECREF(ctx.pNext);
         return TRUE;
     }
     pObMap->wszMultiText = NULL;
@@ -205,14 +564,21 @@ BOOL MmX64_PteMapInitialize(_In_ PVMM_PROCESS pProcess)
     pObMap->fTagScan = FALSE;
     pObMap->cMap = cMemMap;
     memcpy(pObMap->pMap, pMemMap, cMemMap * sizeof(VMM_MAP_PTEENTRY));
+finish:
     LocalFree(pMemMap);
+    if(ctx.pNext) {
+        ctx.pNext->pObMap = Ob_INCREF(pObMap);
+        ObContainer_SetOb(pProcess->pObPersistent->pObCMapPteIncremental, ctx.pNext);
+    }
+    Ob_DECREF(ctx.pPrev);
+    Ob_DECREF(ctx.pNext);
     pProcess->Map.pObPte = pObMap;
     LeaveCriticalSection(&pProcess->LockUpdate);
     return TRUE;
 }
 
 _Success_(return)
-BOOL MmX64_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa)
+BOOL MmX64_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa, _Out_opt_ PQWORD pcbPage)
 {
     QWORD pte, i, qwMask;
     PVMMOB_MEM pObPTEs;
@@ -234,9 +600,82 @@ BOOL MmX64_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_
         *ppa = pte & 0x0000fffffffff000 & qwMask;           // MASK AWAY BITS FOR 4kB/2MB/1GB PAGES
         qwMask = qwMask ^ 0xffffffffffffffff;
         *ppa = *ppa | (qwMask & va);                        // FILL LOWER ADDRESS BITS
+        if(pcbPage) { *pcbPage = qwMask + 1; }
         return TRUE;
     }
-    return MmX64_Virt2Phys(pte, fUserOnly, iPML - 1, va, ppa);
+    return MmX64_Virt2Phys(pte, fUserOnly, iPML - 1, va, ppa, pcbPage);
+}
+
+/*
+* Prefetch all page tables required to translate a batch of virtual addresses.
+* The addresses are reduced to sorted unique 2MB regions and the page tables
+* are walked one level at a time for the whole batch. All page tables missing
+* from the TLB cache on a level are read in one single VmmTlbPrefetch call.
+* -- pProcess
+* -- cpMEMsVirt
+* -- ppMEMsVirt
+*/
+VOID MmX64_Virt2PhysPrefetch(_In_ PVMM_PROCESS pProcess, _In_ DWORD cpMEMsVirt, _In_reads_(cpMEMsVirt) PPMEM_SCATTER ppMEMsVirt)
+{
+    BYTE iPML;
+    DWORD i, c, cVA = 0;
+    QWORD pte, paLast;
+    PQWORD pqwVA = NULL, pqwPT;
+    PVMMOB_MEM pObPT = NULL;
+    POB_SET psObPrefetch = NULL;
+    if(!cpMEMsVirt || !(pqwVA = LocalAlloc(0, 2ULL * cpMEMsVirt * sizeof(QWORD)))) { goto fail; }
+    pqwPT = pqwVA + cpMEMsVirt;
+    // 1: reduce addresses to sorted unique 2MB regions (one region = one PT)
+    for(i = 0; i < cpMEMsVirt; i++) {
+        if(!ppMEMsVirt[i]->f && MEM_SCATTER_ADDR_ISVALID(ppMEMsVirt[i])) {
+            pqwVA[cVA++] = ppMEMsVirt[i]->qwA & ~0x1fffff;
+        }
+    }
+    qsort(pqwVA, cVA, sizeof(QWORD), Util_qsort_QWORD);
+    for(i = 0, c = 0; i < cVA; i++) {
+        if(!c || (pqwVA[i] != pqwVA[c - 1])) {
+            pqwVA[c++] = pqwVA[i];
+        }
+    }
+    if((cVA = c) < 2) { goto fail; }
+    if(!(psObPrefetch = ObSet_New())) { goto fail; }
+    for(i = 0; i < cVA; i++) {
+        pqwPT[i] = pProcess->paDTB & 0x0000fffffffff000;
+    }
+    // 2: walk page table levels PML4 -> PT for all regions at once
+    for(iPML = 4; iPML; iPML--) {
+        // stage page tables missing from the cache & read them in one go
+        for(i = 0, paLast = 0; i < cVA; i++) {
+            if(!pqwPT[i] || (pqwPT[i] == paLast)) { continue; }
+            paLast = pqwPT[i];
+            if(!VmmCacheExists(VMM_CACHE_TAG_TLB, paLast)) {
+                ObSet_Push(psObPrefetch, paLast);
+            }
+        }
+        if(ObSet_Size(psObPrefetch)) {
+            VmmTlbPrefetch(psObPrefetch);
+        }
+        if(iPML == 1) { break; }
+        // resolve page tables of the next level
+        for(i = 0, paLast = 0; i < cVA; i++) {
+            if(!pqwPT[i]) { continue; }
+            if(pqwPT[i] != paLast) {
+                Ob_DECREF(pObPT);
+                paLast = pqwPT[i];
+                pObPT = VmmTlbGetPageTable(paLast, TRUE);
+            }
+            pte = pObPT ? pObPT->pqw[0x1ff & (pqwVA[i] >> MMX64_PAGETABLEMAP_PML_REGION_SIZE[iPML])] : 0;
+            if(!(pte & 0x01) || (pte & 0x80) || (pte & 0x000f000000000000) || (pProcess->fUserOnly && !(pte & 0x04))) {
+                pqwPT[i] = 0;       // not valid / large page / supervisor page
+                continue;
+            }
+            pqwPT[i] = pte & 0x0000fffffffff000;
+        }
+        Ob_DECREF_NULL(&pObPT);
+    }
+fail:
+    Ob_DECREF(psObPrefetch);
+    LocalFree(pqwVA);
 }
 
 VOID MmX64_Virt2PhysGetInformation_DoWork(_Inout_ PVMM_PROCESS pProcess, _Inout_ PVMM_VIRT2PHYS_INFORMATION pVirt2PhysInfo, _In_ BYTE iPML, _In_ QWORD PTEs[512])
@@ -340,11 +779,28 @@ VOID MmX64_Initialize()
     }
     ctxVmm->fnMemoryModel.pfnClose = MmX64_Close;
     ctxVmm->fnMemoryModel.pfnVirt2Phys = MmX64_Virt2Phys;
+    ctxVmm->fnMemoryModel.pfnVirt2PhysPrefetch = MmX64_Virt2PhysPrefetch;
     ctxVmm->fnMemoryModel.pfnVirt2PhysGetInformation = MmX64_Virt2PhysGetInformation;
     ctxVmm->fnMemoryModel.pfnPhys2VirtGetInformation = MmX64_Phys2VirtGetInformation;
     ctxVmm->fnMemoryModel.pfnPteMapInitialize = MmX64_PteMapInitialize;
     ctxVmm->fnMemoryModel.pfnTlbSpider = MmX64_TlbSpider;
-    ctxVmm->fnMemoryModel.pfnTlbPageTableVerify = MmX64_TlbPageTableVerify;
+    ctxVmm->fnMemoryModel.pfnTlbPageTableVerify = MmX64_TlbPageTableVerify_Select();
     ctxVmm->tpMemoryModel = VMM_MEMORYMODEL_X64;
     ctxVmm->f32 = FALSE;
 }
+
+_Success_(return)
+BOOL MmX64_TlbPageTableVerifyConfigure(_In_ BOOL fVector)
+{
+    if(ctxVmm->tpMemoryModel != VMM_MEMORYMODEL_X64) { return FALSE; }
+    ctxVmm->fnMemoryModel.pfnTlbPageTableVerify = fVector ? MmX64_TlbPageTableVerify_Select() : MmX64_TlbPageTableVerify;
+    return TRUE;
+}
+
+_Success_(return)
+BOOL MmX64_TlbPageTableVerifyIsVector(_Out_ PBOOL pfVector)
+{
+    if(ctxVmm->tpMemoryModel != VMM_MEMORYMODEL_X64) { return FALSE; }
+    *pfVector = (ctxVmm->fnMemoryModel.pfnTlbPageTableVerify != MmX64_TlbPageTableVerify);
+    return TRUE;
+}
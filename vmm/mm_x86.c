@@ -146,7 +146,7 @@ BOOL MmX86_PteMapInitialize(_In_ PVMM_PROCESS pProcess)
 }
 
 _Success_(return)
-BOOL MmX86_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa)
+BOOL MmX86_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa, _Out_opt_ PQWORD pcbPage)
 {
     DWORD pte, i;
     PVMMOB_MEM pObPTEs;
@@ -165,15 +165,17 @@ BOOL MmX86_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_
     }
     if(fUserOnly && !(pte & 0x04)) { return FALSE; }        // SUPERVISOR PAGE & USER MODE REQ
     if((iPML == 2) && !(pte & 0x80) /* PS */) {
-        return MmX86_Virt2Phys(pte, fUserOnly, 1, va, ppa);
+        return MmX86_Virt2Phys(pte, fUserOnly, 1, va, ppa, pcbPage);
     }
     if(iPML == 1) { // 4kB PAGE
         *ppa = pte & 0xfffff000;
+        if(pcbPage) { *pcbPage = 0x1000; }
         return TRUE;
     }
     // 4MB PAGE
     if(pte & 0x003e0000) { return FALSE; }                  // RESERVED
     *ppa = (((QWORD)(pte & 0x0001e000)) << (32 - 13)) + (pte & 0xffc00000) + (va & 0x003ff000);
+    if(pcbPage) { *pcbPage = 0x00400000; }
     return TRUE;
 }
 
@@ -197,7 +197,7 @@ BOOL MmX86PAE_PteMapInitialize(_In_ PVMM_PROCESS pProcess)
 }
 
 _Success_(return)
-BOOL MmX86PAE_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa)
+BOOL MmX86PAE_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa, _Out_opt_ PQWORD pcbPage)
 {
     PBYTE pbPTEs;
     QWORD pte, i, qwMask;
@@ -218,7 +218,7 @@ BOOL MmX86PAE_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _I
         Ob_DECREF(pObPTEs);
         if(!(pte & 0x01)) { return FALSE; }                 // NOT VALID
         if(pte & 0xffff0000000001e6) { return FALSE; }      // RESERVED BITS IN PDPTE
-        return MmX86PAE_Virt2Phys(pte, fUserOnly, 2, va, ppa);
+        return MmX86PAE_Virt2Phys(pte, fUserOnly, 2, va, ppa, pcbPage);
     }
     // PT or PD
     pte = pObPTEs->pqw[i];
@@ -234,9 +234,10 @@ BOOL MmX86PAE_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _I
         *ppa = pte & 0x0000fffffffff000 & qwMask;           // MASK AWAY BITS FOR 4kB/2MB/1GB PAGES
         qwMask = qwMask ^ 0xffffffffffffffff;
         *ppa = *ppa | (qwMask & va);                        // FILL LOWER ADDRESS BITS
+        if(pcbPage) { *pcbPage = qwMask + 1; }
         return TRUE;
     }
-    return MmX86PAE_Virt2Phys(pte, fUserOnly, 1, va, ppa);
+    return MmX86PAE_Virt2Phys(pte, fUserOnly, 1, va, ppa, pcbPage);
 }
 
 VOID MmX86PAE_Virt2PhysGetInformation_DoWork(_Inout_ PVMM_PROCESS pProcess, _Inout_ PVMM_VIRT2PHYS_INFORMATION pVirt2PhysInfo, _In_ BYTE iPML, _In_ QWORD PTEs[512])
@@ -15,28 +15,46 @@ typedef unsigned __int64                QWORD, *PQWORD;
 #define OB_TAG_CORE_DATA                'ObDa'
 #define OB_TAG_CORE_SET                 'ObSe'
 #define OB_TAG_CORE_MAP                 'ObMa'
+#define OB_TAG_CORE_STRMAP              'ObSM'
+#define OB_TAG_FC_WINREG_PARALLEL       'FcRp'
 #define OB_TAG_MAP_PTE                  'Mpte'
+#define OB_TAG_MAP_PTE_INCREMENTAL      'MpIn'
 #define OB_TAG_MAP_VAD                  'Mvad'
+#define OB_TAG_MAP_VAD_INCREMENTAL      'MvIn'
 #define OB_TAG_MAP_MODULE               'Mmod'
 #define OB_TAG_MAP_THREAD               'Mthr'
 #define OB_TAG_MAP_HANDLE               'Mhnd'
+#define OB_TAG_MAP_ADDRESS              'Madr'
 #define OB_TAG_MAP_PHYSMEM              'Mmem'
 #define OB_TAG_MAP_USER                 'Musr'
 #define OB_TAG_MAP_NET                  'Mnet'
 #define OB_TAG_MAP_PFN                  'Mpfn'
+#define OB_TAG_MAP_PROCTREE             'Mptr'
+#define OB_TAG_MM_MEMCOMPRESS_STORE     'MmCs'
 #define OB_TAG_MOD_MINIDUMP_CTX         'mMDx'
+#define OB_TAG_MOD_SYSINFOPROC_TREE     'mSPt'
 #define OB_TAG_OBJ_ERROR                'Oerr'
 #define OB_TAG_OBJ_FILE                 'Ofil'
+#define OB_TAG_WIN_OBJECTNAME           'WoNm'
 #define OB_TAG_PDB_ENTRY                'PdbE'
+#define OB_TAG_PE_MODULECACHE           'PeMc'
+#define OB_TAG_PFN_BLOCK                'PfnB'
 #define OB_TAG_PFN_CONTEXT              'PfnC'
 #define OB_TAG_PFN_PROC_TABLE           'PfnT'
 #define OB_TAG_REG_HIVE                 'Rhve'
 #define OB_TAG_REG_KEY                  'Rkey'
 #define OB_TAG_REG_KEYVALUE             'Rval'
+#define OB_TAG_REG_PATHINDEX            'Ridx'
 #define OB_TAG_VMM_PROCESS              'Ps__'
 #define OB_TAG_VMM_PROCESS_CLONE        'PsC_'
 #define OB_TAG_VMM_PROCESS_PERSISTENT   'PsSt'
+#define OB_TAG_VMM_PHYS2VIRT_INDEX      'P2Vi'
+#define OB_TAG_VMM_PHYS2VIRT_PROCESS    'P2Vp'
 #define OB_TAG_VMM_PROCESSTABLE         'PsTb'
+#define OB_TAG_VMM_PAGEDIGEST           'PgDg'
+#define OB_TAG_VMM_WORK_FUTURE          'WkFu'
+#define OB_TAG_VMM_WORK_PARALLEL        'WkPa'
+#define OB_TAG_VMM_SNAPSHOT             'Snap'
 #define OB_TAG_VMMVFS_DUMPCONTEXT       'CDmp'
 
 // ----------------------------------------------------------------------------
@@ -122,6 +140,41 @@ inline VOID Ob_DECREF_NULL(_In_opt_ PVOID *ppOb)
 */
 BOOL Ob_VALID_TAG(_In_ PVOID pObIn, _In_ DWORD tag);
 
+/*
+* Release all memory cached in the object size class pools. Memory of objects
+* freed after this call will be cached anew.
+*/
+VOID Ob_PoolTrim();
+
+#define OB_ACCOUNTING_TAGS_MAX          0x100
+#define OB_ACCOUNTING_TAG_OVERFLOW      'Ovfl'      // tags not fitting in the accounting table
+
+typedef struct tdOB_ACCOUNTING_ENTRY {
+    DWORD tag;
+    DWORD _Filler;
+    QWORD c;                        // live objects
+    QWORD cb;                       // live bytes (objects + charged extra memory)
+} OB_ACCOUNTING_ENTRY, *POB_ACCOUNTING_ENTRY;
+
+/*
+* Charge (or uncharge if negative) extra memory owned by an object to the tag
+* of the object. Object allocations are charged automatically - this is for
+* memory allocated outside of Ob_Alloc but owned by an object. The owner must
+* uncharge the same amount when the memory is freed.
+* -- tag
+* -- cb
+*/
+VOID Ob_AccountingCharge(_In_ DWORD tag, _In_ LONG64 cb);
+
+/*
+* Retrieve a snapshot of the live object count and bytes per object tag.
+* At most OB_ACCOUNTING_TAGS_MAX + 1 entries (incl. overflow) are returned.
+* -- pe
+* -- cMax
+* -- return = number of entries written to pe.
+*/
+DWORD Ob_AccountingGet(_Out_writes_(cMax) POB_ACCOUNTING_ENTRY pe, _In_ DWORD cMax);
+
 
 
 // ----------------------------------------------------------------------------
@@ -209,6 +262,17 @@ typedef struct tdOB_SET *POB_SET;
 */
 POB_SET ObSet_New();
 
+#define OB_SET_FLAGS_NOLOCK             0x01    // unsynchronized - set must never be shared between threads
+
+/*
+* Create a new hashed value set with flags. OB_SET_FLAGS_NOLOCK skips all
+* internal locking and may only be used for sets private to one thread.
+* CALLER DECREF: return
+* -- flags = 0 or OB_SET_FLAGS_* flags.
+* -- return
+*/
+POB_SET ObSet_NewEx(_In_ QWORD flags);
+
 /*
 * Retrieve the number of items in the given ObSet.
 * -- pvs
@@ -330,6 +394,15 @@ QWORD ObSet_Get(_In_opt_ POB_SET pvs, _In_ DWORD index);
 */
 POB_DATA ObSet_GetAll(_In_opt_ POB_SET pvs);
 
+/*
+* Retrieve all values in the Set as a POB_DATA object containing the values
+* in a QWORD table sorted in ascending order.
+* -- CALLER DECREF: return
+* -- pvs
+* -- return
+*/
+POB_DATA ObSet_GetAllSorted(_In_opt_ POB_SET pvs);
+
 
 
 // ----------------------------------------------------------------------------
@@ -446,6 +519,15 @@ PVOID ObMap_RemoveByKey(_In_opt_ POB_MAP pm, _In_ QWORD qwKey);
 */
 VOID ObMap_Clear(_In_opt_ POB_MAP pm);
 
+/*
+* Freeze the map into a read-only state. Lookups of a frozen map take no lock
+* and all functions modifying the map will fail. The map is to be frozen
+* once fully built and before it's shared (e.g. published in an ObContainer).
+* A frozen map cannot be un-frozen.
+* -- pm
+*/
+VOID ObMap_Freeze(_In_opt_ POB_MAP pm);
+
 /*
 * Peek the "last" object.
 * CALLER DECREF(if OB): return
@@ -513,6 +595,18 @@ PVOID ObMap_GetByKey(_In_opt_ POB_MAP pm, _In_ QWORD qwKey);
 */
 PVOID ObMap_GetByIndex(_In_opt_ POB_MAP pm, _In_ DWORD index);
 
+/*
+* Retrieve an object and its key given an index (which is less than the amount
+* of items in the ObMap).
+* CALLER DECREF(if OB): return
+* -- pm
+* -- index
+* -- pKey
+* -- return
+*/
+_Success_(return != NULL)
+PVOID ObMap_GetByIndexWithKey(_In_opt_ POB_MAP pm, _In_ DWORD index, _Out_ PQWORD pKey);
+
 
 /*
 * Common filter function related to ObMap_FilterSet.
@@ -549,4 +643,53 @@ DWORD ObMap_RemoveByFilter(_In_opt_ POB_MAP pm, _In_opt_ BOOL(*pfnFilter)(_In_ Q
 
 
 
+// ----------------------------------------------------------------------------
+// STRMAP FUNCTIONALITY BELOW:
+//
+// The string map is used to build the multi-text string data of a map in a
+// single allocation with de-duplication of equal strings. Strings are pushed
+// together with a pointer to the string pointer in the map entry referencing
+// them - which is updated once the string map is finalized.
+// The ObStrMap is an object manager object and must be DECREF'ed when required.
+// ----------------------------------------------------------------------------
+
+typedef struct tdOB_STRMAP *POB_STRMAP;
+
+/*
+* Create a new string map.
+* CALLER DECREF: return
+* -- return
+*/
+POB_STRMAP ObStrMap_New();
+
+/*
+* Push a string into the string map. The string pointer pwszDst (and optional
+* length pcwszDst) is set to the string in the resulting multi-text when the
+* string map is finalized - until then it's set to NULL/0. The locations of
+* pwszDst/pcwszDst must stay valid until the string map is finalized.
+* Equal strings are de-duplicated. A NULL or zero-length string is set to the
+* empty string at the start of the multi-text.
+* -- psm
+* -- wsz = string, need not be null-terminated.
+* -- cwsz = WCHAR count of string excl. any null terminator.
+* -- pwszDst
+* -- pcwszDst
+* -- return
+*/
+_Success_(return)
+BOOL ObStrMap_PushPtrW(_In_opt_ POB_STRMAP psm, _In_reads_opt_(cwsz) LPCWSTR wsz, _In_ DWORD cwsz, _Out_ LPWSTR *pwszDst, _Out_opt_ PDWORD pcwszDst);
+
+/*
+* Finalize the string map into a multi-text allocation and update all string
+* pointers registered by ObStrMap_PushPtrW. The string map is DECREF'ed and
+* its pointer set to NULL regardless of the result.
+* CALLER LocalFree: *pwszMultiText
+* -- ppsm
+* -- pwszMultiText = the resulting multi-text.
+* -- pcbMultiText = byte length of the resulting multi-text.
+* -- return
+*/
+_Success_(return)
+BOOL ObStrMap_FinalizeAllocW_DECREF_NULL(_In_ POB_STRMAP *ppsm, _Out_ LPWSTR *pwszMultiText, _Out_ PDWORD pcbMultiText);
+
 #endif /* __OB_H__ */
@@ -24,10 +24,128 @@
 #define OB_DEBUG_FOOTER_SIZE            0x20
 #define OB_DEBUG_FOOTER_MAGIC           0x001122334455667788
 
+// Freed objects of up to 0x2000 bytes are kept in lock-free per-size-class
+// free lists (power of two classes) and are re-used by later allocations.
+#define OB_POOL_CLASS_SHIFT             6               // smallest class: 0x40 bytes
+#define OB_POOL_CLASS_COUNT             8               // largest class: 0x2000 bytes
+#define OB_POOL_CLASS_BYTES_MAX         0x00100000      // max bytes cached per class
+
+static SLIST_HEADER g_ObPool[OB_POOL_CLASS_COUNT];
+
+// Live bytes and objects per tag - open addressed table, slots are claimed on
+// first use of a tag and never released. Tags not fitting in the table are
+// charged to the overflow slot (tag OB_ACCOUNTING_TAG_OVERFLOW).
+typedef struct tdOB_ACCOUNTING_SLOT {
+    volatile DWORD tag;
+    volatile LONG64 c;
+    volatile LONG64 cb;
+} OB_ACCOUNTING_SLOT;
+
+static OB_ACCOUNTING_SLOT g_ObAccounting[OB_ACCOUNTING_TAGS_MAX];
+static OB_ACCOUNTING_SLOT g_ObAccountingOverflow = { OB_ACCOUNTING_TAG_OVERFLOW };
+
+/*
+* Charge an object count and bytes to a tag.
+* -- tag
+* -- c
+* -- cb
+*/
+VOID _Ob_AccountingCharge(_In_ DWORD tag, _In_ LONG64 c, _In_ LONG64 cb)
+{
+    DWORD i, iSlot, tagSlot;
+    if(!tag) { tag = '????'; }
+    iSlot = (tag * 0x9e3779b1) >> 24;
+    for(i = 0; i < OB_ACCOUNTING_TAGS_MAX; i++, iSlot = (iSlot + 1) % OB_ACCOUNTING_TAGS_MAX) {
+        tagSlot = g_ObAccounting[iSlot].tag;
+        if(!tagSlot) {
+            tagSlot = InterlockedCompareExchange((volatile LONG*)&g_ObAccounting[iSlot].tag, tag, 0);
+            if(!tagSlot) { tagSlot = tag; }
+        }
+        if(tagSlot == tag) {
+            if(c) { InterlockedAdd64(&g_ObAccounting[iSlot].c, c); }
+            InterlockedAdd64(&g_ObAccounting[iSlot].cb, cb);
+            return;
+        }
+    }
+    if(c) { InterlockedAdd64(&g_ObAccountingOverflow.c, c); }
+    InterlockedAdd64(&g_ObAccountingOverflow.cb, cb);
+}
+
+VOID Ob_AccountingCharge(_In_ DWORD tag, _In_ LONG64 cb)
+{
+    _Ob_AccountingCharge(tag, 0, cb);
+}
+
+DWORD Ob_AccountingGet(_Out_writes_(cMax) POB_ACCOUNTING_ENTRY pe, _In_ DWORD cMax)
+{
+    DWORD i, c = 0;
+    for(i = 0; (i < OB_ACCOUNTING_TAGS_MAX) && (c < cMax); i++) {
+        if(!g_ObAccounting[i].tag) { continue; }
+        pe[c].tag = g_ObAccounting[i].tag;
+        pe[c]._Filler = 0;
+        pe[c].c = (QWORD)max(0, g_ObAccounting[i].c);
+        pe[c].cb = (QWORD)max(0, g_ObAccounting[i].cb);
+        c++;
+    }
+    if((c < cMax) && (g_ObAccountingOverflow.c || g_ObAccountingOverflow.cb)) {
+        pe[c].tag = g_ObAccountingOverflow.tag;
+        pe[c]._Filler = 0;
+        pe[c].c = (QWORD)max(0, g_ObAccountingOverflow.c);
+        pe[c].cb = (QWORD)max(0, g_ObAccountingOverflow.cb);
+        c++;
+    }
+    return c;
+}
+
+/*
+* Retrieve the pool size class of an allocation.
+* -- cb = total allocation size (incl. object header and footer).
+* -- return = size class, OB_POOL_CLASS_COUNT if not pooled.
+*/
+inline DWORD _Ob_PoolClass(_In_ SIZE_T cb)
+{
+    DWORD i;
+    if(cb > (1ULL << (OB_POOL_CLASS_SHIFT + OB_POOL_CLASS_COUNT - 1))) { return OB_POOL_CLASS_COUNT; }
+    if(cb <= (1ULL << OB_POOL_CLASS_SHIFT)) { return 0; }
+    _BitScanReverse(&i, (DWORD)cb - 1);
+    return i + 1 - OB_POOL_CLASS_SHIFT;
+}
+
+/*
+* Free the memory of an object - either to its size class pool or LocalFree.
+* -- pOb
+*/
+VOID _Ob_Free(_In_ POB pOb)
+{
+    DWORD iClass = _Ob_PoolClass(sizeof(OB) + pOb->cbData + OB_DEBUG_FOOTER_SIZE);
+    if((iClass < OB_POOL_CLASS_COUNT) && (QueryDepthSList(&g_ObPool[iClass]) < (OB_POOL_CLASS_BYTES_MAX >> (OB_POOL_CLASS_SHIFT + iClass)))) {
+        InterlockedPushEntrySList(&g_ObPool[iClass], (PSLIST_ENTRY)pOb);
+        return;
+    }
+    LocalFree(pOb);
+}
+
+/*
+* Release all memory cached in the object size class pools.
+*/
+VOID Ob_PoolTrim()
+{
+    DWORD i;
+    PSLIST_ENTRY pe, peNext;
+    for(i = 0; i < OB_POOL_CLASS_COUNT; i++) {
+        pe = InterlockedFlushSList(&g_ObPool[i]);
+        while(pe) {
+            peNext = pe->Next;
+            LocalFree(pe);
+            pe = peNext;
+        }
+    }
+}
+
 /*
 * Allocate a new object manager memory object.
 * -- tag = tag of the object to be allocated.
-* -- uFlags = flags as given by LocalAlloc.
+* -- uFlags = flags as given by LocalAlloc (only LMEM_ZEROINIT for pooled sizes).
 * -- uBytes = bytes of object (_including_ object headers).
 * -- pfnRef_0 = optional callback for cleanup o be called before object is destroyed.
 *               (if object has references that should be decremented before destruction).
@@ -37,8 +155,18 @@
 PVOID Ob_Alloc(_In_ DWORD tag, _In_ UINT uFlags, _In_ SIZE_T uBytes, _In_opt_ VOID(*pfnRef_0)(_In_ PVOID pOb), _In_opt_ VOID(*pfnRef_1)(_In_ PVOID pOb))
 {
     POB pOb;
+    DWORD iClass;
     if((uBytes > 0x40000000) || (uBytes < sizeof(OB))) { return NULL; }
-    pOb = (POB)LocalAlloc(uFlags, uBytes + OB_DEBUG_FOOTER_SIZE);
+    iClass = _Ob_PoolClass(uBytes + OB_DEBUG_FOOTER_SIZE);
+    if(iClass < OB_POOL_CLASS_COUNT) {
+        if((pOb = (POB)InterlockedPopEntrySList(&g_ObPool[iClass]))) {
+            if(uFlags & LMEM_ZEROINIT) { ZeroMemory(pOb, uBytes + OB_DEBUG_FOOTER_SIZE); }
+        } else {
+            pOb = (POB)LocalAlloc(uFlags & LMEM_ZEROINIT, 1ULL << (OB_POOL_CLASS_SHIFT + iClass));
+        }
+    } else {
+        pOb = (POB)LocalAlloc(uFlags, uBytes + OB_DEBUG_FOOTER_SIZE);
+    }
     if(!pOb) { return NULL; }
     pOb->_magic = OB_HEADER_MAGIC;
     pOb->_count = 1;
@@ -46,6 +174,7 @@ PVOID Ob_Alloc(_In_ DWORD tag, _In_ UINT uFlags, _In_ SIZE_T uBytes, _In_opt_ VO
     pOb->_pfnRef_0 = pfnRef_0;
     pOb->_pfnRef_1 = pfnRef_1;
     pOb->cbData = (DWORD)uBytes - sizeof(OB);
+    _Ob_AccountingCharge(tag, 1, uBytes + OB_DEBUG_FOOTER_SIZE);
 #ifdef OB_DEBUG
     DWORD i, cb = sizeof(OB) + pOb->cbData;
     PBYTE pb = (PBYTE)pOb;
@@ -100,7 +229,8 @@ PVOID Ob_DECREF(_In_opt_ PVOID pObIn)
             if(c == 0) {
                 if(pOb->_pfnRef_0) { pOb->_pfnRef_0(pOb); }
                 pOb->_magic = 0;
-                LocalFree(pOb);
+                _Ob_AccountingCharge(pOb->_tag, -1, -(LONG64)(sizeof(OB) + pOb->cbData + OB_DEBUG_FOOTER_SIZE));
+                _Ob_Free(pOb);
             } else if((c == 1) && pOb->_pfnRef_1) {
                 pOb->_pfnRef_1(pOb);
                 return pOb;
@@ -123,5 +253,5 @@ PVOID Ob_DECREF(_In_opt_ PVOID pObIn)
 BOOL Ob_VALID_TAG(_In_ PVOID pObIn, _In_ DWORD tag)
 {
     POB pOb = (POB)pObIn;
-    return pOb && (pOb->_magic == OB_HEADER_MAGIC) && (pOb->_tag = tag);
+    return pOb && (pOb->_magic == OB_HEADER_MAGIC) && (pOb->_tag == tag);
 }
@@ -24,6 +24,12 @@
 #define OB_MAP_TABLE_MAX_CAPACITY   OB_MAP_ENTRIES_DIRECTORY * OB_MAP_ENTRIES_TABLE * OB_MAP_ENTRIES_STORE
 #define OB_MAP_HASH_FUNCTION(v)     (13 * (v + _rotr16((WORD)v, 9) + _rotr((DWORD)v, 17) + _rotr64(v, 31)))
 
+// Hash map entries hold the entry index in the low bits and a fingerprint of
+// the upper hash bits in the otherwise unused high bits. Probes only fetch the
+// key/value from the (indirect) entry store on fingerprint match.
+#define OB_MAP_HASHENTRY_INDEX      0x01ffffff      // >= OB_MAP_TABLE_MAX_CAPACITY - 1
+#define OB_MAP_HASHENTRY_TAG(h)     ((DWORD)(h >> 32) & ~OB_MAP_HASHENTRY_INDEX)
+
 #define OB_MAP_INDEX_DIRECTORY(i)   ((i >> 17) & (OB_MAP_ENTRIES_DIRECTORY - 1))
 #define OB_MAP_INDEX_TABLE(i)       ((i >> 8) & (OB_MAP_ENTRIES_TABLE - 1))
 #define OB_MAP_INDEX_STORE(i)       (i & (OB_MAP_ENTRIES_STORE - 1))
@@ -43,6 +49,8 @@ typedef struct tdOB_MAP {
     BOOL fKey;
     BOOL fObjectsOb;
     BOOL fObjectsLocalFree;
+    BOOL fFrozen;
+    QWORD cbAlloc;                  // bytes of tables allocated outside the object (charged to OB_TAG_CORE_MAP)
     PDWORD pHashMapKey;
     PDWORD pHashMapValue;
     union {
@@ -59,6 +67,7 @@ typedef struct tdOB_MAP {
 #define OB_MAP_CALL_SYNCHRONIZED_IMPLEMENTATION_WRITE(pm, RetTp, RetValFail, fn) {      \
     if(!OB_MAP_IS_VALID(pm)) { return RetValFail; }                                     \
     RetTp retVal;                                                                       \
+    if(pm->fFrozen) { return RetValFail; }                                              \
     AcquireSRWLockExclusive(&pm->LockSRW);                                              \
     retVal = fn;                                                                        \
     ReleaseSRWLockExclusive(&pm->LockSRW);                                              \
@@ -68,6 +77,7 @@ typedef struct tdOB_MAP {
 #define OB_MAP_CALL_SYNCHRONIZED_IMPLEMENTATION_READ(pm, RetTp, RetValFail, fn) {       \
     if(!OB_MAP_IS_VALID(pm)) { return RetValFail; }                                     \
     RetTp retVal;                                                                       \
+    if(pm->fFrozen) { return fn; }                                                      \
     AcquireSRWLockShared(&pm->LockSRW);                                                 \
     retVal = fn;                                                                        \
     ReleaseSRWLockShared(&pm->LockSRW);                                                 \
@@ -117,6 +127,7 @@ VOID _ObMap_ObCloseCallback(_In_ POB_MAP pObMap)
         }
         LocalFree(pObMap->pHashMapValue);
     }
+    Ob_AccountingCharge(OB_TAG_CORE_MAP, -(LONG64)pObMap->cbAlloc);
 }
 
 inline POB_MAP_ENTRY _ObMap_GetFromIndex(_In_ POB_MAP pm, _In_ DWORD iEntry)
@@ -131,51 +142,56 @@ inline QWORD _ObMap_GetFromEntryIndex(_In_ POB_MAP pm, _In_ BOOL fValueHash, _In
     return pe ? (fValueHash ? (QWORD)pe->v : pe->k) : 0;
 }
 
-inline VOID _ObMap_SetHashIndex(_In_ POB_MAP pm, _In_ BOOL fValueHash, _In_ DWORD iHash, _In_ DWORD iEntry)
+inline DWORD _ObMap_GetHashEntry(_In_ POB_MAP pm, _In_ BOOL fValueHash, _In_ DWORD iHash)
+{
+    return fValueHash ? pm->pHashMapValue[iHash] : pm->pHashMapKey[iHash];
+}
+
+inline VOID _ObMap_SetHashEntry(_In_ POB_MAP pm, _In_ BOOL fValueHash, _In_ DWORD iHash, _In_ DWORD dwEntry)
 {
     if(fValueHash) {
-        pm->pHashMapValue[iHash] = iEntry;
+        pm->pHashMapValue[iHash] = dwEntry;
     } else if(pm->fKey) {
-        pm->pHashMapKey[iHash] = iEntry;
+        pm->pHashMapKey[iHash] = dwEntry;
     }
 }
 
 VOID _ObMap_InsertHash(_In_ POB_MAP pm, _In_ BOOL fValueHash, _In_ DWORD iEntry)
 {
-    QWORD qwValueToHash;
+    QWORD qwHash;
     DWORD iHash, dwHashMask = pm->cHashMax - 1;
     if(!fValueHash && !pm->fKey) { return; }
-    qwValueToHash = _ObMap_GetFromEntryIndex(pm, fValueHash, iEntry);
-    iHash = OB_MAP_HASH_FUNCTION(qwValueToHash) & dwHashMask;
-    while(fValueHash ? pm->pHashMapValue[iHash] : pm->pHashMapKey[iHash]) {
+    qwHash = OB_MAP_HASH_FUNCTION(_ObMap_GetFromEntryIndex(pm, fValueHash, iEntry));
+    iHash = (DWORD)qwHash & dwHashMask;
+    while(_ObMap_GetHashEntry(pm, fValueHash, iHash)) {
         iHash = (iHash + 1) & dwHashMask;
     }
-    _ObMap_SetHashIndex(pm, fValueHash, iHash, iEntry);
+    _ObMap_SetHashEntry(pm, fValueHash, iHash, iEntry | OB_MAP_HASHENTRY_TAG(qwHash));
 }
 
 VOID _ObMap_RemoveHash(_In_ POB_MAP pm, _In_ BOOL fValueHash, _In_ QWORD kv, _In_ DWORD iEntry)
 {
     DWORD iHash, dwHashMask = pm->cHashMax - 1;
     DWORD iNextHash, iNextEntry, iNextHashPreferred;
-    QWORD qwNextEntry;
     if(!fValueHash && !pm->fKey) { return; }
     // search for hash index and clear
-    iHash = OB_MAP_HASH_FUNCTION(kv) & dwHashMask;
+    iHash = (DWORD)OB_MAP_HASH_FUNCTION(kv) & dwHashMask;
     while(TRUE) {
-        if(iEntry == (fValueHash ? pm->pHashMapValue[iHash] : pm->pHashMapKey[iHash])) { break; }
+        if(iEntry == (_ObMap_GetHashEntry(pm, fValueHash, iHash) & OB_MAP_HASHENTRY_INDEX)) { break; }
         iHash = (iHash + 1) & dwHashMask;
     }
-    _ObMap_SetHashIndex(pm, fValueHash, iHash, 0);
-    // re-hash any entries following (value)
+    _ObMap_SetHashEntry(pm, fValueHash, iHash, 0);
+    // re-hash any entries following until the end of the probe cluster. An
+    // entry in its preferred slot stays but the cluster walk must continue,
+    // entries further on may otherwise become unreachable.
     iNextHash = iHash;
     while(TRUE) {
         iNextHash = (iNextHash + 1) & dwHashMask;
-        iNextEntry = fValueHash ? pm->pHashMapValue[iNextHash] : pm->pHashMapKey[iNextHash];
+        iNextEntry = _ObMap_GetHashEntry(pm, fValueHash, iNextHash) & OB_MAP_HASHENTRY_INDEX;
         if(0 == iNextEntry) { return; }
-        qwNextEntry = _ObMap_GetFromEntryIndex(pm, fValueHash, iNextEntry);
-        iNextHashPreferred = OB_MAP_HASH_FUNCTION(qwNextEntry) & dwHashMask;
-        if(iNextHash == iNextHashPreferred) { return; }
-        _ObMap_SetHashIndex(pm, fValueHash, iNextHash, 0);
+        iNextHashPreferred = (DWORD)OB_MAP_HASH_FUNCTION(_ObMap_GetFromEntryIndex(pm, fValueHash, iNextEntry)) & dwHashMask;
+        if(iNextHash == iNextHashPreferred) { continue; }
+        _ObMap_SetHashEntry(pm, fValueHash, iNextHash, 0);
         _ObMap_InsertHash(pm, fValueHash, iNextEntry);
     }
 }
@@ -183,15 +199,17 @@ VOID _ObMap_RemoveHash(_In_ POB_MAP pm, _In_ BOOL fValueHash, _In_ QWORD kv, _In
 _Success_(return)
 BOOL _ObMap_GetEntryIndexFromKeyOrValue(_In_ POB_MAP pm, _In_ BOOL fValueHash, _In_ QWORD kv, _Out_opt_ PDWORD piEntry)
 {
-    DWORD iEntry;
+    DWORD dwEntry, iEntry;
+    QWORD qwHash = OB_MAP_HASH_FUNCTION(kv);
     DWORD dwHashMask = pm->cHashMax - 1;
-    DWORD iHash = OB_MAP_HASH_FUNCTION(kv) & dwHashMask;
+    DWORD iHash = (DWORD)qwHash & dwHashMask;
+    DWORD dwTag = OB_MAP_HASHENTRY_TAG(qwHash);
     if(!fValueHash && !pm->fKey) { return FALSE; }
     // scan hash table to find entry
     while(TRUE) {
-        iEntry = fValueHash ? pm->pHashMapValue[iHash] : pm->pHashMapKey[iHash];
-        if(0 == iEntry) { return FALSE; }
-        if(kv == _ObMap_GetFromEntryIndex(pm, fValueHash, iEntry)) {
+        dwEntry = _ObMap_GetHashEntry(pm, fValueHash, iHash);
+        if(0 == dwEntry) { return FALSE; }
+        if((dwTag == (dwEntry & ~OB_MAP_HASHENTRY_INDEX)) && (kv == _ObMap_GetFromEntryIndex(pm, fValueHash, (iEntry = dwEntry & OB_MAP_HASHENTRY_INDEX)))) {
             if(piEntry) { *piEntry = iEntry; }
             return TRUE;
         }
@@ -250,6 +268,12 @@ PVOID _ObMap_GetByEntryIndex(_In_ POB_MAP pm, _In_ DWORD iEntry)
     return pvObObject;
 }
 
+PVOID _ObMap_GetByEntryIndexWithKey(_In_ POB_MAP pm, _In_ DWORD iEntry, _Out_ PQWORD pKey)
+{
+    *pKey = _ObMap_GetFromEntryIndex(pm, FALSE, iEntry);
+    return _ObMap_GetByEntryIndex(pm, iEntry);
+}
+
 PVOID _ObMap_GetByKey(_In_ POB_MAP pm, _In_ QWORD qwKey)
 {
     DWORD iEntry;
@@ -321,6 +345,22 @@ PVOID ObMap_GetByIndex(_In_opt_ POB_MAP pm, _In_ DWORD index)
     OB_MAP_CALL_SYNCHRONIZED_IMPLEMENTATION_READ(pm, PVOID, NULL, _ObMap_GetByEntryIndex(pm, index + 1))  // (+1 == account/adjust for index 0 (reserved))
 }
 
+/*
+* Retrieve an object and its key given an index (which is less than the amount
+* of items in the ObMap).
+* CALLER DECREF(if OB): return
+* -- pm
+* -- index
+* -- pKey
+* -- return
+*/
+_Success_(return != NULL)
+PVOID ObMap_GetByIndexWithKey(_In_opt_ POB_MAP pm, _In_ DWORD index, _Out_ PQWORD pKey)
+{
+    *pKey = 0;
+    OB_MAP_CALL_SYNCHRONIZED_IMPLEMENTATION_READ(pm, PVOID, NULL, _ObMap_GetByEntryIndexWithKey(pm, index + 1, pKey))  // (+1 == account/adjust for index 0 (reserved))
+}
+
 /*
 * Retrieve a value given a key.
 * CALLER DECREF(if OB): return
@@ -555,7 +595,7 @@ DWORD ObMap_RemoveByFilter(_In_opt_ POB_MAP pm, _In_opt_ BOOL(*pfnFilter)(_In_ Q
 */
 VOID ObMap_Clear(_In_opt_ POB_MAP pm)
 {
-    if(!OB_MAP_IS_VALID(pm) || (pm->c <= 1)) { return; }
+    if(!OB_MAP_IS_VALID(pm) || (pm->c <= 1) || pm->fFrozen) { return; }
     AcquireSRWLockExclusive(&pm->LockSRW);
     if(pm->c <= 1) {
         ReleaseSRWLockExclusive(&pm->LockSRW);
@@ -585,9 +625,12 @@ BOOL _ObMap_Grow(_In_ POB_MAP pm)
 {
     DWORD iEntry;
     PDWORD pdwNewAllocHashMap;
-    if(!(pdwNewAllocHashMap = LocalAlloc(LMEM_ZEROINIT, 2 * sizeof(DWORD) * pm->cHashMax * (pm->fKey ? 2 : 1)))) { return FALSE; }
+    QWORD cbHashMapOld = pm->fLargeMode ? (sizeof(DWORD) * pm->cHashMax * (pm->fKey ? 2 : 1)) : 0;
+    QWORD cbCharge = 2 * sizeof(DWORD) * pm->cHashMax * (pm->fKey ? 2 : 1);
+    if(!(pdwNewAllocHashMap = LocalAlloc(LMEM_ZEROINIT, cbCharge))) { return FALSE; }
     if(!pm->fLargeMode) {
         if(!(pm->Directory[0] = LocalAlloc(LMEM_ZEROINIT, sizeof(POB_MAP_ENTRY) * OB_MAP_ENTRIES_TABLE))) { return FALSE; }
+        cbCharge += sizeof(POB_MAP_ENTRY) * OB_MAP_ENTRIES_TABLE;
         pm->Directory[0][0] = pm->Store00;
         ZeroMemory(pm->_SmallHashMap, sizeof(pm->_SmallHashMap));
         pm->pHashMapKey = NULL;
@@ -598,6 +641,8 @@ BOOL _ObMap_Grow(_In_ POB_MAP pm)
     pm->cHashGrowThreshold *= 2;
     LocalFree(pm->pHashMapValue);
     pm->pHashMapValue = pdwNewAllocHashMap;
+    pm->cbAlloc += cbCharge - cbHashMapOld;
+    Ob_AccountingCharge(OB_TAG_CORE_MAP, (LONG64)cbCharge - (LONG64)cbHashMapOld);
     if(pm->fKey) {
         pm->pHashMapKey = pm->pHashMapValue + pm->cHashMax;
     }
@@ -622,9 +667,13 @@ BOOL _ObMap_Push(_In_ POB_MAP pm, _In_ QWORD qwKey, _In_ PVOID pvObject)
     }
     if(!pm->Directory[OB_MAP_INDEX_DIRECTORY(iEntry)]) {    // allocate "table" if required
         if(!(pm->Directory[OB_MAP_INDEX_DIRECTORY(iEntry)] = LocalAlloc(LMEM_ZEROINIT, sizeof(POB_MAP_ENTRY) * OB_MAP_ENTRIES_TABLE))) { return FALSE; }
+        pm->cbAlloc += sizeof(POB_MAP_ENTRY) * OB_MAP_ENTRIES_TABLE;
+        Ob_AccountingCharge(OB_TAG_CORE_MAP, sizeof(POB_MAP_ENTRY) * OB_MAP_ENTRIES_TABLE);
     }
     if(!pm->Directory[OB_MAP_INDEX_DIRECTORY(iEntry)][OB_MAP_INDEX_TABLE(iEntry)]) {    // allocate "store" if required
         if(!(pm->Directory[OB_MAP_INDEX_DIRECTORY(iEntry)][OB_MAP_INDEX_TABLE(iEntry)] = LocalAlloc(LMEM_ZEROINIT, sizeof(OB_MAP_ENTRY) * OB_MAP_ENTRIES_STORE))) { return FALSE; }
+        pm->cbAlloc += sizeof(OB_MAP_ENTRY) * OB_MAP_ENTRIES_STORE;
+        Ob_AccountingCharge(OB_TAG_CORE_MAP, sizeof(OB_MAP_ENTRY) * OB_MAP_ENTRIES_STORE);
     }
     if(pm->fObjectsOb) {
         Ob_INCREF(pvObject);
@@ -652,6 +701,21 @@ BOOL ObMap_Push(_In_opt_ POB_MAP pm, _In_ QWORD qwKey, _In_ PVOID pvObject)
     OB_MAP_CALL_SYNCHRONIZED_IMPLEMENTATION_WRITE(pm, BOOL, FALSE, _ObMap_Push(pm, qwKey, pvObject))
 }
 
+/*
+* Freeze the map into a read-only state. Lookups of a frozen map take no lock
+* and all functions modifying the map will fail. The map is to be frozen
+* once fully built and before it's shared (e.g. published in an ObContainer).
+* A frozen map cannot be un-frozen.
+* -- pm
+*/
+VOID ObMap_Freeze(_In_opt_ POB_MAP pm)
+{
+    if(!OB_MAP_IS_VALID(pm) || pm->fFrozen) { return; }
+    AcquireSRWLockExclusive(&pm->LockSRW);
+    pm->fFrozen = TRUE;
+    ReleaseSRWLockExclusive(&pm->LockSRW);
+}
+
 /*
 * Create a new map. A map (ObMap) provides atomic map operations and ways
 * to optionally map key values to values, pointers or object manager objects.
@@ -14,6 +14,7 @@
 //
 #include "ob.h"
 #include <stdio.h>
+#include <stdlib.h>
 
 #define OB_SET_ENTRIES_DIRECTORY        0x100
 #define OB_SET_ENTRIES_TABLE            0x80
@@ -34,6 +35,7 @@ typedef struct tdOB_SET {
     DWORD cHashMax;
     DWORD cHashGrowThreshold;
     BOOL fLargeMode;
+    BOOL fNoLock;
     PDWORD pHashMapLarge;
     union {
         WORD pHashMapSmall[0x400];
@@ -47,9 +49,18 @@ typedef struct tdOB_SET {
 #define TABLE_MAX_CAPACITY          OB_SET_ENTRIES_DIRECTORY * OB_SET_ENTRIES_TABLE * OB_SET_ENTRIES_STORE
 #define HASH_FUNCTION(v)            (13 * (v + _rotr16((WORD)v, 9) + _rotr((DWORD)v, 17) + _rotr64(v, 31)))
 
+// Hash map entries hold the value index in the low bits and a fingerprint of
+// the upper hash bits in the otherwise unused high bits. Probes only fetch the
+// value from the (indirect) value store on fingerprint match.
+#define OB_SET_HASHENTRY_INDEX_SMALL    0x03ff          // > cHashGrowThreshold of small mode
+#define OB_SET_HASHENTRY_INDEX_LARGE    0x00ffffff      // >= TABLE_MAX_CAPACITY - 1
+#define OB_SET_HASHENTRY_INDEX(pvs)     (pvs->fLargeMode ? OB_SET_HASHENTRY_INDEX_LARGE : OB_SET_HASHENTRY_INDEX_SMALL)
+#define OB_SET_HASHENTRY_TAG(pvs, h)    ((DWORD)(h >> 32) & (pvs->fLargeMode ? ~OB_SET_HASHENTRY_INDEX_LARGE : (0xffff & ~OB_SET_HASHENTRY_INDEX_SMALL)))
+
 #define OB_SET_CALL_SYNCHRONIZED_IMPLEMENTATION_WRITE(pvs, RetTp, RetValFail, fn) {     \
     if(!OB_SET_IS_VALID(pvs)) { return RetValFail; }                                    \
     RetTp retVal;                                                                       \
+    if(pvs->fNoLock) { return fn; }                                                     \
     AcquireSRWLockExclusive(&pvs->LockSRW);                                             \
     retVal = fn;                                                                        \
     ReleaseSRWLockExclusive(&pvs->LockSRW);                                             \
@@ -59,6 +70,7 @@ typedef struct tdOB_SET {
 #define OB_SET_CALL_SYNCHRONIZED_IMPLEMENTATION_READ(pvs, RetTp, RetValFail, fn) {      \
     if(!OB_SET_IS_VALID(pvs)) { return RetValFail; }                                    \
     RetTp retVal;                                                                       \
+    if(pvs->fNoLock) { return fn; }                                                     \
     AcquireSRWLockShared(&pvs->LockSRW);                                                \
     retVal = fn;                                                                        \
     ReleaseSRWLockShared(&pvs->LockSRW);                                                \
@@ -103,10 +115,23 @@ VOID _ObSet_ObCloseCallback(_In_ POB_SET pObSet)
 * -- return
 */
 POB_SET ObSet_New()
+{
+    return ObSet_NewEx(0);
+}
+
+/*
+* Create a new hashed value set with flags. OB_SET_FLAGS_NOLOCK skips all
+* internal locking and may only be used for sets private to one thread.
+* CALLER DECREF: return
+* -- flags = 0 or OB_SET_FLAGS_* flags.
+* -- return
+*/
+POB_SET ObSet_NewEx(_In_ QWORD flags)
 {
     POB_SET pObSet = Ob_Alloc(OB_TAG_CORE_SET, LMEM_ZEROINIT, sizeof(OB_SET), _ObSet_ObCloseCallback, NULL);
     if(!pObSet) { return NULL; }
     InitializeSRWLock(&pObSet->LockSRW);
+    pObSet->fNoLock = (flags & OB_SET_FLAGS_NOLOCK) ? TRUE : FALSE;
     pObSet->c = 1;     // item zero is reserved - hence the initialization of count to 1
     pObSet->cHashMax = 0x400;
     pObSet->cHashGrowThreshold = 0x300;
@@ -137,67 +162,82 @@ inline VOID _ObSet_SetValueFromIndex(_In_ POB_SET pvs, _In_ DWORD iValue, _In_ Q
     }
 }
 
-inline DWORD _ObSet_GetIndexFromHash(_In_ POB_SET pvs, _In_ DWORD iHash)
+inline DWORD _ObSet_GetHashEntry(_In_ POB_SET pvs, _In_ DWORD iHash)
 {
     return pvs->fLargeMode ? pvs->pHashMapLarge[iHash] : pvs->pHashMapSmall[iHash];
 }
 
-inline VOID _ObSet_SetHashIndex(_In_ POB_SET pvs, _In_ DWORD iHash, _In_ DWORD iValue)
+inline VOID _ObSet_SetHashEntry(_In_ POB_SET pvs, _In_ DWORD iHash, _In_ DWORD dwEntry)
 {
     if(pvs->fLargeMode) {
-        pvs->pHashMapLarge[iHash] = iValue;
+        pvs->pHashMapLarge[iHash] = dwEntry;
     } else {
-        pvs->pHashMapSmall[iHash] = (WORD)iValue;
+        pvs->pHashMapSmall[iHash] = (WORD)dwEntry;
     }
 }
 
 VOID _ObSet_InsertHash(_In_ POB_SET pvs, _In_ DWORD iValue)
 {
+    QWORD qwHash;
     DWORD iHash;
     DWORD dwHashMask = pvs->cHashMax - 1;
     QWORD qwValueToHash = _ObSet_GetValueFromIndex(pvs, iValue);
     if(!qwValueToHash) { return; }
-    iHash = HASH_FUNCTION(qwValueToHash) & dwHashMask;
-    while(_ObSet_GetIndexFromHash(pvs, iHash)) {
+    qwHash = HASH_FUNCTION(qwValueToHash);
+    iHash = (DWORD)qwHash & dwHashMask;
+    while(_ObSet_GetHashEntry(pvs, iHash)) {
         iHash = (iHash + 1) & dwHashMask;
     }
-    _ObSet_SetHashIndex(pvs, iHash, iValue);
+    _ObSet_SetHashEntry(pvs, iHash, iValue | OB_SET_HASHENTRY_TAG(pvs, qwHash));
 }
 
 VOID _ObSet_RemoveHash(_In_ POB_SET pvs, _In_ DWORD iHash)
 {
     DWORD dwHashMask = pvs->cHashMax - 1;
-    DWORD iNextHash, iNextEntry, iNextHashPreferred;
+    DWORD iNextHash, dwNextEntry, iNextHashPreferred;
     // clear existing hash entry
-    _ObSet_SetHashIndex(pvs, iHash, 0);
-    // re-hash any entries following
+    _ObSet_SetHashEntry(pvs, iHash, 0);
+    // re-hash any entries following until the end of the probe cluster. An
+    // entry in its preferred slot stays but the cluster walk must continue,
+    // entries further on may otherwise become unreachable.
     iNextHash = iHash;
     while(TRUE) {
         iNextHash = (iNextHash + 1) & dwHashMask;
-        iNextEntry = _ObSet_GetIndexFromHash(pvs, iNextHash);
-        if(0 == iNextEntry) { return; }
-        iNextHashPreferred = HASH_FUNCTION(_ObSet_GetValueFromIndex(pvs, iNextEntry)) & dwHashMask;
-        if(iNextHash == iNextHashPreferred) { return; }
-        if(pvs->fLargeMode) {
-            pvs->pHashMapLarge[iNextHash] = 0;
-        } else {
-            pvs->pHashMapSmall[iNextHash] = 0;
-        }
-        _ObSet_InsertHash(pvs, iNextEntry);
+        dwNextEntry = _ObSet_GetHashEntry(pvs, iNextHash);
+        if(0 == dwNextEntry) { return; }
+        iNextHashPreferred = (DWORD)HASH_FUNCTION(_ObSet_GetValueFromIndex(pvs, dwNextEntry & OB_SET_HASHENTRY_INDEX(pvs))) & dwHashMask;
+        if(iNextHash == iNextHashPreferred) { continue; }
+        _ObSet_SetHashEntry(pvs, iNextHash, 0);
+        _ObSet_InsertHash(pvs, dwNextEntry & OB_SET_HASHENTRY_INDEX(pvs));
     }
 }
 
+/*
+* Locate a value in the hash map.
+* -- pvs
+* -- v
+* -- pdwIndexValue = index of value (if found).
+* -- pdwIndexHash = hash map index of value if found, otherwise the empty hash
+*                   map index at which the value would be inserted.
+* -- return
+*/
 _Success_(return)
 BOOL _ObSet_GetIndexFromValue(_In_ POB_SET pvs, _In_ QWORD v, _Out_opt_ PDWORD pdwIndexValue, _Out_opt_ PDWORD pdwIndexHash)
 {
-    DWORD dwIndex;
+    DWORD dwEntry, dwIndex;
+    QWORD qwHash = HASH_FUNCTION(v);
     DWORD dwHashMask = pvs->cHashMax - 1;
-    DWORD dwHash = HASH_FUNCTION(v) & dwHashMask;
+    DWORD dwHash = (DWORD)qwHash & dwHashMask;
+    DWORD dwIndexMask = OB_SET_HASHENTRY_INDEX(pvs);
+    DWORD dwTag = OB_SET_HASHENTRY_TAG(pvs, qwHash);
     // scan hash table to find entry
     while(TRUE) {
-        dwIndex = _ObSet_GetIndexFromHash(pvs, dwHash);
-        if(0 == dwIndex) { return FALSE; }
-        if(v == _ObSet_GetValueFromIndex(pvs, dwIndex)) { 
+        dwEntry = _ObSet_GetHashEntry(pvs, dwHash);
+        if(0 == dwEntry) {
+            if(pdwIndexHash) { *pdwIndexHash = dwHash; }
+            return FALSE;
+        }
+        if((dwTag == (dwEntry & ~dwIndexMask)) && (v == _ObSet_GetValueFromIndex(pvs, (dwIndex = dwEntry & dwIndexMask)))) {
             if(pdwIndexValue) { *pdwIndexValue = dwIndex; }
             if(pdwIndexHash) { *pdwIndexHash = dwHash; }
             return TRUE;
@@ -285,6 +325,27 @@ POB_DATA ObSet_GetAll(_In_opt_ POB_SET pvs)
     OB_SET_CALL_SYNCHRONIZED_IMPLEMENTATION_READ(pvs, POB_DATA, NULL, _ObSet_GetAll(pvs))
 }
 
+int _ObSet_GetAllSorted_CmpSort(_In_ PQWORD pqw1, _In_ PQWORD pqw2)
+{
+    return (*pqw1 < *pqw2) ? -1 : ((*pqw1 > *pqw2) ? 1 : 0);
+}
+
+/*
+* Retrieve all values in the Set as a POB_DATA object containing the values
+* in a QWORD table sorted in ascending order.
+* -- CALLER DECREF: return
+* -- pvs
+* -- return
+*/
+POB_DATA ObSet_GetAllSorted(_In_opt_ POB_SET pvs)
+{
+    POB_DATA pObData = ObSet_GetAll(pvs);
+    if(pObData) {
+        qsort(pObData->pqw, pObData->ObHdr.cbData / sizeof(QWORD), sizeof(QWORD), (_CoreCrtNonSecureSearchSortCompareFunction)_ObSet_GetAllSorted_CmpSort);
+    }
+    return pObData;
+}
+
 BOOL _ObSet_Remove(_In_ POB_SET pvs, _In_ QWORD value)
 {
     QWORD qwLastValue;
@@ -300,6 +361,8 @@ BOOL _ObSet_Remove(_In_ POB_SET pvs, _In_ QWORD value)
     _ObSet_RemoveHash(pvs, iLastHash);
     pvs->c--;
     if(iLastValue != iRemoveValue) {    // overwrite value to remove with last value if required.
+        // hash entry of value to remove may have moved when last value hash was removed.
+        if(!_ObSet_GetIndexFromValue(pvs, value, &iRemoveValue, &iRemoveHash)) { return TRUE; }
         _ObSet_RemoveHash(pvs, iRemoveHash);
         _ObSet_SetValueFromIndex(pvs, iRemoveValue, qwLastValue);
         _ObSet_InsertHash(pvs, iRemoveValue);
@@ -327,18 +390,16 @@ BOOL ObSet_Remove(_In_opt_ POB_SET pvs, _In_ QWORD value)
 VOID ObSet_Clear(_In_opt_ POB_SET pvs)
 {
     if(!OB_SET_IS_VALID(pvs) || (pvs->c <= 1)) { return; }
-    AcquireSRWLockExclusive(&pvs->LockSRW);
-    if(pvs->c <= 1) {
-        ReleaseSRWLockExclusive(&pvs->LockSRW);
-        return;
-    }
-    if(pvs->fLargeMode) {
-        ZeroMemory(pvs->pHashMapLarge, pvs->cHashMax * sizeof(DWORD));
-    } else {
-        ZeroMemory(pvs->pHashMapSmall, sizeof(pvs->pHashMapSmall));
+    if(!pvs->fNoLock) { AcquireSRWLockExclusive(&pvs->LockSRW); }
+    if(pvs->c > 1) {
+        if(pvs->fLargeMode) {
+            ZeroMemory(pvs->pHashMapLarge, pvs->cHashMax * sizeof(DWORD));
+        } else {
+            ZeroMemory(pvs->pHashMapSmall, sizeof(pvs->pHashMapSmall));
+        }
+        pvs->c = 1;     // item zero is reserved - hence the initialization of count to 1
     }
-    pvs->c = 1;     // item zero is reserved - hence the initialization of count to 1
-    ReleaseSRWLockExclusive(&pvs->LockSRW);
+    if(!pvs->fNoLock) { ReleaseSRWLockExclusive(&pvs->LockSRW); }
 }
 
 QWORD _ObSet_Pop(_In_ POB_SET pvs)
@@ -396,16 +457,18 @@ _Success_(return)
 BOOL _ObSet_Push(_In_ POB_SET pvs, _In_ QWORD value)
 {
     POB_SET_TABLE_ENTRY pTable = NULL;
-    DWORD iValue = pvs->c;
+    DWORD iHash, iValue = pvs->c;
     WORD iDirectory = (iValue >> 14) & (OB_SET_ENTRIES_DIRECTORY - 1);
     WORD iTable = (iValue >> 9) & (OB_SET_ENTRIES_TABLE - 1);
     WORD iValueStore = iValue & (OB_SET_ENTRIES_STORE - 1);
-    if((value == 0) || _ObSet_Exists(pvs, value)) { return FALSE; }
+    // single probe: find existing value or the empty slot to insert into.
+    if((value == 0) || _ObSet_GetIndexFromValue(pvs, value, NULL, &iHash)) { return FALSE; }
     if(iValue == OB_SET_ENTRIES_DIRECTORY * OB_SET_ENTRIES_TABLE * OB_SET_ENTRIES_STORE) { return FALSE; }
     if(iValue == pvs->cHashGrowThreshold) {
         if(!_ObSet_Grow(pvs)) {
             return FALSE;
         }
+        _ObSet_GetIndexFromValue(pvs, value, NULL, &iHash);
     }
     if(iDirectory && !pvs->pDirectory[iDirectory].pTable) { // Ensure Table Exists
         pvs->pDirectory[iDirectory].pTable = LocalAlloc(LMEM_ZEROINIT, OB_SET_ENTRIES_TABLE * sizeof(OB_SET_TABLE_ENTRY));
@@ -418,7 +481,7 @@ BOOL _ObSet_Push(_In_ POB_SET pvs, _In_ QWORD value)
     }
     pvs->c++;
     _ObSet_SetValueFromIndex(pvs, iValue, value);
-    _ObSet_InsertHash(pvs, iValue);
+    _ObSet_SetHashEntry(pvs, iHash, iValue | OB_SET_HASHENTRY_TAG(pvs, HASH_FUNCTION(value)));
     return TRUE;
 }
 
@@ -426,11 +489,11 @@ _Success_(return)
 BOOL _ObSet_PushSet(_In_ POB_SET pvs, _In_ POB_SET pvsSrc)
 {
     DWORD iValue;
-    AcquireSRWLockShared(&pvsSrc->LockSRW);
+    if(!pvsSrc->fNoLock) { AcquireSRWLockShared(&pvsSrc->LockSRW); }
     for(iValue = pvsSrc->c - 1; iValue; iValue--) {
         _ObSet_Push(pvs, _ObSet_GetValueFromIndex(pvsSrc, iValue));
     }
-    ReleaseSRWLockShared(&pvsSrc->LockSRW);
+    if(!pvsSrc->fNoLock) { ReleaseSRWLockShared(&pvsSrc->LockSRW); }
     return TRUE;
 }
 
@@ -0,0 +1,209 @@
+// ob_strmap.c : implementation of object manager string map functionality.
+//
+// The string map is used to build the multi-text string data of a map in a
+// single allocation. Strings are pushed together with a pointer to the string
+// pointer (and optional length) in the map entry which is to reference them.
+// Equal strings are stored only once. When the map entries are fully built
+// the string map is finalized into the resulting multi-text allocation and
+// all string pointers registered at push time are updated.
+//
+// The ObStrMap is an object manager object and must be DECREF'ed when required.
+//
+// (c) MemProcFS contributors, 2020
+// Author: MemProcFS contributors
+//
+#include "ob.h"
+
+#define OB_STRMAP_IS_VALID(p)           (p && (p->ObHdr._magic == OB_HEADER_MAGIC) && (p->ObHdr._tag == OB_TAG_CORE_STRMAP))
+#define OB_STRMAP_CWSZ_INITIAL          0x800
+#define OB_STRMAP_CREF_INITIAL          0x100
+
+typedef struct tdOB_STRMAP_REF {
+    LPWSTR *pwsz;
+    PDWORD pcwsz;
+    DWORD owsz;
+    DWORD cwsz;
+} OB_STRMAP_REF, *POB_STRMAP_REF;
+
+typedef struct tdOB_STRMAP {
+    OB ObHdr;
+    SRWLOCK LockSRW;
+    BOOL fError;
+    POB_MAP pmHash;                 // string hash -> string offset (unique)
+    LPWSTR wsz;
+    DWORD cwsz;
+    DWORD cwszMax;
+    POB_STRMAP_REF pRef;
+    DWORD cRef;
+    DWORD cRefMax;
+} OB_STRMAP, *POB_STRMAP;
+
+/*
+* Object manager cleanup function to be called when reference count reaches zero.
+* -- psm
+*/
+VOID _ObStrMap_ObCloseCallback(_In_ POB_STRMAP psm)
+{
+    Ob_DECREF(psm->pmHash);
+    LocalFree(psm->wsz);
+    LocalFree(psm->pRef);
+}
+
+QWORD _ObStrMap_Hash(_In_reads_(cwsz) LPCWSTR wsz, _In_ DWORD cwsz)
+{
+    DWORD i;
+    QWORD qwHash = 0xcbf29ce484222325 ^ cwsz;
+    for(i = 0; i < cwsz; i++) {
+        qwHash = (qwHash ^ wsz[i]) * 0x100000001b3;
+    }
+    return qwHash;
+}
+
+/*
+* Store a string (or retrieve an already stored equal string).
+* -- psm
+* -- wsz
+* -- cwsz
+* -- return = WCHAR offset of string in the multi-text, 0 on fail.
+*/
+DWORD _ObStrMap_StoreString(_In_ POB_STRMAP psm, _In_reads_(cwsz) LPCWSTR wsz, _In_ DWORD cwsz)
+{
+    QWORD qwHash;
+    DWORD owsz, cwszMaxNew;
+    LPWSTR wszNew;
+    qwHash = _ObStrMap_Hash(wsz, cwsz);
+    owsz = (DWORD)(QWORD)ObMap_GetByKey(psm->pmHash, qwHash);
+    if(owsz && (owsz + cwsz < psm->cwsz) && !psm->wsz[owsz + cwsz] && !memcmp(psm->wsz + owsz, wsz, cwsz * sizeof(WCHAR))) {
+        return owsz;
+    }
+    if(psm->cwsz + cwsz + 1 > psm->cwszMax) {
+        cwszMaxNew = max(psm->cwszMax * 2, psm->cwsz + cwsz + 1);
+        if(!(wszNew = LocalReAlloc(psm->wsz, cwszMaxNew * sizeof(WCHAR), LMEM_MOVEABLE))) { return 0; }
+        psm->wsz = wszNew;
+        psm->cwszMax = cwszMaxNew;
+    }
+    owsz = psm->cwsz;
+    memcpy(psm->wsz + owsz, wsz, cwsz * sizeof(WCHAR));
+    psm->wsz[owsz + cwsz] = 0;
+    psm->cwsz += cwsz + 1;
+    ObMap_Push(psm->pmHash, qwHash, (PVOID)(QWORD)owsz);     // fails on hash collision -> string is not de-duplicated.
+    return owsz;
+}
+
+_Success_(return)
+BOOL _ObStrMap_PushPtrW(_In_ POB_STRMAP psm, _In_reads_opt_(cwsz) LPCWSTR wsz, _In_ DWORD cwsz, _Out_ LPWSTR *pwszDst, _Out_opt_ PDWORD pcwszDst)
+{
+    DWORD owsz = 0, cRefMaxNew;
+    POB_STRMAP_REF pRefNew;
+    if(!wsz) { cwsz = 0; }
+    if(cwsz && !(owsz = _ObStrMap_StoreString(psm, wsz, cwsz))) { goto fail; }
+    if(psm->cRef == psm->cRefMax) {
+        cRefMaxNew = psm->cRefMax * 2;
+        if(!(pRefNew = LocalReAlloc(psm->pRef, cRefMaxNew * sizeof(OB_STRMAP_REF), LMEM_MOVEABLE))) { goto fail; }
+        psm->pRef = pRefNew;
+        psm->cRefMax = cRefMaxNew;
+    }
+    psm->pRef[psm->cRef].pwsz = pwszDst;
+    psm->pRef[psm->cRef].pcwsz = pcwszDst;
+    psm->pRef[psm->cRef].owsz = owsz;
+    psm->pRef[psm->cRef].cwsz = cwsz;
+    psm->cRef++;
+    *pwszDst = NULL;
+    if(pcwszDst) { *pcwszDst = 0; }
+    return TRUE;
+fail:
+    psm->fError = TRUE;
+    *pwszDst = NULL;
+    if(pcwszDst) { *pcwszDst = 0; }
+    return FALSE;
+}
+
+/*
+* Push a string into the string map. The string pointer pwszDst (and optional
+* length pcwszDst) is set to the string in the resulting multi-text when the
+* string map is finalized - until then it's set to NULL/0. The locations of
+* pwszDst/pcwszDst must stay valid until the string map is finalized.
+* Equal strings are de-duplicated. A NULL or zero-length string is set to the
+* empty string at the start of the multi-text.
+* -- psm
+* -- wsz = string, need not be null-terminated.
+* -- cwsz = WCHAR count of string excl. any null terminator.
+* -- pwszDst
+* -- pcwszDst
+* -- return
+*/
+_Success_(return)
+BOOL ObStrMap_PushPtrW(_In_opt_ POB_STRMAP psm, _In_reads_opt_(cwsz) LPCWSTR wsz, _In_ DWORD cwsz, _Out_ LPWSTR *pwszDst, _Out_opt_ PDWORD pcwszDst)
+{
+    BOOL fResult;
+    if(!OB_STRMAP_IS_VALID(psm)) { return FALSE; }
+    AcquireSRWLockExclusive(&psm->LockSRW);
+    fResult = _ObStrMap_PushPtrW(psm, wsz, cwsz, pwszDst, pcwszDst);
+    ReleaseSRWLockExclusive(&psm->LockSRW);
+    return fResult;
+}
+
+/*
+* Finalize the string map into a multi-text allocation and update all string
+* pointers registered by ObStrMap_PushPtrW. The string map is DECREF'ed and
+* its pointer set to NULL regardless of the result.
+* CALLER LocalFree: *pwszMultiText
+* -- ppsm
+* -- pwszMultiText = the resulting multi-text.
+* -- pcbMultiText = byte length of the resulting multi-text.
+* -- return
+*/
+_Success_(return)
+BOOL ObStrMap_FinalizeAllocW_DECREF_NULL(_In_ POB_STRMAP *ppsm, _Out_ LPWSTR *pwszMultiText, _Out_ PDWORD pcbMultiText)
+{
+    DWORD i;
+    LPWSTR wszShrink;
+    POB_STRMAP psm = *ppsm;
+    POB_STRMAP_REF pRef;
+    BOOL fResult = FALSE;
+    *pwszMultiText = NULL;
+    *pcbMultiText = 0;
+    if(!OB_STRMAP_IS_VALID(psm)) { goto fail; }
+    AcquireSRWLockExclusive(&psm->LockSRW);
+    if(!psm->fError) {
+        if((psm->cwsz < psm->cwszMax) && (wszShrink = LocalReAlloc(psm->wsz, psm->cwsz * sizeof(WCHAR), LMEM_MOVEABLE))) {
+            psm->wsz = wszShrink;
+        }
+        for(i = 0; i < psm->cRef; i++) {
+            pRef = psm->pRef + i;
+            *pRef->pwsz = psm->wsz + pRef->owsz;
+            if(pRef->pcwsz) { *pRef->pcwsz = pRef->cwsz; }
+        }
+        *pwszMultiText = psm->wsz;
+        *pcbMultiText = psm->cwsz * sizeof(WCHAR);
+        psm->wsz = NULL;
+        fResult = TRUE;
+    }
+    ReleaseSRWLockExclusive(&psm->LockSRW);
+fail:
+    Ob_DECREF_NULL(ppsm);
+    return fResult;
+}
+
+/*
+* Create a new string map.
+* CALLER DECREF: return
+* -- return
+*/
+POB_STRMAP ObStrMap_New()
+{
+    POB_STRMAP psm;
+    if(!(psm = Ob_Alloc(OB_TAG_CORE_STRMAP, LMEM_ZEROINIT, sizeof(OB_STRMAP), _ObStrMap_ObCloseCallback, NULL))) { return NULL; }
+    InitializeSRWLock(&psm->LockSRW);
+    psm->cwszMax = OB_STRMAP_CWSZ_INITIAL;
+    psm->cRefMax = OB_STRMAP_CREF_INITIAL;
+    psm->cwsz = 1;      // offset zero is reserved for the empty string
+    if(!(psm->pmHash = ObMap_New(0))) { goto fail; }
+    if(!(psm->wsz = LocalAlloc(0, psm->cwszMax * sizeof(WCHAR)))) { goto fail; }
+    if(!(psm->pRef = LocalAlloc(0, psm->cRefMax * sizeof(OB_STRMAP_REF)))) { goto fail; }
+    psm->wsz[0] = 0;
+    return psm;
+fail:
+    Ob_DECREF(psm);
+    return NULL;
+}
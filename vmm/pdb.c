@@ -18,6 +18,11 @@
 #define VMMWIN_PDB_LOAD_ADDRESS_BASE    0x0000511f'00000000;
 #define VMMWIN_PDB_FAKEPROCHANDLE       (HANDLE)0x00005fed'6fed7fed
 #define VMMWIN_PDB_WARN_DEFAULT         "WARNING: Functionality may be limited. Extended debug information disabled.\n"
+#define PDB_CACHE_QUERY_MAX             0x200
+#define PDB_PREFETCH_WAIT_MS            250
+#define PDB_CACHE_SYMBOL                'S'
+#define PDB_CACHE_TYPESIZE              'T'
+#define PDB_CACHE_TYPECHILD             'C'
 
 typedef struct tdPDB_ENTRY {
     OB ObHdr;
@@ -32,6 +37,9 @@ typedef struct tdPDB_ENTRY {
     BOOL fLoadFailed;
     LPSTR szPath;
     QWORD qwLoadAddress;
+    HANDLE hEventPrefetch;      // signalled when a queued async prefetch is completed
+    BOOL fSymTableFailed;
+    struct tdPDB_SYMTABLE *pSymTable;   // sorted address->symbol table (built on 1st reverse lookup)
 } PDB_ENTRY, *PPDB_ENTRY;
 
 const LPSTR szVMMWIN_PDB_FUNCTIONS[] = {
@@ -70,6 +78,10 @@ typedef struct tdVMMWIN_PDB_CONTEXT {
     CRITICAL_SECTION Lock;
     POB_MAP pmPdbByHash;
     POB_MAP pmPdbByModule;
+    POB_MAP pmCache;            // query result cache: PDB_CACHE_ENTRY by hash of pdb hash & query
+    POB_SET psPrefetch;         // pdb hashes queued for async prefetch
+    volatile LONG fPrefetchActive;  // prefetch queue is being processed
+    volatile LONG cPrefetchThread;  // prefetch worker threads alive
     QWORD qwLoadAddressNext;
     union {
         VMMWIN_PDB_FUNCTIONS pfn;
@@ -77,6 +89,26 @@ typedef struct tdVMMWIN_PDB_CONTEXT {
     };
 } VMMWIN_PDB_CONTEXT, *PVMMWIN_PDB_CONTEXT;
 
+typedef struct tdPDB_CACHE_ENTRY {
+    QWORD hPDB;
+    BOOL fResult;
+    DWORD dwValue;
+    CHAR szQuery[];
+} PDB_CACHE_ENTRY, *PPDB_CACHE_ENTRY;
+
+typedef struct tdPDB_SYMTABLE_ENTRY {
+    DWORD dwRVA;
+    DWORD cb;
+    DWORD oName;                // offset of name in PDB_SYMTABLE.szNames
+} PDB_SYMTABLE_ENTRY, *PPDB_SYMTABLE_ENTRY;
+
+typedef struct tdPDB_SYMTABLE {
+    DWORD cEntry;
+    DWORD cbNames;
+    LPSTR szNames;
+    PDB_SYMTABLE_ENTRY pe[];    // sorted by dwRVA
+} PDB_SYMTABLE, *PPDB_SYMTABLE;
+
 typedef struct tdVMMWIN_PDB_INITIALIZE_KERNEL_PARAMETERS {
     PHANDLE phEventThreadStarted;
     BOOL fPdbInfo;
@@ -109,6 +141,8 @@ VOID PDB_CallbackCleanup_ObPdbEntry(PPDB_ENTRY pOb)
     LocalFree(pOb->szModuleName);
     LocalFree(pOb->szName);
     LocalFree(pOb->szPath);
+    if(pOb->hEventPrefetch) { CloseHandle(pOb->hEventPrefetch); }
+    LocalFree(pOb->pSymTable);
 }
 
 /*
@@ -216,6 +250,15 @@ PDB_HANDLE PDB_GetHandleFromModuleName(_In_ LPSTR szModuleName)
     }
     dwHashModule = PDB_HashModuleName(szModuleName);
     if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByModule, dwHashModule))) { return 0; }
+    if(pObPdbEntry->hEventPrefetch && (WAIT_TIMEOUT == WaitForSingleObject(pObPdbEntry->hEventPrefetch, PDB_PREFETCH_WAIT_MS))) {
+        // queued async prefetch of this module (low priority work) has not
+        // completed in time - load it synchronously. the prefetch worker will
+        // find it already loaded once it gets to it.
+        EnterCriticalSection(&ctx->Lock);
+        PDB_LoadEnsureEx(pObPdbEntry);
+        LeaveCriticalSection(&ctx->Lock);
+        SetEvent(pObPdbEntry->hEventPrefetch);
+    }
     qwHashPdb = pObPdbEntry->fLoadFailed ? 0 : pObPdbEntry->qwHash;
     Ob_DECREF(pObPdbEntry);
     return qwHashPdb;
@@ -266,6 +309,68 @@ BOOL PDB_LoadEnsure(_In_opt_ PDB_HANDLE hPDB)
     return fResult;
 }
 
+/*
+* Worker function for the async PDB prefetch. Load queued PDBs one at a time -
+* the PDB lock is released between each PDB to allow other queries to proceed.
+* -- ctx
+* -- return
+*/
+DWORD PDB_Prefetch_ThreadProc(_In_ PVMMWIN_PDB_CONTEXT ctx)
+{
+    QWORD qwPdbHash;
+    PPDB_ENTRY pObPdbEntry;
+    do {
+        while((qwPdbHash = ObSet_Pop(ctx->psPrefetch))) {
+            if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, qwPdbHash))) { continue; }
+            if(ctxVmm->Work.fEnabled) {
+                EnterCriticalSection(&ctx->Lock);
+                if(PDB_LoadEnsureEx(pObPdbEntry)) {
+                    vmmprintfvv_fn("Prefetched PDB '%s'.\n", pObPdbEntry->szName);
+                }
+                LeaveCriticalSection(&ctx->Lock);
+            }
+            SetEvent(pObPdbEntry->hEventPrefetch);
+            Ob_DECREF(pObPdbEntry);
+        }
+        InterlockedExchange(&ctx->fPrefetchActive, FALSE);
+    } while(ObSet_Size(ctx->psPrefetch) && !InterlockedCompareExchange(&ctx->fPrefetchActive, TRUE, FALSE));
+    InterlockedDecrement(&ctx->cPrefetchThread);    // NB! last access to ctx.
+    return 1;
+}
+
+/*
+* Queue a PDB for asynchronous loading in the background. Callers retrieving
+* the PDB handle by module name will wait briefly for the prefetch of the
+* module to complete and then load it synchronously - but will not wait for
+* the prefetch of any other modules.
+* -- hPDB
+*/
+VOID PDB_Prefetch(_In_opt_ PDB_HANDLE hPDB)
+{
+    PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
+    PPDB_ENTRY pObPdbEntry;
+    HANDLE hEvent;
+    if(!ctx || ctx->fDisabled || !hPDB) { return; }
+    if(hPDB == PDB_HANDLE_KERNEL) { hPDB = PDB_GetHandleFromModuleName("ntoskrnl"); }
+    if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, hPDB))) { return; }
+    if(!pObPdbEntry->qwLoadAddress && !pObPdbEntry->fLoadFailed && !pObPdbEntry->hEventPrefetch) {
+        if((hEvent = CreateEvent(NULL, TRUE, FALSE, NULL))) {
+            if(InterlockedCompareExchangePointer(&pObPdbEntry->hEventPrefetch, hEvent, NULL)) {
+                CloseHandle(hEvent);    // already queued by other thread
+            } else {
+                ObSet_Push(ctx->psPrefetch, hPDB);
+                if(!InterlockedCompareExchange(&ctx->fPrefetchActive, TRUE, FALSE)) {
+                    InterlockedIncrement(&ctx->cPrefetchThread);
+                    if(!VmmWorkEx((LPTHREAD_START_ROUTINE)PDB_Prefetch_ThreadProc, ctx, NULL, VMMWORK_PRIORITY_LOW)) {
+                        PDB_Prefetch_ThreadProc(ctx);   // work pool unavailable - process queue in caller
+                    }
+                }
+            }
+        }
+    }
+    Ob_DECREF(pObPdbEntry);
+}
+
 /*
 * Return the module name given a PDB handle.
 * -- hPDB
@@ -285,6 +390,248 @@ BOOL PDB_GetModuleName(_In_opt_ PDB_HANDLE hPDB, _Out_writes_(MAX_PATH) LPSTR sz
     return TRUE;
 }
 
+
+//-----------------------------------------------------------------------------
+// QUERY RESULT CACHE BELOW:
+// Results of symbol offset / type size / type child offset queries are cached
+// per PDB. Cache hits are served from the thread-safe map without taking the
+// PDB lock or calling into dbghelp.dll. Queries are cached as typed strings -
+// the string is verified on hit to rule out hash collisions.
+//-----------------------------------------------------------------------------
+
+/*
+* Build the cache query string and its key.
+* -- hPDB
+* -- chType = PDB_CACHE_*
+* -- szName
+* -- wszChildNameOpt
+* -- szQuery
+* -- pqwKey
+* -- return = TRUE if the query is cacheable.
+*/
+_Success_(return)
+BOOL PDB_CacheQuery(_In_ PDB_HANDLE hPDB, _In_ CHAR chType, _In_ LPSTR szName, _In_opt_ LPWSTR wszChildNameOpt, _Out_writes_(PDB_CACHE_QUERY_MAX) LPSTR szQuery, _Out_ PQWORD pqwKey)
+{
+    int cch;
+    cch = wszChildNameOpt ?
+        _snprintf_s(szQuery, PDB_CACHE_QUERY_MAX, _TRUNCATE, "%c:%s.%S", chType, szName, wszChildNameOpt) :
+        _snprintf_s(szQuery, PDB_CACHE_QUERY_MAX, _TRUNCATE, "%c:%s", chType, szName);
+    *pqwKey = ((hPDB >> 13) | (hPDB << 51)) + Util_HashStringA(szQuery);
+    return cch > 0;
+}
+
+/*
+* Retrieve a cached query result.
+* -- ctx
+* -- hPDB
+* -- szQuery
+* -- qwKey
+* -- pdwValue
+* -- pfResult
+* -- return = TRUE if found in cache.
+*/
+_Success_(return)
+BOOL PDB_CacheGet(_In_ PVMMWIN_PDB_CONTEXT ctx, _In_ PDB_HANDLE hPDB, _In_ LPSTR szQuery, _In_ QWORD qwKey, _Out_ PDWORD pdwValue, _Out_ PBOOL pfResult)
+{
+    PPDB_CACHE_ENTRY pe = ObMap_GetByKey(ctx->pmCache, qwKey);
+    if(!pe || (pe->hPDB != hPDB) || strcmp(pe->szQuery, szQuery)) { return FALSE; }
+    *pdwValue = pe->dwValue;
+    *pfResult = pe->fResult;
+    return TRUE;
+}
+
+/*
+* Store a query result in the cache. Results are never updated - the first
+* result for a query is kept.
+* -- ctx
+* -- hPDB
+* -- szQuery
+* -- qwKey
+* -- dwValue
+* -- fResult
+*/
+VOID PDB_CachePut(_In_ PVMMWIN_PDB_CONTEXT ctx, _In_ PDB_HANDLE hPDB, _In_ LPSTR szQuery, _In_ QWORD qwKey, _In_ DWORD dwValue, _In_ BOOL fResult)
+{
+    SIZE_T cch = strlen(szQuery);
+    PPDB_CACHE_ENTRY pe;
+    if(ObMap_ExistsKey(ctx->pmCache, qwKey)) { return; }
+    if(!(pe = LocalAlloc(0, sizeof(PDB_CACHE_ENTRY) + cch + 1))) { return; }
+    pe->hPDB = hPDB;
+    pe->fResult = fResult;
+    pe->dwValue = dwValue;
+    memcpy(pe->szQuery, szQuery, cch + 1);
+    if(!ObMap_Push(ctx->pmCache, qwKey, pe)) {
+        LocalFree(pe);
+    }
+}
+
+typedef struct tdPDB_CACHE_BULKLOAD_CONTEXT {
+    PVMMWIN_PDB_CONTEXT ctx;
+    PDB_HANDLE hPDB;
+    CHAR chType;
+} PDB_CACHE_BULKLOAD_CONTEXT, *PPDB_CACHE_BULKLOAD_CONTEXT;
+
+/*
+* Callback function for PDB_CacheBulkLoad() / SymEnumSymbols() / SymEnumTypesByName()
+*/
+BOOL PDB_CacheBulkLoad_Callback(_In_ PSYMBOL_INFO pSymInfo, _In_ ULONG SymbolSize, _In_ PPDB_CACHE_BULKLOAD_CONTEXT pBulk)
+{
+    QWORD qwKey;
+    DWORD dwValue = 0;
+    CHAR szQuery[PDB_CACHE_QUERY_MAX];
+    if(pBulk->chType == PDB_CACHE_SYMBOL) {
+        if(pSymInfo->Address - pSymInfo->ModBase < 0x10000000) {
+            dwValue = (DWORD)(pSymInfo->Address - pSymInfo->ModBase);
+        }
+    } else {
+        dwValue = pSymInfo->Size;
+    }
+    if(dwValue && PDB_CacheQuery(pBulk->hPDB, pBulk->chType, pSymInfo->Name, NULL, szQuery, &qwKey)) {
+        PDB_CachePut(pBulk->ctx, pBulk->hPDB, szQuery, qwKey, dwValue, TRUE);
+    }
+    return TRUE;
+}
+
+/*
+* Bulk-load the cache with all symbol offsets and type sizes of a PDB by one
+* enumeration of the PDB. Queries not found in the cache after a bulk-load are
+* still forwarded to dbghelp.dll (wildcard queries and type child offsets).
+* NB! the PDB lock must be held and the PDB must be loaded.
+* -- ctx
+* -- pPdbEntry
+*/
+VOID PDB_CacheBulkLoad(_In_ PVMMWIN_PDB_CONTEXT ctx, _In_ PPDB_ENTRY pPdbEntry)
+{
+    PDB_CACHE_BULKLOAD_CONTEXT Bulk = { 0 };
+    Bulk.ctx = ctx;
+    Bulk.hPDB = pPdbEntry->qwHash;
+    Bulk.chType = PDB_CACHE_SYMBOL;
+    ctx->pfn.SymEnumSymbols(ctx->hSym, pPdbEntry->qwLoadAddress, "*", (PSYM_ENUMERATESYMBOLS_CALLBACK)PDB_CacheBulkLoad_Callback, &Bulk);
+    Bulk.chType = PDB_CACHE_TYPESIZE;
+    ctx->pfn.SymEnumTypesByName(ctx->hSym, pPdbEntry->qwLoadAddress, "*", (PSYM_ENUMERATESYMBOLS_CALLBACK)PDB_CacheBulkLoad_Callback, &Bulk);
+    vmmprintfvv_fn("Cached %i symbols and types from '%s'.\n", ObMap_Size(ctx->pmCache), pPdbEntry->szName);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// REVERSE SYMBOL TABLE BELOW:
+// Address to symbol lookups are served from a per-PDB table of all symbols
+// sorted by RVA. The table is built by one enumeration of the PDB on the 1st
+// reverse lookup and is immutable once built - lookups are binary searches
+// which do not take the PDB lock or call into dbghelp.dll.
+//-----------------------------------------------------------------------------
+
+typedef struct tdPDB_SYMTABLE_BUILD_CONTEXT {
+    PPDB_SYMTABLE pt;           // NULL on the counting pass
+    DWORD c;
+    DWORD cbNames;
+} PDB_SYMTABLE_BUILD_CONTEXT, *PPDB_SYMTABLE_BUILD_CONTEXT;
+
+/*
+* Callback function for PDB_SymTableBuild() / SymEnumSymbols()
+*/
+BOOL PDB_SymTableBuild_Callback(_In_ PSYMBOL_INFO pSymInfo, _In_ ULONG SymbolSize, _In_ PPDB_SYMTABLE_BUILD_CONTEXT pBuild)
+{
+    PPDB_SYMTABLE_ENTRY pe;
+    DWORD cch;
+    if((pSymInfo->Address < pSymInfo->ModBase) || (pSymInfo->Address - pSymInfo->ModBase > 0xffffffff)) { return TRUE; }
+    if(!(cch = (DWORD)strnlen(pSymInfo->Name, MAX_SYM_NAME))) { return TRUE; }
+    if(pBuild->pt) {
+        if((pBuild->c >= pBuild->pt->cEntry) || (pBuild->cbNames + cch + 1 > pBuild->pt->cbNames)) { return FALSE; }
+        pe = pBuild->pt->pe + pBuild->c;
+        pe->dwRVA = (DWORD)(pSymInfo->Address - pSymInfo->ModBase);
+        pe->cb = pSymInfo->Size;
+        pe->oName = pBuild->cbNames;
+        memcpy(pBuild->pt->szNames + pBuild->cbNames, pSymInfo->Name, cch);
+        pBuild->pt->szNames[pBuild->cbNames + cch] = 0;
+    }
+    pBuild->c++;
+    pBuild->cbNames += cch + 1;
+    return TRUE;
+}
+
+/*
+* qsort comparator - order symbol table by RVA, then by name offset.
+*/
+int PDB_SymTableBuild_CmpSort(_In_ PPDB_SYMTABLE_ENTRY p1, _In_ PPDB_SYMTABLE_ENTRY p2)
+{
+    if(p1->dwRVA != p2->dwRVA) { return (p1->dwRVA < p2->dwRVA) ? -1 : 1; }
+    return (p1->oName < p2->oName) ? -1 : ((p1->oName > p2->oName) ? 1 : 0);
+}
+
+/*
+* Build the reverse symbol table of a PDB. The PDB is enumerated twice - once
+* to count the symbols and once to fill the table.
+* NB! the PDB lock must be held and the PDB must be loaded.
+* -- ctx
+* -- pPdbEntry
+*/
+VOID PDB_SymTableBuild(_In_ PVMMWIN_PDB_CONTEXT ctx, _In_ PPDB_ENTRY pPdbEntry)
+{
+    PPDB_SYMTABLE pt;
+    PDB_SYMTABLE_BUILD_CONTEXT Build = { 0 };
+    if(pPdbEntry->pSymTable || pPdbEntry->fSymTableFailed) { return; }
+    pPdbEntry->fSymTableFailed = TRUE;
+    ctx->pfn.SymEnumSymbols(ctx->hSym, pPdbEntry->qwLoadAddress, "*", (PSYM_ENUMERATESYMBOLS_CALLBACK)PDB_SymTableBuild_Callback, &Build);
+    if(!Build.c) { return; }
+    if(!(pt = LocalAlloc(0, sizeof(PDB_SYMTABLE) + Build.c * sizeof(PDB_SYMTABLE_ENTRY) + Build.cbNames))) { return; }
+    pt->cEntry = Build.c;
+    pt->cbNames = Build.cbNames;
+    pt->szNames = (LPSTR)(pt->pe + pt->cEntry);
+    Build.pt = pt;
+    Build.c = 0;
+    Build.cbNames = 0;
+    ctx->pfn.SymEnumSymbols(ctx->hSym, pPdbEntry->qwLoadAddress, "*", (PSYM_ENUMERATESYMBOLS_CALLBACK)PDB_SymTableBuild_Callback, &Build);
+    pt->cEntry = Build.c;
+    qsort(pt->pe, pt->cEntry, sizeof(PDB_SYMTABLE_ENTRY), (_CoreCrtNonSecureSearchSortCompareFunction)PDB_SymTableBuild_CmpSort);
+    vmmprintfvv_fn("Built reverse symbol table of %i symbols from '%s'.\n", pt->cEntry, pPdbEntry->szName);
+    pPdbEntry->fSymTableFailed = FALSE;
+    pPdbEntry->pSymTable = pt;
+}
+
+/*
+* Retrieve the reverse symbol table of a PDB - building it if required.
+* -- ctx
+* -- pPdbEntry
+* -- return = the table (owned by pPdbEntry) or NULL on fail.
+*/
+PPDB_SYMTABLE PDB_SymTableGet(_In_ PVMMWIN_PDB_CONTEXT ctx, _In_ PPDB_ENTRY pPdbEntry)
+{
+    if(!pPdbEntry->pSymTable && !pPdbEntry->fSymTableFailed) {
+        EnterCriticalSection(&ctx->Lock);
+        if(PDB_LoadEnsureEx(pPdbEntry)) {
+            PDB_SymTableBuild(ctx, pPdbEntry);
+        }
+        LeaveCriticalSection(&ctx->Lock);
+    }
+    return pPdbEntry->pSymTable;
+}
+
+/*
+* Lookup the closest symbol at or below an offset in the reverse symbol table.
+* -- pt
+* -- dwSymbolOffset
+* -- return = the symbol entry or NULL if no symbol precedes dwSymbolOffset.
+*/
+PPDB_SYMTABLE_ENTRY PDB_SymTableLookup(_In_ PPDB_SYMTABLE pt, _In_ DWORD dwSymbolOffset)
+{
+    DWORD iMin = 0, iMax = pt->cEntry, i;
+    while(iMin < iMax) {
+        i = (iMin + iMax) / 2;
+        if(pt->pe[i].dwRVA <= dwSymbolOffset) {
+            iMin = i + 1;
+        } else {
+            iMax = i;
+        }
+    }
+    if(!iMin) { return NULL; }
+    i = iMin - 1;
+    while(i && (pt->pe[i - 1].dwRVA == pt->pe[i].dwRVA)) { i--; }
+    return pt->pe + i;
+}
+
 /*
 * Callback function for PDB_GetSymbolOffset() / SymEnumSymbols()
 */
@@ -310,16 +657,18 @@ BOOL PDB_GetSymbolOffset(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szSymbolName, _Out
 {
     PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
     PPDB_ENTRY pObPdbEntry = NULL;
-    BOOL fResult = FALSE;
+    BOOL fResult = FALSE, fCache;
+    QWORD qwKey;
+    CHAR szQuery[PDB_CACHE_QUERY_MAX];
     if(!ctx || ctx->fDisabled || !hPDB) { return FALSE; }
     if(hPDB == PDB_HANDLE_KERNEL) { hPDB = PDB_GetHandleFromModuleName("ntoskrnl"); }
+    if((fCache = PDB_CacheQuery(hPDB, PDB_CACHE_SYMBOL, szSymbolName, NULL, szQuery, &qwKey)) && PDB_CacheGet(ctx, hPDB, szQuery, qwKey, pdwSymbolOffset, &fResult)) { return fResult; }
     if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, hPDB))) { return FALSE; }
     EnterCriticalSection(&ctx->Lock);
     if(!PDB_LoadEnsureEx(pObPdbEntry)) { goto fail; }
     *pdwSymbolOffset = 0;
-    if(!ctx->pfn.SymEnumSymbols(ctx->hSym, pObPdbEntry->qwLoadAddress, szSymbolName, PDB_GetSymbolOffset_Callback, pdwSymbolOffset)) { goto fail; }
-    if(!*pdwSymbolOffset) { goto fail; }
-    fResult = TRUE;
+    fResult = ctx->pfn.SymEnumSymbols(ctx->hSym, pObPdbEntry->qwLoadAddress, szSymbolName, PDB_GetSymbolOffset_Callback, pdwSymbolOffset) && *pdwSymbolOffset;
+    if(fCache) { PDB_CachePut(ctx, hPDB, szQuery, qwKey, *pdwSymbolOffset, fResult); }
 fail:
     LeaveCriticalSection(&ctx->Lock);
     Ob_DECREF(pObPdbEntry);
@@ -367,10 +716,31 @@ BOOL PDB_GetSymbolFromOffset(_In_opt_ PDB_HANDLE hPDB, _In_ DWORD dwSymbolOffset
     SYMBOL_INFO_PACKAGE SymbolInfo = { 0 };
     QWORD cch, qwDisplacement;
     PPDB_ENTRY pObPdbEntry = NULL;
+    PPDB_SYMTABLE pt;
+    PPDB_SYMTABLE_ENTRY pe;
     BOOL fResult = FALSE;
     if(!ctx || ctx->fDisabled || !hPDB) { return FALSE; }
     if(hPDB == PDB_HANDLE_KERNEL) { hPDB = PDB_GetHandleFromModuleName("ntoskrnl"); }
     if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, hPDB))) { return FALSE; }
+    if(pObPdbEntry->cbModuleSize && (dwSymbolOffset >= pObPdbEntry->cbModuleSize)) {
+        Ob_DECREF(pObPdbEntry);
+        return FALSE;
+    }
+    // 1: lookup in reverse symbol table (if possible)
+    if((pt = PDB_SymTableGet(ctx, pObPdbEntry))) {
+        if((pe = PDB_SymTableLookup(pt, dwSymbolOffset))) {
+            if(szSymbolName) {
+                strncpy_s(szSymbolName, MAX_PATH, pt->szNames + pe->oName, _TRUNCATE);
+            }
+            if(pdwSymbolDisplacement) {
+                *pdwSymbolDisplacement = dwSymbolOffset - pe->dwRVA;
+            }
+            fResult = TRUE;
+        }
+        Ob_DECREF(pObPdbEntry);
+        return fResult;
+    }
+    // 2: fallback to dbghelp.dll lookup
     EnterCriticalSection(&ctx->Lock);
     if(!PDB_LoadEnsureEx(pObPdbEntry)) { goto fail; }
     SymbolInfo.si.SizeOfStruct = sizeof(SYMBOL_INFO);
@@ -391,6 +761,51 @@ fail:
     return fResult;
 }
 
+/*
+* Query the PDB for the closest symbol names of multiple offsets in one call.
+* This is much faster than calling PDB_GetSymbolFromOffset() for each offset
+* when many offsets are resolved (e.g. thread start addresses).
+* -- hPDB
+* -- pSymbols
+* -- cSymbols
+* -- return = the number of successfully resolved offsets.
+*/
+DWORD PDB_GetSymbolFromOffsetBatch(_In_opt_ PDB_HANDLE hPDB, _Inout_updates_(cSymbols) PPDB_SYMBOLNAME pSymbols, _In_ DWORD cSymbols)
+{
+    PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
+    PPDB_ENTRY pObPdbEntry = NULL;
+    PPDB_SYMTABLE pt;
+    PPDB_SYMTABLE_ENTRY pe;
+    PPDB_SYMBOLNAME ps;
+    DWORD i, cResult = 0;
+    for(i = 0; i < cSymbols; i++) {
+        pSymbols[i].fResult = FALSE;
+    }
+    if(!ctx || ctx->fDisabled || !hPDB) { return 0; }
+    if(hPDB == PDB_HANDLE_KERNEL) { hPDB = PDB_GetHandleFromModuleName("ntoskrnl"); }
+    if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, hPDB))) { return 0; }
+    if(!(pt = PDB_SymTableGet(ctx, pObPdbEntry))) {
+        // no table - fallback to one dbghelp.dll lookup per offset
+        for(i = 0; i < cSymbols; i++) {
+            ps = pSymbols + i;
+            if((ps->fResult = PDB_GetSymbolFromOffset(hPDB, ps->dwSymbolOffset, ps->szSymbolName, &ps->dwSymbolDisplacement))) { cResult++; }
+        }
+        Ob_DECREF(pObPdbEntry);
+        return cResult;
+    }
+    for(i = 0; i < cSymbols; i++) {
+        ps = pSymbols + i;
+        if(pObPdbEntry->cbModuleSize && (ps->dwSymbolOffset >= pObPdbEntry->cbModuleSize)) { continue; }
+        if(!(pe = PDB_SymTableLookup(pt, ps->dwSymbolOffset))) { continue; }
+        strncpy_s(ps->szSymbolName, MAX_PATH, pt->szNames + pe->oName, _TRUNCATE);
+        ps->dwSymbolDisplacement = ps->dwSymbolOffset - pe->dwRVA;
+        ps->fResult = TRUE;
+        cResult++;
+    }
+    Ob_DECREF(pObPdbEntry);
+    return cResult;
+}
+
 /*
 * Read memory at the PDB acquired symbol offset. If szSymbolName contains
 * wildcard '?*' characters and matches multiple symbols the offset of the
@@ -440,16 +855,18 @@ BOOL PDB_GetTypeSize(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _Out_ PDWO
 {
     PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
     PPDB_ENTRY pObPdbEntry = NULL;
-    BOOL fResult = FALSE;
+    BOOL fResult = FALSE, fCache;
+    QWORD qwKey;
+    CHAR szQuery[PDB_CACHE_QUERY_MAX];
     if(!ctx || ctx->fDisabled || !hPDB) { return FALSE; }
     if(hPDB == PDB_HANDLE_KERNEL) { hPDB = PDB_GetHandleFromModuleName("ntoskrnl"); }
+    if((fCache = PDB_CacheQuery(hPDB, PDB_CACHE_TYPESIZE, szTypeName, NULL, szQuery, &qwKey)) && PDB_CacheGet(ctx, hPDB, szQuery, qwKey, pdwTypeSize, &fResult)) { return fResult; }
     if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, hPDB))) { return FALSE; }
     EnterCriticalSection(&ctx->Lock);
     if(!PDB_LoadEnsureEx(pObPdbEntry)) { goto fail; }
     *pdwTypeSize = 0;
-    if(!ctx->pfn.SymEnumTypesByName(ctx->hSym, pObPdbEntry->qwLoadAddress, szTypeName, PDB_GetTypeSize_Callback, pdwTypeSize)) { goto fail; }
-    if(!*pdwTypeSize) { goto fail; }
-    fResult = TRUE;
+    fResult = ctx->pfn.SymEnumTypesByName(ctx->hSym, pObPdbEntry->qwLoadAddress, szTypeName, PDB_GetTypeSize_Callback, pdwTypeSize) && *pdwTypeSize;
+    if(fCache) { PDB_CachePut(ctx, hPDB, szQuery, qwKey, *pdwTypeSize, fResult); }
 fail:
     LeaveCriticalSection(&ctx->Lock);
     Ob_DECREF(pObPdbEntry);
@@ -489,16 +906,19 @@ _Success_(return)
 BOOL PDB_GetTypeChildOffset(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _In_ LPWSTR wszTypeChildName, _Out_ PDWORD pdwTypeOffset)
 {
     PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
-    BOOL fResult = FALSE;
+    BOOL fResult = FALSE, fCache, fLoaded = FALSE;
     LPWSTR wszTypeChildSymName;
     PPDB_ENTRY pObPdbEntry = NULL;
     DWORD dwTypeId, cTypeChildren, iTypeChild;
     TI_FINDCHILDREN_PARAMS *pFindChildren = NULL;
+    QWORD qwKey;
+    CHAR szQuery[PDB_CACHE_QUERY_MAX];
     if(!ctx || ctx->fDisabled || !hPDB) { return FALSE; }
     if(hPDB == PDB_HANDLE_KERNEL) { hPDB = PDB_GetHandleFromModuleName("ntoskrnl"); }
+    if((fCache = PDB_CacheQuery(hPDB, PDB_CACHE_TYPECHILD, szTypeName, wszTypeChildName, szQuery, &qwKey)) && PDB_CacheGet(ctx, hPDB, szQuery, qwKey, pdwTypeOffset, &fResult)) { return fResult; }
     if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, hPDB))) { return FALSE; }
     EnterCriticalSection(&ctx->Lock);
-    if(!PDB_LoadEnsureEx(pObPdbEntry)) { goto fail; }
+    if(!(fLoaded = PDB_LoadEnsureEx(pObPdbEntry))) { goto fail; }
     if(!ctx->pfn.SymEnumTypesByName(ctx->hSym, pObPdbEntry->qwLoadAddress, szTypeName, PDB_GetTypeChildOffset_Callback, &dwTypeId) || !dwTypeId) { goto fail; }
     if(!ctx->pfn.SymGetTypeInfo(ctx->hSym, pObPdbEntry->qwLoadAddress, dwTypeId, TI_GET_CHILDRENCOUNT, &cTypeChildren) || !cTypeChildren) { goto fail; }
     if(!(pFindChildren = LocalAlloc(LMEM_ZEROINIT, sizeof(TI_FINDCHILDREN_PARAMS) + cTypeChildren * sizeof(ULONG)))) { goto fail; }
@@ -516,6 +936,7 @@ BOOL PDB_GetTypeChildOffset(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _In
         LocalFree(wszTypeChildSymName);
     }
 fail:
+    if(fCache && fLoaded) { PDB_CachePut(ctx, hPDB, szQuery, qwKey, fResult ? *pdwTypeOffset : 0, fResult); }
     LocalFree(pFindChildren);
     LeaveCriticalSection(&ctx->Lock);
     Ob_DECREF(pObPdbEntry);
@@ -543,8 +964,21 @@ BOOL PDB_GetTypeChildOffsetShort(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName
 VOID PDB_Close()
 {
     PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
+    PPDB_ENTRY pObPdbEntry;
+    QWORD qwPdbHash;
     if(!ctx) { return; }
     ctxVmm->pPdbContext = NULL;
+    // cancel any queued prefetch and wait for the prefetch worker to exit.
+    while((qwPdbHash = ObSet_Pop(ctx->psPrefetch))) {
+        if((pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, qwPdbHash))) {
+            SetEvent(pObPdbEntry->hEventPrefetch);
+            Ob_DECREF(pObPdbEntry);
+        }
+    }
+    // NB! if the work pool is closed its threads have already exited.
+    while(ctx->cPrefetchThread && ctxVmm->Work.fEnabled) {
+        SwitchToThread();
+    }
     EnterCriticalSection(&ctx->Lock);
     LeaveCriticalSection(&ctx->Lock);
     DeleteCriticalSection(&ctx->Lock);
@@ -553,6 +987,8 @@ VOID PDB_Close()
     }
     Ob_DECREF(ctx->pmPdbByHash);
     Ob_DECREF(ctx->pmPdbByModule);
+    Ob_DECREF(ctx->pmCache);
+    Ob_DECREF(ctx->psPrefetch);
     if(ctx->hModuleDbgHelp) { FreeLibrary(ctx->hModuleDbgHelp); }
     if(ctx->hModuleSymSrv) { FreeLibrary(ctx->hModuleSymSrv); }
     ZeroMemory(ctx, sizeof(VMMWIN_PDB_CONTEXT));
@@ -639,6 +1075,7 @@ DWORD PDB_Initialize_Async_Kernel_ThreadProc(LPVOID lpParameter)
         vmmprintf("%s         Reason: Unable to download kernel symbols to cache from Symbol Server.\n", VMMWIN_PDB_WARN_DEFAULT);
         goto fail;
     }
+    PDB_CacheBulkLoad(ctx, pObKernelEntry);
     vmmprintfvv_fn("Initialization of debug symbol .pdb functionality completed.\n    [ %s ]\n", ctxMain->pdb.szSymbolPath);
     ctx->fDisabled = FALSE;
     dwReturnStatus = 1;
@@ -748,6 +1185,8 @@ VOID PDB_Initialize(_In_opt_ PPE_CODEVIEW_INFO pPdbInfoOpt, _In_ BOOL fInitializ
     if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMWIN_PDB_CONTEXT)))) { goto fail; }
     if(!(ctx->pmPdbByHash = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) { goto fail; }
     if(!(ctx->pmPdbByModule = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) { goto fail; }
+    if(!(ctx->pmCache = ObMap_New(OB_MAP_FLAGS_OBJECT_LOCALFREE))) { goto fail; }
+    if(!(ctx->psPrefetch = ObSet_New())) { goto fail; }
     // 1: dynamic load of dbghelp.dll and symsrv.dll from directory of vmm.dll - i.e. not from system32
     Util_GetPathDll(szPathSymSrv, ctxVmm->hModuleVmm);
     Util_GetPathDll(szPathDbgHelp, ctxVmm->hModuleVmm);
@@ -809,6 +1248,8 @@ fail:
         }
         Ob_DECREF(ctx->pmPdbByHash);
         Ob_DECREF(ctx->pmPdbByModule);
+        Ob_DECREF(ctx->pmCache);
+        Ob_DECREF(ctx->psPrefetch);
         if(ctx->hModuleDbgHelp) { FreeLibrary(ctx->hModuleDbgHelp); }
         if(ctx->hModuleSymSrv) { FreeLibrary(ctx->hModuleSymSrv); }
     }
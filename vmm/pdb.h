@@ -12,6 +12,13 @@
 
 typedef QWORD                               PDB_HANDLE;
 
+typedef struct tdPDB_SYMBOLNAME {
+    DWORD dwSymbolOffset;                   // [in] offset from module base
+    DWORD dwSymbolDisplacement;             // [out] displacement from beginning of symbol
+    BOOL fResult;                           // [out] TRUE on success
+    CHAR szSymbolName[MAX_PATH];            // [out] symbol name
+} PDB_SYMBOLNAME, *PPDB_SYMBOLNAME;
+
 #define PDB_HANDLE_KERNEL                   ((PDB_HANDLE)-1)
 
 /*
@@ -66,6 +73,15 @@ PDB_HANDLE PDB_GetHandleFromModuleName(_In_ LPSTR szModuleName);
 _Success_(return)
 BOOL PDB_LoadEnsure(_In_opt_ PDB_HANDLE hPDB);
 
+/*
+* Queue a PDB for asynchronous loading in the background. Callers retrieving
+* the PDB handle by module name will wait briefly for the prefetch of the
+* module to complete and then load it synchronously - but will not wait for
+* the prefetch of any other modules.
+* -- hPDB
+*/
+VOID PDB_Prefetch(_In_opt_ PDB_HANDLE hPDB);
+
 /*
 * Return the module name given a PDB handle.
 * -- hPDB
@@ -111,6 +127,17 @@ BOOL PDB_GetSymbolAddress(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szSymbolName, _Ou
 _Success_(return)
 BOOL PDB_GetSymbolFromOffset(_In_opt_ PDB_HANDLE hPDB, _In_ DWORD dwSymbolOffset, _Out_writes_opt_(MAX_PATH) LPSTR szSymbolName, _Out_opt_ PDWORD pdwSymbolDisplacement);
 
+/*
+* Query the PDB for the closest symbol names of multiple offsets in one call.
+* This is much faster than calling PDB_GetSymbolFromOffset() for each offset
+* when many offsets are resolved (e.g. thread start addresses).
+* -- hPDB
+* -- pSymbols
+* -- cSymbols
+* -- return = the number of successfully resolved offsets.
+*/
+DWORD PDB_GetSymbolFromOffsetBatch(_In_opt_ PDB_HANDLE hPDB, _Inout_updates_(cSymbols) PPDB_SYMBOLNAME pSymbols, _In_ DWORD cSymbols);
+
 /*
 * Read memory at the PDB acquired symbol offset. If szSymbolName contains
 * wildcard '?*' characters and matches multiple symbols the offset of the
@@ -7,6 +7,7 @@
 //
 #include "vmm.h"
 #include "pe.h"
+#include "util.h"
 
 PIMAGE_NT_HEADERS PE_HeaderGetVerify(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD vaModuleBase, _Inout_ PBYTE pbModuleHeader, _Out_opt_ PBOOL pfHdr32)
 {
@@ -26,6 +27,101 @@ PIMAGE_NT_HEADERS PE_HeaderGetVerify(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD
     return ntHeader;
 }
 
+//-----------------------------------------------------------------------------
+// MODULE CACHE - PROCESS INDEPENDENT PARSE RESULTS KEYED BY IMAGE IDENTITY:
+//-----------------------------------------------------------------------------
+
+typedef struct tdPE_OB_MODULECACHE_CODEVIEW {
+    OB ObHdr;
+    PE_CODEVIEW_INFO Info;
+} PE_OB_MODULECACHE_CODEVIEW, *PPE_OB_MODULECACHE_CODEVIEW;
+
+// module cache map entry - the full key is kept for verification on lookup.
+typedef struct tdPE_OB_MODULECACHE_ENTRY {
+    OB ObHdr;
+    PE_MODULECACHE_KEY Key;
+    PVOID pObValue;
+} PE_OB_MODULECACHE_ENTRY, *PPE_OB_MODULECACHE_ENTRY;
+
+VOID PE_ModuleCacheEntry_CloseObCallback(_In_ PVOID pOb)
+{
+    Ob_DECREF(((PPE_OB_MODULECACHE_ENTRY)pOb)->pObValue);
+}
+
+VOID PE_ModuleCacheKey(_In_reads_(0x1000) PBYTE pbModuleHeader, _Out_ PPE_MODULECACHE_KEY pKey)
+{
+    BOOL f32;
+    QWORD qwHash;
+    PIMAGE_NT_HEADERS ntHeader;
+    PIMAGE_NT_HEADERS32 ntHeader32;
+    ZeroMemory(pKey, sizeof(PE_MODULECACHE_KEY));
+    if(!(ntHeader = PE_HeaderGetVerify(NULL, 0, pbModuleHeader, &f32))) { return; }
+    if(!ntHeader->FileHeader.TimeDateStamp) { return; }
+    ntHeader32 = (PIMAGE_NT_HEADERS32)ntHeader;
+    pKey->dwTimeDateStamp = ntHeader->FileHeader.TimeDateStamp;
+    pKey->cSections = ntHeader->FileHeader.NumberOfSections;
+    pKey->wMagic = ntHeader->OptionalHeader.Magic;
+    pKey->cbSizeOfImage = f32 ? ntHeader32->OptionalHeader.SizeOfImage : ntHeader->OptionalHeader.SizeOfImage;
+    pKey->dwCheckSum = f32 ? ntHeader32->OptionalHeader.CheckSum : ntHeader->OptionalHeader.CheckSum;
+    pKey->dwAddressOfEntryPoint = f32 ? ntHeader32->OptionalHeader.AddressOfEntryPoint : ntHeader->OptionalHeader.AddressOfEntryPoint;
+    qwHash = ((QWORD)pKey->dwCheckSum << 32) | pKey->dwAddressOfEntryPoint;
+    qwHash = _rotl64(qwHash * 0x9e3779b97f4a7c15, 31);
+    qwHash ^= ((QWORD)pKey->dwTimeDateStamp << 32) | pKey->cbSizeOfImage;
+    qwHash ^= ((QWORD)pKey->cSections << 8) | (f32 ? 1 : 2);
+    pKey->qwHash = qwHash ? qwHash : 1;
+}
+
+_Success_(return != NULL)
+PVOID PE_ModuleCacheGet(_In_ DWORD tp, _In_ PPE_MODULECACHE_KEY pKey)
+{
+    PVOID pvOb = NULL;
+    PPE_OB_MODULECACHE_ENTRY pObEntry;
+    if(!pKey->qwHash || (tp >= PE_MODULECACHE_TP_MAX)) { return NULL; }
+    if((pObEntry = ObMap_GetByKey(ctxVmm->ModuleCache.pm[tp], pKey->qwHash))) {
+        if(!memcmp(&pObEntry->Key, pKey, sizeof(PE_MODULECACHE_KEY))) {
+            pvOb = Ob_INCREF(pObEntry->pObValue);
+        }
+        Ob_DECREF(pObEntry);
+    }
+    if(pvOb) {
+        InterlockedIncrement64(&ctxVmm->stat.cModuleCacheHit);
+    } else {
+        InterlockedIncrement64(&ctxVmm->stat.cModuleCacheMiss);
+    }
+    return pvOb;
+}
+
+VOID PE_ModuleCachePut(_In_ DWORD tp, _In_ PPE_MODULECACHE_KEY pKey, _In_ PVOID pvOb)
+{
+    DWORD c;
+    QWORD qwKeyEvict;
+    POB_MAP pm;
+    PPE_OB_MODULECACHE_ENTRY pObEntry;
+    if(!pKey->qwHash || (tp >= PE_MODULECACHE_TP_MAX)) { return; }
+    pm = ctxVmm->ModuleCache.pm[tp];
+    // hash collision with a different image -> replace the existing entry.
+    if((pObEntry = ObMap_GetByKey(pm, pKey->qwHash))) {
+        if(!memcmp(&pObEntry->Key, pKey, sizeof(PE_MODULECACHE_KEY))) {
+            Ob_DECREF(pObEntry);
+            return;
+        }
+        Ob_DECREF(pObEntry);
+        Ob_DECREF(ObMap_RemoveByKey(pm, pKey->qwHash));
+    }
+    // evict a single entry (rotating position) if full.
+    if((c = ObMap_Size(pm)) >= PE_MODULECACHE_MAX_ENTRIES) {
+        if((pObEntry = ObMap_GetByIndexWithKey(pm, (DWORD)InterlockedIncrement(&ctxVmm->ModuleCache.iEvict[tp]) % c, &qwKeyEvict))) {
+            Ob_DECREF(pObEntry);
+            Ob_DECREF(ObMap_RemoveByKey(pm, qwKeyEvict));
+        }
+    }
+    if(!(pObEntry = Ob_Alloc(OB_TAG_PE_MODULECACHE, 0, sizeof(PE_OB_MODULECACHE_ENTRY), PE_ModuleCacheEntry_CloseObCallback, NULL))) { return; }
+    memcpy(&pObEntry->Key, pKey, sizeof(PE_MODULECACHE_KEY));
+    pObEntry->pObValue = Ob_INCREF(pvOb);
+    ObMap_Push(pm, pKey->qwHash, pObEntry);
+    Ob_DECREF(pObEntry);
+}
+
 QWORD PE_GetSize(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD vaModuleBase)
 {
     BYTE pbHeader[0x1000] = { 0 };
@@ -156,22 +252,60 @@ fail:
     return FALSE;
 }
 
-_Success_(return)
-BOOL PE_GetThunkInfoEAT(_In_ PVMM_PROCESS pProcess, _In_ QWORD vaModuleBase, _In_ LPSTR szProcName, _Out_ PPE_THUNKINFO_EAT pThunkInfoEAT)
+//-----------------------------------------------------------------------------
+// EXPORT ADDRESS TABLE HASH INDEX:
+// Export names are indexed into an open addressing hash table on first use.
+// The index is process independent (RVAs only) and is shared between all
+// mappings of the same image in the module cache.
+//-----------------------------------------------------------------------------
+
+typedef struct tdPE_EATINDEX_ENTRY {
+    DWORD dwHash;
+    DWORD rvaName;
+    DWORD rvaFunction;
+    DWORD oszName;              // offset of name in szMultiText
+    DWORD iOrdinal;             // index into AddressOfFunctions
+} PE_EATINDEX_ENTRY, *PPE_EATINDEX_ENTRY;
+
+typedef struct tdPE_OB_EATINDEX {
+    OB ObHdr;
+    DWORD rvaAddressOfFunctions;
+    DWORD cEntry;
+    DWORD dwHashMask;           // hash table size - 1
+    PDWORD pdwHashTable;        // entry index + 1 (0 = empty slot)
+    PPE_EATINDEX_ENTRY pEntry;
+    LPSTR szMultiText;
+    BYTE pbData[];
+} PE_OB_EATINDEX, *PPE_OB_EATINDEX;
+
+/*
+* Build an export name hash index by reading the export directory of a module.
+* The index is stored in the module cache if the whole directory was read.
+* CALLER DECREF: return
+* -- pProcess
+* -- vaModuleBase
+* -- return
+*/
+_Success_(return != NULL)
+PPE_OB_EATINDEX PE_EatIndex_Get(_In_ PVMM_PROCESS pProcess, _In_ QWORD vaModuleBase)
 {
     BYTE pbModuleHeader[0x1000] = { 0 };
     PIMAGE_NT_HEADERS32 ntHeader32;
     PIMAGE_NT_HEADERS64 ntHeader64;
+    PIMAGE_EXPORT_DIRECTORY exp;
     PDWORD pdwRVAAddrNames, pdwRVAAddrFunctions;
     PWORD pwNameOrdinals;
-    DWORD i, cbProcName, cbExportDirectoryOffset, cbRead = 0;
-    LPSTR sz;
-    QWORD vaExportDirectory;
-    DWORD cbExportDirectory;
+    DWORD i, j, cHash, cchName, cbNames = 0, cbRead = 0, cbExportDirectoryOffset, cbExportDirectory;
+    PE_MODULECACHE_KEY ModuleCacheKey;
+    QWORD vaExportDirectory, vaRVAAddrNames, vaNameOrdinals, vaRVAAddrFunctions;
     PBYTE pbExportDirectory = NULL;
-    QWORD vaRVAAddrNames, vaNameOrdinals, vaRVAAddrFunctions;
+    PPE_OB_EATINDEX pObIndex = NULL;
+    PPE_EATINDEX_ENTRY pe;
+    LPSTR sz;
     BOOL f32;
-    if(!(ntHeader64 = PE_HeaderGetVerify(pProcess, vaModuleBase, pbModuleHeader, &f32))) { goto cleanup; }
+    if(!(ntHeader64 = PE_HeaderGetVerify(pProcess, vaModuleBase, pbModuleHeader, &f32))) { goto fail; }
+    PE_ModuleCacheKey(pbModuleHeader, &ModuleCacheKey);
+    if((pObIndex = PE_ModuleCacheGet(PE_MODULECACHE_TP_EATINDEX, &ModuleCacheKey))) { return pObIndex; }
     if(f32) { // 32-bit PE
         ntHeader32 = (PIMAGE_NT_HEADERS32)ntHeader64;
         vaExportDirectory = vaModuleBase + ntHeader32->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress;
@@ -180,40 +314,101 @@ BOOL PE_GetThunkInfoEAT(_In_ PVMM_PROCESS pProcess, _In_ QWORD vaModuleBase, _In
         vaExportDirectory = vaModuleBase + ntHeader64->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress;
         cbExportDirectory = ntHeader64->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].Size;
     }
-    if((cbExportDirectory < sizeof(IMAGE_EXPORT_DIRECTORY)) || (cbExportDirectory > 0x01000000) || (vaExportDirectory == vaModuleBase) || (vaExportDirectory > vaModuleBase + 0x80000000)) { goto cleanup; }
-    if(!(pbExportDirectory = LocalAlloc(0, cbExportDirectory))) { goto cleanup; }
+    if((cbExportDirectory < sizeof(IMAGE_EXPORT_DIRECTORY)) || (cbExportDirectory > 0x01000000) || (vaExportDirectory == vaModuleBase) || (vaExportDirectory > vaModuleBase + 0x80000000)) { goto fail; }
+    if(!(pbExportDirectory = LocalAlloc(0, cbExportDirectory))) { goto fail; }
     VmmReadEx(pProcess, vaExportDirectory, pbExportDirectory, cbExportDirectory, &cbRead, VMM_FLAG_ZEROPAD_ON_FAIL);
-    if(!cbRead) { goto cleanup; }
-    PIMAGE_EXPORT_DIRECTORY exp = (PIMAGE_EXPORT_DIRECTORY)pbExportDirectory;
-    if(!exp || !exp->NumberOfNames || !exp->AddressOfNames) { goto cleanup; }
+    if(!cbRead) { goto fail; }
+    exp = (PIMAGE_EXPORT_DIRECTORY)pbExportDirectory;
+    if(!exp->NumberOfNames || !exp->AddressOfNames) { goto fail; }
     vaRVAAddrNames = vaModuleBase + exp->AddressOfNames;
     vaNameOrdinals = vaModuleBase + exp->AddressOfNameOrdinals;
     vaRVAAddrFunctions = vaModuleBase + exp->AddressOfFunctions;
-    if((vaRVAAddrNames < vaExportDirectory) || (vaRVAAddrNames > vaExportDirectory + cbExportDirectory - exp->NumberOfNames * sizeof(DWORD))) { goto cleanup; }
-    if((vaNameOrdinals < vaExportDirectory) || (vaNameOrdinals > vaExportDirectory + cbExportDirectory - exp->NumberOfNames * sizeof(WORD))) { goto cleanup; }
-    if((vaRVAAddrFunctions < vaExportDirectory) || (vaRVAAddrFunctions > vaExportDirectory + cbExportDirectory - exp->NumberOfNames * sizeof(DWORD))) { goto cleanup; }
-    cbProcName = (DWORD)strnlen_s(szProcName, MAX_PATH) + 1;
+    if((vaRVAAddrNames < vaExportDirectory) || (vaRVAAddrNames > vaExportDirectory + cbExportDirectory - exp->NumberOfNames * sizeof(DWORD))) { goto fail; }
+    if((vaNameOrdinals < vaExportDirectory) || (vaNameOrdinals > vaExportDirectory + cbExportDirectory - exp->NumberOfNames * sizeof(WORD))) { goto fail; }
+    if((vaRVAAddrFunctions < vaExportDirectory) || (vaRVAAddrFunctions > vaExportDirectory + cbExportDirectory - exp->NumberOfNames * sizeof(DWORD))) { goto fail; }
     cbExportDirectoryOffset = (DWORD)(vaExportDirectory - vaModuleBase);
     pdwRVAAddrNames = (PDWORD)(pbExportDirectory + exp->AddressOfNames - cbExportDirectoryOffset);
     pwNameOrdinals = (PWORD)(pbExportDirectory + exp->AddressOfNameOrdinals - cbExportDirectoryOffset);
     pdwRVAAddrFunctions = (PDWORD)(pbExportDirectory + exp->AddressOfFunctions - cbExportDirectoryOffset);
+    // 1: calculate required size and allocate
     for(i = 0; i < exp->NumberOfNames; i++) {
-        if(pdwRVAAddrNames[i] - cbExportDirectoryOffset + cbProcName > cbExportDirectory) { continue; }
+        if(pdwRVAAddrNames[i] - cbExportDirectoryOffset >= cbExportDirectory) { continue; }
         sz = (LPSTR)(pbExportDirectory + pdwRVAAddrNames[i] - cbExportDirectoryOffset);
-        if(0 == memcmp(sz, szProcName, cbProcName)) {
-            if(pwNameOrdinals[i] >= exp->NumberOfFunctions) { goto cleanup; }
-            pThunkInfoEAT->fValid = TRUE;
-            pThunkInfoEAT->vaFunction = (QWORD)(vaModuleBase + pdwRVAAddrFunctions[pwNameOrdinals[i]]);
-            pThunkInfoEAT->valueThunk = pdwRVAAddrFunctions[pwNameOrdinals[i]];
-            pThunkInfoEAT->vaThunk = vaExportDirectory + exp->AddressOfFunctions - cbExportDirectoryOffset + sizeof(DWORD) * pwNameOrdinals[i];
-            pThunkInfoEAT->vaNameFunction = vaExportDirectory + pdwRVAAddrNames[i] - cbExportDirectoryOffset;
-            LocalFree(pbExportDirectory);
-            return TRUE;
+        cbNames += (DWORD)strnlen_s(sz, min(MAX_PATH, cbExportDirectory - (pdwRVAAddrNames[i] - cbExportDirectoryOffset))) + 1;
+    }
+    for(cHash = 0x10; cHash < 2 * exp->NumberOfNames; cHash <<= 1);
+    pObIndex = Ob_Alloc(OB_TAG_PE_MODULECACHE, LMEM_ZEROINIT, sizeof(PE_OB_EATINDEX) + cHash * sizeof(DWORD) + exp->NumberOfNames * sizeof(PE_EATINDEX_ENTRY) + cbNames, NULL, NULL);
+    if(!pObIndex) { goto fail; }
+    pObIndex->rvaAddressOfFunctions = exp->AddressOfFunctions;
+    pObIndex->dwHashMask = cHash - 1;
+    pObIndex->pdwHashTable = (PDWORD)pObIndex->pbData;
+    pObIndex->pEntry = (PPE_EATINDEX_ENTRY)(pObIndex->pdwHashTable + cHash);
+    pObIndex->szMultiText = (LPSTR)(pObIndex->pEntry + exp->NumberOfNames);
+    // 2: populate entries and hash table (first occurrence of name wins)
+    for(i = 0, cbNames = 0; i < exp->NumberOfNames; i++) {
+        if(pdwRVAAddrNames[i] - cbExportDirectoryOffset >= cbExportDirectory) { continue; }
+        if(pwNameOrdinals[i] >= exp->NumberOfFunctions) { continue; }
+        if((QWORD)(pdwRVAAddrFunctions + pwNameOrdinals[i] + 1) > (QWORD)(pbExportDirectory + cbExportDirectory)) { continue; }
+        sz = (LPSTR)(pbExportDirectory + pdwRVAAddrNames[i] - cbExportDirectoryOffset);
+        cchName = (DWORD)strnlen_s(sz, min(MAX_PATH, cbExportDirectory - (pdwRVAAddrNames[i] - cbExportDirectoryOffset)));
+        pe = pObIndex->pEntry + pObIndex->cEntry;
+        pe->oszName = cbNames;
+        memcpy(pObIndex->szMultiText + cbNames, sz, cchName);
+        cbNames += cchName + 1;
+        pe->dwHash = Util_HashStringA(pObIndex->szMultiText + pe->oszName);
+        pe->rvaName = pdwRVAAddrNames[i];
+        pe->iOrdinal = pwNameOrdinals[i];
+        pe->rvaFunction = pdwRVAAddrFunctions[pe->iOrdinal];
+        for(j = pe->dwHash & pObIndex->dwHashMask; pObIndex->pdwHashTable[j]; j = (j + 1) & pObIndex->dwHashMask) {
+            if(!strcmp(pObIndex->szMultiText + pObIndex->pEntry[pObIndex->pdwHashTable[j] - 1].oszName, pObIndex->szMultiText + pe->oszName)) { break; }
+        }
+        if(!pObIndex->pdwHashTable[j]) {
+            pObIndex->pdwHashTable[j] = ++pObIndex->cEntry;
         }
     }
-cleanup:
+    if(cbRead == cbExportDirectory) {
+        PE_ModuleCachePut(PE_MODULECACHE_TP_EATINDEX, &ModuleCacheKey, pObIndex);
+    }
+fail:
     LocalFree(pbExportDirectory);
-    return FALSE;
+    return pObIndex;
+}
+
+/*
+* Lookup a name in the export name hash index.
+* -- pIndex
+* -- szProcName
+* -- return = the entry or NULL if not found.
+*/
+PPE_EATINDEX_ENTRY PE_EatIndex_Lookup(_In_ PPE_OB_EATINDEX pIndex, _In_ LPSTR szProcName)
+{
+    DWORD j, dwHash;
+    PPE_EATINDEX_ENTRY pe;
+    dwHash = Util_HashStringA(szProcName);
+    for(j = dwHash & pIndex->dwHashMask; pIndex->pdwHashTable[j]; j = (j + 1) & pIndex->dwHashMask) {
+        pe = pIndex->pEntry + pIndex->pdwHashTable[j] - 1;
+        if((pe->dwHash == dwHash) && !strcmp(pIndex->szMultiText + pe->oszName, szProcName)) {
+            return pe;
+        }
+    }
+    return NULL;
+}
+
+_Success_(return)
+BOOL PE_GetThunkInfoEAT(_In_ PVMM_PROCESS pProcess, _In_ QWORD vaModuleBase, _In_ LPSTR szProcName, _Out_ PPE_THUNKINFO_EAT pThunkInfoEAT)
+{
+    PPE_OB_EATINDEX pObIndex;
+    PPE_EATINDEX_ENTRY pe;
+    if(!(pObIndex = PE_EatIndex_Get(pProcess, vaModuleBase))) { return FALSE; }
+    if((pe = PE_EatIndex_Lookup(pObIndex, szProcName))) {
+        pThunkInfoEAT->fValid = TRUE;
+        pThunkInfoEAT->vaFunction = vaModuleBase + pe->rvaFunction;
+        pThunkInfoEAT->valueThunk = pe->rvaFunction;
+        pThunkInfoEAT->vaThunk = vaModuleBase + pObIndex->rvaAddressOfFunctions + sizeof(DWORD) * (QWORD)pe->iOrdinal;
+        pThunkInfoEAT->vaNameFunction = vaModuleBase + pe->rvaName;
+    }
+    Ob_DECREF(pObIndex);
+    return pe ? TRUE : FALSE;
 }
 
 QWORD PE_GetProcAddress(_In_ PVMM_PROCESS pProcess, _In_ QWORD vaModuleBase, _In_ LPSTR lpProcName)
@@ -223,6 +418,23 @@ QWORD PE_GetProcAddress(_In_ PVMM_PROCESS pProcess, _In_ QWORD vaModuleBase, _In
     return oThunkInfoEAT.vaFunction;
 }
 
+DWORD PE_GetProcAddressBatch(_In_ PVMM_PROCESS pProcess, _In_ QWORD vaModuleBase, _In_ DWORD cProcNames, _In_reads_(cProcNames) LPSTR *pszProcNames, _Out_writes_(cProcNames) PQWORD pvaProcAddresses)
+{
+    DWORD i, cFound = 0;
+    PPE_OB_EATINDEX pObIndex;
+    PPE_EATINDEX_ENTRY pe;
+    ZeroMemory(pvaProcAddresses, cProcNames * sizeof(QWORD));
+    if(!(pObIndex = PE_EatIndex_Get(pProcess, vaModuleBase))) { return 0; }
+    for(i = 0; i < cProcNames; i++) {
+        if(pszProcNames[i] && (pe = PE_EatIndex_Lookup(pObIndex, pszProcNames[i]))) {
+            pvaProcAddresses[i] = vaModuleBase + pe->rvaFunction;
+            cFound++;
+        }
+    }
+    Ob_DECREF(pObIndex);
+    return cFound;
+}
+
 WORD PE_SectionGetNumberOfEx(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD vaModuleBase, _In_reads_opt_(0x1000) PBYTE pbModuleHeaderOpt)
 {
     BOOL f32;
@@ -417,11 +629,20 @@ BOOL PE_GetCodeViewInfo(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD vaModuleBase,
     DWORD i, iMax, cbImageSize, cbDebugDirectory;
     PBYTE pbDebugDirectory = NULL;
     PIMAGE_DEBUG_DIRECTORY pDebugDirectory;
+    PE_MODULECACHE_KEY ModuleCacheKey;
+    PPE_OB_MODULECACHE_CODEVIEW pObCodeView;
     ZeroMemory(pCodeViewInfo, sizeof(PE_CODEVIEW_INFO));
     // load both 32/64 bit ntHeader unless already supplied in parameter (only one of 32/64 bit hdr will be valid)
     // load nt header either by using optionally supplied module header or by fetching from memory.
     ntHeader = pbModuleHeaderOpt ? PE_HeaderGetVerify(pProcess, 0, pbModuleHeaderOpt, &f32) : PE_HeaderGetVerify(pProcess, vaModuleBase, pbModuleHeader, &f32);
     if(!ntHeader) { return FALSE; }
+    // codeview info is identical for all mappings of the image - check module cache.
+    PE_ModuleCacheKey(pbModuleHeaderOpt ? pbModuleHeaderOpt : pbModuleHeader, &ModuleCacheKey);
+    if((pObCodeView = PE_ModuleCacheGet(PE_MODULECACHE_TP_CODEVIEW, &ModuleCacheKey))) {
+        memcpy(pCodeViewInfo, &pObCodeView->Info, sizeof(PE_CODEVIEW_INFO));
+        Ob_DECREF(pObCodeView);
+        return TRUE;
+    }
     if(!f32) { // 64-bit PE
         ntHeader64 = (PIMAGE_NT_HEADERS64)ntHeader;
         vaDebugDirectory = vaModuleBase + ntHeader64->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_DEBUG].VirtualAddress;
@@ -447,6 +668,11 @@ BOOL PE_GetCodeViewInfo(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD vaModuleBase,
             (pCodeViewInfo->CodeView.Signature == 0x53445352) &&
             (pCodeViewInfo->SizeCodeView = pDebugDirectory->SizeOfData);
         if(f) {
+            if((pObCodeView = Ob_Alloc(OB_TAG_PE_MODULECACHE, 0, sizeof(PE_OB_MODULECACHE_CODEVIEW), NULL, NULL))) {
+                memcpy(&pObCodeView->Info, pCodeViewInfo, sizeof(PE_CODEVIEW_INFO));
+                PE_ModuleCachePut(PE_MODULECACHE_TP_CODEVIEW, &ModuleCacheKey, pObCodeView);
+                Ob_DECREF(pObCodeView);
+            }
             LocalFree(pbDebugDirectory);
             return TRUE;
         }
@@ -86,6 +86,25 @@ QWORD PE_GetProcAddress(
     _In_ LPSTR lpProcName
 );
 
+/*
+* Lookup the virtual addresses of multiple exported functions or symbols in the
+* module supplied. The export directory is read and indexed once regardless of
+* the number of names looked up.
+* -- pProcess
+* -- vaModuleBase = PE module base address.
+* -- cProcNames
+* -- pszProcNames
+* -- pvaProcAddresses = receives the virtual address of each name (0 if not found).
+* -- return = number of names found.
+*/
+DWORD PE_GetProcAddressBatch(
+    _In_ PVMM_PROCESS pProcess,
+    _In_ QWORD vaModuleBase,
+    _In_ DWORD cProcNames,
+    _In_reads_(cProcNames) LPSTR *pszProcNames,
+    _Out_writes_(cProcNames) PQWORD pvaProcAddresses
+);
+
 /*
 * Lookup the virtual address of an exported function or symbol in the module supplied
 * among with additional information returned in the pThunkInfoEAT struct.
@@ -317,4 +336,53 @@ BOOL PE_FileRaw_Write(
     _In_ DWORD cbOffset
 );
 
+#define PE_MODULECACHE_TP_EAT               0   // parsed export address table
+#define PE_MODULECACHE_TP_SIZE              1   // display buffer and raw file sizes
+#define PE_MODULECACHE_TP_CODEVIEW          2   // PE_CODEVIEW_INFO
+#define PE_MODULECACHE_TP_EATINDEX          3   // export name hash index
+#define PE_MODULECACHE_TP_MAX               4
+#define PE_MODULECACHE_MAX_ENTRIES          0x800   // per type - one entry is evicted per insert when full
+
+typedef struct tdPE_MODULECACHE_KEY {
+    QWORD qwHash;                   // map key - 0 = invalid key
+    DWORD dwTimeDateStamp;
+    DWORD cbSizeOfImage;
+    DWORD dwCheckSum;
+    DWORD dwAddressOfEntryPoint;
+    WORD cSections;
+    WORD wMagic;
+    DWORD _Filler;
+} PE_MODULECACHE_KEY, *PPE_MODULECACHE_KEY;
+
+/*
+* Retrieve the image identity key of a PE module header. The key consists of
+* the TimeDateStamp, SizeOfImage, CheckSum and other header values that are
+* identical for all mappings of the same image regardless of process and load
+* address. Process independent parse results may be shared between all
+* processes in the module cache using this key. The map hash of the key may
+* collide - the full identity is verified on lookup.
+* -- pbModuleHeader = module header (MZ) page.
+* -- pKey = the key, qwHash is 0 on fail.
+*/
+VOID PE_ModuleCacheKey(_In_reads_(0x1000) PBYTE pbModuleHeader, _Out_ PPE_MODULECACHE_KEY pKey);
+
+/*
+* Retrieve a process independent parse result from the module cache.
+* CALLER DECREF: return
+* -- tp = PE_MODULECACHE_TP_*
+* -- pKey = key as retrieved by PE_ModuleCacheKey().
+* -- return
+*/
+_Success_(return != NULL)
+PVOID PE_ModuleCacheGet(_In_ DWORD tp, _In_ PPE_MODULECACHE_KEY pKey);
+
+/*
+* Store a process independent parse result in the module cache. Results shall
+* not be modified after being stored. If an entry already exists it's kept.
+* -- tp = PE_MODULECACHE_TP_*
+* -- pKey = key as retrieved by PE_ModuleCacheKey().
+* -- pvOb = object manager object to store.
+*/
+VOID PE_ModuleCachePut(_In_ DWORD tp, _In_ PPE_MODULECACHE_KEY pKey, _In_ PVOID pvOb);
+
 #endif /* __PE_H__ */
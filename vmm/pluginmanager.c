@@ -27,14 +27,67 @@
 // A pProcess struct (if applicable) and a PID is also given in each call
 // together with the module name and path.
 //
+// In lazy mode (-pluginlazy) native plugin DLLs and the python plugin manager
+// are not loaded at startup. Their registrations are instead read from a small
+// cache file (recorded when the plugin was last loaded) and registered as stub
+// entries. The plugin is loaded on first List/Read/Write of a stub path or on
+// a forensic timeline. Unloaded plugins do not receive notifications - they
+// have no state that may need to be updated.
+//
 
 // ----------------------------------------------------------------------------
 // MODULES CORE FUNCTIONALITY - DEFINES BELOW:
 // ----------------------------------------------------------------------------
 
+#define PLUGIN_CACHE_MAGIC              0x63676c50      // 'Plgc'
+#define PLUGIN_CACHE_VERSION            1
+#define PLUGIN_CACHE_FILE               "plugins\\plugins.cache"
+#define PLUGIN_CACHE_ENTRY_MAX          0x400
+
+typedef struct tdPLUGIN_CACHE_ENTRY {
+    CHAR szFileName[64];                // dll file name
+    QWORD ftLastWrite;
+    QWORD cbFile;
+    WCHAR wszPathName[128];             // empty = dll does not register any module
+    BOOL fRootModule;
+    BOOL fProcessModule;
+    BOOL fRootModuleHidden;
+    BOOL fProcessModuleHidden;
+    BOOL fTimeline;
+} PLUGIN_CACHE_ENTRY, *PPLUGIN_CACHE_ENTRY;
+
+typedef struct tdPLUGIN_CACHE_FILE_HEADER {
+    DWORD dwMagic;
+    DWORD dwVersion;
+    DWORD cEntry;
+    DWORD _Reserved;
+} PLUGIN_CACHE_FILE_HEADER, *PPLUGIN_CACHE_FILE_HEADER;
+
+typedef struct tdPLUGIN_CACHE {
+    DWORD cOld;
+    DWORD cNew;
+    DWORD cNewMax;
+    DWORD cNewCapture;                  // cNew at start of current capture
+    BOOL fCapture;                      // record registrations of the currently loading dll
+    PPLUGIN_CACHE_ENTRY peOld;
+    PPLUGIN_CACHE_ENTRY peNew;
+    PLUGIN_CACHE_ENTRY eCapture;        // file info of the currently loading dll
+} PLUGIN_CACHE, *PPLUGIN_CACHE;
+
+typedef struct tdPLUGIN_LAZY {
+    struct tdPLUGIN_LAZY *FLink;
+    volatile BOOL fLoaded;              // set (with release semantics) once the plugin is loaded
+    BOOL fLoading;                      // load in progress (protected by LockMaster)
+    BOOL fPython;                       // python plugin manager - szPath unused
+    BOOL fTimeline;                     // plugin has timeline functionality
+    CHAR szPath[MAX_PATH];
+} PLUGIN_LAZY, *PPLUGIN_LAZY;
+
 typedef struct tdPLUGIN_ENTRY {
     struct tdPLUGIN_ENTRY *FLink;
     struct tdPLUGIN_ENTRY *FLinkNotify;
+    PPLUGIN_LAZY pLazy;                 // non-NULL = stub of a not yet loaded lazy plugin
+    struct tdPLUGIN_TREE *pLazyTree[2]; // stub tree entries [root, process]
     HMODULE hDLL;
     WCHAR wszName[32];
     DWORD dwNameHash;
@@ -55,6 +108,7 @@ typedef struct tdPLUGIN_ENTRY {
 } PLUGIN_ENTRY, *PPLUGIN_ENTRY;
 
 #define PLUGIN_TREE_MAX_CHILDITEMS      32
+#define PLUGIN_TREE_CHILD_HASH_SLOTS    64      // power of 2 and > PLUGIN_TREE_MAX_CHILDITEMS
 
 typedef struct tdPLUGIN_TREE {
     WCHAR wszName[32];
@@ -63,6 +117,7 @@ typedef struct tdPLUGIN_TREE {
     BOOL fVisible;
     struct tdPLUGIN_TREE *pParent;
     struct tdPLUGIN_TREE *Child[PLUGIN_TREE_MAX_CHILDITEMS];
+    BYTE iChildHash[PLUGIN_TREE_CHILD_HASH_SLOTS];  // open addressing: Child[] index + 1 (0 = empty)
     PPLUGIN_ENTRY pPlugin;
 } PLUGIN_TREE, *PPLUGIN_TREE;
 
@@ -87,9 +142,27 @@ VOID PluginManager_SetTreeVisibility(_In_opt_ PPLUGIN_TREE pTree, _In_ BOOL fVis
     }
 }
 
+/*
+* Retrieve a direct child of a plugin tree entry by its hashed name.
+* -- pTree
+* -- dwHash
+* -- return = the child, or NULL if not found.
+*/
+PPLUGIN_TREE PluginManager_GetTreeChild(_In_ PPLUGIN_TREE pTree, _In_ DWORD dwHash)
+{
+    DWORD iSlot = dwHash;
+    PPLUGIN_TREE pChild;
+    while(pTree->iChildHash[iSlot &= PLUGIN_TREE_CHILD_HASH_SLOTS - 1]) {
+        pChild = pTree->Child[pTree->iChildHash[iSlot] - 1];
+        if(pChild->dwHashName == dwHash) { return pChild; }
+        iSlot++;
+    }
+    return NULL;
+}
+
 PPLUGIN_TREE PluginManager_Register_GetCreateTree(_In_ PPLUGIN_TREE pTree, _In_ LPWSTR wszPathName, _In_ BOOL fVisible)
 {
-    DWORD i, dwHash;
+    DWORD dwHash, iSlot;
     WCHAR wszEntry[32];
     PPLUGIN_TREE pChild;
     // 1: no more levels to create - return
@@ -97,10 +170,8 @@ PPLUGIN_TREE PluginManager_Register_GetCreateTree(_In_ PPLUGIN_TREE pTree, _In_
     // 2: check existing tree child entries
     wszPathName = Util_PathSplit2_ExWCHAR(wszPathName, wszEntry, _countof(wszEntry));
     dwHash = Util_HashStringUpperW(wszEntry);
-    for(i = 0; i < pTree->cChild; i++) {
-        if(pTree->Child[i]->dwHashName == dwHash) {
-            return PluginManager_Register_GetCreateTree(pTree->Child[i], wszPathName, fVisible);
-        }
+    if((pChild = PluginManager_GetTreeChild(pTree, dwHash))) {
+        return PluginManager_Register_GetCreateTree(pChild, wszPathName, fVisible);
     }
     // 3: create new entry
     if(pTree->cChild == PLUGIN_TREE_MAX_CHILDITEMS) { return NULL; }
@@ -109,12 +180,16 @@ PPLUGIN_TREE PluginManager_Register_GetCreateTree(_In_ PPLUGIN_TREE pTree, _In_
     wcsncpy_s(pChild->wszName, _countof(pChild->wszName), wszEntry, _TRUNCATE);
     pChild->dwHashName = dwHash;
     pChild->pParent = pTree;
+    for(iSlot = dwHash & (PLUGIN_TREE_CHILD_HASH_SLOTS - 1); pTree->iChildHash[iSlot]; iSlot = (iSlot + 1) & (PLUGIN_TREE_CHILD_HASH_SLOTS - 1));
+    pTree->iChildHash[iSlot] = (BYTE)pTree->cChild;
     PluginManager_SetTreeVisibility(pChild, fVisible);
     return PluginManager_Register_GetCreateTree(pChild, wszPathName, fVisible);
 }
 
 /*
-* Retrieve the PLUGIN_TREE entry and the remaining path given a root tree and a root path.
+* Retrieve the PLUGIN_TREE entry and the remaining path given a root tree and
+* a root path. The tree is walked one path component at a time using the child
+* hash index.
 * -- pTree
 * -- wszPath
 * -- pTree
@@ -122,21 +197,21 @@ PPLUGIN_TREE PluginManager_Register_GetCreateTree(_In_ PPLUGIN_TREE pTree, _In_
 */
 VOID PluginManager_GetTree(_In_ PPLUGIN_TREE pTree, _In_ LPWSTR wszPath, _Out_ PPLUGIN_TREE *ppTree, _Out_ LPWSTR *pwszSubPath)
 {
-    DWORD i, dwHash;
-    WCHAR wszEntry[32];
-    LPWSTR wszSubPath;
-    if(!wszPath[0]) { goto finish; }
-    wszSubPath = Util_PathSplit2_ExWCHAR(wszPath, wszEntry, _countof(wszEntry));
-    dwHash = Util_HashStringUpperW(wszEntry);
-    for(i = 0; i < pTree->cChild; i++) {
-        if(pTree->Child[i]->dwHashName == dwHash) {
-            PluginManager_GetTree(pTree->Child[i], wszSubPath, ppTree, pwszSubPath);
-            return;
+    WCHAR c;
+    DWORD i, iStart, dwHash;
+    PPLUGIN_TREE pChild;
+    // walk tree - hash path components in-place (same as Util_HashStringUpperW)
+    *ppTree = pTree;
+    for(i = 0, iStart = 0; wszPath[iStart]; iStart = i) {
+        for(dwHash = 0; (c = wszPath[i]) && (c != '\\'); i++) {
+            if(c >= 'a' && c <= 'z') { c += 'A' - 'a'; }
+            dwHash = ((dwHash >> 13) | (dwHash << 19)) + c;
         }
+        if(!(pChild = PluginManager_GetTreeChild(*ppTree, dwHash))) { break; }
+        *ppTree = pChild;
+        if(wszPath[i]) { i++; }
     }
-finish:
-    *ppTree = pTree;
-    *pwszSubPath = wszPath;
+    *pwszSubPath = wszPath + iStart;
 }
 
 VOID PluginManager_SetVisibility(_In_ BOOL fRoot, _In_ LPWSTR wszPluginPath, _In_ BOOL fVisible)
@@ -157,6 +232,15 @@ BOOL PluginManager_ModuleExistsDll(_In_opt_ HMODULE hDLL) {
     return FALSE;
 }
 
+BOOL PluginManager_ModuleExistsLazy(_In_ PPLUGIN_LAZY pLazy) {
+    PPLUGIN_ENTRY pModule = (PPLUGIN_ENTRY)ctxVmm->PluginManager.FLink;
+    while(pModule) {
+        if(pLazy == pModule->pLazy) { return TRUE; }
+        pModule = pModule->FLink;
+    }
+    return FALSE;
+}
+
 BOOL PluginManager_ModuleExists(_In_ PPLUGIN_TREE pTree, _In_ LPWSTR wszPath) {
     LPWSTR wszSubPath;
     PPLUGIN_TREE pTreePlugin;
@@ -164,6 +248,24 @@ BOOL PluginManager_ModuleExists(_In_ PPLUGIN_TREE pTree, _In_ LPWSTR wszPath) {
     return pTreePlugin->pPlugin && !wszSubPath[0];
 }
 
+VOID PluginManager_LazyLoad(_In_ PPLUGIN_LAZY pLazy);
+
+/*
+* Retrieve the plugin of a plugin tree entry. If the plugin is a lazy plugin
+* stub the plugin is loaded and the loaded plugin (if any) is returned.
+* -- pTree
+* -- return
+*/
+PPLUGIN_ENTRY PluginManager_GetTreePlugin(_In_ PPLUGIN_TREE pTree)
+{
+    PPLUGIN_ENTRY pPlugin = pTree->pPlugin;
+    if(pPlugin && pPlugin->pLazy) {
+        PluginManager_LazyLoad(pPlugin->pLazy);
+        pPlugin = pTree->pPlugin;
+    }
+    return pPlugin;
+}
+
 VOID PluginManager_ContextInitialize(_Out_ PVMMDLL_PLUGIN_CONTEXT ctx, PPLUGIN_ENTRY pModule, _In_opt_ PVMM_PROCESS pProcess, _In_ LPWSTR wszPath)
 {
     ctx->magic = VMMDLL_PLUGIN_CONTEXT_MAGIC;
@@ -195,9 +297,9 @@ VOID PluginManager_List(_In_opt_ PVMM_PROCESS pProcess, _In_ LPWSTR wszPath, _In
                 }
             }
         }
-        if((pPlugin = pTree->pPlugin) && pPlugin->pfnList) {
+        if((pPlugin = PluginManager_GetTreePlugin(pTree)) && pPlugin->pfnList) {
             PluginManager_ContextInitialize(&ctx, pPlugin, pProcess, wszSubPath);
-            pTree->pPlugin->pfnList(&ctx, pFileList);
+            pPlugin->pfnList(&ctx, pFileList);
         }
     }
     Statistics_CallEnd(STATISTICS_ID_PluginManager_List, tmStart);
@@ -215,7 +317,7 @@ NTSTATUS PluginManager_Read(_In_opt_ PVMM_PROCESS pProcess, _In_ LPWSTR wszPath,
     if(!pTree) { return VMMDLL_STATUS_FILE_INVALID; }
     PluginManager_GetTree((pProcess ? ctxVmm->PluginManager.Proc : ctxVmm->PluginManager.Root), wszPath, &pTree, &wszSubPath);
     if(pTree->fVisible) {
-        if((pPlugin = pTree->pPlugin) && pPlugin->pfnRead) {
+        if((pPlugin = PluginManager_GetTreePlugin(pTree)) && pPlugin->pfnRead) {
             PluginManager_ContextInitialize(&ctx, pPlugin, pProcess, wszSubPath);
             nt = pPlugin->pfnRead(&ctx, pb, cb, pcbRead, cbOffset);
             Statistics_CallEnd(STATISTICS_ID_PluginManager_Read, tmStart);
@@ -238,7 +340,7 @@ NTSTATUS PluginManager_Write(_In_opt_ PVMM_PROCESS pProcess, _In_ LPWSTR wszPath
     if(!pTree) { return VMMDLL_STATUS_FILE_INVALID; }
     PluginManager_GetTree((pProcess ? ctxVmm->PluginManager.Proc : ctxVmm->PluginManager.Root), wszPath, &pTree, &wszSubPath);
     if(pTree->fVisible) {
-        if((pPlugin = pTree->pPlugin) && pPlugin->pfnWrite) {
+        if((pPlugin = PluginManager_GetTreePlugin(pTree)) && pPlugin->pfnWrite) {
             PluginManager_ContextInitialize(&ctx, pPlugin, pProcess, wszSubPath);
             nt = pPlugin->pfnWrite(&ctx, pb, cb, pcbWrite, cbOffset);
             Statistics_CallEnd(STATISTICS_ID_PluginManager_Read, tmStart);
@@ -270,7 +372,16 @@ VOID PluginManager_Timeline(
 ) {
     HANDLE hTimeline;
     QWORD tmStart = Statistics_CallStart();
-    PPLUGIN_ENTRY pModule = (PPLUGIN_ENTRY)ctxVmm->PluginManager.FLink;
+    PPLUGIN_ENTRY pModule;
+    PPLUGIN_LAZY pLazy = (PPLUGIN_LAZY)ctxVmm->PluginManager.FLinkLazy;
+    // load lazy plugins with timeline functionality before the timeline is generated.
+    while(pLazy) {
+        if(pLazy->fTimeline) {
+            PluginManager_LazyLoad(pLazy);
+        }
+        pLazy = pLazy->FLink;
+    }
+    pModule = (PPLUGIN_ENTRY)ctxVmm->PluginManager.FLink;
     while(pModule) {
         if(pModule->Timeline.pfn) {
             hTimeline = pfnRegister(pModule->Timeline.sNameShort, pModule->Timeline.szFileUTF8, pModule->Timeline.szFileJSON);
@@ -288,12 +399,42 @@ VOID PluginManager_Timeline(
 // MODULES REGISTRATION/CLEANUP FUNCTIONALITY - IMPLEMENTATION BELOW:
 // ----------------------------------------------------------------------------
 
-BOOL PluginManager_Register(_In_ PVMMDLL_PLUGIN_REGINFO pRegInfo)
+/*
+* Insert a plugin entry into the plugin list and into the plugin tree(s).
+* -- pModule
+* -- wszPathName
+* -- fRootModuleHidden
+* -- fProcessModuleHidden
+*/
+VOID PluginManager_Register_Tree(_In_ PPLUGIN_ENTRY pModule, _In_ LPWSTR wszPathName, _In_ BOOL fRootModuleHidden, _In_ BOOL fProcessModuleHidden)
 {
     DWORD iPluginNameStart;
+    PPLUGIN_TREE pPluginTreeEntry;
+    pModule->FLink = (PPLUGIN_ENTRY)ctxVmm->PluginManager.FLink;
+    ctxVmm->PluginManager.FLink = pModule;
+    iPluginNameStart = (wszPathName[0] == '\\') ? 1 : 0;
+    if(pModule->fRootModule) {
+        pPluginTreeEntry = PluginManager_Register_GetCreateTree(ctxVmm->PluginManager.Root, wszPathName + iPluginNameStart, !fRootModuleHidden);
+        if(pPluginTreeEntry && !pPluginTreeEntry->pPlugin) {
+            pPluginTreeEntry->pPlugin = pModule;
+            pModule->pLazyTree[0] = pModule->pLazy ? pPluginTreeEntry : NULL;
+        }
+    }
+    if(pModule->fProcessModule) {
+        pPluginTreeEntry = PluginManager_Register_GetCreateTree(ctxVmm->PluginManager.Proc, wszPathName + iPluginNameStart, !fProcessModuleHidden);
+        if(pPluginTreeEntry && !pPluginTreeEntry->pPlugin) {
+            pPluginTreeEntry->pPlugin = pModule;
+            pModule->pLazyTree[1] = pModule->pLazy ? pPluginTreeEntry : NULL;
+        }
+    }
+}
+
+VOID PluginManager_LazyCache_Capture(_In_ PPLUGIN_CACHE pc, _In_ PPLUGIN_ENTRY pModule, _In_ LPWSTR wszPathName, _In_ BOOL fRootModuleHidden, _In_ BOOL fProcessModuleHidden);
+
+BOOL PluginManager_Register(_In_ PVMMDLL_PLUGIN_REGINFO pRegInfo)
+{
     LPWSTR wszPluginName;
     PPLUGIN_ENTRY pModule;
-    PPLUGIN_TREE pPluginTreeEntry;
     // 1: tests if plugin is valid
     pRegInfo->reg_info.wszPathName[127] = 0;
     if(!pRegInfo || (pRegInfo->magic != VMMDLL_PLUGIN_REGINFO_MAGIC) || (pRegInfo->wVersion > VMMDLL_PLUGIN_REGINFO_VERSION)) { return FALSE; }
@@ -325,21 +466,11 @@ BOOL PluginManager_Register(_In_ PVMMDLL_PLUGIN_REGINFO pRegInfo)
         pModule->FLinkNotify = (PPLUGIN_ENTRY)ctxVmm->PluginManager.FLinkNotify;
         ctxVmm->PluginManager.FLinkNotify = pModule;
     }
-    pModule->FLink = (PPLUGIN_ENTRY)ctxVmm->PluginManager.FLink;
-    ctxVmm->PluginManager.FLink = pModule;
     // 3: register plugin in plugin tree
-    iPluginNameStart = (pRegInfo->reg_info.wszPathName[0] == '\\') ? 1 : 0;
-    if(pModule->fRootModule) {
-        pPluginTreeEntry = PluginManager_Register_GetCreateTree(ctxVmm->PluginManager.Root, pRegInfo->reg_info.wszPathName + iPluginNameStart, !pRegInfo->reg_info.fRootModuleHidden);
-        if(pPluginTreeEntry && !pPluginTreeEntry->pPlugin) {
-            pPluginTreeEntry->pPlugin = pModule;
-        }
-    }
-    if(pModule->fProcessModule) {
-        pPluginTreeEntry = PluginManager_Register_GetCreateTree(ctxVmm->PluginManager.Proc, pRegInfo->reg_info.wszPathName + iPluginNameStart, !pRegInfo->reg_info.fProcessModuleHidden);
-        if(pPluginTreeEntry && !pPluginTreeEntry->pPlugin) {
-            pPluginTreeEntry->pPlugin = pModule;
-        }
+    PluginManager_Register_Tree(pModule, pRegInfo->reg_info.wszPathName, pRegInfo->reg_info.fRootModuleHidden, pRegInfo->reg_info.fProcessModuleHidden);
+    // 4: record registration in lazy plugin cache (if loading a plugin dll not yet in cache)
+    if(pModule->hDLL && ctxVmm->PluginManager.pvLazyCache && ((PPLUGIN_CACHE)ctxVmm->PluginManager.pvLazyCache)->fCapture) {
+        PluginManager_LazyCache_Capture((PPLUGIN_CACHE)ctxVmm->PluginManager.pvLazyCache, pModule, pRegInfo->reg_info.wszPathName, pRegInfo->reg_info.fRootModuleHidden, pRegInfo->reg_info.fProcessModuleHidden);
     }
     return TRUE;
 }
@@ -357,12 +488,17 @@ VOID PluginManager_Close_Tree(_In_ PPLUGIN_TREE pTree)
 VOID PluginManager_Close()
 {
     PPLUGIN_ENTRY pm;
+    PPLUGIN_LAZY pLazy;
     PPLUGIN_TREE pTreeRoot = ctxVmm->PluginManager.Root, pTreeProc = ctxVmm->PluginManager.Proc;
     ctxVmm->PluginManager.Root = NULL;
     ctxVmm->PluginManager.Proc = NULL;
     PluginManager_Close_Tree(pTreeRoot);
     PluginManager_Close_Tree(pTreeProc);
     ctxVmm->PluginManager.FLinkNotify = NULL;
+    while((pLazy = (PPLUGIN_LAZY)ctxVmm->PluginManager.FLinkLazy)) {
+        ctxVmm->PluginManager.FLinkLazy = pLazy->FLink;
+        LocalFree(pLazy);
+    }
     while((pm = (PPLUGIN_ENTRY)ctxVmm->PluginManager.FLink)) {
         // 1: Detach current module list entry from list
         ctxVmm->PluginManager.FLink = pm->FLink;
@@ -476,18 +612,331 @@ fail:
     if(hDllPython3) { FreeLibrary(hDllPython3); }
 }
 
-BOOL PluginManager_Initialize()
+/*
+* Load a native plugin dll and let it register its module(s).
+* -- szPath = full path of the plugin dll.
+* -- szFileName = file name of the plugin dll.
+* -- return = TRUE if the dll was loaded (regardless of registered modules).
+*/
+BOOL PluginManager_Initialize_Dll(_In_ LPSTR szPath, _In_ LPSTR szFileName)
 {
+    HMODULE hDLL;
     VMMDLL_PLUGIN_REGINFO ri;
+    VOID(*pfnInitializeVmmPlugin)(_In_ PVMMDLL_PLUGIN_REGINFO pRegInfo);
+    hDLL = LoadLibraryExA(szPath, 0, 0);
+    if(!hDLL) {
+        vmmprintfvv("PluginManager: FAIL: Load DLL: '%s' - missing dependencies?\n", szFileName);
+        return FALSE;
+    }
+    vmmprintfvv("PluginManager: Load DLL: '%s'\n", szFileName);
+    pfnInitializeVmmPlugin = (VOID(*)(PVMMDLL_PLUGIN_REGINFO))GetProcAddress(hDLL, "InitializeVmmPlugin");
+    if(!pfnInitializeVmmPlugin) {
+        vmmprintfvv("PluginManager: UnLoad DLL: '%s' - Plugin Entry Point not found.\n", szFileName);
+        FreeLibrary(hDLL);
+        return TRUE;
+    }
+    PluginManager_Initialize_RegInfoInit(&ri, hDLL);
+    pfnInitializeVmmPlugin(&ri);
+    if(!PluginManager_ModuleExistsDll(hDLL)) {
+        vmmprintfvv("PluginManager: UnLoad DLL: '%s' - not registered with plugin manager.\n", szFileName);
+        FreeLibrary(hDLL);
+    }
+    return TRUE;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// LAZY PLUGIN LOADING FUNCTIONALITY BELOW:
+// ----------------------------------------------------------------------------
+
+/*
+* Load a lazy plugin on first use. The stub entries are detached from the
+* plugin tree so that the real plugin may register in their place. Stub tree
+* entries not taken over by the loaded plugin are hidden.
+* -- pLazy
+*/
+VOID PluginManager_LazyLoad(_In_ PPLUGIN_LAZY pLazy)
+{
+    DWORD i;
+    PPLUGIN_ENTRY pModule;
+    PPLUGIN_TREE pTree;
+    if(pLazy->fLoaded) { return; }
+    EnterCriticalSection(&ctxVmm->LockMaster);
+    if(pLazy->fLoaded || pLazy->fLoading) { goto finish; }
+    pLazy->fLoading = TRUE;
+    // 1: detach stubs from plugin tree
+    for(pModule = (PPLUGIN_ENTRY)ctxVmm->PluginManager.FLink; pModule; pModule = pModule->FLink) {
+        for(i = 0; (pModule->pLazy == pLazy) && (i < 2); i++) {
+            if((pTree = pModule->pLazyTree[i]) && (pTree->pPlugin == pModule)) {
+                pTree->pPlugin = NULL;
+            }
+        }
+    }
+    // 2: load plugin
+    vmmprintfv("PluginManager: Lazy load: '%s'\n", (pLazy->fPython ? "vmmpycplugin.dll" : pLazy->szPath));
+    if(pLazy->fPython) {
+        PluginManager_Initialize_Python();
+    } else {
+        PluginManager_Initialize_Dll(pLazy->szPath, Util_PathSplitLastA(pLazy->szPath));
+    }
+    // 3: hide stub tree entries not registered by the loaded plugin
+    for(pModule = (PPLUGIN_ENTRY)ctxVmm->PluginManager.FLink; pModule; pModule = pModule->FLink) {
+        for(i = 0; (pModule->pLazy == pLazy) && (i < 2); i++) {
+            if((pTree = pModule->pLazyTree[i]) && !pTree->pPlugin) {
+                PluginManager_SetTreeVisibility(pTree, FALSE);
+            }
+        }
+    }
+    // 4: publish the loaded plugin - lock-free readers of fLoaded must not
+    //    observe it before the plugin tree is updated.
+    InterlockedExchange((PLONG)&pLazy->fLoaded, TRUE);
+finish:
+    LeaveCriticalSection(&ctxVmm->LockMaster);
+}
+
+/*
+* Register a stub plugin entry from a cached plugin registration.
+* -- pLazy
+* -- pe
+*/
+VOID PluginManager_LazyRegisterStub(_In_ PPLUGIN_LAZY pLazy, _In_ PPLUGIN_CACHE_ENTRY pe)
+{
+    LPWSTR wszPluginName;
+    PPLUGIN_ENTRY pModule;
+    pe->wszPathName[_countof(pe->wszPathName) - 1] = 0;
+    wszPluginName = Util_PathSplitLastW(pe->wszPathName);
+    if(wcslen(wszPluginName) > 31) { return; }
+    if(pe->fRootModule && PluginManager_ModuleExists(ctxVmm->PluginManager.Root, pe->wszPathName)) { return; }
+    if(pe->fProcessModule && PluginManager_ModuleExists(ctxVmm->PluginManager.Proc, pe->wszPathName)) { return; }
+    if(!(pModule = (PPLUGIN_ENTRY)LocalAlloc(LMEM_ZEROINIT, sizeof(PLUGIN_ENTRY)))) { return; }
+    pModule->pLazy = pLazy;
+    wcsncpy_s(pModule->wszName, 32, wszPluginName, _TRUNCATE);
+    pModule->dwNameHash = Util_HashStringUpperW(pModule->wszName);
+    pModule->fRootModule = pe->fRootModule;
+    pModule->fProcessModule = pe->fProcessModule;
+    vmmprintfvv("PluginManager: Lazy module: '%S'\n", pe->wszPathName);
+    PluginManager_Register_Tree(pModule, pe->wszPathName, pe->fRootModuleHidden, pe->fProcessModuleHidden);
+}
+
+/*
+* Register stub entries for a plugin dll if cached registrations matching the
+* dll file name, last write time and size exists. Matching entries are carried
+* over into the new cache.
+* -- pc
+* -- pFindData = file info of the plugin dll.
+* -- szPath = full path of the plugin dll.
+* -- fPython = the plugin dll is the python plugin manager.
+* -- return = TRUE if the dll is cached (and should not be loaded now).
+*/
+_Success_(return)
+BOOL PluginManager_LazyCache_Stub(_In_ PPLUGIN_CACHE pc, _In_ PWIN32_FIND_DATAA pFindData, _In_ LPSTR szPath, _In_ BOOL fPython)
+{
+    DWORD i, cMatch = 0;
+    PPLUGIN_CACHE_ENTRY pe;
+    PPLUGIN_LAZY pLazy;
+    QWORD ftLastWrite = ((QWORD)pFindData->ftLastWriteTime.dwHighDateTime << 32) | pFindData->ftLastWriteTime.dwLowDateTime;
+    QWORD cbFile = ((QWORD)pFindData->nFileSizeHigh << 32) | pFindData->nFileSizeLow;
+    if(!(pLazy = LocalAlloc(LMEM_ZEROINIT, sizeof(PLUGIN_LAZY)))) { return FALSE; }
+    pLazy->fPython = fPython;
+    strncpy_s(pLazy->szPath, MAX_PATH, szPath, _TRUNCATE);
+    for(i = 0; (i < pc->cOld) && (pc->cNew < pc->cNewMax); i++) {
+        pe = pc->peOld + i;
+        if((pe->ftLastWrite != ftLastWrite) || (pe->cbFile != cbFile) || _stricmp(pe->szFileName, pFindData->cFileName)) { continue; }
+        memcpy(pc->peNew + pc->cNew, pe, sizeof(PLUGIN_CACHE_ENTRY));
+        pc->cNew++;
+        cMatch++;
+        if(pe->wszPathName[0] && (pe->fRootModule || pe->fProcessModule)) {
+            pLazy->fTimeline = pLazy->fTimeline || pe->fTimeline;
+            PluginManager_LazyRegisterStub(pLazy, pe);
+        }
+    }
+    if(PluginManager_ModuleExistsLazy(pLazy)) {
+        pLazy->FLink = (PPLUGIN_LAZY)ctxVmm->PluginManager.FLinkLazy;
+        ctxVmm->PluginManager.FLinkLazy = pLazy;
+    } else {
+        LocalFree(pLazy);
+    }
+    return cMatch > 0;
+}
+
+/*
+* Start recording the registrations of a plugin dll about to be loaded.
+* -- pc
+* -- pFindData = file info of the plugin dll.
+*/
+VOID PluginManager_LazyCache_CaptureBegin(_In_opt_ PPLUGIN_CACHE pc, _In_ PWIN32_FIND_DATAA pFindData)
+{
+    if(!pc) { return; }
+    ZeroMemory(&pc->eCapture, sizeof(PLUGIN_CACHE_ENTRY));
+    strncpy_s(pc->eCapture.szFileName, _countof(pc->eCapture.szFileName), pFindData->cFileName, _TRUNCATE);
+    pc->eCapture.ftLastWrite = ((QWORD)pFindData->ftLastWriteTime.dwHighDateTime << 32) | pFindData->ftLastWriteTime.dwLowDateTime;
+    pc->eCapture.cbFile = ((QWORD)pFindData->nFileSizeHigh << 32) | pFindData->nFileSizeLow;
+    pc->cNewCapture = pc->cNew;
+    pc->fCapture = TRUE;
+}
+
+/*
+* Record a single plugin registration - called from PluginManager_Register.
+*/
+VOID PluginManager_LazyCache_Capture(_In_ PPLUGIN_CACHE pc, _In_ PPLUGIN_ENTRY pModule, _In_ LPWSTR wszPathName, _In_ BOOL fRootModuleHidden, _In_ BOOL fProcessModuleHidden)
+{
+    PPLUGIN_CACHE_ENTRY pe;
+    if(pc->cNew >= pc->cNewMax) { return; }
+    pe = pc->peNew + pc->cNew;
+    memcpy(pe, &pc->eCapture, sizeof(PLUGIN_CACHE_ENTRY));
+    wcsncpy_s(pe->wszPathName, _countof(pe->wszPathName), wszPathName, _TRUNCATE);
+    pe->fRootModule = pModule->fRootModule;
+    pe->fProcessModule = pModule->fProcessModule;
+    pe->fRootModuleHidden = fRootModuleHidden;
+    pe->fProcessModuleHidden = fProcessModuleHidden;
+    pe->fTimeline = pModule->Timeline.pfn ? TRUE : FALSE;
+    pc->cNew++;
+}
+
+/*
+* Stop recording registrations. If the dll did not register any module an
+* empty entry is recorded (if requested) so that the dll is not loaded again
+* at next startup unless changed.
+* -- pc
+* -- fCacheEmpty
+*/
+VOID PluginManager_LazyCache_CaptureEnd(_In_opt_ PPLUGIN_CACHE pc, _In_ BOOL fCacheEmpty)
+{
+    if(!pc) { return; }
+    pc->fCapture = FALSE;
+    if(fCacheEmpty && (pc->cNew == pc->cNewCapture) && (pc->cNew < pc->cNewMax)) {
+        memcpy(pc->peNew + pc->cNew, &pc->eCapture, sizeof(PLUGIN_CACHE_ENTRY));
+        pc->cNew++;
+    }
+}
+
+/*
+* Create the lazy plugin cache and read the previously recorded registrations
+* from the cache file (if it exists and is valid).
+* -- szFileName
+* -- return = the cache, or NULL on failure. Free with PluginManager_LazyCache_Close.
+*/
+PPLUGIN_CACHE PluginManager_LazyCache_Open(_In_ LPSTR szFileName)
+{
+    FILE *hFile = NULL;
+    PPLUGIN_CACHE pc;
+    PLUGIN_CACHE_FILE_HEADER hdr;
+    if(!(pc = LocalAlloc(LMEM_ZEROINIT, sizeof(PLUGIN_CACHE)))) { return NULL; }
+    if(!(pc->peNew = LocalAlloc(0, PLUGIN_CACHE_ENTRY_MAX * sizeof(PLUGIN_CACHE_ENTRY)))) {
+        LocalFree(pc);
+        return NULL;
+    }
+    pc->cNewMax = PLUGIN_CACHE_ENTRY_MAX;
+    if(fopen_s(&hFile, szFileName, "rb") || !hFile) { return pc; }
+    if((1 != fread(&hdr, sizeof(PLUGIN_CACHE_FILE_HEADER), 1, hFile)) || (hdr.dwMagic != PLUGIN_CACHE_MAGIC) || (hdr.dwVersion != PLUGIN_CACHE_VERSION) || (hdr.cEntry > PLUGIN_CACHE_ENTRY_MAX)) { goto finish; }
+    if(!hdr.cEntry || !(pc->peOld = LocalAlloc(0, hdr.cEntry * sizeof(PLUGIN_CACHE_ENTRY)))) { goto finish; }
+    if(hdr.cEntry != fread(pc->peOld, sizeof(PLUGIN_CACHE_ENTRY), hdr.cEntry, hFile)) {
+        LocalFree(pc->peOld);
+        pc->peOld = NULL;
+        goto finish;
+    }
+    pc->cOld = hdr.cEntry;
+finish:
+    fclose(hFile);
+    return pc;
+}
+
+/*
+* Write the lazy plugin cache to file (if changed) and free it.
+* -- pc
+* -- szFileName
+*/
+VOID PluginManager_LazyCache_Close(_In_opt_ PPLUGIN_CACHE pc, _In_ LPSTR szFileName)
+{
+    FILE *hFile = NULL;
+    PLUGIN_CACHE_FILE_HEADER hdr = { 0 };
+    if(!pc) { return; }
+    if((pc->cNew != pc->cOld) || (pc->cNew && memcmp(pc->peNew, pc->peOld, pc->cNew * sizeof(PLUGIN_CACHE_ENTRY)))) {
+        hdr.dwMagic = PLUGIN_CACHE_MAGIC;
+        hdr.dwVersion = PLUGIN_CACHE_VERSION;
+        hdr.cEntry = pc->cNew;
+        if(!fopen_s(&hFile, szFileName, "wb") && hFile) {
+            if((1 == fwrite(&hdr, sizeof(PLUGIN_CACHE_FILE_HEADER), 1, hFile)) && (pc->cNew == fwrite(pc->peNew, sizeof(PLUGIN_CACHE_ENTRY), pc->cNew, hFile))) {
+                fclose(hFile);
+                vmmprintfvv("PluginManager: Lazy plugin cache written: %i entries.\n", pc->cNew);
+            } else {
+                fclose(hFile);
+                remove(szFileName);
+            }
+        }
+    }
+    LocalFree(pc->peOld);
+    LocalFree(pc->peNew);
+    LocalFree(pc);
+}
+
+/*
+* Fold a file name, size and last write time into a running cache identity.
+*/
+VOID PluginManager_LazyCache_PythonIdentity_Fold(_Inout_ PQWORD pqwTime, _Inout_ PQWORD pqwSize, _In_ PWIN32_FIND_DATAA pFindFile)
+{
+    *pqwTime = _rotl64(*pqwTime, 7) ^ (((QWORD)pFindFile->ftLastWriteTime.dwHighDateTime << 32) | pFindFile->ftLastWriteTime.dwLowDateTime) ^ Util_HashStringA(pFindFile->cFileName);
+    *pqwSize = _rotl64(*pqwSize, 7) ^ (((QWORD)pFindFile->nFileSizeHigh << 32) | pFindFile->nFileSizeLow);
+}
+
+/*
+* The python plugins are loaded by vmmpycplugin.dll which rarely changes. Fold
+* the python sources - vmmpyplugin.py and plugins\pym_*\*.py - into the file
+* info of vmmpycplugin.dll so that the cached python registrations are
+* invalidated whenever a python plugin is added, removed or changed.
+* -- szPathBase = directory of vmm.dll (terminated with a backslash).
+* -- pFindData = file info of vmmpycplugin.dll to update.
+*/
+VOID PluginManager_LazyCache_PythonIdentity(_In_ LPSTR szPathBase, _Inout_ PWIN32_FIND_DATAA pFindData)
+{
     CHAR szPath[MAX_PATH];
+    HANDLE hFindDir, hFindFile;
+    WIN32_FIND_DATAA FindDir, FindFile;
+    QWORD qwTime = ((QWORD)pFindData->ftLastWriteTime.dwHighDateTime << 32) | pFindData->ftLastWriteTime.dwLowDateTime;
+    QWORD qwSize = ((QWORD)pFindData->nFileSizeHigh << 32) | pFindData->nFileSizeLow;
+    // 1: python plugin manager
+    _snprintf_s(szPath, MAX_PATH, _TRUNCATE, "%svmmpyplugin.py", szPathBase);
+    if((hFindFile = FindFirstFileA(szPath, &FindFile)) != INVALID_HANDLE_VALUE) {
+        PluginManager_LazyCache_PythonIdentity_Fold(&qwTime, &qwSize, &FindFile);
+        FindClose(hFindFile);
+    }
+    // 2: python plugins
+    _snprintf_s(szPath, MAX_PATH, _TRUNCATE, "%splugins\\pym_*", szPathBase);
+    if((hFindDir = FindFirstFileA(szPath, &FindDir)) != INVALID_HANDLE_VALUE) {
+        do {
+            if(!(FindDir.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) { continue; }
+            _snprintf_s(szPath, MAX_PATH, _TRUNCATE, "%splugins\\%s\\*.py", szPathBase, FindDir.cFileName);
+            if((hFindFile = FindFirstFileA(szPath, &FindFile)) != INVALID_HANDLE_VALUE) {
+                do {
+                    PluginManager_LazyCache_PythonIdentity_Fold(&qwTime, &qwSize, &FindFile);
+                } while(FindNextFileA(hFindFile, &FindFile));
+                FindClose(hFindFile);
+            }
+            PluginManager_LazyCache_PythonIdentity_Fold(&qwTime, &qwSize, &FindDir);
+        } while(FindNextFileA(hFindDir, &FindDir));
+        FindClose(hFindDir);
+    }
+    pFindData->ftLastWriteTime.dwHighDateTime = (DWORD)(qwTime >> 32);
+    pFindData->ftLastWriteTime.dwLowDateTime = (DWORD)qwTime;
+    pFindData->nFileSizeHigh = (DWORD)(qwSize >> 32);
+    pFindData->nFileSizeLow = (DWORD)qwSize;
+}
+
+BOOL PluginManager_Initialize()
+{
+    VMMDLL_PLUGIN_REGINFO ri;
+    CHAR szPath[MAX_PATH], szCacheFile[MAX_PATH] = { 0 };
     DWORD i, cchPathBase;
     HANDLE hFindFile;
     WIN32_FIND_DATAA FindData;
-    HMODULE hDLL;
-    VOID(*pfnInitializeVmmPlugin)(_In_ PVMMDLL_PLUGIN_REGINFO pRegInfo);
+    DWORD iPhase, iPhaseDll;
+    BOOL fLoaded;
+    PPLUGIN_CACHE pc = NULL;
     // 1: check if already initialized
     if(ctxVmm->PluginManager.FLink) { return FALSE; }
     EnterCriticalSection(&ctxVmm->LockMaster);
+    iPhase = Statistics_StartupPhaseBegin("Plugins");
     if(ctxVmm->PluginManager.FLink) { goto fail; }
     // 2: set up root nodes of process plugin tree
     ctxVmm->PluginManager.Root = LocalAlloc(LMEM_ZEROINIT, sizeof(PLUGIN_TREE));
@@ -498,9 +947,17 @@ BOOL PluginManager_Initialize()
         PluginManager_Initialize_RegInfoInit(&ri, NULL);
         g_pfnModulesAllInternal[i](&ri);
     }
-    // 4: process dll modules
+    // 4: open lazy plugin cache (if lazy plugin loading)
     Util_GetPathDll(szPath, NULL);
     cchPathBase = (DWORD)strnlen(szPath, MAX_PATH - 1);
+    if(ctxMain->cfg.fPluginLazy) {
+        strcpy_s(szCacheFile, MAX_PATH, szPath);
+        strcat_s(szCacheFile, MAX_PATH, PLUGIN_CACHE_FILE);
+        pc = PluginManager_LazyCache_Open(szCacheFile);
+        ctxVmm->PluginManager.pvLazyCache = pc;
+    }
+    // 5: process dll modules
+    iPhaseDll = Statistics_StartupPhaseBegin("Plugins DLL");
     strcat_s(szPath, MAX_PATH, "plugins\\m_*.dll");
     hFindFile = FindFirstFileA(szPath, &FindData);
     if(hFindFile != INVALID_HANDLE_VALUE) {
@@ -508,32 +965,46 @@ BOOL PluginManager_Initialize()
             szPath[min(cchPathBase, MAX_PATH - 1)] = '\0';
             strcat_s(szPath, MAX_PATH, "plugins\\");
             strcat_s(szPath, MAX_PATH, FindData.cFileName);
-            hDLL = LoadLibraryExA(szPath, 0, 0);
-            if(!hDLL) { 
-                vmmprintfvv("PluginManager: FAIL: Load DLL: '%s' - missing dependencies?\n", FindData.cFileName);
-                continue;
-            }
-            vmmprintfvv("PluginManager: Load DLL: '%s'\n", FindData.cFileName);
-            pfnInitializeVmmPlugin = (VOID(*)(PVMMDLL_PLUGIN_REGINFO))GetProcAddress(hDLL, "InitializeVmmPlugin");
-            if(!pfnInitializeVmmPlugin) {
-                vmmprintfvv("PluginManager: UnLoad DLL: '%s' - Plugin Entry Point not found.\n", FindData.cFileName);
-                FreeLibrary(hDLL);
-                continue;
-            }
-            PluginManager_Initialize_RegInfoInit(&ri, hDLL);
-            pfnInitializeVmmPlugin(&ri);
-            if(!PluginManager_ModuleExistsDll(hDLL)) {
-                vmmprintfvv("PluginManager: UnLoad DLL: '%s' - not registered with plugin manager.\n", FindData.cFileName);
-                FreeLibrary(hDLL);
-                continue;
-            }
+            if(pc && PluginManager_LazyCache_Stub(pc, &FindData, szPath, FALSE)) { continue; }
+            PluginManager_LazyCache_CaptureBegin(pc, &FindData);
+            fLoaded = PluginManager_Initialize_Dll(szPath, FindData.cFileName);
+            PluginManager_LazyCache_CaptureEnd(pc, fLoaded);
         } while(FindNextFileA(hFindFile, &FindData));
+        FindClose(hFindFile);
+    }
+    Statistics_StartupPhaseEnd(iPhaseDll);
+    // 6: process 'special status' python plugin manager.
+    //    in lazy mode the python plugin manager is identified by vmmpycplugin.dll
+    //    together with the python plugin sources.
+    iPhaseDll = Statistics_StartupPhaseBegin("Plugins Python");
+    hFindFile = INVALID_HANDLE_VALUE;
+    if(pc) {
+        szPath[min(cchPathBase, MAX_PATH - 1)] = '\0';
+        strcat_s(szPath, MAX_PATH, "vmmpycplugin.dll");
+        hFindFile = FindFirstFileA(szPath, &FindData);
+    }
+    if(hFindFile != INVALID_HANDLE_VALUE) {
+        FindClose(hFindFile);
+        szPath[min(cchPathBase, MAX_PATH - 1)] = '\0';
+        PluginManager_LazyCache_PythonIdentity(szPath, &FindData);
+        strcat_s(szPath, MAX_PATH, "vmmpycplugin.dll");
+        if(!PluginManager_LazyCache_Stub(pc, &FindData, szPath, TRUE)) {
+            PluginManager_LazyCache_CaptureBegin(pc, &FindData);
+            PluginManager_Initialize_Python();
+            PluginManager_LazyCache_CaptureEnd(pc, FALSE);
+        }
+    } else {
+        PluginManager_Initialize_Python();
     }
-    // 5: process 'special status' python plugin manager.
-    PluginManager_Initialize_Python();
+    Statistics_StartupPhaseEnd(iPhaseDll);
+    // 7: write lazy plugin cache (if changed)
+    ctxVmm->PluginManager.pvLazyCache = NULL;
+    PluginManager_LazyCache_Close(pc, szCacheFile);
+    Statistics_StartupPhaseEnd(iPhase);
     LeaveCriticalSection(&ctxVmm->LockMaster);
     return TRUE;
 fail:
+    Statistics_StartupPhaseEnd(iPhase);
     LeaveCriticalSection(&ctxVmm->LockMaster);
     return FALSE;
 }
@@ -4,6 +4,7 @@
 // Author: Ulf Frisk, pcileech@frizk.net
 //
 #include "statistics.h"
+#include "util.h"
 #include "vmm.h"
 
 // ----------------------------------------------------------------------------
@@ -179,17 +180,35 @@ VOID PageStatUpdate(_In_opt_ PPAGE_STATISTICS pPageStat, _In_ QWORD qwAddr, _In_
 // FUNCTION CALL STATISTICAL FUNCTIONALITY BELOW:
 // ----------------------------------------------------------------------------
 
+// calls are accounted in per-thread shards (by thread id) to avoid all threads
+// contending on the same counters. latencies are kept in log-linear buckets
+// with four sub-buckets per power of two (< 25% error) from which percentiles
+// are estimated.
+#define STATISTICS_CALL_SHARDS      8
+#define STATISTICS_CALL_LINE_LENGTH 121
+#define STATISTICS_CALL_JSON_LINE_LENGTH    288
+
 typedef struct tdCALLSTAT {
     QWORD c;
     QWORD tm;
+    QWORD tmMax;
+    LONG cBucket[STATISTICS_CALL_BUCKETS];
 } CALLSTAT, *PCALLSTAT;
 
+typedef struct tdCALLSTAT_CONTEXT {
+    QWORD qwFreq;
+    CALLSTAT Shard[STATISTICS_CALL_SHARDS][STATISTICS_ID_MAX + 1];
+} CALLSTAT_CONTEXT, *PCALLSTAT_CONTEXT;
+
 VOID Statistics_CallSetEnabled(_In_ BOOL fEnabled)
 {
+    PCALLSTAT_CONTEXT ctx;
     if(fEnabled && ctxMain->pvStatistics) { return; }
     if(!fEnabled && !ctxMain->pvStatistics) { return; }
     if(fEnabled) {
-        ctxMain->pvStatistics = LocalAlloc(LMEM_ZEROINIT, (STATISTICS_ID_MAX + 1) * sizeof(CALLSTAT));
+        if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(CALLSTAT_CONTEXT)))) { return; }
+        QueryPerformanceFrequency((PLARGE_INTEGER)&ctx->qwFreq);
+        ctxMain->pvStatistics = ctx;
     } else {
         LocalFree(ctxMain->pvStatistics);
         ctxMain->pvStatistics = NULL;
@@ -201,6 +220,33 @@ BOOL Statistics_CallGetEnabled()
     return ctxMain->pvStatistics != NULL;
 }
 
+/*
+* Retrieve the latency bucket of a call duration.
+* -- qwUs
+* -- return = bucket index [0, STATISTICS_CALL_BUCKETS - 1].
+*/
+DWORD Statistics_CallBucket(_In_ QWORD qwUs)
+{
+    DWORD dwMsb;
+    if(qwUs < 4) { return (DWORD)qwUs; }
+    _BitScanReverse64(&dwMsb, qwUs);
+    if(dwMsb > 32) { return STATISTICS_CALL_BUCKETS - 1; }
+    return 4 * (dwMsb - 1) + (DWORD)((qwUs >> (dwMsb - 2)) & 3);
+}
+
+/*
+* Retrieve the upper bound (inclusive) in uS of a latency bucket.
+* -- iBucket
+* -- return
+*/
+QWORD Statistics_CallBucketMaxUs(_In_ DWORD iBucket)
+{
+    DWORD dwShift;
+    if(iBucket < 4) { return iBucket; }
+    dwShift = iBucket / 4 - 1;
+    return ((4ULL + (iBucket & 3)) << dwShift) + (1ULL << dwShift) - 1;
+}
+
 QWORD Statistics_CallStart()
 {
     QWORD tmNow;
@@ -211,90 +257,295 @@ QWORD Statistics_CallStart()
 
 QWORD Statistics_CallEnd(_In_ DWORD fId, QWORD tmCallStart)
 {
-    QWORD tmNow;
+    QWORD tmNow, tm, tmMax;
     PCALLSTAT pStat;
-    if(!ctxMain->pvStatistics) { return 0; }
+    PCALLSTAT_CONTEXT ctx = (PCALLSTAT_CONTEXT)ctxMain->pvStatistics;
+    if(!ctx) { return 0; }
     if(fId > STATISTICS_ID_MAX) { return 0; }
     if(tmCallStart == 0) { return 0; }
-    pStat = ((PCALLSTAT)ctxMain->pvStatistics) + fId;
-    InterlockedIncrement64(&pStat->c);
+    pStat = &ctx->Shard[(GetCurrentThreadId() >> 2) % STATISTICS_CALL_SHARDS][fId];
     QueryPerformanceCounter((PLARGE_INTEGER)&tmNow);
-    InterlockedAdd64(&pStat->tm, tmNow - tmCallStart);
-    return tmNow - tmCallStart;
+    tm = tmNow - tmCallStart;
+    InterlockedIncrement64(&pStat->c);
+    InterlockedAdd64(&pStat->tm, tm);
+    InterlockedIncrement(&pStat->cBucket[Statistics_CallBucket(tm * 1000000ULL / ctx->qwFreq)]);
+    while((tm > (tmMax = pStat->tmMax)) && (tmMax != (QWORD)InterlockedCompareExchange64(&pStat->tmMax, tm, tmMax)));
+    return tm;
+}
+
+/*
+* Retrieve the percentile latency from an aggregated bucket histogram.
+* -- pcBucket
+* -- c = total count of pcBucket.
+* -- dwPercentile
+* -- tmUsMax = max observed latency, used to clamp the bucket upper bound.
+* -- return
+*/
+QWORD Statistics_CallPercentile(_In_reads_(STATISTICS_CALL_BUCKETS) PQWORD pcBucket, _In_ QWORD c, _In_ DWORD dwPercentile, _In_ QWORD tmUsMax)
+{
+    DWORD i;
+    QWORD cAcc = 0, cRank = (c * dwPercentile + 99) / 100;
+    for(i = 0; i < STATISTICS_CALL_BUCKETS; i++) {
+        cAcc += pcBucket[i];
+        if(cAcc >= cRank) {
+            return min(tmUsMax, Statistics_CallBucketMaxUs(i));
+        }
+    }
+    return tmUsMax;
+}
+
+_Success_(return)
+BOOL Statistics_CallSummary(_In_ DWORD fId, _Out_ PSTATISTICS_CALL_SUMMARY ps)
+{
+    DWORD i, iShard;
+    QWORD tm = 0, tmMax = 0;
+    QWORD cBucket[STATISTICS_CALL_BUCKETS] = { 0 };
+    PCALLSTAT pStat;
+    PCALLSTAT_CONTEXT ctx = (PCALLSTAT_CONTEXT)ctxMain->pvStatistics;
+    ZeroMemory(ps, sizeof(STATISTICS_CALL_SUMMARY));
+    if(!ctx || (fId > STATISTICS_ID_MAX)) { return FALSE; }
+    for(iShard = 0; iShard < STATISTICS_CALL_SHARDS; iShard++) {
+        pStat = &ctx->Shard[iShard][fId];
+        ps->c += pStat->c;
+        tm += pStat->tm;
+        tmMax = max(tmMax, pStat->tmMax);
+        for(i = 0; i < STATISTICS_CALL_BUCKETS; i++) {
+            cBucket[i] += (DWORD)pStat->cBucket[i];
+        }
+    }
+    ps->tmUs = tm * 1000000ULL / ctx->qwFreq;
+    ps->tmUsMax = tmMax * 1000000ULL / ctx->qwFreq;
+    if(ps->c) {
+        ps->tmUsP50 = Statistics_CallPercentile(cBucket, ps->c, 50, ps->tmUsMax);
+        ps->tmUsP95 = Statistics_CallPercentile(cBucket, ps->c, 95, ps->tmUsMax);
+        ps->tmUsP99 = Statistics_CallPercentile(cBucket, ps->c, 99, ps->tmUsMax);
+    }
+    return TRUE;
 }
 
 VOID Statistics_CallToString(_In_opt_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcb)
 {
     BOOL result;
-    QWORD qwFreq, uS;
+    QWORD uS;
     DWORD i, o = 0;
-    PCALLSTAT pStat;
+    STATISTICS_CALL_SUMMARY s;
     PLC_STATISTICS pLcStatistics = NULL;
     if(!pb) { 
-        *pcb = 79 * (STATISTICS_ID_MAX + LC_STATISTICS_ID_MAX + 6);
+        *pcb = STATISTICS_CALL_LINE_LENGTH * (STATISTICS_ID_MAX + LC_STATISTICS_ID_MAX + 6);
         return;
     }
-    QueryPerformanceFrequency((PLARGE_INTEGER)&qwFreq);
     o += snprintf(
         pb + o,
         cb - o,
-        "FUNCTION CALL STATISTICS:                                                     \n" \
-        "VALUES IN DECIMAL, TIME IN MICROSECONDS uS, STATISTICS = %s             \n" \
-        "FUNCTION CALL NAME                           CALLS  TIME AVG        TIME TOTAL\n" \
-        "==============================================================================\n",
+        "FUNCTION CALL STATISTICS:                                                                                               \n" \
+        "VALUES IN DECIMAL, TIME IN MICROSECONDS uS, STATISTICS = %s                                                       \n" \
+        "FUNCTION CALL NAME                           CALLS  TIME AVG        TIME TOTAL       P50       P95       P99         MAX\n" \
+        "========================================================================================================================\n",
         ctxMain->pvStatistics ? "ENABLED " : "DISABLED"
-        );
+    );
     // statistics
     for(i = 0; i <= STATISTICS_ID_MAX; i++) {
-        if(ctxMain->pvStatistics) {
-            pStat = ((PCALLSTAT)ctxMain->pvStatistics) + i;
-            if(pStat->c) {
-                uS = (pStat->tm * 1000000ULL) / qwFreq;
-                o += snprintf(
-                    pb + o,
-                    cb - o,
-                    "%-40.40s  %8i  %8i  %16lli\n",
-                    STATISTICS_ID_STR[i],
-                    (DWORD)pStat->c,
-                    (DWORD)(uS / pStat->c),
-                    uS
-                );
-                continue;
-            }
-        }
+        Statistics_CallSummary(i, &s);
         o += snprintf(
             pb + o,
             cb - o,
-            "%-40.40s  %8i  %8i  %16lli\n",
+            "%-40.40s  %8i  %8i  %16lli  %8lli  %8lli  %8lli  %10lli\n",
             STATISTICS_ID_STR[i],
-            0, 0, 0ULL);
+            (DWORD)s.c,
+            (DWORD)(s.c ? (s.tmUs / s.c) : 0),
+            s.tmUs,
+            s.tmUsP50,
+            s.tmUsP95,
+            s.tmUsP99,
+            s.tmUsMax
+        );
     }
-    // leechcore statistics
+    // leechcore statistics (no latency distribution available)
     result = LcCommand(ctxMain->hLC, LC_CMD_STATISTICS_GET, 0, NULL, &(PBYTE)pLcStatistics, NULL);
     if(result && (pLcStatistics->dwVersion == LC_STATISTICS_VERSION) && pLcStatistics->qwFreq) {
         for(i = 0; i <= LC_STATISTICS_ID_MAX; i++) {
-            if(pLcStatistics->Call[i].c) {
-                uS = (pLcStatistics->Call[i].tm * 1000000ULL) / pLcStatistics->qwFreq;
-                o += snprintf(
-                    pb + o,
-                    cb - o,
-                    "%-40.40s  %8i  %8i  %16lli\n",
-                    LC_STATISTICS_NAME[i],
-                    (DWORD)pLcStatistics->Call[i].c,
-                    (DWORD)(uS / pLcStatistics->Call[i].c),
-                    uS
-                );
-            } else {
-                o += snprintf(
-                    pb + o,
-                    cb - o,
-                    "%-40.40s  %8i  %8i  %16lli\n",
-                    LC_STATISTICS_NAME[i],
-                    0, 0, 0ULL);
-            }
+            uS = (pLcStatistics->Call[i].tm * 1000000ULL) / pLcStatistics->qwFreq;
+            o += snprintf(
+                pb + o,
+                cb - o,
+                "%-40.40s  %8i  %8i  %16lli  %8s  %8s  %8s  %10s\n",
+                LC_STATISTICS_NAME[i],
+                (DWORD)pLcStatistics->Call[i].c,
+                (DWORD)(pLcStatistics->Call[i].c ? (uS / pLcStatistics->Call[i].c) : 0),
+                uS,
+                "-", "-", "-", "-"
+            );
         }
     }
     LocalFree(pLcStatistics);
     pb[o - 1] = '\n';
     *pcb = o;
 }
+
+VOID Statistics_CallToJson(_Out_writes_opt_(cb) PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcb)
+{
+    DWORD i, o = 0;
+    CHAR szLine[STATISTICS_CALL_JSON_LINE_LENGTH + 1];
+    STATISTICS_CALL_SUMMARY s;
+    // header line + one fixed length record per function id + trailer line.
+    *pcb = STATISTICS_CALL_JSON_LINE_LENGTH * (STATISTICS_ID_MAX + 3);
+    if(!pb) { return; }
+    if(cb < *pcb) {
+        *pcb = 0;
+        return;
+    }
+    Util_snprintf_ln2(szLine, STATISTICS_CALL_JSON_LINE_LENGTH, "{\"enabled\":%s,\"calls\":[", (ctxMain->pvStatistics ? "true" : "false"));
+    memcpy(pb + o, szLine, STATISTICS_CALL_JSON_LINE_LENGTH);
+    o += STATISTICS_CALL_JSON_LINE_LENGTH;
+    for(i = 0; i <= STATISTICS_ID_MAX; i++) {
+        Statistics_CallSummary(i, &s);
+        Util_snprintf_ln2(
+            szLine,
+            STATISTICS_CALL_JSON_LINE_LENGTH,
+            "{\"name\":\"%s\",\"id\":%i,\"count\":%lli,\"total_us\":%lli,\"avg_us\":%lli,\"p50_us\":%lli,\"p95_us\":%lli,\"p99_us\":%lli,\"max_us\":%lli}%s",
+            STATISTICS_ID_STR[i],
+            i,
+            s.c,
+            s.tmUs,
+            (s.c ? (s.tmUs / s.c) : 0),
+            s.tmUsP50,
+            s.tmUsP95,
+            s.tmUsP99,
+            s.tmUsMax,
+            ((i < STATISTICS_ID_MAX) ? "," : "")
+        );
+        memcpy(pb + o, szLine, STATISTICS_CALL_JSON_LINE_LENGTH);
+        o += STATISTICS_CALL_JSON_LINE_LENGTH;
+    }
+    Util_snprintf_ln2(szLine, STATISTICS_CALL_JSON_LINE_LENGTH, "]}");
+    memcpy(pb + o, szLine, STATISTICS_CALL_JSON_LINE_LENGTH);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// STARTUP PHASE TIMELINE FUNCTIONALITY BELOW:
+// Phases may be nested and phases of the async initialization thread may run
+// concurrently with other phases. Device reads are counted globally - reads
+// by concurrently running phases are therefore included in each of them.
+// ----------------------------------------------------------------------------
+
+#define STATISTICS_STARTUP_LINE_LENGTH      80
+#define STATISTICS_STARTUP_HEADER_LINES     4
+
+/*
+* Snapshot the device read counters (if the vmm context is initialized).
+*/
+#define STATISTICS_STARTUP_READ_SNAPSHOT(r) { \
+    if(ctxVmm) { \
+        r.c = ctxVmm->stat.cDeviceRead; \
+        r.cPages = ctxVmm->stat.cDeviceReadPages; \
+        r.tmUs = ctxVmm->stat.tmDeviceReadUs; \
+    } }
+
+DWORD Statistics_StartupPhaseBegin(_In_ LPCSTR szName)
+{
+    DWORD iPhase;
+    PVMM_STARTUP_PHASE pe;
+    iPhase = InterlockedIncrement(&ctxMain->startup.cPhase);
+    if(iPhase > VMM_STARTUP_PHASE_MAX) { return 0; }
+    pe = ctxMain->startup.Phase + iPhase - 1;
+    pe->szName = szName;
+    pe->dwThreadId = GetCurrentThreadId();
+    STATISTICS_STARTUP_READ_SNAPSHOT(pe->ReadStart);
+    QueryPerformanceCounter((PLARGE_INTEGER)&pe->tmStart);
+    return iPhase;
+}
+
+VOID Statistics_StartupPhaseEnd(_In_ DWORD iPhase)
+{
+    QWORD qwFreq, tmEnd;
+    PVMM_STARTUP_PHASE pe;
+    if(!iPhase || (iPhase > VMM_STARTUP_PHASE_MAX)) { return; }
+    pe = ctxMain->startup.Phase + iPhase - 1;
+    if(pe->tmEnd) { return; }
+    STATISTICS_STARTUP_READ_SNAPSHOT(pe->ReadEnd);
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmEnd);
+    QueryPerformanceFrequency((PLARGE_INTEGER)&qwFreq);
+    pe->tmEnd = tmEnd;
+    vmmprintfv(
+        "STARTUP: %-32s %8lli ms %8lli reads %10lli kB\n",
+        pe->szName,
+        ((pe->tmEnd - pe->tmStart) * 1000) / qwFreq,
+        pe->ReadEnd.c - pe->ReadStart.c,
+        (pe->ReadEnd.cPages - pe->ReadStart.cPages) << 2);
+}
+
+/*
+* Append a formatted line to the startup timeline buffer - the line is dropped
+* if it does not fit in the remaining buffer.
+*/
+VOID Statistics_StartupToString_Append(_Inout_updates_(cb) PBYTE pb, _In_ DWORD cb, _Inout_ PDWORD po, _In_z_ _Printf_format_string_ LPCSTR szFormat, ...)
+{
+    int cch;
+    va_list arglist;
+    CHAR szLine[0x100];
+    va_start(arglist, szFormat);
+    cch = _vsnprintf_s(szLine, _countof(szLine), _TRUNCATE, szFormat, arglist);
+    va_end(arglist);
+    if(cch < 0) { cch = (int)strlen(szLine); }
+    if(*po + (DWORD)cch > cb) { return; }
+    memcpy(pb + *po, szLine, cch);
+    *po += cch;
+}
+
+VOID Statistics_StartupToString(_Out_writes_opt_(cb) PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcb)
+{
+    QWORD qwFreq, tmNow, tmEnd;
+    DWORD i, j, iDepth, o = 0, cPhase;
+    CHAR szName[33];
+    PVMM_STARTUP_PHASE pe, pe2;
+    struct { QWORD c, cPages, tmUs; } ReadNow = { 0 }, ReadEnd;
+    cPhase = min(VMM_STARTUP_PHASE_MAX, (DWORD)ctxMain->startup.cPhase);
+    if(!pb) {
+        *pcb = STATISTICS_STARTUP_LINE_LENGTH * (STATISTICS_STARTUP_HEADER_LINES + cPhase);
+        return;
+    }
+    *pcb = 0;
+    if(cb < STATISTICS_STARTUP_LINE_LENGTH * STATISTICS_STARTUP_HEADER_LINES) { return; }
+    cPhase = min(cPhase, cb / STATISTICS_STARTUP_LINE_LENGTH - STATISTICS_STARTUP_HEADER_LINES);
+    QueryPerformanceFrequency((PLARGE_INTEGER)&qwFreq);
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmNow);
+    STATISTICS_STARTUP_READ_SNAPSHOT(ReadNow);
+    Statistics_StartupToString_Append(pb, cb, &o, "%-79s\n", "STARTUP TIMELINE: VALUES IN DECIMAL, TIME IN MILLISECONDS ms, READ SIZE IN kB");
+    Statistics_StartupToString_Append(pb, cb, &o, "%-79s\n", "PHASES IN START ORDER, NESTED PHASES INDENTED, RUNNING PHASES TIMED UNTIL NOW");
+    Statistics_StartupToString_Append(pb, cb, &o, "%-32s %8s %8s %8s %8s %10s\n", "PHASE", "START", "TIME", "DEV_TIME", "READS", "READ_kB");
+    Statistics_StartupToString_Append(pb, cb, &o, "%-79s\n", "==============================================================================");
+    for(i = 0; i < cPhase; i++) {
+        pe = ctxMain->startup.Phase + i;
+        if(!pe->tmStart) {
+            // phase index reserved but not yet started by other thread
+            Statistics_StartupToString_Append(pb, cb, &o, "%-32s %8i %8i %8i %8i %10i\n", "-", 0, 0, 0, 0, 0);
+            continue;
+        }
+        tmEnd = pe->tmEnd ? pe->tmEnd : tmNow;
+        memcpy(&ReadEnd, pe->tmEnd ? (PVOID)&pe->ReadEnd : (PVOID)&ReadNow, sizeof(ReadEnd));
+        // nesting depth: enclosing earlier started phases of the same thread
+        for(j = 0, iDepth = 0; j < i; j++) {
+            pe2 = ctxMain->startup.Phase + j;
+            if((pe2->dwThreadId == pe->dwThreadId) && (!pe2->tmEnd || (pe->tmEnd && (pe2->tmEnd >= pe->tmEnd)))) {
+                iDepth++;
+            }
+        }
+        iDepth = min(iDepth, 8);
+        _snprintf_s(szName, _countof(szName), _TRUNCATE, "%*s%s%s", iDepth * 2, "", pe->szName, (pe->tmEnd ? "" : "*"));
+        Statistics_StartupToString_Append(
+            pb,
+            cb,
+            &o,
+            "%-32.32s %8lli %8lli %8lli %8lli %10lli\n",
+            szName,
+            ((pe->tmStart - ctxMain->startup.tmBase) * 1000) / qwFreq,
+            ((tmEnd - pe->tmStart) * 1000) / qwFreq,
+            (ReadEnd.tmUs - pe->ReadStart.tmUs) / 1000,
+            ReadEnd.c - pe->ReadStart.c,
+            (ReadEnd.cPages - pe->ReadStart.cPages) << 2
+        );
+    }
+    *pcb = o;
+}
@@ -119,7 +119,19 @@ VOID PageStatUpdate(_In_opt_ PPAGE_STATISTICS pPageStat, _In_ QWORD qwAddr, _In_
 #define STATISTICS_ID_VMMDLL_PdbTypeSize                        0x31
 #define STATISTICS_ID_VMMDLL_PdbTypeChildOffset                 0x32
 #define STATISTICS_ID_VMM_PagedCompressedMemory                 0x33
-#define STATISTICS_ID_MAX                                       0x33
+#define STATISTICS_ID_VMMDLL_MemReadScatterAsync                0x34
+#define STATISTICS_ID_VMMDLL_ProcessGetProcAddressBatch         0x35
+#define STATISTICS_ID_VMMDLL_SnapshotBegin                      0x36
+#define STATISTICS_ID_VMMDLL_SnapshotEnd                        0x37
+#define STATISTICS_ID_VMMDLL_ProcessPageDigestEnable            0x38
+#define STATISTICS_ID_VMMDLL_ProcessPageDigestGetChanged        0x39
+#define STATISTICS_ID_VMMDLL_ForensicExportTable                0x3a
+#define STATISTICS_ID_VMMDLL_WinReg_QueryValueBatchW            0x3b
+#define STATISTICS_ID_VMMDLL_PdbSymbolNameBatch                 0x3c
+#define STATISTICS_ID_VMMDLL_Scatter_Execute                    0x3d
+#define STATISTICS_ID_VMMDLL_Scatter_Read                       0x3e
+#define STATISTICS_ID_VMMDLL_MemSearch                          0x3f
+#define STATISTICS_ID_MAX                                       0x3f
 #define STATISTICS_ID_NOLOG                                     0xffffffff
 
 static LPCSTR STATISTICS_ID_STR[] = {
@@ -175,12 +187,80 @@ static LPCSTR STATISTICS_ID_STR[] = {
     "VMMDLL_PdbTypeSize",
     "VMMDLL_PdbTypeChildOffset",
     "VMM_PagedCompressedMemory",
+    "VMMDLL_MemReadScatterAsync",
+    "VMMDLL_ProcessGetProcAddressBatch",
+    "VMMDLL_SnapshotBegin",
+    "VMMDLL_SnapshotEnd",
+    "VMMDLL_ProcessPageDigestEnable",
+    "VMMDLL_ProcessPageDigestGetChanged",
+    "VMMDLL_ForensicExportTable",
+    "VMMDLL_WinReg_QueryValueBatchW",
+    "VMMDLL_PdbSymbolNameBatch",
+    "VMMDLL_Scatter_Execute",
+    "VMMDLL_Scatter_Read",
+    "VMMDLL_MemSearch",
 };
 
+#define STATISTICS_CALL_BUCKETS                                 128
+
+typedef struct tdSTATISTICS_CALL_SUMMARY {
+    QWORD c;
+    QWORD tmUs;
+    QWORD tmUsMax;
+    QWORD tmUsP50;
+    QWORD tmUsP95;
+    QWORD tmUsP99;
+} STATISTICS_CALL_SUMMARY, *PSTATISTICS_CALL_SUMMARY;
+
 VOID Statistics_CallSetEnabled(_In_ BOOL fEnabled);
 BOOL Statistics_CallGetEnabled();
 QWORD Statistics_CallStart();
 QWORD Statistics_CallEnd(_In_ DWORD fId, QWORD tmCallStart);
 VOID Statistics_CallToString(_In_opt_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcb);
 
+/*
+* Retrieve the aggregated call count and latency distribution of a function
+* call statistics id. Percentiles are estimated from the latency histogram
+* and are accurate to within 25%.
+* -- fId = STATISTICS_ID_*
+* -- ps
+* -- return = TRUE if statistics are enabled and fId is valid.
+*/
+_Success_(return)
+BOOL Statistics_CallSummary(_In_ DWORD fId, _Out_ PSTATISTICS_CALL_SUMMARY ps);
+
+/*
+* Render the function call statistics as JSON. All function ids are included
+* as fixed length (whitespace padded) records so the size of the document is
+* constant. If pb is NULL the required buffer size is returned in pcb.
+* -- pb
+* -- cb
+* -- pcb
+*/
+VOID Statistics_CallToJson(_Out_writes_opt_(cb) PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcb);
+
+/*
+* Begin a startup phase. The wall time and the device reads of the phase are
+* recorded in the startup timeline.
+* -- szName = static name of the phase.
+* -- return = phase index to be given to Statistics_StartupPhaseEnd (zero if the timeline is full).
+*/
+DWORD Statistics_StartupPhaseBegin(_In_ LPCSTR szName);
+
+/*
+* End a startup phase previously started by Statistics_StartupPhaseBegin and
+* log its statistics to the verbose log. Already ended phases are ignored.
+* -- iPhase
+*/
+VOID Statistics_StartupPhaseEnd(_In_ DWORD iPhase);
+
+/*
+* Render the startup timeline. If pb is NULL the exact required buffer size
+* is returned in pcb.
+* -- pb
+* -- cb
+* -- pcb
+*/
+VOID Statistics_StartupToString(_Out_writes_opt_(cb) PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcb);
+
 #endif /* __STATISTICS_H__ */
@@ -401,6 +401,43 @@ NTSTATUS Util_VfsReadFile_FromPBYTE(_In_opt_ PBYTE pbFile, _In_ QWORD cbFile, _O
     return *pcbRead ? UTIL_NTSTATUS_SUCCESS : UTIL_NTSTATUS_END_OF_FILE;
 }
 
+NTSTATUS Util_VfsLineFixed_Read(
+    _In_ UTIL_VFSLINEFIXED_PFN_CB pfnCallback,
+    _In_opt_ PVOID ctx,
+    _In_ DWORD cbLineLength,
+    _In_ DWORD cMap,
+    _In_ PVOID pvMap,
+    _In_ DWORD cbEntry,
+    _Out_writes_to_(cb, *pcbRead) PBYTE pb,
+    _In_ DWORD cb,
+    _Out_ PDWORD pcbRead,
+    _In_ QWORD cbOffset
+) {
+    DWORD ie, o = 0, oLine, cbLine, cch;
+    QWORD cbFile = (QWORD)cMap * cbLineLength;
+    CHAR szLine[UTIL_VFSLINEFIXED_LINELENGTH_MAX + 1];
+    *pcbRead = 0;
+    if(!cbLineLength || (cbLineLength > UTIL_VFSLINEFIXED_LINELENGTH_MAX) || (cbOffset >= cbFile)) { return UTIL_NTSTATUS_END_OF_FILE; }
+    cb = (DWORD)min(cb, cbFile - cbOffset);
+    ie = (DWORD)(cbOffset / cbLineLength);
+    oLine = (DWORD)(cbOffset % cbLineLength);
+    while(o < cb) {
+        ZeroMemory(szLine, cbLineLength + 1ULL);
+        pfnCallback(ctx, cbLineLength, ie, (PBYTE)pvMap + (QWORD)ie * cbEntry, szLine);
+        // short lines are padded with spaces and newline terminated just like Util_snprintf_ln2.
+        cch = (DWORD)strnlen(szLine, cbLineLength);
+        memset(szLine + cch, ' ', cbLineLength - cch);
+        szLine[cbLineLength - 1] = '\n';
+        cbLine = min(cbLineLength - oLine, cb - o);
+        memcpy(pb + o, szLine + oLine, cbLine);
+        o += cbLine;
+        oLine = 0;
+        ie++;
+    }
+    *pcbRead = cb;
+    return UTIL_NTSTATUS_SUCCESS;
+}
+
 NTSTATUS Util_VfsReadFile_FromTextWtoU8(_In_opt_ LPWSTR wszValue, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
 {
     NTSTATUS nt;
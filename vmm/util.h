@@ -309,6 +309,40 @@ NTSTATUS Util_VfsReadFile_FromNumber(_In_ QWORD qwValue, _Out_ PBYTE pb, _In_ DW
 NTSTATUS Util_VfsReadFile_FromQWORD(_In_ QWORD qwValue, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset, _In_ BOOL fPrefix);
 NTSTATUS Util_VfsReadFile_FromDWORD(_In_ DWORD dwValue, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset, _In_ BOOL fPrefix);
 NTSTATUS Util_VfsReadFile_FromBOOL(_In_ BOOL fValue, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset);
+
+typedef VOID(*UTIL_VFSLINEFIXED_PFN_CB)(_In_opt_ PVOID ctx, _In_ DWORD cbLineLength, _In_ DWORD ie, _In_ PVOID pe, _Out_writes_(cbLineLength + 1) LPSTR szu8);
+
+/*
+* Read from a text file consisting of fixed length lines - one line per map
+* entry. Only the lines overlapping the read are rendered (by the callback)
+* so random reads at any file offset costs the same regardless of map size.
+* -- pfnCallback = render line of entry ie into szu8 (cbLineLength + NULL).
+*                  Short lines are space padded and newline terminated.
+* -- ctx = optional context passed to pfnCallback.
+* -- cbLineLength = max UTIL_VFSLINEFIXED_LINELENGTH_MAX.
+* -- cMap
+* -- pvMap
+* -- cbEntry
+* -- pb
+* -- cb
+* -- pcbRead
+* -- cbOffset
+* -- return
+*/
+#define UTIL_VFSLINEFIXED_LINELENGTH_MAX            0x400
+NTSTATUS Util_VfsLineFixed_Read(
+    _In_ UTIL_VFSLINEFIXED_PFN_CB pfnCallback,
+    _In_opt_ PVOID ctx,
+    _In_ DWORD cbLineLength,
+    _In_ DWORD cMap,
+    _In_ PVOID pvMap,
+    _In_ DWORD cbEntry,
+    _Out_writes_to_(cb, *pcbRead) PBYTE pb,
+    _In_ DWORD cb,
+    _Out_ PDWORD pcbRead,
+    _In_ QWORD cbOffset
+);
+
 NTSTATUS Util_VfsWriteFile_BOOL(_Inout_ PBOOL pfTarget, _In_reads_(cb) PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbWrite, _In_ QWORD cbOffset);
 NTSTATUS Util_VfsWriteFile_09(_Inout_ PDWORD pdwTarget, _In_reads_(cb) PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbWrite, _In_ QWORD cbOffset);
 NTSTATUS Util_VfsWriteFile_DWORD(_Inout_ PDWORD pdwTarget, _In_reads_(cb) PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbWrite, _In_ QWORD cbOffset, _In_ DWORD dwMinAllow, _In_opt_ DWORD dwMaxAllow);
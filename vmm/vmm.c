@@ -5,6 +5,7 @@
 //
 
 #include "vmm.h"
+#include "vmmdevtrace.h"
 #include "mm.h"
 #include "ob.h"
 #include "pdb.h"
@@ -13,6 +14,7 @@
 #include "vmmwindef.h"
 #include "vmmwinobj.h"
 #include "vmmwinreg.h"
+#include "vmmwinprofile.h"
 #include "vmmwinnet.h"
 #include "pluginmanager.h"
 #include "util.h"
@@ -42,6 +44,304 @@ PVMM_CACHE_TABLE VmmCacheTableGet(_In_ DWORD wTblTag)
 
 #define VMM_CACHE2_GET_REGION(qwA)      ((qwA >> 12) % VMM_CACHE2_REGIONS)
 #define VMM_CACHE2_GET_BUCKET(qwA)      ((qwA >> 12) % VMM_CACHE2_BUCKETS)
+#define VMM_CACHE2_LOCKFREE_MAXWALK     0x40
+
+/*
+* Acquire/Release the write lock of a cache region. The region write sequence
+* is incremented on both acquire and release - i.e. it's odd while a writer is
+* active. This allows readers in VmmCacheGet to walk the bucket lists without
+* taking the lock and detect if a concurrent write took place.
+* -- t
+* -- iR
+*/
+VOID VmmCacheRegionLock(_In_ PVMM_CACHE_TABLE t, _In_ DWORD iR)
+{
+    if(!TryEnterCriticalSection(&t->R[iR].Lock)) {
+        InterlockedIncrement64(&ctxVmm->stat.cCacheLockContention);
+        EnterCriticalSection(&t->R[iR].Lock);
+    }
+    InterlockedIncrement(&t->R[iR].dwSeq);
+}
+
+VOID VmmCacheRegionUnlock(_In_ PVMM_CACHE_TABLE t, _In_ DWORD iR)
+{
+    InterlockedIncrement(&t->R[iR].dwSeq);
+    LeaveCriticalSection(&t->R[iR].Lock);
+}
+
+/*
+* Detach/Attach a cache entry from/to the region age lists. Entries are either
+* in the probation age list (default) or in the hot age list (2Q policy only).
+* NB! caller must hold the region lock.
+*/
+VOID VmmCacheAgeDetach(_In_ PVMM_CACHE_TABLE t, _In_ DWORD iR, _In_ PVMMOB_MEM pOb)
+{
+    PPVMMOB_MEM ppFLink = pOb->fHot ? &t->R[iR].HotFLink : &t->R[iR].AgeFLink;
+    PPVMMOB_MEM ppBLink = pOb->fHot ? &t->R[iR].HotBLink : &t->R[iR].AgeBLink;
+    if(pOb->AgeBLink) {
+        pOb->AgeBLink->AgeFLink = pOb->AgeFLink;
+    } else {
+        *ppFLink = pOb->AgeFLink;
+    }
+    if(pOb->AgeFLink) {
+        pOb->AgeFLink->AgeBLink = pOb->AgeBLink;
+    } else {
+        *ppBLink = pOb->AgeBLink;
+    }
+    if(pOb->fHot) {
+        t->R[iR].cHot--;
+        pOb->fHot = FALSE;
+    }
+}
+
+VOID VmmCacheAgeAttach(_In_ PVMM_CACHE_TABLE t, _In_ DWORD iR, _In_ PVMMOB_MEM pOb, _In_ BOOL fHot)
+{
+    PPVMMOB_MEM ppFLink = fHot ? &t->R[iR].HotFLink : &t->R[iR].AgeFLink;
+    PPVMMOB_MEM ppBLink = fHot ? &t->R[iR].HotBLink : &t->R[iR].AgeBLink;
+    pOb->fHot = fHot;
+    pOb->AgeBLink = NULL;
+    pOb->AgeFLink = *ppFLink;
+    if(pOb->AgeFLink) { pOb->AgeFLink->AgeBLink = pOb; }
+    *ppFLink = pOb;
+    if(!*ppBLink) { *ppBLink = pOb; }
+    if(fHot) { t->R[iR].cHot++; }
+}
+
+/*
+* Detach a cache entry from its bucket list. The FLink of the entry is left
+* intact so that concurrent lock-free readers may continue their walk.
+* NB! caller must hold the region lock.
+*/
+VOID VmmCacheBucketDetach(_In_ PVMM_CACHE_TABLE t, _In_ DWORD iR, _In_ PVMMOB_MEM pOb)
+{
+    if(pOb->BLink) {
+        pOb->BLink->FLink = pOb->FLink;
+    } else {
+        t->R[iR].B[VMM_CACHE2_GET_BUCKET(pOb->h.qwA)] = pOb->FLink;
+    }
+    if(pOb->FLink) {
+        pOb->FLink->BLink = pOb->BLink;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// COMPRESSED PHYSICAL MEMORY CACHE TIER:
+// Pages evicted from the physical memory cache by VmmCacheReclaim are xpress
+// compressed and kept in a map keyed by physical address within a memory
+// budget. On a physical memory cache miss the page is decompressed and then
+// promoted back into the physical memory cache. Zero pages take no data.
+// ----------------------------------------------------------------------------
+
+/*
+* Evict entries from the compressed cache tier until it fits within budget.
+* Entries are evicted at pseudo random positions (random replacement).
+* NB! caller must hold ctxVmm->CacheCompress.Lock.
+* -- cbExtra = additional bytes to make room for.
+*/
+VOID VmmCacheCompress_EvictBudget(_In_ QWORD cbExtra)
+{
+    DWORD c;
+    PVMM_CACHE_COMPRESS_ENTRY pe;
+    while((ctxVmm->CacheCompress.cb + cbExtra > ctxVmm->CacheCompress.cbMax) && (c = ObMap_Size(ctxVmm->CacheCompress.pm))) {
+        ctxVmm->CacheCompress.iEvict = ctxVmm->CacheCompress.iEvict * 1103515245 + 12345;
+        pe = ObMap_GetByIndex(ctxVmm->CacheCompress.pm, (ctxVmm->CacheCompress.iEvict >> 8) % c);
+        if(!pe || !ObMap_Remove(ctxVmm->CacheCompress.pm, pe)) { break; }
+        ctxVmm->CacheCompress.cb -= VMM_CACHE_COMPRESS_CB_OVERHEAD + pe->cb;
+        LocalFree(pe);
+        InterlockedIncrement64(&ctxVmm->stat.cCacheCompressEvict);
+    }
+}
+
+DWORD VmmCacheClockEvict(_In_ POB_MAP pm, _In_ POB_SET psReferenced, _Inout_ PDWORD piClock, _Inout_ PQWORD pcb, _In_ QWORD cbMax, _In_ QWORD cbExtra, _In_ QWORD cbOverhead)
+{
+    DWORD c, cEvict = 0;
+    QWORD qwKey;
+    POB pOb;
+    while((*pcb + cbExtra > cbMax) && (c = ObMap_Size(pm))) {
+        *piClock = *piClock % c;
+        if(!(pOb = ObMap_GetByIndexWithKey(pm, *piClock, &qwKey))) { break; }
+        if(ObSet_Remove(psReferenced, qwKey)) {
+            (*piClock)++;
+        } else if(ObMap_Remove(pm, pOb)) {
+            // removal moves the last entry into the clock hand position - do not advance.
+            *pcb -= min(*pcb, cbOverhead + pOb->cbData);
+            cEvict++;
+            Ob_DECREF(pOb);
+        }
+        Ob_DECREF(pOb);
+    }
+    return cEvict;
+}
+
+/*
+* Compress a page evicted from the physical memory cache into the compressed
+* cache tier. Pages not compressing well enough are discarded.
+* -- pOb
+*/
+VOID VmmCacheCompress_Store(_In_ PVMMOB_MEM pOb)
+{
+    DWORD i, cb = 0;
+    PVMM_CACHE_COMPRESS_ENTRY pe, peOld;
+    EnterCriticalSection(&ctxVmm->CacheCompress.Lock);
+    if(!ctxVmm->CacheCompress.cbMax) { goto fail; }
+    for(i = 0; (i < 0x200) && !((PQWORD)pOb->pb)[i]; i++);
+    if(i < 0x200) {
+        if((VMM_STATUS_SUCCESS != ctxVmm->fn.RtlCompressBuffer(COMPRESSION_FORMAT_XPRESS | COMPRESSION_ENGINE_STANDARD, pOb->pb, 0x1000, ctxVmm->CacheCompress.pbBuffer, VMM_CACHE_COMPRESS_CB_MAX, 0x1000, &cb, ctxVmm->CacheCompress.pvWorkSpace)) || !cb || (cb > VMM_CACHE_COMPRESS_CB_MAX)) {
+            InterlockedIncrement64(&ctxVmm->stat.cCacheCompressReject);
+            goto fail;
+        }
+    }
+    if(!(pe = LocalAlloc(0, sizeof(VMM_CACHE_COMPRESS_ENTRY) + cb))) { goto fail; }
+    pe->cb = cb;
+    memcpy(pe->pb, ctxVmm->CacheCompress.pbBuffer, cb);
+    // replace stale entry (if any) and make room within the budget
+    if((peOld = ObMap_RemoveByKey(ctxVmm->CacheCompress.pm, pOb->h.qwA))) {
+        ctxVmm->CacheCompress.cb -= VMM_CACHE_COMPRESS_CB_OVERHEAD + peOld->cb;
+        LocalFree(peOld);
+    }
+    VmmCacheCompress_EvictBudget(VMM_CACHE_COMPRESS_CB_OVERHEAD + cb);
+    if(ObMap_Push(ctxVmm->CacheCompress.pm, pOb->h.qwA, pe)) {
+        ctxVmm->CacheCompress.cb += VMM_CACHE_COMPRESS_CB_OVERHEAD + cb;
+        InterlockedIncrement64(&ctxVmm->stat.cCacheCompressStore);
+    } else {
+        LocalFree(pe);
+    }
+fail:
+    LeaveCriticalSection(&ctxVmm->CacheCompress.Lock);
+}
+
+/*
+* Remove a page from the compressed cache tier and decompress it.
+* -- pa
+* -- pbPage = buffer to receive the 4kB page.
+* -- return
+*/
+_Success_(return)
+BOOL VmmCacheCompress_Load(_In_ QWORD pa, _Out_writes_(0x1000) PBYTE pbPage)
+{
+    BOOL fResult;
+    DWORD cbDecompressed = 0;
+    PVMM_CACHE_COMPRESS_ENTRY pe;
+    if(!ObMap_ExistsKey(ctxVmm->CacheCompress.pm, pa)) { return FALSE; }
+    EnterCriticalSection(&ctxVmm->CacheCompress.Lock);
+    if((pe = ObMap_RemoveByKey(ctxVmm->CacheCompress.pm, pa))) {
+        ctxVmm->CacheCompress.cb -= VMM_CACHE_COMPRESS_CB_OVERHEAD + pe->cb;
+    }
+    LeaveCriticalSection(&ctxVmm->CacheCompress.Lock);
+    if(!pe) { return FALSE; }
+    if(pe->cb) {
+        fResult = (VMM_STATUS_SUCCESS == ctxVmm->fn.RtlDecompressBuffer(COMPRESSION_FORMAT_XPRESS, pbPage, 0x1000, pe->pb, pe->cb, &cbDecompressed)) && (cbDecompressed == 0x1000);
+    } else {
+        ZeroMemory(pbPage, 0x1000);
+        fResult = TRUE;
+    }
+    LocalFree(pe);
+    if(fResult) {
+        InterlockedIncrement64(&ctxVmm->stat.cCacheCompressHit);
+    }
+    return fResult;
+}
+
+/*
+* Promote a page from the compressed cache tier back into the physical memory
+* cache. On success the page is also copied into pMEM.
+* -- pMEM
+* -- return
+*/
+_Success_(return)
+BOOL VmmCacheCompress_Promote(_Inout_ PMEM_SCATTER pMEM)
+{
+    PVMMOB_MEM pObReservedMEM;
+    if(!VmmCacheCompress_Load(pMEM->qwA, pMEM->pb)) { return FALSE; }
+    pMEM->f = TRUE;
+    if((pObReservedMEM = VmmCacheReserve(VMM_CACHE_TAG_PHYS))) {
+        pObReservedMEM->h.f = TRUE;
+        pObReservedMEM->h.qwA = pMEM->qwA;
+        memcpy(pObReservedMEM->h.pb, pMEM->pb, 0x1000);
+        VmmCacheReserveReturn(pObReservedMEM);
+    }
+    return TRUE;
+}
+
+/*
+* Invalidate a page in the compressed cache tier (if exists).
+* -- pa
+*/
+VOID VmmCacheCompress_Invalidate(_In_ QWORD pa)
+{
+    PVMM_CACHE_COMPRESS_ENTRY pe;
+    if(!ObMap_ExistsKey(ctxVmm->CacheCompress.pm, pa)) { return; }
+    EnterCriticalSection(&ctxVmm->CacheCompress.Lock);
+    if((pe = ObMap_RemoveByKey(ctxVmm->CacheCompress.pm, pa))) {
+        ctxVmm->CacheCompress.cb -= VMM_CACHE_COMPRESS_CB_OVERHEAD + pe->cb;
+        LocalFree(pe);
+    }
+    LeaveCriticalSection(&ctxVmm->CacheCompress.Lock);
+}
+
+/*
+* Clear the compressed cache tier from all entries.
+*/
+VOID VmmCacheCompress_Clear()
+{
+    if(!ctxVmm->CacheCompress.fInitialized) { return; }
+    EnterCriticalSection(&ctxVmm->CacheCompress.Lock);
+    ObMap_Clear(ctxVmm->CacheCompress.pm);
+    ctxVmm->CacheCompress.cb = 0;
+    LeaveCriticalSection(&ctxVmm->CacheCompress.Lock);
+}
+
+_Success_(return)
+BOOL VmmCacheCompressConfigure(_In_ DWORD cMB)
+{
+    if(!ctxVmm->CacheCompress.fInitialized) { return FALSE; }
+    EnterCriticalSection(&ctxVmm->CacheCompress.Lock);
+    ctxVmm->CacheCompress.cbMax = (QWORD)cMB << 20;
+    VmmCacheCompress_EvictBudget(0);
+    LeaveCriticalSection(&ctxVmm->CacheCompress.Lock);
+    return TRUE;
+}
+
+VOID VmmCacheCompressShrink(_In_ QWORD cb)
+{
+    QWORD cbCache;
+    if(!ctxVmm->CacheCompress.fInitialized) { return; }
+    EnterCriticalSection(&ctxVmm->CacheCompress.Lock);
+    cbCache = min(ctxVmm->CacheCompress.cb, ctxVmm->CacheCompress.cbMax);
+    VmmCacheCompress_EvictBudget(ctxVmm->CacheCompress.cbMax - cbCache + cb);
+    LeaveCriticalSection(&ctxVmm->CacheCompress.Lock);
+}
+
+/*
+* Initialize the compressed cache tier. The tier is only available if the
+* ntdll compression functions exist. It's enabled if a budget is configured.
+*/
+VOID VmmCacheCompress_Initialize()
+{
+    ULONG cbWorkSpace = 0, cbWorkSpaceFragment = 0;
+    if(!ctxVmm->fn.RtlCompressBuffer || !ctxVmm->fn.RtlDecompressBuffer || !ctxVmm->fn.RtlGetCompressionWorkSpaceSize) { return; }
+    if(VMM_STATUS_SUCCESS != ctxVmm->fn.RtlGetCompressionWorkSpaceSize(COMPRESSION_FORMAT_XPRESS | COMPRESSION_ENGINE_STANDARD, &cbWorkSpace, &cbWorkSpaceFragment)) { return; }
+    if(!(ctxVmm->CacheCompress.pvWorkSpace = LocalAlloc(0, max(1, cbWorkSpace)))) { return; }
+    if(!(ctxVmm->CacheCompress.pm = ObMap_New(OB_MAP_FLAGS_OBJECT_LOCALFREE))) {
+        LocalFree(ctxVmm->CacheCompress.pvWorkSpace);
+        ctxVmm->CacheCompress.pvWorkSpace = NULL;
+        return;
+    }
+    InitializeCriticalSection(&ctxVmm->CacheCompress.Lock);
+    ctxVmm->CacheCompress.cbMax = (QWORD)ctxMain->cfg.cMBCacheCompress << 20;
+    ctxVmm->CacheCompress.fInitialized = TRUE;
+}
+
+VOID VmmCacheCompress_Close()
+{
+    if(!ctxVmm->CacheCompress.fInitialized) { return; }
+    ctxVmm->CacheCompress.fInitialized = FALSE;
+    ctxVmm->CacheCompress.cbMax = 0;
+    Ob_DECREF_NULL(&ctxVmm->CacheCompress.pm);
+    LocalFree(ctxVmm->CacheCompress.pvWorkSpace);
+    ctxVmm->CacheCompress.pvWorkSpace = NULL;
+    DeleteCriticalSection(&ctxVmm->CacheCompress.Lock);
+}
 
 /*
 * Invalidate a cache entry (if exists)
@@ -55,78 +355,183 @@ VOID VmmCacheInvalidate_2(_In_ DWORD dwTblTag, _In_ QWORD qwA)
     if(!t || !t->fActive) { return; }
     iR = VMM_CACHE2_GET_REGION(qwA);
     iB = VMM_CACHE2_GET_BUCKET(qwA);
-    EnterCriticalSection(&t->R[iR].Lock);
+    VmmCacheRegionLock(t, iR);
     pOb = t->R[iR].B[iB];
     while(pOb) {
         pObNext = pOb->FLink;
         if(pOb->h.qwA == qwA) {
-            // detach bucket
-            if(pOb->BLink) {
-                pOb->BLink->FLink = pOb->FLink;
-            } else {
-                t->R[iR].B[iB] = pOb->FLink;
-            }
-            if(pOb->FLink) {
-                pOb->FLink->BLink = pOb->BLink;
-            }
-            // detach age list
-            if(pOb->AgeBLink) {
-                pOb->AgeBLink->AgeFLink = pOb->AgeFLink;
-            } else {
-                t->R[iR].AgeFLink = pOb->AgeFLink;
-            }
-            if(pOb->AgeFLink) {
-                pOb->AgeFLink->AgeBLink = pOb->AgeBLink;
-            } else {
-                t->R[iR].AgeBLink = pOb->AgeBLink;
-            }
+            VmmCacheBucketDetach(t, iR, pOb);
+            VmmCacheAgeDetach(t, iR, pOb);
             // decrease count & decref
             InterlockedDecrement(&t->R[iR].c);
             Ob_DECREF(pOb);
         }
         pOb = pObNext;
     }
-    LeaveCriticalSection(&t->R[iR].Lock);
+    VmmCacheRegionUnlock(t, iR);
 }
 
 VOID VmmCacheInvalidate(_In_ QWORD pa)
 {
+    InterlockedIncrement(&ctxVmm->dwSoftTlbGeneration);
     VmmCacheInvalidate_2(VMM_CACHE_TAG_TLB, pa);
     VmmCacheInvalidate_2(VMM_CACHE_TAG_PHYS, pa);
+    VmmCacheCompress_Invalidate(pa);
 }
 
+/*
+* Reclaim entries from a cache region. Entries are evicted oldest first from
+* the probation age list and from the hot age list only if probation is empty.
+* If the 2Q policy is active referenced probation entries are promoted to the
+* hot list instead of being evicted. The hot list is capped at half of the
+* region - surplus hot entries are demoted back to probation. This keeps the
+* 'hot' working set (such as page tables) alive during large linear reads.
+* Evicted physical memory cache entries are compressed into the compressed
+* cache tier (if enabled) after the region lock is released.
+* -- t
+* -- iR
+* -- fTotal = evict all entries.
+*/
 VOID VmmCacheReclaim(_In_ PVMM_CACHE_TABLE t, _In_ DWORD iR, _In_ BOOL fTotal)
 {
-    DWORD cThreshold;
-    PVMMOB_MEM pOb;
-    EnterCriticalSection(&t->R[iR].Lock);
+    DWORD i, cThreshold, cPromoteMax, cCompress = 0, cCompressMax = 0;
+    PVMMOB_MEM pOb, pObDemote;
+    PPVMMOB_MEM ppObCompress = NULL;
+    if(!fTotal && (t->tag == VMM_CACHE_TAG_PHYS) && ctxVmm->CacheCompress.cbMax) {
+        cCompressMax = t->R[iR].c;
+        if(!(ppObCompress = LocalAlloc(0, max(1, cCompressMax) * sizeof(PVMMOB_MEM)))) { cCompressMax = 0; }
+    }
+    VmmCacheRegionLock(t, iR);
     cThreshold = fTotal ? 0 : max(0x10, t->R[iR].c >> 1);
+    cPromoteMax = t->R[iR].c;
     while(t->R[iR].c > cThreshold) {
         // get
-        pOb = t->R[iR].AgeBLink;
+        pOb = t->R[iR].AgeBLink ? t->R[iR].AgeBLink : t->R[iR].HotBLink;
         if(!pOb) {
             vmmprintf_fn("ERROR - SHOULD NOT HAPPEN - NULL OBJECT RETRIEVED\n");
             break;
         }
-        // detach from age list
-        t->R[iR].AgeBLink = pOb->AgeBLink;
-        if(pOb->AgeBLink) {
-            pOb->AgeBLink->AgeFLink = NULL;
-        } else {
-            t->R[iR].AgeFLink = NULL;
+        VmmCacheAgeDetach(t, iR, pOb);
+        // 2Q: promote referenced probation entry to hot list
+        if(t->f2Q && !fTotal && pOb->fRef && cPromoteMax) {
+            cPromoteMax--;
+            pOb->fRef = FALSE;
+            VmmCacheAgeAttach(t, iR, pOb, TRUE);
+            if((t->R[iR].cHot > (t->R[iR].c >> 1)) && (pObDemote = t->R[iR].HotBLink)) {
+                VmmCacheAgeDetach(t, iR, pObDemote);
+                pObDemote->fRef = FALSE;
+                VmmCacheAgeAttach(t, iR, pObDemote, FALSE);
+            }
+            continue;
         }
-        // detach from bucket list
-        if(pOb->BLink) {
-            pOb->BLink->FLink = NULL;
-        } else {
-            t->R[iR].B[VMM_CACHE2_GET_BUCKET(pOb->h.qwA)] = NULL;
+        VmmCacheBucketDetach(t, iR, pOb);
+        if(!fTotal) {
+            InterlockedIncrement64(&t->stat.cEvict);
+        }
+        if(pOb->fReadAhead) {
+            pOb->fReadAhead = FALSE;
+            InterlockedIncrement64(&ctxVmm->stat.cPhysReadAheadMiss);
+        }
+        InterlockedDecrement(&t->R[iR].c);
+        if(pOb->h.f && (cCompress < cCompressMax)) {
+            // region refcount is overtaken by the compression list.
+            ppObCompress[cCompress++] = pOb;
+            continue;
         }
         // remove region refcount of object - callback will take care of
         // re-insertion into empty list when refcount becomes low enough.
         Ob_DECREF(pOb);
-        InterlockedDecrement(&t->R[iR].c);
     }
-    LeaveCriticalSection(&t->R[iR].Lock);
+    VmmCacheRegionUnlock(t, iR);
+    for(i = 0; i < cCompress; i++) {
+        VmmCacheCompress_Store(ppObCompress[i]);
+        Ob_DECREF(ppObCompress[i]);
+    }
+    LocalFree(ppObCompress);
+}
+
+/*
+* Free cache entries removed by a cache shrink. Entries are retired for one
+* cache clear period before being free'd since lock-free readers that started
+* their bucket walk before the removal may still access them.
+* -- t
+* -- fAll = free all retired entries (on close).
+*/
+VOID VmmCacheRetiredFree(_In_ PVMM_CACHE_TABLE t, _In_ BOOL fAll)
+{
+    PVMMOB_MEM pOb;
+    PSLIST_ENTRY e, eNext;
+    DWORD i;
+    for(i = 0; i < (fAll ? 2UL : 1UL); i++) {
+        // 1: free entries retired during the previous clear period
+        e = InterlockedFlushSList(&t->ListHeadRetiredOld);
+        while(e) {
+            eNext = e->Next;
+            pOb = CONTAINING_RECORD(e, VMMOB_MEM, SListEmpty);
+            Ob_DECREF(pOb);     // "empty list" reference
+            Ob_DECREF(pOb);     // "total list" reference
+            e = eNext;
+        }
+        // 2: age entries retired during this clear period
+        e = InterlockedFlushSList(&t->ListHeadRetired);
+        while(e) {
+            eNext = e->Next;
+            InterlockedPushEntrySList(&t->ListHeadRetiredOld, e);
+            e = eNext;
+        }
+    }
+}
+
+/*
+* Remove unused surplus entries from a cache table that have been shrunk.
+* Entries currently in use are left in the cache and will be re-used.
+* NB! caller must hold ctxVmm->LockMaster.
+* -- t
+*/
+VOID VmmCacheTrim(_In_ PVMM_CACHE_TABLE t)
+{
+    DWORD i, cTrim = 0;
+    PVMMOB_MEM pOb;
+    PSLIST_ENTRY e, eNext;
+    // 1: clear regions and remove surplus entries from the empty list
+    for(i = 0; i < VMM_CACHE2_REGIONS; i++) {
+        VmmCacheReclaim(t, i, TRUE);
+    }
+    while((t->cTotal - cTrim > t->cMaxEntries) && (e = InterlockedPopEntrySList(&t->ListHeadEmpty))) {
+        InterlockedDecrement(&t->cEmpty);
+        pOb = CONTAINING_RECORD(e, VMMOB_MEM, SListEmpty);
+        pOb->fTrim = TRUE;
+        cTrim++;
+    }
+    if(!cTrim) { return; }
+    // 2: rebuild total list without the removed entries and retire them
+    e = InterlockedFlushSList(&t->ListHeadTotal);
+    while(e) {
+        eNext = e->Next;
+        pOb = CONTAINING_RECORD(e, VMMOB_MEM, SListTotal);
+        if(pOb->fTrim) {
+            InterlockedPushEntrySList(&t->ListHeadRetired, &pOb->SListEmpty);
+            InterlockedDecrement(&t->cTotal);
+        } else {
+            InterlockedPushEntrySList(&t->ListHeadTotal, &pOb->SListTotal);
+        }
+        e = eNext;
+    }
+}
+
+/*
+* Reset the process 'is spider done' flag after TLB cache entries are removed.
+*/
+VOID VmmCacheTlbSpiderReset()
+{
+    PVMM_PROCESS pObProcess = NULL;
+    while((pObProcess = VmmProcessGetNext(pObProcess, 0))) {
+        if(pObProcess->fTlbSpiderDone) {
+            EnterCriticalSection(&pObProcess->LockUpdate);
+            pObProcess->fTlbSpiderDone = FALSE;
+            LeaveCriticalSection(&pObProcess->LockUpdate);
+        }
+    }
 }
 
 /*
@@ -137,22 +542,40 @@ VOID VmmCacheClear(_In_ DWORD dwTblTag)
 {
     DWORD i;
     PVMM_CACHE_TABLE t;
-    PVMM_PROCESS pObProcess = NULL;
     // 1: clear cache
     t = VmmCacheTableGet(dwTblTag);
     for(i = 0; i < VMM_CACHE2_REGIONS; i++) {
         VmmCacheReclaim(t, i, TRUE);
     }
+    VmmCacheRetiredFree(t, FALSE);
+    if(dwTblTag == VMM_CACHE_TAG_PHYS) {
+        VmmCacheCompress_Clear();
+        InterlockedIncrement64(&ctxVmm->PageDigest.qwGeneration);
+    }
     // 2: if tlb cache clear -> update process 'is spider done' flag
     if(dwTblTag == VMM_CACHE_TAG_TLB) {
-        while((pObProcess = VmmProcessGetNext(pObProcess, 0))) {
-            if(pObProcess->fTlbSpiderDone) {
-                EnterCriticalSection(&pObProcess->LockUpdate);
-                pObProcess->fTlbSpiderDone = FALSE;
-                LeaveCriticalSection(&pObProcess->LockUpdate);
-            }
-        }
+        InterlockedIncrement64(&ctxVmm->PageDigest.qwGeneration);
+        InterlockedIncrement(&ctxVmm->dwSoftTlbGeneration);
+        VmmCacheTlbSpiderReset();
+    }
+}
+
+_Success_(return)
+BOOL VmmCacheConfigure(_In_ DWORD dwTblTag, _In_ DWORD cMaxEntries, _In_ BOOL f2Q)
+{
+    PVMM_CACHE_TABLE t;
+    t = VmmCacheTableGet(dwTblTag);
+    if(!t || !t->fActive) { return FALSE; }
+    if(!cMaxEntries) { cMaxEntries = VMM_CACHE2_MAX_ENTRIES; }
+    if((cMaxEntries < VMM_CACHE2_MIN_ENTRIES) || (cMaxEntries > VMM_CACHE2_LIMIT_ENTRIES)) { return FALSE; }
+    EnterCriticalSection(&ctxVmm->LockMaster);
+    t->f2Q = f2Q;
+    t->cMaxEntries = cMaxEntries;
+    if(t->cTotal > t->cMaxEntries) {
+        VmmCacheTrim(t);
     }
+    LeaveCriticalSection(&ctxVmm->LockMaster);
+    return TRUE;
 }
 
 VOID VmmCache_CallbackRefCount1(PVMMOB_MEM pOb)
@@ -163,7 +586,7 @@ VOID VmmCache_CallbackRefCount1(PVMMOB_MEM pOb)
         vmmprintf_fn("ERROR - SHOULD NOT HAPPEN - INVALID OBJECT TAG %02X\n", ((POB)pOb)->_tag);
         return;
     }
-    if(!t->fActive) { return; }
+    if(!t->fActive || pOb->fTrim) { return; }
     Ob_INCREF(pOb);
     InterlockedPushEntrySList(&t->ListHeadEmpty, &pOb->SListEmpty);
     InterlockedIncrement(&t->cEmpty);
@@ -194,20 +617,17 @@ VOID VmmCacheReserveReturn(_In_opt_ PVMMOB_MEM pOb)
     // insert into map - refcount will be overtaken by "cache region".
     iR = VMM_CACHE2_GET_REGION(pOb->h.qwA);
     iB = VMM_CACHE2_GET_BUCKET(pOb->h.qwA);
-    EnterCriticalSection(&t->R[iR].Lock);
+    VmmCacheRegionLock(t, iR);
     // insert into "bucket"
     pOb->BLink = NULL;
     pOb->FLink = t->R[iR].B[iB];
     if(pOb->FLink) { pOb->FLink->BLink = pOb; }
     t->R[iR].B[iB] = pOb;
-    // insert into "age list"
-    pOb->AgeFLink = t->R[iR].AgeFLink;
-    if(pOb->AgeFLink) { pOb->AgeFLink->AgeBLink = pOb; }
-    pOb->AgeBLink = NULL;
-    t->R[iR].AgeFLink = pOb;
-    if(!t->R[iR].AgeBLink) { t->R[iR].AgeBLink = pOb; }
+    // insert into "age list" (probation)
+    pOb->fRef = FALSE;
+    VmmCacheAgeAttach(t, iR, pOb, FALSE);
     InterlockedIncrement(&t->R[iR].c);
-    LeaveCriticalSection(&t->R[iR].Lock);
+    VmmCacheRegionUnlock(t, iR);
 }
 
 PVMMOB_MEM VmmCacheReserve(_In_ DWORD dwTblTag)
@@ -219,10 +639,13 @@ PVMMOB_MEM VmmCacheReserve(_In_ DWORD dwTblTag)
     t = VmmCacheTableGet(dwTblTag);
     if(!t || !t->fActive) { return NULL; }
     while(!(e = InterlockedPopEntrySList(&t->ListHeadEmpty))) {
-        if(t->cTotal < VMM_CACHE2_MAX_ENTRIES) {
+        if(t->cTotal < t->cMaxEntries) {
             // below max threshold -> create new
             pOb = Ob_Alloc(t->tag, LMEM_ZEROINIT, sizeof(VMMOB_MEM), NULL, VmmCache_CallbackRefCount1);
-            if(!pOb) { return NULL; }
+            if(!pOb) {
+                InterlockedIncrement64(&t->stat.cReserveFail);
+                return NULL;
+            }
             pOb->h.version = MEM_SCATTER_VERSION;
             pOb->h.cb = 0x1000;
             pOb->h.pb = pOb->pb;
@@ -236,6 +659,7 @@ PVMMOB_MEM VmmCacheReserve(_In_ DWORD dwTblTag)
         iReclaimLast = InterlockedIncrement16(&t->iReclaimLast);
         VmmCacheReclaim(t, iReclaimLast % VMM_CACHE2_REGIONS, FALSE);
         if(++cLoopProtect == VMM_CACHE2_REGIONS) {
+            InterlockedIncrement64(&t->stat.cReserveFail);
             vmmprintf_fn("ERROR - SHOULD NOT HAPPEN - CACHE %04X DRAINED OF ENTRIES\n", dwTblTag);
             Sleep(10);
         }
@@ -244,67 +668,551 @@ PVMMOB_MEM VmmCacheReserve(_In_ DWORD dwTblTag)
     pOb = CONTAINING_RECORD(e, VMMOB_MEM, SListEmpty);
     pOb->h.qwA = MEM_SCATTER_ADDR_INVALID;
     pOb->h.f = FALSE;
+    pOb->fReadAhead = FALSE;
     return pOb; // reference overtaken by callee (from EmptyList)
 }
 
+/*
+* Try to take a reference to a cache object found by a lock-free reader. The
+* reference is only taken if the object is held by a region or is in use, i.e.
+* refcount >= 2 (total list + region/user). Objects at refcount 1 are in the
+* process of being returned to the empty list and must not be revived.
+* -- pOb
+* -- return
+*/
+_Success_(return)
+BOOL VmmCacheGet_TryIncref(_In_ PVMMOB_MEM pOb)
+{
+    LONG c;
+    while((c = *(volatile LONG*)&pOb->Ob._count) >= 2) {
+        if(c == InterlockedCompareExchange((volatile LONG*)&pOb->Ob._count, c + 1, c)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
 PVMMOB_MEM VmmCacheGet(_In_ DWORD dwTblTag, _In_ QWORD qwA)
 {
     PVMM_CACHE_TABLE t;
-    DWORD iR;
+    DWORD iR, iB, dwSeq, cWalk = 0;
     PVMMOB_MEM pOb;
     t = VmmCacheTableGet(dwTblTag);
     if(!t || !t->fActive) { return NULL; }
     iR = VMM_CACHE2_GET_REGION(qwA);
+    iB = VMM_CACHE2_GET_BUCKET(qwA);
+    // 1: lock-free read: cache objects are never free'd while the table is
+    //    active so it's safe to walk the bucket list without the lock as long
+    //    as the region write sequence is unchanged after the reference is taken.
+    dwSeq = t->R[iR].dwSeq;
+    if(!(dwSeq & 1)) {
+        pOb = t->R[iR].B[iB];
+        while(pOb && (qwA != pOb->h.qwA) && (++cWalk < VMM_CACHE2_LOCKFREE_MAXWALK)) {
+            pOb = pOb->FLink;
+        }
+        if(cWalk < VMM_CACHE2_LOCKFREE_MAXWALK) {
+            if(!pOb) {
+                if(dwSeq == t->R[iR].dwSeq) {
+                    InterlockedIncrement64(&t->stat.cMiss);
+                    return NULL;
+                }
+            } else if(VmmCacheGet_TryIncref(pOb)) {
+                if((dwSeq == t->R[iR].dwSeq) && (qwA == pOb->h.qwA)) {
+                    if(t->f2Q && !pOb->fRef) { pOb->fRef = TRUE; }
+                    InterlockedIncrement64(&t->stat.cHit);
+                    return pOb;
+                }
+                Ob_DECREF(pOb);
+            }
+        }
+    }
+    // 2: concurrent write in region -> fall back to locked read.
+    InterlockedIncrement64(&ctxVmm->stat.cCacheReadLockFallback);
     EnterCriticalSection(&t->R[iR].Lock);
-    pOb = t->R[iR].B[VMM_CACHE2_GET_BUCKET(qwA)];
+    pOb = t->R[iR].B[iB];
     while(pOb && (qwA != pOb->h.qwA)) {
         pOb = pOb->FLink;
     }
+    if(pOb && t->f2Q) { pOb->fRef = TRUE; }
     Ob_INCREF(pOb);
     LeaveCriticalSection(&t->R[iR].Lock);
+    InterlockedIncrement64(pOb ? &t->stat.cHit : &t->stat.cMiss);
     return pOb;
 }
 
-PVMMOB_MEM VmmCacheGet_FromDeviceOnMiss(_In_ DWORD dwTblTag, _In_ DWORD dwTblTagSecondaryOpt, _In_ QWORD qwA)
+/*
+* Update the remote device profile with the time taken by a small device read
+* and re-tune the coalescing window and read-ahead depth from the smoothed
+* round-trip time. Updates are racy by design - the values are estimates only.
+* -- qwUs = time taken by the read in uS.
+*/
+VOID VmmDeviceSched_RemoteUpdate(_In_ QWORD qwUs)
 {
-    PVMMOB_MEM pObMEM, pObReservedMEM;
-    PMEM_SCATTER pMEM;
-    pObMEM = VmmCacheGet(dwTblTag, qwA);
-    if(pObMEM) { return pObMEM; }
-    if((pObReservedMEM = VmmCacheReserve(dwTblTag))) {
-        pMEM = &pObReservedMEM->h;
-        pMEM->qwA = qwA;
-        if(dwTblTagSecondaryOpt && (pObMEM = VmmCacheGet(dwTblTagSecondaryOpt, qwA))) {
-            pMEM->f = TRUE;
-            memcpy(pMEM->pb, pObMEM->pb, 0x1000);
-            Ob_DECREF(pObMEM);
-            pObMEM = NULL;
-        }
-        if(!pMEM->f) {
-            LcReadScatter(ctxMain->hLC, 1, &pMEM);
-        }
-        if(pMEM->f) {
-            Ob_INCREF(pObReservedMEM);
-            VmmCacheReserveReturn(pObReservedMEM);
-            return pObReservedMEM;
-        }
-        VmmCacheReserveReturn(pObReservedMEM);
+    DWORD cUsRtt = ctxVmm->DeviceSched.Remote.cUsRtt;
+    cUsRtt = (DWORD)(cUsRtt ? (((QWORD)cUsRtt * 7 + qwUs) >> 3) : min(qwUs, 0xffffffff));
+    ctxVmm->DeviceSched.Remote.cUsRtt = cUsRtt;
+    ctxVmm->DeviceSched.Remote.cUsCoalesceWindow = min(VMM_COALESCE_WINDOW_US_MAX, cUsRtt >> 2);
+    ctxVmm->DeviceSched.Remote.cReadAheadMult = (cUsRtt >= 10000) ? 16 : ((cUsRtt >= 1000) ? 4 : 1);
+}
+
+/*
+* Issue a read to the device. Small reads on a remote device are timed to
+* keep track of the device round-trip time.
+* -- cpMEMs
+* -- ppMEMs
+*/
+VOID VmmDeviceReadScatter_LcRead(_In_ DWORD cpMEMs, _Inout_ PPMEM_SCATTER ppMEMs)
+{
+    QWORD tmStart, tmEnd;
+    if(!ctxVmm->DeviceSched.Remote.fEnabled || (cpMEMs > VMM_DEVICE_REMOTE_RTT_PAGES) || !ctxVmm->qwPerfFreq) {
+        VmmDevTrace_ReadScatter(cpMEMs, ppMEMs);
+        return;
     }
-    return NULL;
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmStart);
+    VmmDevTrace_ReadScatter(cpMEMs, ppMEMs);
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmEnd);
+    VmmDeviceSched_RemoteUpdate((tmEnd - tmStart) * 1000000ULL / ctxVmm->qwPerfFreq);
 }
 
-BOOL VmmCacheExists(_In_ DWORD dwTblTag, _In_ QWORD qwA)
+VOID VmmDeviceSched_ExternalBegin()
 {
-    BOOL result;
-    PVMMOB_MEM pOb;
-    pOb = VmmCacheGet(dwTblTag, qwA);
-    result = pOb != NULL;
-    Ob_DECREF(pOb);
-    return result;
+    InterlockedIncrement(&ctxVmm->DeviceSched.cExternal);
+}
+
+VOID VmmDeviceSched_ExternalEnd()
+{
+    if(0 == InterlockedDecrement(&ctxVmm->DeviceSched.cExternal)) {
+        AcquireSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+        WakeAllConditionVariable(&ctxVmm->DeviceSched.CondIdle);
+        ReleaseSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+    }
 }
 
 /*
-* Retrieve a page table from a given physical address (if possible).
+* Retrieve the coalescing window currently in effect.
+* -- return = coalescing window in uS, 0 = disabled.
+*/
+DWORD VmmDeviceSched_CoalesceWindow()
+{
+    DWORD cUs = ctxVmm->DeviceSched.cUsCoalesceWindow;
+    if(ctxVmm->DeviceSched.Remote.fEnabled && (cUs || !ctxVmm->DeviceSched.fCoalesceWindowSet)) {
+        cUs = max(cUs, ctxVmm->DeviceSched.Remote.cUsCoalesceWindow);
+    }
+    return cUs;
+}
+
+/*
+* Read a single bulk priority slice. The slice waits for active interactive
+* reads to finish (up to VMM_DEVICE_BULK_MAXWAIT_MS) before being issued.
+* -- cpMEMs
+* -- ppMEMs
+*/
+VOID VmmDeviceReadScatter_BulkSlice(_In_ DWORD cpMEMs, _Inout_ PPMEM_SCATTER ppMEMs)
+{
+    QWORD tmStart;
+    AcquireSRWLockShared(&ctxVmm->DeviceSched.LockSRW);
+    if(ctxVmm->DeviceSched.cInteractive) {
+        InterlockedIncrement64(&ctxVmm->stat.cDeviceReadBulkYield);
+        tmStart = GetTickCount64();
+        while(ctxVmm->DeviceSched.cInteractive && (GetTickCount64() - tmStart < VMM_DEVICE_BULK_MAXWAIT_MS)) {
+            SleepConditionVariableSRW(&ctxVmm->DeviceSched.CondIdle, &ctxVmm->DeviceSched.LockSRW, VMM_DEVICE_BULK_MAXWAIT_MS, CONDITION_VARIABLE_LOCKMODE_SHARED);
+        }
+    }
+    ReleaseSRWLockShared(&ctxVmm->DeviceSched.LockSRW);
+    InterlockedIncrement64(&ctxVmm->stat.cDeviceReadBulkSlice);
+    VmmDeviceReadScatter_LcRead(cpMEMs, ppMEMs);
+}
+
+typedef struct tdVMM_DEVICE_BULK_PIPELINE {
+    volatile LONG cRef;
+    volatile LONG iSliceNext;
+    volatile LONG cSliceDone;
+    DWORD cSlice;
+    DWORD cpMEMs;
+    PPMEM_SCATTER ppMEMs;
+    HANDLE hEventDone;
+} VMM_DEVICE_BULK_PIPELINE, *PVMM_DEVICE_BULK_PIPELINE;
+
+VOID VmmDeviceReadScatter_BulkPipeline_DECREF(_In_ PVMM_DEVICE_BULK_PIPELINE pp)
+{
+    if(0 == InterlockedDecrement(&pp->cRef)) {
+        CloseHandle(pp->hEventDone);
+        LocalFree(pp);
+    }
+}
+
+/*
+* Read slices of a pipelined bulk read until no slices remain. Executed both
+* by the requesting thread and by the helper work items. A slice is only ever
+* claimed by a running thread, helper work items starting late will find no
+* remaining slices - the requesting thread never waits for queued work items.
+* -- pp
+* -- return
+*/
+DWORD VmmDeviceReadScatter_BulkPipeline_DoWork(_In_ PVMM_DEVICE_BULK_PIPELINE pp)
+{
+    DWORD iSlice, iBase;
+    while((iSlice = (DWORD)InterlockedIncrement(&pp->iSliceNext) - 1) < pp->cSlice) {
+        iBase = iSlice * VMM_DEVICE_REMOTE_BULK_SLICE;
+        VmmDeviceReadScatter_BulkSlice(min(VMM_DEVICE_REMOTE_BULK_SLICE, pp->cpMEMs - iBase), pp->ppMEMs + iBase);
+        if((DWORD)InterlockedIncrement(&pp->cSliceDone) == pp->cSlice) {
+            SetEvent(pp->hEventDone);
+        }
+    }
+    return 0;
+}
+
+DWORD VmmDeviceReadScatter_BulkPipeline_ThreadProc(_In_ PVMM_DEVICE_BULK_PIPELINE pp)
+{
+    if(ctxVmm->Work.fEnabled) {
+        VmmDeviceReadScatter_BulkPipeline_DoWork(pp);
+    }
+    VmmDeviceReadScatter_BulkPipeline_DECREF(pp);
+    return 0;
+}
+
+/*
+* Perform a pipelined bulk priority device read on a remote device. Large
+* slices are read with up to VMM_DEVICE_REMOTE_INFLIGHT slices in flight to
+* hide the round-trip time of the remote device.
+* -- cpMEMs
+* -- ppMEMs
+* -- return = TRUE if the read was completed, FALSE if it should be performed
+*             without pipelining.
+*/
+_Success_(return)
+BOOL VmmDeviceReadScatter_BulkPipeline(_In_ DWORD cpMEMs, _Inout_ PPMEM_SCATTER ppMEMs)
+{
+    DWORD i, cHelper;
+    PVMM_DEVICE_BULK_PIPELINE pp;
+    if(!(pp = LocalAlloc(LMEM_ZEROINIT, sizeof(VMM_DEVICE_BULK_PIPELINE)))) { return FALSE; }
+    if(!(pp->hEventDone = CreateEvent(NULL, TRUE, FALSE, NULL))) {
+        LocalFree(pp);
+        return FALSE;
+    }
+    pp->cRef = 1;
+    pp->cpMEMs = cpMEMs;
+    pp->ppMEMs = ppMEMs;
+    pp->cSlice = (cpMEMs + VMM_DEVICE_REMOTE_BULK_SLICE - 1) / VMM_DEVICE_REMOTE_BULK_SLICE;
+    cHelper = min(VMM_DEVICE_REMOTE_INFLIGHT, pp->cSlice) - 1;
+    for(i = 0; i < cHelper; i++) {
+        InterlockedIncrement(&pp->cRef);
+        if(!VmmWorkRelease((LPTHREAD_START_ROUTINE)VmmDeviceReadScatter_BulkPipeline_ThreadProc, pp, (VOID(*)(PVOID))VmmDeviceReadScatter_BulkPipeline_DECREF, VMMWORK_PRIORITY_HIGH)) {
+            InterlockedDecrement(&pp->cRef);
+            break;
+        }
+    }
+    VmmDeviceReadScatter_BulkPipeline_DoWork(pp);
+    WaitForSingleObject(pp->hEventDone, INFINITE);
+    VmmDeviceReadScatter_BulkPipeline_DECREF(pp);
+    return TRUE;
+}
+
+/*
+* Perform a bulk priority device read. The read is split into slices and each
+* slice waits for active interactive reads to finish before being issued.
+* -- cpMEMs
+* -- ppMEMs
+*/
+VOID VmmDeviceReadScatter_Bulk(_In_ DWORD cpMEMs, _Inout_ PPMEM_SCATTER ppMEMs)
+{
+    DWORD iBase, cSlice;
+    if(ctxVmm->DeviceSched.Remote.fEnabled && (cpMEMs > VMM_DEVICE_REMOTE_BULK_SLICE) && VmmDeviceReadScatter_BulkPipeline(cpMEMs, ppMEMs)) {
+        return;
+    }
+    cSlice = ctxVmm->DeviceSched.Remote.fEnabled ? VMM_DEVICE_REMOTE_BULK_SLICE : VMM_DEVICE_BULK_SLICE;
+    for(iBase = 0; iBase < cpMEMs; iBase += cSlice) {
+        VmmDeviceReadScatter_BulkSlice(min(cSlice, cpMEMs - iBase), ppMEMs + iBase);
+    }
+}
+
+/*
+* Read a coalesced batch in one LcReadScatter call. Duplicate requests of the
+* same address are removed before the read and filled in afterwards.
+* -- pb
+*/
+VOID VmmDeviceReadScatter_CoalesceRead(_In_ PVMM_COALESCE_BATCH pb)
+{
+    DWORD i, j, iH, cUnique = 0;
+    PMEM_SCATTER pMEM, pMEMu;
+    WORD iHash[VMM_COALESCE_BATCH_MAX * 2];     // 1-based index of first occurrence, 0 = free
+    WORD iDup[VMM_COALESCE_BATCH_MAX];          // 1-based index of first occurrence, 0 = unique
+    PMEM_SCATTER ppMEMsUnique[VMM_COALESCE_BATCH_MAX];
+    ZeroMemory(iHash, sizeof(iHash));
+    for(i = 0; i < pb->cMEMs; i++) {
+        pMEM = pb->ppMEMs[i];
+        iDup[i] = 0;
+        iH = (DWORD)((pMEM->qwA >> 12) % _countof(iHash));
+        while((j = iHash[iH])) {
+            pMEMu = pb->ppMEMs[j - 1];
+            if((pMEMu->qwA == pMEM->qwA) && (pMEMu->cb == pMEM->cb)) {
+                iDup[i] = (WORD)j;
+                break;
+            }
+            iH = (iH + 1) % _countof(iHash);
+        }
+        if(!iDup[i]) {
+            iHash[iH] = (WORD)(i + 1);
+            ppMEMsUnique[cUnique++] = pMEM;
+        }
+    }
+    VmmDeviceReadScatter_LcRead(cUnique, ppMEMsUnique);
+    for(i = 0; i < pb->cMEMs; i++) {
+        if(iDup[i]) {
+            pMEM = pb->ppMEMs[i];
+            pMEMu = pb->ppMEMs[iDup[i] - 1];
+            if(pMEMu->f && !pMEM->f) {
+                memcpy(pMEM->pb, pMEMu->pb, pMEM->cb);
+                pMEM->f = TRUE;
+            }
+        }
+    }
+    InterlockedAdd64(&ctxVmm->stat.cDeviceReadCoalescedDup, pb->cMEMs - cUnique);
+}
+
+/*
+* Perform an interactive device read of a small number of pages by merging it
+* with reads of other threads arriving within a short time window. The first
+* thread to arrive becomes the leader of a batch, waits for the window to pass
+* and issues the read - other threads wait for the leader to complete.
+* -- cpMEMs
+* -- ppMEMs
+* -- return = TRUE if the read was completed, FALSE if it should be performed
+*             without coalescing.
+*/
+_Success_(return)
+BOOL VmmDeviceReadScatter_Coalesce(_In_ DWORD cpMEMs, _Inout_ PPMEM_SCATTER ppMEMs)
+{
+    BOOL fLeader = FALSE;
+    QWORD tmStart, tmNow, tmWindow;
+    PVMM_COALESCE_BATCH pb;
+    PVMM_COALESCE_BATCH pbNew = NULL;
+    AcquireSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+    pb = ctxVmm->DeviceSched.pCoalesce;
+    if(!pb || (pb->cMEMs + cpMEMs > VMM_COALESCE_BATCH_MAX)) {
+        // no open batch (or full) -> become leader of a new batch
+        ReleaseSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+        if(!(pbNew = LocalAlloc(LMEM_ZEROINIT, sizeof(VMM_COALESCE_BATCH)))) { return FALSE; }
+        AcquireSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+        pb = ctxVmm->DeviceSched.pCoalesce;
+        if(!pb || (pb->cMEMs + cpMEMs > VMM_COALESCE_BATCH_MAX)) {
+            pb = ctxVmm->DeviceSched.pCoalesce = pbNew;
+            pbNew = NULL;
+            fLeader = TRUE;
+        }
+    }
+    memcpy(pb->ppMEMs + pb->cMEMs, ppMEMs, cpMEMs * sizeof(PMEM_SCATTER));
+    pb->cMEMs += cpMEMs;
+    pb->cRef++;
+    if(fLeader) {
+        // leader: wait for the coalescing window to pass (or batch to fill up)
+        ReleaseSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+        QueryPerformanceCounter((PLARGE_INTEGER)&tmStart);
+        tmWindow = VmmDeviceSched_CoalesceWindow() * ctxVmm->qwPerfFreq / 1000000ULL;
+        do {
+            SwitchToThread();
+            QueryPerformanceCounter((PLARGE_INTEGER)&tmNow);
+        } while((tmNow - tmStart < tmWindow) && (pb->cMEMs < VMM_COALESCE_BATCH_MAX));
+        AcquireSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+        if(ctxVmm->DeviceSched.pCoalesce == pb) {
+            ctxVmm->DeviceSched.pCoalesce = NULL;
+        }
+        ReleaseSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+        VmmDeviceReadScatter_CoalesceRead(pb);
+        AcquireSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+        pb->fDone = TRUE;
+        WakeAllConditionVariable(&ctxVmm->DeviceSched.CondCoalesce);
+    } else {
+        // follower: wait for leader to complete the batch
+        InterlockedIncrement64(&ctxVmm->stat.cDeviceReadCoalesced);
+        while(!pb->fDone) {
+            SleepConditionVariableSRW(&ctxVmm->DeviceSched.CondCoalesce, &ctxVmm->DeviceSched.LockSRW, INFINITE, 0);
+        }
+    }
+    if(0 == --pb->cRef) {
+        LocalFree(pb);
+    }
+    ReleaseSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+    LocalFree(pbNew);
+    return TRUE;
+}
+
+VOID VmmDeviceReadScatter(_In_ DWORD cpMEMs, _Inout_ PPMEM_SCATTER ppMEMs, _In_ QWORD flags)
+{
+    DWORD iBucket = 0;
+    QWORD tmStart, tmEnd, qwUs;
+    BOOL fBulk = (flags & VMM_FLAG_PRIORITY_BULK) ? TRUE : FALSE;
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmStart);
+    if(fBulk) {
+        VmmDeviceReadScatter_Bulk(cpMEMs, ppMEMs);
+    } else {
+        AcquireSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+        ctxVmm->DeviceSched.cInteractive++;
+        ReleaseSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+        if(!VmmDeviceSched_CoalesceWindow() || (cpMEMs > VMM_COALESCE_REQUEST_MAX) || !VmmDeviceReadScatter_Coalesce(cpMEMs, ppMEMs)) {
+            VmmDeviceReadScatter_LcRead(cpMEMs, ppMEMs);
+        }
+        AcquireSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+        if(0 == --ctxVmm->DeviceSched.cInteractive) {
+            WakeAllConditionVariable(&ctxVmm->DeviceSched.CondIdle);
+        }
+        ReleaseSRWLockExclusive(&ctxVmm->DeviceSched.LockSRW);
+    }
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmEnd);
+    qwUs = ctxVmm->qwPerfFreq ? ((tmEnd - tmStart) * 1000000ULL / ctxVmm->qwPerfFreq) : 0;
+    InterlockedIncrement64(&ctxVmm->stat.cDeviceRead);
+    InterlockedAdd64(&ctxVmm->stat.cDeviceReadPages, cpMEMs);
+    InterlockedAdd64(&ctxVmm->stat.tmDeviceReadUs, qwUs);
+    while(qwUs && (iBucket < VMM_LATENCY_HISTOGRAM_BUCKETS - 1)) {
+        qwUs = qwUs >> 1;
+        iBucket++;
+    }
+    InterlockedIncrement64(&ctxVmm->stat.cDeviceReadLatency[iBucket]);
+}
+
+#define VMM_INFLIGHT_CLAIM_FAIL     0
+#define VMM_INFLIGHT_CLAIM_OWNER    1
+#define VMM_INFLIGHT_CLAIM_WAIT     2
+
+/*
+* Try to claim a physical page for reading from the device. If the page is
+* already being read by another thread the caller should wait for the read to
+* complete (VmmInFlight_Wait) and then retrieve the page from the cache.
+* -- pa
+* -- return = VMM_INFLIGHT_CLAIM_OWNER - caller must read and VmmInFlight_Release.
+*             VMM_INFLIGHT_CLAIM_WAIT  - page is being read by another thread.
+*             VMM_INFLIGHT_CLAIM_FAIL  - table full, read without deduplication.
+*/
+DWORD VmmInFlight_Claim(_In_ QWORD pa)
+{
+    DWORD i, iFree = VMM_INFLIGHT_BUCKET_SLOTS, tp = VMM_INFLIGHT_CLAIM_FAIL;
+    PVMM_INFLIGHT_BUCKET b = &ctxVmm->InFlight[(pa >> 12) % VMM_INFLIGHT_BUCKETS];
+    pa |= 1;    // ensure non-zero slot value for physical address zero
+    AcquireSRWLockExclusive(&b->LockSRW);
+    for(i = 0; i < VMM_INFLIGHT_BUCKET_SLOTS; i++) {
+        if(b->pa[i] == pa) {
+            tp = VMM_INFLIGHT_CLAIM_WAIT;
+            break;
+        }
+        if(!b->pa[i] && (iFree == VMM_INFLIGHT_BUCKET_SLOTS)) {
+            iFree = i;
+        }
+    }
+    if((tp != VMM_INFLIGHT_CLAIM_WAIT) && (iFree < VMM_INFLIGHT_BUCKET_SLOTS)) {
+        b->pa[iFree] = pa;
+        tp = VMM_INFLIGHT_CLAIM_OWNER;
+    }
+    ReleaseSRWLockExclusive(&b->LockSRW);
+    return tp;
+}
+
+/*
+* Release a page previously claimed by VmmInFlight_Claim and wake any threads
+* waiting for it. The page should be inserted into the cache before release.
+* -- pa
+*/
+VOID VmmInFlight_Release(_In_ QWORD pa)
+{
+    DWORD i;
+    PVMM_INFLIGHT_BUCKET b = &ctxVmm->InFlight[(pa >> 12) % VMM_INFLIGHT_BUCKETS];
+    pa |= 1;
+    AcquireSRWLockExclusive(&b->LockSRW);
+    for(i = 0; i < VMM_INFLIGHT_BUCKET_SLOTS; i++) {
+        if(b->pa[i] == pa) {
+            b->pa[i] = 0;
+            break;
+        }
+    }
+    ReleaseSRWLockExclusive(&b->LockSRW);
+    WakeAllConditionVariable(&b->Cond);
+}
+
+/*
+* Wait for an in-flight read of a page by another thread to complete.
+* NB! caller must not hold any claimed pages - or deadlock may occur.
+* -- pa
+* -- return = TRUE if the page was in-flight and the read was waited upon.
+*/
+BOOL VmmInFlight_Wait(_In_ QWORD pa)
+{
+    DWORD i;
+    BOOL fFound = TRUE, fWait = FALSE;
+    PVMM_INFLIGHT_BUCKET b = &ctxVmm->InFlight[(pa >> 12) % VMM_INFLIGHT_BUCKETS];
+    pa |= 1;
+    AcquireSRWLockShared(&b->LockSRW);
+    while(fFound) {
+        for(fFound = FALSE, i = 0; i < VMM_INFLIGHT_BUCKET_SLOTS; i++) {
+            if(b->pa[i] == pa) {
+                fFound = TRUE;
+                break;
+            }
+        }
+        if(fFound) {
+            fWait = TRUE;
+            if(!SleepConditionVariableSRW(&b->Cond, &b->LockSRW, 1000, CONDITION_VARIABLE_LOCKMODE_SHARED)) {
+                break;  // timeout - fall back to reading page from device
+            }
+        }
+    }
+    ReleaseSRWLockShared(&b->LockSRW);
+    return fWait;
+}
+
+PVMMOB_MEM VmmCacheGet_FromDeviceOnMiss(_In_ DWORD dwTblTag, _In_ DWORD dwTblTagSecondaryOpt, _In_ QWORD qwA)
+{
+    DWORD tpInFlight;
+    PVMMOB_MEM pObMEM, pObReservedMEM;
+    PMEM_SCATTER pMEM;
+    pObMEM = VmmCacheGet(dwTblTag, qwA);
+    if(pObMEM) { return pObMEM; }
+    if(VMM_INFLIGHT_CLAIM_WAIT == (tpInFlight = VmmInFlight_Claim(qwA))) {
+        if(VmmInFlight_Wait(qwA) && (pObMEM = VmmCacheGet(dwTblTag, qwA))) {
+            InterlockedIncrement64(&ctxVmm->stat.cPhysReadInFlightWait);
+            return pObMEM;
+        }
+        tpInFlight = VmmInFlight_Claim(qwA);
+    }
+    if((pObReservedMEM = VmmCacheReserve(dwTblTag))) {
+        pMEM = &pObReservedMEM->h;
+        pMEM->qwA = qwA;
+        if(dwTblTagSecondaryOpt && (pObMEM = VmmCacheGet(dwTblTagSecondaryOpt, qwA))) {
+            pMEM->f = TRUE;
+            memcpy(pMEM->pb, pObMEM->pb, 0x1000);
+            Ob_DECREF(pObMEM);
+            pObMEM = NULL;
+        }
+        if(!pMEM->f && ((dwTblTag == VMM_CACHE_TAG_PHYS) || (dwTblTagSecondaryOpt == VMM_CACHE_TAG_PHYS)) && VmmCacheCompress_Load(qwA, pMEM->pb)) {
+            pMEM->f = TRUE;
+        }
+        if(!pMEM->f) {
+            VmmDeviceReadScatter(1, &pMEM, 0);
+        }
+        if(pMEM->f) {
+            Ob_INCREF(pObReservedMEM);
+            VmmCacheReserveReturn(pObReservedMEM);
+            pObMEM = pObReservedMEM;
+        } else {
+            VmmCacheReserveReturn(pObReservedMEM);
+        }
+    }
+    if(tpInFlight == VMM_INFLIGHT_CLAIM_OWNER) {
+        VmmInFlight_Release(qwA);
+    }
+    return pObMEM;
+}
+
+BOOL VmmCacheExists(_In_ DWORD dwTblTag, _In_ QWORD qwA)
+{
+    BOOL result;
+    PVMMOB_MEM pOb;
+    pOb = VmmCacheGet(dwTblTag, qwA);
+    result = pOb != NULL;
+    Ob_DECREF(pOb);
+    return result;
+}
+
+/*
+* Retrieve a page table from a given physical address (if possible).
 * CALLER DECREF: return
 * -- pa
 * -- fCacheOnly
@@ -347,6 +1255,8 @@ VOID VmmCache2Close(_In_ DWORD dwTblTag)
         VmmCacheReclaim(t, i, TRUE);
         DeleteCriticalSection(&t->R[i].Lock);
     }
+    // remove retired entries (removed by cache shrink)
+    VmmCacheRetiredFree(t, TRUE);
     // remove from "empty list"
     while(e = InterlockedPopEntrySList(&t->ListHeadEmpty)) {
         pOb = CONTAINING_RECORD(e, VMMOB_MEM, SListEmpty);
@@ -363,7 +1273,7 @@ VOID VmmCache2Close(_In_ DWORD dwTblTag)
 
 VOID VmmCache2Initialize(_In_ DWORD dwTblTag)
 {
-    DWORD i;
+    DWORD i, cMB = 0;
     PVMM_CACHE_TABLE t;
     t = VmmCacheTableGet(dwTblTag);
     if(!t || t->fActive) { return; }
@@ -372,6 +1282,21 @@ VOID VmmCache2Initialize(_In_ DWORD dwTblTag)
     }
     InitializeSListHead(&t->ListHeadEmpty);
     InitializeSListHead(&t->ListHeadTotal);
+    InitializeSListHead(&t->ListHeadRetired);
+    InitializeSListHead(&t->ListHeadRetiredOld);
+    switch(dwTblTag) {
+        case VMM_CACHE_TAG_PHYS:
+            cMB = ctxMain->cfg.cMBCachePhys;
+            t->f2Q = ctxMain->cfg.fCachePhys2Q;
+            break;
+        case VMM_CACHE_TAG_TLB:
+            cMB = ctxMain->cfg.cMBCacheTlb;
+            break;
+        case VMM_CACHE_TAG_PAGING:
+            cMB = ctxMain->cfg.cMBCachePaging;
+            break;
+    }
+    t->cMaxEntries = cMB ? (DWORD)min(VMM_CACHE2_LIMIT_ENTRIES, max(VMM_CACHE2_MIN_ENTRIES, (QWORD)cMB << 8)) : VMM_CACHE2_MAX_ENTRIES;
     t->fActive = TRUE;
     t->tag = dwTblTag;
 }
@@ -397,7 +1322,7 @@ VOID VmmTlbPrefetch(_In_ POB_SET pTlbPrefetch)
             ppMEMs[i] = &ppObMEMs[i]->h;
             ppMEMs[i]->qwA = ObSet_Pop(pTlbPrefetch);
         }
-        LcReadScatter(ctxMain->hLC, cTlbs, ppMEMs);
+        VmmDeviceReadScatter(cTlbs, ppMEMs, 0);
         for(i = 0; i < cTlbs; i++) {
             if(ppMEMs[i]->f && !VmmTlbPageTableVerify(ppMEMs[i]->pb, ppMEMs[i]->qwA, FALSE)) {
                 ppMEMs[i]->f = FALSE;  // "fail" invalid page table read
@@ -410,10 +1335,65 @@ fail:
     LocalFree(ppObMEMs);
 }
 
+#define VMM_TLB_REVALIDATE_BATCH        0x400
+
+VOID VmmTlbRevalidate()
+{
+    PVMM_CACHE_TABLE t = &ctxVmm->Cache.TLB;
+    DWORD iR, i, iBase, c, cBatch, cObs = 0, cInvalid = 0;
+    PVMMOB_MEM pOb, *ppObs;
+    PPMEM_SCATTER ppMEMs = NULL;
+    if(!t->fActive) { return; }
+    if(!LcAllocScatter1(VMM_TLB_REVALIDATE_BATCH, &ppMEMs)) { return; }
+    for(iR = 0; iR < VMM_CACHE2_REGIONS; iR++) {
+        // 1: take a referenced snapshot of the region entries
+        ppObs = NULL;
+        EnterCriticalSection(&t->R[iR].Lock);
+        c = t->R[iR].c;
+        if(c && (ppObs = LocalAlloc(0, c * sizeof(PVMMOB_MEM)))) {
+            cObs = 0;
+            for(pOb = t->R[iR].AgeFLink; pOb && (cObs < c); pOb = pOb->AgeFLink) {
+                ppObs[cObs++] = Ob_INCREF(pOb);
+            }
+            for(pOb = t->R[iR].HotFLink; pOb && (cObs < c); pOb = pOb->AgeFLink) {
+                ppObs[cObs++] = Ob_INCREF(pOb);
+            }
+        }
+        LeaveCriticalSection(&t->R[iR].Lock);
+        if(!ppObs) { continue; }
+        // 2: re-read in batches - invalidate changed and unreadable entries
+        for(iBase = 0; iBase < cObs; iBase += cBatch) {
+            cBatch = min(VMM_TLB_REVALIDATE_BATCH, cObs - iBase);
+            for(i = 0; i < cBatch; i++) {
+                ppMEMs[i]->qwA = ppObs[iBase + i]->h.qwA;
+                ppMEMs[i]->f = FALSE;
+            }
+            VmmDeviceReadScatter(cBatch, ppMEMs, VMM_FLAG_PRIORITY_BULK);
+            for(i = 0; i < cBatch; i++) {
+                pOb = ppObs[iBase + i];
+                if(!ppMEMs[i]->f || memcmp(ppMEMs[i]->pb, pOb->pb, 0x1000)) {
+                    VmmCacheInvalidate(pOb->h.qwA);
+                    cInvalid++;
+                }
+                Ob_DECREF(pOb);
+            }
+        }
+        InterlockedAdd64(&ctxVmm->stat.cTlbRevalidate, cObs);
+        LocalFree(ppObs);
+    }
+    LcMemFree(ppMEMs);
+    if(cInvalid) {
+        // page tables changed -> allow re-spider of processes to pick up new tables.
+        InterlockedAdd64(&ctxVmm->stat.cTlbRevalidateInvalid, cInvalid);
+        VmmCacheTlbSpiderReset();
+    }
+}
+
 /*
 * Prefetch a set of addresses contained in pPrefetchPages into the cache. This
 * is useful when reading data from somewhat known addresses over higher latency
 * connections.
+* Pages are read in ascending address order for locality on the device.
 * NB! pPrefetchPages must not be updated/altered during the function call.
 * -- pProcess
 * -- pPrefetchPages
@@ -421,15 +1401,24 @@ fail:
 */
 VOID VmmCachePrefetchPages(_In_opt_ PVMM_PROCESS pProcess, _In_opt_ POB_SET pPrefetchPages, _In_ QWORD flags)
 {
-    QWORD qwA = 0;
-    DWORD cPages, iMEM = 0;
+    DWORD i, cPages, iMEM = 0;
+    POB_DATA pObData = NULL;
     PPMEM_SCATTER ppMEMs = NULL;
     cPages = ObSet_Size(pPrefetchPages);
     if(!cPages || (ctxVmm->flags & VMM_FLAG_NOCACHE)) { return; }
-    if(!LcAllocScatter1(cPages, &ppMEMs)) { return; }
-    while((qwA = ObSet_GetNext(pPrefetchPages, qwA))) {
-        ppMEMs[iMEM++]->qwA = qwA & ~0xfff;
+    if(!pProcess && ctxMain->filemap.pb) { return; }    // memory mapped - prefetch not required
+    if(!(pObData = ObSet_GetAllSorted(pPrefetchPages))) { return; }
+    cPages = pObData->ObHdr.cbData / sizeof(QWORD);
+    if(!cPages || !LcAllocScatter1(cPages, &ppMEMs)) {
+        Ob_DECREF(pObData);
+        return;
     }
+    for(i = 0; i < cPages; i++) {
+        // unaligned values of the same page are adjacent once sorted - skip dups.
+        if(iMEM && (ppMEMs[iMEM - 1]->qwA == (pObData->pqw[i] & ~0xfff))) { continue; }
+        ppMEMs[iMEM++]->qwA = pObData->pqw[i] & ~0xfff;
+    }
+    Ob_DECREF(pObData);
     if(pProcess) {
         VmmReadScatterVirtual(pProcess, ppMEMs, iMEM, flags);
     } else {
@@ -449,7 +1438,7 @@ VOID VmmCachePrefetchPages2(_In_opt_ PVMM_PROCESS pProcess, _In_ DWORD cAddresse
 {
     va_list arguments;
     POB_SET pObSet = NULL;
-    if(!cAddresses || !(pObSet = ObSet_New())) { return; }
+    if(!cAddresses || !(pObSet = ObSet_NewEx(OB_SET_FLAGS_NOLOCK))) { return; }
     va_start(arguments, cAddresses);
     while(cAddresses) {
         ObSet_Push(pObSet, va_arg(arguments, QWORD) & ~0xfff);
@@ -476,7 +1465,7 @@ VOID VmmCachePrefetchPages3(_In_opt_ PVMM_PROCESS pProcess, _In_opt_ POB_SET pPr
     POB_SET pObSetAlign;
     if(!cb || !pPrefetchPagesNonPageAligned) { return; }
     if(0 == ObSet_Size(pPrefetchPagesNonPageAligned)) { return; }
-    if(!(pObSetAlign = ObSet_New())) { return; }
+    if(!(pObSetAlign = ObSet_NewEx(OB_SET_FLAGS_NOLOCK))) { return; }
     while((qwA = ObSet_GetNext(pPrefetchPagesNonPageAligned, qwA))) {
         ObSet_Push_PageAlign(pObSetAlign, qwA, cb);
     }
@@ -496,7 +1485,7 @@ VOID VmmCachePrefetchPages3(_In_opt_ PVMM_PROCESS pProcess, _In_opt_ POB_SET pPr
 VOID VmmCachePrefetchPages4(_In_opt_ PVMM_PROCESS pProcess, _In_ DWORD cAddresses, _In_ PQWORD pqwAddresses, _In_ DWORD cb, _In_ QWORD flags)
 {
     POB_SET pObSet = NULL;
-    if(!cAddresses || !(pObSet = ObSet_New())) { return; }
+    if(!cAddresses || !(pObSet = ObSet_NewEx(OB_SET_FLAGS_NOLOCK))) { return; }
     while(cAddresses) {
         cAddresses--;
         if(pqwAddresses[cAddresses]) {
@@ -728,74 +1717,475 @@ BOOL VmmMap_GetHandle(_In_ PVMM_PROCESS pProcess, _Out_ PVMMOB_MAP_HANDLE *ppObH
     return TRUE;
 }
 
+typedef struct tdVMMMAP_ADDRESS_INTERVAL {
+    QWORD vaStart;                  // must be 1st member (sorted by Util_qsort_QWORD)
+    QWORD vaEnd;
+    PVOID pvEntry;
+} VMMMAP_ADDRESS_INTERVAL, *PVMMMAP_ADDRESS_INTERVAL;
+
+VOID VmmMap_GetAddress_CloseObCallback(_In_ PVOID pVmmOb)
+{
+    PVMMOB_MAP_ADDRESS pOb = (PVMMOB_MAP_ADDRESS)pVmmOb;
+    Ob_DECREF(pOb->pObPte);
+    Ob_DECREF(pOb->pObVad);
+    Ob_DECREF(pOb->pObModule);
+    Ob_DECREF(pOb->pObHeap);
+}
+
 /*
-* Retrieve the Physical Memory Map.
-* CALLER DECREF: ppObPhysMem
-* -- ppObPhysMem
+* Create a new address map by merging the intervals of the source maps into
+* non-overlapping segments. Segment boundaries are all interval start and end
+* addresses - each segment thus has exactly one entry (or none) per source.
+* CALLER DECREF: return
+* -- pObPte
+* -- pObVad
+* -- pObModule
+* -- pObHeap
 * -- return
 */
-_Success_(return)
-BOOL VmmMap_GetPhysMem(_Out_ PVMMOB_MAP_PHYSMEM *ppObPhysMem)
+PVMMOB_MAP_ADDRESS VmmMap_GetAddress_Create(_In_opt_ PVMMOB_MAP_PTE pObPte, _In_opt_ PVMMOB_MAP_VAD pObVad, _In_opt_ PVMMOB_MAP_MODULE pObModule, _In_opt_ PVMMOB_MAP_HEAP pObHeap)
 {
-    PVMMOB_MAP_PHYSMEM pObPhysMemMap = ObContainer_GetOb(ctxVmm->pObCMapPhysMem);
-    if(!pObPhysMemMap) {
-        pObPhysMemMap = VmmWinPhysMemMap_Initialize();
+    DWORD i, j, k, cBoundary = 0, cSegment = 0;
+    DWORD c[VMM_MAP_ADDRESS_SOURCES] = { 0 }, iCur[VMM_MAP_ADDRESS_SOURCES] = { 0 };
+    PVMMMAP_ADDRESS_INTERVAL pe[VMM_MAP_ADDRESS_SOURCES] = { 0 };
+    PVOID pvEntry[VMM_MAP_ADDRESS_SOURCES];
+    PQWORD pqwBoundary = NULL;
+    QWORD vaStart, vaEnd;
+    BOOL fCovered;
+    PVMM_MAP_ADDRESSENTRY peA;
+    PVMMOB_MAP_ADDRESS pObAddress = NULL;
+    // 1: collect intervals from source maps
+    c[0] = pObPte ? pObPte->cMap : 0;
+    c[1] = pObVad ? pObVad->cMap : 0;
+    c[2] = pObModule ? pObModule->cMap : 0;
+    c[3] = pObHeap ? pObHeap->cMap : 0;
+    for(i = 0; i < VMM_MAP_ADDRESS_SOURCES; i++) {
+        cBoundary += 2 * c[i];
+        if(c[i] && !(pe[i] = LocalAlloc(0, c[i] * sizeof(VMMMAP_ADDRESS_INTERVAL)))) { goto fail; }
     }
-    *ppObPhysMem = pObPhysMemMap;
-    return pObPhysMemMap != NULL;
+    for(i = 0; i < c[0]; i++) {
+        pe[0][i].vaStart = pObPte->pMap[i].vaBase;
+        pe[0][i].vaEnd = pObPte->pMap[i].vaBase + (pObPte->pMap[i].cPages << 12) - 1;
+        pe[0][i].pvEntry = pObPte->pMap + i;
+    }
+    for(i = 0; i < c[1]; i++) {
+        pe[1][i].vaStart = pObVad->pMap[i].vaStart;
+        pe[1][i].vaEnd = pObVad->pMap[i].vaEnd;
+        pe[1][i].pvEntry = pObVad->pMap + i;
+    }
+    for(i = 0; i < c[2]; i++) {
+        pe[2][i].vaStart = pObModule->pMap[i].vaBase;
+        pe[2][i].vaEnd = pObModule->pMap[i].vaBase + max(0x1000, pObModule->pMap[i].cbImageSize) - 1;
+        pe[2][i].pvEntry = pObModule->pMap + i;
+    }
+    for(i = 0; i < c[3]; i++) {
+        pe[3][i].vaStart = pObHeap->pMap[i].vaHeapSegment;
+        pe[3][i].vaEnd = pObHeap->pMap[i].vaHeapSegment + ((QWORD)max(1, pObHeap->pMap[i].cPages) << 12) - 1;
+        pe[3][i].pvEntry = pObHeap->pMap + i;
+    }
+    // 2: sort intervals and collect unique segment boundaries (start / end + 1)
+    if(!(pqwBoundary = LocalAlloc(0, (cBoundary + 1ULL) * sizeof(QWORD)))) { goto fail; }
+    for(i = 0, k = 0; i < VMM_MAP_ADDRESS_SOURCES; i++) {
+        qsort(pe[i], c[i], sizeof(VMMMAP_ADDRESS_INTERVAL), Util_qsort_QWORD);
+        for(j = 0; j < c[i]; j++) {
+            pqwBoundary[k++] = pe[i][j].vaStart;
+            if(pe[i][j].vaEnd != (QWORD)-1) {
+                pqwBoundary[k++] = pe[i][j].vaEnd + 1;
+            }
+        }
+    }
+    qsort(pqwBoundary, k, sizeof(QWORD), Util_qsort_QWORD);
+    for(i = 0, cBoundary = 0; i < k; i++) {
+        if(!cBoundary || (pqwBoundary[cBoundary - 1] != pqwBoundary[i])) {
+            pqwBoundary[cBoundary++] = pqwBoundary[i];
+        }
+    }
+    // 3: sweep segments and record covering entry of each source
+    pObAddress = Ob_Alloc(OB_TAG_MAP_ADDRESS, LMEM_ZEROINIT, sizeof(VMMOB_MAP_ADDRESS) + cBoundary * sizeof(VMM_MAP_ADDRESSENTRY), VmmMap_GetAddress_CloseObCallback, NULL);
+    if(!pObAddress) { goto fail; }
+    for(k = 0; k < cBoundary; k++) {
+        vaStart = pqwBoundary[k];
+        vaEnd = (k + 1 < cBoundary) ? (pqwBoundary[k + 1] - 1) : (QWORD)-1;
+        fCovered = FALSE;
+        for(i = 0; i < VMM_MAP_ADDRESS_SOURCES; i++) {
+            while((iCur[i] < c[i]) && (pe[i][iCur[i]].vaEnd < vaStart)) { iCur[i]++; }
+            pvEntry[i] = ((iCur[i] < c[i]) && (pe[i][iCur[i]].vaStart <= vaStart)) ? pe[i][iCur[i]].pvEntry : NULL;
+            fCovered = fCovered || pvEntry[i];
+        }
+        if(!fCovered) { continue; }
+        peA = pObAddress->pMap + cSegment++;
+        peA->vaStart = vaStart;
+        peA->vaEnd = vaEnd;
+        peA->pPte = (PVMM_MAP_PTEENTRY)pvEntry[0];
+        peA->pVad = (PVMM_MAP_VADENTRY)pvEntry[1];
+        peA->pModule = (PVMM_MAP_MODULEENTRY)pvEntry[2];
+        peA->pHeap = (PVMM_MAP_HEAPENTRY)pvEntry[3];
+    }
+    pObAddress->cMap = cSegment;
+    pObAddress->pObPte = Ob_INCREF(pObPte);
+    pObAddress->pObVad = Ob_INCREF(pObVad);
+    pObAddress->pObModule = Ob_INCREF(pObModule);
+    pObAddress->pObHeap = Ob_INCREF(pObHeap);
+fail:
+    for(i = 0; i < VMM_MAP_ADDRESS_SOURCES; i++) {
+        LocalFree(pe[i]);
+    }
+    LocalFree(pqwBoundary);
+    return pObAddress;
 }
 
 /*
-* Retrieve the USER map
-* CALLER DECREF: ppObUserMap
-* -- ppObUserMap
+* Retrieve the address map - a merged interval index of the PTE, VAD, module
+* and heap maps. The map is created on first use and re-created if any of the
+* source maps have changed (i.e. a previously unavailable map has become
+* available).
+* CALLER DECREF: ppObAddressMap
+* -- pProcess
+* -- ppObAddressMap
 * -- return
 */
 _Success_(return)
-BOOL VmmMap_GetUser(_Out_ PVMMOB_MAP_USER *ppObUserMap)
+BOOL VmmMap_GetAddress(_In_ PVMM_PROCESS pProcess, _Out_ PVMMOB_MAP_ADDRESS *ppObAddressMap)
 {
-    PVMMOB_MAP_USER pObUserMap = ObContainer_GetOb(ctxVmm->pObCMapUser);
-    if(!pObUserMap) {
-        pObUserMap = VmmWinUser_Initialize();
+    PVMMOB_MAP_PTE pObPte = NULL;
+    PVMMOB_MAP_VAD pObVad = NULL;
+    PVMMOB_MAP_MODULE pObModule = NULL;
+    PVMMOB_MAP_HEAP pObHeap = NULL;
+    PVMMOB_MAP_ADDRESS pObAddress = NULL;
+    VmmMap_GetPte(pProcess, &pObPte, FALSE);
+    VmmMap_GetVad(pProcess, &pObVad, FALSE);
+    VmmMap_GetModule(pProcess, &pObModule);
+    VmmMap_GetHeap(pProcess, &pObHeap);
+    EnterCriticalSection(&pProcess->LockUpdate);
+    pObAddress = ObContainer_GetOb(pProcess->Map.pObCAddress);
+    if(!pObAddress || (pObAddress->pObPte != pObPte) || (pObAddress->pObVad != pObVad) || (pObAddress->pObModule != pObModule) || (pObAddress->pObHeap != pObHeap)) {
+        Ob_DECREF_NULL(&pObAddress);
+        if((pObAddress = VmmMap_GetAddress_Create(pObPte, pObVad, pObModule, pObHeap))) {
+            ObContainer_SetOb(pProcess->Map.pObCAddress, pObAddress);
+        }
     }
-    *ppObUserMap = pObUserMap;
-    return pObUserMap != NULL;
+    LeaveCriticalSection(&pProcess->LockUpdate);
+    Ob_DECREF(pObPte);
+    Ob_DECREF(pObVad);
+    Ob_DECREF(pObModule);
+    Ob_DECREF(pObHeap);
+    *ppObAddressMap = pObAddress;
+    return pObAddress ? TRUE : FALSE;
 }
 
 /*
-* Retrieve the NETWORK CONNECTION map
-* CALLER DECREF: ppObNetMap
-* -- ppObNetMap
-* -- return
+* Retrieve the index of the first address map entry ending at or after va.
 */
-_Success_(return)
-BOOL VmmMap_GetNet(_Out_ PVMMOB_MAP_NET *ppObNetMap)
+DWORD VmmMap_GetAddressEntry_LowerBound(_In_ PVMMOB_MAP_ADDRESS pAddressMap, _In_ QWORD va)
 {
-    PVMMOB_MAP_NET pObNetMap = ObContainer_GetOb(ctxVmm->pObCMapNet);
-    if(!pObNetMap) {
-        pObNetMap = VmmWinNet_Initialize();
+    DWORD iLo = 0, iHi = pAddressMap->cMap, iMid;
+    while(iLo < iHi) {
+        iMid = (iLo + iHi) >> 1;
+        if(pAddressMap->pMap[iMid].vaEnd < va) {
+            iLo = iMid + 1;
+        } else {
+            iHi = iMid;
+        }
     }
-    *ppObNetMap = pObNetMap;
-    return pObNetMap != NULL;
+    return iLo;
 }
 
-// ----------------------------------------------------------------------------
-// PROCESS MANAGEMENT FUNCTIONALITY:
-//
-// The process 'object' represents a process in the analyzed system.
-//
-// The process 'object' is an object manager refcount object. The processes may
-// contain, in addition to values, sub-objects such as maps of loaded modules
-// and memory.
-//
-// Before updates to the process object happens the 'LockUpdate' generally
-// should be acquired.
-//
-// The active processes are contained in a 'process table' which is also an
-// object manager refcount object. Atmoic access (get and increase refcount) is
-// guarded by a object manager container which allows for easy retrieval of the
-// process table. The process table may also contain a process table for new
-// not yet committed process objects. When processes are refreshed in the back-
+/*
+* Retrieve a single PVMM_MAP_ADDRESSENTRY for a given AddressMap and address.
+* -- pAddressMap
+* -- va
+* -- return = PTR to ADDRESSENTRY or NULL on fail. Must not be used out of pAddressMap scope.
+*/
+PVMM_MAP_ADDRESSENTRY VmmMap_GetAddressEntry(_In_opt_ PVMMOB_MAP_ADDRESS pAddressMap, _In_ QWORD va)
+{
+    DWORD i;
+    if(!pAddressMap) { return NULL; }
+    i = VmmMap_GetAddressEntry_LowerBound(pAddressMap, va);
+    return ((i < pAddressMap->cMap) && (pAddressMap->pMap[i].vaStart <= va)) ? (pAddressMap->pMap + i) : NULL;
+}
+
+/*
+* Retrieve all PVMM_MAP_ADDRESSENTRY overlapping an address range.
+* -- pAddressMap
+* -- vaStart
+* -- vaEnd = inclusive end address.
+* -- pcEntries = number of consecutive entries overlapping the range.
+* -- return = PTR to first entry or NULL if no overlapping entry. Must not be used out of pAddressMap scope.
+*/
+PVMM_MAP_ADDRESSENTRY VmmMap_GetAddressEntryRange(_In_opt_ PVMMOB_MAP_ADDRESS pAddressMap, _In_ QWORD vaStart, _In_ QWORD vaEnd, _Out_ PDWORD pcEntries)
+{
+    DWORD i, iEnd;
+    *pcEntries = 0;
+    if(!pAddressMap || (vaStart > vaEnd)) { return NULL; }
+    i = VmmMap_GetAddressEntry_LowerBound(pAddressMap, vaStart);
+    for(iEnd = i; (iEnd < pAddressMap->cMap) && (pAddressMap->pMap[iEnd].vaStart <= vaEnd); iEnd++);
+    *pcEntries = iEnd - i;
+    return *pcEntries ? (pAddressMap->pMap + i) : NULL;
+}
+
+/*
+* Bulk lookup of many addresses - such as stack walk or pointer scan results.
+* Sorted (or partially sorted) input is resolved mostly without binary search
+* since the neighbourhood of the previous match is checked first.
+* -- pAddressMap
+* -- cva
+* -- pva
+* -- ppEntries = receives PTR to ADDRESSENTRY or NULL per address.
+* -- return = number of addresses with a matching entry.
+*/
+DWORD VmmMap_GetAddressEntries(_In_ PVMMOB_MAP_ADDRESS pAddressMap, _In_ DWORD cva, _In_reads_(cva) PQWORD pva, _Out_writes_(cva) PVMM_MAP_ADDRESSENTRY *ppEntries)
+{
+    QWORD va;
+    DWORD i, iEntry = 0, cFound = 0;
+    PVMM_MAP_ADDRESSENTRY pe = pAddressMap->pMap;
+    for(i = 0; i < cva; i++) {
+        va = pva[i];
+        ppEntries[i] = NULL;
+        if(!pAddressMap->cMap) { continue; }
+        if((va < pe[iEntry].vaStart) || (va > pe[iEntry].vaEnd)) {
+            if((iEntry + 1 < pAddressMap->cMap) && (va > pe[iEntry].vaEnd) && (va <= pe[iEntry + 1].vaEnd)) {
+                iEntry++;
+            } else {
+                iEntry = VmmMap_GetAddressEntry_LowerBound(pAddressMap, va);
+                if(iEntry >= pAddressMap->cMap) { iEntry = pAddressMap->cMap - 1; continue; }
+            }
+            if(va < pe[iEntry].vaStart) { continue; }
+        }
+        ppEntries[i] = pe + iEntry;
+        cFound++;
+    }
+    return cFound;
+}
+
+/*
+* Retrieve the Physical Memory Map.
+* CALLER DECREF: ppObPhysMem
+* -- ppObPhysMem
+* -- return
+*/
+_Success_(return)
+BOOL VmmMap_GetPhysMem(_Out_ PVMMOB_MAP_PHYSMEM *ppObPhysMem)
+{
+    PVMMOB_SNAPSHOT pObSnapshot = VmmSnapshotGetActive();
+    PVMMOB_MAP_PHYSMEM pObPhysMemMap = pObSnapshot ? VmmSnapshot_MapPin(pObSnapshot, VMM_SNAPSHOT_MAP_PHYSMEM, NULL) : NULL;
+    if(!pObPhysMemMap && !(pObPhysMemMap = ObContainer_GetOb(ctxVmm->pObCMapPhysMem))) {
+        pObPhysMemMap = VmmWinPhysMemMap_Initialize();
+    }
+    if(pObSnapshot) {
+        pObPhysMemMap = VmmSnapshot_MapPin(pObSnapshot, VMM_SNAPSHOT_MAP_PHYSMEM, pObPhysMemMap);
+        Ob_DECREF(pObSnapshot);
+    }
+    *ppObPhysMem = pObPhysMemMap;
+    return pObPhysMemMap != NULL;
+}
+
+/*
+* Retrieve the USER map
+* CALLER DECREF: ppObUserMap
+* -- ppObUserMap
+* -- return
+*/
+_Success_(return)
+BOOL VmmMap_GetUser(_Out_ PVMMOB_MAP_USER *ppObUserMap)
+{
+    PVMMOB_SNAPSHOT pObSnapshot = VmmSnapshotGetActive();
+    PVMMOB_MAP_USER pObUserMap = pObSnapshot ? VmmSnapshot_MapPin(pObSnapshot, VMM_SNAPSHOT_MAP_USER, NULL) : NULL;
+    if(!pObUserMap && !(pObUserMap = ObContainer_GetOb(ctxVmm->pObCMapUser))) {
+        pObUserMap = VmmWinUser_Initialize();
+    }
+    if(pObSnapshot) {
+        pObUserMap = VmmSnapshot_MapPin(pObSnapshot, VMM_SNAPSHOT_MAP_USER, pObUserMap);
+        Ob_DECREF(pObSnapshot);
+    }
+    *ppObUserMap = pObUserMap;
+    return pObUserMap != NULL;
+}
+
+/*
+* Retrieve the NETWORK CONNECTION map
+* CALLER DECREF: ppObNetMap
+* -- ppObNetMap
+* -- return
+*/
+_Success_(return)
+BOOL VmmMap_GetNet(_Out_ PVMMOB_MAP_NET *ppObNetMap)
+{
+    PVMMOB_SNAPSHOT pObSnapshot = VmmSnapshotGetActive();
+    PVMMOB_MAP_NET pObNetMap = pObSnapshot ? VmmSnapshot_MapPin(pObSnapshot, VMM_SNAPSHOT_MAP_NET, NULL) : NULL;
+    if(!pObNetMap && !(pObNetMap = ObContainer_GetOb(ctxVmm->pObCMapNet))) {
+        pObNetMap = VmmWinNet_Initialize();
+    }
+    if(pObSnapshot) {
+        pObNetMap = VmmSnapshot_MapPin(pObSnapshot, VMM_SNAPSHOT_MAP_NET, pObNetMap);
+        Ob_DECREF(pObSnapshot);
+    }
+    *ppObNetMap = pObNetMap;
+    return pObNetMap != NULL;
+}
+
+int VmmMap_GetProcTree_CmpSort(PVMM_MAP_PROCTREEENTRY a, PVMM_MAP_PROCTREEENTRY b)
+{
+    return (a->dwPID < b->dwPID) ? -1 : ((a->dwPID > b->dwPID) ? 1 : 0);
+}
+
+int VmmMap_GetProcTreeEntry_CmpFind(_In_ QWORD qwPID, _In_ PVMM_MAP_PROCTREEENTRY pEntry)
+{
+    if(pEntry->dwPID > (DWORD)qwPID) { return -1; }
+    if(pEntry->dwPID < (DWORD)qwPID) { return 1; }
+    return 0;
+}
+
+/*
+* Retrieve a single PVMM_MAP_PROCTREEENTRY for a given PID.
+* -- pProcTreeMap
+* -- dwPID
+* -- return = PTR to PROCTREEENTRY or NULL on fail. Must not be used out of pProcTreeMap scope.
+*/
+PVMM_MAP_PROCTREEENTRY VmmMap_GetProcTreeEntry(_In_opt_ PVMMOB_MAP_PROCTREE pProcTreeMap, _In_ DWORD dwPID)
+{
+    if(!pProcTreeMap) { return NULL; }
+    return Util_qfind((PVOID)(QWORD)dwPID, pProcTreeMap->cMap, pProcTreeMap->pMap, sizeof(VMM_MAP_PROCTREEENTRY), (int(*)(PVOID, PVOID))VmmMap_GetProcTreeEntry_CmpFind);
+}
+
+/*
+* Build the process tree map of a process table. The parent/child index is
+* built in O(n log n). The depth-first tree order starts with processes with
+* no parent in the table followed by any remaining processes (in case of a
+* PPID-loop which ideally should not happen) - both in PID order.
+* CALLER DECREF: return
+* -- pt
+* -- return
+*/
+PVMMOB_MAP_PROCTREE VmmMap_GetProcTree_Build(_In_ PVMMOB_PROCESS_TABLE pt)
+{
+    BOOL fPass;
+    DWORD i, j, c, o, cTree = 0, cStack;
+    PDWORD piStack = NULL;
+    PBYTE pfVisit = NULL;
+    PVMM_MAP_PROCTREEENTRY pe, peParent;
+    PVMMOB_MAP_PROCTREE pObTree = NULL;
+    c = (DWORD)pt->c;
+    if(!(pfVisit = LocalAlloc(LMEM_ZEROINIT, c + 2ULL * c * sizeof(DWORD)))) { goto fail; }
+    piStack = (PDWORD)(pfVisit + c);
+    if(!(pObTree = Ob_Alloc(OB_TAG_MAP_PROCTREE, LMEM_ZEROINIT, sizeof(VMMOB_MAP_PROCTREE) + c * (sizeof(VMM_MAP_PROCTREEENTRY) + 2ULL * sizeof(DWORD)), NULL, NULL))) { goto fail; }
+    pObTree->cMap = c;
+    pObTree->piChild = (PDWORD)(pObTree->pMap + c);
+    pObTree->piTree = pObTree->piChild + c;
+    // 1: fill and sort entries
+    for(i = 0; i < c; i++) {
+        pObTree->pMap[i].dwPID = pt->_M[i]->dwPID;
+        pObTree->pMap[i].dwPPID = pt->_M[i]->dwPPID;
+    }
+    qsort(pObTree->pMap, c, sizeof(VMM_MAP_PROCTREEENTRY), (int(*)(const void*, const void*))VmmMap_GetProcTree_CmpSort);
+    // 2: resolve parents and count children
+    for(i = 0; i < c; i++) {
+        pe = pObTree->pMap + i;
+        peParent = (pe->dwPPID != pe->dwPID) ? VmmMap_GetProcTreeEntry(pObTree, pe->dwPPID) : NULL;
+        pe->iParent = peParent ? (DWORD)(peParent - pObTree->pMap) : (DWORD)-1;
+        if(peParent) { peParent->cChild++; }
+    }
+    // 3: assign child index ranges and fill children (in PID order)
+    for(i = 0, o = 0; i < c; i++) {
+        pObTree->pMap[i].iChild = o;
+        o += pObTree->pMap[i].cChild;
+        pObTree->pMap[i].cChild = 0;
+    }
+    for(i = 0; i < c; i++) {
+        if((j = pObTree->pMap[i].iParent) != (DWORD)-1) {
+            peParent = pObTree->pMap + j;
+            pObTree->piChild[peParent->iChild + peParent->cChild++] = i;
+        }
+    }
+    // 4: depth-first tree order - top level processes first, remaining last.
+    for(fPass = FALSE; cTree < c; fPass = TRUE) {
+        for(i = 0; i < c; i++) {
+            if(pfVisit[i] || (!fPass && (pObTree->pMap[i].iParent != (DWORD)-1))) { continue; }
+            pObTree->pMap[i].iLevel = 0;
+            piStack[0] = i;
+            cStack = 1;
+            while(cStack) {
+                pe = pObTree->pMap + piStack[--cStack];
+                if(pfVisit[pe - pObTree->pMap]) { continue; }
+                pfVisit[pe - pObTree->pMap] = TRUE;
+                pObTree->piTree[cTree++] = (DWORD)(pe - pObTree->pMap);
+                for(j = pe->cChild; j; j--) {
+                    o = pObTree->piChild[pe->iChild + j - 1];
+                    if(pfVisit[o]) { continue; }
+                    pObTree->pMap[o].iLevel = pe->iLevel + 1;
+                    piStack[cStack++] = o;
+                }
+            }
+        }
+    }
+    LocalFree(pfVisit);
+    return pObTree;
+fail:
+    LocalFree(pfVisit);
+    Ob_DECREF(pObTree);
+    return NULL;
+}
+
+/*
+* Retrieve the PROCESS TREE map (parent/child index of all processes including
+* terminated processes). The map is built once per process table.
+* CALLER DECREF: ppObProcTreeMap
+* -- ppObProcTreeMap
+* -- return
+*/
+_Success_(return)
+BOOL VmmMap_GetProcTree(_Out_ PVMMOB_MAP_PROCTREE *ppObProcTreeMap)
+{
+    PVMMOB_SNAPSHOT pObSnapshot;
+    PVMMOB_PROCESS_TABLE pObTable, pObTableCurrent;
+    PVMMOB_MAP_PROCTREE pObTree;
+    // active snapshot -> tree of the pinned process table
+    if((pObSnapshot = VmmSnapshotGetActive())) {
+        if(!(pObTree = VmmSnapshot_MapPin(pObSnapshot, VMM_SNAPSHOT_MAP_PROCTREE, NULL))) {
+            pObTree = VmmSnapshot_MapPin(pObSnapshot, VMM_SNAPSHOT_MAP_PROCTREE, VmmMap_GetProcTree_Build(pObSnapshot->pObProcessTable));
+        }
+        Ob_DECREF(pObSnapshot);
+        *ppObProcTreeMap = pObTree;
+        return pObTree != NULL;
+    }
+    pObTree = ObContainer_GetOb(ctxVmm->pObCMapProcTree);
+    if(!pObTree) {
+        EnterCriticalSection(&ctxVmm->LockUpdateMap);
+        if(!(pObTree = ObContainer_GetOb(ctxVmm->pObCMapProcTree)) && (pObTable = ObContainer_GetOb(ctxVmm->pObCPROC))) {
+            if((pObTree = VmmMap_GetProcTree_Build(pObTable))) {
+                // the process table may have been replaced meanwhile - if so
+                // the map is returned to the caller but not cached.
+                ObContainer_SetOb(ctxVmm->pObCMapProcTree, pObTree);
+                pObTableCurrent = ObContainer_GetOb(ctxVmm->pObCPROC);
+                if(pObTableCurrent != pObTable) {
+                    ObContainer_SetOb(ctxVmm->pObCMapProcTree, NULL);
+                }
+                Ob_DECREF(pObTableCurrent);
+            }
+            Ob_DECREF(pObTable);
+        }
+        LeaveCriticalSection(&ctxVmm->LockUpdateMap);
+    }
+    *ppObProcTreeMap = pObTree;
+    return pObTree != NULL;
+}
+
+// ----------------------------------------------------------------------------
+// PROCESS MANAGEMENT FUNCTIONALITY:
+//
+// The process 'object' represents a process in the analyzed system.
+//
+// The process 'object' is an object manager refcount object. The processes may
+// contain, in addition to values, sub-objects such as maps of loaded modules
+// and memory.
+//
+// Before updates to the process object happens the 'LockUpdate' generally
+// should be acquired.
+//
+// The active processes are contained in a 'process table' which is also an
+// object manager refcount object. Atmoic access (get and increase refcount) is
+// guarded by a object manager container which allows for easy retrieval of the
+// process table. The process table may also contain a process table for new
+// not yet committed process objects. When processes are refreshed in the back-
 // ground they are created (or copied by refcount increase) into the new table.
 // Once all processes are enumerated the function 'VmmProcessCreateFinish' is
 // called and replaces the 'old' table with the 'new' table which becomes the
@@ -809,7 +2199,7 @@ BOOL VmmMap_GetNet(_Out_ PVMMOB_MAP_NET *ppObNetMap)
 VOID VmmProcess_TokenTryEnsure(_In_ PVMMOB_PROCESS_TABLE pt)
 {
     BOOL f, f32 = ctxVmm->f32;
-    DWORD j, i = 0, iM, cbHdr, cb;
+    DWORD j, i, cbHdr, cb;
     QWORD va, *pva = NULL;
     BYTE pb[0x1000];
     PVMM_PROCESS *ppProcess = NULL, pObSystemProcess = NULL;
@@ -822,17 +2212,14 @@ VOID VmmProcess_TokenTryEnsure(_In_ PVMMOB_PROCESS_TABLE pt)
     cbHdr = f32 ? 0x2c : 0x5c;
     cb = cbHdr + oep->opt.TOKEN_UserAndGroups + 8;
     // 1: Get Process and Token VA:
-    iM = pt->_iFLink;
-    while(iM && i < pt->c) {
-        if((ppProcess[i] = pt->_M[iM]) && !ppProcess[i]->win.TOKEN.fInitialized) {
+    for(i = 0; i < pt->c; i++) {
+        if((ppProcess[i] = pt->_M[i]) && !ppProcess[i]->win.TOKEN.fInitialized) {
             va = VMM_PTR_OFFSET(f32, ppProcess[i]->win.EPROCESS.pb, oep->opt.Token) & (f32 ? ~0x7 : ~0xf);
             if(VMM_KADDR(va)) {
                 ppProcess[i]->win.TOKEN.va = va;
                 pva[i] = va - cbHdr; // adjust for _OBJECT_HEADER and Pool Header
             }
         }
-        iM = pt->_iFLinkM[iM];
-        i++;
     }
     // 2: Read Token:
     VmmCachePrefetchPages4(pObSystemProcess, (DWORD)pt->c, pva, cb, 0);
@@ -898,6 +2285,87 @@ VOID VmmProcess_TokenTryEnsureLock(_In_ PVMMOB_PROCESS_TABLE pt, _In_ PVMM_PROCE
     LeaveCriticalSection(&ctxVmm->LockMaster);
 }
 
+// PIDs are multiples of four - shift before multiplicative hashing.
+#define VMM_PROCESSTABLE_HASH(dwPID)        (((dwPID) >> 2) * 0x9E3779B1)
+
+/*
+* Retrieve the index into pt->_M of the process with the given PID.
+* The table is immutable once published - lookups are lock-free.
+* -- pt
+* -- dwPID
+* -- return = index into pt->_M or (DWORD)-1 if not found.
+*/
+DWORD VmmProcessTable_FindIndex(_In_ PVMMOB_PROCESS_TABLE pt, _In_ DWORD dwPID)
+{
+    DWORD iHash, iM;
+    if(!pt->cHash) { return (DWORD)-1; }
+    iHash = VMM_PROCESSTABLE_HASH(dwPID) & (pt->cHash - 1);
+    while((iM = pt->_piHash[iHash])) {
+        if(pt->_M[iM - 1]->dwPID == dwPID) { return iM - 1; }
+        iHash = (iHash + 1) & (pt->cHash - 1);
+    }
+    return (DWORD)-1;
+}
+
+/*
+* Insert a process into a (not yet published) process table. The dense process
+* array and the PID hash are grown as required - there is no upper limit on
+* the number of processes.
+* -- pt
+* -- pProcess = process to insert, the table takes over the caller reference.
+* -- return
+*/
+_Success_(return)
+BOOL VmmProcessTable_Insert(_In_ PVMMOB_PROCESS_TABLE pt, _In_ PVMM_PROCESS pProcess)
+{
+    DWORD i, iHash, cHashNew;
+    PDWORD piHashNew;
+    PVMM_PROCESS *pMNew;
+    if(pt->c == pt->cMax) {
+        if(!(pMNew = LocalAlloc(0, max(VMM_PROCESSTABLE_ENTRIES_MIN, 2 * pt->cMax) * sizeof(PVMM_PROCESS)))) { return FALSE; }
+        if(pt->c) { memcpy(pMNew, pt->_M, pt->c * sizeof(PVMM_PROCESS)); }
+        LocalFree(pt->_M);
+        pt->_M = pMNew;
+        pt->cMax = max(VMM_PROCESSTABLE_ENTRIES_MIN, 2 * pt->cMax);
+    }
+    if(2 * (pt->c + 1) > pt->cHash) {
+        cHashNew = max(2 * VMM_PROCESSTABLE_ENTRIES_MIN, 2 * pt->cHash);
+        if(!(piHashNew = LocalAlloc(LMEM_ZEROINIT, cHashNew * sizeof(DWORD)))) { return FALSE; }
+        for(i = 0; i < pt->c; i++) {
+            iHash = VMM_PROCESSTABLE_HASH(pt->_M[i]->dwPID) & (cHashNew - 1);
+            while(piHashNew[iHash]) { iHash = (iHash + 1) & (cHashNew - 1); }
+            piHashNew[iHash] = i + 1;
+        }
+        LocalFree(pt->_piHash);
+        pt->_piHash = piHashNew;
+        pt->cHash = cHashNew;
+    }
+    iHash = VMM_PROCESSTABLE_HASH(pProcess->dwPID) & (pt->cHash - 1);
+    while(pt->_piHash[iHash]) { iHash = (iHash + 1) & (pt->cHash - 1); }
+    pt->_M[pt->c] = pProcess;
+    pt->_piHash[iHash] = (DWORD)++pt->c;
+    pt->cActive += (pProcess->dwState == 0) ? 1 : 0;
+    return TRUE;
+}
+
+/*
+* Retrieve the process table lookups without an explicit table are made
+* against - the table pinned by the active snapshot (if any) or the current.
+* CALLER DECREF: return
+* -- return
+*/
+PVMMOB_PROCESS_TABLE VmmProcessTable_Get()
+{
+    PVMMOB_SNAPSHOT pObSnapshot;
+    PVMMOB_PROCESS_TABLE pObTable;
+    if((pObSnapshot = VmmSnapshotGetActive())) {
+        pObTable = Ob_INCREF(pObSnapshot->pObProcessTable);
+        Ob_DECREF(pObSnapshot);
+        return pObTable;
+    }
+    return (PVMMOB_PROCESS_TABLE)ObContainer_GetOb(ctxVmm->pObCPROC);
+}
+
 /*
 * Retrieve a process for a given PID and optional PVMMOB_PROCESS_TABLE.
 * CALLER DECREF: return
@@ -911,25 +2379,18 @@ PVMM_PROCESS VmmProcessGetEx(_In_opt_ PVMMOB_PROCESS_TABLE pt, _In_ DWORD dwPID,
     BOOL fToken = ((flags | ctxVmm->flags) & VMM_FLAG_PROCESS_TOKEN);
     PVMM_PROCESS pObProcess, pObProcessClone;
     PVMMOB_PROCESS_TABLE pObTable;
-    DWORD i, iStart;
+    DWORD i;
     if(!pt) {
-        pObTable = (PVMMOB_PROCESS_TABLE)ObContainer_GetOb(ctxVmm->pObCPROC);
-        pObProcess = VmmProcessGetEx(pObTable, dwPID, flags);
+        pObTable = VmmProcessTable_Get();
+        pObProcess = pObTable ? VmmProcessGetEx(pObTable, dwPID, flags) : NULL;
         Ob_DECREF(pObTable);
         return pObProcess;
     }
-    i = iStart = dwPID % VMM_PROCESSTABLE_ENTRIES_MAX;
-    while(TRUE) {
-        if(!pt->_M[i]) { goto fail; }
-        if(pt->_M[i]->dwPID == dwPID) {
-            pObProcess = (PVMM_PROCESS)Ob_INCREF(pt->_M[i]);
-            if(pObProcess && fToken && !pObProcess->win.TOKEN.fInitialized) { VmmProcess_TokenTryEnsureLock(pt, pObProcess); }
-            return pObProcess;
-        }
-        if(++i == VMM_PROCESSTABLE_ENTRIES_MAX) { i = 0; }
-        if(i == iStart) { goto fail; }
+    if((i = VmmProcessTable_FindIndex(pt, dwPID)) != (DWORD)-1) {
+        pObProcess = (PVMM_PROCESS)Ob_INCREF(pt->_M[i]);
+        if(pObProcess && fToken && !pObProcess->win.TOKEN.fInitialized) { VmmProcess_TokenTryEnsureLock(pt, pObProcess); }
+        return pObProcess;
     }
-fail:
     if(dwPID & VMM_PID_PROCESS_CLONE_WITH_KERNELMEMORY) {
         if((pObProcess = VmmProcessGetEx(pt, dwPID & ~VMM_PID_PROCESS_CLONE_WITH_KERNELMEMORY, flags))) {
             if((pObProcessClone = VmmProcessClone(pObProcess))) {
@@ -960,41 +2421,27 @@ PVMM_PROCESS VmmProcessGetNextEx(_In_opt_ PVMMOB_PROCESS_TABLE pt, _In_opt_ PVMM
     BOOL fToken = ((flags | ctxVmm->flags) & VMM_FLAG_PROCESS_TOKEN);
     BOOL fShowTerminated = ((flags | ctxVmm->flags) & VMM_FLAG_PROCESS_SHOW_TERMINATED);
     PVMM_PROCESS pProcessNew;
-    DWORD i, iStart;
+    DWORD i;
     if(!pt) {
-        pt = (PVMMOB_PROCESS_TABLE)ObContainer_GetOb(ctxVmm->pObCPROC);
+        pt = VmmProcessTable_Get();
         if(!pt) { goto fail; }
         pProcessNew = VmmProcessGetNextEx(pt, pProcess, flags);
         Ob_DECREF(pt);
         return pProcessNew;
     }
-restart:
+    // processes are iterated from most recently inserted to first inserted.
     if(!pProcess) {
-        i = pt->_iFLink;
-        if(!pt->_M[i]) { goto fail; }
+        i = (DWORD)pt->c;
+    } else {
+        i = VmmProcessTable_FindIndex(pt, pProcess->dwPID);
+        if(i == (DWORD)-1) { goto fail; }
+    }
+    while(i--) {
+        if(pt->_M[i]->dwState && !fShowTerminated) { continue; }
         pProcessNew = (PVMM_PROCESS)Ob_INCREF(pt->_M[i]);
         Ob_DECREF(pProcess);
-        pProcess = pProcessNew;
-        if(pProcess && pProcess->dwState && !fShowTerminated) { goto restart; }
-        if(pProcess && fToken && !pProcess->win.TOKEN.fInitialized) { VmmProcess_TokenTryEnsureLock(pt, pProcess); }
-        return pProcess;
-    }
-    i = iStart = pProcess->dwPID % VMM_PROCESSTABLE_ENTRIES_MAX;
-    while(TRUE) {
-        if(!pt->_M[i]) { goto fail; }
-        if(pt->_M[i]->dwPID == pProcess->dwPID) {
-            // current process -> retrieve next!
-            i = pt->_iFLinkM[i];
-            if(!pt->_M[i]) { goto fail; }
-            pProcessNew = (PVMM_PROCESS)Ob_INCREF(pt->_M[i]);
-            Ob_DECREF(pProcess);
-            pProcess = pProcessNew;
-            if(pProcess && pProcess->dwState && !fShowTerminated) { goto restart; }
-            if(pProcess && fToken && !pProcess->win.TOKEN.fInitialized) { VmmProcess_TokenTryEnsureLock(pt, pProcess); }
-            return pProcess;
-        }
-        if(++i == VMM_PROCESSTABLE_ENTRIES_MAX) { i = 0; }
-        if(i == iStart) { goto fail; }
+        if(fToken && !pProcessNew->win.TOKEN.fInitialized) { VmmProcess_TokenTryEnsureLock(pt, pProcessNew); }
+        return pProcessNew;
     }
 fail:
     Ob_DECREF(pProcess);
@@ -1012,7 +2459,13 @@ VOID VmmProcessStatic_CloseObCallback(_In_ PVOID pVmmOb)
     Ob_DECREF_NULL(&pProcessStatic->pObCLdrModulesPrefetch32);
     Ob_DECREF_NULL(&pProcessStatic->pObCLdrModulesPrefetch64);
     Ob_DECREF_NULL(&pProcessStatic->pObCMapThreadPrefetch);
+    Ob_DECREF_NULL(&pProcessStatic->pObCMapPteIncremental);
+    Ob_DECREF_NULL(&pProcessStatic->pObCMapVadIncremental);
     Ob_DECREF_NULL(&pProcessStatic->Plugin.pObCMiniDump);
+    if(pProcessStatic->pObCPageDigest && pProcessStatic->pObCPageDigest->pOb) {
+        InterlockedDecrement(&ctxVmm->PageDigest.cEnabled);
+    }
+    Ob_DECREF_NULL(&pProcessStatic->pObCPageDigest);
     LocalFree(pProcessStatic->uszPathKernel);
     LocalFree(pProcessStatic->wszPathKernel);
     LocalFree(pProcessStatic->UserProcessParams.uszCommandLine);
@@ -1035,7 +2488,10 @@ VOID VmmProcessStatic_Initialize(_In_ PVMM_PROCESS pProcess)
         pProcess->pObPersistent->pObCLdrModulesPrefetch32 = ObContainer_New(NULL);
         pProcess->pObPersistent->pObCLdrModulesPrefetch64 = ObContainer_New(NULL);
         pProcess->pObPersistent->pObCMapThreadPrefetch = ObContainer_New(NULL);
+        pProcess->pObPersistent->pObCMapPteIncremental = ObContainer_New(NULL);
+        pProcess->pObPersistent->pObCMapVadIncremental = ObContainer_New(NULL);
         pProcess->pObPersistent->Plugin.pObCMiniDump = ObContainer_New(NULL);
+        pProcess->pObPersistent->pObCPageDigest = ObContainer_New(NULL);
     }
     LeaveCriticalSection(&pProcess->LockUpdate);
 }
@@ -1054,6 +2510,7 @@ VOID VmmProcess_CloseObCallback(_In_ PVOID pVmmOb)
     Ob_DECREF(pProcess->Map.pObHeap);
     Ob_DECREF(pProcess->Map.pObThread);
     Ob_DECREF(pProcess->Map.pObHandle);
+    Ob_DECREF(pProcess->Map.pObCAddress);
     Ob_DECREF(pProcess->pObPersistent);
     LocalFree(pProcess->win.TOKEN.szSID);
     // plugin cleanup below
@@ -1086,19 +2543,15 @@ VOID VmmProcessClone_CloseObCallback(_In_ PVOID pVmmOb)
 VOID VmmProcessTable_CloseObCallback(_In_ PVOID pVmmOb)
 {
     PVMMOB_PROCESS_TABLE pt = (PVMMOB_PROCESS_TABLE)pVmmOb;
-    PVMM_PROCESS pProcess;
-    WORD iProcess;
+    SIZE_T i;
     // Close NewPROC
     Ob_DECREF_NULL(&pt->pObCNewPROC);
     // DECREF all pProcess in table
-    iProcess = pt->_iFLink;
-    pProcess = pt->_M[iProcess];
-    while(pProcess) {
-        Ob_DECREF(pProcess);
-        iProcess = pt->_iFLinkM[iProcess];
-        pProcess = pt->_M[iProcess];
-        if(!pProcess || iProcess == pt->_iFLink) { break; }
+    for(i = 0; i < pt->c; i++) {
+        Ob_DECREF(pt->_M[i]);
     }
+    LocalFree(pt->_M);
+    LocalFree(pt->_piHash);
 }
 
 /*
@@ -1119,6 +2572,7 @@ PVMM_PROCESS VmmProcessClone(_In_ PVMM_PROCESS pProcess)
     if(!pObProcessClone) { return NULL; }
     memcpy((PBYTE)pObProcessClone + sizeof(OB), (PBYTE)pProcess + sizeof(OB), pProcess->ObHdr.cbData);
     pObProcessClone->pObProcessCloneParent = Ob_INCREF(pProcess);
+    ZeroMemory(pObProcessClone->SoftTlb, sizeof(pObProcessClone->SoftTlb));
     InitializeCriticalSection(&pObProcessClone->LockUpdate);
     InitializeCriticalSection(&pObProcessClone->LockPlugin);
     InitializeCriticalSection(&pObProcessClone->Map.LockUpdateThreadMap);
@@ -1147,7 +2601,6 @@ PVMM_PROCESS VmmProcessClone(_In_ PVMM_PROCESS pProcess)
 PVMM_PROCESS VmmProcessCreateEntry(_In_ BOOL fTotalRefresh, _In_ DWORD dwPID, _In_ DWORD dwPPID, _In_ DWORD dwState, _In_ QWORD paDTB, _In_ QWORD paDTB_UserOpt, _In_ CHAR szName[16], _In_ BOOL fUserOnly, _In_reads_opt_(cbEPROCESS) PBYTE pbEPROCESS, _In_ DWORD cbEPROCESS)
 {
     PVMMOB_PROCESS_TABLE ptOld = NULL, ptNew = NULL;
-    QWORD i, iStart, cEmpty = 0, cValid = 0;
     PVMM_PROCESS pProcess = NULL, pProcessOld = NULL;
     PVMMOB_MEM pObDTB = NULL;
     BOOL result;
@@ -1195,6 +2648,7 @@ PVMM_PROCESS VmmProcessCreateEntry(_In_ BOOL fTotalRefresh, _In_ DWORD dwPID, _I
         pProcess->Plugin.pObCLdrModulesDisplayCache = ObContainer_New(NULL);
         pProcess->Plugin.pObCPeDumpDirCache = ObContainer_New(NULL);
         pProcess->Plugin.pObCPhys2Virt = ObContainer_New(NULL);
+        pProcess->Map.pObCAddress = ObContainer_New(NULL);
         if(pbEPROCESS && cbEPROCESS) {
             pProcess->win.EPROCESS.cb = min(sizeof(pProcess->win.EPROCESS.pb), cbEPROCESS);
             memcpy(pProcess->win.EPROCESS.pb, pbEPROCESS, pProcess->win.EPROCESS.cb);
@@ -1210,21 +2664,11 @@ PVMM_PROCESS VmmProcessCreateEntry(_In_ BOOL fTotalRefresh, _In_ DWORD dwPID, _I
         pProcessOld = NULL;
     }
     // 5: Install new PID
-    i = iStart = dwPID % VMM_PROCESSTABLE_ENTRIES_MAX;
-    while(TRUE) {
-        if(!ptNew->_M[i]) {
-            ptNew->_M[i] = pProcess;
-            ptNew->_iFLinkM[i] = ptNew->_iFLink;
-            ptNew->_iFLink = (WORD)i;
-            ptNew->c++;
-            ptNew->cActive += (pProcess->dwState == 0) ? 1 : 0;
-            Ob_DECREF(ptOld);
-            Ob_DECREF(ptNew);
-            // pProcess already "consumed" by table insertion so increase before returning ... 
-            return (PVMM_PROCESS)Ob_INCREF(pProcess);
-        }
-        if(++i == VMM_PROCESSTABLE_ENTRIES_MAX) { i = 0; }
-        if(i == iStart) { goto fail; }
+    if(VmmProcessTable_Insert(ptNew, pProcess)) {
+        Ob_DECREF(ptOld);
+        Ob_DECREF(ptNew);
+        // pProcess already "consumed" by table insertion so increase before returning ... 
+        return (PVMM_PROCESS)Ob_INCREF(pProcess);
     }
 fail:
     Ob_DECREF(pProcess);
@@ -1249,6 +2693,7 @@ VOID VmmProcessCreateFinish()
     }
     // Replace "existing" old process table with new.
     ObContainer_SetOb(ctxVmm->pObCPROC, ptNew);
+    ObContainer_SetOb(ctxVmm->pObCMapProcTree, NULL);
     Ob_DECREF(ptNew);
     Ob_DECREF(ptOld);
 }
@@ -1259,16 +2704,10 @@ VOID VmmProcessCreateFinish()
 VOID VmmProcessTlbClear()
 {
     PVMMOB_PROCESS_TABLE pt = (PVMMOB_PROCESS_TABLE)ObContainer_GetOb(ctxVmm->pObCPROC);
-    PVMM_PROCESS pProcess;
-    WORD iProcess;
+    SIZE_T i;
     if(!pt) { return; }
-    iProcess = pt->_iFLink;
-    pProcess = pt->_M[iProcess];
-    while(pProcess) {
-        pProcess->fTlbSpiderDone = FALSE;
-        iProcess = pt->_iFLinkM[iProcess];
-        pProcess = pt->_M[iProcess];
-        if(!pProcess || iProcess == pt->_iFLink) { break; }
+    for(i = 0; i < pt->c; i++) {
+        pt->_M[i]->fTlbSpiderDone = FALSE;
     }
     Ob_DECREF(pt);
 }
@@ -1281,10 +2720,10 @@ VOID VmmProcessTlbClear()
 */
 VOID VmmProcessListPIDs(_Out_writes_opt_(*pcPIDs) PDWORD pPIDs, _Inout_ PSIZE_T pcPIDs, _In_ QWORD flags)
 {
-    PVMMOB_PROCESS_TABLE pt = (PVMMOB_PROCESS_TABLE)ObContainer_GetOb(ctxVmm->pObCPROC);
+    PVMMOB_PROCESS_TABLE pt = VmmProcessTable_Get();
     BOOL fShowTerminated = ((flags | ctxVmm->flags) & VMM_FLAG_PROCESS_SHOW_TERMINATED);
     PVMM_PROCESS pProcess;
-    WORD iProcess;
+    SIZE_T iProcess;
     DWORD i = 0;
     if(!pPIDs) {
         *pcPIDs = fShowTerminated ? pt->c : pt->cActive;
@@ -1296,22 +2735,173 @@ VOID VmmProcessListPIDs(_Out_writes_opt_(*pcPIDs) PDWORD pPIDs, _Inout_ PSIZE_T
         Ob_DECREF(pt);
         return;
     }
-    // copy all PIDs
-    iProcess = pt->_iFLink;
-    pProcess = pt->_M[iProcess];
-    while(pProcess) {
+    // copy all PIDs (most recently inserted first)
+    for(iProcess = pt->c; iProcess--; ) {
+        pProcess = pt->_M[iProcess];
         if(!pProcess->dwState || fShowTerminated) {
             *(pPIDs + i) = pProcess->dwPID;
             i++;
         }
-        iProcess = pt->_iFLinkM[iProcess];
-        pProcess = pt->_M[iProcess];
-        if(!pProcess || (iProcess == pt->_iFLink)) { break; }
     }
     *pcPIDs = i;
     Ob_DECREF(pt);
 }
 
+VOID VmmSnapshot_CloseObCallback(_In_ PVOID pVmmOb)
+{
+    DWORD i;
+    PVMMOB_SNAPSHOT pOb = (PVMMOB_SNAPSHOT)pVmmOb;
+    Ob_DECREF(pOb->pObProcessTable);
+    for(i = 0; i < VMM_SNAPSHOT_MAP_MAX; i++) {
+        Ob_DECREF(pOb->pObMap[i]);
+    }
+}
+
+BOOL VmmSnapshot_IsExpired(_In_ PVMMOB_SNAPSHOT pSnapshot)
+{
+    return GetTickCount64() - pSnapshot->qwTickCount >= VMM_SNAPSHOT_DEFER_MS_MAX;
+}
+
+BOOL VmmSnapshot_Update_FilterExpired(_In_ QWORD k, _In_ PVOID v)
+{
+    return VmmSnapshot_IsExpired((PVMMOB_SNAPSHOT)v);
+}
+
+VOID VmmSnapshot_Update_FilterActive(_In_ QWORD k, _In_ PVOID v, _Inout_opt_ PVOID ctx)
+{
+    if(!ctxVmm->Snapshot.pActive || (k > ctxVmm->Snapshot.pActive->qwSnapshotId)) {
+        ctxVmm->Snapshot.pActive = (PVMMOB_SNAPSHOT)v;
+    }
+}
+
+/*
+* Remove expired snapshots and recalculate the active snapshot.
+* NB! Caller must hold ctxVmm->Snapshot.Lock.
+*/
+VOID VmmSnapshot_Update_NoLock()
+{
+    ObMap_RemoveByFilter(ctxVmm->Snapshot.pmObPinned, VmmSnapshot_Update_FilterExpired);
+    ctxVmm->Snapshot.pActive = NULL;
+    ObMap_Filter(ctxVmm->Snapshot.pmObPinned, NULL, VmmSnapshot_Update_FilterActive);
+    ctxVmm->Snapshot.cPinned = ObMap_Size(ctxVmm->Snapshot.pmObPinned);
+}
+
+/*
+* Begin a consistent analysis snapshot. The currently active process table,
+* the already built global maps and the page digest generation are pinned and
+* destructive background refreshes (cache clears and process/map refreshes)
+* are deferred until all snapshots have ended, or for at most
+* VMM_SNAPSHOT_DEFER_MS_MAX milliseconds.
+* -- pqwSnapshotId = receives snapshot to pass to VmmSnapshotEnd.
+* -- return
+*/
+_Success_(return)
+BOOL VmmSnapshotBegin(_Out_ PQWORD pqwSnapshotId)
+{
+    BOOL fResult = FALSE;
+    PVMMOB_SNAPSHOT pObSnapshot = NULL;
+    // master lock ensures no refresh is ongoing while pinning.
+    EnterCriticalSection(&ctxVmm->LockMaster);
+    EnterCriticalSection(&ctxVmm->Snapshot.Lock);
+    VmmSnapshot_Update_NoLock();
+    if((pObSnapshot = Ob_Alloc(OB_TAG_VMM_SNAPSHOT, LMEM_ZEROINIT, sizeof(VMMOB_SNAPSHOT), VmmSnapshot_CloseObCallback, NULL))) {
+        pObSnapshot->qwSnapshotId = ++ctxVmm->Snapshot.qwSnapshotIdLast;
+        pObSnapshot->qwTickCount = GetTickCount64();
+        pObSnapshot->qwPageDigestGeneration = (QWORD)ctxVmm->PageDigest.qwGeneration;
+        pObSnapshot->pObProcessTable = ObContainer_GetOb(ctxVmm->pObCPROC);
+        pObSnapshot->pObMap[VMM_SNAPSHOT_MAP_PHYSMEM] = ObContainer_GetOb(ctxVmm->pObCMapPhysMem);
+        pObSnapshot->pObMap[VMM_SNAPSHOT_MAP_USER] = ObContainer_GetOb(ctxVmm->pObCMapUser);
+        pObSnapshot->pObMap[VMM_SNAPSHOT_MAP_NET] = ObContainer_GetOb(ctxVmm->pObCMapNet);
+        if(pObSnapshot->pObProcessTable && ObMap_Push(ctxVmm->Snapshot.pmObPinned, pObSnapshot->qwSnapshotId, pObSnapshot)) {
+            if(!ctxVmm->Snapshot.cPinned++) {
+                ctxVmm->Snapshot.qwTickCountPinned = pObSnapshot->qwTickCount;
+            }
+            ctxVmm->Snapshot.pActive = pObSnapshot;
+            *pqwSnapshotId = pObSnapshot->qwSnapshotId;
+            fResult = TRUE;
+        }
+    }
+    LeaveCriticalSection(&ctxVmm->Snapshot.Lock);
+    LeaveCriticalSection(&ctxVmm->LockMaster);
+    Ob_DECREF(pObSnapshot);
+    return fResult;
+}
+
+/*
+* End a snapshot started by VmmSnapshotBegin.
+* -- qwSnapshotId
+* -- return = TRUE if the snapshot was active, FALSE if not found or expired.
+*/
+_Success_(return)
+BOOL VmmSnapshotEnd(_In_ QWORD qwSnapshotId)
+{
+    BOOL fResult;
+    PVMMOB_SNAPSHOT pObSnapshot;
+    EnterCriticalSection(&ctxVmm->Snapshot.Lock);
+    pObSnapshot = ObMap_RemoveByKey(ctxVmm->Snapshot.pmObPinned, qwSnapshotId);
+    VmmSnapshot_Update_NoLock();
+    LeaveCriticalSection(&ctxVmm->Snapshot.Lock);
+    fResult = pObSnapshot && !VmmSnapshot_IsExpired(pObSnapshot);
+    Ob_DECREF(pObSnapshot);
+    return fResult;
+}
+
+/*
+* Retrieve the most recently begun snapshot, if it's active and not expired.
+* CALLER DECREF: return
+* -- return
+*/
+PVMMOB_SNAPSHOT VmmSnapshotGetActive()
+{
+    PVMMOB_SNAPSHOT pObSnapshot = NULL;
+    if(!ctxVmm->Snapshot.cPinned) { return NULL; }  // fast path (racy but benign)
+    EnterCriticalSection(&ctxVmm->Snapshot.Lock);
+    if(ctxVmm->Snapshot.pActive && !VmmSnapshot_IsExpired(ctxVmm->Snapshot.pActive)) {
+        pObSnapshot = Ob_INCREF(ctxVmm->Snapshot.pActive);
+    }
+    LeaveCriticalSection(&ctxVmm->Snapshot.Lock);
+    return pObSnapshot;
+}
+
+/*
+* Pin a global map into a snapshot unless one is already pinned. Retrieve the
+* pinned map. If pObMap is NULL the currently pinned map (if any) is returned.
+* FUNCTION DECREF: pObMap
+* CALLER DECREF: return
+* -- pSnapshot
+* -- iMap = VMM_SNAPSHOT_MAP_*
+* -- pObMap
+* -- return
+*/
+PVOID VmmSnapshot_MapPin(_In_ PVMMOB_SNAPSHOT pSnapshot, _In_ DWORD iMap, _In_opt_ _Post_ptr_invalid_ PVOID pObMap)
+{
+    PVOID pObPinned;
+    EnterCriticalSection(&ctxVmm->Snapshot.Lock);
+    if(!pSnapshot->pObMap[iMap]) {
+        pSnapshot->pObMap[iMap] = Ob_INCREF(pObMap);
+    }
+    pObPinned = Ob_INCREF(pSnapshot->pObMap[iMap]);
+    LeaveCriticalSection(&ctxVmm->Snapshot.Lock);
+    Ob_DECREF(pObMap);
+    return pObPinned;
+}
+
+/*
+* Check whether destructive background refreshes should currently be deferred
+* due to active snapshots.
+* -- return
+*/
+BOOL VmmSnapshotIsRefreshDeferred()
+{
+    BOOL fResult;
+    if(!ctxVmm->Snapshot.cPinned) { return FALSE; }
+    EnterCriticalSection(&ctxVmm->Snapshot.Lock);
+    VmmSnapshot_Update_NoLock();
+    fResult = ctxVmm->Snapshot.cPinned && (GetTickCount64() - ctxVmm->Snapshot.qwTickCountPinned < VMM_SNAPSHOT_DEFER_MS_MAX);
+    LeaveCriticalSection(&ctxVmm->Snapshot.Lock);
+    return fResult;
+}
+
 /*
 * Create the initial process table at startup.
 */
@@ -1327,95 +2917,371 @@ BOOL VmmProcessTableCreateInitial()
 
 // ----------------------------------------------------------------------------
 // WORK (THREAD POOL) API:
-// The 'Work' thread pool contain by default 32 threads which is waiting to
-// receive work scheduled by calling the VmmWork function.
+// The 'Work' thread pool contain by default two threads per cpu (between 32
+// and 64 threads) or the number of threads configured with -workthreads. Each
+// worker thread own a deque per priority class. Work is queued on the deques
+// of the scheduling worker thread (or on the deques of a round robin selected
+// worker if scheduled from a non worker thread). A worker thread takes work
+// from the bottom of its own deques and steals from the top of the other
+// deques when idle. Higher priority work is always taken before lower priority
+// work. Work scheduled from a worker thread must not be waited for without a
+// fallback - all workers may be waiting - see VmmProcessActionForeachParallel.
 // ----------------------------------------------------------------------------
 
 typedef struct tdVMMWORK_UNIT {
     LPTHREAD_START_ROUTINE pfn;     // function to call
     PVOID ctx;                      // optional function parameter
     HANDLE hEventFinish;            // optional event to set when upon work completion
+    PVMMOB_WORK_FUTURE pObFuture;   // optional future to complete upon work completion
+    VOID(*pfnRelease)(_In_ PVOID ctx);  // optional function to release ctx if discarded
 } VMMWORK_UNIT, *PVMMWORK_UNIT;
 
-typedef struct tdVMMWORK_THREAD_CONTEXT {
-    HANDLE hEventWakeup;
+typedef struct tdVMMWORK_DEQUE {
+    SRWLOCK LockSRW;
     HANDLE hThread;
-} VMMWORK_THREAD_CONTEXT, *PVMMWORK_THREAD_CONTEXT;
+    struct {
+        volatile DWORD c;
+        DWORD cMax;
+        DWORD iTop;
+        PVMMWORK_UNIT pe;
+    } q[VMMWORK_PRIORITY_COUNT];
+} VMMWORK_DEQUE, *PVMMWORK_DEQUE;
 
-DWORD VmmWork_MainWorkerLoop_ThreadProc(PVMMWORK_THREAD_CONTEXT ctx)
+/*
+* Push a work unit onto the bottom of a deque.
+* -- pd
+* -- dwPriority
+* -- pu
+* -- return
+*/
+_Success_(return)
+BOOL VmmWork_DequePush(_In_ PVMMWORK_DEQUE pd, _In_ DWORD dwPriority, _In_ PVMMWORK_UNIT pu)
 {
-    PVMMWORK_UNIT pu;
-    while(ctxVmm->Work.fEnabled) {
-        if((pu = (PVMMWORK_UNIT)ObSet_Pop(ctxVmm->Work.psUnit))) {
-            pu->pfn(pu->ctx);
-            if(pu->hEventFinish) {
-                SetEvent(pu->hEventFinish);
-            }
-            LocalFree(pu);
+    DWORD i, cMaxNew;
+    PVMMWORK_UNIT peNew;
+    BOOL fResult = FALSE;
+    AcquireSRWLockExclusive(&pd->LockSRW);
+    if(pd->q[dwPriority].c == pd->q[dwPriority].cMax) {
+        cMaxNew = pd->q[dwPriority].cMax ? 2 * pd->q[dwPriority].cMax : VMM_WORK_DEQUE_INITIAL_ENTRIES;
+        if(!(peNew = LocalAlloc(0, cMaxNew * sizeof(VMMWORK_UNIT)))) { goto fail; }
+        for(i = 0; i < pd->q[dwPriority].c; i++) {
+            peNew[i] = pd->q[dwPriority].pe[(pd->q[dwPriority].iTop + i) % pd->q[dwPriority].cMax];
+        }
+        LocalFree(pd->q[dwPriority].pe);
+        pd->q[dwPriority].pe = peNew;
+        pd->q[dwPriority].cMax = cMaxNew;
+        pd->q[dwPriority].iTop = 0;
+    }
+    pd->q[dwPriority].pe[(pd->q[dwPriority].iTop + pd->q[dwPriority].c) % pd->q[dwPriority].cMax] = *pu;
+    pd->q[dwPriority].c++;
+    InterlockedIncrement(&ctxVmm->Work.cQueued);
+    fResult = TRUE;
+fail:
+    ReleaseSRWLockExclusive(&pd->LockSRW);
+    return fResult;
+}
+
+/*
+* Pop a work unit from the bottom (owner) or the top (thief) of a deque.
+* -- pd
+* -- dwPriority
+* -- fBottom
+* -- pu
+* -- return
+*/
+_Success_(return)
+BOOL VmmWork_DequePop(_In_ PVMMWORK_DEQUE pd, _In_ DWORD dwPriority, _In_ BOOL fBottom, _Out_ PVMMWORK_UNIT pu)
+{
+    BOOL fResult = FALSE;
+    if(!pd->q[dwPriority].c) { return FALSE; }
+    AcquireSRWLockExclusive(&pd->LockSRW);
+    if(pd->q[dwPriority].c) {
+        pd->q[dwPriority].c--;
+        if(fBottom) {
+            *pu = pd->q[dwPriority].pe[(pd->q[dwPriority].iTop + pd->q[dwPriority].c) % pd->q[dwPriority].cMax];
         } else {
-            ResetEvent(ctx->hEventWakeup);
-            ObSet_Push(ctxVmm->Work.psThreadAvail, (QWORD)ctx);
-            WaitForSingleObject(ctx->hEventWakeup, INFINITE);
+            *pu = pd->q[dwPriority].pe[pd->q[dwPriority].iTop];
+            pd->q[dwPriority].iTop = (pd->q[dwPriority].iTop + 1) % pd->q[dwPriority].cMax;
         }
+        InterlockedDecrement(&ctxVmm->Work.cQueued);
+        fResult = TRUE;
     }
-    ObSet_Remove(ctxVmm->Work.psThreadAll, (QWORD)ctx);
-    CloseHandle(ctx->hEventWakeup);
-    CloseHandle(ctx->hThread);
-    LocalFree(ctx);
+    ReleaseSRWLockExclusive(&pd->LockSRW);
+    return fResult;
+}
+
+/*
+* Take the highest priority work unit available to a worker thread. Its own
+* deque is preferred over stealing from the other deques.
+* -- iWorker
+* -- pu
+* -- return
+*/
+_Success_(return)
+BOOL VmmWork_Take(_In_ DWORD iWorker, _Out_ PVMMWORK_UNIT pu)
+{
+    DWORD iPriority, i;
+    for(iPriority = 0; iPriority < VMMWORK_PRIORITY_COUNT; iPriority++) {
+        if(VmmWork_DequePop(ctxVmm->Work.paDeque + iWorker, iPriority, TRUE, pu)) { return TRUE; }
+        for(i = 1; i < ctxVmm->Work.cThread; i++) {
+            if(VmmWork_DequePop(ctxVmm->Work.paDeque + ((iWorker + i) % ctxVmm->Work.cThread), iPriority, FALSE, pu)) { return TRUE; }
+        }
+    }
+    return FALSE;
+}
+
+/*
+* Complete a work unit - either after execution or when discarded on shutdown.
+* -- pu
+* -- fCompleted
+* -- dwResult
+*/
+VOID VmmWork_Complete(_In_ PVMMWORK_UNIT pu, _In_ BOOL fCompleted, _In_ DWORD dwResult)
+{
+    if(!fCompleted && pu->pfnRelease) {
+        pu->pfnRelease(pu->ctx);
+    }
+    if(pu->pObFuture) {
+        pu->pObFuture->dwResult = dwResult;
+        pu->pObFuture->fCompleted = fCompleted;
+        SetEvent(pu->pObFuture->hEventFinish);
+        Ob_DECREF(pu->pObFuture);
+    }
+    if(pu->hEventFinish) {
+        SetEvent(pu->hEventFinish);
+    }
+}
+
+DWORD VmmWork_MainWorkerLoop_ThreadProc(_In_ LPVOID lpParameter)
+{
+    VMMWORK_UNIT u;
+    DWORD iWorker = (DWORD)(SIZE_T)lpParameter;
+    TlsSetValue(ctxVmm->Work.dwTlsIndex, (LPVOID)(SIZE_T)(iWorker + 1));
+    while(ctxVmm->Work.fEnabled) {
+        if(VmmWork_Take(iWorker, &u)) {
+            VmmWork_Complete(&u, TRUE, u.pfn(u.ctx));
+            continue;
+        }
+        AcquireSRWLockExclusive(&ctxVmm->Work.LockSRW);
+        InterlockedIncrement(&ctxVmm->Work.cIdle);
+        while(ctxVmm->Work.fEnabled && !ctxVmm->Work.cQueued) {
+            SleepConditionVariableSRW(&ctxVmm->Work.CondWork, &ctxVmm->Work.LockSRW, INFINITE, 0);
+        }
+        InterlockedDecrement(&ctxVmm->Work.cIdle);
+        ReleaseSRWLockExclusive(&ctxVmm->Work.LockSRW);
+    }
+    InterlockedDecrement(&ctxVmm->Work.cThreadActive);
     return 1;
 }
 
 VOID VmmWork_Initialize()
 {
-    PVMMWORK_THREAD_CONTEXT p;
+    DWORD i;
+    SYSTEM_INFO SystemInfo = { 0 };
+    GetSystemInfo(&SystemInfo);
+    if(ctxMain->cfg.cWorkThreads) {
+        ctxVmm->Work.cThread = min(VMM_WORK_THREADPOOL_NUM_THREADS_MAX, max(VMM_WORK_THREADPOOL_NUM_THREADS_CFG_MIN, ctxMain->cfg.cWorkThreads));
+    } else {
+        ctxVmm->Work.cThread = min(VMM_WORK_THREADPOOL_NUM_THREADS_MAX, max(VMM_WORK_THREADPOOL_NUM_THREADS_MIN, 2 * SystemInfo.dwNumberOfProcessors));
+    }
+    if(!(ctxVmm->Work.paDeque = LocalAlloc(LMEM_ZEROINIT, ctxVmm->Work.cThread * sizeof(VMMWORK_DEQUE)))) { return; }
+    if(TLS_OUT_OF_INDEXES == (ctxVmm->Work.dwTlsIndex = TlsAlloc())) {
+        LocalFree(ctxVmm->Work.paDeque);
+        ctxVmm->Work.paDeque = NULL;
+        return;
+    }
+    InitializeSRWLock(&ctxVmm->Work.LockSRW);
+    InitializeConditionVariable(&ctxVmm->Work.CondWork);
+    for(i = 0; i < ctxVmm->Work.cThread; i++) {
+        InitializeSRWLock(&ctxVmm->Work.paDeque[i].LockSRW);
+    }
     ctxVmm->Work.fEnabled = TRUE;
-    ctxVmm->Work.psUnit = ObSet_New();
-    ctxVmm->Work.psThreadAll = ObSet_New();
-    ctxVmm->Work.psThreadAvail = ObSet_New();
-    while(ObSet_Size(ctxVmm->Work.psThreadAll) < VMM_WORK_THREADPOOL_NUM_THREADS) {
-        if((p = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMWORK_THREAD_CONTEXT)))) {
-            p->hEventWakeup = CreateEvent(NULL, TRUE, FALSE, NULL);
-            p->hThread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)VmmWork_MainWorkerLoop_ThreadProc, p, 0, NULL);
-            ObSet_Push(ctxVmm->Work.psThreadAll, (QWORD)p);
+    for(i = 0; i < ctxVmm->Work.cThread; i++) {
+        InterlockedIncrement(&ctxVmm->Work.cThreadActive);
+        if(!(ctxVmm->Work.paDeque[i].hThread = CreateThread(NULL, 0, VmmWork_MainWorkerLoop_ThreadProc, (LPVOID)(SIZE_T)i, 0, NULL))) {
+            InterlockedDecrement(&ctxVmm->Work.cThreadActive);
         }
     }
 }
 
 VOID VmmWork_Close()
 {
-    PVMMWORK_UNIT pu;
-    PVMMWORK_THREAD_CONTEXT pt = NULL;
+    DWORD i, iPriority;
+    VMMWORK_UNIT u;
+    if(!ctxVmm->Work.paDeque) { return; }
+    AcquireSRWLockExclusive(&ctxVmm->Work.LockSRW);
     ctxVmm->Work.fEnabled = FALSE;
-    while(ObSet_Size(ctxVmm->Work.psThreadAll)) {
-        while((pt = (PVMMWORK_THREAD_CONTEXT)ObSet_GetNext(ctxVmm->Work.psThreadAll, (QWORD)pt))) {
-            SetEvent(pt->hEventWakeup);
-        }
+    WakeAllConditionVariable(&ctxVmm->Work.CondWork);
+    ReleaseSRWLockExclusive(&ctxVmm->Work.LockSRW);
+    while(ctxVmm->Work.cThreadActive) {
         SwitchToThread();
     }
-    while((pu = (PVMMWORK_UNIT)ObSet_Pop(ctxVmm->Work.psUnit))) {
-        if(pu->hEventFinish) {
-            SetEvent(pu->hEventFinish);
+    for(i = 0; i < ctxVmm->Work.cThread; i++) {
+        for(iPriority = 0; iPriority < VMMWORK_PRIORITY_COUNT; iPriority++) {
+            while(VmmWork_DequePop(ctxVmm->Work.paDeque + i, iPriority, FALSE, &u)) {
+                VmmWork_Complete(&u, FALSE, 0);
+            }
+            LocalFree(ctxVmm->Work.paDeque[i].q[iPriority].pe);
+        }
+        if(ctxVmm->Work.paDeque[i].hThread) {
+            CloseHandle(ctxVmm->Work.paDeque[i].hThread);
         }
-        LocalFree(pu);
     }
-    Ob_DECREF_NULL(&ctxVmm->Work.psUnit);
-    Ob_DECREF_NULL(&ctxVmm->Work.psThreadAll);
-    Ob_DECREF_NULL(&ctxVmm->Work.psThreadAvail);
+    TlsFree(ctxVmm->Work.dwTlsIndex);
+    LocalFree(ctxVmm->Work.paDeque);
+    ctxVmm->Work.paDeque = NULL;
+}
+
+_Success_(return)
+BOOL VmmWork_Submit(_In_ PVMMWORK_UNIT pu, _In_ DWORD dwPriority)
+{
+    DWORD iWorker;
+    if(!ctxVmm->Work.fEnabled || (dwPriority >= VMMWORK_PRIORITY_COUNT)) { return FALSE; }
+    if((iWorker = (DWORD)(SIZE_T)TlsGetValue(ctxVmm->Work.dwTlsIndex))) {
+        iWorker--;
+    } else {
+        iWorker = (DWORD)InterlockedIncrement(&ctxVmm->Work.iSubmit) % ctxVmm->Work.cThread;
+    }
+    if(!VmmWork_DequePush(ctxVmm->Work.paDeque + iWorker, dwPriority, pu)) { return FALSE; }
+    if(ctxVmm->Work.cIdle) {
+        AcquireSRWLockExclusive(&ctxVmm->Work.LockSRW);
+        WakeConditionVariable(&ctxVmm->Work.CondWork);
+        ReleaseSRWLockExclusive(&ctxVmm->Work.LockSRW);
+    }
+    return TRUE;
+}
+
+_Success_(return)
+BOOL VmmWorkEx(_In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx, _In_opt_ HANDLE hEventFinish, _In_ DWORD dwPriority)
+{
+    VMMWORK_UNIT u = { 0 };
+    u.pfn = pfn;
+    u.ctx = ctx;
+    u.hEventFinish = hEventFinish;
+    return VmmWork_Submit(&u, dwPriority);
 }
 
 VOID VmmWork(_In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx, _In_opt_ HANDLE hEventFinish)
 {
-    PVMMWORK_UNIT pu;
-    PVMMWORK_THREAD_CONTEXT pt;
-    if((pu = LocalAlloc(0, sizeof(VMMWORK_UNIT)))) {
-        pu->pfn = pfn;
-        pu->ctx = ctx;
-        pu->hEventFinish = hEventFinish;
-        ObSet_Push(ctxVmm->Work.psUnit, (QWORD)pu);
-        if((pt = (PVMMWORK_THREAD_CONTEXT)ObSet_Pop(ctxVmm->Work.psThreadAvail))) {
-            SetEvent(pt->hEventWakeup);
+    VmmWorkEx(pfn, ctx, hEventFinish, VMMWORK_PRIORITY_NORMAL);
+}
+
+_Success_(return)
+BOOL VmmWorkRelease(_In_ LPTHREAD_START_ROUTINE pfn, _In_ PVOID ctx, _In_ VOID(*pfnRelease)(_In_ PVOID ctx), _In_ DWORD dwPriority)
+{
+    VMMWORK_UNIT u = { 0 };
+    u.pfn = pfn;
+    u.ctx = ctx;
+    u.pfnRelease = pfnRelease;
+    return VmmWork_Submit(&u, dwPriority);
+}
+
+VOID VmmWorkFuture_CloseObCallback(_In_ PVOID pOb)
+{
+    PVMMOB_WORK_FUTURE pObFuture = (PVMMOB_WORK_FUTURE)pOb;
+    if(pObFuture->hEventFinish) {
+        CloseHandle(pObFuture->hEventFinish);
+    }
+}
+
+PVMMOB_WORK_FUTURE VmmWorkFuture(_In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx, _In_ DWORD dwPriority)
+{
+    VMMWORK_UNIT u = { 0 };
+    PVMMOB_WORK_FUTURE pObFuture;
+    if(!(pObFuture = Ob_Alloc(OB_TAG_VMM_WORK_FUTURE, LMEM_ZEROINIT, sizeof(VMMOB_WORK_FUTURE), VmmWorkFuture_CloseObCallback, NULL))) { return NULL; }
+    if(!(pObFuture->hEventFinish = CreateEvent(NULL, TRUE, FALSE, NULL))) {
+        Ob_DECREF(pObFuture);
+        return NULL;
+    }
+    u.pfn = pfn;
+    u.ctx = ctx;
+    u.pObFuture = Ob_INCREF(pObFuture);
+    if(!VmmWork_Submit(&u, dwPriority)) {
+        Ob_DECREF(pObFuture);
+        Ob_DECREF(pObFuture);
+        return NULL;
+    }
+    return pObFuture;
+}
+
+_Success_(return)
+BOOL VmmWorkFuture_Wait(_In_ PVMMOB_WORK_FUTURE pFuture, _In_ DWORD dwMilliseconds, _Out_opt_ PDWORD pdwResult)
+{
+    if(WAIT_OBJECT_0 != WaitForSingleObject(pFuture->hEventFinish, dwMilliseconds)) { return FALSE; }
+    if(!pFuture->fCompleted) { return FALSE; }
+    if(pdwResult) { *pdwResult = pFuture->dwResult; }
+    return TRUE;
+}
+
+VOID VmmWorkParallel_CloseObCallback(_In_ PVOID pOb)
+{
+    PVMMOB_WORK_PARALLEL pObWork = (PVMMOB_WORK_PARALLEL)pOb;
+    if(pObWork->hEventFinish) {
+        CloseHandle(pObWork->hEventFinish);
+    }
+}
+
+BOOL VmmWorkParallel_ClaimOne(_In_ PVMMOB_WORK_PARALLEL pWork)
+{
+    LONG i;
+    if((i = InterlockedIncrement(&pWork->iNext) - 1) >= (LONG)pWork->c) { return FALSE; }
+    pWork->pfnItem(pWork->ctx, (DWORD)i);
+    if((0 == InterlockedDecrement(&pWork->cRemaining)) && pWork->hEventFinish) {
+        SetEvent(pWork->hEventFinish);
+    }
+    return TRUE;
+}
+
+DWORD VmmWorkParallel_ThreadProc(_In_ PVMMOB_WORK_PARALLEL pObWork)
+{
+    while(VmmWorkParallel_ClaimOne(pObWork));
+    Ob_DECREF(pObWork);
+    return 1;
+}
+
+PVMMOB_WORK_PARALLEL VmmWorkParallel_Start(_In_ DWORD c, _In_ DWORD cThread, _In_ VOID(*pfnItem)(_In_opt_ PVOID ctx, _In_ DWORD i), _In_opt_ PVOID ctx)
+{
+    DWORD i;
+    PVMMOB_WORK_PARALLEL pObWork;
+    if(!(pObWork = Ob_Alloc(OB_TAG_VMM_WORK_PARALLEL, LMEM_ZEROINIT, sizeof(VMMOB_WORK_PARALLEL), VmmWorkParallel_CloseObCallback, NULL))) { return NULL; }
+    pObWork->pfnItem = pfnItem;
+    pObWork->ctx = ctx;
+    pObWork->c = c;
+    pObWork->cRemaining = c;
+    cThread = min(cThread, c ? c - 1 : 0);
+    if(cThread && ctxVmm->Work.fEnabled && (pObWork->hEventFinish = CreateEvent(NULL, TRUE, FALSE, NULL))) {
+        for(i = 0; i < cThread; i++) {
+            if(!VmmWorkRelease((LPTHREAD_START_ROUTINE)VmmWorkParallel_ThreadProc, Ob_INCREF(pObWork), (VOID(*)(PVOID))Ob_DECREF, VMMWORK_PRIORITY_NORMAL)) {
+                Ob_DECREF(pObWork);
+                break;
+            }
         }
     }
+    return pObWork;
+}
+
+VOID VmmWorkParallel_Finish(_In_opt_ _Post_ptr_invalid_ PVMMOB_WORK_PARALLEL pObWork)
+{
+    if(!pObWork) { return; }
+    while(VmmWorkParallel_ClaimOne(pObWork));
+    if(pObWork->cRemaining) {
+        WaitForSingleObject(pObWork->hEventFinish, INFINITE);
+    }
+    Ob_DECREF(pObWork);
+}
+
+VOID VmmWorkParallel(_In_ DWORD c, _In_ DWORD cThread, _In_ VOID(*pfnItem)(_In_opt_ PVOID ctx, _In_ DWORD i), _In_opt_ PVOID ctx)
+{
+    DWORD i;
+    PVMMOB_WORK_PARALLEL pObWork;
+    if(!c) { return; }
+    if(!(pObWork = VmmWorkParallel_Start(c, cThread, pfnItem, ctx))) {
+        for(i = 0; i < c; i++) {
+            pfnItem(ctx, i);
+        }
+        return;
+    }
+    VmmWorkParallel_Finish(pObWork);
 }
 
 // ----------------------------------------------------------------------------
@@ -1424,23 +3290,80 @@ VOID VmmWork(_In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx, _In_opt_ HANDL
 
 typedef struct tdVMM_PROCESS_ACTION_FOREACH {
     HANDLE hEventFinish;
-    VOID(*pfnAction)(_In_ PVMM_PROCESS pProcess, _In_ PVOID ctx);
+    CRITICAL_SECTION LockResult;
+    PVOID(*pfnAction)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx);
+    VOID(*pfnResult)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID pvResult, _In_opt_ PVOID ctx);
     PVOID ctxAction;
-    DWORD cRemainingWork;       // set to dwPIDs count on entry and decremented as-goes - when zero FinishEvent is set.
-    DWORD iPID;                 // set to dwPIDs count on entry and decremented as-goes
+    PBOOL pfCancel;
+    BOOL fCancelled;
+    DWORD cChunk;
+    volatile LONG iNext;        // next PID index to claim (claimed in chunks of cChunk)
+    volatile LONG cRef;         // caller + queued work items - ctx is free'd when zero.
+    volatile LONG cBusy;        // work items currently processing chunks.
+    volatile LONG fDone;        // caller has finished - work items not yet started are skipped.
+    DWORD cPIDs;
     DWORD dwPIDs[];
 } VMM_PROCESS_ACTION_FOREACH, *PVMM_PROCESS_ACTION_FOREACH;
 
+/*
+* Process chunks of PIDs until no more are remaining or until cancelled. This
+* is run by the worker threads as well as by the calling thread.
+* -- ctx
+*/
+VOID VmmProcessActionForeachParallel_DoWork(_In_ PVMM_PROCESS_ACTION_FOREACH ctx)
+{
+    DWORD i, iStart, iEnd;
+    PVOID pvResult;
+    PVMM_PROCESS pObProcess;
+    while(TRUE) {
+        iStart = (DWORD)InterlockedAdd(&ctx->iNext, ctx->cChunk) - ctx->cChunk;
+        if(iStart >= ctx->cPIDs) { return; }
+        iEnd = min(ctx->cPIDs, iStart + ctx->cChunk);
+        for(i = iStart; i < iEnd; i++) {
+            if((ctx->pfCancel && *(volatile BOOL*)ctx->pfCancel) || !ctxVmm->Work.fEnabled) {
+                ctx->fCancelled = TRUE;
+                return;
+            }
+            if((pObProcess = VmmProcessGet(ctx->dwPIDs[i]))) {
+                pvResult = ctx->pfnAction(pObProcess, ctx->ctxAction);
+                if(ctx->pfnResult) {
+                    EnterCriticalSection(&ctx->LockResult);
+                    ctx->pfnResult(pObProcess, pvResult, ctx->ctxAction);
+                    LeaveCriticalSection(&ctx->LockResult);
+                }
+                Ob_DECREF(pObProcess);
+            }
+        }
+    }
+}
+
+VOID VmmProcessActionForeachParallel_Release(_In_ PVMM_PROCESS_ACTION_FOREACH ctx)
+{
+    if(0 == InterlockedDecrement(&ctx->cRef)) {
+        DeleteCriticalSection(&ctx->LockResult);
+        CloseHandle(ctx->hEventFinish);
+        LocalFree(ctx);
+    }
+}
+
+/*
+* Worker thread part of a parallel process action. Work items which are not
+* started before the calling thread has finished all chunks are skipped - the
+* caller never waits for queued work items, only for work items which are
+* actively processing claimed chunks. This prevents nested waits on worker
+* threads from deadlocking the pool when all workers are waiting.
+* -- ctx
+*/
 DWORD VmmProcessActionForeachParallel_ThreadProc(PVMM_PROCESS_ACTION_FOREACH ctx)
 {
-    PVMM_PROCESS pObProcess = VmmProcessGet(ctx->dwPIDs[InterlockedDecrement(&ctx->iPID)]);
-    if(pObProcess) {
-        ctx->pfnAction(pObProcess, ctx->ctxAction);
-        Ob_DECREF(pObProcess);
+    InterlockedIncrement(&ctx->cBusy);
+    if(!ctx->fDone) {
+        VmmProcessActionForeachParallel_DoWork(ctx);
     }
-    if(0 == InterlockedDecrement(&ctx->cRemainingWork)) {
+    if((0 == InterlockedDecrement(&ctx->cBusy)) && ctx->fDone) {
         SetEvent(ctx->hEventFinish);
     }
+    VmmProcessActionForeachParallel_Release(ctx);
     return 1;
 }
 
@@ -1449,104 +3372,336 @@ BOOL VmmProcessActionForeachParallel_CriteriaActiveOnly(_In_ PVMM_PROCESS pProce
     return pProcess->dwState == 0;
 }
 
-VOID VmmProcessActionForeachParallel(_In_opt_ PVOID ctxAction, _In_opt_ BOOL(*pfnCriteria)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx), _In_ VOID(*pfnAction)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx))
-{
-    DWORD i, cProcess;
+_Success_(return)
+BOOL VmmProcessActionForeachParallelEx(
+    _In_opt_ PVOID ctxAction,
+    _In_ DWORD cChunk,
+    _In_opt_ PBOOL pfCancel,
+    _In_opt_ BOOL(*pfnCriteria)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx),
+    _In_ PVOID(*pfnAction)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx),
+    _In_opt_ VOID(*pfnResult)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID pvResult, _In_opt_ PVOID ctx)
+) {
+    BOOL fResult = FALSE;
+    DWORD i, cProcess, cWork;
     PVMM_PROCESS pObProcess = NULL;
     POB_SET pObProcessSelectedSet = NULL;
     PVMM_PROCESS_ACTION_FOREACH ctx = NULL;
     // 1: select processes to queue using criteria function
     if(!(pObProcessSelectedSet = ObSet_New())) { goto fail; }
-    while(pObProcess = VmmProcessGetNext(pObProcess, VMM_FLAG_PROCESS_SHOW_TERMINATED)) {
-        if(!pfnCriteria || pfnCriteria(pObProcess, ctx)) {
+    while((pObProcess = VmmProcessGetNext(pObProcess, VMM_FLAG_PROCESS_SHOW_TERMINATED))) {
+        if(!pfnCriteria || pfnCriteria(pObProcess, ctxAction)) {
             ObSet_Push(pObProcessSelectedSet, pObProcess->dwPID);
         }
     }
-    if(!(cProcess = ObSet_Size(pObProcessSelectedSet))) { goto fail; }
+    if(!(cProcess = ObSet_Size(pObProcessSelectedSet))) {
+        fResult = TRUE;
+        goto fail;
+    }
     // 2: set up context for worker function
     if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(VMM_PROCESS_ACTION_FOREACH) + cProcess * sizeof(DWORD)))) { goto fail; }
-    if(!(ctx->hEventFinish = CreateEvent(NULL, TRUE, FALSE, NULL))) { goto fail; }
+    if(!(ctx->hEventFinish = CreateEvent(NULL, TRUE, FALSE, NULL))) {
+        LocalFree(ctx);
+        ctx = NULL;
+        goto fail;
+    }
+    InitializeCriticalSection(&ctx->LockResult);
+    ctx->cRef = 1;
     ctx->pfnAction = pfnAction;
+    ctx->pfnResult = pfnResult;
     ctx->ctxAction = ctxAction;
-    ctx->cRemainingWork = cProcess;
-    ctx->iPID = cProcess;
+    ctx->pfCancel = pfCancel;
+    ctx->cChunk = max(1, cChunk);
+    ctx->cPIDs = cProcess;
     for(i = 0; i < cProcess; i++) {
         ctx->dwPIDs[i] = (DWORD)ObSet_Pop(pObProcessSelectedSet);
     }
-    // 3: parallelize onto worker threads and wait for completion
-    for(i = 0; i < cProcess; i++) {
-        VmmWork(VmmProcessActionForeachParallel_ThreadProc, ctx, NULL);
+    // 3: parallelize onto worker threads (the calling thread also processes
+    //    chunks) and wait for work items still busy with claimed chunks.
+    cWork = min(ctxVmm->Work.cThread, (cProcess + ctx->cChunk - 1) / ctx->cChunk);
+    cWork = cWork ? cWork - 1 : 0;
+    for(i = 0; i < cWork; i++) {
+        InterlockedIncrement(&ctx->cRef);
+        if(!VmmWorkEx((LPTHREAD_START_ROUTINE)VmmProcessActionForeachParallel_ThreadProc, ctx, NULL, VMMWORK_PRIORITY_NORMAL)) {
+            InterlockedDecrement(&ctx->cRef);
+        }
     }
-    WaitForSingleObject(ctx->hEventFinish, INFINITE);
-    BOOL DEBUG = ctxVmm->f32;
+    VmmProcessActionForeachParallel_DoWork(ctx);
+    InterlockedExchange(&ctx->fDone, TRUE);
+    if(ctx->cBusy) {
+        WaitForSingleObject(ctx->hEventFinish, INFINITE);
+    }
+    fResult = !ctx->fCancelled;
 fail:
     Ob_DECREF(pObProcessSelectedSet);
     if(ctx) {
-        if(ctx->hEventFinish) {
-            CloseHandle(ctx->hEventFinish);
-        }
-        LocalFree(ctx);
+        VmmProcessActionForeachParallel_Release(ctx);
     }
+    return fResult;
+}
+
+typedef struct tdVMM_PROCESS_ACTION_FOREACH_COMPAT {
+    PVOID ctxAction;
+    VOID(*pfnAction)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx);
+    BOOL(*pfnCriteria)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx);
+} VMM_PROCESS_ACTION_FOREACH_COMPAT, *PVMM_PROCESS_ACTION_FOREACH_COMPAT;
+
+BOOL VmmProcessActionForeachParallel_CompatCriteria(_In_ PVMM_PROCESS pProcess, _In_ PVMM_PROCESS_ACTION_FOREACH_COMPAT ctx)
+{
+    return !ctx->pfnCriteria || ctx->pfnCriteria(pProcess, ctx->ctxAction);
+}
+
+PVOID VmmProcessActionForeachParallel_CompatAction(_In_ PVMM_PROCESS pProcess, _In_ PVMM_PROCESS_ACTION_FOREACH_COMPAT ctx)
+{
+    ctx->pfnAction(pProcess, ctx->ctxAction);
+    return NULL;
+}
+
+VOID VmmProcessActionForeachParallel(_In_opt_ PVOID ctxAction, _In_opt_ BOOL(*pfnCriteria)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx), _In_ VOID(*pfnAction)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx))
+{
+    VMM_PROCESS_ACTION_FOREACH_COMPAT ctx;
+    ctx.ctxAction = ctxAction;
+    ctx.pfnAction = pfnAction;
+    ctx.pfnCriteria = pfnCriteria;
+    VmmProcessActionForeachParallelEx(
+        &ctx,
+        VMM_PROCESS_ACTION_FOREACH_CHUNK_DEFAULT,
+        NULL,
+        (BOOL(*)(PVMM_PROCESS, PVOID))VmmProcessActionForeachParallel_CompatCriteria,
+        (PVOID(*)(PVMM_PROCESS, PVOID))VmmProcessActionForeachParallel_CompatAction,
+        NULL);
 }
 
 // ----------------------------------------------------------------------------
 // INTERNAL VMMU FUNCTIONALITY: VIRTUAL MEMORY ACCESS.
 // ----------------------------------------------------------------------------
 
-VOID VmmWriteScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsPhys)
+VOID VmmWriteScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsPhys)
+{
+    DWORD i;
+    PMEM_SCATTER pMEM;
+    LcWriteScatter(ctxMain->hLC, cpMEMsPhys, ppMEMsPhys);
+    if(ctxVmm->PageDigest.cEnabled) {
+        InterlockedIncrement64(&ctxVmm->PageDigest.qwGeneration);
+    }
+    for(i = 0; i < cpMEMsPhys; i++) {
+        pMEM = ppMEMsPhys[i];
+        InterlockedIncrement64(&ctxVmm->stat.cPhysWrite);
+        if(pMEM->f && MEM_SCATTER_ADDR_ISVALID(pMEM)) {
+            VmmCacheInvalidate(pMEM->qwA & ~0xfff);
+        }
+    }
+}
+
+VOID VmmWriteScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_ PPMEM_SCATTER ppMEMsVirt, _In_ DWORD cpMEMsVirt)
+{
+    DWORD i;
+    QWORD qwPA_PTE = 0, qwPagedPA = 0;
+    PMEM_SCATTER pMEM;
+    for(i = 0; i < cpMEMsVirt; i++) {
+        pMEM = ppMEMsVirt[i];
+        MEM_SCATTER_STACK_PUSH(pMEM, pMEM->qwA);
+        if(pMEM->f || (pMEM->qwA == -1)) {
+            pMEM->qwA = -1;
+            continue;
+        }
+        if(VmmVirt2Phys(pProcess, pMEM->qwA, &qwPA_PTE)) {
+            pMEM->qwA = qwPA_PTE;
+            continue;
+        }
+        // paged "read" also translate virtual -> physical for some
+        // types of paged memory such as transition and prototype.
+        ctxVmm->fnMemoryModel.pfnPagedRead(pProcess, pMEM->qwA, qwPA_PTE, NULL, &qwPagedPA, NULL, 0);
+        pMEM->qwA = qwPagedPA ? qwPagedPA : -1;
+    }
+    VmmWriteScatterPhysical(ppMEMsVirt, cpMEMsVirt);
+    for(i = 0; i < cpMEMsVirt; i++) {
+        ppMEMsVirt[i]->qwA = MEM_SCATTER_STACK_POP(ppMEMsVirt[i]);
+    }
+}
+
+/*
+* Update the read-ahead stream detector of the calling thread with a read and
+* retrieve the read-ahead window to use. Sequential and constant strided reads
+* grow the window (up to ctxVmm->ReadAhead.cPagesMax - scaled by round-trip
+* time on remote devices) while random reads will shrink it - eventually to zero.
+* -- paFirst = first page of the read.
+* -- paLast = last page of the read.
+* -- pqwStride = receives the distance between read-ahead pages.
+* -- return = number of pages to read ahead.
+*/
+DWORD VmmReadAhead_Update(_In_ QWORD paFirst, _In_ QWORD paLast, _Out_ PQWORD pqwStride)
+{
+    QWORD qwStride;
+    DWORD cPagesMax, dwTID = GetCurrentThreadId();
+    PVMM_READAHEAD_STREAM s = &ctxVmm->ReadAhead.Stream[(dwTID >> 2) % VMM_READAHEAD_STREAMS];
+    paFirst &= ~0xfff;
+    paLast &= ~0xfff;
+    if(s->dwTID != dwTID) {
+        // new stream
+        s->dwTID = dwTID;
+        s->cPages = VMM_READAHEAD_PAGES_INITIAL;
+        s->qwStride = 0x1000;
+    } else if(paFirst != s->paLast) {
+        qwStride = paFirst - s->paLast;
+        if((qwStride == 0x1000) || ((qwStride == s->qwStride) && (qwStride < VMM_READAHEAD_STRIDE_MAX))) {
+            // sequential or constant (forward) stride -> grow window
+            s->cPages = max(VMM_READAHEAD_PAGES_INITIAL, s->cPages << 1);
+        } else {
+            // random -> back off
+            s->cPages = s->cPages >> 1;
+        }
+        s->qwStride = qwStride;
+    }
+    s->paLast = paLast;
+    cPagesMax = ctxVmm->ReadAhead.cPagesMax;
+    if(ctxVmm->DeviceSched.Remote.fEnabled) {
+        cPagesMax = min(VMM_READAHEAD_PAGES_MAX, cPagesMax * ctxVmm->DeviceSched.Remote.cReadAheadMult);
+    }
+    s->cPages = min(s->cPages, cPagesMax);
+    *pqwStride = (s->qwStride < VMM_READAHEAD_STRIDE_MAX) ? s->qwStride : 0x1000;
+    return s->cPages;
+}
+
+VOID VmmFileMap_Close()
+{
+    if(ctxMain->filemap.pb) {
+        UnmapViewOfFile(ctxMain->filemap.pb);
+    }
+    if(ctxMain->filemap.hMap) {
+        CloseHandle(ctxMain->filemap.hMap);
+    }
+    if(ctxMain->filemap.hFile) {
+        CloseHandle(ctxMain->filemap.hFile);
+    }
+    ZeroMemory(&ctxMain->filemap, sizeof(ctxMain->filemap));
+}
+
+/*
+* Copy from the memory mapped view of the raw memory dump file. An i/o error
+* on the underlying file (e.g. network share or removable media) surfaces as
+* an EXCEPTION_IN_PAGE_ERROR on access which is caught here.
+* -- pb
+* -- pa
+* -- cb
+* -- return = TRUE on success, FALSE on in-page error.
+*/
+_Success_(return)
+BOOL VmmFileMap_Copy(_Out_writes_(cb) PBYTE pb, _In_ QWORD pa, _In_ DWORD cb)
+{
+    __try {
+        memcpy(pb, ctxMain->filemap.pb + pa, cb);
+        return TRUE;
+    } __except(GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+        return FALSE;
+    }
+}
+
+BOOL VmmFileMap_Initialize()
 {
     DWORD i;
-    PMEM_SCATTER pMEM;
-    LcWriteScatter(ctxMain->hLC, cpMEMsPhys, ppMEMsPhys);
-    for(i = 0; i < cpMEMsPhys; i++) {
-        pMEM = ppMEMsPhys[i];
-        InterlockedIncrement64(&ctxVmm->stat.cPhysWrite);
-        if(pMEM->f && MEM_SCATTER_ADDR_ISVALID(pMEM)) {
-            VmmCacheInvalidate(pMEM->qwA & ~0xfff);
-        }
+    LPSTR szFile;
+    LARGE_INTEGER cbFile;
+    BYTE pbPage[0x1000], pbPageMap[0x1000];
+    QWORD pa, paSample[] = { 0x1000, (ctxMain->dev.paMax >> 1) & ~0xfff, (ctxMain->dev.paMax - 0x1000) & ~0xfff };
+    // only raw non-volatile read-only local memory dump files are supported.
+    if(ctxMain->filemap.pb || ctxMain->cfg.fDisableFileMap) { return FALSE; }
+    if(ctxMain->dev.fVolatile || ctxMain->dev.fWritable || ctxMain->dev.fRemote || (ctxMain->dev.paMax < 0x2000)) { return FALSE; }
+    if(_stricmp(ctxMain->dev.szDeviceName, "file")) { return FALSE; }
+    szFile = ctxMain->dev.szDevice;
+    if(!_strnicmp(szFile, "file://", 7)) { szFile += 7; }
+    ctxMain->filemap.hFile = CreateFileA(szFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(ctxMain->filemap.hFile == INVALID_HANDLE_VALUE) {
+        ctxMain->filemap.hFile = NULL;
+        goto fail;
+    }
+    if(!GetFileSizeEx(ctxMain->filemap.hFile, &cbFile) || ((QWORD)cbFile.QuadPart < ctxMain->dev.paMax)) { goto fail; }
+    if(!(ctxMain->filemap.hMap = CreateFileMappingA(ctxMain->filemap.hFile, NULL, PAGE_READONLY, 0, 0, NULL))) { goto fail; }
+    if(!(ctxMain->filemap.pb = MapViewOfFile(ctxMain->filemap.hMap, FILE_MAP_READ, 0, 0, 0))) { goto fail; }
+    ctxMain->filemap.cb = ctxMain->dev.paMax;
+    // memory dump files with headers (crash dumps, elf cores) are translated by
+    // leechcore - detect these by signature and by comparing sample pages.
+    if(!VmmFileMap_Copy(pbPageMap, 0, 0x1000)) { goto fail; }
+    if(!memcmp(pbPageMap, "PAGEDU", 6) || !memcmp(pbPageMap, "\x7f" "ELF", 4)) { goto fail; }
+    for(i = 0; i < sizeof(paSample) / sizeof(QWORD); i++) {
+        pa = paSample[i];
+        if(!LcRead(ctxMain->hLC, pa, 0x1000, pbPage) || !VmmFileMap_Copy(pbPageMap, pa, 0x1000) || memcmp(pbPage, pbPageMap, 0x1000)) { goto fail; }
     }
+    vmmprintfv("MemProcFS: Memory mapped raw memory dump file '%s'.\n", szFile);
+    return TRUE;
+fail:
+    VmmFileMap_Close();
+    return FALSE;
 }
 
-VOID VmmWriteScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_ PPMEM_SCATTER ppMEMsVirt, _In_ DWORD cpMEMsVirt)
+/*
+* Serve a physical scatter read from the memory mapped view of a raw memory
+* dump file. Reads beyond the end of the file will fail. Pages faulting with
+* an in-page error are read through leechcore instead.
+* -- ppMEMsPhys
+* -- cpMEMsPhys
+* -- flags
+*/
+VOID VmmReadScatterPhysical_FileMap(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsPhys, _In_ QWORD flags)
 {
-    DWORD i;
-    QWORD qwPA_PTE = 0, qwPagedPA = 0;
+    DWORD i, cFallback = 0;
     PMEM_SCATTER pMEM;
-    for(i = 0; i < cpMEMsVirt; i++) {
-        pMEM = ppMEMsVirt[i];
-        MEM_SCATTER_STACK_PUSH(pMEM, pMEM->qwA);
-        if(pMEM->f || (pMEM->qwA == -1)) {
-            pMEM->qwA = -1;
+    // 1: copy from mapped view - in-page errors are left for the fallback.
+    for(i = 0; i < cpMEMsPhys; i++) {
+        pMEM = ppMEMsPhys[i];
+        if(pMEM->f) {
+            MEM_SCATTER_STACK_PUSH(pMEM, 1);
             continue;
         }
-        if(VmmVirt2Phys(pProcess, pMEM->qwA, &qwPA_PTE)) {
-            pMEM->qwA = qwPA_PTE;
-            continue;
+        MEM_SCATTER_STACK_PUSH(pMEM, 0);
+        if(MEM_SCATTER_ADDR_ISVALID(pMEM) && (pMEM->qwA + pMEM->cb <= ctxMain->filemap.cb)) {
+            if(VmmFileMap_Copy(pMEM->pb, pMEM->qwA, pMEM->cb)) {
+                pMEM->f = TRUE;
+            } else {
+                cFallback++;
+            }
         }
-        // paged "read" also translate virtual -> physical for some
-        // types of paged memory such as transition and prototype.
-        ctxVmm->fnMemoryModel.pfnPagedRead(pProcess, pMEM->qwA, qwPA_PTE, NULL, &qwPagedPA, 0);
-        pMEM->qwA = qwPagedPA ? qwPagedPA : -1;
     }
-    VmmWriteScatterPhysical(ppMEMsVirt, cpMEMsVirt);
-    for(i = 0; i < cpMEMsVirt; i++) {
-        ppMEMsVirt[i]->qwA = MEM_SCATTER_STACK_POP(ppMEMsVirt[i]);
+    // 2: fallback read through leechcore (already completed MEMs are skipped).
+    if(cFallback) {
+        LcReadScatter(ctxMain->hLC, cpMEMsPhys, ppMEMsPhys);
+    }
+    // 3: statistics & zero pad
+    for(i = 0; i < cpMEMsPhys; i++) {
+        pMEM = ppMEMsPhys[i];
+        if(MEM_SCATTER_STACK_POP(pMEM)) { continue; }
+        if(pMEM->f) {
+            InterlockedIncrement64(&ctxVmm->stat.cPhysReadSuccess);
+        } else {
+            InterlockedIncrement64(&ctxVmm->stat.cPhysReadFail);
+            if((flags & VMM_FLAG_ZEROPAD_ON_FAIL) && (pMEM->qwA < ctxMain->dev.paMax)) {
+                ZeroMemory(pMEM->pb, pMEM->cb);
+                pMEM->f = TRUE;
+            }
+        }
     }
 }
 
 VOID VmmReadScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsPhys, _In_ QWORD flags)
 {
-    QWORD tp;   // 0 = normal, 1 = already read, 2 = cache hit, 3 = speculative read
-    BOOL fCache;
+    QWORD tp;   // 1 = normal read, 2 = cache hit, 3 = already read, 4 = read-ahead, 6 = normal read (in-flight owner)
+    BOOL fCache, fInFlight;
     PMEM_SCATTER pMEM;
-    DWORD i, c, cSpeculative;
+    QWORD qwA, qwStride = 0x1000;
+    DWORD i, c = 0, cAhead = 0, cpMEMsPhysRequest = cpMEMsPhys;
     PVMMOB_MEM pObCacheEntry, pObReservedMEM;
-    PMEM_SCATTER ppMEMsSpeculative[0x18];
-    PVMMOB_MEM ppObCacheSpeculative[0x18];
+    PBYTE pbBufferLarge = NULL;
+    PPMEM_SCATTER ppMEMsAhead = NULL;
+    PPVMMOB_MEM ppObCacheAhead = NULL;
+    PMEM_SCATTER ppMEMsAheadSmall[0x40];
+    PVMMOB_MEM ppObCacheAheadSmall[0x40];
+    if(ctxMain->filemap.pb) {
+        VmmReadScatterPhysical_FileMap(ppMEMsPhys, cpMEMsPhys, flags);
+        return;
+    }
     fCache = !(VMM_FLAG_NOCACHE & (flags | ctxVmm->flags));
+    fInFlight = fCache && !((VMM_FLAG_NOCACHEPUT | VMM_FLAG_FORCECACHE_READ) & flags);
     // 1: cache read
     if(fCache) {
-        c = 0, cSpeculative = 0;
         for(i = 0; i < cpMEMsPhys; i++) {
             pMEM = ppMEMsPhys[i];
             if(pMEM->f) {
@@ -1561,16 +3716,51 @@ VOID VmmReadScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsP
                 MEM_SCATTER_STACK_PUSH(pMEM, 2);    // 2: cache read
                 pMEM->f = TRUE;
                 memcpy(pMEM->pb, pObCacheEntry->pb, 0x1000);
+                if(pObCacheEntry->fReadAhead) {
+                    pObCacheEntry->fReadAhead = FALSE;
+                    InterlockedIncrement64(&ctxVmm->stat.cPhysReadAheadHit);
+                }
                 Ob_DECREF(pObCacheEntry);
                 InterlockedIncrement64(&ctxVmm->stat.cPhysCacheHit);
                 c++;
                 continue;
             }
+            // retrieve from compressed cache tier (if found)
+            if((pMEM->cb == 0x1000) && !(VMM_FLAG_NOCACHEPUT & flags) && VmmCacheCompress_Promote(pMEM)) {
+                MEM_SCATTER_STACK_PUSH(pMEM, 2);    // 2: cache read
+                InterlockedIncrement64(&ctxVmm->stat.cPhysCacheHit);
+                c++;
+                continue;
+            }
             MEM_SCATTER_STACK_PUSH(pMEM, 1);        // 1: normal read
-            // add to potential speculative read map if read is small enough...
-            if(cSpeculative < 0x18) {
-                ppMEMsSpeculative[cSpeculative++] = pMEM;
+        }
+        // in-flight deduplication: wait for pages currently being read by
+        // other threads and retrieve them from the cache once completed. Any
+        // waiting must take place before pages are claimed to avoid deadlock.
+        if(fInFlight && (c < cpMEMsPhys)) {
+            for(i = 0; i < cpMEMsPhys; i++) {
+                pMEM = ppMEMsPhys[i];
+                if((MEM_SCATTER_STACK_PEEK(pMEM, 1) != 1) || (pMEM->cb != 0x1000) || MEM_SCATTER_ADDR_ISINVALID(pMEM)) { continue; }
+                if(VmmInFlight_Wait(pMEM->qwA) && (pObCacheEntry = VmmCacheGet(VMM_CACHE_TAG_PHYS, pMEM->qwA))) {
+                    MEM_SCATTER_STACK_SET(pMEM, 1, 2);  // 2: cache read
+                    pMEM->f = TRUE;
+                    memcpy(pMEM->pb, pObCacheEntry->pb, 0x1000);
+                    Ob_DECREF(pObCacheEntry);
+                    InterlockedIncrement64(&ctxVmm->stat.cPhysCacheHit);
+                    InterlockedIncrement64(&ctxVmm->stat.cPhysReadInFlightWait);
+                    c++;
+                }
             }
+            for(i = 0; i < cpMEMsPhys; i++) {
+                pMEM = ppMEMsPhys[i];
+                if((MEM_SCATTER_STACK_PEEK(pMEM, 1) != 1) || (pMEM->cb != 0x1000) || MEM_SCATTER_ADDR_ISINVALID(pMEM)) { continue; }
+                if(VMM_INFLIGHT_CLAIM_OWNER == VmmInFlight_Claim(pMEM->qwA)) {
+                    MEM_SCATTER_STACK_SET(pMEM, 1, 6);  // 6: normal read (in-flight owner)
+                }
+            }
+        }
+        if(cpMEMsPhys && ctxVmm->ReadAhead.cPagesMax) {
+            cAhead = VmmReadAhead_Update(ppMEMsPhys[0]->qwA, ppMEMsPhys[cpMEMsPhys - 1]->qwA, &qwStride);
         }
         // all found in cache _OR_ only cached reads allowed -> restore mem stack and return!
         if((c == cpMEMsPhys) || (VMM_FLAG_FORCECACHE_READ & flags)) {
@@ -1580,28 +3770,41 @@ VOID VmmReadScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsP
             return;
         }
     }
-    // 2: speculative future read if negligible performance loss
-    if(fCache && cSpeculative && (cSpeculative < 0x18)) {
-        for(i = 0; i < cpMEMsPhys; i++) {
-            pMEM = ppMEMsPhys[i];
-            if(1 != MEM_SCATTER_STACK_PEEK(pMEM, 1)) {
-                MEM_SCATTER_STACK_POP(pMEM);
-            }
+    // 2: adaptive read-ahead of pages following the read into the cache.
+    //    read-ahead pages are appended to the request and read in one go.
+    if(fCache && cAhead && !(VMM_FLAG_NOCACHEPUT & flags)) {
+        if(cpMEMsPhys + cAhead <= 0x40) {
+            ppMEMsAhead = ppMEMsAheadSmall;
+            ppObCacheAhead = ppObCacheAheadSmall;
+        } else {
+            if(!(pbBufferLarge = LocalAlloc(0, (cpMEMsPhys + cAhead) * (sizeof(PMEM_SCATTER) + sizeof(PVMMOB_MEM))))) { goto read; }
+            ppMEMsAhead = (PPMEM_SCATTER)pbBufferLarge;
+            ppObCacheAhead = (PPVMMOB_MEM)(pbBufferLarge + (cpMEMsPhys + cAhead) * sizeof(PMEM_SCATTER));
         }
-        while(cSpeculative < 0x18) {
-            if((ppObCacheSpeculative[cSpeculative] = VmmCacheReserve(VMM_CACHE_TAG_PHYS))) {
-                pMEM = ppMEMsSpeculative[cSpeculative] = &ppObCacheSpeculative[cSpeculative]->h;
-                MEM_SCATTER_STACK_PUSH(pMEM, 4);
-                pMEM->f = FALSE;
-                pMEM->qwA = ((QWORD)ppMEMsSpeculative[cSpeculative - 1]->qwA & ~0xfff) + 0x1000;
-                cSpeculative++;
+        memcpy(ppMEMsAhead, ppMEMsPhys, cpMEMsPhys * sizeof(PMEM_SCATTER));
+        qwA = ppMEMsPhys[cpMEMsPhys - 1]->qwA & ~0xfff;
+        for(i = 0; i < cAhead; i++) {
+            qwA += qwStride;
+            if(qwA >= ctxMain->dev.paMax) { break; }
+            if(VmmCacheExists(VMM_CACHE_TAG_PHYS, qwA)) { continue; }
+            if(VMM_INFLIGHT_CLAIM_OWNER != VmmInFlight_Claim(qwA)) { continue; }
+            if(!(pObReservedMEM = VmmCacheReserve(VMM_CACHE_TAG_PHYS))) {
+                VmmInFlight_Release(qwA);
+                break;
             }
+            ppObCacheAhead[cpMEMsPhys] = pObReservedMEM;
+            pMEM = ppMEMsAhead[cpMEMsPhys] = &pObReservedMEM->h;
+            MEM_SCATTER_STACK_PUSH(pMEM, 4);
+            pMEM->f = FALSE;
+            pMEM->qwA = qwA;
+            cpMEMsPhys++;
         }
-        ppMEMsPhys = ppMEMsSpeculative;
-        cpMEMsPhys = cSpeculative;
+        InterlockedAdd64(&ctxVmm->stat.cPhysReadAhead, cpMEMsPhys - cpMEMsPhysRequest);
+        ppMEMsPhys = ppMEMsAhead;
     }
+read:
     // 3: read!
-    LcReadScatter(ctxMain->hLC, cpMEMsPhys, ppMEMsPhys);
+    VmmDeviceReadScatter(cpMEMsPhys, ppMEMsPhys, flags);
     // 4: statistics and read fail zero fixups (if required)
     for(i = 0; i < cpMEMsPhys; i++) {
         pMEM = ppMEMsPhys[i];
@@ -1611,7 +3814,7 @@ VOID VmmReadScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsP
         } else {
             // fail
             InterlockedIncrement64(&ctxVmm->stat.cPhysReadFail);
-            if((flags & VMM_FLAG_ZEROPAD_ON_FAIL) && (pMEM->qwA < ctxMain->dev.paMax)) {
+            if((flags & VMM_FLAG_ZEROPAD_ON_FAIL) && (pMEM->qwA < ctxMain->dev.paMax) && (i < cpMEMsPhysRequest)) {
                 ZeroMemory(pMEM->pb, pMEM->cb);
                 pMEM->f = TRUE;
             }
@@ -1622,11 +3825,14 @@ VOID VmmReadScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsP
         for(i = 0; i < cpMEMsPhys; i++) {
             pMEM = ppMEMsPhys[i];
             tp = MEM_SCATTER_STACK_POP(pMEM);
+            if(tp == 4) {   // 4 == read-ahead & backed by cache reserved
+                ppObCacheAhead[i]->fReadAhead = pMEM->f;
+                VmmCacheReserveReturn(ppObCacheAhead[i]);
+                VmmInFlight_Release(pMEM->qwA);
+                continue;
+            }
             if(!(VMM_FLAG_NOCACHEPUT & flags)) {
-                if(tp == 4) {   // 4 == speculative & backed by cache reserved
-                    VmmCacheReserveReturn(ppObCacheSpeculative[i]);
-                }
-                if((tp == 1) && pMEM->f) { // 1 = normal read
+                if(((tp == 1) || (tp == 6)) && pMEM->f) { // 1/6 = normal read
                     if((pObReservedMEM = VmmCacheReserve(VMM_CACHE_TAG_PHYS))) {
                         pObReservedMEM->h.f = TRUE;
                         pObReservedMEM->h.qwA = pMEM->qwA;
@@ -1635,10 +3841,247 @@ VOID VmmReadScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsP
                     }
                 }
             }
+            if(tp == 6) {
+                VmmInFlight_Release(pMEM->qwA);
+            }
+        }
+    }
+    LocalFree(pbBufferLarge);
+}
+
+// ----------------------------------------------------------------------------
+// PER-PROCESS SOFTWARE TLB:
+// Recent virtual to physical page translations of a process are remembered so
+// that repeated reads of the same structures don't walk the page tables. All
+// entries are invalidated by bumping ctxVmm->dwSoftTlbGeneration whenever the
+// TLB (page table) cache is cleared or cache entries are invalidated.
+// ----------------------------------------------------------------------------
+
+/*
+* Retrieve a translation from the per-process software TLB.
+* -- pProcess
+* -- va
+* -- ppa
+* -- return
+*/
+_Success_(return)
+BOOL VmmSoftTlb_Get(_In_ PVMM_PROCESS pProcess, _In_ QWORD va, _Out_ PQWORD ppa)
+{
+    LONG dwSeq;
+    DWORD dwGeneration;
+    QWORD vaEntry, paEntry;
+    PVMM_SOFTTLB_ENTRY pe = &pProcess->SoftTlb[(va >> 12) % VMM_SOFTTLB_ENTRIES];
+    dwSeq = pe->dwSeq;
+    if(dwSeq & 1) { return FALSE; }
+    MemoryBarrier();
+    vaEntry = pe->va;
+    paEntry = pe->pa;
+    dwGeneration = pe->dwGeneration;
+    MemoryBarrier();
+    if((dwSeq != pe->dwSeq) || (dwGeneration != ctxVmm->dwSoftTlbGeneration) || (vaEntry != (va & ~0xfff))) { return FALSE; }
+    *ppa = paEntry | (va & 0xfff);
+    return TRUE;
+}
+
+/*
+* Insert a translation into the per-process software TLB. The insert is skipped
+* if another thread is currently updating the same entry.
+* -- pProcess
+* -- dwGeneration = TLB generation sampled before the page table walk.
+* -- va
+* -- pa
+*/
+VOID VmmSoftTlb_Put(_In_ PVMM_PROCESS pProcess, _In_ DWORD dwGeneration, _In_ QWORD va, _In_ QWORD pa)
+{
+    LONG dwSeq;
+    PVMM_SOFTTLB_ENTRY pe = &pProcess->SoftTlb[(va >> 12) % VMM_SOFTTLB_ENTRIES];
+    dwSeq = pe->dwSeq;
+    if((dwSeq & 1) || (dwSeq != InterlockedCompareExchange(&pe->dwSeq, dwSeq + 1, dwSeq))) { return; }
+    pe->va = va & ~0xfff;
+    pe->pa = pa & ~0xfff;
+    pe->dwGeneration = dwGeneration;
+    InterlockedExchange(&pe->dwSeq, dwSeq + 2);
+}
+
+// ----------------------------------------------------------------------------
+// PAGE DIGEST FUNCTIONALITY BELOW:
+// Opt-in per-process tracking of a compact hash of each successfully read
+// page. Digests are computed on data already read by VmmReadScatterVirtual
+// and re-computed on every such read - also on reads bypassing the cache. The
+// generation is bumped whenever a tracked page is seen with a new digest, on
+// each memory write and on each physical memory or tlb cache clear.
+// ----------------------------------------------------------------------------
+
+VOID VmmPageDigest_CloseObCallback(_In_ PVOID pVmmOb)
+{
+    LocalFree(((PVMMOB_PAGEDIGEST)pVmmOb)->pe);
+}
+
+/*
+* Calculate the 32-bit digest of a 4kB page.
+*/
+DWORD VmmPageDigest_Hash(_In_reads_(0x1000) PBYTE pb)
+{
+    DWORD i;
+    QWORD h = 0xcbf29ce484222325;
+    for(i = 0; i < 0x1000; i += 8) {
+        h = (h ^ *(PQWORD)(pb + i)) * 0x100000001b3;
+    }
+    return (DWORD)(h ^ (h >> 32));
+}
+
+/*
+* Enable or disable page digest tracking for a process. Disabling discards
+* previously collected digests.
+* -- pProcess
+* -- fEnable
+* -- return
+*/
+_Success_(return)
+BOOL VmmPageDigest_Enable(_In_ PVMM_PROCESS pProcess, _In_ BOOL fEnable)
+{
+    PVMMOB_PAGEDIGEST pObDigest = NULL;
+    PVMMOB_PROCESS_PERSISTENT pPers = pProcess->pObPersistent;
+    EnterCriticalSection(&ctxVmm->LockUpdateMap);
+    pObDigest = ObContainer_GetOb(pPers->pObCPageDigest);
+    if(fEnable && !pObDigest) {
+        if((pObDigest = Ob_Alloc(OB_TAG_VMM_PAGEDIGEST, LMEM_ZEROINIT, sizeof(VMMOB_PAGEDIGEST), VmmPageDigest_CloseObCallback, NULL))) {
+            InitializeSRWLock(&pObDigest->LockSRW);
+            ObContainer_SetOb(pPers->pObCPageDigest, pObDigest);
+            InterlockedIncrement(&ctxVmm->PageDigest.cEnabled);
+        }
+    }
+    if(!fEnable && pObDigest) {
+        ObContainer_SetOb(pPers->pObCPageDigest, NULL);
+        InterlockedDecrement(&ctxVmm->PageDigest.cEnabled);
+    }
+    LeaveCriticalSection(&ctxVmm->LockUpdateMap);
+    Ob_DECREF(pObDigest);
+    return !fEnable || pObDigest;
+}
+
+/*
+* Grow the open addressing digest table. Caller must hold exclusive lock.
+*/
+_Success_(return)
+BOOL VmmPageDigest_Grow(_In_ PVMMOB_PAGEDIGEST pDigest)
+{
+    DWORD i, j, cMaxNew;
+    PVMM_PAGEDIGEST_ENTRY peNew;
+    cMaxNew = pDigest->cMax ? 2 * pDigest->cMax : VMM_PAGEDIGEST_ENTRIES_MIN;
+    if(!(peNew = LocalAlloc(LMEM_ZEROINIT, cMaxNew * sizeof(VMM_PAGEDIGEST_ENTRY)))) { return FALSE; }
+    for(i = 0; i < pDigest->cMax; i++) {
+        if(!pDigest->pe[i].va) { continue; }
+        j = (DWORD)((pDigest->pe[i].va >> 12) * 0x9E3779B97F4A7C15 >> 32) & (cMaxNew - 1);
+        while(peNew[j].va) { j = (j + 1) & (cMaxNew - 1); }
+        peNew[j] = pDigest->pe[i];
+    }
+    LocalFree(pDigest->pe);
+    pDigest->pe = peNew;
+    pDigest->cMax = cMaxNew;
+    return TRUE;
+}
+
+/*
+* Update page digests from successfully completed page-sized reads.
+* -- pProcess
+* -- ppMEMs
+* -- cpMEMs
+*/
+VOID VmmPageDigest_Update(_In_ PVMM_PROCESS pProcess, _In_reads_(cpMEMs) PPMEM_SCATTER ppMEMs, _In_ DWORD cpMEMs)
+{
+    DWORD i, j, dwDigest;
+    QWORD qwGeneration = 0;
+    PMEM_SCATTER pMEM;
+    PVMMOB_PAGEDIGEST pObDigest;
+    if(!pProcess->pObPersistent->pObCPageDigest->pOb) { return; }  // fast path (racy but benign)
+    if(!(pObDigest = ObContainer_GetOb(pProcess->pObPersistent->pObCPageDigest))) { return; }
+    AcquireSRWLockExclusive(&pObDigest->LockSRW);
+    for(i = 0; i < cpMEMs; i++) {
+        pMEM = ppMEMs[i];
+        if(!pMEM->f || (pMEM->cb != 0x1000) || (pMEM->qwA & 0xfff) || !pMEM->qwA) { continue; }
+        // grow table if required - when saturated existing pages are still
+        // updated but no new pages are added.
+        if((2 * (pObDigest->c + 1) > pObDigest->cMax) && (pObDigest->c < VMM_PAGEDIGEST_ENTRIES_MAX)) {
+            VmmPageDigest_Grow(pObDigest);
+        }
+        if(!pObDigest->cMax) { break; }
+        dwDigest = VmmPageDigest_Hash(pMEM->pb);
+        j = (DWORD)((pMEM->qwA >> 12) * 0x9E3779B97F4A7C15 >> 32) & (pObDigest->cMax - 1);
+        while(pObDigest->pe[j].va && (pObDigest->pe[j].va != pMEM->qwA)) { j = (j + 1) & (pObDigest->cMax - 1); }
+        if(!pObDigest->pe[j].va) {
+            if(2 * (pObDigest->c + 1) > pObDigest->cMax) { continue; }
+            pObDigest->pe[j].va = pMEM->qwA;
+            pObDigest->c++;
+        } else if(pObDigest->pe[j].dwDigest == dwDigest) {
+            continue;
+        }
+        // new or changed page - stamp it with a fresh generation so that it's
+        // reported to callers holding the previously returned generation.
+        if(!qwGeneration) {
+            qwGeneration = (QWORD)InterlockedIncrement64(&ctxVmm->PageDigest.qwGeneration);
+        }
+        pObDigest->pe[j].dwDigest = dwDigest;
+        pObDigest->pe[j].qwGeneration = qwGeneration;
+    }
+    ReleaseSRWLockExclusive(&pObDigest->LockSRW);
+    Ob_DECREF(pObDigest);
+}
+
+/*
+* Retrieve the pages which have changed (or been seen for the first time)
+* after a given generation. Pages are only tracked once read - callers
+* should re-read the regions of interest before calling this function.
+* -- pProcess
+* -- qwGenerationSince = generation previously returned in pqwGeneration (0 = all).
+* -- pqwGeneration = receives the current generation.
+* -- pva = buffer to receive page addresses, or NULL to retrieve count only.
+* -- pcva = in: # entries in pva, out: # pages changed (or required entries if pva is NULL).
+* -- return
+*/
+_Success_(return)
+BOOL VmmPageDigest_GetChanged(_In_ PVMM_PROCESS pProcess, _In_ QWORD qwGenerationSince, _Out_ PQWORD pqwGeneration, _Out_writes_opt_(*pcva) PQWORD pva, _Inout_ PDWORD pcva)
+{
+    BOOL fResult = TRUE;
+    DWORD i, c = 0;
+    QWORD qwGenerationMax = (QWORD)-1;
+    PVMMOB_PAGEDIGEST pObDigest;
+    PVMMOB_SNAPSHOT pObSnapshot;
+    *pqwGeneration = (QWORD)ctxVmm->PageDigest.qwGeneration;
+    if(!(pObDigest = ObContainer_GetOb(pProcess->pObPersistent->pObCPageDigest))) { return FALSE; }
+    // active snapshot -> only report changes up until the pinned generation.
+    if((pObSnapshot = VmmSnapshotGetActive())) {
+        qwGenerationMax = pObSnapshot->qwPageDigestGeneration;
+        Ob_DECREF_NULL(&pObSnapshot);
+    }
+    AcquireSRWLockShared(&pObDigest->LockSRW);
+    // generations are handed out under the exclusive lock by updates - read
+    // it under the lock to not miss pages stamped after the returned value.
+    *pqwGeneration = min(qwGenerationMax, (QWORD)ctxVmm->PageDigest.qwGeneration);
+    for(i = 0; i < pObDigest->cMax; i++) {
+        if(!pObDigest->pe[i].va || (pObDigest->pe[i].qwGeneration <= qwGenerationSince) || (pObDigest->pe[i].qwGeneration > qwGenerationMax)) { continue; }
+        if(pva) {
+            if(c >= *pcva) { fResult = FALSE; break; }
+            pva[c] = pObDigest->pe[i].va;
         }
+        c++;
+    }
+    ReleaseSRWLockShared(&pObDigest->LockSRW);
+    Ob_DECREF(pObDigest);
+    if(!fResult) {
+        *pcva = 0;
+        return FALSE;
     }
+    *pcva = c;
+    if(pva) {
+        qsort(pva, c, sizeof(QWORD), Util_qsort_QWORD);
+    }
+    return TRUE;
 }
 
+#define VMM_VIRT2PHYS_PREFETCH_THRESHOLD    0x10
+#define VMM_PAGING_BATCH_THRESHOLD          0x10
+
 VOID VmmReadScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_updates_(cpMEMsVirt) PPMEM_SCATTER ppMEMsVirt, _In_ DWORD cpMEMsVirt, _In_ QWORD flags)
 {
     // NB! the buffers pIoPA / ppMEMsPhys are used for both:
@@ -1646,11 +4089,14 @@ VOID VmmReadScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_updates_(cpMEMsVir
     //     - paged memory (grows from top downwards).
     BOOL fVirt2Phys;
     DWORD i = 0, iVA, iPA;
-    QWORD qwPA, qwPagedPA = 0;
+    QWORD qwPA, qwPagedPA = 0, cbPage;
+    QWORD vaLargePage = 0, paLargePage = 0, cbLargePage = 0, cLargePage = 0, cSoftTlbHit = 0;
+    DWORD dwSoftTlbGeneration = ctxVmm->dwSoftTlbGeneration;
     BYTE pbBufferSmall[0x20 * (sizeof(MEM_SCATTER) + sizeof(PMEM_SCATTER))];
     PBYTE pbBufferMEMs, pbBufferLarge = NULL;
     PMEM_SCATTER pIoPA, pIoVA;
     PPMEM_SCATTER ppMEMsPhys = NULL;
+    PVMM_PAGING_BATCH pPagingBatch = NULL;
     BOOL fPaging = !(VMM_FLAG_NOPAGING & (flags | ctxVmm->flags));
     BOOL fAltAddrPte = VMM_FLAG_ALTADDR_VA_PTE & flags;
     BOOL fZeropadOnFail = VMM_FLAG_ZEROPAD_ON_FAIL & (flags | ctxVmm->flags);
@@ -1664,7 +4110,18 @@ VOID VmmReadScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_updates_(cpMEMsVir
         ppMEMsPhys = (PPMEM_SCATTER)pbBufferLarge;
         pbBufferMEMs = pbBufferLarge + cpMEMsVirt * sizeof(PMEM_SCATTER);
     }
-    // 2: translate virt2phys
+    if(fPaging && (cpMEMsVirt >= VMM_PAGING_BATCH_THRESHOLD) && ctxVmm->fnMemoryModel.pfnPagedReadBatch && !(VMM_FLAG_NOPAGING_IO & flags)) {
+        if((pPagingBatch = LocalAlloc(0, sizeof(VMM_PAGING_BATCH) + cpMEMsVirt * sizeof(VMM_PAGING_BATCH_ENTRY)))) {
+            pPagingBatch->c = 0;
+            pPagingBatch->cMax = cpMEMsVirt;
+            pPagingBatch->pMEMCurrent = NULL;
+        }
+    }
+    // 2: translate virt2phys - larger reads prefetch required page tables in
+    //    batch first to avoid reading missing page tables one at a time.
+    if((cpMEMsVirt >= VMM_VIRT2PHYS_PREFETCH_THRESHOLD) && !fAltAddrPte && ctxVmm->fnMemoryModel.pfnVirt2PhysPrefetch) {
+        ctxVmm->fnMemoryModel.pfnVirt2PhysPrefetch(pProcess, cpMEMsVirt, ppMEMsVirt);
+    }
     for(iVA = 0, iPA = 0; iVA < cpMEMsVirt; iVA++) {
         pIoVA = ppMEMsVirt[iVA];
         // MEMORY READ ALREADY COMPLETED
@@ -1675,11 +4132,30 @@ VOID VmmReadScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_updates_(cpMEMsVir
             continue;
         }
         // PHYSICAL MEMORY
-        qwPA = 0;
-        fVirt2Phys = !fAltAddrPte && VmmVirt2Phys(pProcess, pIoVA->qwA, &qwPA);
+        if(cbLargePage && (pIoVA->qwA - vaLargePage < cbLargePage)) {
+            // within previously translated large page - no page table walk.
+            qwPA = paLargePage + (pIoVA->qwA - vaLargePage);
+            fVirt2Phys = TRUE;
+            cLargePage++;
+        } else if(!fAltAddrPte && VmmSoftTlb_Get(pProcess, pIoVA->qwA, &qwPA)) {
+            fVirt2Phys = TRUE;
+            cSoftTlbHit++;
+        } else {
+            qwPA = 0;
+            fVirt2Phys = !fAltAddrPte && VmmVirt2PhysPage(pProcess, pIoVA->qwA, &qwPA, &cbPage);
+            if(fVirt2Phys) {
+                VmmSoftTlb_Put(pProcess, dwSoftTlbGeneration, pIoVA->qwA, qwPA);
+                if(cbPage > 0x1000) {
+                    vaLargePage = pIoVA->qwA & ~(cbPage - 1);
+                    paLargePage = (qwPA & ~0xfff) - ((pIoVA->qwA & (cbPage - 1)) & ~0xfff);
+                    cbLargePage = cbPage;
+                }
+            }
+        }
         // PAGED MEMORY
         if(!fVirt2Phys && fPaging && (pIoVA->cb == 0x1000) && ctxVmm->fnMemoryModel.pfnPagedRead) {
-            if(ctxVmm->fnMemoryModel.pfnPagedRead(pProcess, (fAltAddrPte ? 0 : pIoVA->qwA), (fAltAddrPte ? pIoVA->qwA : qwPA), pIoVA->pb, &qwPagedPA, flags)) {
+            if(pPagingBatch) { pPagingBatch->pMEMCurrent = pIoVA; }
+            if(ctxVmm->fnMemoryModel.pfnPagedRead(pProcess, (fAltAddrPte ? 0 : pIoVA->qwA), (fAltAddrPte ? pIoVA->qwA : qwPA), pIoVA->pb, &qwPagedPA, pPagingBatch, flags)) {
                 continue;
             }
             if(qwPagedPA) {
@@ -1703,6 +4179,12 @@ VOID VmmReadScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_updates_(cpMEMsVir
         pIoPA->f = FALSE;
         MEM_SCATTER_STACK_PUSH(pIoPA, (QWORD)pIoVA);
     }
+    if(cLargePage) {
+        InterlockedAdd64(&ctxVmm->stat.cVirt2PhysLargePage, cLargePage);
+    }
+    if(cSoftTlbHit) {
+        InterlockedAdd64(&ctxVmm->stat.cVirt2PhysSoftTlbHit, cSoftTlbHit);
+    }
     // 3: read and check result
     if(iPA) {
         VmmReadScatterPhysical(ppMEMsPhys, iPA, flags);
@@ -1711,6 +4193,23 @@ VOID VmmReadScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_updates_(cpMEMsVir
             ((PMEM_SCATTER)MEM_SCATTER_STACK_POP(ppMEMsPhys[iPA]))->f = ppMEMsPhys[iPA]->f;
         }
     }
+    // 4: complete deferred page file reads
+    if(pPagingBatch && pPagingBatch->c) {
+        for(i = 0; i < pPagingBatch->c; i++) {
+            pPagingBatch->e[i].pMEM->f = FALSE;
+        }
+        ctxVmm->fnMemoryModel.pfnPagedReadBatch(pPagingBatch);
+        for(i = 0; i < pPagingBatch->c; i++) {
+            if(!pPagingBatch->e[i].pMEM->f && fZeropadOnFail) {
+                ZeroMemory(pPagingBatch->e[i].pbPage, 0x1000);
+            }
+        }
+    }
+    // 5: update page digests (if enabled)
+    if(ctxVmm->PageDigest.cEnabled && !fAltAddrPte) {
+        VmmPageDigest_Update(pProcess, ppMEMsVirt, cpMEMsVirt);
+    }
+    LocalFree(pPagingBatch);
     LocalFree(pbBufferLarge);
 }
 
@@ -1729,6 +4228,9 @@ VOID VmmReadScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_updates_(cpMEMsVir
 */
 PVMMOB_PHYS2VIRT_INFORMATION VmmPhys2VirtGetInformation(_In_ PVMM_PROCESS pProcess, _In_ QWORD paTarget)
 {
+    DWORD i, c;
+    PVMM_PHYS2VIRT_INDEX_ENTRY pe;
+    PVMMOB_PHYS2VIRT_INDEX pObIndex = NULL;
     PVMMOB_PHYS2VIRT_INFORMATION pObP2V = NULL;
     if(paTarget) {
         pProcess->pObPersistent->Plugin.paPhys2Virt = paTarget;
@@ -1738,6 +4240,7 @@ PVMMOB_PHYS2VIRT_INFORMATION VmmPhys2VirtGetInformation(_In_ PVMM_PROCESS pProce
     pObP2V = ObContainer_GetOb(pProcess->Plugin.pObCPhys2Virt);
     if(paTarget && (!pObP2V || (pObP2V->paTarget != paTarget))) {
         Ob_DECREF_NULL(&pObP2V);
+        pObIndex = VmmPhys2VirtIndex_Get();     // NB! retrieve before process lock - index update locks all processes.
         EnterCriticalSection(&pProcess->LockUpdate);
         pObP2V = ObContainer_GetOb(pProcess->Plugin.pObCPhys2Virt);
         if(paTarget && (!pObP2V || (pObP2V->paTarget != paTarget))) {
@@ -1745,12 +4248,21 @@ PVMMOB_PHYS2VIRT_INFORMATION VmmPhys2VirtGetInformation(_In_ PVMM_PROCESS pProce
             pObP2V = Ob_Alloc('PAVA', LMEM_ZEROINIT, sizeof(VMMOB_PHYS2VIRT_INFORMATION), NULL, NULL);
             pObP2V->paTarget = paTarget;
             pObP2V->dwPID = pProcess->dwPID;
-            if(ctxVmm->fnMemoryModel.pfnPhys2VirtGetInformation) {
+            if(pObIndex) {
+                c = VmmPhys2VirtIndex_Lookup(pObIndex, paTarget, &pe);
+                for(i = 0; (i < c) && (pObP2V->cvaList < VMM_PHYS2VIRT_INFORMATION_MAX_PROCESS_RESULT); i++) {
+                    if(pe[i].dwPID == pProcess->dwPID) {
+                        pObP2V->pvaList[pObP2V->cvaList++] = pe[i].va | (paTarget & 0xfff);
+                    }
+                }
+                ObContainer_SetOb(pProcess->Plugin.pObCPhys2Virt, pObP2V);
+            } else if(ctxVmm->fnMemoryModel.pfnPhys2VirtGetInformation) {
                 ctxVmm->fnMemoryModel.pfnPhys2VirtGetInformation(pProcess, pObP2V);
                 ObContainer_SetOb(pProcess->Plugin.pObCPhys2Virt, pObP2V);
             }
         }
         LeaveCriticalSection(&pProcess->LockUpdate);
+        Ob_DECREF_NULL(&pObIndex);
     }
     if(!pObP2V) {
         EnterCriticalSection(&pProcess->LockUpdate);
@@ -1765,17 +4277,211 @@ PVMMOB_PHYS2VIRT_INFORMATION VmmPhys2VirtGetInformation(_In_ PVMM_PROCESS pProce
     return pObP2V;
 }
 
+// ----------------------------------------------------------------------------
+// PHYSICAL TO VIRTUAL REVERSE INDEX FUNCTIONALITY BELOW:
+// The index is built from the PTE maps of all active processes. Per-process
+// entries are kept between index updates and are only rebuilt if the process
+// PTE map object changed.
+// ----------------------------------------------------------------------------
+
+VOID VmmPhys2VirtIndex_Process_CloseObCallback(_In_ PVOID pOb)
+{
+    Ob_DECREF(((PVMMOB_PHYS2VIRT_INDEX_PROCESS)pOb)->pObMapPte);
+}
+
+VOID VmmPhys2VirtIndex_CloseObCallback(_In_ PVOID pOb)
+{
+    LocalFree(((PVMMOB_PHYS2VIRT_INDEX)pOb)->piBucket);
+}
+
+int VmmPhys2VirtIndex_CmpSort(PVMM_PHYS2VIRT_INDEX_ENTRY a, PVMM_PHYS2VIRT_INDEX_ENTRY b)
+{
+    if(a->dwPFN != b->dwPFN) { return (a->dwPFN < b->dwPFN) ? -1 : 1; }
+    if(a->dwPID != b->dwPID) { return (a->dwPID < b->dwPID) ? -1 : 1; }
+    return (a->va < b->va) ? -1 : ((a->va > b->va) ? 1 : 0);
+}
+
+/*
+* Create the index entries of a single process by translating all pages in
+* its PTE map. Large pages are translated once.
+* CALLER DECREF: return
+* -- pProcess
+* -- pObPteMap
+* -- return
+*/
+PVMMOB_PHYS2VIRT_INDEX_PROCESS VmmPhys2VirtIndex_ProcessCreate(_In_ PVMM_PROCESS pProcess, _In_ PVMMOB_MAP_PTE pObPteMap)
+{
+    DWORD i, cMax = 0;
+    QWORD pa, va, vaEnd, vaPageEnd, cbPage, paMax = ctxMain->dev.paMax;
+    PVMM_MAP_PTEENTRY pePte;
+    PVMM_PHYS2VIRT_INDEX_ENTRY pe;
+    PVMMOB_PHYS2VIRT_INDEX_PROCESS pObP;
+    for(i = 0; i < pObPteMap->cMap; i++) {
+        cMax += (DWORD)pObPteMap->pMap[i].cPages;
+    }
+    pObP = Ob_Alloc(OB_TAG_VMM_PHYS2VIRT_PROCESS, 0, sizeof(VMMOB_PHYS2VIRT_INDEX_PROCESS) + cMax * sizeof(VMM_PHYS2VIRT_INDEX_ENTRY), VmmPhys2VirtIndex_Process_CloseObCallback, NULL);
+    if(!pObP) { return NULL; }
+    pObP->pObMapPte = Ob_INCREF(pObPteMap);
+    pObP->dwPID = pProcess->dwPID;
+    pObP->cEntry = 0;
+    for(i = 0; i < pObPteMap->cMap; i++) {
+        pePte = pObPteMap->pMap + i;
+        va = pePte->vaBase;
+        vaEnd = pePte->vaBase + (pePte->cPages << 12);
+        while(va < vaEnd) {
+            if(!VmmVirt2PhysPage(pProcess, va, &pa, &cbPage) || !cbPage) {
+                va += 0x1000;
+                continue;
+            }
+            vaPageEnd = min(vaEnd, (va & ~(cbPage - 1)) + cbPage);
+            for(; (va < vaPageEnd) && (pObP->cEntry < cMax); va += 0x1000, pa += 0x1000) {
+                if(pa > paMax) { continue; }
+                pe = pObP->e + pObP->cEntry++;
+                pe->dwPFN = (DWORD)(pa >> 12);
+                pe->dwPID = pProcess->dwPID;
+                pe->va = va;
+            }
+            va = vaPageEnd;
+        }
+    }
+    return pObP;
+}
+
+/*
+* Create a new index from the currently active processes.
+* NB! caller must hold ctxVmm->Phys2VirtIndex.Lock.
+* CALLER DECREF: return
+* -- return
+*/
+PVMMOB_PHYS2VIRT_INDEX VmmPhys2VirtIndex_Create()
+{
+    DWORD i, iBucket, c = 0;
+    PVMM_PROCESS pObProcess = NULL;
+    PVMMOB_MAP_PTE pObPteMap = NULL;
+    POB_MAP pmObProcessNew = NULL;
+    PVMMOB_PHYS2VIRT_INDEX pObIndex = NULL;
+    PVMMOB_PHYS2VIRT_INDEX_PROCESS pObP = NULL;
+    if(!(pmObProcessNew = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) { return NULL; }
+    // 1: fetch/create per-process entries
+    while((pObProcess = VmmProcessGetNext(pObProcess, 0))) {
+        if(!VmmMap_GetPte(pObProcess, &pObPteMap, FALSE)) { continue; }
+        pObP = ObMap_GetByKey(ctxVmm->Phys2VirtIndex.pmProcess, pObProcess->dwPID);
+        if(!pObP || (pObP->pObMapPte != pObPteMap)) {
+            Ob_DECREF_NULL(&pObP);
+            pObP = VmmPhys2VirtIndex_ProcessCreate(pObProcess, pObPteMap);
+        }
+        if(pObP && ObMap_Push(pmObProcessNew, pObProcess->dwPID, pObP)) {
+            c += pObP->cEntry;
+        }
+        Ob_DECREF_NULL(&pObP);
+        Ob_DECREF_NULL(&pObPteMap);
+    }
+    // 2: merge and sort entries
+    pObIndex = Ob_Alloc(OB_TAG_VMM_PHYS2VIRT_INDEX, LMEM_ZEROINIT, sizeof(VMMOB_PHYS2VIRT_INDEX) + c * sizeof(VMM_PHYS2VIRT_INDEX_ENTRY), VmmPhys2VirtIndex_CloseObCallback, NULL);
+    if(!pObIndex) { goto fail; }
+    pObIndex->tcCreateTime = GetTickCount64();
+    pObIndex->pe = (PVMM_PHYS2VIRT_INDEX_ENTRY)(pObIndex + 1);
+    for(i = 0; i < ObMap_Size(pmObProcessNew); i++) {
+        if((pObP = ObMap_GetByIndex(pmObProcessNew, i))) {
+            memcpy(pObIndex->pe + pObIndex->cEntry, pObP->e, pObP->cEntry * sizeof(VMM_PHYS2VIRT_INDEX_ENTRY));
+            pObIndex->cEntry += pObP->cEntry;
+            Ob_DECREF_NULL(&pObP);
+        }
+    }
+    qsort(pObIndex->pe, pObIndex->cEntry, sizeof(VMM_PHYS2VIRT_INDEX_ENTRY), (_CoreCrtNonSecureSearchSortCompareFunction)VmmPhys2VirtIndex_CmpSort);
+    // 3: create bucket table
+    pObIndex->cBucket = pObIndex->cEntry ? ((pObIndex->pe[pObIndex->cEntry - 1].dwPFN >> VMM_PHYS2VIRT_INDEX_BUCKET_SHIFT) + 1) : 0;
+    if(!(pObIndex->piBucket = LocalAlloc(0, (pObIndex->cBucket + 1ULL) * sizeof(DWORD)))) {
+        Ob_DECREF_NULL(&pObIndex);
+        goto fail;
+    }
+    for(i = 0, iBucket = 0; iBucket <= pObIndex->cBucket; iBucket++) {
+        while((i < pObIndex->cEntry) && ((pObIndex->pe[i].dwPFN >> VMM_PHYS2VIRT_INDEX_BUCKET_SHIFT) < iBucket)) { i++; }
+        pObIndex->piBucket[iBucket] = i;
+    }
+    // 4: keep per-process entries for next update
+    Ob_DECREF(ctxVmm->Phys2VirtIndex.pmProcess);
+    ctxVmm->Phys2VirtIndex.pmProcess = pmObProcessNew;
+    return pObIndex;
+fail:
+    Ob_DECREF(pmObProcessNew);
+    return NULL;
+}
+
+PVMMOB_PHYS2VIRT_INDEX VmmPhys2VirtIndex_Get()
+{
+    PVMMOB_PHYS2VIRT_INDEX pObIndex;
+    if(!ctxVmm->Phys2VirtIndex.fEnabled) { return NULL; }
+    pObIndex = ObContainer_GetOb(ctxVmm->Phys2VirtIndex.pObCIndex);
+    if(pObIndex && (pObIndex->tcCreateTime + VMM_PHYS2VIRT_MAX_AGE_MS > GetTickCount64())) { return pObIndex; }
+    Ob_DECREF_NULL(&pObIndex);
+    EnterCriticalSection(&ctxVmm->Phys2VirtIndex.Lock);
+    pObIndex = ObContainer_GetOb(ctxVmm->Phys2VirtIndex.pObCIndex);
+    if(ctxVmm->Phys2VirtIndex.fEnabled && (!pObIndex || (pObIndex->tcCreateTime + VMM_PHYS2VIRT_MAX_AGE_MS <= GetTickCount64()))) {
+        Ob_DECREF_NULL(&pObIndex);
+        if((pObIndex = VmmPhys2VirtIndex_Create())) {
+            ObContainer_SetOb(ctxVmm->Phys2VirtIndex.pObCIndex, pObIndex);
+        }
+    }
+    LeaveCriticalSection(&ctxVmm->Phys2VirtIndex.Lock);
+    return pObIndex;
+}
+
+DWORD VmmPhys2VirtIndex_Lookup(_In_ PVMMOB_PHYS2VIRT_INDEX pIndex, _In_ QWORD pa, _Out_ PVMM_PHYS2VIRT_INDEX_ENTRY *ppe)
+{
+    DWORD i, iEnd, c = 0, dwPFN = (DWORD)(pa >> 12), iBucket = dwPFN >> VMM_PHYS2VIRT_INDEX_BUCKET_SHIFT;
+    *ppe = NULL;
+    if((pa >> 12) > 0xffffffff) { return 0; }
+    if(iBucket >= pIndex->cBucket) { return 0; }
+    i = pIndex->piBucket[iBucket];
+    iEnd = pIndex->piBucket[iBucket + 1];
+    while((i < iEnd) && (pIndex->pe[i].dwPFN < dwPFN)) { i++; }
+    while((i + c < iEnd) && (pIndex->pe[i + c].dwPFN == dwPFN)) { c++; }
+    if(c) { *ppe = pIndex->pe + i; }
+    return c;
+}
+
+BOOL VmmPhys2VirtIndex_Configure(_In_ BOOL fEnable)
+{
+    EnterCriticalSection(&ctxVmm->Phys2VirtIndex.Lock);
+    ctxVmm->Phys2VirtIndex.fEnabled = fEnable;
+    if(!fEnable) {
+        ObContainer_SetOb(ctxVmm->Phys2VirtIndex.pObCIndex, NULL);
+        ObMap_Clear(ctxVmm->Phys2VirtIndex.pmProcess);
+    }
+    LeaveCriticalSection(&ctxVmm->Phys2VirtIndex.Lock);
+    return TRUE;
+}
+
+VOID VmmPhys2VirtIndex_Initialize()
+{
+    InitializeCriticalSection(&ctxVmm->Phys2VirtIndex.Lock);
+    ctxVmm->Phys2VirtIndex.pObCIndex = ObContainer_New(NULL);
+    ctxVmm->Phys2VirtIndex.pmProcess = ObMap_New(OB_MAP_FLAGS_OBJECT_OB);
+    ctxVmm->Phys2VirtIndex.fEnabled = ctxMain->cfg.fPhys2VirtIndex;
+}
+
+VOID VmmPhys2VirtIndex_Close()
+{
+    if(!ctxVmm->Phys2VirtIndex.pObCIndex) { return; }
+    Ob_DECREF_NULL(&ctxVmm->Phys2VirtIndex.pObCIndex);
+    Ob_DECREF_NULL(&ctxVmm->Phys2VirtIndex.pmProcess);
+    DeleteCriticalSection(&ctxVmm->Phys2VirtIndex.Lock);
+}
+
 // ----------------------------------------------------------------------------
 // PUBLICALLY VISIBLE FUNCTIONALITY RELATED TO VMMU.
 // ----------------------------------------------------------------------------
 
 VOID VmmClose()
 {
+    DWORD i;
     if(!ctxVmm) { return; }
     if(ctxVmm->PluginManager.FLink) { PluginManager_Close(); }
     VmmWork_Close();
     VmmWinObj_Close();
     VmmWinReg_Close();
+    VmmWinProfile_Close();
     PDB_Close();
     Ob_DECREF_NULL(&ctxVmm->pObVfsDumpContext);
     Ob_DECREF_NULL(&ctxVmm->pObPfnContext);
@@ -1787,13 +4493,24 @@ VOID VmmClose()
     VmmCache2Close(VMM_CACHE_TAG_PHYS);
     VmmCache2Close(VMM_CACHE_TAG_TLB);
     VmmCache2Close(VMM_CACHE_TAG_PAGING);
+    VmmCacheCompress_Close();
+    VmmPhys2VirtIndex_Close();
     Ob_DECREF_NULL(&ctxVmm->Cache.PAGING_FAILED);
     Ob_DECREF_NULL(&ctxVmm->Cache.pmPrototypePte);
+    for(i = 0; i < _countof(ctxVmm->ModuleCache.pm); i++) {
+        Ob_DECREF_NULL(&ctxVmm->ModuleCache.pm[i]);
+    }
+    MmVad_PrototypePteCache_Close();
     Ob_DECREF_NULL(&ctxVmm->pObCMapPhysMem);
     Ob_DECREF_NULL(&ctxVmm->pObCMapUser);
     Ob_DECREF_NULL(&ctxVmm->pObCMapNet);
+    Ob_DECREF_NULL(&ctxVmm->pObCMapProcTree);
+    Ob_DECREF_NULL(&ctxVmm->TcpIp.pObCTcpE);
     Ob_DECREF_NULL(&ctxVmm->pObCCachePrefetchEPROCESS);
     Ob_DECREF_NULL(&ctxVmm->pObCCachePrefetchRegistry);
+    Ob_DECREF_NULL(&ctxVmm->pObCObjectNameCache);
+    Ob_DECREF_NULL(&ctxVmm->Snapshot.pmObPinned);
+    DeleteCriticalSection(&ctxVmm->Snapshot.Lock);
     DeleteCriticalSection(&ctxVmm->TcpIp.LockUpdate);
     DeleteCriticalSection(&ctxVmm->LockMaster);
     DeleteCriticalSection(&ctxVmm->LockPlugin);
@@ -1802,6 +4519,7 @@ VOID VmmClose()
     LocalFree(ctxVmm->ObjectTypeTable.wszMultiText);
     LocalFree(ctxVmm);
     ctxVmm = NULL;
+    Ob_PoolTrim();
 }
 
 VOID VmmWriteEx(_In_opt_ PVMM_PROCESS pProcess, _In_ QWORD qwA, _In_ PBYTE pb, _In_ DWORD cb, _Out_opt_ PDWORD pcbWrite)
@@ -2025,6 +4743,34 @@ BOOL VmmReadPage(_In_opt_ PVMM_PROCESS pProcess, _In_ QWORD qwA, _Out_writes_(40
     return cb == 0x1000;
 }
 
+PVMMOB_MEM VmmReadPageOb(_In_opt_ PVMM_PROCESS pProcess, _In_ QWORD qwA, _In_ QWORD flags)
+{
+    QWORD pa;
+    PVMMOB_MEM pObMEM;
+    if((flags | ctxVmm->flags) & VMM_FLAG_NOCACHE) { return NULL; }
+    if(pProcess) {
+        if(!VmmVirt2Phys(pProcess, qwA, &pa)) { return NULL; }
+    } else {
+        pa = qwA;
+    }
+    pa &= ~0xfff;
+    if((pObMEM = VmmCacheGet(VMM_CACHE_TAG_PHYS, pa))) {
+        if(pObMEM->fReadAhead) {
+            pObMEM->fReadAhead = FALSE;
+            InterlockedIncrement64(&ctxVmm->stat.cPhysReadAheadHit);
+        }
+        InterlockedIncrement64(&ctxVmm->stat.cPhysCacheHit);
+        return pObMEM;
+    }
+    if(flags & (VMM_FLAG_FORCECACHE_READ | VMM_FLAG_NOCACHEPUT)) { return NULL; }
+    if((pObMEM = VmmCacheGet_FromDeviceOnMiss(VMM_CACHE_TAG_PHYS, 0, pa))) {
+        InterlockedIncrement64(&ctxVmm->stat.cPhysReadSuccess);
+        return pObMEM;
+    }
+    InterlockedIncrement64(&ctxVmm->stat.cPhysReadFail);
+    return NULL;
+}
+
 VOID VmmInitializeMemoryModel(_In_ VMM_MEMORYMODEL_TP tp)
 {
     switch(tp) {
@@ -2049,12 +4795,15 @@ VOID VmmInitializeFunctions()
     HMODULE hNtDll = NULL;
     if((hNtDll = LoadLibraryA("ntdll.dll"))) {
         ctxVmm->fn.RtlDecompressBuffer = (VMMFN_RtlDecompressBuffer*)GetProcAddress(hNtDll, "RtlDecompressBuffer");
+        ctxVmm->fn.RtlCompressBuffer = (VMMFN_RtlCompressBuffer*)GetProcAddress(hNtDll, "RtlCompressBuffer");
+        ctxVmm->fn.RtlGetCompressionWorkSpaceSize = (VMMFN_RtlGetCompressionWorkSpaceSize*)GetProcAddress(hNtDll, "RtlGetCompressionWorkSpaceSize");
         FreeLibrary(hNtDll);
     }
 }
 
 BOOL VmmInitialize()
 {
+    DWORD i;
     // 1: allocate & initialize
     if(ctxVmm) { VmmClose(); }
     ctxVmm = (PVMM_CONTEXT)LocalAlloc(LMEM_ZEROINIT, sizeof(VMM_CONTEXT));
@@ -2074,20 +4823,46 @@ BOOL VmmInitialize()
     if(!(ctxVmm->Cache.PAGING_FAILED = ObSet_New())) { goto fail; }
     // 6: CACHE INIT: Prototype PTE Cache Map
     if(!(ctxVmm->Cache.pmPrototypePte = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) { goto fail; }
+    for(i = 0; i < _countof(ctxVmm->ModuleCache.pm); i++) {
+        if(!(ctxVmm->ModuleCache.pm[i] = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) { goto fail; }
+    }
+    MmVad_PrototypePteCache_Initialize();
+    ctxVmm->ReadAhead.cPagesMax = VMM_READAHEAD_PAGES_MAX_DEFAULT;
+    QueryPerformanceFrequency((PLARGE_INTEGER)&ctxVmm->qwPerfFreq);
+    ctxVmm->dwSoftTlbGeneration = 1;
+    InitializeSRWLock(&ctxVmm->DeviceSched.LockSRW);
+    InitializeConditionVariable(&ctxVmm->DeviceSched.CondIdle);
+    InitializeConditionVariable(&ctxVmm->DeviceSched.CondCoalesce);
+    ctxVmm->DeviceSched.cUsCoalesceWindow = min(VMM_COALESCE_WINDOW_US_MAX, ctxMain->cfg.cUsReadCoalesce);
+    ctxVmm->DeviceSched.fCoalesceWindowSet = ctxMain->cfg.fReadCoalesceSet;
+    ctxVmm->DeviceSched.Remote.fEnabled = ctxMain->dev.fRemote;
+    ctxVmm->DeviceSched.Remote.cReadAheadMult = VMM_DEVICE_REMOTE_READAHEAD_MULT_INITIAL;
+    for(i = 0; i < VMM_INFLIGHT_BUCKETS; i++) {
+        InitializeSRWLock(&ctxVmm->InFlight[i].LockSRW);
+        InitializeConditionVariable(&ctxVmm->InFlight[i].Cond);
+    }
     // 7: WORKER THREADS INIT:
     VmmWork_Initialize();
     // 8: OTHER INIT:
     ctxVmm->pObCMapPhysMem = ObContainer_New(NULL);
     ctxVmm->pObCMapUser = ObContainer_New(NULL);
     ctxVmm->pObCMapNet = ObContainer_New(NULL);
+    ctxVmm->pObCMapProcTree = ObContainer_New(NULL);
+    ctxVmm->TcpIp.pObCTcpE = ObContainer_New(NULL);
     ctxVmm->pObCCachePrefetchEPROCESS = ObContainer_New(NULL);
     ctxVmm->pObCCachePrefetchRegistry = ObContainer_New(NULL);
+    ctxVmm->pObCObjectNameCache = ObContainer_New(NULL);
+    ctxVmm->Snapshot.pmObPinned = ObMap_New(OB_MAP_FLAGS_OBJECT_OB);
+    ctxVmm->PageDigest.qwGeneration = 1;
+    InitializeCriticalSection(&ctxVmm->Snapshot.Lock);
     InitializeCriticalSection(&ctxVmm->LockMaster);
     InitializeCriticalSection(&ctxVmm->LockPlugin);
     InitializeCriticalSection(&ctxVmm->LockUpdateMap);
     InitializeCriticalSection(&ctxVmm->LockUpdateModule);
     InitializeCriticalSection(&ctxVmm->TcpIp.LockUpdate);
     VmmInitializeFunctions();
+    VmmCacheCompress_Initialize();
+    VmmPhys2VirtIndex_Initialize();
     return TRUE;
 fail:
     VmmClose();
@@ -29,7 +29,7 @@ typedef unsigned __int64                QWORD, *PQWORD;
 #define VMM_STATUS_FILE_INVALID                 STATUS_FILE_INVALID
 #define VMM_STATUS_FILE_SYSTEM_LIMITATION       STATUS_FILE_SYSTEM_LIMITATION
 
-#define VMM_PROCESSTABLE_ENTRIES_MAX            0x4000
+#define VMM_PROCESSTABLE_ENTRIES_MIN            0x100  // initial # of process slots - table grows as required
 #define VMM_PROCESS_OS_ALLOC_PTR_MAX            0x4    // max number of operating system specific pointers that must be free'd
 #define VMM_MEMMAP_ENTRIES_MAX                  0x4000
 
@@ -46,7 +46,15 @@ typedef unsigned __int64                QWORD, *PQWORD;
 #define VMM_CACHE_TLB_ENTRIES                   0x4000  // -> 64MB of cached data
 #define VMM_CACHE_PHYS_ENTRIES                  0x4000  // -> 64MB of cached data
 
-#define VMM_WORK_THREADPOOL_NUM_THREADS         0x20
+#define VMM_WORK_THREADPOOL_NUM_THREADS_MIN     0x20    // worker threads = 2 * cpu count, clamped to min/max
+#define VMM_WORK_THREADPOOL_NUM_THREADS_MAX     0x40    // (or as configured by -workthreads, clamped to cfg_min/max)
+#define VMM_WORK_THREADPOOL_NUM_THREADS_CFG_MIN 0x04
+#define VMM_WORK_DEQUE_INITIAL_ENTRIES          0x40
+
+#define VMMWORK_PRIORITY_HIGH                   0
+#define VMMWORK_PRIORITY_NORMAL                 1
+#define VMMWORK_PRIORITY_LOW                    2
+#define VMMWORK_PRIORITY_COUNT                  3
 
 #define VMM_FLAG_NOCACHE                        0x00000001  // do not use the data cache (force reading from memory acquisition device).
 #define VMM_FLAG_ZEROPAD_ON_FAIL                0x00000002  // zero pad failed physical memory reads and report success if read within range of physical memory.
@@ -57,6 +65,7 @@ typedef unsigned __int64                QWORD, *PQWORD;
 #define VMM_FLAG_PROCESS_TOKEN                  0x00000040  // try initialize process token
 #define VMM_FLAG_ALTADDR_VA_PTE                 0x00000080  // alternative address mode - MEM_IO_SCATTER_HEADER.qwA contains PTE instead of VA when calling VmmRead* functions.
 #define VMM_FLAG_NOCACHEPUT                     0x00000100  // do not write back to the data cache upon successful read from memory acquisition device.
+#define VMM_FLAG_PRIORITY_BULK                  0x00000200  // low priority bulk read - device reads are sliced and yield to interactive reads.
 #define VMM_FLAG_PAGING_LOOP_PROTECT_BITS       0x00ff0000  // placeholder bits for paging loop protect counter.
 #define VMM_FLAG_NOVAD                          0x01000000  // do not try to retrieve memory from backing VAD even if otherwise possible.
 
@@ -329,6 +338,15 @@ typedef struct tdVMM_MAP_USERENTRY {
     QWORD vaRegHive;
 } VMM_MAP_USERENTRY, *PVMM_MAP_USERENTRY;
 
+typedef struct tdVMM_MAP_PROCTREEENTRY {
+    DWORD dwPID;
+    DWORD dwPPID;
+    DWORD iParent;                  // index of parent entry, (DWORD)-1 if parent is not in map
+    DWORD iLevel;                   // depth in tree (0 = top level)
+    DWORD iChild;                   // index of first child entry index in piChild
+    DWORD cChild;                   // # child entries
+} VMM_MAP_PROCTREEENTRY, *PVMM_MAP_PROCTREEENTRY;
+
 typedef struct tdVMMOB_MAP_PTE {
     OB ObHdr;
     LPWSTR wszMultiText;            // NULL or multi-wstr pointed into by VMM_MAP_PTEENTRY.wszText
@@ -394,6 +412,28 @@ typedef struct tdVMMOB_MAP_HANDLE {
     VMM_MAP_HANDLEENTRY pMap[];     // map entries.
 } VMMOB_MAP_HANDLE, *PVMMOB_MAP_HANDLE;
 
+#define VMM_MAP_ADDRESS_SOURCES     4
+
+typedef struct tdVMM_MAP_ADDRESSENTRY {
+    QWORD vaStart;
+    QWORD vaEnd;                    // inclusive
+    PVMM_MAP_PTEENTRY pPte;         // NULL if not covered by source map
+    PVMM_MAP_VADENTRY pVad;
+    PVMM_MAP_MODULEENTRY pModule;
+    PVMM_MAP_HEAPENTRY pHeap;
+} VMM_MAP_ADDRESSENTRY, *PVMM_MAP_ADDRESSENTRY;
+
+typedef struct tdVMMOB_MAP_ADDRESS {
+    OB ObHdr;
+    PVMMOB_MAP_PTE pObPte;          // source maps (may be NULL)
+    PVMMOB_MAP_VAD pObVad;
+    PVMMOB_MAP_MODULE pObModule;
+    PVMMOB_MAP_HEAP pObHeap;
+    DWORD cMap;                     // # map entries
+    DWORD _Reserved1;
+    VMM_MAP_ADDRESSENTRY pMap[];    // map entries, sorted & non-overlapping
+} VMMOB_MAP_ADDRESS, *PVMMOB_MAP_ADDRESS;
+
 typedef struct tdVMMOB_MAP_NET {
     OB ObHdr;
     LPWSTR wszMultiText;            // multi-wstr pointed into by VMM_MAP_USERENTRY.wszText
@@ -416,6 +456,14 @@ typedef struct tdVMMOB_MAP_USER {
     VMM_MAP_USERENTRY pMap[];       // map entries.
 } VMMOB_MAP_USER, *PVMMOB_MAP_USER;
 
+typedef struct tdVMMOB_MAP_PROCTREE {
+    OB ObHdr;
+    PDWORD piChild;                 // child entry indexes - children of an entry are sorted by PID
+    PDWORD piTree;                  // entry indexes in depth-first tree order
+    DWORD cMap;                     // # map entries.
+    VMM_MAP_PROCTREEENTRY pMap[];   // map entries - sorted by PID.
+} VMMOB_MAP_PROCTREE, *PVMMOB_MAP_PROCTREE;
+
 typedef struct tdVMMWIN_USER_PROCESS_PARAMETERS {
     BOOL fProcessed;
     DWORD cwszImagePathName;
@@ -439,6 +487,52 @@ typedef struct tdVMMOB_PHYS2VIRT_INFORMATION {
     QWORD pvaList[VMM_PHYS2VIRT_INFORMATION_MAX_PROCESS_RESULT];
 } VMMOB_PHYS2VIRT_INFORMATION, *PVMMOB_PHYS2VIRT_INFORMATION;
 
+// optional global reverse index from physical page to virtual addresses over
+// all active processes. entries are sorted on (PFN, PID, VA) and are located
+// by a bucket table indexed on physical 1MB region (PFN >> 8).
+#define VMM_PHYS2VIRT_INDEX_BUCKET_SHIFT                8
+
+typedef struct tdVMM_PHYS2VIRT_INDEX_ENTRY {
+    DWORD dwPFN;
+    DWORD dwPID;
+    QWORD va;                       // virtual address of page (page aligned)
+} VMM_PHYS2VIRT_INDEX_ENTRY, *PVMM_PHYS2VIRT_INDEX_ENTRY;
+
+typedef struct tdVMMOB_PHYS2VIRT_INDEX_PROCESS {
+    OB ObHdr;
+    PVOID pObMapPte;                // PTE map entries were built from (ref counted)
+    DWORD dwPID;
+    DWORD cEntry;
+    VMM_PHYS2VIRT_INDEX_ENTRY e[];
+} VMMOB_PHYS2VIRT_INDEX_PROCESS, *PVMMOB_PHYS2VIRT_INDEX_PROCESS;
+
+typedef struct tdVMMOB_PHYS2VIRT_INDEX {
+    OB ObHdr;
+    QWORD tcCreateTime;
+    DWORD cBucket;
+    DWORD cEntry;
+    PDWORD piBucket;                // cBucket + 1 start indexes into pe
+    PVMM_PHYS2VIRT_INDEX_ENTRY pe;
+} VMMOB_PHYS2VIRT_INDEX, *PVMMOB_PHYS2VIRT_INDEX;
+
+#define VMM_PAGEDIGEST_ENTRIES_MIN      0x1000
+#define VMM_PAGEDIGEST_ENTRIES_MAX      0x400000    // max # of tracked pages per process (16GB)
+
+typedef struct tdVMM_PAGEDIGEST_ENTRY {
+    QWORD va;                       // page address (0 = empty slot)
+    DWORD dwDigest;
+    DWORD _Filler;
+    QWORD qwGeneration;             // generation when digest last changed
+} VMM_PAGEDIGEST_ENTRY, *PVMM_PAGEDIGEST_ENTRY;
+
+typedef struct tdVMMOB_PAGEDIGEST {
+    OB ObHdr;
+    SRWLOCK LockSRW;
+    DWORD cMax;                     // # slots in pe (power of 2)
+    DWORD c;                        // # used slots in pe
+    PVMM_PAGEDIGEST_ENTRY pe;       // open addressing table keyed on va
+} VMMOB_PAGEDIGEST, *PVMMOB_PAGEDIGEST;
+
 // 'static' process information that should be kept even in the ase of a total
 // process refresh. Only use for information that may never change or things
 // that may not affect analysis (like cache preload addresses that only may
@@ -452,6 +546,9 @@ typedef struct tdVMMOB_PROCESS_PERSISTENT {
     POB_CONTAINER pObCLdrModulesPrefetch32;
     POB_CONTAINER pObCLdrModulesPrefetch64;
     POB_CONTAINER pObCMapThreadPrefetch;
+    POB_CONTAINER pObCMapPteIncremental;    // previous PTE map build (memory model specific)
+    POB_CONTAINER pObCMapVadIncremental;    // previous VAD map build (incl. raw VAD nodes)
+    POB_CONTAINER pObCPageDigest;           // PVMMOB_PAGEDIGEST (if page digest tracking is enabled)
     VMMWIN_USER_PROCESS_PARAMETERS UserProcessParams;
     // kernel path and long name (from EPROCESS.SeAuditProcessCreationInfo)
     WORD cwszNameLong;
@@ -470,6 +567,18 @@ typedef struct tdVMMOB_PROCESS_PERSISTENT {
     } Plugin;
 } VMMOB_PROCESS_PERSISTENT, *PVMMOB_PROCESS_PERSISTENT;
 
+// per-process software TLB - direct mapped cache of recent virtual to physical
+// page translations. entries are updated lock-free guarded by a sequence number
+// (odd = update in progress) and are valid only for the current TLB generation.
+#define VMM_SOFTTLB_ENTRIES     0x100
+
+typedef struct tdVMM_SOFTTLB_ENTRY {
+    volatile LONG dwSeq;
+    DWORD dwGeneration;
+    QWORD va;
+    QWORD pa;
+} VMM_SOFTTLB_ENTRY, *PVMM_SOFTTLB_ENTRY;
+
 typedef struct tdVMM_PROCESS {
     OB ObHdr;
     CRITICAL_SECTION LockUpdate;
@@ -489,6 +598,7 @@ typedef struct tdVMM_PROCESS {
         PVMMOB_MAP_HEAP pObHeap;
         PVMMOB_MAP_THREAD pObThread;
         PVMMOB_MAP_HANDLE pObHandle;
+        POB_CONTAINER pObCAddress;  // PVMMOB_MAP_ADDRESS - merged index of above maps
         // separate locks from main process lock to avoid deadlocks
         // but also for increased parallelization for slow tasks.
         CRITICAL_SECTION LockUpdateExtendedInfo;
@@ -524,21 +634,40 @@ typedef struct tdVMM_PROCESS {
         POB_CONTAINER pObCPhys2Virt;
     } Plugin;
     struct tdVMM_PROCESS *pObProcessCloneParent;    // only set in cloned processes
+    VMM_SOFTTLB_ENTRY SoftTlb[VMM_SOFTTLB_ENTRIES];
 } VMM_PROCESS, *PVMM_PROCESS;
 
 typedef struct tdVMMOB_PROCESS_TABLE {
     OB ObHdr;
     SIZE_T c;                       // Total # of processes in table
     SIZE_T cActive;                 // # of active processes (state = 0) in table
-    WORD _iFLink;
-    WORD _iFLinkM[VMM_PROCESSTABLE_ENTRIES_MAX];
-    PVMM_PROCESS _M[VMM_PROCESSTABLE_ENTRIES_MAX];
+    SIZE_T cMax;                    // # allocated slots in _M
+    DWORD cHash;                    // # hash buckets in _piHash (power of 2)
+    PDWORD _piHash;                 // PID hash bucket -> index+1 into _M (0 = empty)
+    PVMM_PROCESS *_M;               // dense process array in insertion order
     POB_CONTAINER pObCNewPROC;      // contains VMM_PROCESS_TABLE
 } VMMOB_PROCESS_TABLE, *PVMMOB_PROCESS_TABLE;
 
+#define VMM_SNAPSHOT_MAP_PHYSMEM        0
+#define VMM_SNAPSHOT_MAP_USER           1
+#define VMM_SNAPSHOT_MAP_NET            2
+#define VMM_SNAPSHOT_MAP_PROCTREE       3
+#define VMM_SNAPSHOT_MAP_MAX            4
+
+typedef struct tdVMMOB_SNAPSHOT {
+    OB ObHdr;
+    QWORD qwSnapshotId;
+    QWORD qwTickCount;              // tick count when snapshot began
+    QWORD qwPageDigestGeneration;   // page digest generation when snapshot began
+    PVMMOB_PROCESS_TABLE pObProcessTable;
+    PVOID pObMap[VMM_SNAPSHOT_MAP_MAX]; // pinned global maps (pinned on first use if not built at begin) - ctxVmm->Snapshot.Lock
+} VMMOB_SNAPSHOT, *PVMMOB_SNAPSHOT;
+
 #define VMM_CACHE2_REGIONS      17
 #define VMM_CACHE2_BUCKETS      2039
-#define VMM_CACHE2_MAX_ENTRIES  0x8000
+#define VMM_CACHE2_MAX_ENTRIES  0x8000      // default # of entries per cache table (128MB)
+#define VMM_CACHE2_MIN_ENTRIES  0x400       // min # of entries per cache table (4MB)
+#define VMM_CACHE2_LIMIT_ENTRIES 0x1000000  // hard max # of entries per cache table (64GB)
 
 #define VMM_CACHE_TAG_PHYS      'CaPh'
 #define VMM_CACHE_TAG_PAGING    'CaPg'
@@ -552,6 +681,10 @@ typedef struct tdVMMOB_MEM {
     struct tdVMMOB_MEM *BLink;
     struct tdVMMOB_MEM *AgeFLink;
     struct tdVMMOB_MEM *AgeBLink;
+    BOOL fHot;          // entry is in the region 'hot' (protected) age list [2Q].
+    BOOL fRef;          // entry have been referenced since insertion/promotion [2Q].
+    BOOL fTrim;         // entry is being removed from the cache due to resize.
+    BOOL fReadAhead;    // entry was speculatively read and not yet accessed.
     MEM_SCATTER h;
     union {
         BYTE pb[0x1000];
@@ -567,17 +700,52 @@ typedef struct tdVMM_CACHE_TABLE {
     SLIST_HEADER ListHeadTotal;
     DWORD cEmpty;
     DWORD cTotal;
+    DWORD cMaxEntries;
+    BOOL f2Q;                       // scan resistant replacement: probation + hot age lists
     WORD iReclaimLast;
+    SLIST_HEADER ListHeadRetired;   // entries removed by shrink - free'd at next clear
+    SLIST_HEADER ListHeadRetiredOld;    // entries removed by shrink - free'd at this clear
+    struct {
+        QWORD cHit;
+        QWORD cMiss;
+        QWORD cEvict;               // entries evicted to make room for new entries
+        QWORD cReserveFail;         // failed or stalled reserve (cache drained)
+    } stat;
     struct {
         DWORD c;
-        DWORD dwFuture;
+        volatile DWORD dwSeq;       // write sequence - odd when a writer is active in region
         CRITICAL_SECTION Lock;
-        PVMMOB_MEM AgeFLink;
+        PVMMOB_MEM AgeFLink;        // (probation) age list - new entries inserted here
         PVMMOB_MEM AgeBLink;
+        DWORD cHot;
+        PVMMOB_MEM HotFLink;        // hot age list - entries referenced while in probation [2Q]
+        PVMMOB_MEM HotBLink;
         PVMMOB_MEM B[VMM_CACHE2_BUCKETS];
     } R[VMM_CACHE2_REGIONS];
 } VMM_CACHE_TABLE, *PVMM_CACHE_TABLE;
 
+#define VMM_READAHEAD_STREAMS               0x20
+#define VMM_READAHEAD_PAGES_INITIAL         0x10
+#define VMM_READAHEAD_PAGES_MAX_DEFAULT     0x100
+#define VMM_READAHEAD_PAGES_MAX             0x1000
+#define VMM_READAHEAD_STRIDE_MAX            0x00100000
+
+typedef struct tdVMM_READAHEAD_STREAM {
+    DWORD dwTID;                // thread owning the stream
+    DWORD cPages;               // current read-ahead window (in pages)
+    QWORD paLast;               // last page of most recent read
+    QWORD qwStride;             // most recent distance between reads
+} VMM_READAHEAD_STREAM, *PVMM_READAHEAD_STREAM;
+
+#define VMM_INFLIGHT_BUCKETS                0x40
+#define VMM_INFLIGHT_BUCKET_SLOTS           8
+
+typedef struct tdVMM_INFLIGHT_BUCKET {
+    SRWLOCK LockSRW;
+    CONDITION_VARIABLE Cond;    // signalled when a page in the bucket completes
+    QWORD pa[VMM_INFLIGHT_BUCKET_SLOTS];    // physical pages currently being read (0 = free)
+} VMM_INFLIGHT_BUCKET, *PVMM_INFLIGHT_BUCKET;
+
 typedef struct tdVMM_VIRT2PHYS_INFORMATION {
     VMM_MEMORYMODEL_TP tpMemoryModel;
     QWORD va;
@@ -586,15 +754,39 @@ typedef struct tdVMM_VIRT2PHYS_INFORMATION {
     WORD  iPTEs[5]; // Index of PTE in page table
 } VMM_VIRT2PHYS_INFORMATION, *PVMM_VIRT2PHYS_INFORMATION;
 
+// page file reads and decompressions deferred from a virtual scatter read -
+// completed in one sorted pass over the page files by pfnPagedReadBatch.
+typedef struct tdVMM_PAGING_BATCH_ENTRY {
+    BOOL fCompressed;               // compressed virtual store page (not page file)
+    DWORD dwPfNumber;
+    DWORD dwPfOffset;
+    QWORD pte;
+    PBYTE pbPage;
+    PMEM_SCATTER pMEM;
+    // compressed virtual store pages only:
+    PVMM_PROCESS pProcess;
+    QWORD va;
+    QWORD fVmmRead;
+} VMM_PAGING_BATCH_ENTRY, *PVMM_PAGING_BATCH_ENTRY;
+
+typedef struct tdVMM_PAGING_BATCH {
+    DWORD c;
+    DWORD cMax;
+    PMEM_SCATTER pMEMCurrent;       // MEM currently being resolved by pfnPagedRead
+    VMM_PAGING_BATCH_ENTRY e[];
+} VMM_PAGING_BATCH, *PVMM_PAGING_BATCH;
+
 typedef struct tdVMM_MEMORYMODEL_FUNCTIONS {
     VOID(*pfnClose)();
-    BOOL(*pfnVirt2Phys)(_In_ QWORD paDTB, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa);
+    BOOL(*pfnVirt2Phys)(_In_ QWORD paDTB, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa, _Out_opt_ PQWORD pcbPage);
+    VOID(*pfnVirt2PhysPrefetch)(_In_ PVMM_PROCESS pProcess, _In_ DWORD cpMEMsVirt, _In_reads_(cpMEMsVirt) PPMEM_SCATTER ppMEMsVirt);    // optional
     VOID(*pfnVirt2PhysGetInformation)(_Inout_ PVMM_PROCESS pProcess, _Inout_ PVMM_VIRT2PHYS_INFORMATION pVirt2PhysInfo);
     VOID(*pfnPhys2VirtGetInformation)(_In_ PVMM_PROCESS pProcess, _Inout_ PVMMOB_PHYS2VIRT_INFORMATION pP2V);
     BOOL(*pfnPteMapInitialize)(_In_ PVMM_PROCESS pProcess);
     VOID(*pfnTlbSpider)(_In_ PVMM_PROCESS pProcess);
     BOOL(*pfnTlbPageTableVerify)(_Inout_ PBYTE pb, _In_ QWORD pa, _In_ BOOL fSelfRefReq);
-    BOOL(*pfnPagedRead)(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _In_ QWORD flags);
+    BOOL(*pfnPagedRead)(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _Inout_opt_ PVMM_PAGING_BATCH pBatch, _In_ QWORD flags);
+    VOID(*pfnPagedReadBatch)(_Inout_ PVMM_PAGING_BATCH pBatch);    // optional
 } VMM_MEMORYMODEL_FUNCTIONS;
 
 // ----------------------------------------------------------------------------
@@ -611,21 +803,123 @@ typedef struct tdVmmConfig {
     BOOL fVerboseExtra;
     BOOL fVerboseExtraTlp;
     BOOL fDisableBackgroundRefresh;
+    BOOL fDisableFileMap;           // do not memory map raw memory dump files
     BOOL fDisableLeechCoreClose;    // when device 'existing'
     BOOL fDisableSymbolServerOnStartup;
     BOOL fWaitInitialize;
+    BOOL fCachePhys2Q;              // scan resistant physical memory cache
+    BOOL fPhys2VirtIndex;           // global physical to virtual reverse index
+    BOOL fRegistryLazy;             // lazy registry hive snapshots (fetch hive data on demand)
+    BOOL fDisableProfile;           // do not load/save the per-build kernel offset profile
+    BOOL fPluginLazy;               // lazy plugin loading (load plugin on first use)
+    // cache sizes (in MB) below - zero = default
+    DWORD cMBCachePhys;
+    DWORD cMBCacheTlb;
+    DWORD cMBCachePaging;
+    DWORD cUsReadCoalesce;          // small device read coalescing window (in uS) - zero = disabled
+    BOOL fReadCoalesceSet;          // coalescing window explicitly configured (also if zero)
+    DWORD cMBCacheCompress;         // compressed physical memory cache tier (in MB) - zero = disabled
+    DWORD cMBCachePrototypePte;     // prototype pte array cache (in MB) - zero = default
+    DWORD dwWarmupMaps;             // VMM_WARMUP_MAP_* map types to pre-build after refresh - zero = disabled
+    DWORD cFcScanChunks;            // forensic physical memory scan pipeline depth - zero = default
+    DWORD cMBFcScanChunk;           // forensic physical memory scan chunk size (in MB) - zero = default
+    DWORD cMBFcMemoryBudget;        // in-memory forensic database spill-to-disk budget (in MB) - zero = default
+    DWORD cMBMemoryBudget;          // global memory budget (in MB) - zero = no budget
+    DWORD cWorkThreads;             // worker thread pool size - zero = default
     // strings below
     CHAR szMemMap[MAX_PATH];
     CHAR szPythonPath[MAX_PATH];
     CHAR szPageFile[10][MAX_PATH];
+    CHAR szForensicPattern[MAX_PATH];   // forensic scan multi-pattern file
+    CHAR szDeviceRecord[MAX_PATH];      // device read trace file to record to
+    CHAR szDeviceReplay[MAX_PATH];      // device read trace file to replay instead of device
 } VMMCONFIG, *PVMMCONFIG;
 
+#define VMM_COALESCE_BATCH_MAX              0x400       // max pages per coalesced device read
+#define VMM_COALESCE_REQUEST_MAX            0x40        // max pages per request eligible for coalescing
+#define VMM_COALESCE_WINDOW_US_MAX          10000
+
+typedef struct tdVMM_COALESCE_BATCH {
+    DWORD cRef;                 // requesters (incl. leader) yet to pick up result
+    DWORD cMEMs;
+    BOOL fDone;
+    PMEM_SCATTER ppMEMs[VMM_COALESCE_BATCH_MAX];
+} VMM_COALESCE_BATCH, *PVMM_COALESCE_BATCH;
+
+// compressed second tier of the physical memory cache. pages evicted from the
+// physical memory cache are kept xpress compressed in a memory budget. pages
+// not compressing to VMM_CACHE_COMPRESS_CB_MAX bytes or less are discarded.
+#define VMM_CACHE_COMPRESS_CB_MAX           0xc00
+#define VMM_CACHE_COMPRESS_CB_OVERHEAD      0x40        // per entry accounting overhead (map + alloc)
+
+typedef struct tdVMM_CACHE_COMPRESS_ENTRY {
+    DWORD cb;                   // compressed size, 0 = zero page
+    BYTE pb[];
+} VMM_CACHE_COMPRESS_ENTRY, *PVMM_CACHE_COMPRESS_ENTRY;
+
+// prototype pte array cache shared between all processes (keyed by prototype
+// pte array address). the cache is memory budgeted and is trimmed with a clock
+// (second chance) approximation of least recently used replacement.
+#define VMM_CACHE_PROTOTYPEPTE_MB_DEFAULT   64
+#define VMM_CACHE_PROTOTYPEPTE_CB_OVERHEAD  0x60        // per entry accounting overhead (map + ob header)
+
+#define VMM_DEVICE_BULK_SLICE               0x100       // max pages per bulk read slice (1MB)
+#define VMM_DEVICE_BULK_MAXWAIT_MS          100         // max delay of bulk read slice by interactive reads
+
+// remote device profile - active by default on remote (leechagent) devices.
+// bulk reads are issued in larger slices with several slices in flight and
+// the coalescing window and read-ahead depth are tuned from the measured
+// round-trip time of small device reads.
+#define VMM_DEVICE_REMOTE_BULK_SLICE        0x400       // max pages per bulk read slice (4MB)
+#define VMM_DEVICE_REMOTE_INFLIGHT          4           // max bulk read slices in flight
+#define VMM_DEVICE_REMOTE_RTT_PAGES         0x40        // max pages of a read sampled for round-trip time
+#define VMM_DEVICE_REMOTE_READAHEAD_MULT_INITIAL    4
+
+// map types optionally pre-built for active processes by the low priority
+// warm-up stage of the refresh thread (ctxVmm->ThreadProcCache.dwWarmupMaps).
+#define VMM_WARMUP_MAP_VAD                  0x00000001
+#define VMM_WARMUP_MAP_MODULE               0x00000002
+#define VMM_WARMUP_MAP_HANDLE               0x00000004
+#define VMM_WARMUP_MAP_THREAD               0x00000008
+#define VMM_WARMUP_MAP_ALL                  0x0000000f
+#define VMM_WARMUP_BUDGET_MS_DEFAULT        5000        // max time spent on warm-up per refresh
+#define VMM_WARMUP_BUDGET_PAGES_DEFAULT     0x8000      // max device pages read by warm-up per refresh (128MB)
+#define VMM_SNAPSHOT_DEFER_MS_MAX           60000       // max time background refreshes are deferred by snapshots
+
+// LcReadScatter latency histogram bucket i count calls with a latency less
+// than 2^i microseconds (and at least 2^(i-1)); the last bucket is unbounded.
+#define VMM_LATENCY_HISTOGRAM_BUCKETS       16
+
 typedef struct tdVMM_STATISTICS {
     QWORD cPhysCacheHit;
     QWORD cPhysReadSuccess;
     QWORD cPhysReadFail;
     QWORD cPhysWrite;
     QWORD cPhysRefreshCache;
+    QWORD cPhysReadAhead;           // pages speculatively read
+    QWORD cPhysReadAheadHit;        // speculatively read pages later accessed
+    QWORD cPhysReadAheadMiss;       // speculatively read pages evicted un-accessed
+    QWORD cPhysReadInFlightWait;    // page misses served by waiting on another thread's read
+    QWORD cVirt2PhysLargePage;      // virtual pages translated from a previous large page translation
+    QWORD cVirt2PhysSoftTlbHit;     // virtual pages translated by the per-process software TLB
+    QWORD cDeviceRead;              // LcReadScatter calls
+    QWORD cDeviceReadPages;         // LcReadScatter pages requested
+    QWORD tmDeviceReadUs;           // LcReadScatter total time (in microseconds)
+    QWORD cDeviceReadLatency[VMM_LATENCY_HISTOGRAM_BUCKETS];  // LcReadScatter latency histogram
+    QWORD cDeviceReadBulkSlice;     // bulk priority read slices
+    QWORD cDeviceReadBulkYield;     // bulk priority read slices delayed by interactive reads
+    QWORD cDeviceReadCoalesced;     // interactive reads merged into another thread's device read
+    QWORD cDeviceReadCoalescedDup;  // duplicate pages removed from coalesced device reads
+    QWORD cCacheCompressStore;      // pages stored in the compressed cache tier
+    QWORD cCacheCompressReject;     // evicted pages not compressible enough to be stored
+    QWORD cCacheCompressHit;        // pages promoted from the compressed cache tier
+    QWORD cCacheCompressEvict;      // pages evicted from the compressed cache tier
+    QWORD cCachePrototypePteHit;    // prototype pte arrays retrieved from cache
+    QWORD cCachePrototypePteMiss;   // prototype pte arrays not in cache
+    QWORD cCachePrototypePteEvict;  // prototype pte arrays evicted from cache
+    QWORD cModuleCacheHit;          // process independent module parse results retrieved from cache
+    QWORD cModuleCacheMiss;         // process independent module parse results not in cache
+    QWORD cMemBudgetEvict;          // eviction steps taken to enforce the memory budget
     struct {
         QWORD cPrototype;
         QWORD cTransition;
@@ -645,8 +939,13 @@ typedef struct tdVMM_STATISTICS {
     QWORD cTlbReadSuccess;
     QWORD cTlbReadFail;
     QWORD cTlbRefreshCache;
+    QWORD cTlbRevalidate;           // page tables re-read by incremental revalidation
+    QWORD cTlbRevalidateInvalid;    // page tables invalidated by incremental revalidation
+    QWORD cCacheReadLockFallback;   // lock-free cache read retried under region lock
+    QWORD cCacheLockContention;     // region lock already held at time of acquire
     QWORD cProcessRefreshPartial;
     QWORD cProcessRefreshFull;
+    QWORD cProcessWarmup;           // processes with maps pre-built by the warm-up stage
 } VMM_STATISTICS, *PVMM_STATISTICS;
 
 typedef struct tdVMM_OFFSET_EPROCESS {
@@ -790,6 +1089,7 @@ typedef struct tdVMMWIN_TCPIP_CONTEXT {
     BOOL fInitialized;
     QWORD vaPartitionTable;
     VMMWIN_TCPIP_OFFSET_TcpE OTcpE;
+    POB_CONTAINER pObCTcpE;         // POB_MAP of previous build: vaTcpE -> VMMWIN_TCPIP_TCPE_PREVIOUS
 } VMMWIN_TCPIP_CONTEXT, *PVMMWIN_TCPIP_CONTEXT;
 
 typedef struct tdVMMWIN_OPTIONAL_KERNEL_CONTEXT {
@@ -829,10 +1129,29 @@ typedef NTSTATUS VMMFN_RtlDecompressBuffer(
     PULONG FinalUncompressedSize
 );
 
+typedef NTSTATUS VMMFN_RtlCompressBuffer(
+    USHORT CompressionFormatAndEngine,
+    PUCHAR UncompressedBuffer,
+    ULONG  UncompressedBufferSize,
+    PUCHAR CompressedBuffer,
+    ULONG  CompressedBufferSize,
+    ULONG  UncompressedChunkSize,
+    PULONG FinalCompressedSize,
+    PVOID  WorkSpace
+);
+
+typedef NTSTATUS VMMFN_RtlGetCompressionWorkSpaceSize(
+    USHORT CompressionFormatAndEngine,
+    PULONG CompressBufferWorkSpaceSize,
+    PULONG CompressFragmentWorkSpaceSize
+);
+
 typedef struct tdVMM_DYNAMIC_LOAD_FUNCTIONS {
     // functions below may be loaded on startup
     // NB! null checks are required before use!
     VMMFN_RtlDecompressBuffer *RtlDecompressBuffer;     // ntdll.dll!RtlDecompressBuffer
+    VMMFN_RtlCompressBuffer *RtlCompressBuffer;         // ntdll.dll!RtlCompressBuffer
+    VMMFN_RtlGetCompressionWorkSpaceSize *RtlGetCompressionWorkSpaceSize;   // ntdll.dll!RtlGetCompressionWorkSpaceSize
 } VMM_DYNAMIC_LOAD_FUNCTIONS;
 
 // OBJECT TYPE table exists on Win7+ It's initialized on first use and it will
@@ -874,6 +1193,10 @@ typedef struct tdVMM_CONTEXT {
         DWORD cTick_ProcPartial;
         DWORD cTick_ProcTotal;
         DWORD cTick_Registry;
+        BOOL fTlbRevalidate;        // revalidate TLB cache on TLB tick instead of clear
+        DWORD dwWarmupMaps;         // VMM_WARMUP_MAP_* to pre-build after process refresh (0 = disabled)
+        DWORD cMs_WarmupBudget;     // warm-up time budget per refresh
+        DWORD cPages_WarmupBudget;  // warm-up device read budget (in pages) per refresh
     } ThreadProcCache;
     VMM_STATISTICS stat;
     VMM_KERNELINFO kernel;
@@ -882,6 +1205,7 @@ typedef struct tdVMM_CONTEXT {
     POB pObPfnContext;
     PVOID pPdbContext;
     PVOID pMmContext;
+    PVOID pProfileContext;
     PVMMWINOBJ_CONTEXT pObjects;
     PVMMWIN_REGISTRY_CONTEXT pRegistry;
     VMMWIN_TCPIP_CONTEXT TcpIp;
@@ -890,6 +1214,8 @@ typedef struct tdVMM_CONTEXT {
     struct {
         PVOID FLink;
         PVOID FLinkNotify;
+        PVOID FLinkLazy;                // lazy plugins not yet loaded (-pluginlazy)
+        PVOID pvLazyCache;              // lazy plugin cache - only valid during initialization
         PVOID Root;
         PVOID Proc;
     } PluginManager;
@@ -898,8 +1224,10 @@ typedef struct tdVMM_CONTEXT {
     POB_CONTAINER pObCMapPhysMem;
     POB_CONTAINER pObCMapUser;
     POB_CONTAINER pObCMapNet;
+    POB_CONTAINER pObCMapProcTree;      // contains PVMMOB_MAP_PROCTREE of the active process table
     POB_CONTAINER pObCCachePrefetchEPROCESS;
     POB_CONTAINER pObCCachePrefetchRegistry;
+    POB_CONTAINER pObCObjectNameCache;  // contains POB_MAP of object va -> VMMWIN_OB_OBJECTNAME
     // page caches
     struct {
         VMM_CACHE_TABLE PHYS;
@@ -908,17 +1236,116 @@ typedef struct tdVMM_CONTEXT {
         POB_SET PAGING_FAILED;
         POB_MAP pmPrototypePte;     // map with mm_vad.c managed data
     } Cache;
-    // worker threads
+    // memory budget of the prototype pte array cache (mm_vad.c managed)
+    struct {
+        CRITICAL_SECTION Lock;
+        BOOL fInitialized;
+        QWORD cbMax;                // memory budget in bytes
+        QWORD cb;                   // memory currently in use (incl. overhead)
+        DWORD iClock;               // clock hand - index into Cache.pmPrototypePte
+        POB_SET psReferenced;       // entries (prototype pte addresses) referenced since last clock pass
+    } CachePrototypePte;
+    // opt-in page digest tracking (see VmmPageDigest_*)
+    struct {
+        DWORD cEnabled;             // # processes with page digest tracking enabled
+        volatile LONG64 qwGeneration;   // incremented on each memory write and physical/tlb cache clear
+    } PageDigest;
+    // consistent analysis snapshots - pinned process tables & deferred refresh
+    struct {
+        CRITICAL_SECTION Lock;
+        DWORD cPinned;              // # active snapshots
+        QWORD qwSnapshotIdLast;
+        QWORD qwTickCountPinned;    // tick count when first active snapshot began
+        POB_MAP pmObPinned;         // snapshot id -> PVMMOB_SNAPSHOT
+        PVMMOB_SNAPSHOT pActive;    // most recently begun snapshot in pmObPinned (no reference held)
+    } Snapshot;
+    // process independent module parse results keyed by image identity (pe.c managed)
+    struct {
+        POB_MAP pm[4];              // PE_MODULECACHE_TP_MAX maps of key hash -> module cache entry
+        volatile LONG iEvict[4];    // rotating eviction position per map
+    } ModuleCache;
+    // compressed second tier of the physical memory cache
+    struct {
+        CRITICAL_SECTION Lock;
+        BOOL fInitialized;
+        QWORD cbMax;                // memory budget in bytes (0 = disabled)
+        QWORD cb;                   // memory currently in use (incl. overhead)
+        DWORD iEvict;               // pseudo random replacement index
+        POB_MAP pm;                 // pa -> PVMM_CACHE_COMPRESS_ENTRY
+        PVOID pvWorkSpace;          // RtlCompressBuffer work space
+        BYTE pbBuffer[0x1000];      // RtlCompressBuffer output buffer
+    } CacheCompress;
+    // global memory budget (vmmmembudget.c managed)
+    struct {
+        QWORD cbMax;                // memory budget in bytes (0 = no budget)
+        volatile LONG fThread;      // budget enforcement thread started
+        QWORD qwTickProcessRefresh; // tick count of last budget enforced process refresh
+    } MemBudget;
+    // optional global physical to virtual reverse index.
+    struct {
+        CRITICAL_SECTION Lock;
+        BOOL fEnabled;
+        POB_CONTAINER pObCIndex;    // current PVMMOB_PHYS2VIRT_INDEX
+        POB_MAP pmProcess;          // per-process PVMMOB_PHYS2VIRT_INDEX_PROCESS by PID
+    } Phys2VirtIndex;
+    QWORD qwPerfFreq;               // QueryPerformanceFrequency
+    volatile DWORD dwSoftTlbGeneration;     // bumped to invalidate all per-process software TLBs
+    // adaptive physical memory read-ahead
+    struct {
+        DWORD cPagesMax;            // max read-ahead window (0 = disabled)
+        VMM_READAHEAD_STREAM Stream[VMM_READAHEAD_STREAMS];
+    } ReadAhead;
+    // physical pages currently being read from the device - used to avoid
+    // duplicate device reads when multiple threads miss on the same page.
+    VMM_INFLIGHT_BUCKET InFlight[VMM_INFLIGHT_BUCKETS];
+    // device read scheduler - bulk reads yield to interactive reads.
+    struct {
+        SRWLOCK LockSRW;
+        CONDITION_VARIABLE CondIdle;    // signalled when no interactive reads are active
+        DWORD cInteractive;             // number of active interactive reads
+        volatile LONG cExternal;        // number of active external (api/vfs) calls
+        DWORD cUsCoalesceWindow;        // small read coalescing window in uS (0 = disabled)
+        BOOL fCoalesceWindowSet;        // window explicitly configured - an explicit 0 is not overridden by remote tuning
+        PVMM_COALESCE_BATCH pCoalesce;  // currently open coalescing batch (if any)
+        CONDITION_VARIABLE CondCoalesce;    // signalled when a coalesced batch completes
+        struct {
+            BOOL fEnabled;              // remote device profile active
+            volatile DWORD cUsRtt;      // smoothed round-trip time of small device reads in uS
+            DWORD cUsCoalesceWindow;    // tuned coalescing window in uS (applied if larger than configured)
+            DWORD cReadAheadMult;       // tuned read-ahead window multiplier
+        } Remote;
+    } DeviceSched;
+    // worker threads - per worker deques with work stealing
     struct {
         BOOL fEnabled;
-        POB_SET psThreadAll;
-        POB_SET psThreadAvail;
-        POB_SET psUnit;
+        DWORD cThread;              // number of worker threads (and deques)
+        DWORD dwTlsIndex;           // tls slot - worker index + 1 on worker threads
+        volatile LONG cThreadActive;    // running worker threads
+        volatile LONG cQueued;      // queued work units in all deques
+        volatile LONG cIdle;        // worker threads sleeping on CondWork
+        volatile LONG iSubmit;      // round robin deque for submits from non worker threads
+        SRWLOCK LockSRW;            // idle worker lock
+        CONDITION_VARIABLE CondWork;    // signalled when work is queued
+        struct tdVMMWORK_DEQUE *paDeque;
     } Work;
     WCHAR _EmptyWCHAR;
     VMMWIN_OBJECT_TYPE_TABLE ObjectTypeTable;
 } VMM_CONTEXT, *PVMM_CONTEXT;
 
+#define VMM_STARTUP_PHASE_MAX           0x20
+
+typedef struct tdVMM_STARTUP_PHASE {
+    LPCSTR szName;
+    DWORD dwThreadId;
+    QWORD tmStart;                  // QueryPerformanceCounter
+    QWORD tmEnd;                    // QueryPerformanceCounter, zero = phase still running
+    struct {
+        QWORD c;                    // ctxVmm->stat.cDeviceRead
+        QWORD cPages;               // ctxVmm->stat.cDeviceReadPages
+        QWORD tmUs;                 // ctxVmm->stat.tmDeviceReadUs
+    } ReadStart, ReadEnd;
+} VMM_STARTUP_PHASE, *PVMM_STARTUP_PHASE;
+
 typedef struct tdVMM_MAIN_CONTEXT {
     VMMCONFIG cfg;
     HANDLE hLC;
@@ -932,6 +1359,21 @@ typedef struct tdVMM_MAIN_CONTEXT {
         CHAR szSymbolPath[MAX_PATH];
     } pdb;
     PVOID pvStatistics;
+    PVOID pvDevTrace;               // device read trace record/replay context (vmmdevtrace.c)
+    // read-only memory mapped view of a raw memory dump file (if any) used to
+    // serve physical memory reads directly - bypassing device and cache.
+    struct {
+        HANDLE hFile;
+        HANDLE hMap;
+        PBYTE pb;
+        QWORD cb;
+    } filemap;
+    // startup phase timeline - phases are recorded in the order started.
+    struct {
+        QWORD tmBase;               // QueryPerformanceCounter at VMMDLL_Initialize
+        volatile LONG cPhase;
+        VMM_STARTUP_PHASE Phase[VMM_STARTUP_PHASE_MAX];
+    } startup;
 } VMM_MAIN_CONTEXT, *PVMM_MAIN_CONTEXT;
 
 // ----------------------------------------------------------------------------
@@ -1004,6 +1446,52 @@ BOOL VmmCacheExists(_In_ DWORD dwTblTag, _In_ QWORD qwA);
 */
 PVMMOB_MEM VmmCacheReserve(_In_ DWORD wTblTag);
 
+/*
+* Set the max number of entries and the replacement policy of a cache table.
+* If the cache shrinks surplus entries are free'd once they become unused.
+* -- dwTblTag
+* -- cMaxEntries = max # of 4kB entries, zero = default.
+* -- f2Q = use a scan resistant 2Q-style replacement policy.
+* -- return
+*/
+_Success_(return)
+BOOL VmmCacheConfigure(_In_ DWORD dwTblTag, _In_ DWORD cMaxEntries, _In_ BOOL f2Q);
+
+/*
+* Set the memory budget of the compressed physical memory cache tier. If the
+* budget shrinks surplus entries are evicted. A zero budget disables the tier.
+* -- cMB = memory budget in MB.
+* -- return = FALSE if the tier is unavailable or the budget is invalid.
+*/
+_Success_(return)
+BOOL VmmCacheCompressConfigure(_In_ DWORD cMB);
+
+/*
+* Release memory held by the compressed physical memory cache tier under
+* memory pressure. Entries are evicted in the regular random order of the tier.
+* -- cb = number of bytes to release.
+*/
+VOID VmmCacheCompressShrink(_In_ QWORD cb);
+
+/*
+* Evict entries from a memory budgeted key -> object manager object map until
+* cbExtra additional bytes fits within the budget. Second-chance (clock)
+* replacement: entries whose key is in psReferenced are skipped once and their
+* key removed from the set. Keys are used for reference tracking since object
+* addresses may be re-used after free. Used by caches outside of vmm.c which
+* manage their own map and lock.
+* NB! caller must hold the lock protecting pm, psReferenced, piClock and pcb.
+* -- pm = map with OB_MAP_FLAGS_OBJECT_OB.
+* -- psReferenced = keys referenced since the clock hand last passed them.
+* -- piClock = clock hand - index into pm.
+* -- pcb = bytes in use - reduced by cbOverhead + object data size on evict.
+* -- cbMax = memory budget in bytes.
+* -- cbExtra = additional bytes to make room for.
+* -- cbOverhead = bytes charged per entry in addition to the object data.
+* -- return = number of evicted entries.
+*/
+DWORD VmmCacheClockEvict(_In_ POB_MAP pm, _In_ POB_SET psReferenced, _Inout_ PDWORD piClock, _Inout_ PQWORD pcb, _In_ QWORD cbMax, _In_ QWORD cbExtra, _In_ QWORD cbOverhead);
+
 /*
 * Return an entry retrieved with VmmCacheReserve to the cache.
 * NB! no other items may be returned with this function!
@@ -1111,6 +1599,20 @@ VOID VmmReadEx(_In_opt_ PVMM_PROCESS pProcess, _In_ QWORD qwA, _Out_writes_(cb)
 _Success_(return)
 BOOL VmmReadPage(_In_opt_ PVMM_PROCESS pProcess, _In_ QWORD qwA, _Out_writes_(4096) PBYTE pbPage);
 
+/*
+* Retrieve the physical memory cache page backing an address without copying
+* its contents. On a cache miss the page is read from the device and inserted
+* into the cache. Paged out virtual memory is not supported - callers should
+* fall back to VmmReadEx if the function fails. The returned page is shared and
+* must be treated as read-only.
+* CALLER DECREF: return
+* -- pProcess = NULL=='physical memory read', PTR=='virtual memory read'
+* -- qwA
+* -- flags = flags as in VMM_FLAG_*, VMM_FLAG_FORCECACHE_READ = fail on cache miss.
+* -- return = cache page containing qwA on success, NULL on fail.
+*/
+PVMMOB_MEM VmmReadPageOb(_In_opt_ PVMM_PROCESS pProcess, _In_ QWORD qwA, _In_ QWORD flags);
+
 /*
 * Scatter read virtual memory. Non contiguous 4096-byte pages.
 * -- pProcess
@@ -1128,6 +1630,20 @@ VOID VmmReadScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_updates_(cpMEMsVir
 */
 VOID VmmReadScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsPhys, _In_ QWORD flags);
 
+/*
+* Try to memory map the memory acquisition device if it's a static raw memory
+* dump file. If successful physical memory reads will be served directly from
+* the mapped view. Must be called after the LeechCore device is initialized
+* but before any memory map is applied to it.
+* -- return = TRUE if the file was mapped.
+*/
+BOOL VmmFileMap_Initialize();
+
+/*
+* Close any memory mapped view of the memory acquisition device.
+*/
+VOID VmmFileMap_Close();
+
 /*
 * Read a memory segment as a file. This function is mainly a helper function
 * for various file system functionality.
@@ -1172,7 +1688,7 @@ inline BOOL VmmVirt2PhysEx(_In_ QWORD paDTB, _In_ BOOL fUserOnly, _In_ QWORD va,
 {
     *ppa = 0;
     if(ctxVmm->tpMemoryModel == VMM_MEMORYMODEL_NA) { return FALSE; }
-    return ctxVmm->fnMemoryModel.pfnVirt2Phys(paDTB, fUserOnly, -1, va, ppa);
+    return ctxVmm->fnMemoryModel.pfnVirt2Phys(paDTB, fUserOnly, -1, va, ppa, NULL);
 }
 
 /*
@@ -1190,7 +1706,27 @@ inline BOOL VmmVirt2Phys(_In_ PVMM_PROCESS pProcess, _In_ QWORD va, _Out_ PQWORD
 {
     *ppa = 0;
     if(ctxVmm->tpMemoryModel == VMM_MEMORYMODEL_NA) { return FALSE; }
-    return ctxVmm->fnMemoryModel.pfnVirt2Phys(pProcess->paDTB, pProcess->fUserOnly, -1, va, ppa);
+    return ctxVmm->fnMemoryModel.pfnVirt2Phys(pProcess->paDTB, pProcess->fUserOnly, -1, va, ppa, NULL);
+}
+
+/*
+* Translate a virtual address to a physical address and also retrieve the size
+* of the translating page - 4kB or a large page (2MB/4MB/1GB). This allows the
+* caller to translate all other addresses within a large page without further
+* page table walks.
+* -- pProcess
+* -- va
+* -- ppa
+* -- pcbPage = size of the translating page on success.
+* -- return
+*/
+_Success_(return)
+inline BOOL VmmVirt2PhysPage(_In_ PVMM_PROCESS pProcess, _In_ QWORD va, _Out_ PQWORD ppa, _Out_ PQWORD pcbPage)
+{
+    *ppa = 0;
+    *pcbPage = 0x1000;
+    if(ctxVmm->tpMemoryModel == VMM_MEMORYMODEL_NA) { return FALSE; }
+    return ctxVmm->fnMemoryModel.pfnVirt2Phys(pProcess->paDTB, pProcess->fUserOnly, -1, va, ppa, pcbPage);
 }
 
 /*
@@ -1237,6 +1773,30 @@ inline VOID VmmVirt2PhysGetInformation(_Inout_ PVMM_PROCESS pProcess, _Inout_ PV
     ctxVmm->fnMemoryModel.pfnVirt2PhysGetInformation(pProcess, pVirt2PhysInfo);
 }
 
+/*
+* Enable or disable page digest tracking for a process. While enabled a compact
+* digest of each page successfully read by VmmReadScatterVirtual is recorded.
+* Disabling discards previously collected digests.
+* -- pProcess
+* -- fEnable
+* -- return
+*/
+_Success_(return)
+BOOL VmmPageDigest_Enable(_In_ PVMM_PROCESS pProcess, _In_ BOOL fEnable);
+
+/*
+* Retrieve the sorted page addresses whose digest changed (or which were first
+* seen) after a given generation. Pages are only tracked once read.
+* -- pProcess
+* -- qwGenerationSince = generation previously returned in pqwGeneration (0 = all).
+* -- pqwGeneration = receives the current generation.
+* -- pva = buffer to receive page addresses, or NULL to retrieve count only.
+* -- pcva = in: # entries in pva, out: # changed pages.
+* -- return
+*/
+_Success_(return)
+BOOL VmmPageDigest_GetChanged(_In_ PVMM_PROCESS pProcess, _In_ QWORD qwGenerationSince, _Out_ PQWORD pqwGeneration, _Out_writes_opt_(*pcva) PQWORD pva, _Inout_ PDWORD pcva);
+
 /*
 * Retrieve information of the physical2virtual address translation for the
 * supplied process. This function may take time on larger address spaces -
@@ -1252,6 +1812,33 @@ inline VOID VmmVirt2PhysGetInformation(_Inout_ PVMM_PROCESS pProcess, _Inout_ PV
 */
 PVMMOB_PHYS2VIRT_INFORMATION VmmPhys2VirtGetInformation(_In_ PVMM_PROCESS pProcess, _In_ QWORD paTarget);
 
+/*
+* Retrieve the global physical to virtual reverse index. The index is updated
+* if older than VMM_PHYS2VIRT_MAX_AGE_MS. Only processes with a changed PTE
+* map are re-indexed. The index must be enabled by the -phys2virtindex option
+* or by VMMDLL_OPT_CONFIG_PHYS2VIRT_INDEX.
+* CALLER DECREF: return
+* -- return = the index, or NULL if not enabled or on failure.
+*/
+PVMMOB_PHYS2VIRT_INDEX VmmPhys2VirtIndex_Get();
+
+/*
+* Look up the index entries for a physical address.
+* -- pIndex
+* -- pa
+* -- ppe = ptr to receive first entry, entries are sorted on PID and VA.
+* -- return = the number of entries.
+*/
+DWORD VmmPhys2VirtIndex_Lookup(_In_ PVMMOB_PHYS2VIRT_INDEX pIndex, _In_ QWORD pa, _Out_ PVMM_PHYS2VIRT_INDEX_ENTRY *ppe);
+
+/*
+* Enable or disable the global physical to virtual reverse index. Disabling
+* the index releases all memory held by it.
+* -- fEnable
+* -- return
+*/
+BOOL VmmPhys2VirtIndex_Configure(_In_ BOOL fEnable);
+
 /*
 * Retrieve the PTE hardware page table memory map.
 * CALLER DECREF: ppObPteMap
@@ -1357,6 +1944,47 @@ PVMM_MAP_THREADENTRY VmmMap_GetThreadEntry(_In_ PVMMOB_MAP_THREAD pThreadMap, _I
 _Success_(return)
 BOOL VmmMap_GetHandle(_In_ PVMM_PROCESS pProcess, _Out_ PVMMOB_MAP_HANDLE *ppObHandleMap, _In_ BOOL fExtendedText);
 
+/*
+* Retrieve the ADDRESS map - a merged interval index of the PTE, VAD, module
+* and heap maps of a process. Created on first use and re-created whenever a
+* source map changes.
+* CALLER DECREF: ppObAddressMap
+* -- pProcess
+* -- ppObAddressMap
+* -- return
+*/
+_Success_(return)
+BOOL VmmMap_GetAddress(_In_ PVMM_PROCESS pProcess, _Out_ PVMMOB_MAP_ADDRESS *ppObAddressMap);
+
+/*
+* Retrieve a single PVMM_MAP_ADDRESSENTRY for a given AddressMap and address.
+* -- pAddressMap
+* -- va
+* -- return = PTR to ADDRESSENTRY or NULL on fail. Must not be used out of pAddressMap scope.
+*/
+PVMM_MAP_ADDRESSENTRY VmmMap_GetAddressEntry(_In_opt_ PVMMOB_MAP_ADDRESS pAddressMap, _In_ QWORD va);
+
+/*
+* Retrieve all consecutive PVMM_MAP_ADDRESSENTRY overlapping an address range.
+* -- pAddressMap
+* -- vaStart
+* -- vaEnd = inclusive end address.
+* -- pcEntries
+* -- return = PTR to first entry or NULL if none. Must not be used out of pAddressMap scope.
+*/
+PVMM_MAP_ADDRESSENTRY VmmMap_GetAddressEntryRange(_In_opt_ PVMMOB_MAP_ADDRESS pAddressMap, _In_ QWORD vaStart, _In_ QWORD vaEnd, _Out_ PDWORD pcEntries);
+
+/*
+* Bulk lookup of many addresses in an AddressMap. Mostly sorted input is
+* resolved without binary search.
+* -- pAddressMap
+* -- cva
+* -- pva
+* -- ppEntries = receives PTR to ADDRESSENTRY or NULL per address.
+* -- return = number of addresses with a matching entry.
+*/
+DWORD VmmMap_GetAddressEntries(_In_ PVMMOB_MAP_ADDRESS pAddressMap, _In_ DWORD cva, _In_reads_(cva) PQWORD pva, _Out_writes_(cva) PVMM_MAP_ADDRESSENTRY *ppEntries);
+
 /*
 * Retrieve the NETWORK CONNECTION map
 * CALLER DECREF: ppObNetMap
@@ -1384,6 +2012,25 @@ BOOL VmmMap_GetPhysMem(_Out_ PVMMOB_MAP_PHYSMEM *ppObPhysMem);
 _Success_(return)
 BOOL VmmMap_GetUser(_Out_ PVMMOB_MAP_USER *ppObUserMap);
 
+/*
+* Retrieve the PROCESS TREE map (parent/child index of all processes including
+* terminated processes). The map is built once per process table.
+* CALLER DECREF: ppObProcTreeMap
+* -- ppObProcTreeMap
+* -- return
+*/
+_Success_(return)
+BOOL VmmMap_GetProcTree(_Out_ PVMMOB_MAP_PROCTREE *ppObProcTreeMap);
+
+/*
+* Retrieve a single PVMM_MAP_PROCTREEENTRY for a given PID. Ancestors are found
+* by following the iParent index.
+* -- pProcTreeMap
+* -- dwPID
+* -- return = PTR to PROCTREEENTRY or NULL on fail. Must not be used out of pProcTreeMap scope.
+*/
+PVMM_MAP_PROCTREEENTRY VmmMap_GetProcTreeEntry(_In_opt_ PVMMOB_MAP_PROCTREE pProcTreeMap, _In_ DWORD dwPID);
+
 /*
 * Retrieve a process for a given PID and optional PVMMOB_PROCESS_TABLE.
 * CALLER DECREF: return
@@ -1502,6 +2149,53 @@ VOID VmmProcessCreateFinish();
 */
 VOID VmmProcessListPIDs(_Out_writes_opt_(*pcPIDs) PDWORD pPIDs, _Inout_ PSIZE_T pcPIDs, _In_ QWORD flags);
 
+/*
+* Begin a consistent analysis snapshot. The currently active process table,
+* the global maps and the page digest generation are pinned and destructive
+* background refreshes are deferred until all snapshots have ended (or
+* VMM_SNAPSHOT_DEFER_MS_MAX has elapsed). While the snapshot is active process
+* and global map lookups are made against the pinned objects. A snapshot
+* expires VMM_SNAPSHOT_DEFER_MS_MAX after it began.
+* -- pqwSnapshotId = receives snapshot to pass to VmmSnapshotEnd.
+* -- return
+*/
+_Success_(return)
+BOOL VmmSnapshotBegin(_Out_ PQWORD pqwSnapshotId);
+
+/*
+* End a snapshot started by VmmSnapshotBegin.
+* -- qwSnapshotId
+* -- return = TRUE if the snapshot was active, FALSE if not found or expired.
+*/
+_Success_(return)
+BOOL VmmSnapshotEnd(_In_ QWORD qwSnapshotId);
+
+/*
+* Retrieve the most recently begun snapshot, if it's active and not expired.
+* CALLER DECREF: return
+* -- return
+*/
+PVMMOB_SNAPSHOT VmmSnapshotGetActive();
+
+/*
+* Pin a global map into a snapshot unless one is already pinned. Retrieve the
+* pinned map. If pObMap is NULL the currently pinned map (if any) is returned.
+* FUNCTION DECREF: pObMap
+* CALLER DECREF: return
+* -- pSnapshot
+* -- iMap = VMM_SNAPSHOT_MAP_*
+* -- pObMap
+* -- return
+*/
+PVOID VmmSnapshot_MapPin(_In_ PVMMOB_SNAPSHOT pSnapshot, _In_ DWORD iMap, _In_opt_ _Post_ptr_invalid_ PVOID pObMap);
+
+/*
+* Check whether destructive background refreshes should currently be deferred
+* due to active snapshots.
+* -- return
+*/
+BOOL VmmSnapshotIsRefreshDeferred();
+
 /*
 * Schedule an asynchronous work item onto a worker thread.
 * NB! longer running functions must monitor ctxVmm->Work.fEnabled and exit
@@ -1512,6 +2206,114 @@ VOID VmmProcessListPIDs(_Out_writes_opt_(*pcPIDs) PDWORD pPIDs, _Inout_ PSIZE_T
 */
 VOID VmmWork(_In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx, _In_opt_ HANDLE hEventFinish);
 
+/*
+* Schedule an asynchronous work item onto a worker thread with a priority.
+* Work of higher priority is always taken before work of lower priority. Work
+* scheduled from a worker thread is queued on its own deque and is stolen by
+* idle worker threads if the scheduling thread is busy.
+* -- pfn
+* -- ctx = optional context to provide to the pfn function.
+* -- hEventFinish = optional event with will be set upon work completion.
+* -- dwPriority = VMMWORK_PRIORITY_*
+* -- return
+*/
+_Success_(return)
+BOOL VmmWorkEx(_In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx, _In_opt_ HANDLE hEventFinish, _In_ DWORD dwPriority);
+
+/*
+* Schedule an asynchronous work item whose context holds a reference owned by
+* the work item. The work function releases the reference itself when run -
+* pfnRelease is called instead if the work item is discarded on shutdown.
+* -- pfn
+* -- ctx = context to provide to the pfn and pfnRelease functions.
+* -- pfnRelease = function releasing ctx if the work item is never run.
+* -- dwPriority = VMMWORK_PRIORITY_*
+* -- return = TRUE if scheduled, FALSE if not (ctx is not released).
+*/
+_Success_(return)
+BOOL VmmWorkRelease(_In_ LPTHREAD_START_ROUTINE pfn, _In_ PVOID ctx, _In_ VOID(*pfnRelease)(_In_ PVOID ctx), _In_ DWORD dwPriority);
+
+typedef struct tdVMMOB_WORK_FUTURE {
+    OB ObHdr;
+    HANDLE hEventFinish;
+    BOOL fCompleted;            // work function was executed (not discarded on shutdown)
+    DWORD dwResult;             // return value of the work function
+} VMMOB_WORK_FUTURE, *PVMMOB_WORK_FUTURE;
+
+/*
+* Schedule an asynchronous work item and retrieve a future which completes
+* with the return value of the work function.
+* CALLER DECREF: return
+* -- pfn
+* -- ctx = optional context to provide to the pfn function.
+* -- dwPriority = VMMWORK_PRIORITY_*
+* -- return = future, or NULL on fail.
+*/
+PVMMOB_WORK_FUTURE VmmWorkFuture(_In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx, _In_ DWORD dwPriority);
+
+/*
+* Wait for a future to complete.
+* NB! waiting on a future from a worker thread occupies that worker thread.
+* -- pFuture
+* -- dwMilliseconds = timeout or INFINITE.
+* -- pdwResult = return value of the work function.
+* -- return = TRUE if the work function was executed and completed in time.
+*/
+_Success_(return)
+BOOL VmmWorkFuture_Wait(_In_ PVMMOB_WORK_FUTURE pFuture, _In_ DWORD dwMilliseconds, _Out_opt_ PDWORD pdwResult);
+
+typedef struct tdVMMOB_WORK_PARALLEL {
+    OB ObHdr;
+    HANDLE hEventFinish;
+    VOID(*pfnItem)(_In_opt_ PVOID ctx, _In_ DWORD i);
+    PVOID ctx;
+    DWORD c;
+    volatile LONG iNext;        // next item to claim
+    volatile LONG cRemaining;   // items not yet completed - hEventFinish is set on zero.
+} VMMOB_WORK_PARALLEL, *PVMMOB_WORK_PARALLEL;
+
+/*
+* Start parallel processing of the items [0, c) on up to cThread worker
+* threads. Items are claimed one at a time - both by the worker threads and by
+* the calling thread in VmmWorkParallel_ClaimOne() / VmmWorkParallel_Finish().
+* Callers only ever wait for items in progress on other threads - never for
+* queued work units - it is thus safe to use from within a worker thread.
+* ctx is only accessed by claimed items and may be stack allocated; queued
+* work units started after all items are claimed exit without touching it.
+* CALLER VmmWorkParallel_Finish: return
+* -- c = number of items.
+* -- cThread = max number of worker threads in addition to the caller.
+* -- pfnItem = function to process item i.
+* -- ctx = optional context to provide to pfnItem.
+* -- return = parallel context, or NULL on fail.
+*/
+PVMMOB_WORK_PARALLEL VmmWorkParallel_Start(_In_ DWORD c, _In_ DWORD cThread, _In_ VOID(*pfnItem)(_In_opt_ PVOID ctx, _In_ DWORD i), _In_opt_ PVOID ctx);
+
+/*
+* Claim and process one item in the calling thread.
+* -- pWork
+* -- return = TRUE if an item was processed, FALSE if no unclaimed items remain.
+*/
+BOOL VmmWorkParallel_ClaimOne(_In_ PVMMOB_WORK_PARALLEL pWork);
+
+/*
+* Process all remaining unclaimed items in the calling thread, wait for items
+* in progress on worker threads and release the parallel context.
+* -- pObWork
+*/
+VOID VmmWorkParallel_Finish(_In_opt_ _Post_ptr_invalid_ PVMMOB_WORK_PARALLEL pObWork);
+
+/*
+* Process the items [0, c) in parallel on up to cThread worker threads and on
+* the calling thread and return once all items are completed. Items are
+* processed by the calling thread only if parallel processing is unavailable.
+* -- c = number of items.
+* -- cThread = max number of worker threads in addition to the caller.
+* -- pfnItem = function to process item i.
+* -- ctx = optional context to provide to pfnItem.
+*/
+VOID VmmWorkParallel(_In_ DWORD c, _In_ DWORD cThread, _In_ VOID(*pfnItem)(_In_opt_ PVOID ctx, _In_ DWORD i), _In_opt_ PVOID ctx);
+
 /*
 * Perform multi-threaded parallel processing of processes in the process table.
 * This is useful when slow I/O should take place on multiple or all processes
@@ -1534,6 +2336,35 @@ VOID VmmProcessActionForeachParallel(
     _In_ VOID(*pfnAction)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx)
 );
 
+#define VMM_PROCESS_ACTION_FOREACH_CHUNK_DEFAULT    1
+
+/*
+* Perform multi-threaded parallel processing of processes in the process table
+* in chunks with optional cancellation and streamed results.
+* Worker threads (and the calling thread) claim chunks of cChunk processes at
+* a time - a slow process only delays the chunk it belongs to. The optional
+* pfnResult callback receives the result of each pfnAction as soon as the
+* process completes. Calls to pfnResult are serialized (but not ordered).
+* The processing stops as soon as *pfCancel is set to TRUE.
+* NB! Manipulation of ctx in pfnAction callback function must be thread-safe!
+* -- ctxAction = optional context forwarded to callback functions.
+* -- cChunk = number of processes per claimed chunk (0 = default).
+* -- pfCancel = optional cancellation token - set to TRUE to cancel.
+* -- pfnCriteria = optional callback function selecting which processes to process.
+* -- pfnAction = processing function to be called in multi-threaded context.
+* -- pfnResult = optional callback receiving the pfnAction result per process.
+* -- return = TRUE if all selected processes were processed (not cancelled).
+*/
+_Success_(return)
+BOOL VmmProcessActionForeachParallelEx(
+    _In_opt_ PVOID ctxAction,
+    _In_ DWORD cChunk,
+    _In_opt_ PBOOL pfCancel,
+    _In_opt_ BOOL(*pfnCriteria)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx),
+    _In_ PVOID(*pfnAction)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx),
+    _In_opt_ VOID(*pfnResult)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID pvResult, _In_opt_ PVOID ctx)
+);
+
 /*
 * Commonly used criteria - only process active processes instead of all processes
 * (which may include terminated processes as well).
@@ -1549,12 +2380,42 @@ BOOL VmmProcessActionForeachParallel_CriteriaActiveOnly(_In_ PVMM_PROCESS pProce
 */
 VOID VmmCacheClear(_In_ DWORD dwTblTag);
 
+/*
+* Revalidate the page table (TLB) cache against the memory acquisition device.
+* Cached page tables are re-read in large scatter batches and compared to the
+* cached copy - only changed (or unreadable) entries are invalidated by calling
+* VmmCacheInvalidate. Used instead of VmmCacheClear(VMM_CACHE_TAG_TLB) to keep
+* the TLB cache warm while still tracking a live system.
+*/
+VOID VmmTlbRevalidate();
+
 /*
 * Invalidate cache entries belonging to a specific physical address.
 * -- pa
 */
 VOID VmmCacheInvalidate(_In_ QWORD pa);
 
+/*
+* Read from the memory acquisition device by calling LcReadScatter. The call
+* is timed and device read statistics are updated (ctxVmm->stat.cDeviceRead*).
+* Reads are scheduled in two priority classes: interactive (default) and bulk
+* (VMM_FLAG_PRIORITY_BULK). Bulk reads are split into slices and each slice is
+* delayed while interactive reads are active - up to a max wait per slice.
+* -- cpMEMs
+* -- ppMEMs
+* -- flags = flags as in VMM_FLAG_*, [VMM_FLAG_PRIORITY_BULK]
+*/
+VOID VmmDeviceReadScatter(_In_ DWORD cpMEMs, _Inout_ PPMEM_SCATTER ppMEMs, _In_ QWORD flags);
+
+/*
+* Track external (api/vfs) calls. Background activity such as the map warm-up
+* yields to active external calls only - not to device reads issued by its own
+* worker threads. ctxVmm->DeviceSched.CondIdle is signalled when the last
+* active external call ends.
+*/
+VOID VmmDeviceSched_ExternalBegin();
+VOID VmmDeviceSched_ExternalEnd();
+
 /*
 * Prefetch a set of addresses contained in pPrefetchPages into the cache. This
 * is useful when reading data from somewhat known addresses over higher latency
@@ -0,0 +1,349 @@
+// vmmdevtrace.c : implementation of the device read trace recorder and of the
+//                 deterministic trace replay device.
+//
+// Recording: each device read batch is appended to the trace file as a batch
+// header followed by one entry per MEM_SCATTER and its data. Successful reads
+// of all zero pages are stored without data to keep traces compact. Batches
+// are written serialized by a lock in the order they complete.
+//
+// Replay: the trace file is memory mapped read-only and all entries are
+// indexed by address (successful reads take precedence, otherwise the first
+// recorded read wins). Reads are served from the index and delayed by the
+// mean per-page device time of the recording to keep the relative cost of
+// device reads realistic when benchmarking cache and read-ahead changes.
+//
+// (c) MemProcFS contributors, 2020
+// Author: MemProcFS contributors
+//
+
+#include "vmmdevtrace.h"
+
+#define VMMDEVTRACE_READ_PAGES_MAX      0x1000      // max pages per contiguous read scatter batch
+
+typedef struct tdVMMDEVTRACE_CONTEXT {
+    BOOL fReplay;
+    QWORD qwFreq;
+    struct {
+        SRWLOCK LockSRW;
+        FILE *hFile;
+        QWORD tmStart;
+        VMMDEVTRACE_HEADER Hdr;
+    } Record;
+    struct {
+        HANDLE hFile;
+        HANDLE hMap;
+        PBYTE pb;
+        QWORD cb;
+        POB_MAP pmEntry;            // qwA -> PVMMDEVTRACE_ENTRY
+        QWORD cNsPage;              // simulated device time per page (in nS)
+    } Replay;
+} VMMDEVTRACE_CONTEXT, *PVMMDEVTRACE_CONTEXT;
+
+// ----------------------------------------------------------------------------
+// RECORD FUNCTIONALITY BELOW:
+// ----------------------------------------------------------------------------
+
+BOOL VmmDevTrace_IsZero(_In_reads_(cb) PBYTE pb, _In_ DWORD cb)
+{
+    DWORD i;
+    for(i = 0; i + 8 <= cb; i += 8) {
+        if(*(PQWORD)(pb + i)) { return FALSE; }
+    }
+    for(; i < cb; i++) {
+        if(pb[i]) { return FALSE; }
+    }
+    return TRUE;
+}
+
+/*
+* Append a completed device read batch to the trace file. On write failure
+* recording is stopped - the trace is valid up until the last complete batch.
+* -- ctx
+* -- cpMEMs
+* -- ppMEMs
+* -- tmStart
+* -- tmEnd
+*/
+VOID VmmDevTrace_RecordBatch(_In_ PVMMDEVTRACE_CONTEXT ctx, _In_ DWORD cpMEMs, _In_ PPMEM_SCATTER ppMEMs, _In_ QWORD tmStart, _In_ QWORD tmEnd)
+{
+    DWORD i;
+    BOOL fResult = TRUE;
+    PMEM_SCATTER pMEM;
+    VMMDEVTRACE_BATCH b;
+    VMMDEVTRACE_ENTRY e;
+    b.cEntry = cpMEMs;
+    b.cUs = (DWORD)min(0xffffffff, (tmEnd - tmStart) * 1000000ULL / ctx->qwFreq);
+    b.tmUs = (tmStart - ctx->Record.tmStart) * 1000000ULL / ctx->qwFreq;
+    AcquireSRWLockExclusive(&ctx->Record.LockSRW);
+    if(!ctx->Record.hFile) { goto finish; }
+    fResult = (1 == fwrite(&b, sizeof(VMMDEVTRACE_BATCH), 1, ctx->Record.hFile));
+    for(i = 0; fResult && (i < cpMEMs); i++) {
+        pMEM = ppMEMs[i];
+        e.qwA = pMEM->qwA;
+        e.cb = pMEM->cb;
+        e.tp = !pMEM->f ? VMMDEVTRACE_ENTRY_FAIL : (VmmDevTrace_IsZero(pMEM->pb, pMEM->cb) ? VMMDEVTRACE_ENTRY_ZERO : VMMDEVTRACE_ENTRY_DATA);
+        fResult = (1 == fwrite(&e, sizeof(VMMDEVTRACE_ENTRY), 1, ctx->Record.hFile));
+        if(fResult && (e.tp == VMMDEVTRACE_ENTRY_DATA)) {
+            fResult = (1 == fwrite(pMEM->pb, pMEM->cb, 1, ctx->Record.hFile));
+        }
+    }
+    if(fResult) {
+        ctx->Record.Hdr.cBatch++;
+        ctx->Record.Hdr.cEntry += cpMEMs;
+        ctx->Record.Hdr.tmUs += b.cUs;
+    } else {
+        vmmprintf("MemProcFS: Failed writing device trace - recording stopped.\n");
+        fclose(ctx->Record.hFile);
+        ctx->Record.hFile = NULL;
+    }
+finish:
+    ReleaseSRWLockExclusive(&ctx->Record.LockSRW);
+}
+
+_Success_(return)
+BOOL VmmDevTrace_RecordInitialize()
+{
+    PVMMDEVTRACE_CONTEXT ctx;
+    if(!ctxMain->cfg.szDeviceRecord[0] || ctxMain->pvDevTrace) { return FALSE; }
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMDEVTRACE_CONTEXT)))) { return FALSE; }
+    InitializeSRWLock(&ctx->Record.LockSRW);
+    QueryPerformanceFrequency((PLARGE_INTEGER)&ctx->qwFreq);
+    if(fopen_s(&ctx->Record.hFile, ctxMain->cfg.szDeviceRecord, "wb") || !ctx->Record.hFile) {
+        vmmprintf("MemProcFS: Failed to create device trace file: '%s'.\n", ctxMain->cfg.szDeviceRecord);
+        LocalFree(ctx);
+        return FALSE;
+    }
+    ctx->Record.Hdr.dwMagic = VMMDEVTRACE_MAGIC;
+    ctx->Record.Hdr.dwVersion = VMMDEVTRACE_VERSION;
+    ctx->Record.Hdr.paMax = ctxMain->dev.paMax;
+    ctx->Record.Hdr.fVolatile = ctxMain->dev.fVolatile;
+    ctx->Record.Hdr.fRemote = ctxMain->dev.fRemote;
+    strncpy_s(ctx->Record.Hdr.szDeviceName, _countof(ctx->Record.Hdr.szDeviceName), ctxMain->dev.szDeviceName, _TRUNCATE);
+    if(1 != fwrite(&ctx->Record.Hdr, sizeof(VMMDEVTRACE_HEADER), 1, ctx->Record.hFile)) {
+        fclose(ctx->Record.hFile);
+        LocalFree(ctx);
+        return FALSE;
+    }
+    // memory mapped raw memory dump files bypass the device - disable them.
+    ctxMain->cfg.fDisableFileMap = TRUE;
+    QueryPerformanceCounter((PLARGE_INTEGER)&ctx->Record.tmStart);
+    ctxMain->pvDevTrace = ctx;
+    vmmprintfv("MemProcFS: Recording device reads to trace file: '%s'.\n", ctxMain->cfg.szDeviceRecord);
+    return TRUE;
+}
+
+/*
+* Finish the recording by updating the trace header (memory map and batch
+* counts may have changed since the recording was started).
+* -- ctx
+*/
+VOID VmmDevTrace_RecordClose(_In_ PVMMDEVTRACE_CONTEXT ctx)
+{
+    AcquireSRWLockExclusive(&ctx->Record.LockSRW);
+    if(ctx->Record.hFile) {
+        ctx->Record.Hdr.paMax = ctxMain->dev.paMax;
+        if(!_fseeki64(ctx->Record.hFile, 0, SEEK_SET)) {
+            fwrite(&ctx->Record.Hdr, sizeof(VMMDEVTRACE_HEADER), 1, ctx->Record.hFile);
+        }
+        fclose(ctx->Record.hFile);
+        ctx->Record.hFile = NULL;
+    }
+    ReleaseSRWLockExclusive(&ctx->Record.LockSRW);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// REPLAY FUNCTIONALITY BELOW:
+// ----------------------------------------------------------------------------
+
+/*
+* Index the entries of the memory mapped trace by address.
+* -- ctx
+* -- return
+*/
+_Success_(return)
+BOOL VmmDevTrace_ReplayIndex(_In_ PVMMDEVTRACE_CONTEXT ctx)
+{
+    QWORD i, o, cPages = 0, tmUs = 0;
+    PVMMDEVTRACE_BATCH pb;
+    PVMMDEVTRACE_ENTRY pe, peIndex;
+    o = sizeof(VMMDEVTRACE_HEADER);
+    while(o + sizeof(VMMDEVTRACE_BATCH) <= ctx->Replay.cb) {
+        pb = (PVMMDEVTRACE_BATCH)(ctx->Replay.pb + o);
+        o += sizeof(VMMDEVTRACE_BATCH);
+        for(i = 0; i < pb->cEntry; i++) {
+            if(o + sizeof(VMMDEVTRACE_ENTRY) > ctx->Replay.cb) { goto truncated; }
+            pe = (PVMMDEVTRACE_ENTRY)(ctx->Replay.pb + o);
+            o += sizeof(VMMDEVTRACE_ENTRY);
+            if((pe->cb > 0x1000) || (pe->tp > VMMDEVTRACE_ENTRY_ZERO)) { return FALSE; }
+            if(pe->tp == VMMDEVTRACE_ENTRY_DATA) {
+                if(o + pe->cb > ctx->Replay.cb) { goto truncated; }
+                o += pe->cb;
+            }
+            peIndex = ObMap_GetByKey(ctx->Replay.pmEntry, pe->qwA);
+            if(peIndex && (peIndex->tp == VMMDEVTRACE_ENTRY_FAIL) && (pe->tp != VMMDEVTRACE_ENTRY_FAIL)) {
+                ObMap_RemoveByKey(ctx->Replay.pmEntry, pe->qwA);
+                peIndex = NULL;
+            }
+            if(!peIndex) {
+                ObMap_Push(ctx->Replay.pmEntry, pe->qwA, pe);
+            }
+        }
+        cPages += pb->cEntry;
+        tmUs += pb->cUs;
+    }
+truncated:
+    ctx->Replay.cNsPage = cPages ? (tmUs * 1000 / cPages) : 0;
+    return TRUE;
+}
+
+_Success_(return)
+BOOL VmmDevTrace_ReplayInitialize()
+{
+    LARGE_INTEGER cbFile;
+    PVMMDEVTRACE_HEADER pHdr;
+    PVMMDEVTRACE_CONTEXT ctx;
+    if(!ctxMain->cfg.szDeviceReplay[0] || ctxMain->pvDevTrace) { return FALSE; }
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMDEVTRACE_CONTEXT)))) { return FALSE; }
+    ctx->fReplay = TRUE;
+    QueryPerformanceFrequency((PLARGE_INTEGER)&ctx->qwFreq);
+    ctx->Replay.hFile = CreateFileA(ctxMain->cfg.szDeviceReplay, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(ctx->Replay.hFile == INVALID_HANDLE_VALUE) {
+        ctx->Replay.hFile = NULL;
+        goto fail;
+    }
+    if(!GetFileSizeEx(ctx->Replay.hFile, &cbFile) || ((QWORD)cbFile.QuadPart < sizeof(VMMDEVTRACE_HEADER))) { goto fail; }
+    if(!(ctx->Replay.hMap = CreateFileMappingA(ctx->Replay.hFile, NULL, PAGE_READONLY, 0, 0, NULL))) { goto fail; }
+    if(!(ctx->Replay.pb = MapViewOfFile(ctx->Replay.hMap, FILE_MAP_READ, 0, 0, 0))) { goto fail; }
+    ctx->Replay.cb = cbFile.QuadPart;
+    pHdr = (PVMMDEVTRACE_HEADER)ctx->Replay.pb;
+    if((pHdr->dwMagic != VMMDEVTRACE_MAGIC) || (pHdr->dwVersion != VMMDEVTRACE_VERSION)) { goto fail; }
+    if(!(ctx->Replay.pmEntry = ObMap_New(0))) { goto fail; }
+    if(!VmmDevTrace_ReplayIndex(ctx)) { goto fail; }
+    ObMap_Freeze(ctx->Replay.pmEntry);     // read-only from here on - replay lookups take no lock
+    // populate the device config from the trace - no leechcore device exists.
+    ctxMain->dev.paMax = pHdr->paMax;
+    ctxMain->dev.fVolatile = pHdr->fVolatile;
+    ctxMain->dev.fRemote = pHdr->fRemote;
+    ctxMain->dev.fWritable = FALSE;
+    ctxMain->dev.fRemoteDisableCompress = FALSE;
+    strcpy_s(ctxMain->dev.szDeviceName, _countof(ctxMain->dev.szDeviceName), "replay");
+    ctxMain->pvDevTrace = ctx;
+    vmmprintfv("MemProcFS: Replaying device trace '%s' (recorded on '%.31s', %lli pages indexed, %lli nS/page).\n",
+        ctxMain->cfg.szDeviceReplay, pHdr->szDeviceName, (QWORD)ObMap_Size(ctx->Replay.pmEntry), ctx->Replay.cNsPage);
+    return TRUE;
+fail:
+    vmmprintf("MemProcFS: Failed to open device trace file: '%s'.\n", ctxMain->cfg.szDeviceReplay);
+    ctxMain->pvDevTrace = ctx;
+    VmmDevTrace_Close();
+    return FALSE;
+}
+
+/*
+* Delay a replayed read according to the recorded mean per-page device time.
+* -- ctx
+* -- cpMEMs
+*/
+VOID VmmDevTrace_ReplayDelay(_In_ PVMMDEVTRACE_CONTEXT ctx, _In_ DWORD cpMEMs)
+{
+    QWORD tmStart, tmNow, tmDelay;
+    if(!ctx->Replay.cNsPage) { return; }
+    tmDelay = ctx->Replay.cNsPage * cpMEMs * ctx->qwFreq / 1000000000ULL;
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmStart);
+    do {
+        SwitchToThread();
+        QueryPerformanceCounter((PLARGE_INTEGER)&tmNow);
+    } while(tmNow - tmStart < tmDelay);
+}
+
+VOID VmmDevTrace_ReplayReadScatter(_In_ PVMMDEVTRACE_CONTEXT ctx, _In_ DWORD cpMEMs, _Inout_ PPMEM_SCATTER ppMEMs)
+{
+    DWORD i, o;
+    PMEM_SCATTER pMEM;
+    PVMMDEVTRACE_ENTRY pe;
+    for(i = 0; i < cpMEMs; i++) {
+        pMEM = ppMEMs[i];
+        if(pMEM->f || !MEM_SCATTER_ADDR_ISVALID(pMEM)) { continue; }
+        o = 0;
+        pe = ObMap_GetByKey(ctx->Replay.pmEntry, pMEM->qwA);
+        if(!pe || (pe->cb < pMEM->cb)) {
+            // sub-page read not recorded as such - serve from the page read.
+            o = pMEM->qwA & 0xfff;
+            pe = ObMap_GetByKey(ctx->Replay.pmEntry, pMEM->qwA & ~0xfff);
+        }
+        if(!pe || (pe->tp == VMMDEVTRACE_ENTRY_FAIL) || (o + pMEM->cb > pe->cb)) { continue; }
+        if(pe->tp == VMMDEVTRACE_ENTRY_ZERO) {
+            ZeroMemory(pMEM->pb, pMEM->cb);
+        } else {
+            memcpy(pMEM->pb, (PBYTE)(pe + 1) + o, pMEM->cb);
+        }
+        pMEM->f = TRUE;
+    }
+    VmmDevTrace_ReplayDelay(ctx, cpMEMs);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// GENERAL FUNCTIONALITY BELOW:
+// ----------------------------------------------------------------------------
+
+VOID VmmDevTrace_Close()
+{
+    PVMMDEVTRACE_CONTEXT ctx = (PVMMDEVTRACE_CONTEXT)ctxMain->pvDevTrace;
+    if(!ctx) { return; }
+    ctxMain->pvDevTrace = NULL;
+    if(ctx->fReplay) {
+        Ob_DECREF(ctx->Replay.pmEntry);
+        if(ctx->Replay.pb) { UnmapViewOfFile(ctx->Replay.pb); }
+        if(ctx->Replay.hMap) { CloseHandle(ctx->Replay.hMap); }
+        if(ctx->Replay.hFile) { CloseHandle(ctx->Replay.hFile); }
+    } else {
+        VmmDevTrace_RecordClose(ctx);
+    }
+    LocalFree(ctx);
+}
+
+VOID VmmDevTrace_ReadScatter(_In_ DWORD cpMEMs, _Inout_ PPMEM_SCATTER ppMEMs)
+{
+    QWORD tmStart, tmEnd;
+    PVMMDEVTRACE_CONTEXT ctx = (PVMMDEVTRACE_CONTEXT)ctxMain->pvDevTrace;
+    if(!ctx) {
+        LcReadScatter(ctxMain->hLC, cpMEMs, ppMEMs);
+        return;
+    }
+    if(ctx->fReplay) {
+        VmmDevTrace_ReplayReadScatter(ctx, cpMEMs, ppMEMs);
+        return;
+    }
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmStart);
+    LcReadScatter(ctxMain->hLC, cpMEMs, ppMEMs);
+    QueryPerformanceCounter((PLARGE_INTEGER)&tmEnd);
+    VmmDevTrace_RecordBatch(ctx, cpMEMs, ppMEMs, tmStart, tmEnd);
+}
+
+_Success_(return)
+BOOL VmmDevTrace_Read(_In_ QWORD pa, _In_ DWORD cb, _Out_writes_(cb) PBYTE pb)
+{
+    BOOL fResult = TRUE;
+    DWORD i, iBatch, cMEMs, cBatch;
+    PPMEM_SCATTER ppMEMs = NULL;
+    if(!ctxMain->pvDevTrace || (pa & 0xfff) || (cb & 0xfff)) {
+        return LcRead(ctxMain->hLC, pa, cb, pb);
+    }
+    cMEMs = cb >> 12;
+    if(!LcAllocScatter2(cb, pb, cMEMs, &ppMEMs)) { return FALSE; }
+    for(i = 0; i < cMEMs; i++) {
+        ppMEMs[i]->qwA = pa + ((QWORD)i << 12);
+    }
+    for(iBatch = 0; iBatch < cMEMs; iBatch += VMMDEVTRACE_READ_PAGES_MAX) {
+        cBatch = min(VMMDEVTRACE_READ_PAGES_MAX, cMEMs - iBatch);
+        VmmDevTrace_ReadScatter(cBatch, ppMEMs + iBatch);
+    }
+    for(i = 0; i < cMEMs; i++) {
+        fResult = fResult && ppMEMs[i]->f;
+    }
+    LcMemFree(ppMEMs);
+    return fResult;
+}
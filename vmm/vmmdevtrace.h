@@ -0,0 +1,92 @@
+// vmmdevtrace.h : declarations of the device read trace recorder and of the
+//                 deterministic trace replay device.
+//
+// A device trace is a compact binary recording of all physical memory read
+// batches issued to the memory acquisition device (LcReadScatter boundary).
+// The trace may be replayed as a virtual device - without the original
+// device or memory dump - to benchmark cache and read-ahead changes against
+// recorded analysis sessions offline.
+//
+// (c) MemProcFS contributors, 2020
+// Author: MemProcFS contributors
+//
+
+#ifndef __VMMDEVTRACE_H__
+#define __VMMDEVTRACE_H__
+#include "vmm.h"
+
+#define VMMDEVTRACE_MAGIC           0x43525456      // 'VTRC'
+#define VMMDEVTRACE_VERSION         1
+
+#define VMMDEVTRACE_ENTRY_FAIL      0
+#define VMMDEVTRACE_ENTRY_DATA      1               // cb bytes of data follows the entry
+#define VMMDEVTRACE_ENTRY_ZERO      2               // successful read of all zero data - no data follows
+
+typedef struct tdVMMDEVTRACE_HEADER {
+    DWORD dwMagic;                  // VMMDEVTRACE_MAGIC
+    DWORD dwVersion;                // VMMDEVTRACE_VERSION
+    QWORD paMax;
+    BOOL fVolatile;
+    BOOL fRemote;
+    QWORD cBatch;
+    QWORD cEntry;
+    QWORD tmUs;                     // total device time of all batches (in uS)
+    CHAR szDeviceName[32];
+} VMMDEVTRACE_HEADER, *PVMMDEVTRACE_HEADER;
+
+// a batch is followed by cEntry entries each followed by its data (if any).
+typedef struct tdVMMDEVTRACE_BATCH {
+    DWORD cEntry;
+    DWORD cUs;                      // device time of batch (in uS)
+    QWORD tmUs;                     // start of batch relative to start of trace (in uS)
+} VMMDEVTRACE_BATCH, *PVMMDEVTRACE_BATCH;
+
+typedef struct tdVMMDEVTRACE_ENTRY {
+    QWORD qwA;
+    DWORD cb;
+    DWORD tp;                       // VMMDEVTRACE_ENTRY_*
+} VMMDEVTRACE_ENTRY, *PVMMDEVTRACE_ENTRY;
+
+/*
+* Initialize the replay device from the trace file given in the -devicereplay
+* option. This replaces the creation of the LeechCore device - ctxMain->dev
+* is populated from the trace and ctxMain->hLC is left NULL.
+* -- return
+*/
+_Success_(return)
+BOOL VmmDevTrace_ReplayInitialize();
+
+/*
+* Start recording device reads to the trace file given in the -devicerecord
+* option. Must be called after the LeechCore device is created and before any
+* physical memory is read through the vmm.
+* -- return
+*/
+_Success_(return)
+BOOL VmmDevTrace_RecordInitialize();
+
+/*
+* Finish any ongoing recording and close any trace.
+*/
+VOID VmmDevTrace_Close();
+
+/*
+* Read from the device, the replay device if replaying. The read is recorded
+* if recording. This is the LcReadScatter boundary of the vmm.
+* -- cpMEMs
+* -- ppMEMs
+*/
+VOID VmmDevTrace_ReadScatter(_In_ DWORD cpMEMs, _Inout_ PPMEM_SCATTER ppMEMs);
+
+/*
+* Read contiguous physical memory from the device - replacement for LcRead
+* which honors recording and replay. The read should be page aligned.
+* -- pa
+* -- cb
+* -- pb
+* -- return = TRUE if all memory was read successfully.
+*/
+_Success_(return)
+BOOL VmmDevTrace_Read(_In_ QWORD pa, _In_ DWORD cb, _Out_writes_(cb) PBYTE pb);
+
+#endif /* __VMMDEVTRACE_H__ */
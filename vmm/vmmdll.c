@@ -14,11 +14,15 @@
 #include "statistics.h"
 #include "version.h"
 #include "vmm.h"
+#include "vmmdevtrace.h"
+#include "vmmmembudget.h"
 #include "vmmproc.h"
+#include "vmmsearch.h"
 #include "vmmwin.h"
 #include "vmmwinnet.h"
 #include "vmmwinobj.h"
 #include "vmmwinreg.h"
+#include "mm.h"
 #include "mm_pfn.h"
 
 // ----------------------------------------------------------------------------
@@ -32,7 +36,9 @@
     BOOL result;                                                        \
     if(!ctxVmm) { return FALSE; }                                       \
     tm = Statistics_CallStart();                                        \
+    VmmDeviceSched_ExternalBegin();                                     \
     result = fn;                                                        \
+    VmmDeviceSched_ExternalEnd();                                       \
     Statistics_CallEnd(id, tm);                                         \
     return result;                                                      \
 }
@@ -42,7 +48,9 @@
     RetTp retVal;                                                       \
     if(!ctxVmm) { return ((RetTp)RetValFail); } /* UNSUCCESSFUL */      \
     tm = Statistics_CallStart();                                        \
+    VmmDeviceSched_ExternalBegin();                                     \
     retVal = fn;                                                        \
+    VmmDeviceSched_ExternalEnd();                                       \
     Statistics_CallEnd(id, tm);                                         \
     return retVal;                                                      \
 }
@@ -96,6 +104,30 @@ BOOL VmmDll_ConfigIntialize(_In_ DWORD argc, _In_ char* argv[])
             ctxMain->cfg.fWaitInitialize = TRUE;
             i++;
             continue;
+        } else if(0 == _stricmp(argv[i], "-noprofile")) {
+            ctxMain->cfg.fDisableProfile = TRUE;
+            i++;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-nofilemap")) {
+            ctxMain->cfg.fDisableFileMap = TRUE;
+            i++;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-cache2q")) {
+            ctxMain->cfg.fCachePhys2Q = TRUE;
+            i++;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-phys2virtindex")) {
+            ctxMain->cfg.fPhys2VirtIndex = TRUE;
+            i++;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-reglazy")) {
+            ctxMain->cfg.fRegistryLazy = TRUE;
+            i++;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-pluginlazy")) {
+            ctxMain->cfg.fPluginLazy = TRUE;
+            i++;
+            continue;
         } else if(i + 1 >= argc) {
             return FALSE;
         } else if(0 == _stricmp(argv[i], "-cr3")) {
@@ -107,6 +139,55 @@ BOOL VmmDll_ConfigIntialize(_In_ DWORD argc, _In_ char* argv[])
             if(ctxMain->cfg.tpForensicMode > FC_DATABASE_TYPE_MAX) { return FALSE; }
             i += 2;
             continue;
+        } else if(0 == _stricmp(argv[i], "-cachesize")) {
+            ctxMain->cfg.cMBCachePhys = (DWORD)Util_GetNumericA(argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-cachesizetlb")) {
+            ctxMain->cfg.cMBCacheTlb = (DWORD)Util_GetNumericA(argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-cachesizepaging")) {
+            ctxMain->cfg.cMBCachePaging = (DWORD)Util_GetNumericA(argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-cachecompress")) {
+            ctxMain->cfg.cMBCacheCompress = (DWORD)Util_GetNumericA(argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-membudget")) {
+            ctxMain->cfg.cMBMemoryBudget = (DWORD)Util_GetNumericA(argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-cachesizeprototype")) {
+            ctxMain->cfg.cMBCachePrototypePte = (DWORD)Util_GetNumericA(argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-warmup")) {
+            ctxMain->cfg.dwWarmupMaps = (DWORD)Util_GetNumericA(argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-workthreads")) {
+            ctxMain->cfg.cWorkThreads = (DWORD)Util_GetNumericA(argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-forensicscanchunks")) {
+            ctxMain->cfg.cFcScanChunks = (DWORD)Util_GetNumericA(argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-forensicscanchunkmb")) {
+            ctxMain->cfg.cMBFcScanChunk = (DWORD)Util_GetNumericA(argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-forensicmembudget")) {
+            ctxMain->cfg.cMBFcMemoryBudget = (DWORD)Util_GetNumericA(argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-coalesce")) {
+            ctxMain->cfg.cUsReadCoalesce = (DWORD)Util_GetNumericA(argv[i + 1]);
+            ctxMain->cfg.fReadCoalesceSet = TRUE;
+            i += 2;
+            continue;
         } else if(0 == _stricmp(argv[i], "-max")) {
             ctxMain->dev.paMax = Util_GetNumericA(argv[i + 1]);
             i += 2;
@@ -123,6 +204,18 @@ BOOL VmmDll_ConfigIntialize(_In_ DWORD argc, _In_ char* argv[])
             strcpy_s(ctxMain->cfg.szMemMap, MAX_PATH, argv[i + 1]);
             i += 2;
             continue;
+        } else if(0 == _stricmp(argv[i], "-devicerecord")) {
+            strcpy_s(ctxMain->cfg.szDeviceRecord, MAX_PATH, argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-devicereplay")) {
+            strcpy_s(ctxMain->cfg.szDeviceReplay, MAX_PATH, argv[i + 1]);
+            i += 2;
+            continue;
+        } else if(0 == _stricmp(argv[i], "-forensicpattern")) {
+            strcpy_s(ctxMain->cfg.szForensicPattern, MAX_PATH, argv[i + 1]);
+            i += 2;
+            continue;
         } else if(0 == _stricmp(argv[i], "-pythonpath")) {
             strcpy_s(ctxMain->cfg.szPythonPath, MAX_PATH, argv[i + 1]);
             i += 2;
@@ -131,6 +224,10 @@ BOOL VmmDll_ConfigIntialize(_In_ DWORD argc, _In_ char* argv[])
             chMountMount = argv[i + 1][0];
             i += 2;
             continue;
+        } else if(0 == _stricmp(argv[i], "-vfsttl")) {
+            // directory cache ttls of the memprocfs file system - parsed by memprocfs.exe
+            i += 2;
+            continue;
         } else if(0 == _strnicmp(argv[i], "-pagefile", 9)) {
             iPageFile = argv[i][9] - '0';
             if(iPageFile < 10) {
@@ -156,7 +253,7 @@ BOOL VmmDll_ConfigIntialize(_In_ DWORD argc, _In_ char* argv[])
     ctxMain->dev.dwPrintfVerbosity |= ctxMain->cfg.fVerbose ? LC_CONFIG_PRINTF_V : 0;
     ctxMain->dev.dwPrintfVerbosity |= ctxMain->cfg.fVerboseExtra ? LC_CONFIG_PRINTF_VV : 0;
     ctxMain->dev.dwPrintfVerbosity |= ctxMain->cfg.fVerboseExtraTlp ? LC_CONFIG_PRINTF_VVV : 0;
-    return (ctxMain->dev.szDevice[0] != 0);
+    return (ctxMain->dev.szDevice[0] != 0) || (ctxMain->cfg.szDeviceReplay[0] != 0);
 }
 
 VOID VmmDll_PrintHelp()
@@ -208,6 +305,11 @@ VOID VmmDll_PrintHelp()
         "   -cr3 : base address of kernel/process page table (PML4) / CR3 CPU register. \n" \
         "   -max : memory max address, valid range: 0x0 .. 0xffffffffffffffff           \n" \
         "          default: auto-detect (max supported by device / target system).      \n" \
+        "   -devicerecord : record all physical memory reads of the device (addresses,  \n" \
+        "          sizes, timing and data) to a trace file. Example: -devicerecord t.bin\n" \
+        "   -devicereplay : replay a trace file recorded with -devicerecord as a virtual\n" \
+        "          read-only device instead of -device. Reads not in the trace fail.    \n" \
+        "          Example: -devicereplay c:\\temp\\trace.bin                           \n" \
         "   -memmap : specify a physical memory map given in a file or specify 'auto'.  \n" \
         "          example: -memmap c:\\temp\\my_custom_memory_map.txt                  \n" \
         "          example: -memmap auto                                                \n" \
@@ -219,6 +321,10 @@ VOID VmmDll_PrintHelp()
         "          Example: -pythonpath \"C:\\Program Files\\Python37\"                 \n" \
         "   -mount : drive letter to mount The Memory Process File system at.           \n" \
         "          default: M   Example: -mount Q                                       \n" \
+        "   -vfsttl : directory listing cache lifetime in ms per plugin for the mounted \n" \
+        "          file system. Per-process plugins are given by the plugin name only.  \n" \
+        "          Plugin '*' sets the default lifetime (default: 500). Example:        \n" \
+        "          -vfsttl *=1000,sys=5000,modules=2000                                 \n" \
         "   -norefresh : disable automatic cache and processes refreshes even when      \n" \
         "          running against a live memory target - such as PCIe FPGA or live     \n" \
         "          driver acquired memory. This is not recommended. Example: -norefresh \n" \
@@ -227,15 +333,80 @@ VOID VmmDll_PrintHelp()
         "          will be limited if this is activated. Example: -symbolserverdisable  \n" \
         "   -waitinitialize : wait debugging .pdb symbol subsystem to fully start before\n" \
         "          mounting file system and fully starting MemProcFS.                   \n" \
+        "   -cachesize : size of the physical memory cache in MB. Larger caches may be  \n" \
+        "          beneficial on analysis hosts with lots of RAM. default: 128 max:65536\n" \
+        "          Example: -cachesize 4096                                             \n" \
+        "   -cachesizetlb : size of the page table (tlb) cache in MB. default: 128      \n" \
+        "   -cachesizepaging : size of the paged virtual memory cache in MB.            \n" \
+        "          default: 128                                                         \n" \
+        "   -cache2q : use a scan resistant replacement policy for the physical memory  \n" \
+        "          cache. Large linear reads will not evict frequently used pages such  \n" \
+        "          as page tables. Option has no value. Example: -cache2q               \n" \
+        "   -cachecompress : size of the compressed physical memory cache tier in MB.   \n" \
+        "          Pages evicted from the physical memory cache are kept compressed and \n" \
+        "          are promoted back on access. Useful on high latency devices such as  \n" \
+        "          FPGA or remote. default: 0 (disabled)  Example: -cachecompress 256   \n" \
+        "   -membudget : global memory budget in MB. Cached data, such as registry hive \n" \
+        "          snapshots and process maps, is evicted when exceeded. The phys, tlb  \n" \
+        "          and paging caches are not included. default: 0 (no budget)           \n" \
+        "          Example: -membudget 2048                                             \n" \
+        "   -cachesizeprototype : size of the prototype pte array cache in MB. Arrays   \n" \
+        "          are shared between processes mapping the same file. default: 64      \n" \
+        "   -coalesce : merge small reads of concurrent threads arriving within the     \n" \
+        "          given time window (in microseconds) into one device read. Useful on  \n" \
+        "          high latency devices such as FPGA or remote. default: 0 (disabled)   \n" \
+        "          On remote devices the window is tuned automatically unless set to 0. \n" \
+        "          Example: -coalesce 50                                                \n" \
+        "   -warmup : pre-build maps of active processes in the background after each   \n" \
+        "          process refresh. The warm-up is time and read budgeted and yields to \n" \
+        "          other reads. Value is a bitmask: 1 = vad, 2 = module, 4 = handle,    \n" \
+        "          8 = thread. default: 0 (disabled)  Example: -warmup 0xf              \n" \
+        "   -phys2virtindex : keep a global index from physical pages to virtual        \n" \
+        "          addresses of all processes. Makes phys2virt lookups fast and without \n" \
+        "          a result limit at the expense of memory. Option has no value.        \n" \
+        "   -reglazy : fetch registry hive data on demand and only index the keys which \n" \
+        "          are visited instead of reading whole registry hives at once. Useful  \n" \
+        "          on high latency devices such as FPGA or remote. Option has no value. \n" \
+        "   -pluginlazy : load native and python plugins on first use instead of at     \n" \
+        "          startup. Plugin registrations are cached in 'plugins\\plugins.cache' \n" \
+        "          and refreshed whenever a plugin file changes. Plugins not yet loaded \n" \
+        "          receive no notifications. Option has no value. Example: -pluginlazy  \n" \
+        "   -noprofile : do not load or save the kernel offset profile. By default the  \n" \
+        "          offsets of the analyzed kernel build are saved in the 'Profiles'     \n" \
+        "          directory to speed up later startups of the same kernel build.       \n" \
+        "          Startup hints (DTB and kernel location) of memory dump files are     \n" \
+        "          saved in the same directory and are also disabled by this option.    \n" \
+        "          Option has no value. Example: -noprofile                             \n" \
+        "   -nofilemap : do not memory map raw memory dump files. By default raw memory \n" \
+        "          dump files are read directly from a memory mapped view which bypass  \n" \
+        "          the physical memory cache. Option has no value. Example: -nofilemap  \n" \
+        "   -workthreads : number of worker threads in the internal thread pool. Valid  \n" \
+        "          range: 4-64. default: two per cpu (min 32).                          \n" \
+        "          Example: -workthreads 16                                             \n" \
         "   -forensic : start a forensic scan of the physical memory immediately after  \n" \
-        "          startup if possible. Allowed parameter values range from 0-4.        \n" \
+        "          startup if possible. Allowed parameter values range from 0-5.        \n" \
         "          Note! forensic mode is not available for live memory.                \n" \
         "          0 = not enabled (default value)                                      \n" \
         "          1 = forensic mode with in-memory sqlite database.                    \n" \
         "          2 = forensic mode with temp sqlite database deleted upon exit.       \n" \
         "          3 = forensic mode with temp sqlite database remaining upon exit.     \n" \
         "          4 = forensic mode with static named sqlite database (vmm.sqlite3).   \n" \
+        "          5 = forensic mode with in-memory sqlite database which is saved to a \n" \
+        "              temp sqlite database when exceeding -forensicmembudget.          \n" \
         "          default: 0  Example -forensic 4                                      \n" \
+        "   -forensicscanchunks : number of chunks read and analyzed in parallel by the \n" \
+        "          forensic physical memory scan. default: 4                            \n" \
+        "          Example: -forensicscanchunks 8                                       \n" \
+        "   -forensicscanchunkmb : size in MB of each forensic physical memory scan     \n" \
+        "          chunk. default: 16  Example: -forensicscanchunkmb 32                 \n" \
+        "   -forensicmembudget : memory budget in MB of the in-memory forensic database \n" \
+        "          (-forensic 5) before it's spilled to disk. default: 4096             \n" \
+        "          Example: -forensicmembudget 8192                                     \n" \
+        "   -forensicpattern : file with byte and string patterns to search for in all  \n" \
+        "          physical memory during the forensic scan. Hits are saved to the      \n" \
+        "          forensic database table 'pattern' together with process attribution. \n" \
+        "          One pattern per line: <name> <hex|ascii|utf16> <value>               \n" \
+        "          Example: -forensicpattern c:\\temp\\patterns.txt                       \n" \
         "                                                                               \n",
         VERSION_MAJOR, VERSION_MINOR, VERSION_REVISION
     );
@@ -251,6 +422,8 @@ VOID VmmDll_FreeContext()
     }
     if(ctxMain) {
         Statistics_CallSetEnabled(FALSE);
+        VmmFileMap_Close();
+        VmmDevTrace_Close();
         if(!ctxMain->cfg.fDisableLeechCoreClose && ctxMain->hLC) {
             LcClose(ctxMain->hLC);
         }
@@ -291,7 +464,9 @@ BOOL VMMDLL_Initialize(_In_ DWORD argc, _In_ LPSTR argv[])
     BOOL f;
     DWORD cbMemMap = 0;
     PBYTE pbMemMap = NULL;
+    DWORD iPhase;
     if(!(ctxMain = LocalAlloc(LMEM_ZEROINIT, sizeof(VMM_MAIN_CONTEXT)))) { return FALSE; }
+    QueryPerformanceCounter((PLARGE_INTEGER)&ctxMain->startup.tmBase);
     // initialize configuration
     if(!VmmDll_ConfigIntialize((DWORD)argc, argv)) {
         VmmDll_PrintHelp();
@@ -301,9 +476,21 @@ BOOL VMMDLL_Initialize(_In_ DWORD argc, _In_ LPSTR argv[])
     if(0 == _stricmp(ctxMain->dev.szDevice, "existing")) {
         ctxMain->cfg.fDisableLeechCoreClose = TRUE;
     }
-    if(!(ctxMain->hLC = LcCreate(&ctxMain->dev))) {
-        vmmprintf("MemProcFS: Failed to connect to memory acquisition device.\n");
-        goto fail;
+    if(ctxMain->cfg.szDeviceReplay[0]) {
+        // replay device - no leechcore device is created (ctxMain->hLC = NULL).
+        if(ctxMain->cfg.szDeviceRecord[0] || ctxMain->cfg.szMemMap[0]) {
+            vmmprintf("MemProcFS: Options -devicerecord and -memmap are not supported with -devicereplay.\n");
+            goto fail;
+        }
+        if(!VmmDevTrace_ReplayInitialize()) { goto fail; }
+    } else {
+        iPhase = Statistics_StartupPhaseBegin("LeechCore device");
+        ctxMain->hLC = LcCreate(&ctxMain->dev);
+        Statistics_StartupPhaseEnd(iPhase);
+        if(!ctxMain->hLC) {
+            vmmprintf("MemProcFS: Failed to connect to memory acquisition device.\n");
+            goto fail;
+        }
     }
     // Set LeechCore MemMap (if exists and not auto - i.e. from file)
     if(ctxMain->cfg.szMemMap[0] && _stricmp(ctxMain->cfg.szMemMap, "auto")) {
@@ -320,6 +507,11 @@ BOOL VMMDLL_Initialize(_In_ DWORD argc, _In_ LPSTR argv[])
         }
     }
     // ctxMain.dev context is initialized from here onwards - device functionality is working!
+    if(ctxMain->cfg.szDeviceRecord[0] && !VmmDevTrace_RecordInitialize()) { goto fail; }
+    // Memory map raw memory dump files (if possible and no custom memory map)
+    if(!ctxMain->cfg.szMemMap[0]) {
+        VmmFileMap_Initialize();
+    }
     if(!VmmProcInitialize()) {
         vmmprintf("MOUNT: INFO: PROC file system not mounted.\n");
         goto fail;
@@ -387,9 +579,28 @@ BOOL VMMDLL_InitializePlugins()
 
 #define VMMDLL_REFRESH_CHECK(fOption, mask)      (fOption & mask & 0xffff'00000000)
 
+/*
+* Retrieve the cache table given by the low dword of a VMMDLL_OPT_CONFIG_STAT_CACHE_* option.
+* -- fOption
+* -- return = the cache table, NULL on invalid option.
+*/
+PVMM_CACHE_TABLE VMMDLL_ConfigGet_CacheTable(_In_ ULONG64 fOption)
+{
+    switch((DWORD)fOption) {
+        case 1: return &ctxVmm->Cache.PHYS;
+        case 2: return &ctxVmm->Cache.TLB;
+        case 3: return &ctxVmm->Cache.PAGING;
+        default: return NULL;
+    }
+}
+
 _Success_(return)
 BOOL VMMDLL_ConfigGet(_In_ ULONG64 fOption, _Out_ PULONG64 pqwValue)
 {
+    PVMM_CACHE_TABLE t;
+    STATISTICS_CALL_SUMMARY CallSummary;
+    VMMMEMBUDGET_USAGE MemUsage;
+    BOOL fVector;
     if(!fOption || !pqwValue) { return FALSE; }
     switch(fOption & 0xffffffff'00000000) {
         case VMMDLL_OPT_CORE_SYSTEM:
@@ -431,6 +642,100 @@ BOOL VMMDLL_ConfigGet(_In_ ULONG64 fOption, _Out_ PULONG64 pqwValue)
         case VMMDLL_OPT_CONFIG_STATISTICS_FUNCTIONCALL:
             *pqwValue = Statistics_CallGetEnabled() ? 1 : 0;
             return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHESIZE_PHYS:
+            *pqwValue = ctxVmm->Cache.PHYS.cMaxEntries >> 8;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHESIZE_TLB:
+            *pqwValue = ctxVmm->Cache.TLB.cMaxEntries >> 8;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHESIZE_PAGING:
+            *pqwValue = ctxVmm->Cache.PAGING.cMaxEntries >> 8;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHE_PHYS_2Q:
+            *pqwValue = ctxVmm->Cache.PHYS.f2Q ? 1 : 0;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_READAHEAD_MAX:
+            *pqwValue = ctxVmm->ReadAhead.cPagesMax;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_TLBCACHE_REVALIDATE:
+            *pqwValue = ctxVmm->ThreadProcCache.fTlbRevalidate ? 1 : 0;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_STAT_CACHE_HIT:
+            if(!(t = VMMDLL_ConfigGet_CacheTable(fOption))) { return FALSE; }
+            *pqwValue = t->stat.cHit;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_STAT_CACHE_MISS:
+            if(!(t = VMMDLL_ConfigGet_CacheTable(fOption))) { return FALSE; }
+            *pqwValue = t->stat.cMiss;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_STAT_CACHE_EVICT:
+            if(!(t = VMMDLL_ConfigGet_CacheTable(fOption))) { return FALSE; }
+            *pqwValue = t->stat.cEvict;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_STAT_CACHE_RESFAIL:
+            if(!(t = VMMDLL_ConfigGet_CacheTable(fOption))) { return FALSE; }
+            *pqwValue = t->stat.cReserveFail;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_STAT_CACHE_INUSE:
+            if(!(t = VMMDLL_ConfigGet_CacheTable(fOption))) { return FALSE; }
+            *pqwValue = t->cTotal - t->cEmpty;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_STAT_DEVICE_LATENCY:
+            if((DWORD)fOption >= VMM_LATENCY_HISTOGRAM_BUCKETS) { return FALSE; }
+            *pqwValue = ctxVmm->stat.cDeviceReadLatency[(DWORD)fOption];
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_READ_COALESCE_US:
+            *pqwValue = ctxVmm->DeviceSched.cUsCoalesceWindow;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_REMOTE_PROFILE:
+            *pqwValue = ctxVmm->DeviceSched.Remote.fEnabled ? 1 : 0;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_STAT_DEVICE_RTT_US:
+            *pqwValue = ctxVmm->DeviceSched.Remote.cUsRtt;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_STAT_FNCALL_COUNT:
+        case VMMDLL_OPT_CONFIG_STAT_FNCALL_P50_US:
+        case VMMDLL_OPT_CONFIG_STAT_FNCALL_P95_US:
+        case VMMDLL_OPT_CONFIG_STAT_FNCALL_P99_US:
+        case VMMDLL_OPT_CONFIG_STAT_FNCALL_MAX_US:
+            if(!Statistics_CallSummary((DWORD)fOption, &CallSummary)) { return FALSE; }
+            switch(fOption & 0xffffffff'00000000) {
+                case VMMDLL_OPT_CONFIG_STAT_FNCALL_COUNT:   *pqwValue = CallSummary.c; break;
+                case VMMDLL_OPT_CONFIG_STAT_FNCALL_P50_US:  *pqwValue = CallSummary.tmUsP50; break;
+                case VMMDLL_OPT_CONFIG_STAT_FNCALL_P95_US:  *pqwValue = CallSummary.tmUsP95; break;
+                case VMMDLL_OPT_CONFIG_STAT_FNCALL_P99_US:  *pqwValue = CallSummary.tmUsP99; break;
+                default:                                    *pqwValue = CallSummary.tmUsMax; break;
+            }
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHE_COMPRESS_MB:
+            *pqwValue = ctxVmm->CacheCompress.cbMax >> 20;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_MEMORY_BUDGET_MB:
+            *pqwValue = ctxVmm->MemBudget.cbMax >> 20;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_STAT_MEMORY_USAGE:
+            VmmMemBudget_Usage(&MemUsage);
+            *pqwValue = MemUsage.cbEnforced;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_TLB_VERIFY_VECTOR:
+            if(!MmX64_TlbPageTableVerifyIsVector(&fVector)) { return FALSE; }
+            *pqwValue = fVector ? 1 : 0;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHE_PROTOTYPEPTE_MB:
+            *pqwValue = ctxVmm->CachePrototypePte.cbMax >> 20;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_WARMUP_MAPS:
+            *pqwValue = ctxVmm->ThreadProcCache.dwWarmupMaps;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_REGISTRY_LAZY:
+            *pqwValue = ctxMain->cfg.fRegistryLazy ? 1 : 0;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_PLUGIN_LAZY:
+            *pqwValue = ctxMain->cfg.fPluginLazy ? 1 : 0;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_PHYS2VIRT_INDEX:
+            *pqwValue = ctxVmm->Phys2VirtIndex.fEnabled ? 1 : 0;
+            return TRUE;
         case VMMDLL_OPT_WIN_VERSION_MAJOR:
             *pqwValue = ctxVmm->kernel.dwVersionMajor;
             return TRUE;
@@ -443,6 +748,18 @@ BOOL VMMDLL_ConfigGet(_In_ ULONG64 fOption, _Out_ PULONG64 pqwValue)
         case VMMDLL_OPT_FORENSIC_MODE:
             *pqwValue = ctxFc ? (BYTE)ctxFc->db.tp : 0;
             return TRUE;
+        case VMMDLL_OPT_FORENSIC_INIT_STATUS:
+            *pqwValue = (ctxFc && ctxFc->fInitFinish) ? 2 : ((ctxFc && ctxFc->fInitStart) ? 1 : 0);
+            return TRUE;
+        case VMMDLL_OPT_FORENSIC_SCAN_CHUNKS:
+            *pqwValue = ctxMain->cfg.cFcScanChunks;
+            return TRUE;
+        case VMMDLL_OPT_FORENSIC_SCAN_CHUNK_MB:
+            *pqwValue = ctxMain->cfg.cMBFcScanChunk;
+            return TRUE;
+        case VMMDLL_OPT_FORENSIC_MEMORY_BUDGET_MB:
+            *pqwValue = ctxMain->cfg.cMBFcMemoryBudget;
+            return TRUE;
         // core options affecting both vmm.dll and pcileech.dll
         case VMMDLL_OPT_CORE_PRINTF_ENABLE:
             *pqwValue = ctxMain->cfg.fVerboseDll ? 1 : 0;
@@ -480,7 +797,12 @@ BOOL VMMDLL_ConfigSet(_In_ ULONG64 fOption, _In_ ULONG64 qwValue)
             VmmCacheClear(VMM_CACHE_TAG_PAGING);
         }
         if(VMMDLL_REFRESH_CHECK(fOption, VMMDLL_OPT_REFRESH_PROCESS)) {
+            EnterCriticalSection(&ctxVmm->LockMaster);
             VmmProc_RefreshProcesses(TRUE);
+            LeaveCriticalSection(&ctxVmm->LockMaster);
+            VmmWinNet_Refresh();
+            VmmWinObj_Refresh();
+            VmmWinHandle_Refresh();
             PluginManager_Notify(VMMDLL_PLUGIN_EVENT_REFRESH_PROCESS_TOTAL, NULL, 0);
         }
         if(VMMDLL_REFRESH_CHECK(fOption, VMMDLL_OPT_REFRESH_REGISTRY)) {
@@ -546,14 +868,107 @@ BOOL VMMDLL_ConfigSet(_In_ ULONG64 fOption, _In_ ULONG64 qwValue)
         case VMMDLL_OPT_CONFIG_STATISTICS_FUNCTIONCALL:
             Statistics_CallSetEnabled(qwValue ? TRUE : FALSE);
             return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHESIZE_PHYS:
+            if(qwValue > 0x00100000) { return FALSE; }
+            return VmmCacheConfigure(VMM_CACHE_TAG_PHYS, (DWORD)qwValue << 8, ctxVmm->Cache.PHYS.f2Q);
+        case VMMDLL_OPT_CONFIG_CACHESIZE_TLB:
+            if(qwValue > 0x00100000) { return FALSE; }
+            return VmmCacheConfigure(VMM_CACHE_TAG_TLB, (DWORD)qwValue << 8, FALSE);
+        case VMMDLL_OPT_CONFIG_CACHESIZE_PAGING:
+            if(qwValue > 0x00100000) { return FALSE; }
+            return VmmCacheConfigure(VMM_CACHE_TAG_PAGING, (DWORD)qwValue << 8, FALSE);
+        case VMMDLL_OPT_CONFIG_CACHE_PHYS_2Q:
+            return VmmCacheConfigure(VMM_CACHE_TAG_PHYS, ctxVmm->Cache.PHYS.cMaxEntries, qwValue ? TRUE : FALSE);
+        case VMMDLL_OPT_CONFIG_READAHEAD_MAX:
+            if(qwValue > VMM_READAHEAD_PAGES_MAX) { return FALSE; }
+            ctxVmm->ReadAhead.cPagesMax = (DWORD)qwValue;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_TLBCACHE_REVALIDATE:
+            ctxVmm->ThreadProcCache.fTlbRevalidate = qwValue ? TRUE : FALSE;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_READ_COALESCE_US:
+            if(qwValue > VMM_COALESCE_WINDOW_US_MAX) { return FALSE; }
+            ctxVmm->DeviceSched.cUsCoalesceWindow = (DWORD)qwValue;
+            ctxVmm->DeviceSched.fCoalesceWindowSet = TRUE;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_REMOTE_PROFILE:
+            ctxVmm->DeviceSched.Remote.fEnabled = qwValue ? TRUE : FALSE;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHE_COMPRESS_MB:
+            if(qwValue > 0xffffffff) { return FALSE; }
+            return VmmCacheCompressConfigure((DWORD)qwValue);
+        case VMMDLL_OPT_CONFIG_MEMORY_BUDGET_MB:
+            if(qwValue > 0xffffffff) { return FALSE; }
+            return VmmMemBudget_Configure((DWORD)qwValue);
+        case VMMDLL_OPT_CONFIG_TLB_VERIFY_VECTOR:
+            return MmX64_TlbPageTableVerifyConfigure(qwValue ? TRUE : FALSE);
+        case VMMDLL_OPT_CONFIG_CACHE_PROTOTYPEPTE_MB:
+            if(qwValue > 0xffffffff) { return FALSE; }
+            return MmVad_PrototypePteCache_Configure((DWORD)qwValue);
+        case VMMDLL_OPT_CONFIG_WARMUP_MAPS:
+            ctxVmm->ThreadProcCache.dwWarmupMaps = (DWORD)qwValue & VMM_WARMUP_MAP_ALL;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_REGISTRY_LAZY:
+            ctxMain->cfg.fRegistryLazy = qwValue ? TRUE : FALSE;    // applies to hive snapshots taken after change
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_PLUGIN_LAZY:
+            ctxMain->cfg.fPluginLazy = qwValue ? TRUE : FALSE;      // applies to plugin initialization after change
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_PHYS2VIRT_INDEX:
+            return VmmPhys2VirtIndex_Configure(qwValue ? TRUE : FALSE);
         case VMMDLL_OPT_FORENSIC_MODE:
             return FcInitialize((DWORD)qwValue, FALSE);
+        case VMMDLL_OPT_FORENSIC_SCAN_CHUNKS:
+            if(qwValue > FC_PHYSMEMSCAN_CHUNKS_MAX) { return FALSE; }
+            ctxMain->cfg.cFcScanChunks = (DWORD)qwValue;
+            return TRUE;
+        case VMMDLL_OPT_FORENSIC_SCAN_CHUNK_MB:
+            if(qwValue > (FC_PHYSMEMSCAN_CHUNK_PAGES_MAX >> 8)) { return FALSE; }
+            ctxMain->cfg.cMBFcScanChunk = (DWORD)qwValue;
+            return TRUE;
+        case VMMDLL_OPT_FORENSIC_MEMORY_BUDGET_MB:
+            if(qwValue > 0xffffffff) { return FALSE; }
+            ctxMain->cfg.cMBFcMemoryBudget = (DWORD)qwValue;
+            return TRUE;
+        case VMMDLL_OPT_FORENSIC_DATABASE_SAVE:
+            return ctxFc && ctxFc->fInitFinish && Fc_SqlMemorySpill();
         default:
             // non-recognized option - possibly a device option to pass along to leechcore.dll
             return LcSetOption(ctxMain->hLC, fOption, qwValue);
     }
 }
 
+_Success_(return)
+BOOL VMMDLL_SnapshotBegin(_Out_ PULONG64 pqwSnapshotId)
+{
+    CALL_IMPLEMENTATION_VMM(
+        STATISTICS_ID_VMMDLL_SnapshotBegin,
+        VmmSnapshotBegin(pqwSnapshotId))
+}
+
+_Success_(return)
+BOOL VMMDLL_SnapshotEnd(_In_ ULONG64 qwSnapshotId)
+{
+    CALL_IMPLEMENTATION_VMM(
+        STATISTICS_ID_VMMDLL_SnapshotEnd,
+        VmmSnapshotEnd(qwSnapshotId))
+}
+
+_Success_(return)
+BOOL VMMDLL_ForensicExportTable_Impl(_In_ LPSTR szTable, _In_ LPWSTR wszFileName)
+{
+    if(!ctxFc || !ctxFc->fInitFinish) { return FALSE; }
+    return FcExport_Table(szTable, wszFileName);
+}
+
+_Success_(return)
+BOOL VMMDLL_ForensicExportTable(_In_ LPSTR szTable, _In_ LPWSTR wszFileName)
+{
+    CALL_IMPLEMENTATION_VMM(
+        STATISTICS_ID_VMMDLL_ForensicExportTable,
+        VMMDLL_ForensicExportTable_Impl(szTable, wszFileName))
+}
+
 //-----------------------------------------------------------------------------
 // VFS - VIRTUAL FILE SYSTEM FUNCTIONALITY BELOW:
 //-----------------------------------------------------------------------------
@@ -757,6 +1172,243 @@ DWORD VMMDLL_MemReadScatter(_In_ DWORD dwPID, _Inout_ PPMEM_SCATTER ppMEMs, _In_
         VMMDLL_MemReadScatter_Impl(dwPID, ppMEMs, cpMEMs, flags))
 }
 
+typedef struct tdVMMDLL_MEMREADSCATTERASYNC_CONTEXT {
+    HANDLE hEventFinish;
+    DWORD dwPID;
+    DWORD flags;
+    DWORD cpMEMs;
+    PPMEM_SCATTER ppMEMs;
+    VMMDLL_MEM_SCATTER_ASYNC_CALLBACK pfnCallback;
+    PVOID ctx;
+} VMMDLL_MEMREADSCATTERASYNC_CONTEXT, *PVMMDLL_MEMREADSCATTERASYNC_CONTEXT;
+
+DWORD VMMDLL_MemReadScatterAsync_ThreadProc(_In_ PVMMDLL_MEMREADSCATTERASYNC_CONTEXT ctx)
+{
+    DWORD cMEMsRead;
+    // the read is an external call even though it runs on a worker thread.
+    VmmDeviceSched_ExternalBegin();
+    cMEMsRead = VMMDLL_MemReadScatter_Impl(ctx->dwPID, ctx->ppMEMs, ctx->cpMEMs, ctx->flags);
+    VmmDeviceSched_ExternalEnd();
+    if(ctx->pfnCallback) {
+        ctx->pfnCallback(ctx->ctx, ctx->ppMEMs, ctx->cpMEMs, cMEMsRead);
+    }
+    SetEvent(ctx->hEventFinish);
+    CloseHandle(ctx->hEventFinish);
+    LocalFree(ctx);
+    return 1;
+}
+
+_Success_(return != NULL)
+HANDLE VMMDLL_MemReadScatterAsync_Impl(_In_ DWORD dwPID, _Inout_ PPMEM_SCATTER ppMEMs, _In_ DWORD cpMEMs, _In_ DWORD flags, _In_opt_ VMMDLL_MEM_SCATTER_ASYNC_CALLBACK pfnCallback, _In_opt_ PVOID ctx)
+{
+    HANDLE hEventCaller = NULL;
+    PVMMDLL_MEMREADSCATTERASYNC_CONTEXT ctxAsync;
+    if(!(ctxAsync = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMDLL_MEMREADSCATTERASYNC_CONTEXT)))) { return NULL; }
+    // the worker and the caller each own a handle to the completion event so
+    // that the caller may close its handle before the read has completed.
+    ctxAsync->hEventFinish = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if(!ctxAsync->hEventFinish || !DuplicateHandle(GetCurrentProcess(), ctxAsync->hEventFinish, GetCurrentProcess(), &hEventCaller, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+        if(ctxAsync->hEventFinish) { CloseHandle(ctxAsync->hEventFinish); }
+        LocalFree(ctxAsync);
+        return NULL;
+    }
+    ctxAsync->dwPID = dwPID;
+    ctxAsync->flags = flags;
+    ctxAsync->cpMEMs = cpMEMs;
+    ctxAsync->ppMEMs = ppMEMs;
+    ctxAsync->pfnCallback = pfnCallback;
+    ctxAsync->ctx = ctx;
+    VmmWork((LPTHREAD_START_ROUTINE)VMMDLL_MemReadScatterAsync_ThreadProc, ctxAsync, NULL);
+    return hEventCaller;
+}
+
+_Success_(return != NULL)
+HANDLE VMMDLL_MemReadScatterAsync(_In_ DWORD dwPID, _Inout_ PPMEM_SCATTER ppMEMs, _In_ DWORD cpMEMs, _In_ DWORD flags, _In_opt_ VMMDLL_MEM_SCATTER_ASYNC_CALLBACK pfnCallback, _In_opt_ PVOID ctx)
+{
+    CALL_IMPLEMENTATION_VMM_RETURN(
+        STATISTICS_ID_VMMDLL_MemReadScatterAsync,
+        HANDLE,
+        NULL,
+        VMMDLL_MemReadScatterAsync_Impl(dwPID, ppMEMs, cpMEMs, flags, pfnCallback, ctx))
+}
+
+#define VMMDLL_SCATTER_MAGIC        0x5ca77e55
+#define VMMDLL_SCATTER_IS_VALID(h)  (h && (((PVMMDLL_SCATTER_CONTEXT)h)->dwMagic == VMMDLL_SCATTER_MAGIC))
+#define VMMDLL_SCATTER_PAGE_ZERO    0x80000000'00000000     // POB_SET does not support ZERO - stand-in for page 0 in psPage
+
+typedef struct tdVMMDLL_SCATTER_CONTEXT {
+    DWORD dwMagic;
+    DWORD dwPID;
+    DWORD flags;
+    DWORD cMEMs;
+    SRWLOCK LockSRW;
+    POB_SET psPage;                 // prepared page addresses
+    POB_MAP pmMEM;                  // page address -> PMEM_SCATTER of most recent execute
+    PPMEM_SCATTER ppMEMs;
+} VMMDLL_SCATTER_CONTEXT, *PVMMDLL_SCATTER_CONTEXT;
+
+VOID VMMDLL_Scatter_ClearResult(_In_ PVMMDLL_SCATTER_CONTEXT ctx)
+{
+    ObMap_Clear(ctx->pmMEM);
+    LcMemFree(ctx->ppMEMs);
+    ctx->ppMEMs = NULL;
+    ctx->cMEMs = 0;
+}
+
+_Success_(return != NULL)
+VMMDLL_SCATTER_HANDLE VMMDLL_Scatter_Initialize(_In_ DWORD dwPID, _In_ DWORD flags)
+{
+    PVMMDLL_SCATTER_CONTEXT ctx;
+    if(!ctxVmm) { return NULL; }
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMDLL_SCATTER_CONTEXT)))) { return NULL; }
+    InitializeSRWLock(&ctx->LockSRW);
+    ctx->dwPID = dwPID;
+    ctx->flags = flags;
+    if(!(ctx->psPage = ObSet_New()) || !(ctx->pmMEM = ObMap_New(0))) {
+        Ob_DECREF(ctx->psPage);
+        LocalFree(ctx);
+        return NULL;
+    }
+    ctx->dwMagic = VMMDLL_SCATTER_MAGIC;
+    return (VMMDLL_SCATTER_HANDLE)ctx;
+}
+
+_Success_(return)
+BOOL VMMDLL_Scatter_Prepare(_In_ VMMDLL_SCATTER_HANDLE hS, _In_ ULONG64 va, _In_ DWORD cb)
+{
+    PVMMDLL_SCATTER_CONTEXT ctx = (PVMMDLL_SCATTER_CONTEXT)hS;
+    if(!VMMDLL_SCATTER_IS_VALID(hS) || !cb || (va + cb < va)) { return FALSE; }
+    if(va < 0x1000) { ObSet_Push(ctx->psPage, VMMDLL_SCATTER_PAGE_ZERO); }
+    ObSet_Push_PageAlign(ctx->psPage, va, cb);
+    return TRUE;
+}
+
+_Success_(return)
+BOOL VMMDLL_Scatter_Execute_DoWork(_In_ PVMMDLL_SCATTER_CONTEXT ctx)
+{
+    DWORD i, cMEMs;
+    POB_DATA pObData = NULL;
+    PVMM_PROCESS pObProcess = NULL;
+    VMMDLL_Scatter_ClearResult(ctx);
+    if(ctx->dwPID != (DWORD)-1) {
+        if(!(pObProcess = VmmProcessGet(ctx->dwPID))) { return FALSE; }
+    }
+    if(!(pObData = ObSet_GetAllSorted(ctx->psPage))) { goto fail; }
+    cMEMs = pObData->ObHdr.cbData / sizeof(QWORD);
+    if(cMEMs) {
+        if(!LcAllocScatter1(cMEMs, &ctx->ppMEMs)) { goto fail; }
+        for(i = 0; i < cMEMs; i++) {
+            ctx->ppMEMs[i]->qwA = (pObData->pqw[i] == VMMDLL_SCATTER_PAGE_ZERO) ? 0 : pObData->pqw[i];
+        }
+        if(pObProcess) {
+            VmmReadScatterVirtual(pObProcess, ctx->ppMEMs, cMEMs, ctx->flags);
+        } else {
+            VmmReadScatterPhysical(ctx->ppMEMs, cMEMs, ctx->flags);
+        }
+        for(i = 0; i < cMEMs; i++) {
+            ObMap_Push(ctx->pmMEM, ctx->ppMEMs[i]->qwA, ctx->ppMEMs[i]);
+        }
+        ctx->cMEMs = cMEMs;
+    }
+    Ob_DECREF(pObData);
+    Ob_DECREF(pObProcess);
+    return TRUE;
+fail:
+    Ob_DECREF(pObData);
+    Ob_DECREF(pObProcess);
+    return FALSE;
+}
+
+_Success_(return)
+BOOL VMMDLL_Scatter_Execute_Impl(_In_ VMMDLL_SCATTER_HANDLE hS)
+{
+    BOOL fResult;
+    PVMMDLL_SCATTER_CONTEXT ctx = (PVMMDLL_SCATTER_CONTEXT)hS;
+    if(!VMMDLL_SCATTER_IS_VALID(hS)) { return FALSE; }
+    AcquireSRWLockExclusive(&ctx->LockSRW);
+    fResult = VMMDLL_Scatter_Execute_DoWork(ctx);
+    ReleaseSRWLockExclusive(&ctx->LockSRW);
+    return fResult;
+}
+
+_Success_(return)
+BOOL VMMDLL_Scatter_Execute(_In_ VMMDLL_SCATTER_HANDLE hS)
+{
+    CALL_IMPLEMENTATION_VMM(
+        STATISTICS_ID_VMMDLL_Scatter_Execute,
+        VMMDLL_Scatter_Execute_Impl(hS))
+}
+
+_Success_(return)
+BOOL VMMDLL_Scatter_Read_Impl(_In_ VMMDLL_SCATTER_HANDLE hS, _In_ ULONG64 va, _In_ DWORD cb, _Out_writes_(cb) PBYTE pb, _Out_opt_ PDWORD pcbRead)
+{
+    QWORD qwA;
+    PMEM_SCATTER pMEM;
+    DWORD o = 0, oPage, cbChunk, cbRead = 0;
+    PVMMDLL_SCATTER_CONTEXT ctx = (PVMMDLL_SCATTER_CONTEXT)hS;
+    if(pcbRead) { *pcbRead = 0; }
+    if(!VMMDLL_SCATTER_IS_VALID(hS) || (va + cb < va)) { return FALSE; }
+    AcquireSRWLockShared(&ctx->LockSRW);
+    while(o < cb) {
+        qwA = va + o;
+        oPage = qwA & 0xfff;
+        cbChunk = min(cb - o, 0x1000 - oPage);
+        if((pMEM = ObMap_GetByKey(ctx->pmMEM, qwA & ~0xfff)) && pMEM->f) {
+            memcpy(pb + o, pMEM->pb + oPage, cbChunk);
+            cbRead += cbChunk;
+        } else {
+            ZeroMemory(pb + o, cbChunk);
+        }
+        o += cbChunk;
+    }
+    ReleaseSRWLockShared(&ctx->LockSRW);
+    if(pcbRead) { *pcbRead = cbRead; }
+    return cbRead == cb;
+}
+
+_Success_(return)
+BOOL VMMDLL_Scatter_Read(_In_ VMMDLL_SCATTER_HANDLE hS, _In_ ULONG64 va, _In_ DWORD cb, _Out_writes_(cb) PBYTE pb, _Out_opt_ PDWORD pcbRead)
+{
+    CALL_IMPLEMENTATION_VMM(
+        STATISTICS_ID_VMMDLL_Scatter_Read,
+        VMMDLL_Scatter_Read_Impl(hS, va, cb, pb, pcbRead))
+}
+
+_Success_(return)
+BOOL VMMDLL_Scatter_Clear(_In_ VMMDLL_SCATTER_HANDLE hS, _In_ DWORD dwPID, _In_ DWORD flags)
+{
+    PVMMDLL_SCATTER_CONTEXT ctx = (PVMMDLL_SCATTER_CONTEXT)hS;
+    if(!VMMDLL_SCATTER_IS_VALID(hS)) { return FALSE; }
+    AcquireSRWLockExclusive(&ctx->LockSRW);
+    VMMDLL_Scatter_ClearResult(ctx);
+    ObSet_Clear(ctx->psPage);
+    ctx->dwPID = dwPID;
+    ctx->flags = flags;
+    ReleaseSRWLockExclusive(&ctx->LockSRW);
+    return TRUE;
+}
+
+_Success_(return)
+BOOL VMMDLL_MemSearch(_In_ DWORD dwPID, _Inout_ PVMMDLL_MEM_SEARCH_CONTEXT ctx)
+{
+    CALL_IMPLEMENTATION_VMM(
+        STATISTICS_ID_VMMDLL_MemSearch,
+        VmmSearch(dwPID, ctx))
+}
+
+VOID VMMDLL_Scatter_CloseHandle(_In_opt_ _Post_ptr_invalid_ VMMDLL_SCATTER_HANDLE hS)
+{
+    PVMMDLL_SCATTER_CONTEXT ctx = (PVMMDLL_SCATTER_CONTEXT)hS;
+    if(!VMMDLL_SCATTER_IS_VALID(hS)) { return; }
+    AcquireSRWLockExclusive(&ctx->LockSRW);
+    ctx->dwMagic = 0;
+    VMMDLL_Scatter_ClearResult(ctx);
+    Ob_DECREF_NULL(&ctx->psPage);
+    Ob_DECREF_NULL(&ctx->pmMEM);
+    ReleaseSRWLockExclusive(&ctx->LockSRW);
+    LocalFree(ctx);
+}
+
 _Success_(return)
 BOOL VMMDLL_MemReadEx_Impl(_In_ DWORD dwPID, _In_ ULONG64 qwA, _Out_writes_(cb) PBYTE pb, _In_ DWORD cb, _Out_opt_ PDWORD pcbReadOpt, _In_ ULONG64 flags)
 {
@@ -1595,6 +2247,30 @@ ULONG64 VMMDLL_ProcessGetProcAddress(_In_ DWORD dwPID, _In_ LPWSTR wszModuleName
         VMMDLL_ProcessGetProcAddress_Impl(dwPID, wszModuleName, szFunctionName))
 }
 
+DWORD VMMDLL_ProcessGetProcAddressBatch_Impl(_In_ DWORD dwPID, _In_ LPWSTR wszModuleName, _In_ DWORD cFunctions, _In_reads_(cFunctions) LPSTR *pszFunctionNames, _Out_writes_(cFunctions) PULONG64 pvaFunctions)
+{
+    DWORD cFound = 0;
+    VMMDLL_MAP_MODULEENTRY oModuleEntry = { 0 };
+    PVMM_PROCESS pObProcess = NULL;
+    ZeroMemory(pvaFunctions, cFunctions * sizeof(ULONG64));
+    pObProcess = VmmProcessGet(dwPID);
+    if(!pObProcess) { return 0; }
+    if(VMMDLL_ProcessMap_GetModuleFromName_Impl(dwPID, wszModuleName, &oModuleEntry)) {
+        cFound = PE_GetProcAddressBatch(pObProcess, oModuleEntry.vaBase, cFunctions, pszFunctionNames, pvaFunctions);
+    }
+    Ob_DECREF(pObProcess);
+    return cFound;
+}
+
+DWORD VMMDLL_ProcessGetProcAddressBatch(_In_ DWORD dwPID, _In_ LPWSTR wszModuleName, _In_ DWORD cFunctions, _In_reads_(cFunctions) LPSTR *pszFunctionNames, _Out_writes_(cFunctions) PULONG64 pvaFunctions)
+{
+    CALL_IMPLEMENTATION_VMM_RETURN(
+        STATISTICS_ID_VMMDLL_ProcessGetProcAddressBatch,
+        DWORD,
+        0,
+        VMMDLL_ProcessGetProcAddressBatch_Impl(dwPID, wszModuleName, cFunctions, pszFunctionNames, pvaFunctions))
+}
+
 ULONG64 VMMDLL_ProcessGetModuleBase_Impl(_In_ DWORD dwPID, _In_ LPWSTR wszModuleName)
 {
     QWORD vaModuleBase = 0;
@@ -1617,6 +2293,45 @@ ULONG64 VMMDLL_ProcessGetModuleBase(_In_ DWORD dwPID, _In_ LPWSTR wszModuleName)
         VMMDLL_ProcessGetModuleBase_Impl(dwPID, wszModuleName))
 }
 
+_Success_(return)
+BOOL VMMDLL_ProcessPageDigestEnable_Impl(_In_ DWORD dwPID, _In_ BOOL fEnable)
+{
+    BOOL fResult;
+    PVMM_PROCESS pObProcess = NULL;
+    if(!(pObProcess = VmmProcessGet(dwPID))) { return FALSE; }
+    fResult = VmmPageDigest_Enable(pObProcess, fEnable);
+    Ob_DECREF(pObProcess);
+    return fResult;
+}
+
+_Success_(return)
+BOOL VMMDLL_ProcessPageDigestEnable(_In_ DWORD dwPID, _In_ BOOL fEnable)
+{
+    CALL_IMPLEMENTATION_VMM(
+        STATISTICS_ID_VMMDLL_ProcessPageDigestEnable,
+        VMMDLL_ProcessPageDigestEnable_Impl(dwPID, fEnable))
+}
+
+_Success_(return)
+BOOL VMMDLL_ProcessPageDigestGetChanged_Impl(_In_ DWORD dwPID, _In_ ULONG64 qwGenerationSince, _Out_ PULONG64 pqwGeneration, _Out_writes_opt_(*pcPages) PULONG64 pvaPages, _Inout_ PDWORD pcPages)
+{
+    BOOL fResult;
+    PVMM_PROCESS pObProcess = NULL;
+    *pqwGeneration = 0;
+    if(!(pObProcess = VmmProcessGet(dwPID))) { return FALSE; }
+    fResult = VmmPageDigest_GetChanged(pObProcess, qwGenerationSince, pqwGeneration, pvaPages, pcPages);
+    Ob_DECREF(pObProcess);
+    return fResult;
+}
+
+_Success_(return)
+BOOL VMMDLL_ProcessPageDigestGetChanged(_In_ DWORD dwPID, _In_ ULONG64 qwGenerationSince, _Out_ PULONG64 pqwGeneration, _Out_writes_opt_(*pcPages) PULONG64 pvaPages, _Inout_ PDWORD pcPages)
+{
+    CALL_IMPLEMENTATION_VMM(
+        STATISTICS_ID_VMMDLL_ProcessPageDigestGetChanged,
+        VMMDLL_ProcessPageDigestGetChanged_Impl(dwPID, qwGenerationSince, pqwGeneration, pvaPages, pcPages))
+}
+
 
 
 //-----------------------------------------------------------------------------
@@ -1810,6 +2525,21 @@ BOOL VMMDLL_WinReg_QueryValueExW( _In_ LPWSTR wszFullPathKeyValue, _Out_opt_ LPD
         VmmWinReg_ValueQuery2(wszFullPathKeyValue, lpType, lpData, lpcbData ? *lpcbData : 0, lpcbData))
 }
 
+_Success_(return)
+BOOL VMMDLL_WinReg_QueryValueBatchW_Impl(_Inout_updates_(cValues) PVMMDLL_WINREG_QUERYVALUE pValues, _In_ DWORD cValues)
+{
+    return (sizeof(VMMDLL_WINREG_QUERYVALUE) == sizeof(VMMWINREG_QUERYVALUE)) &&
+        (VmmWinReg_ValueQueryBatch((PVMMWINREG_QUERYVALUE)pValues, cValues) > 0);
+}
+
+_Success_(return)
+BOOL VMMDLL_WinReg_QueryValueBatchW(_Inout_updates_(cValues) PVMMDLL_WINREG_QUERYVALUE pValues, _In_ DWORD cValues)
+{
+    CALL_IMPLEMENTATION_VMM(
+        STATISTICS_ID_VMMDLL_WinReg_QueryValueBatchW,
+        VMMDLL_WinReg_QueryValueBatchW_Impl(pValues, cValues))
+}
+
 
 
 //-----------------------------------------------------------------------------
@@ -1903,6 +2633,23 @@ BOOL VMMDLL_PdbSymbolName(_In_ LPSTR szModule, _In_ DWORD cbSymbolOffset, _Out_w
         VMMDLL_PdbSymbolName_Impl(szModule, cbSymbolOffset, szSymbolName, pdwSymbolDisplacement))
 }
 
+_Success_(return)
+BOOL VMMDLL_PdbSymbolNameBatch_Impl(_In_ LPSTR szModule, _Inout_updates_(cSymbols) PVMMDLL_PDB_SYMBOLNAME pSymbols, _In_ DWORD cSymbols)
+{
+    PDB_HANDLE hPdb;
+    if(sizeof(VMMDLL_PDB_SYMBOLNAME) != sizeof(PDB_SYMBOLNAME)) { return FALSE; }
+    hPdb = PDB_GetHandleFromModuleName(szModule);
+    return PDB_GetSymbolFromOffsetBatch(hPdb, (PPDB_SYMBOLNAME)pSymbols, cSymbols) > 0;
+}
+
+_Success_(return)
+BOOL VMMDLL_PdbSymbolNameBatch(_In_ LPSTR szModule, _Inout_updates_(cSymbols) PVMMDLL_PDB_SYMBOLNAME pSymbols, _In_ DWORD cSymbols)
+{
+    CALL_IMPLEMENTATION_VMM(
+        STATISTICS_ID_VMMDLL_PdbSymbolNameBatch,
+        VMMDLL_PdbSymbolNameBatch_Impl(szModule, pSymbols, cSymbols))
+}
+
 _Success_(return)
 BOOL VMMDLL_PdbSymbolAddress_Impl(_In_ LPSTR szModule, _In_ LPSTR szSymbolName, _Out_ PULONG64 pvaSymbolAddress)
 {
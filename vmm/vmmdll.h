@@ -113,12 +113,46 @@ VOID VMMDLL_MemFree(_Frees_ptr_opt_ PVOID pvMem);
 #define VMMDLL_OPT_CONFIG_VMM_VERSION_REVISION          0x2000000B'00000000  // R
 #define VMMDLL_OPT_CONFIG_STATISTICS_FUNCTIONCALL       0x2000000C'00000000  // RW - enable function call statistics (.status/statistics_fncall file)
 #define VMMDLL_OPT_CONFIG_IS_PAGING_ENABLED             0x2000000D'00000000  // RW - 1/0
+#define VMMDLL_OPT_CONFIG_CACHESIZE_PHYS                0x2000000E'00000000  // RW - physical memory cache size (in MB)
+#define VMMDLL_OPT_CONFIG_CACHESIZE_TLB                 0x2000000F'00000000  // RW - page table (tlb) cache size (in MB)
+#define VMMDLL_OPT_CONFIG_CACHESIZE_PAGING              0x20000010'00000000  // RW - virtual memory 'paging' cache size (in MB)
+#define VMMDLL_OPT_CONFIG_CACHE_PHYS_2Q                 0x20000011'00000000  // RW - 1/0 - scan resistant physical memory cache
+#define VMMDLL_OPT_CONFIG_READAHEAD_MAX                 0x20000012'00000000  // RW - max physical memory read-ahead (in pages), 0 = disabled
+#define VMMDLL_OPT_CONFIG_TLBCACHE_REVALIDATE           0x20000013'00000000  // RW - 1/0 - revalidate page table (tlb) cache on refresh instead of clear
+#define VMMDLL_OPT_CONFIG_STAT_CACHE_HIT                0x20000014'00000000  // R - cache hits - low dword = cache table: 1=PHYS 2=TLB 3=PAGING
+#define VMMDLL_OPT_CONFIG_STAT_CACHE_MISS               0x20000015'00000000  // R - cache misses - low dword = cache table
+#define VMMDLL_OPT_CONFIG_STAT_CACHE_EVICT              0x20000016'00000000  // R - cache evictions - low dword = cache table
+#define VMMDLL_OPT_CONFIG_STAT_CACHE_RESFAIL            0x20000017'00000000  // R - cache reserve failures - low dword = cache table
+#define VMMDLL_OPT_CONFIG_STAT_CACHE_INUSE              0x20000018'00000000  // R - cache entries in use - low dword = cache table
+#define VMMDLL_OPT_CONFIG_STAT_DEVICE_LATENCY           0x20000019'00000000  // R - device reads with latency < 2^n uS - low dword = n [0-15]
+#define VMMDLL_OPT_CONFIG_READ_COALESCE_US              0x2000001A'00000000  // RW - small read coalescing window in uS - 0 = disabled
+#define VMMDLL_OPT_CONFIG_CACHE_COMPRESS_MB             0x2000001B'00000000  // RW - compressed physical memory cache tier budget in MB - 0 = disabled
+#define VMMDLL_OPT_CONFIG_PHYS2VIRT_INDEX               0x2000001C'00000000  // R/W: global phys2virt reverse index enabled (0/1)
+#define VMMDLL_OPT_CONFIG_CACHE_PROTOTYPEPTE_MB         0x2000001D'00000000  // RW - prototype pte array cache budget in MB - 0 = default
+#define VMMDLL_OPT_CONFIG_WARMUP_MAPS                   0x2000001E'00000000  // RW - map types to pre-build after process refresh - bitmask: 1=vad 2=module 4=handle 8=thread
+#define VMMDLL_OPT_CONFIG_REGISTRY_LAZY                 0x2000001F'00000000  // RW - 1/0 - lazy registry hive snapshots - hive data fetched and keys built on demand
+#define VMMDLL_OPT_CONFIG_PLUGIN_LAZY                   0x20000020'00000000  // RW - 1/0 - lazy plugin loading - set before VMMDLL_InitializePlugins
+#define VMMDLL_OPT_CONFIG_REMOTE_PROFILE                0x20000021'00000000  // RW - 1/0 - remote device profile - pipelined bulk reads and round-trip time tuned coalescing and read-ahead
+#define VMMDLL_OPT_CONFIG_STAT_DEVICE_RTT_US            0x20000022'00000000  // R - smoothed round-trip time of small device reads in uS (remote profile only)
+#define VMMDLL_OPT_CONFIG_STAT_FNCALL_COUNT             0x20000023'00000000  // R - function call count - low dword = id as in statistics_fncall.json
+#define VMMDLL_OPT_CONFIG_STAT_FNCALL_P50_US            0x20000024'00000000  // R - function call median latency in uS - low dword = STATISTICS_ID
+#define VMMDLL_OPT_CONFIG_STAT_FNCALL_P95_US            0x20000025'00000000  // R - function call 95th percentile latency in uS - low dword = STATISTICS_ID
+#define VMMDLL_OPT_CONFIG_STAT_FNCALL_P99_US            0x20000026'00000000  // R - function call 99th percentile latency in uS - low dword = STATISTICS_ID
+#define VMMDLL_OPT_CONFIG_STAT_FNCALL_MAX_US            0x20000027'00000000  // R - function call max latency in uS - low dword = STATISTICS_ID
+#define VMMDLL_OPT_CONFIG_MEMORY_BUDGET_MB              0x20000028'00000000  // RW - global memory budget in MB - 0 = no budget
+#define VMMDLL_OPT_CONFIG_STAT_MEMORY_USAGE             0x20000029'00000000  // R - memory in use by budgeted subsystems in bytes
+#define VMMDLL_OPT_CONFIG_TLB_VERIFY_VECTOR             0x2000002A'00000000  // RW - 1/0 - vectorized x64 page table verify (0 = scalar, x64 only)
 
 #define VMMDLL_OPT_WIN_VERSION_MAJOR                    0x20000101'00000000  // R
 #define VMMDLL_OPT_WIN_VERSION_MINOR                    0x20000102'00000000  // R
 #define VMMDLL_OPT_WIN_VERSION_BUILD                    0x20000103'00000000  // R
 
-#define VMMDLL_OPT_FORENSIC_MODE                        0x20000201'00000000  // RW - enable/retrieve forensic mode type [0-4].
+#define VMMDLL_OPT_FORENSIC_MODE                        0x20000201'00000000  // RW - enable/retrieve forensic mode type [0-5].
+#define VMMDLL_OPT_FORENSIC_SCAN_CHUNKS                 0x20000202'00000000  // RW - forensic physical memory scan pipeline depth (# chunks in flight) - 0 = default (4)
+#define VMMDLL_OPT_FORENSIC_SCAN_CHUNK_MB               0x20000203'00000000  // RW - forensic physical memory scan chunk size in MB - 0 = default (16)
+#define VMMDLL_OPT_FORENSIC_MEMORY_BUDGET_MB            0x20000204'00000000  // RW - in-memory forensic database (mode 5) spill-to-disk budget in MB - 0 = default (4096)
+#define VMMDLL_OPT_FORENSIC_DATABASE_SAVE               0x20000205'00000000  // W - save in-memory forensic database (mode 5) to its temp file
+#define VMMDLL_OPT_FORENSIC_INIT_STATUS                 0x20000206'00000000  // R - forensic initialization status - 0 = not started, 1 = in progress, 2 = completed
 
 #define VMMDLL_OPT_REFRESH_ALL                          0x2001ffff'00000000  // W - refresh all caches
 #define VMMDLL_OPT_REFRESH_PROCESS                      0x20010001'00000000  // W - refresh process listings
@@ -170,6 +204,44 @@ BOOL VMMDLL_ConfigGet(_In_ ULONG64 fOption, _Out_ PULONG64 pqwValue);
 _Success_(return)
 BOOL VMMDLL_ConfigSet(_In_ ULONG64 fOption, _In_ ULONG64 qwValue);
 
+/*
+* Begin a consistent analysis snapshot. While at least one snapshot is active
+* destructive background refreshes (i.e. cache flushes and process/map
+* refreshes) are deferred - for at most 60s. Process lookups, the global maps
+* (physical memory, users, network, process tree) and the page digest
+* generation are served from the state pinned by the most recent snapshot also
+* if a user-initiated refresh by VMMDLL_ConfigSet(VMMDLL_OPT_REFRESH_*) takes
+* place. This allows multi-step analysis (list PIDs, retrieve maps, read
+* memory) to see a consistent view without straddling a refresh. A snapshot
+* expires 60s after it began - lookups then use the current state again.
+* Every successful call must be matched by a call to VMMDLL_SnapshotEnd.
+* -- pqwSnapshotId = receives an id to pass to VMMDLL_SnapshotEnd.
+* -- return = success/fail.
+*/
+_Success_(return)
+BOOL VMMDLL_SnapshotBegin(_Out_ PULONG64 pqwSnapshotId);
+
+/*
+* End a snapshot started by VMMDLL_SnapshotBegin. Deferred refreshes will take
+* place at the next background refresh tick once no snapshot is active.
+* -- qwSnapshotId
+* -- return = success/fail. Fails if the snapshot has expired.
+*/
+_Success_(return)
+BOOL VMMDLL_SnapshotEnd(_In_ ULONG64 qwSnapshotId);
+
+/*
+* Export a forensic database table to a file in the Apache Arrow IPC streaming
+* format (.arrows) for direct ingestion into columnar analytics tools. Rows are
+* streamed in record batches so memory use is bounded regardless of the table
+* size. Requires forensic mode to be enabled and its processing to be complete.
+* -- szTable = timeline, ntfs, process, thread, registry, pattern or pfn.
+* -- wszFileName = destination file, overwritten if it exists.
+* -- return = success/fail.
+*/
+_Success_(return)
+BOOL VMMDLL_ForensicExportTable(_In_ LPSTR szTable, _In_ LPWSTR wszFileName);
+
 
 
 //-----------------------------------------------------------------------------
@@ -378,6 +450,7 @@ typedef struct tdVMMDLL_PLUGIN_REGINFO {
 #define VMMDLL_FLAG_NOPAGING                        0x0010  // do not try to retrieve memory from paged out memory from pagefile/compressed (even if possible)
 #define VMMDLL_FLAG_NOPAGING_IO                     0x0020  // do not try to retrieve memory from paged out memory if read would incur additional I/O (even if possible).
 #define VMMDLL_FLAG_NOCACHEPUT                      0x0100  // do not write back to the data cache upon successful read from memory acquisition device.
+#define VMMDLL_FLAG_PRIORITY_BULK                   0x0200  // low priority bulk read - device reads are sliced and yield to interactive (normal) reads.
 
 /*
 * Read memory in various non-contigious locations specified by the pointers to
@@ -394,6 +467,33 @@ typedef struct tdVMMDLL_PLUGIN_REGINFO {
 */
 DWORD VMMDLL_MemReadScatter(_In_ DWORD dwPID, _Inout_ PPMEM_SCATTER ppMEMs, _In_ DWORD cpMEMs, _In_ DWORD flags);
 
+/*
+* Callback function called upon completion of an asynchronous scatter read.
+* -- ctx = the user context supplied to VMMDLL_MemReadScatterAsync.
+* -- ppMEMs = array of scatter read headers.
+* -- cpMEMs = count of ppMEMs.
+* -- cMEMsRead = the number of successfully read items.
+*/
+typedef VOID(*VMMDLL_MEM_SCATTER_ASYNC_CALLBACK)(_In_opt_ PVOID ctx, _In_ PPMEM_SCATTER ppMEMs, _In_ DWORD cpMEMs, _In_ DWORD cMEMsRead);
+
+/*
+* Asynchronous version of VMMDLL_MemReadScatter. The read is queued to the MemProcFS
+* worker thread pool and the function returns immediately. Upon completion the
+* optional callback is called (on a worker thread) and the returned event is
+* signalled. The ppMEMs array and its items must remain valid until completion.
+* All asynchronous reads must have completed before calling VMMDLL_Close.
+* CALLER CloseHandle: return
+* -- dwPID - PID of target process, (DWORD)-1 to read physical memory.
+* -- ppMEMs = array of scatter read headers.
+* -- cpMEMs = count of ppMEMs.
+* -- flags = optional flags as given by VMMDLL_FLAG_*
+* -- pfnCallback = optional callback function called upon completion.
+* -- ctx = optional user context passed to pfnCallback.
+* -- return = event handle signalled upon completion, NULL on fail.
+*/
+_Success_(return != NULL)
+HANDLE VMMDLL_MemReadScatterAsync(_In_ DWORD dwPID, _Inout_ PPMEM_SCATTER ppMEMs, _In_ DWORD cpMEMs, _In_ DWORD flags, _In_opt_ VMMDLL_MEM_SCATTER_ASYNC_CALLBACK pfnCallback, _In_opt_ PVOID ctx);
+
 /*
 * Read a single 4096-byte page of memory.
 * -- dwPID - PID of target process, (DWORD)-1 to read physical memory.
@@ -470,6 +570,136 @@ BOOL VMMDLL_MemVirt2Phys(_In_ DWORD dwPID, _In_ ULONG64 qwVA, _Out_ PULONG64 pqw
 
 
 
+//-----------------------------------------------------------------------------
+// VMM SCATTER READ FUNCTIONALITY BELOW:
+// Batch many small reads of arbitrary size and alignment into one scatter read.
+// Reads are first prepared on a scatter handle, then executed in one call and
+// finally the (page-deduplicated) results are read from the handle.
+// A scatter handle is not thread-safe w.r.t. VMMDLL_Scatter_CloseHandle.
+//-----------------------------------------------------------------------------
+
+typedef HANDLE                              VMMDLL_SCATTER_HANDLE;
+
+/*
+* Initialize a scatter handle which is used to efficiently read memory in
+* batches of arbitrarily sized and aligned reads.
+* CALLER VMMDLL_Scatter_CloseHandle: return
+* -- dwPID - PID of target process, (DWORD)-1 to read physical memory.
+* -- flags = optional flags as given by VMMDLL_FLAG_*
+* -- return = handle to be used in VMMDLL_Scatter_* functions, NULL on fail.
+*/
+_Success_(return != NULL)
+VMMDLL_SCATTER_HANDLE VMMDLL_Scatter_Initialize(_In_ DWORD dwPID, _In_ DWORD flags);
+
+/*
+* Prepare (add) a memory range for reading. The read will not take place until
+* VMMDLL_Scatter_Execute is called.
+* -- hS
+* -- va = start address of the memory range to read.
+* -- cb = byte count of the memory range to read.
+* -- return
+*/
+_Success_(return)
+BOOL VMMDLL_Scatter_Prepare(_In_ VMMDLL_SCATTER_HANDLE hS, _In_ ULONG64 va, _In_ DWORD cb);
+
+/*
+* Read all prepared memory ranges in a single scatter read. Results of any
+* previous execute are discarded. Prepared ranges are kept and may be read
+* again by calling VMMDLL_Scatter_Execute anew.
+* -- hS
+* -- return
+*/
+_Success_(return)
+BOOL VMMDLL_Scatter_Execute(_In_ VMMDLL_SCATTER_HANDLE hS);
+
+/*
+* Read memory from a previously executed scatter handle. The memory range need
+* not be identical to a prepared range, but only memory contained in prepared
+* ranges is readable. Unreadable memory is zero-filled.
+* -- hS
+* -- va
+* -- cb
+* -- pb
+* -- pcbRead = optional number of bytes successfully read.
+* -- return = TRUE if all bytes were read successfully.
+*/
+_Success_(return)
+BOOL VMMDLL_Scatter_Read(_In_ VMMDLL_SCATTER_HANDLE hS, _In_ ULONG64 va, _In_ DWORD cb, _Out_writes_(cb) PBYTE pb, _Out_opt_ PDWORD pcbRead);
+
+/*
+* Clear a scatter handle of all prepared ranges and read results and set a new
+* target PID and flags.
+* -- hS
+* -- dwPID - PID of target process, (DWORD)-1 to read physical memory.
+* -- flags = optional flags as given by VMMDLL_FLAG_*
+* -- return
+*/
+_Success_(return)
+BOOL VMMDLL_Scatter_Clear(_In_ VMMDLL_SCATTER_HANDLE hS, _In_ DWORD dwPID, _In_ DWORD flags);
+
+/*
+* Close a scatter handle and free its resources.
+* -- hS
+*/
+VOID VMMDLL_Scatter_CloseHandle(_In_opt_ _Post_ptr_invalid_ VMMDLL_SCATTER_HANDLE hS);
+
+
+
+//-----------------------------------------------------------------------------
+// VMM MEMORY SEARCH FUNCTIONALITY BELOW:
+// Search process virtual memory, all processes or physical memory for up to
+// VMMDLL_MEM_SEARCH_MAX byte patterns (with optional wildcard bit masks) in a
+// single parallel pass. Hits are reported to an optional callback which may
+// terminate the search early.
+//-----------------------------------------------------------------------------
+
+#define VMMDLL_MEM_SEARCH_VERSION           0xfe3e0001
+#define VMMDLL_MEM_SEARCH_MAX               16
+#define VMMDLL_MEM_SEARCH_MAXLENGTH         32
+#define VMMDLL_MEM_SEARCH_PID_ALL           ((DWORD)-2)     // search all processes
+
+typedef struct tdVMMDLL_MEM_SEARCH_CONTEXT_SEARCHENTRY {
+    DWORD cbAlign;                          // byte alignment of hits (0/1 = any, otherwise power of two <= 0x1000)
+    DWORD cb;                               // pattern length in bytes (1..VMMDLL_MEM_SEARCH_MAXLENGTH)
+    BYTE pb[VMMDLL_MEM_SEARCH_MAXLENGTH];   // pattern
+    BYTE pbSkipMask[VMMDLL_MEM_SEARCH_MAXLENGTH];   // bits set are wildcards (zero = exact match)
+} VMMDLL_MEM_SEARCH_CONTEXT_SEARCHENTRY, *PVMMDLL_MEM_SEARCH_CONTEXT_SEARCHENTRY;
+
+typedef struct tdVMMDLL_MEM_SEARCH_CONTEXT {
+    DWORD dwVersion;                        // VMMDLL_MEM_SEARCH_VERSION
+    DWORD cSearch;                          // # valid search entries
+    VMMDLL_MEM_SEARCH_CONTEXT_SEARCHENTRY search[VMMDLL_MEM_SEARCH_MAX];
+    QWORD vaMin;                            // min address to search
+    QWORD vaMax;                            // max address to search (0 = no limit)
+    DWORD ReadFlags;                        // optional VMMDLL_FLAG_* for the memory reads
+    BOOL fForceW;                           // virtual memory: only search writable pages
+    BOOL fForceX;                           // virtual memory: only search executable pages
+    DWORD cMaxResult;                       // stop after # hits (0 = max 0x01000000)
+    BOOL volatile fAbortRequested;          // set by caller to abort the search
+    DWORD cResult;                          // out: # hits
+    QWORD cbReadTotal;                      // out: # bytes read and searched
+    PVOID pvUserPtrOpt;                     // optional caller pointer for the callback
+    // optional result callback - called after the search in pid/address order. Return FALSE to stop.
+    BOOL(*pfnResultOptCB)(_In_ struct tdVMMDLL_MEM_SEARCH_CONTEXT *ctx, _In_ DWORD dwPID, _In_ QWORD va, _In_ DWORD iSearch);
+} VMMDLL_MEM_SEARCH_CONTEXT, *PVMMDLL_MEM_SEARCH_CONTEXT;
+
+/*
+* Search memory for byte patterns. Process virtual memory is searched along the
+* process PTE map, physical memory along the physical memory map. The search is
+* split into large scatter reads which are searched in parallel.
+* Hits are reported to the callback on the calling thread once the search has
+* completed - sorted by pid, address and search entry index.
+* NB! must not be called from a VmmWork thread (such as plugin parallel tasks).
+* -- dwPID = PID of process, (DWORD)-1 for physical memory or
+*            VMMDLL_MEM_SEARCH_PID_ALL for all processes.
+* -- ctx = search context, result counts are returned in the context.
+* -- return = TRUE on completed or aborted search, FALSE on invalid context.
+*/
+_Success_(return)
+BOOL VMMDLL_MemSearch(_In_ DWORD dwPID, _Inout_ PVMMDLL_MEM_SEARCH_CONTEXT ctx);
+
+
+
 //-----------------------------------------------------------------------------
 // VMM PROCESS MAP FUNCTIONALITY BELOW:
 // Functionality for retrieving process related collections of items such as
@@ -1053,6 +1283,20 @@ BOOL VMMDLL_ProcessGetIAT(_In_ DWORD dwPID, _In_ LPWSTR wszModule, _Out_opt_ PVM
 */
 ULONG64 VMMDLL_ProcessGetProcAddress(_In_ DWORD dwPID, _In_ LPWSTR wszModuleName, _In_ LPSTR szFunctionName);
 
+/*
+* Retrieve the virtual addresses of multiple functions inside a process/module
+* in one call. This is more efficient than multiple calls to the function
+* VMMDLL_ProcessGetProcAddress.
+* -- dwPID
+* -- wszModuleName
+* -- cFunctions
+* -- pszFunctionNames = array of cFunctions function names.
+* -- pvaFunctions = array of cFunctions receiving the virtual address of each
+*                   function, zero if not found.
+* -- return = number of functions found.
+*/
+DWORD VMMDLL_ProcessGetProcAddressBatch(_In_ DWORD dwPID, _In_ LPWSTR wszModuleName, _In_ DWORD cFunctions, _In_reads_(cFunctions) LPSTR *pszFunctionNames, _Out_writes_(cFunctions) PULONG64 pvaFunctions);
+
 /*
 * Retrieve the base address of a given module.
 * -- dwPID
@@ -1061,6 +1305,35 @@ ULONG64 VMMDLL_ProcessGetProcAddress(_In_ DWORD dwPID, _In_ LPWSTR wszModuleName
 */
 ULONG64 VMMDLL_ProcessGetModuleBase(_In_ DWORD dwPID, _In_ LPWSTR wszModuleName);
 
+/*
+* Enable or disable page digest tracking for a process. While enabled a 32-bit
+* digest is recorded for each page read from the process by any VMMDLL_Mem*
+* function. Combined with VMMDLL_ProcessPageDigestGetChanged this allows live
+* monitoring to process only pages that changed between refreshes.
+* Disabling tracking discards all previously collected digests.
+* -- dwPID
+* -- fEnable
+* -- return = success/fail.
+*/
+_Success_(return)
+BOOL VMMDLL_ProcessPageDigestEnable(_In_ DWORD dwPID, _In_ BOOL fEnable);
+
+/*
+* Retrieve the (sorted) addresses of pages whose content changed, or which
+* were read for the first time, after a given generation. The generation is
+* increased each time a read observes a new page content - also when reading
+* with VMMDLL_FLAG_NOCACHE. Pages are only tracked when read - re-read the
+* memory of interest before calling.
+* -- dwPID
+* -- qwGenerationSince = generation returned in a previous call (0 = all pages).
+* -- pqwGeneration = receives the current generation.
+* -- pvaPages = buffer to receive page addresses, or NULL for size query.
+* -- pcPages = in: # entries in pvaPages, out: # changed pages.
+* -- return = success/fail.
+*/
+_Success_(return)
+BOOL VMMDLL_ProcessPageDigestGetChanged(_In_ DWORD dwPID, _In_ ULONG64 qwGenerationSince, _Out_ PULONG64 pqwGeneration, _Out_writes_opt_(*pcPages) PULONG64 pvaPages, _Inout_ PDWORD pcPages);
+
 
 
 //-----------------------------------------------------------------------------
@@ -1090,6 +1363,28 @@ BOOL VMMDLL_PdbLoad(_In_ DWORD dwPID, _In_ ULONG64 vaModuleBase, _Out_writes_(MA
 _Success_(return)
 BOOL VMMDLL_PdbSymbolName(_In_ LPSTR szModule, _In_ DWORD cbSymbolOffset, _Out_writes_(MAX_PATH) LPSTR szSymbolName, _Out_opt_ PDWORD pdwSymbolDisplacement);
 
+typedef struct tdVMMDLL_PDB_SYMBOLNAME {
+    DWORD cbSymbolOffset;           // [in] offset from module base
+    DWORD dwSymbolDisplacement;     // [out] displacement from the beginning of the symbol
+    BOOL fResult;                   // [out] TRUE on success
+    CHAR szSymbolName[MAX_PATH];    // [out] symbol name
+} VMMDLL_PDB_SYMBOLNAME, *PVMMDLL_PDB_SYMBOLNAME;
+
+/*
+* Retrieve the symbol names closest to multiple offsets in a module in one
+* call. This is much faster than calling VMMDLL_PdbSymbolName for each offset
+* when many offsets are resolved. Result of each offset is found in its
+* fResult field.
+* NB! not all modules may exist - initially only module "nt" is available.
+* NB! if multiple modules have the same name the 1st to be added will be used.
+* -- szModule
+* -- pSymbols
+* -- cSymbols
+* -- return = TRUE if at least one offset was successfully resolved.
+*/
+_Success_(return)
+BOOL VMMDLL_PdbSymbolNameBatch(_In_ LPSTR szModule, _Inout_updates_(cSymbols) PVMMDLL_PDB_SYMBOLNAME pSymbols, _In_ DWORD cSymbols);
+
 /*
 * Retrieve a symbol virtual address given a module name and a symbol name.
 * NB! not all modules may exist - initially only module "nt" is available.
@@ -1264,6 +1559,29 @@ BOOL VMMDLL_WinReg_QueryValueExW(
     _When_(lpData == NULL, _Out_opt_) _When_(lpData != NULL, _Inout_opt_) LPDWORD lpcbData
 );
 
+typedef struct tdVMMDLL_WINREG_QUERYVALUE {
+    LPWSTR wszFullPathKeyValue;     // [in] key/value path - same format as in VMMDLL_WinReg_QueryValueExW
+    PBYTE pbData;                   // [in,opt] buffer to receive value data (or NULL to retrieve size only)
+    DWORD cbData;                   // [in] size of pbData, [out] bytes read (or value size if pbData is NULL)
+    DWORD dwType;                   // [out] registry value type
+    BOOL fResult;                   // [out] TRUE on success
+} VMMDLL_WINREG_QUERYVALUE, *PVMMDLL_WINREG_QUERYVALUE;
+
+/*
+* Query multiple registry values in one call. Values are grouped by hive and
+* key internally so that each key is only resolved once - this is much faster
+* than calling VMMDLL_WinReg_QueryValueExW for each value when many values are
+* read from the same keys. Result of each value is found in its fResult field.
+* -- pValues
+* -- cValues
+* -- return = TRUE if at least one value was successfully queried.
+*/
+_Success_(return)
+BOOL VMMDLL_WinReg_QueryValueBatchW(
+    _Inout_updates_(cValues) PVMMDLL_WINREG_QUERYVALUE pValues,
+    _In_ DWORD cValues
+);
+
 
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,191 @@
+// vmmmembudget.c : implementation of per-subsystem memory accounting and of
+//                  the global memory budget.
+//
+// Eviction is done in priority order - cheapest to rebuild first - and stops
+// as soon as the memory in use is within the budget. Within each step the
+// regular replacement policy of the evicted cache is used. Per-process maps
+// are not individually locked and may only be released by rebuilding the
+// process table (total process refresh) which is the step of last resort.
+//
+// (c) MemProcFS contributors, 2020
+// Author: MemProcFS contributors
+//
+
+#include "vmmmembudget.h"
+#include "vmmproc.h"
+#include "vmmwin.h"
+#include "vmmwinnet.h"
+#include "vmmwinobj.h"
+#include "vmmwinreg.h"
+#include "mm.h"
+#include "mm_pfn.h"
+#include "pluginmanager.h"
+
+typedef struct tdVMMMEMBUDGET_SUBSYSTEM_DEF {
+    LPSTR szName;
+    BOOL fEnforced;
+    DWORD tags[16];                 // zero terminated
+} VMMMEMBUDGET_SUBSYSTEM_DEF;
+
+static const VMMMEMBUDGET_SUBSYSTEM_DEF g_VmmMemBudgetSubsystem[VMMMEMBUDGET_SUBSYSTEM_MAX] = {
+    { "cache_phys",     FALSE, { VMM_CACHE_TAG_PHYS } },
+    { "cache_tlb",      FALSE, { VMM_CACHE_TAG_TLB } },
+    { "cache_paging",   FALSE, { VMM_CACHE_TAG_PAGING } },
+    { "cache_compress", TRUE,  { 0 } },
+    { "prototype_pte",  TRUE,  { 'MmSt' } },
+    { "registry",       TRUE,  { OB_TAG_REG_HIVE, OB_TAG_REG_KEY, OB_TAG_REG_KEYVALUE, OB_TAG_REG_PATHINDEX } },
+    { "process",        TRUE,  { OB_TAG_VMM_PROCESS, OB_TAG_VMM_PROCESS_CLONE, OB_TAG_VMM_PROCESS_PERSISTENT, OB_TAG_VMM_PROCESSTABLE, OB_TAG_VMM_PHYS2VIRT_INDEX, OB_TAG_VMM_PHYS2VIRT_PROCESS, OB_TAG_VMM_PAGEDIGEST } },
+    { "map",            TRUE,  { OB_TAG_MAP_PTE, OB_TAG_MAP_PTE_INCREMENTAL, OB_TAG_MAP_VAD, OB_TAG_MAP_VAD_INCREMENTAL, OB_TAG_MAP_MODULE, OB_TAG_MAP_THREAD, OB_TAG_MAP_HANDLE, OB_TAG_MAP_ADDRESS, OB_TAG_MAP_PHYSMEM, OB_TAG_MAP_USER, OB_TAG_MAP_NET, OB_TAG_MAP_PFN, 'HeaM', OB_TAG_PFN_CONTEXT, OB_TAG_PFN_PROC_TABLE } },
+    { "module",         TRUE,  { OB_TAG_PE_MODULECACHE, 'PeEA', 'PeIA', 'MPeD' } },
+    { "object",         TRUE,  { OB_TAG_WIN_OBJECTNAME, OB_TAG_OBJ_FILE, OB_TAG_OBJ_ERROR } },
+    { "minidump",       TRUE,  { OB_TAG_MOD_MINIDUMP_CTX, OB_TAG_VMMVFS_DUMPCONTEXT } },
+    { "pdb",            TRUE,  { OB_TAG_PDB_ENTRY } },
+    { "forensic",       TRUE,  { 'Fidx', 'FSCN', OB_TAG_FC_WINREG_PARALLEL, 'Mntf', 'Mtml' } },
+    { "core",           TRUE,  { OB_TAG_CORE_CONTAINER, OB_TAG_CORE_DATA, OB_TAG_CORE_SET, OB_TAG_CORE_MAP, OB_TAG_CORE_STRMAP } },
+    { "other",          TRUE,  { 0 } },
+};
+
+/*
+* Retrieve the subsystem an object manager tag is accounted to.
+* -- tag
+* -- return = VMMMEMBUDGET_SUBSYSTEM_*
+*/
+DWORD VmmMemBudget_SubsystemFromTag(_In_ DWORD tag)
+{
+    DWORD iSubsystem, iTag;
+    for(iSubsystem = 0; iSubsystem < VMMMEMBUDGET_SUBSYSTEM_OTHER; iSubsystem++) {
+        for(iTag = 0; (iTag < _countof(g_VmmMemBudgetSubsystem[0].tags)) && g_VmmMemBudgetSubsystem[iSubsystem].tags[iTag]; iTag++) {
+            if(g_VmmMemBudgetSubsystem[iSubsystem].tags[iTag] == tag) {
+                return iSubsystem;
+            }
+        }
+    }
+    return VMMMEMBUDGET_SUBSYSTEM_OTHER;
+}
+
+VOID VmmMemBudget_Usage(_Out_ PVMMMEMBUDGET_USAGE pUsage)
+{
+    DWORD i, iSubsystem, cEntry;
+    OB_ACCOUNTING_ENTRY pEntry[OB_ACCOUNTING_TAGS_MAX + 1];
+    ZeroMemory(pUsage, sizeof(VMMMEMBUDGET_USAGE));
+    pUsage->cbMax = ctxVmm->MemBudget.cbMax;
+    pUsage->cEvict = ctxVmm->stat.cMemBudgetEvict;
+    for(i = 0; i < VMMMEMBUDGET_SUBSYSTEM_MAX; i++) {
+        pUsage->Subsystem[i].szName = g_VmmMemBudgetSubsystem[i].szName;
+        pUsage->Subsystem[i].fEnforced = g_VmmMemBudgetSubsystem[i].fEnforced;
+    }
+    cEntry = Ob_AccountingGet(pEntry, OB_ACCOUNTING_TAGS_MAX + 1);
+    for(i = 0; i < cEntry; i++) {
+        iSubsystem = VmmMemBudget_SubsystemFromTag(pEntry[i].tag);
+        pUsage->Subsystem[iSubsystem].c += pEntry[i].c;
+        pUsage->Subsystem[iSubsystem].cb += pEntry[i].cb;
+    }
+    // the compressed cache tier is allocated outside of the object manager.
+    if(ctxVmm->CacheCompress.fInitialized) {
+        pUsage->Subsystem[VMMMEMBUDGET_SUBSYSTEM_CACHE_COMPRESS].c = ObMap_Size(ctxVmm->CacheCompress.pm);
+        pUsage->Subsystem[VMMMEMBUDGET_SUBSYSTEM_CACHE_COMPRESS].cb = ctxVmm->CacheCompress.cb;
+    }
+    for(i = 0; i < VMMMEMBUDGET_SUBSYSTEM_MAX; i++) {
+        pUsage->cbTotal += pUsage->Subsystem[i].cb;
+        if(pUsage->Subsystem[i].fEnforced) {
+            pUsage->cbEnforced += pUsage->Subsystem[i].cb;
+        }
+    }
+}
+
+/*
+* Retrieve the number of bytes the memory subject to the budget exceeds the
+* budget with.
+* -- return = bytes over budget, 0 if within budget.
+*/
+QWORD VmmMemBudget_Excess()
+{
+    VMMMEMBUDGET_USAGE Usage;
+    VmmMemBudget_Usage(&Usage);
+    if(!Usage.cbMax || (Usage.cbEnforced <= Usage.cbMax)) { return 0; }
+    return Usage.cbEnforced - Usage.cbMax;
+}
+
+/*
+* Release the per-process maps by a forced total process refresh - all process
+* objects are re-created (unchanged processes are not kept). This is rate
+* limited since it's costly to rebuild and may evict maps in active use.
+* -- return = TRUE if the process table was refreshed.
+*/
+BOOL VmmMemBudget_EvictProcess()
+{
+    BOOL fResult;
+    QWORD qwTickCount = GetTickCount64();
+    if((ctxVmm->tpSystem != VMM_SYSTEM_WINDOWS_X64) && (ctxVmm->tpSystem != VMM_SYSTEM_WINDOWS_X86)) { return FALSE; }
+    if(qwTickCount - ctxVmm->MemBudget.qwTickProcessRefresh < VMMMEMBUDGET_PROCESS_REFRESH_MIN_MS) { return FALSE; }
+    if(VmmSnapshotIsRefreshDeferred()) { return FALSE; }
+    ctxVmm->MemBudget.qwTickProcessRefresh = qwTickCount;
+    EnterCriticalSection(&ctxVmm->LockMaster);
+    fResult = VmmProc_RefreshProcesses(TRUE);
+    LeaveCriticalSection(&ctxVmm->LockMaster);
+    if(fResult) {
+        VmmWinHandle_Refresh();
+        PluginManager_Notify(VMMDLL_PLUGIN_EVENT_REFRESH_PROCESS_TOTAL, NULL, 0);
+        MmPfn_Refresh();
+    }
+    return fResult;
+}
+
+VOID VmmMemBudget_Enforce()
+{
+    DWORD i, iStep;
+    QWORD cbExcess;
+    for(iStep = 0; (cbExcess = VmmMemBudget_Excess()); iStep++) {
+        switch(iStep) {
+            case 0:     // compressed physical memory cache tier
+                VmmCacheCompressShrink(cbExcess);
+                break;
+            case 1:     // process independent module parse results
+                for(i = 0; i < _countof(ctxVmm->ModuleCache.pm); i++) {
+                    ObMap_Clear(ctxVmm->ModuleCache.pm[i]);
+                }
+                break;
+            case 2:     // prototype pte arrays
+                MmVad_PrototypePteCache_Shrink(cbExcess);
+                break;
+            case 3:     // global derived maps
+                VmmWinNet_Refresh();
+                VmmWinObj_Refresh();
+                VmmWinHandle_Refresh();
+                break;
+            case 4:     // registry hive snapshots
+                VmmWinReg_Refresh();
+                PluginManager_Notify(VMMDLL_PLUGIN_EVENT_REFRESH_REGISTRY, NULL, 0);
+                break;
+            case 5:     // per-process maps - last resort
+                if(!VmmMemBudget_EvictProcess()) { return; }
+                break;
+            default:
+                return;
+        }
+        InterlockedIncrement64(&ctxVmm->stat.cMemBudgetEvict);
+    }
+}
+
+DWORD VmmMemBudget_ThreadProc(_In_ LPVOID lpParameter)
+{
+    vmmprintfv("VmmMemBudget: Start memory budget enforcement.\n");
+    while(ctxVmm->Work.fEnabled) {
+        Sleep(VMMMEMBUDGET_PERIOD_MS);
+        if(ctxVmm->MemBudget.cbMax) {
+            VmmMemBudget_Enforce();
+        }
+    }
+    vmmprintfv("VmmMemBudget: Exit memory budget enforcement.\n");
+    return 0;
+}
+
+_Success_(return)
+BOOL VmmMemBudget_Configure(_In_ DWORD cMB)
+{
+    ctxVmm->MemBudget.cbMax = (QWORD)cMB << 20;
+    if(cMB && !InterlockedCompareExchange(&ctxVmm->MemBudget.fThread, TRUE, FALSE)) {
+        VmmWork((LPTHREAD_START_ROUTINE)VmmMemBudget_ThreadProc, NULL, 0);
+    }
+    return TRUE;
+}
@@ -0,0 +1,71 @@
+// vmmmembudget.h : declarations of per-subsystem memory accounting and of the
+//                  global memory budget.
+//
+// Memory is accounted per object manager tag (see Ob_AccountingGet) and the
+// tags are grouped into subsystems. If a memory budget is set a background
+// thread evicts cached data - cheapest to rebuild first - until the memory
+// in use is within the budget again.
+//
+// (c) MemProcFS contributors, 2020
+// Author: MemProcFS contributors
+//
+#ifndef __VMMMEMBUDGET_H__
+#define __VMMMEMBUDGET_H__
+#include "vmm.h"
+
+#define VMMMEMBUDGET_SUBSYSTEM_CACHE_PHYS       0
+#define VMMMEMBUDGET_SUBSYSTEM_CACHE_TLB        1
+#define VMMMEMBUDGET_SUBSYSTEM_CACHE_PAGING     2
+#define VMMMEMBUDGET_SUBSYSTEM_CACHE_COMPRESS   3
+#define VMMMEMBUDGET_SUBSYSTEM_PROTOTYPEPTE     4
+#define VMMMEMBUDGET_SUBSYSTEM_REGISTRY         5
+#define VMMMEMBUDGET_SUBSYSTEM_PROCESS          6
+#define VMMMEMBUDGET_SUBSYSTEM_MAP              7
+#define VMMMEMBUDGET_SUBSYSTEM_MODULE           8
+#define VMMMEMBUDGET_SUBSYSTEM_OBJECT           9
+#define VMMMEMBUDGET_SUBSYSTEM_MINIDUMP         10
+#define VMMMEMBUDGET_SUBSYSTEM_PDB              11
+#define VMMMEMBUDGET_SUBSYSTEM_FORENSIC         12
+#define VMMMEMBUDGET_SUBSYSTEM_CORE             13
+#define VMMMEMBUDGET_SUBSYSTEM_OTHER            14
+#define VMMMEMBUDGET_SUBSYSTEM_MAX              15
+
+#define VMMMEMBUDGET_PERIOD_MS                  1000
+#define VMMMEMBUDGET_PROCESS_REFRESH_MIN_MS     (10 * 1000)     // min time between budget enforced process refreshes
+
+typedef struct tdVMMMEMBUDGET_USAGE {
+    QWORD cbMax;                    // memory budget (0 = no budget)
+    QWORD cbTotal;                  // memory in use - all subsystems
+    QWORD cbEnforced;               // memory in use - subsystems subject to the budget
+    QWORD cEvict;                   // eviction steps taken to enforce the budget
+    struct {
+        LPSTR szName;
+        BOOL fEnforced;             // subsystem is subject to the budget
+        QWORD c;                    // live objects / entries
+        QWORD cb;                   // live bytes
+    } Subsystem[VMMMEMBUDGET_SUBSYSTEM_MAX];
+} VMMMEMBUDGET_USAGE, *PVMMMEMBUDGET_USAGE;
+
+/*
+* Retrieve the current memory usage per subsystem.
+* -- pUsage
+*/
+VOID VmmMemBudget_Usage(_Out_ PVMMMEMBUDGET_USAGE pUsage);
+
+/*
+* Set the global memory budget. The fixed size cache tables (phys/tlb/paging)
+* are sized by their own options and are not subject to the budget. Setting a
+* non-zero budget starts the background budget enforcement (if not started).
+* -- cMB = memory budget in MB, 0 = no budget.
+* -- return
+*/
+_Success_(return)
+BOOL VmmMemBudget_Configure(_In_ DWORD cMB);
+
+/*
+* Enforce the memory budget once - evict cached data until the memory in use
+* is within the budget (or nothing more may be evicted).
+*/
+VOID VmmMemBudget_Enforce();
+
+#endif /* __VMMMEMBUDGET_H__ */
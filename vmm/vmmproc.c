@@ -6,6 +6,7 @@
 
 #include "vmmdll.h"
 #include "vmmproc.h"
+#include "vmmmembudget.h"
 #include "vmmwin.h"
 #include "vmmwininit.h"
 #include "vmmwinnet.h"
@@ -70,6 +71,101 @@ BOOL VmmProc_RefreshProcesses(_In_ BOOL fRefreshTotal)
     return TRUE;
 }
 
+typedef struct tdVMMPROC_WARMUP_CONTEXT {
+    DWORD dwMaps;
+    QWORD tcDeadline;
+    QWORD cPagesStart;
+    QWORD cPagesMax;
+} VMMPROC_WARMUP_CONTEXT, *PVMMPROC_WARMUP_CONTEXT;
+
+/*
+* Check whether the warm-up should continue. If external (api/vfs) calls are
+* currently active the warm-up yields until they are done (or for at most
+* VMM_DEVICE_BULK_MAXWAIT_MS) so that foreground requests go first. Device
+* reads issued by the warm-up's own workers are not waited for.
+* -- ctx
+* -- return = TRUE if warm-up is within budget and should continue.
+*/
+BOOL VmmProc_Warmup_Continue(_In_ PVMMPROC_WARMUP_CONTEXT ctx)
+{
+    QWORD tcStart;
+    if(!ctxVmm->Work.fEnabled || !ctxVmm->ThreadProcCache.fEnabled) { return FALSE; }
+    if(GetTickCount64() > ctx->tcDeadline) { return FALSE; }
+    if(ctxVmm->stat.cDeviceReadPages - ctx->cPagesStart > ctx->cPagesMax) { return FALSE; }
+    AcquireSRWLockShared(&ctxVmm->DeviceSched.LockSRW);
+    if(ctxVmm->DeviceSched.cExternal) {
+        tcStart = GetTickCount64();
+        while(ctxVmm->DeviceSched.cExternal && (GetTickCount64() - tcStart < VMM_DEVICE_BULK_MAXWAIT_MS)) {
+            SleepConditionVariableSRW(&ctxVmm->DeviceSched.CondIdle, &ctxVmm->DeviceSched.LockSRW, VMM_DEVICE_BULK_MAXWAIT_MS, CONDITION_VARIABLE_LOCKMODE_SHARED);
+        }
+    }
+    ReleaseSRWLockShared(&ctxVmm->DeviceSched.LockSRW);
+    return TRUE;
+}
+
+VOID VmmProc_Warmup_CallbackAction(_In_ PVMM_PROCESS pProcess, _In_ PVMMPROC_WARMUP_CONTEXT ctx)
+{
+    PVMMOB_MAP_VAD pObVadMap = NULL;
+    PVMMOB_MAP_MODULE pObModuleMap = NULL;
+    PVMMOB_MAP_HANDLE pObHandleMap = NULL;
+    PVMMOB_MAP_THREAD pObThreadMap = NULL;
+    if((ctx->dwMaps & VMM_WARMUP_MAP_VAD) && !pProcess->Map.pObVad) {
+        if(!VmmProc_Warmup_Continue(ctx)) { return; }
+        VmmMap_GetVad(pProcess, &pObVadMap, TRUE);
+        Ob_DECREF_NULL(&pObVadMap);
+    }
+    if((ctx->dwMaps & VMM_WARMUP_MAP_MODULE) && !pProcess->Map.pObModule) {
+        if(!VmmProc_Warmup_Continue(ctx)) { return; }
+        VmmMap_GetModule(pProcess, &pObModuleMap);
+        Ob_DECREF_NULL(&pObModuleMap);
+    }
+    if((ctx->dwMaps & VMM_WARMUP_MAP_HANDLE) && !pProcess->Map.pObHandle) {
+        if(!VmmProc_Warmup_Continue(ctx)) { return; }
+        VmmMap_GetHandle(pProcess, &pObHandleMap, TRUE);
+        Ob_DECREF_NULL(&pObHandleMap);
+    }
+    if((ctx->dwMaps & VMM_WARMUP_MAP_THREAD) && !pProcess->Map.pObThread) {
+        if(!VmmProc_Warmup_Continue(ctx)) { return; }
+        VmmMap_GetThread(pProcess, &pObThreadMap);
+        Ob_DECREF_NULL(&pObThreadMap);
+    }
+    InterlockedIncrement64(&ctxVmm->stat.cProcessWarmup);
+}
+
+/*
+* Warm up the thread maps of all active processes at once - the thread lists
+* of all processes are walked together instead of one process at a time. The
+* warm-up budget is checked between the phases of the batched initialization.
+* -- ctx
+*/
+VOID VmmProc_Warmup_Thread(_In_ PVMMPROC_WARMUP_CONTEXT ctx)
+{
+    if(!VmmProc_Warmup_Continue(ctx)) { return; }
+    VmmWinThread_InitializeAll(ctx, VmmProc_Warmup_Continue);
+}
+
+/*
+* Low priority warm-up stage run by the refresh thread after a process refresh.
+* Pre-build the configured map types (ctxVmm->ThreadProcCache.dwWarmupMaps) of
+* active processes so that the first access to them is fast. The warm-up stops
+* when the time budget or the device read budget is exhausted.
+* NB! must not be called with ctxVmm->LockMaster held.
+*/
+VOID VmmProc_Warmup()
+{
+    VMMPROC_WARMUP_CONTEXT ctx = { 0 };
+    if(!(ctx.dwMaps = ctxVmm->ThreadProcCache.dwWarmupMaps & VMM_WARMUP_MAP_ALL)) { return; }
+    if((ctxVmm->tpSystem != VMM_SYSTEM_WINDOWS_X64) && (ctxVmm->tpSystem != VMM_SYSTEM_WINDOWS_X86)) { return; }
+    if(!ctxVmm->fThreadMapEnabled) { ctx.dwMaps &= ~VMM_WARMUP_MAP_THREAD; }
+    ctx.tcDeadline = GetTickCount64() + ctxVmm->ThreadProcCache.cMs_WarmupBudget;
+    ctx.cPagesStart = ctxVmm->stat.cDeviceReadPages;
+    ctx.cPagesMax = ctxVmm->ThreadProcCache.cPages_WarmupBudget;
+    if(ctx.dwMaps & VMM_WARMUP_MAP_THREAD) {
+        VmmProc_Warmup_Thread(&ctx);
+    }
+    VmmProcessActionForeachParallel(&ctx, VmmProcessActionForeachParallel_CriteriaActiveOnly, VmmProc_Warmup_CallbackAction);
+}
+
 // Initial hard coded values that seems to be working nicely below. These values
 // may be changed in config options or by editing files in the .status directory.
 
@@ -91,6 +187,7 @@ DWORD VmmProcCacheUpdaterThread()
 {
     QWORD i = 0;
     BOOL fPHYS, fTLB, fProcPartial, fProcTotal, fRegistry;
+    BOOL fDeferPHYS = FALSE, fDeferTLB = FALSE, fDeferProcPartial = FALSE, fDeferProcTotal = FALSE, fDeferRegistry = FALSE;
     vmmprintfv("VmmProc: Start periodic cache flushing.\n");
     if(ctxMain->dev.fRemote) {
         ctxVmm->ThreadProcCache.cMs_TickPeriod = VMMPROC_UPDATERTHREAD_REMOTE_PERIOD;
@@ -107,6 +204,9 @@ DWORD VmmProcCacheUpdaterThread()
         ctxVmm->ThreadProcCache.cTick_ProcTotal = VMMPROC_UPDATERTHREAD_LOCAL_PROC_REFRESHTOTAL;
         ctxVmm->ThreadProcCache.cTick_Registry = VMMPROC_UPDATERTHREAD_LOCAL_REGISTRY;
     }
+    ctxVmm->ThreadProcCache.dwWarmupMaps = ctxMain->cfg.dwWarmupMaps;
+    ctxVmm->ThreadProcCache.cMs_WarmupBudget = VMM_WARMUP_BUDGET_MS_DEFAULT;
+    ctxVmm->ThreadProcCache.cPages_WarmupBudget = VMM_WARMUP_BUDGET_PAGES_DEFAULT;
     while(ctxVmm->Work.fEnabled && ctxVmm->ThreadProcCache.fEnabled) {
         Sleep(ctxVmm->ThreadProcCache.cMs_TickPeriod);
         i++;
@@ -115,8 +215,23 @@ DWORD VmmProcCacheUpdaterThread()
         fProcTotal = !(i % ctxVmm->ThreadProcCache.cTick_ProcTotal);
         fProcPartial = !(i % ctxVmm->ThreadProcCache.cTick_ProcPartial) && !fProcTotal;
         fRegistry = !(i % ctxVmm->ThreadProcCache.cTick_Registry);
-        EnterCriticalSection(&ctxVmm->LockMaster);
-        // PHYS / TLB cache clear
+        // defer destructive refreshes while analysis snapshots are active
+        if(VmmSnapshotIsRefreshDeferred()) {
+            fDeferPHYS = fDeferPHYS || fPHYS;
+            fDeferTLB = fDeferTLB || fTLB;
+            fDeferProcPartial = fDeferProcPartial || fProcPartial;
+            fDeferProcTotal = fDeferProcTotal || fProcTotal;
+            fDeferRegistry = fDeferRegistry || fRegistry;
+            continue;
+        }
+        fPHYS = fPHYS || fDeferPHYS;
+        fTLB = fTLB || fDeferTLB;
+        fProcTotal = fProcTotal || fDeferProcTotal;
+        fProcPartial = (fProcPartial || fDeferProcPartial) && !fProcTotal;
+        fRegistry = fRegistry || fDeferRegistry;
+        fDeferPHYS = fDeferTLB = fDeferProcPartial = fDeferProcTotal = fDeferRegistry = FALSE;
+        // PHYS / TLB cache clear (cache tables are internally locked - the
+        // master lock is not required and TLB revalidation may be slow).
         if(fPHYS) {
             VmmCacheClear(VMM_CACHE_TAG_PHYS);
             InterlockedIncrement64(&ctxVmm->stat.cPhysRefreshCache);
@@ -125,33 +240,45 @@ DWORD VmmProcCacheUpdaterThread()
             ObSet_Clear(ctxVmm->Cache.PAGING_FAILED);
         }
         if(fTLB) {
-            VmmCacheClear(VMM_CACHE_TAG_TLB);
+            if(ctxVmm->ThreadProcCache.fTlbRevalidate) {
+                VmmTlbRevalidate();
+            } else {
+                VmmCacheClear(VMM_CACHE_TAG_TLB);
+            }
             InterlockedIncrement64(&ctxVmm->stat.cTlbRefreshCache);
         }
-        // refresh proc list
+        // refresh proc list - the new process table is built and then swapped
+        // in; the master lock only serializes against other process table
+        // writers - readers continue on the previous table meanwhile.
         if(fProcPartial || fProcTotal) {
+            EnterCriticalSection(&ctxVmm->LockMaster);
             if(!VmmProc_RefreshProcesses(fProcTotal)) {
                 vmmprintf("VmmProc: Failed to refresh memory process file system - aborting.\n");
                 LeaveCriticalSection(&ctxVmm->LockMaster);
                 goto fail;
             }
-            // send notify
+            LeaveCriticalSection(&ctxVmm->LockMaster);
+            // invalidate derived maps and send notify (outside of master lock)
             if(fProcTotal) {
                 VmmWinNet_Refresh();
                 VmmWinObj_Refresh();
+                VmmWinHandle_Refresh();
                 PluginManager_Notify(VMMDLL_PLUGIN_EVENT_REFRESH_PROCESS_TOTAL, NULL, 0);
             }
             // refresh pfn subsystem
             MmPfn_Refresh();
         }
-        // refresh registry and user map
+        // refresh registry and user map (outside of master lock)
         if(fRegistry) {
             VmmWinReg_Refresh();
             VmmWinUser_Refresh();
             VmmWinPhysMemMap_Refresh();
             PluginManager_Notify(VMMDLL_PLUGIN_EVENT_REFRESH_REGISTRY, NULL, 0);
         }
-        LeaveCriticalSection(&ctxVmm->LockMaster);
+        // low priority map warm-up (outside of master lock)
+        if(fProcPartial || fProcTotal) {
+            VmmProc_Warmup();
+        }
     }
 fail:
     vmmprintfv("VmmProc: Exit periodic cache flushing.\n");
@@ -161,11 +288,19 @@ fail:
 BOOL VmmProcInitialize()
 {
     BOOL result = FALSE;
-    if(!VmmInitialize()) { return FALSE; }
+    DWORD iPhase;
+    iPhase = Statistics_StartupPhaseBegin("VmmInitialize");
+    result = VmmInitialize();
+    Statistics_StartupPhaseEnd(iPhase);
+    if(!result) { return FALSE; }
     // 1: try initialize 'windows' with an optionally supplied CR3
+    iPhase = Statistics_StartupPhaseBegin("VmmWinInit");
     result = VmmWinInit_TryInitialize(ctxMain->cfg.paCR3);
+    Statistics_StartupPhaseEnd(iPhase);
     if(!result) {
+        iPhase = Statistics_StartupPhaseBegin("User CR3");
         result = ctxMain->cfg.paCR3 && VmmProcUserCR3TryInitialize64();
+        Statistics_StartupPhaseEnd(iPhase);
         if(!result) {
             vmmprintf(
                 "VmmProc: Unable to auto-identify operating system for PROC file system mount.   \n" \
@@ -180,6 +315,10 @@ BOOL VmmProcInitialize()
         ctxVmm->ThreadProcCache.fEnabled = TRUE;
         VmmWork((LPTHREAD_START_ROUTINE)VmmProcCacheUpdaterThread, NULL, 0);
     }
+    // global memory budget enforcement (if configured).
+    if(result && ctxMain->cfg.cMBMemoryBudget) {
+        VmmMemBudget_Configure(ctxMain->cfg.cMBMemoryBudget);
+    }
     return result;
 }
 
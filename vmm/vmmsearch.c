@@ -0,0 +1,459 @@
+// vmmsearch.c : implementation of the parallel memory search functionality.
+//
+// The memory to search is split into ranges of at most VMMSEARCH_CHUNK_PAGES
+// pages taken from the process PTE map (virtual memory) or the physical memory
+// map. Ranges are picked up by worker threads which read each range in one
+// scatter read - including one trailing overlap page if the next range is
+// contiguous so that hits crossing a range boundary are found. Each read is
+// searched with an SSE2 scan for an anchor byte of each pattern followed by a
+// full masked compare. Hits are collected under a lock and reported to the
+// caller callback from the calling thread once the search completes - sorted
+// by process id, address and search entry so that results are reproducible
+// regardless of the order in which the worker threads finish.
+//
+// (c) MemProcFS contributors, 2020
+// Author: MemProcFS contributors
+//
+
+#include <intrin.h>
+#include <emmintrin.h>
+#include "vmmsearch.h"
+
+#define VMMSEARCH_CHUNK_PAGES           0x100       // 1MB per scatter read (excl. overlap page)
+#define VMMSEARCH_THREADS_MAX           8
+#define VMMSEARCH_RANGE_INITIAL         0x400
+#define VMMSEARCH_RESULT_INITIAL        0x400
+#define VMMSEARCH_RESULT_MAX            0x01000000  // hits collected when no cMaxResult is given
+#define VMMSEARCH_READ_FLAGS            (VMM_FLAG_NOCACHEPUT | VMM_FLAG_PRIORITY_BULK)
+
+typedef struct tdVMMSEARCH_RANGE {
+    QWORD va;
+    DWORD dwPID;
+    WORD cPages;
+    WORD fOverlap;              // next range is contiguous -> read one extra page
+} VMMSEARCH_RANGE, *PVMMSEARCH_RANGE;
+
+typedef struct tdVMMSEARCH_PATTERN {
+    BOOL fAnchor;               // pattern has a fully unmasked byte to scan for
+    DWORD iAnchor;
+    DWORD cbAlign;
+    BYTE bAnchor;
+} VMMSEARCH_PATTERN, *PVMMSEARCH_PATTERN;
+
+typedef struct tdVMMSEARCH_RESULT {
+    QWORD va;
+    DWORD dwPID;
+    DWORD iSearch;
+} VMMSEARCH_RESULT, *PVMMSEARCH_RESULT;
+
+typedef struct tdVMMSEARCH_CONTEXT {
+    PVMMDLL_MEM_SEARCH_CONTEXT ctxs;
+    SRWLOCK LockSRW;            // serializes result collection
+    BOOL volatile fAbort;
+    LONG volatile iRangeNext;
+    DWORD cRange;
+    DWORD cRangeMax;
+    PVMMSEARCH_RANGE pRange;
+    LONG64 volatile cbRead;
+    VMMSEARCH_PATTERN Pattern[VMMDLL_MEM_SEARCH_MAX];
+    DWORD cResult;
+    DWORD cResultMax;
+    PVMMSEARCH_RESULT pResult;
+} VMMSEARCH_CONTEXT, *PVMMSEARCH_CONTEXT;
+
+typedef struct tdVMMSEARCH_THREAD {
+    PVMMSEARCH_CONTEXT ctx;
+    HANDLE hEventFinish;
+} VMMSEARCH_THREAD, *PVMMSEARCH_THREAD;
+
+//-----------------------------------------------------------------------------
+// RANGE SETUP FUNCTIONALITY BELOW:
+//-----------------------------------------------------------------------------
+
+/*
+* Add a page aligned memory span to the search ranges. The span is clipped to
+* the search address limits and split into chunks. Spans contiguous with the
+* previously added span are merged into its last chunk.
+* -- ctx
+* -- dwPID
+* -- va
+* -- cb
+* -- return
+*/
+_Success_(return)
+BOOL VmmSearch_AddSpan(_In_ PVMMSEARCH_CONTEXT ctx, _In_ DWORD dwPID, _In_ QWORD va, _In_ QWORD cb)
+{
+    QWORD vaMin, vaMax, cPages;
+    DWORD cRangeMaxNew, cChunk;
+    PVMMSEARCH_RANGE pe, pRangeNew;
+    vaMin = ctx->ctxs->vaMin & ~0xfff;
+    vaMax = ctx->ctxs->vaMax ? ctx->ctxs->vaMax : (QWORD)-1;
+    if(!cb || (va > vaMax) || (va + cb - 1 < vaMin)) { return TRUE; }
+    if(va < vaMin) {
+        cb -= vaMin - va;
+        va = vaMin;
+    }
+    if(va + cb - 1 > vaMax) {
+        cb = ((vaMax - va) | 0xfff) + 1;
+    }
+    cPages = cb >> 12;
+    while(cPages) {
+        pe = ctx->cRange ? (ctx->pRange + ctx->cRange - 1) : NULL;
+        if(pe && (pe->dwPID == dwPID) && (pe->va + ((QWORD)pe->cPages << 12) == va)) {
+            if(pe->cPages < VMMSEARCH_CHUNK_PAGES) {
+                cChunk = (DWORD)min(cPages, VMMSEARCH_CHUNK_PAGES - pe->cPages);
+                pe->cPages += (WORD)cChunk;
+                va += (QWORD)cChunk << 12;
+                cPages -= cChunk;
+                continue;
+            }
+            pe->fOverlap = TRUE;
+        }
+        if(ctx->cRange == ctx->cRangeMax) {
+            cRangeMaxNew = ctx->cRangeMax ? (ctx->cRangeMax * 2) : VMMSEARCH_RANGE_INITIAL;
+            pRangeNew = ctx->pRange ? LocalReAlloc(ctx->pRange, cRangeMaxNew * sizeof(VMMSEARCH_RANGE), LMEM_MOVEABLE) : LocalAlloc(0, cRangeMaxNew * sizeof(VMMSEARCH_RANGE));
+            if(!pRangeNew) { return FALSE; }
+            ctx->pRange = pRangeNew;
+            ctx->cRangeMax = cRangeMaxNew;
+        }
+        cChunk = (DWORD)min(cPages, VMMSEARCH_CHUNK_PAGES);
+        pe = ctx->pRange + ctx->cRange++;
+        pe->va = va;
+        pe->dwPID = dwPID;
+        pe->cPages = (WORD)cChunk;
+        pe->fOverlap = FALSE;
+        va += (QWORD)cChunk << 12;
+        cPages -= cChunk;
+    }
+    return TRUE;
+}
+
+/*
+* Add the ranges of a process PTE map matching the protection filters.
+* -- ctx
+* -- pProcess
+* -- return
+*/
+_Success_(return)
+BOOL VmmSearch_AddProcess(_In_ PVMMSEARCH_CONTEXT ctx, _In_ PVMM_PROCESS pProcess)
+{
+    BOOL fResult = TRUE;
+    DWORD i;
+    PVMM_MAP_PTEENTRY pe;
+    PVMMOB_MAP_PTE pObPteMap = NULL;
+    if(!VmmMap_GetPte(pProcess, &pObPteMap, FALSE)) { return TRUE; }
+    for(i = 0; fResult && (i < pObPteMap->cMap); i++) {
+        pe = pObPteMap->pMap + i;
+        if(ctx->ctxs->fForceW && !(pe->fPage & VMM_MEMMAP_PAGE_W)) { continue; }
+        if(ctx->ctxs->fForceX && (pe->fPage & VMM_MEMMAP_PAGE_NX)) { continue; }
+        fResult = VmmSearch_AddSpan(ctx, pProcess->dwPID, pe->vaBase, pe->cPages << 12);
+    }
+    Ob_DECREF(pObPteMap);
+    return fResult;
+}
+
+/*
+* Add the ranges of the physical memory map.
+* -- ctx
+* -- return
+*/
+_Success_(return)
+BOOL VmmSearch_AddPhysical(_In_ PVMMSEARCH_CONTEXT ctx)
+{
+    BOOL fResult = TRUE;
+    DWORD i;
+    PVMMOB_MAP_PHYSMEM pObPhysMemMap = NULL;
+    if(!VmmMap_GetPhysMem(&pObPhysMemMap) || !pObPhysMemMap->cMap) {
+        Ob_DECREF(pObPhysMemMap);
+        return VmmSearch_AddSpan(ctx, (DWORD)-1, 0, ctxMain->dev.paMax & ~0xfff);
+    }
+    for(i = 0; fResult && (i < pObPhysMemMap->cMap); i++) {
+        fResult = VmmSearch_AddSpan(ctx, (DWORD)-1, pObPhysMemMap->pMap[i].pa, pObPhysMemMap->pMap[i].cb & ~0xfff);
+    }
+    Ob_DECREF(pObPhysMemMap);
+    return fResult;
+}
+
+//-----------------------------------------------------------------------------
+// MATCH FUNCTIONALITY BELOW:
+//-----------------------------------------------------------------------------
+
+/*
+* Collect a hit. Calls are serialized and stop once aborted or once the max
+* number of results is reached. The search ranges are page aligned - hits
+* outside the exact limits are dropped.
+*/
+VOID VmmSearch_Result(_In_ PVMMSEARCH_CONTEXT ctx, _In_ DWORD dwPID, _In_ QWORD va, _In_ DWORD iSearch)
+{
+    DWORD cResultMaxNew;
+    PVMMSEARCH_RESULT pe, pResultNew;
+    PVMMDLL_MEM_SEARCH_CONTEXT ctxs = ctx->ctxs;
+    if((va < ctxs->vaMin) || (ctxs->vaMax && (va > ctxs->vaMax))) { return; }
+    AcquireSRWLockExclusive(&ctx->LockSRW);
+    if(!ctx->fAbort && !ctxs->fAbortRequested) {
+        if(ctx->cResult == ctx->cResultMax) {
+            cResultMaxNew = ctx->cResultMax ? (ctx->cResultMax * 2) : VMMSEARCH_RESULT_INITIAL;
+            pResultNew = ctx->pResult ? LocalReAlloc(ctx->pResult, cResultMaxNew * sizeof(VMMSEARCH_RESULT), LMEM_MOVEABLE) : LocalAlloc(0, cResultMaxNew * sizeof(VMMSEARCH_RESULT));
+            if(!pResultNew) {
+                ctx->fAbort = TRUE;
+                goto finish;
+            }
+            ctx->pResult = pResultNew;
+            ctx->cResultMax = cResultMaxNew;
+        }
+        pe = ctx->pResult + ctx->cResult++;
+        pe->va = va;
+        pe->dwPID = dwPID;
+        pe->iSearch = iSearch;
+        if(ctx->cResult >= (ctxs->cMaxResult ? min(ctxs->cMaxResult, VMMSEARCH_RESULT_MAX) : VMMSEARCH_RESULT_MAX)) {
+            ctx->fAbort = TRUE;
+        }
+    }
+finish:
+    ReleaseSRWLockExclusive(&ctx->LockSRW);
+}
+
+/*
+* qsort comparator - order hits by process id, address and search entry.
+*/
+int VmmSearch_ResultCmp(const void *v1, const void *v2)
+{
+    PVMMSEARCH_RESULT p1 = (PVMMSEARCH_RESULT)v1;
+    PVMMSEARCH_RESULT p2 = (PVMMSEARCH_RESULT)v2;
+    if(p1->dwPID != p2->dwPID) { return (p1->dwPID < p2->dwPID) ? -1 : 1; }
+    if(p1->va != p2->va) { return (p1->va < p2->va) ? -1 : 1; }
+    return (p1->iSearch < p2->iSearch) ? -1 : ((p1->iSearch > p2->iSearch) ? 1 : 0);
+}
+
+/*
+* Sort the collected hits and report them to the caller callback in order.
+* Reporting stops once the callback returns FALSE.
+*/
+VOID VmmSearch_ResultReport(_In_ PVMMSEARCH_CONTEXT ctx)
+{
+    DWORD i;
+    PVMMSEARCH_RESULT pe;
+    PVMMDLL_MEM_SEARCH_CONTEXT ctxs = ctx->ctxs;
+    if(!ctx->cResult) { return; }
+    qsort(ctx->pResult, ctx->cResult, sizeof(VMMSEARCH_RESULT), VmmSearch_ResultCmp);
+    for(i = 0; i < ctx->cResult; i++) {
+        pe = ctx->pResult + i;
+        ctxs->cResult++;
+        if(ctxs->pfnResultOptCB && !ctxs->pfnResultOptCB(ctxs, pe->dwPID, pe->va, pe->iSearch)) { break; }
+    }
+}
+
+inline BOOL VmmSearch_MatchAt(_In_ PVMMDLL_MEM_SEARCH_CONTEXT_SEARCHENTRY ps, _In_ PBYTE pb)
+{
+    DWORD i;
+    for(i = 0; i < ps->cb; i++) {
+        if((pb[i] ^ ps->pb[i]) & ~ps->pbSkipMask[i]) { return FALSE; }
+    }
+    return TRUE;
+}
+
+/*
+* Search a contiguous run of successfully read memory for all patterns. Only
+* hits starting before cbReport are reported - the remainder is overlap which
+* is reported by the next range.
+* -- ctx
+* -- dwPID
+* -- va = address of pb.
+* -- pb
+* -- cb
+* -- cbReport
+*/
+VOID VmmSearch_SearchRun(_In_ PVMMSEARCH_CONTEXT ctx, _In_ DWORD dwPID, _In_ QWORD va, _In_reads_(cb) PBYTE pb, _In_ DWORD cb, _In_ DWORD cbReport)
+{
+    DWORD iS, o, oA, cbEnd, dwMask;
+    __m128i v128Anchor;
+    PVMMSEARCH_PATTERN pp;
+    PVMMDLL_MEM_SEARCH_CONTEXT_SEARCHENTRY ps;
+    for(iS = 0; (iS < ctx->ctxs->cSearch) && !ctx->fAbort; iS++) {
+        ps = ctx->ctxs->search + iS;
+        pp = ctx->Pattern + iS;
+        if(cb < ps->cb) { continue; }
+        cbEnd = min(cbReport, cb - ps->cb + 1);     // hit start offsets: [0, cbEnd)
+        if(!pp->fAnchor) {
+            for(o = 0; o < cbEnd; o += pp->cbAlign) {
+                if(VmmSearch_MatchAt(ps, pb + o)) {
+                    VmmSearch_Result(ctx, dwPID, va + o, iS);
+                }
+            }
+            continue;
+        }
+        v128Anchor = _mm_set1_epi8((CHAR)pp->bAnchor);
+        for(oA = pp->iAnchor; oA < cbEnd + pp->iAnchor; oA += 16) {
+            if(oA + 16 <= cb) {
+                dwMask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)(pb + oA)), v128Anchor));
+            } else {
+                for(dwMask = 0, o = oA; o < cb; o++) {
+                    if(pb[o] == pp->bAnchor) { dwMask |= 1 << (o - oA); }
+                }
+            }
+            while(dwMask) {
+                _BitScanForward(&o, dwMask);
+                dwMask &= dwMask - 1;
+                o += oA - pp->iAnchor;
+                if((o < cbEnd) && !(o & (pp->cbAlign - 1)) && VmmSearch_MatchAt(ps, pb + o)) {
+                    VmmSearch_Result(ctx, dwPID, va + o, iS);
+                }
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// WORKER FUNCTIONALITY BELOW:
+//-----------------------------------------------------------------------------
+
+VOID VmmSearch_ThreadProc(_In_ PVMMSEARCH_THREAD pThread)
+{
+    PVMMSEARCH_CONTEXT ctx = pThread->ctx;
+    DWORD i, j, iRange, cMEMs, dwPID = (DWORD)-1;
+    QWORD flags = ctx->ctxs->ReadFlags | VMMSEARCH_READ_FLAGS;
+    PBYTE pb = NULL;
+    PPMEM_SCATTER ppMEMs = NULL;
+    PVMMSEARCH_RANGE pe;
+    PVMM_PROCESS pObProcess = NULL;
+    if(!(pb = LocalAlloc(0, (VMMSEARCH_CHUNK_PAGES + 1) << 12))) { goto fail; }
+    if(!LcAllocScatter2((VMMSEARCH_CHUNK_PAGES + 1) << 12, pb, VMMSEARCH_CHUNK_PAGES + 1, &ppMEMs)) { goto fail; }
+    while(!ctx->fAbort && !ctx->ctxs->fAbortRequested && ctxVmm->Work.fEnabled) {
+        if((iRange = InterlockedIncrement(&ctx->iRangeNext) - 1) >= ctx->cRange) { break; }
+        pe = ctx->pRange + iRange;
+        if(pe->dwPID != dwPID) {
+            Ob_DECREF_NULL(&pObProcess);
+            dwPID = pe->dwPID;
+            if(dwPID != (DWORD)-1) { pObProcess = VmmProcessGet(dwPID); }
+        }
+        if((dwPID != (DWORD)-1) && !pObProcess) { continue; }
+        cMEMs = pe->cPages + (pe->fOverlap ? 1 : 0);
+        for(i = 0; i < cMEMs; i++) {
+            ppMEMs[i]->qwA = pe->va + ((QWORD)i << 12);
+            ppMEMs[i]->f = FALSE;
+        }
+        if(pObProcess) {
+            VmmReadScatterVirtual(pObProcess, ppMEMs, cMEMs, flags);
+        } else {
+            VmmReadScatterPhysical(ppMEMs, cMEMs, flags);
+        }
+        // search each run of consecutive successfully read pages.
+        for(i = 0; i < pe->cPages; i = j) {
+            if(!ppMEMs[i]->f) { j = i + 1; continue; }
+            for(j = i + 1; (j < cMEMs) && ppMEMs[j]->f; j++);
+            InterlockedAdd64(&ctx->cbRead, (QWORD)(min(j, pe->cPages) - i) << 12);
+            VmmSearch_SearchRun(ctx, dwPID, pe->va + ((QWORD)i << 12), pb + ((QWORD)i << 12), (j - i) << 12, (min(j, pe->cPages) - i) << 12);
+        }
+    }
+fail:
+    Ob_DECREF(pObProcess);
+    LcMemFree(ppMEMs);
+    LocalFree(pb);
+}
+
+//-----------------------------------------------------------------------------
+// SEARCH FUNCTIONALITY BELOW:
+//-----------------------------------------------------------------------------
+
+/*
+* Verify the caller search context and compile the patterns. The anchor byte
+* is the first fully unmasked byte - preferring bytes other than 0x00 and 0xff
+* which are very common in memory.
+* -- ctx
+* -- return
+*/
+_Success_(return)
+BOOL VmmSearch_Initialize(_In_ PVMMSEARCH_CONTEXT ctx)
+{
+    DWORD iS, i;
+    PVMMSEARCH_PATTERN pp;
+    PVMMDLL_MEM_SEARCH_CONTEXT_SEARCHENTRY ps;
+    PVMMDLL_MEM_SEARCH_CONTEXT ctxs = ctx->ctxs;
+    if((ctxs->dwVersion != VMMDLL_MEM_SEARCH_VERSION) || !ctxs->cSearch || (ctxs->cSearch > VMMDLL_MEM_SEARCH_MAX)) { return FALSE; }
+    if(ctxs->vaMax && (ctxs->vaMax < ctxs->vaMin)) { return FALSE; }
+    for(iS = 0; iS < ctxs->cSearch; iS++) {
+        ps = ctxs->search + iS;
+        pp = ctx->Pattern + iS;
+        if(!ps->cb || (ps->cb > VMMDLL_MEM_SEARCH_MAXLENGTH)) { return FALSE; }
+        if((ps->cbAlign > 0x1000) || (ps->cbAlign & (ps->cbAlign - 1))) { return FALSE; }
+        pp->cbAlign = max(1, ps->cbAlign);
+        for(i = 0; i < ps->cb; i++) {
+            if(ps->pbSkipMask[i]) { continue; }
+            if(!pp->fAnchor || (((pp->bAnchor == 0x00) || (pp->bAnchor == 0xff)) && (ps->pb[i] != 0x00) && (ps->pb[i] != 0xff))) {
+                pp->fAnchor = TRUE;
+                pp->iAnchor = i;
+                pp->bAnchor = ps->pb[i];
+            }
+        }
+    }
+    return TRUE;
+}
+
+/*
+* Search memory for the patterns in the search context - hits are sorted and
+* reported to the callback once all memory has been searched.
+* NB! must not be called from a VmmWork thread.
+* -- dwPID = process to search, VMMDLL_MEM_SEARCH_PID_ALL or (DWORD)-1 = physical.
+* -- ctxs
+* -- return
+*/
+_Success_(return)
+BOOL VmmSearch(_In_ DWORD dwPID, _Inout_ PVMMDLL_MEM_SEARCH_CONTEXT ctxs)
+{
+    BOOL fResult = FALSE;
+    DWORD i, cThread;
+    PVMM_PROCESS pObProcess = NULL;
+    VMMSEARCH_THREAD Threads[VMMSEARCH_THREADS_MAX] = { 0 };
+    PVMMSEARCH_CONTEXT ctx = NULL;
+    ctxs->cResult = 0;
+    ctxs->cbReadTotal = 0;
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMSEARCH_CONTEXT)))) { return FALSE; }
+    ctx->ctxs = ctxs;
+    InitializeSRWLock(&ctx->LockSRW);
+    if(!VmmSearch_Initialize(ctx)) { goto fail; }
+    // 1: collect ranges to search
+    if(dwPID == (DWORD)-1) {
+        if(!VmmSearch_AddPhysical(ctx)) { goto fail; }
+    } else if(dwPID == VMMDLL_MEM_SEARCH_PID_ALL) {
+        while((pObProcess = VmmProcessGetNext(pObProcess, 0))) {
+            if(!VmmSearch_AddProcess(ctx, pObProcess)) { goto fail; }
+        }
+    } else {
+        if(!(pObProcess = VmmProcessGet(dwPID))) { goto fail; }
+        if(!VmmSearch_AddProcess(ctx, pObProcess)) { goto fail; }
+    }
+    // 2: dispatch ranges onto worker threads - the last thread is the caller.
+    //    NB! this waits for VmmWork workers - never call from a VmmWork thread.
+    cThread = min(VMMSEARCH_THREADS_MAX, ctx->cRange);
+    for(i = 0; i < cThread; i++) {
+        Threads[i].ctx = ctx;
+    }
+    for(i = 0; i + 1 < cThread; i++) {
+        Threads[i].hEventFinish = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if(!Threads[i].hEventFinish || !VmmWorkEx((LPTHREAD_START_ROUTINE)VmmSearch_ThreadProc, Threads + i, Threads[i].hEventFinish, VMMWORK_PRIORITY_NORMAL)) {
+            if(Threads[i].hEventFinish) {
+                CloseHandle(Threads[i].hEventFinish);
+                Threads[i].hEventFinish = NULL;
+            }
+        }
+    }
+    if(cThread) {
+        VmmSearch_ThreadProc(Threads + cThread - 1);
+    }
+    for(i = 0; i + 1 < cThread; i++) {
+        if(Threads[i].hEventFinish) {
+            WaitForSingleObject(Threads[i].hEventFinish, INFINITE);
+            CloseHandle(Threads[i].hEventFinish);
+        }
+    }
+    ctxs->cbReadTotal = ctx->cbRead;
+    // 3: report the hits in sorted order.
+    VmmSearch_ResultReport(ctx);
+    fResult = TRUE;
+fail:
+    Ob_DECREF(pObProcess);
+    LocalFree(ctx->pResult);
+    LocalFree(ctx->pRange);
+    LocalFree(ctx);
+    return fResult;
+}
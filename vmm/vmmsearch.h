@@ -0,0 +1,28 @@
+// vmmsearch.h : declarations of the parallel memory search functionality.
+//
+// (c) MemProcFS contributors, 2020
+// Author: MemProcFS contributors
+//
+
+#ifndef __VMMSEARCH_H__
+#define __VMMSEARCH_H__
+#include "vmm.h"
+#include "vmmdll.h"
+
+/*
+* Search process virtual memory, all processes or physical memory for the byte
+* patterns in the search context. The memory is read in large scatter reads
+* which are searched in parallel on the worker threads. Hits are reported to
+* the callback once the search completes - sorted by pid, address and search
+* entry index.
+* NB! must not be called from a VmmWork thread - the search is dispatched onto
+*     VmmWork threads and waited for which may otherwise deadlock.
+* -- dwPID = PID of process, (DWORD)-1 for physical memory or
+*            VMMDLL_MEM_SEARCH_PID_ALL for all processes.
+* -- ctxs = search context.
+* -- return = TRUE on completed or aborted search, FALSE on invalid context.
+*/
+_Success_(return)
+BOOL VmmSearch(_In_ DWORD dwPID, _Inout_ PVMMDLL_MEM_SEARCH_CONTEXT ctxs);
+
+#endif /* __VMMSEARCH_H__ */
@@ -8,6 +8,7 @@
 #include "vmmwin.h"
 #include "vmmwindef.h"
 #include "vmmwinreg.h"
+#include "vmmwinprofile.h"
 #include "vmmproc.h"
 #include "util.h"
 #include "pdb.h"
@@ -42,8 +43,42 @@ PIMAGE_NT_HEADERS VmmWin_GetVerifyHeaderPE(_In_ PVMM_PROCESS pProcess, _In_opt_
 // ----------------------------------------------------------------------------
 // WINDOWS SPECIFIC PROCESS RELATED FUNCTIONALITY BELOW:
 //    IMPORT/EXPORT DIRECTORY PARSING
+// The export address table and the display buffer sizes are identical for all
+// mappings of an image and are shared between processes in the PE module cache
+// (keyed by image identity). The import address table is process specific.
 // ----------------------------------------------------------------------------
 
+typedef struct tdVMMWIN_OB_MODULECACHE_EAT {
+    OB ObHdr;
+    DWORD cEAT;
+    struct {
+        DWORD vaFunctionOffset;
+        CHAR szFunction[40];
+    } e[];
+} VMMWIN_OB_MODULECACHE_EAT, *PVMMWIN_OB_MODULECACHE_EAT;
+
+typedef struct tdVMMWIN_OB_MODULECACHE_SIZE {
+    OB ObHdr;
+    DWORD cbFileSizeRaw;
+    DWORD cbDisplayBufferSections;
+    DWORD cbDisplayBufferEAT;
+    DWORD cbDisplayBufferIAT;
+} VMMWIN_OB_MODULECACHE_SIZE, *PVMMWIN_OB_MODULECACHE_SIZE;
+
+/*
+* Copy a cached export address table into the caller supplied buffer.
+*/
+VOID VmmWin_PE_LoadEAT_DisplayBuffer_FromCache(_In_ PVMMWIN_OB_MODULECACHE_EAT pObEat, _In_ PVMM_MAP_MODULEENTRY pModule, _Out_writes_opt_(cEATs) PVMMPROC_WINDOWS_EAT_ENTRY pEATs, _In_ DWORD cEATs, _Out_ PDWORD pcEATs)
+{
+    DWORD i;
+    for(i = 0; (i < pObEat->cEAT) && (i < cEATs); i++) {
+        pEATs[i].vaFunctionOffset = pObEat->e[i].vaFunctionOffset;
+        pEATs[i].vaFunction = pModule->vaBase + pObEat->e[i].vaFunctionOffset;
+        memcpy(pEATs[i].szFunction, pObEat->e[i].szFunction, 40);
+    }
+    *pcEATs = i;
+}
+
 _Success_(return)
 BOOL VmmWin_PE_LoadEAT_DisplayBuffer(_In_ PVMM_PROCESS pProcess, _In_ PVMM_MAP_MODULEENTRY pModule, _Out_writes_opt_(cEATs) PVMMPROC_WINDOWS_EAT_ENTRY pEATs, _In_ DWORD cEATs, _Out_ PDWORD pcEATs)
 {
@@ -56,10 +91,19 @@ BOOL VmmWin_PE_LoadEAT_DisplayBuffer(_In_ PVMM_PROCESS pProcess, _In_ PVMM_MAP_M
     QWORD i, oNameOrdinal, ooName, oName, oFunction, wOrdinalFnIdx;
     DWORD vaFunctionOffset;
     BOOL fHdr32;
+    PE_MODULECACHE_KEY ModuleCacheKey;
+    PVMMWIN_OB_MODULECACHE_EAT pObEat = NULL;
     *pcEATs = 0;
     // load both 32/64 bit ntHeader (only one will be valid)
     if(!(ntHeader64 = VmmWin_GetVerifyHeaderPE(pProcess, pModule->vaBase, pbModuleHeader, &fHdr32))) { goto fail; }
     ntHeader32 = (PIMAGE_NT_HEADERS32)ntHeader64;
+    // check module cache
+    PE_ModuleCacheKey(pbModuleHeader, &ModuleCacheKey);
+    if((pObEat = PE_ModuleCacheGet(PE_MODULECACHE_TP_EAT, &ModuleCacheKey))) {
+        VmmWin_PE_LoadEAT_DisplayBuffer_FromCache(pObEat, pModule, pEATs, cEATs, pcEATs);
+        Ob_DECREF(pObEat);
+        return TRUE;
+    }
     // Load Export Address Table (EAT)
     oExportDirectory = fHdr32 ?
         ntHeader32->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress :
@@ -70,9 +114,11 @@ BOOL VmmWin_PE_LoadEAT_DisplayBuffer(_In_ PVMM_PROCESS pProcess, _In_ PVMM_MAP_M
     if(!oExportDirectory || !cbExportDirectory || cbExportDirectory > 0x01000000) { goto fail; }
     if(!(pbExportDirectory = LocalAlloc(0, cbExportDirectory))) { goto fail; }
     if(!VmmRead(pProcess, pModule->vaBase + oExportDirectory, pbExportDirectory, (DWORD)cbExportDirectory)) { goto fail; }
-    // Walk exported functions
+    // Walk exported functions into the module cache object (all names)
     pExportDirectory = (PIMAGE_EXPORT_DIRECTORY)pbExportDirectory;
-    for(i = 0; i < pExportDirectory->NumberOfNames && i < cEATs; i++) {
+    if(pExportDirectory->NumberOfNames > (cbExportDirectory >> 2)) { goto fail; }
+    if(!(pObEat = Ob_Alloc(OB_TAG_PE_MODULECACHE, LMEM_ZEROINIT, sizeof(VMMWIN_OB_MODULECACHE_EAT) + pExportDirectory->NumberOfNames * sizeof(pObEat->e[0]), NULL, NULL))) { goto fail; }
+    for(i = 0; i < pExportDirectory->NumberOfNames; i++) {
         //
         oNameOrdinal = pExportDirectory->AddressOfNameOrdinals + (i << 1);
         if((oNameOrdinal - sizeof(WORD) - oExportDirectory) > cbExportDirectory) { continue; }
@@ -86,12 +132,14 @@ BOOL VmmWin_PE_LoadEAT_DisplayBuffer(_In_ PVMM_PROCESS pProcess, _In_ PVMM_MAP_M
         oFunction = pExportDirectory->AddressOfFunctions + (wOrdinalFnIdx << 2);
         if((oFunction - sizeof(DWORD) - oExportDirectory) > cbExportDirectory) { continue; }
         vaFunctionOffset = *(PDWORD)(pbExportDirectory - oExportDirectory + oFunction);
-        // store into caller supplied info struct
-        pEATs[i].vaFunctionOffset = vaFunctionOffset;
-        pEATs[i].vaFunction = pModule->vaBase + vaFunctionOffset;
-        strncpy_s(pEATs[i].szFunction, 40, (LPSTR)(pbExportDirectory - oExportDirectory + oName), _TRUNCATE);
-    }
-    *pcEATs = (DWORD)i;
+        // store into module cache object
+        pObEat->e[i].vaFunctionOffset = vaFunctionOffset;
+        strncpy_s(pObEat->e[i].szFunction, 40, (LPSTR)(pbExportDirectory - oExportDirectory + oName), _TRUNCATE);
+    }
+    pObEat->cEAT = (DWORD)i;
+    PE_ModuleCachePut(PE_MODULECACHE_TP_EAT, &ModuleCacheKey, pObEat);
+    VmmWin_PE_LoadEAT_DisplayBuffer_FromCache(pObEat, pModule, pEATs, cEATs, pcEATs);
+    Ob_DECREF(pObEat);
     LocalFree(pbExportDirectory);
     return TRUE;
 fail:
@@ -183,6 +231,8 @@ VOID VmmWin_PE_SetSizeSectionIATEAT_DisplayBuffer(_In_ PVMM_PROCESS pProcess, _I
     BYTE pbModuleHeader[0x1000] = { 0 };
     PIMAGE_NT_HEADERS64 pNtHeaders64;
     BOOL fHdr32;
+    PE_MODULECACHE_KEY ModuleCacheKey;
+    PVMMWIN_OB_MODULECACHE_SIZE pObSize = NULL;
     // check if function is required
     if(pModule->fLoadedEAT && pModule->fLoadedIAT) { return; }
     EnterCriticalSection(&pProcess->LockUpdate);
@@ -196,16 +246,27 @@ VOID VmmWin_PE_SetSizeSectionIATEAT_DisplayBuffer(_In_ PVMM_PROCESS pProcess, _I
         return;
     }
     // calculate display buffer size of: SECTIONS, EAT, IAT, RawFileSize
-    pModule->cbFileSizeRaw = PE_FileRaw_Size(pProcess, pModule->vaBase, pbModuleHeader);
-    pModule->cbDisplayBufferSections = PE_SectionGetNumberOfEx(pProcess, pModule->vaBase, pbModuleHeader) * 70;    // each display buffer human readable line == 70 bytes.
+    // (zero cached sizes may be due to paged out memory and are re-calculated)
+    PE_ModuleCacheKey(pbModuleHeader, &ModuleCacheKey);
+    pObSize = PE_ModuleCacheGet(PE_MODULECACHE_TP_SIZE, &ModuleCacheKey);
+    pModule->cbFileSizeRaw = (pObSize && pObSize->cbFileSizeRaw) ? pObSize->cbFileSizeRaw : PE_FileRaw_Size(pProcess, pModule->vaBase, pbModuleHeader);
+    pModule->cbDisplayBufferSections = (pObSize && pObSize->cbDisplayBufferSections) ? pObSize->cbDisplayBufferSections : PE_SectionGetNumberOfEx(pProcess, pModule->vaBase, pbModuleHeader) * 70;    // each display buffer human readable line == 70 bytes.
     if(!pModule->fLoadedEAT) {
-        pModule->cbDisplayBufferEAT = PE_EatGetNumberOfEx(pProcess, pModule->vaBase, pbModuleHeader) * 64;         // each display buffer human readable line == 64 bytes.
+        pModule->cbDisplayBufferEAT = (pObSize && pObSize->cbDisplayBufferEAT) ? pObSize->cbDisplayBufferEAT : PE_EatGetNumberOfEx(pProcess, pModule->vaBase, pbModuleHeader) * 64;         // each display buffer human readable line == 64 bytes.
         pModule->fLoadedEAT = TRUE;
     }
     if(!pModule->fLoadedIAT) {
-        pModule->cbDisplayBufferIAT = PE_IatGetNumberOfEx(pProcess, pModule->vaBase, pbModuleHeader) * 128;        // each display buffer human readable line == 128 bytes.
+        pModule->cbDisplayBufferIAT = (pObSize && pObSize->cbDisplayBufferIAT) ? pObSize->cbDisplayBufferIAT : PE_IatGetNumberOfEx(pProcess, pModule->vaBase, pbModuleHeader) * 128;        // each display buffer human readable line == 128 bytes.
         pModule->fLoadedIAT = TRUE;
     }
+    if(!pObSize && (pObSize = Ob_Alloc(OB_TAG_PE_MODULECACHE, 0, sizeof(VMMWIN_OB_MODULECACHE_SIZE), NULL, NULL))) {
+        pObSize->cbFileSizeRaw = pModule->cbFileSizeRaw;
+        pObSize->cbDisplayBufferSections = pModule->cbDisplayBufferSections;
+        pObSize->cbDisplayBufferEAT = pModule->cbDisplayBufferEAT;
+        pObSize->cbDisplayBufferIAT = pModule->cbDisplayBufferIAT;
+        PE_ModuleCachePut(PE_MODULECACHE_TP_SIZE, &ModuleCacheKey, pObSize);
+    }
+    Ob_DECREF(pObSize);
     LeaveCriticalSection(&pProcess->LockUpdate);
 }
 
@@ -1176,6 +1237,7 @@ typedef struct tdVMMWIN_INITIALIZETHREAD_CONTEXT {
     POB_SET psObTeb;
     POB_SET psObTrapFrame;
     PVMM_PROCESS pProcess;
+    BOOL fTebPrefetchVirtual;       // TEBs not translatable up front - prefetch by virtual address
 } VMMWIN_INITIALIZETHREAD_CONTEXT, *PVMMWIN_INITIALIZETHREAD_CONTEXT;
 
 int VmmWinThread_Initialize_CmpThreadEntry(PVMM_MAP_THREADENTRY v1, PVMM_MAP_THREADENTRY v2)
@@ -1226,58 +1288,39 @@ VOID VmmWinThread_Initialize_DoWork_Pre(_In_ PVMM_PROCESS pSystemProcess, _In_op
     ObMap_Push(ctx->pmThread, e->dwTID, e);  // map will free allocation when cleared
 }
 
-VOID VmmWinThread_Initialize_DoWork(_In_ PVMM_PROCESS pProcess)
+/*
+* Finish the thread map of a process after its thread list has been walked.
+* The TEBs are fetched and the trap frames (expected to be prefetched already)
+* are read before the map is committed to the process object.
+* -- pSystemProcess
+* -- ctx
+* -- cbTrapFrame
+*/
+VOID VmmWinThread_Initialize_DoWork_Finish(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMMWIN_INITIALIZETHREAD_CONTEXT ctx, _In_ DWORD cbTrapFrame)
 {
     BOOL f, f32 = ctxVmm->f32;
     BYTE pb[0x200];
-    DWORD i, cMap, cbTrapFrame = 0;
-    QWORD va, vaThreadListEntry;
-    POB_SET psObTeb = NULL, psObTrapFrame = NULL;
-    POB_MAP pmObThreads = NULL;
+    DWORD i, cMap;
     PVMMOB_MAP_THREAD pObThreadMap = NULL;
     PVMM_MAP_THREADENTRY pThreadEntry;
-    PVMM_PROCESS pObSystemProcess = NULL;
-    VMMWIN_INITIALIZETHREAD_CONTEXT ctx = { 0 };
+    PVMM_PROCESS pProcess = ctx->pProcess;
     PVMM_OFFSET_ETHREAD ot = &ctxVmm->offset.ETHREAD;
-    // 1: set up and perform list traversal call.
-    vaThreadListEntry = VMM_PTR_OFFSET(f32, pProcess->win.EPROCESS.pb, ctxVmm->offset.ETHREAD.oThreadListHeadKP);
-    if(f32 ? !VMM_KADDR32_4(vaThreadListEntry) : !VMM_KADDR64_8(vaThreadListEntry)) { goto fail; }
-    if(!(pObSystemProcess = VmmProcessGet(4))) { goto fail; }
-    if(!(psObTeb = ObSet_New())) { goto fail; }
-    if(!(psObTrapFrame = ObSet_New())) { goto fail; }
-    if(!(pmObThreads = ObMap_New(OB_MAP_FLAGS_OBJECT_LOCALFREE))) { goto fail; }
-    ctx.pmThread = pmObThreads;
-    ctx.psObTeb = psObTeb;
-    ctx.psObTrapFrame = psObTrapFrame;
-    ctx.pProcess = pProcess;
-    va = vaThreadListEntry - ctxVmm->offset.ETHREAD.oThreadListEntry;
-    VmmWin_ListTraversePrefetch(
-        pObSystemProcess,
-        f32,
-        &ctx,
-        1,
-        &va,
-        ctxVmm->offset.ETHREAD.oThreadListEntry,
-        ctxVmm->offset.ETHREAD.oMax,
-        VmmWinThread_Initialize_DoWork_Pre,
-        NULL,
-        pProcess->pObPersistent->pObCMapThreadPrefetch);
-    // 2: transfer result from generic map into PVMMOB_MAP_THREAD
-    if(!(cMap = ObMap_Size(pmObThreads))) { goto fail; }
-    if(!(pObThreadMap = Ob_Alloc(OB_TAG_MAP_THREAD, 0, sizeof(VMMOB_MAP_THREAD) + cMap * sizeof(VMM_MAP_THREADENTRY), NULL, NULL))) { goto fail; }
+    // 1: transfer result from generic map into PVMMOB_MAP_THREAD
+    if(!(cMap = ObMap_Size(ctx->pmThread))) { return; }
+    if(!(pObThreadMap = Ob_Alloc(OB_TAG_MAP_THREAD, 0, sizeof(VMMOB_MAP_THREAD) + cMap * sizeof(VMM_MAP_THREADENTRY), NULL, NULL))) { return; }
     pObThreadMap->cMap = cMap;
-    cbTrapFrame = ((ot->oTrapRsp < 0x200 - 8) && (ot->oTrapRip < 0x200 - 8)) ? 8 + max(ot->oTrapRsp, ot->oTrapRip) : 0;
-    VmmCachePrefetchPages3(pObSystemProcess, psObTrapFrame, cbTrapFrame, 0);
-    VmmCachePrefetchPages3(pProcess, psObTeb, 0x20, 0);
+    if(ctx->fTebPrefetchVirtual) {
+        VmmCachePrefetchPages3(pProcess, ctx->psObTeb, 0x20, 0);
+    }
     for(i = 0; i < cMap; i++) {
-        pThreadEntry = (PVMM_MAP_THREADENTRY)ObMap_GetByIndex(pmObThreads, i);
+        pThreadEntry = (PVMM_MAP_THREADENTRY)ObMap_GetByIndex(ctx->pmThread, i);
         // fetch Teb
         if(VmmRead2(pProcess, pThreadEntry->vaTeb, pb, 0x20, VMM_FLAG_FORCECACHE_READ)) {
             pThreadEntry->vaStackBaseUser = VMM_PTR_OFFSET_DUAL(f32, pb, 4, 8);
             pThreadEntry->vaStackLimitUser = VMM_PTR_OFFSET_DUAL(f32, pb, 8, 16);
         }
         // fetch TrapFrame (RSP/RIP)
-        if(cbTrapFrame && VmmRead2(pObSystemProcess, pThreadEntry->vaTrapFrame, pb, cbTrapFrame, VMM_FLAG_FORCECACHE_READ)) {
+        if(cbTrapFrame && VmmRead2(pSystemProcess, pThreadEntry->vaTrapFrame, pb, cbTrapFrame, VMM_FLAG_FORCECACHE_READ)) {
             pThreadEntry->vaRIP = VMM_PTR_OFFSET(f32, pb, ot->oTrapRip);
             pThreadEntry->vaRSP = VMM_PTR_OFFSET(f32, pb, ot->oTrapRsp);
             f = ((pThreadEntry->vaStackBaseUser > pThreadEntry->vaRSP) && (pThreadEntry->vaStackLimitUser < pThreadEntry->vaRSP)) ||
@@ -1290,13 +1333,91 @@ VOID VmmWinThread_Initialize_DoWork(_In_ PVMM_PROCESS pProcess)
         // commit
         memcpy(pObThreadMap->pMap + i, pThreadEntry, sizeof(VMM_MAP_THREADENTRY));
     }
-    // 3: sort on thread id (TID) and assign result to process object.
+    // 2: sort on thread id (TID) and assign result to process object.
     qsort(pObThreadMap->pMap, cMap, sizeof(VMM_MAP_THREADENTRY), (int(*)(const void*, const void*))VmmWinThread_Initialize_CmpThreadEntry);
     pProcess->Map.pObThread = pObThreadMap;     // pProcess take reference responsibility
+}
+
+/*
+* Build the thread maps of one or more processes. The thread lists of all the
+* processes are walked together - one device round trip per list depth step.
+* NB! Caller must hold Map.LockUpdateThreadMap of all processes.
+* -- cProcess
+* -- ppProcess
+*/
+VOID VmmWinThread_Initialize_DoWork(_In_ DWORD cProcess, _In_reads_(cProcess) PVMM_PROCESS *ppProcess)
+{
+    BOOL f32 = ctxVmm->f32;
+    DWORD i, cList = 0, cbTrapFrame = 0;
+    QWORD va, pa, vaThreadListEntry;
+    PQWORD pvaListStart = NULL;
+    POB_SET psObTrapFrame = NULL, psObTebPhys = NULL;
+    PVMM_PROCESS pObSystemProcess = NULL;
+    PVMMWIN_LISTTRAVERSE_LIST pList = NULL;
+    PVMMWIN_INITIALIZETHREAD_CONTEXT pCtx = NULL;
+    PVMM_OFFSET_ETHREAD ot = &ctxVmm->offset.ETHREAD;
+    // 1: set up and perform list traversal call of all thread lists at once.
+    if(!(pObSystemProcess = VmmProcessGet(4))) { goto fail; }
+    if(!(psObTrapFrame = ObSet_New())) { goto fail; }
+    if(!(psObTebPhys = ObSet_New())) { goto fail; }
+    if(!(pCtx = LocalAlloc(LMEM_ZEROINIT, cProcess * sizeof(VMMWIN_INITIALIZETHREAD_CONTEXT)))) { goto fail; }
+    if(!(pList = LocalAlloc(LMEM_ZEROINIT, cProcess * sizeof(VMMWIN_LISTTRAVERSE_LIST)))) { goto fail; }
+    if(!(pvaListStart = LocalAlloc(LMEM_ZEROINIT, cProcess * sizeof(QWORD)))) { goto fail; }
+    for(i = 0; i < cProcess; i++) {
+        vaThreadListEntry = VMM_PTR_OFFSET(f32, ppProcess[i]->win.EPROCESS.pb, ot->oThreadListHeadKP);
+        if(f32 ? !VMM_KADDR32_4(vaThreadListEntry) : !VMM_KADDR64_8(vaThreadListEntry)) { continue; }
+        if(!(pCtx[cList].pmThread = ObMap_New(OB_MAP_FLAGS_OBJECT_LOCALFREE))) { goto fail; }
+        if(!(pCtx[cList].psObTeb = ObSet_New())) { goto fail; }
+        pCtx[cList].psObTrapFrame = psObTrapFrame;
+        pCtx[cList].pProcess = ppProcess[i];
+        pvaListStart[cList] = vaThreadListEntry - ot->oThreadListEntry;
+        pList[cList].ctx = pCtx + cList;
+        pList[cList].cvaDataStart = 1;
+        pList[cList].pvaDataStart = pvaListStart + cList;
+        pList[cList].pPrefetchAddressContainer = ppProcess[i]->pObPersistent->pObCMapThreadPrefetch;
+        cList++;
+    }
+    VmmWin_ListTraversePrefetchMulti(
+        pObSystemProcess,
+        f32,
+        cList,
+        pList,
+        ot->oThreadListEntry,
+        ot->oMax,
+        VmmWinThread_Initialize_DoWork_Pre,
+        NULL);
+    // 2: fetch trap frames and TEBs of all processes in one go and finish the
+    //    maps. TEBs are translated up front and read by physical address in a
+    //    single batch; processes with TEBs that do not translate (e.g. paged
+    //    out) fall back to a per-process virtual address prefetch.
+    cbTrapFrame = ((ot->oTrapRsp < 0x200 - 8) && (ot->oTrapRip < 0x200 - 8)) ? 8 + max(ot->oTrapRsp, ot->oTrapRip) : 0;
+    VmmCachePrefetchPages3(pObSystemProcess, psObTrapFrame, cbTrapFrame, 0);
+    for(i = 0; i < cList; i++) {
+        va = 0;
+        while((va = ObSet_GetNext(pCtx[i].psObTeb, va))) {
+            if(VmmVirt2Phys(pCtx[i].pProcess, va, &pa) && ((pa & 0xfff) + 0x20 <= 0x1000)) {
+                ObSet_Push(psObTebPhys, pa & ~0xfff);
+            } else {
+                pCtx[i].fTebPrefetchVirtual = TRUE;
+            }
+        }
+    }
+    VmmCachePrefetchPages(NULL, psObTebPhys, 0);
+    for(i = 0; i < cList; i++) {
+        VmmWinThread_Initialize_DoWork_Finish(pObSystemProcess, pCtx + i, cbTrapFrame);
+    }
 fail:
-    Ob_DECREF(psObTeb);
+    if(pCtx) {
+        for(i = 0; i < cProcess; i++) {
+            Ob_DECREF(pCtx[i].psObTeb);
+            Ob_DECREF(pCtx[i].pmThread);
+        }
+        LocalFree(pCtx);
+    }
+    LocalFree(pList);
+    LocalFree(pvaListStart);
     Ob_DECREF(psObTrapFrame);
-    Ob_DECREF(pmObThreads);
+    Ob_DECREF(psObTebPhys);
     Ob_DECREF(pObSystemProcess);
 }
 
@@ -1319,7 +1440,7 @@ BOOL VmmWinThread_Initialize(_In_ PVMM_PROCESS pProcess, _In_ BOOL fNonBlocking)
         EnterCriticalSection(&pProcess->Map.LockUpdateThreadMap);
     }
     if(!pProcess->Map.pObThread) {
-        VmmWinThread_Initialize_DoWork(pProcess);
+        VmmWinThread_Initialize_DoWork(1, &pProcess);
         if(!pProcess->Map.pObThread) {
             pProcess->Map.pObThread = Ob_Alloc(OB_TAG_MAP_THREAD, LMEM_ZEROINIT, sizeof(VMMOB_MAP_THREAD), NULL, NULL);
         }
@@ -1328,6 +1449,84 @@ BOOL VmmWinThread_Initialize(_In_ PVMM_PROCESS pProcess, _In_ BOOL fNonBlocking)
     return pProcess->Map.pObThread ? TRUE : FALSE;
 }
 
+VOID VmmWinThread_InitializeMulti(_In_ DWORD cProcess, _In_reads_(cProcess) PVMM_PROCESS *ppProcess)
+{
+    DWORD i, cLocked = 0;
+    PVMM_PROCESS *ppLocked = NULL;
+    if(!ctxVmm->fThreadMapEnabled || !cProcess) { return; }
+    if(!(ppLocked = LocalAlloc(0, cProcess * sizeof(PVMM_PROCESS)))) { return; }
+    for(i = 0; i < cProcess; i++) {
+        if(ppProcess[i]->Map.pObThread) { continue; }
+        VmmTlbSpider(ppProcess[i]);     // no-op if already spidered by the caller
+        if(!TryEnterCriticalSection(&ppProcess[i]->Map.LockUpdateThreadMap)) { continue; }
+        if(ppProcess[i]->Map.pObThread) {
+            LeaveCriticalSection(&ppProcess[i]->Map.LockUpdateThreadMap);
+            continue;
+        }
+        ppLocked[cLocked++] = ppProcess[i];
+    }
+    if(cLocked) {
+        VmmWinThread_Initialize_DoWork(cLocked, ppLocked);
+    }
+    for(i = 0; i < cLocked; i++) {
+        if(!ppLocked[i]->Map.pObThread) {
+            ppLocked[i]->Map.pObThread = Ob_Alloc(OB_TAG_MAP_THREAD, LMEM_ZEROINIT, sizeof(VMMOB_MAP_THREAD), NULL, NULL);
+        }
+        LeaveCriticalSection(&ppLocked[i]->Map.LockUpdateThreadMap);
+    }
+    LocalFree(ppLocked);
+}
+
+typedef struct tdVMMWIN_INITIALIZEALL_CONTEXT {
+    PVOID ctx;
+    BOOL(*pfnContinue)(_In_opt_ PVOID ctx);
+} VMMWIN_INITIALIZEALL_CONTEXT, *PVMMWIN_INITIALIZEALL_CONTEXT;
+
+BOOL VmmWinThread_InitializeAll_CriteriaNoThreadMap(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx)
+{
+    return (pProcess->dwState == 0) && !pProcess->Map.pObThread;
+}
+
+VOID VmmWinThread_InitializeAll_TlbSpiderAction(_In_ PVMM_PROCESS pProcess, _In_ PVMMWIN_INITIALIZEALL_CONTEXT ctx)
+{
+    if(ctx->pfnContinue && !ctx->pfnContinue(ctx->ctx)) { return; }
+    VmmTlbSpider(pProcess);
+}
+
+/*
+* Initialize the thread maps of all active processes at once in one combined
+* thread list traversal. The page tables of the processes (required to read
+* the TEBs) are spidered in parallel on the worker threads up front.
+* -- ctxContinue = optional context forwarded to pfnContinue.
+* -- pfnContinue = optional budget callback - checked before each page table
+*                  spider and before the combined thread list traversal.
+*/
+VOID VmmWinThread_InitializeAll(_In_opt_ PVOID ctxContinue, _In_opt_ BOOL(*pfnContinue)(_In_opt_ PVOID ctx))
+{
+    DWORD i, cProcess = 0;
+    PVMM_PROCESS pObProcess = NULL, *ppObProcess = NULL;
+    PVMMOB_PROCESS_TABLE ptObProcess = NULL;
+    VMMWIN_INITIALIZEALL_CONTEXT ctxAll = { ctxContinue, pfnContinue };
+    if(!ctxVmm->fThreadMapEnabled) { return; }
+    VmmProcessActionForeachParallel(&ctxAll, VmmWinThread_InitializeAll_CriteriaNoThreadMap, VmmWinThread_InitializeAll_TlbSpiderAction);
+    if(pfnContinue && !pfnContinue(ctxContinue)) { return; }
+    if(!(ptObProcess = (PVMMOB_PROCESS_TABLE)ObContainer_GetOb(ctxVmm->pObCPROC))) { return; }
+    if(!(ppObProcess = LocalAlloc(0, ptObProcess->c * sizeof(PVMM_PROCESS)))) { goto fail; }
+    while((pObProcess = VmmProcessGetNextEx(ptObProcess, pObProcess, 0)) && (cProcess < ptObProcess->c)) {
+        if((pObProcess->dwState == 0) && !pObProcess->Map.pObThread) {
+            ppObProcess[cProcess++] = Ob_INCREF(pObProcess);
+        }
+    }
+    Ob_DECREF_NULL(&pObProcess);
+    VmmWinThread_InitializeMulti(cProcess, ppObProcess);
+fail:
+    for(i = 0; i < cProcess; i++) {
+        Ob_DECREF(ppObProcess[i]);
+    }
+    LocalFree(ppObProcess);
+    Ob_DECREF(ptObProcess);
+}
+
 // ----------------------------------------------------------------------------
 // HANDLE FUNCTIONALITY BELOW:
 //
@@ -1672,6 +1871,9 @@ DWORD VmmWinHandle_InitializeText_GetPoolHeader64(_In_reads_(0x60) PBYTE pb, _Ou
     return 0;
 }
 
+#define VMMWINHANDLE_TEXT_CHUNK                 0x800   // objects per parallel resolve chunk
+#define VMMWINHANDLE_TEXT_PARALLEL_THREADS      8
+
 typedef struct tdVMMWINHANDLE_REGHELPER {
     QWORD vaCmKeyControlBlock;
     QWORD vaHive;
@@ -1682,7 +1884,7 @@ typedef struct tdVMMWINHANDLE_REGHELPER {
 } VMMWINHANDLE_REGHELPER, *PVMMWINHANDLE_REGHELPER;
 
 /*
-* Helper function for VmmWinHandle_InitializeText_DoWork that fetches registry
+* Helper function for VmmWinHandle_InitializeText_Resolve that fetches registry
 * names provided that the underlying _CM_KEY_CONTROL_BLOCK is prefetched.
 * -- pSystemProcess
 * -- pm
@@ -1778,7 +1980,14 @@ VOID VmmWinHandle_InitializeText_DoWork_FileSizeHelper(_In_ PVMM_PROCESS pSystem
     }
 }
 
-VOID VmmWinHandle_InitializeText_DoWork(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMMOB_MAP_HANDLE pHandleMap)
+/*
+* Resolve object information and text for all entries of a handle map. Entries
+* sharing the same object are resolved independently - callers should provide
+* maps of unique objects.
+* -- pSystemProcess
+* -- pHandleMap
+*/
+VOID VmmWinHandle_InitializeText_Resolve(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMMOB_MAP_HANDLE pHandleMap)
 {
     BOOL f, fThreadingEnabled;
     PBYTE pbMultiText = NULL;
@@ -2006,6 +2215,208 @@ fail:
     Ob_DECREF(pmObRegHelperMap);
 }
 
+/*
+* Context for parallel object text resolution. Chunks of VMMWINHANDLE_TEXT_CHUNK
+* objects are claimed through VmmWorkParallel by worker threads and the caller.
+*/
+typedef struct tdVMMWINHANDLE_TEXT_PARALLEL {
+    PVMM_PROCESS pSystemProcess;
+    POB_MAP pmObObjectName;
+    DWORD cObject;
+    PQWORD pvaObject;
+} VMMWINHANDLE_TEXT_PARALLEL, *PVMMWINHANDLE_TEXT_PARALLEL;
+
+/*
+* Resolve a chunk of previously unresolved objects and store the results in
+* the shared object name cache.
+* -- ctx
+* -- iStart
+* -- cObject
+*/
+VOID VmmWinHandle_TextParallel_ResolveChunk(_In_ PVMMWINHANDLE_TEXT_PARALLEL ctx, _In_ DWORD iStart, _In_ DWORD cObject)
+{
+    DWORD i;
+    PVMM_MAP_HANDLEENTRY pe;
+    PVMMOB_MAP_HANDLE pTmpMap;
+    PVMMWIN_OB_OBJECTNAME pObName;
+    if(!(pTmpMap = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMOB_MAP_HANDLE) + cObject * sizeof(VMM_MAP_HANDLEENTRY)))) { return; }
+    pTmpMap->cMap = cObject;
+    for(i = 0; i < cObject; i++) {
+        pTmpMap->pMap[i].vaObject = ctx->pvaObject[iStart + i];
+    }
+    VmmWinHandle_InitializeText_Resolve(ctx->pSystemProcess, pTmpMap);
+    for(i = 0; i < cObject; i++) {
+        pe = pTmpMap->pMap + i;
+        if(!(pObName = Ob_Alloc(OB_TAG_WIN_OBJECTNAME, 0, sizeof(VMMWIN_OB_OBJECTNAME) + (pe->cwszText + 1ULL) * sizeof(WCHAR), NULL, NULL))) { continue; }
+        pObName->e = *pe;
+        pObName->e.wszText = NULL;
+        pObName->cwszText = pe->cwszText;
+        if(pe->cwszText) {
+            memcpy(pObName->wszText, pe->wszText, pe->cwszText * sizeof(WCHAR));
+        }
+        pObName->wszText[pe->cwszText] = 0;
+        ObMap_Push(ctx->pmObObjectName, pe->vaObject, pObName);
+        Ob_DECREF(pObName);
+    }
+    LocalFree(pTmpMap->wszMultiText);
+    LocalFree(pTmpMap);
+}
+
+VOID VmmWinHandle_TextParallel_Item(_In_ PVMMWINHANDLE_TEXT_PARALLEL ctx, _In_ DWORD iChunk)
+{
+    DWORD iStart = iChunk * VMMWINHANDLE_TEXT_CHUNK;
+    VmmWinHandle_TextParallel_ResolveChunk(ctx, iStart, min(VMMWINHANDLE_TEXT_CHUNK, ctx->cObject - iStart));
+}
+
+/*
+* Resolve objects not already in the shared object name cache. Large sets are
+* split into chunks which are resolved in parallel on the worker threads. The
+* caller resolves chunks itself and only waits for chunks in progress on other
+* threads - it may thus be called from within a worker thread.
+* -- pSystemProcess
+* -- pmObObjectName
+* -- psvaObject = objects to resolve.
+*/
+VOID VmmWinHandle_InitializeText_ResolveParallel(_In_ PVMM_PROCESS pSystemProcess, _In_ POB_MAP pmObObjectName, _In_ POB_SET psvaObject)
+{
+    DWORD i, cChunk;
+    VMMWINHANDLE_TEXT_PARALLEL ctx = { 0 };
+    ctx.pSystemProcess = pSystemProcess;
+    ctx.pmObObjectName = pmObObjectName;
+    if(!(ctx.cObject = ObSet_Size(psvaObject))) { return; }
+    if(!(ctx.pvaObject = LocalAlloc(0, ctx.cObject * sizeof(QWORD)))) { return; }
+    for(i = 0; i < ctx.cObject; i++) {
+        ctx.pvaObject[i] = ObSet_Get(psvaObject, i);
+    }
+    cChunk = (ctx.cObject + VMMWINHANDLE_TEXT_CHUNK - 1) / VMMWINHANDLE_TEXT_CHUNK;
+    VmmWorkParallel(cChunk, VMMWINHANDLE_TEXT_PARALLEL_THREADS - 1, (VOID(*)(PVOID, DWORD))VmmWinHandle_TextParallel_Item, &ctx);
+    LocalFree(ctx.pvaObject);
+}
+
+/*
+* Retrieve the object name cache - creating it if required.
+* CALLER DECREF: return
+* -- return
+*/
+POB_MAP VmmWinHandle_ObjectNameCache_GetOrCreate()
+{
+    POB_MAP pmOb;
+    if((pmOb = ObContainer_GetOb(ctxVmm->pObCObjectNameCache))) { return pmOb; }
+    EnterCriticalSection(&ctxVmm->LockUpdateMap);
+    if(!(pmOb = ObContainer_GetOb(ctxVmm->pObCObjectNameCache))) {
+        if((pmOb = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) {
+            ObContainer_SetOb(ctxVmm->pObCObjectNameCache, pmOb);
+        }
+    }
+    LeaveCriticalSection(&ctxVmm->LockUpdateMap);
+    return pmOb;
+}
+
+/*
+* Refresh the handle sub-system. Clears the object name cache shared between
+* the handle maps of all processes.
+*/
+VOID VmmWinHandle_Refresh()
+{
+    ObContainer_SetOb(ctxVmm->pObCObjectNameCache, NULL);
+}
+
+/*
+* Resolve kernel objects into the object name cache. Safe to call from within
+* a worker thread (see VmmWinHandle_InitializeText_ResolveParallel).
+* -- pSystemProcess
+* -- psvaObject
+*/
+VOID VmmWinHandle_ObjectNameResolve(_In_ PVMM_PROCESS pSystemProcess, _In_ POB_SET psvaObject)
+{
+    DWORD i;
+    QWORD va;
+    POB_SET psObUnresolved = NULL;
+    POB_MAP pmObObjectName = NULL;
+    if(!(pmObObjectName = VmmWinHandle_ObjectNameCache_GetOrCreate())) { goto fail; }
+    if(!(psObUnresolved = ObSet_New())) { goto fail; }
+    for(i = 0; (va = ObSet_Get(psvaObject, i)); i++) {
+        if(!ObMap_ExistsKey(pmObObjectName, va)) {
+            ObSet_Push(psObUnresolved, va);
+        }
+    }
+    if(ObSet_Size(psObUnresolved)) {
+        VmmWinHandle_InitializeText_ResolveParallel(pSystemProcess, pmObObjectName, psObUnresolved);
+    }
+fail:
+    Ob_DECREF(psObUnresolved);
+    Ob_DECREF(pmObObjectName);
+}
+
+/*
+* Retrieve resolved object information from the object name cache.
+* CALLER DECREF: return
+* -- vaObject
+* -- return
+*/
+_Success_(return != NULL)
+PVMMWIN_OB_OBJECTNAME VmmWinHandle_ObjectNameGet(_In_ QWORD vaObject)
+{
+    POB_MAP pmObObjectName;
+    PVMMWIN_OB_OBJECTNAME pObName = NULL;
+    if((pmObObjectName = ObContainer_GetOb(ctxVmm->pObCObjectNameCache))) {
+        pObName = ObMap_GetByKey(pmObObjectName, vaObject);
+        Ob_DECREF(pmObObjectName);
+    }
+    return pObName;
+}
+
+/*
+* Initialize the extended text information of a handle map. Object information
+* and text is resolved once per object and refresh and is shared in the object
+* name cache between processes (handles to the same object in many processes
+* are common). The handle map receive its own de-duplicated copy of the texts.
+* -- pSystemProcess
+* -- pHandleMap
+*/
+VOID VmmWinHandle_InitializeText_DoWork(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMMOB_MAP_HANDLE pHandleMap)
+{
+    BOOL fResult = FALSE;
+    DWORD i;
+    PVMM_MAP_HANDLEENTRY pe;
+    POB_SET psObObject = NULL;
+    POB_MAP pmObObjectName = NULL;
+    POB_STRMAP psmOb = NULL;
+    PVMMWIN_OB_OBJECTNAME pObName = NULL;
+    if(!(pmObObjectName = VmmWinHandle_ObjectNameCache_GetOrCreate())) { goto fail; }
+    // 1: resolve objects missing from cache
+    if(!(psObObject = ObSet_New())) { goto fail; }
+    for(i = 0; i < pHandleMap->cMap; i++) {
+        ObSet_Push(psObObject, pHandleMap->pMap[i].vaObject);
+    }
+    VmmWinHandle_ObjectNameResolve(pSystemProcess, psObObject);
+    // 2: fill handle map from cache
+    if(!(psmOb = ObStrMap_New())) { goto fail; }
+    for(i = 0; i < pHandleMap->cMap; i++) {
+        pe = pHandleMap->pMap + i;
+        if((pObName = ObMap_GetByKey(pmObObjectName, pe->vaObject))) {
+            pe->iType = pObName->e.iType;
+            pe->qwHandleCount = pObName->e.qwHandleCount;
+            pe->qwPointerCount = pObName->e.qwPointerCount;
+            pe->vaObjectCreateInfo = pObName->e.vaObjectCreateInfo;
+            pe->vaSecurityDescriptor = pObName->e.vaSecurityDescriptor;
+            pe->dwPoolTag = pObName->e.dwPoolTag;
+            pe->tpInfoEx = pObName->e.tpInfoEx;
+            pe->_Reserved = pObName->e._Reserved;
+        }
+        ObStrMap_PushPtrW(psmOb, (pObName ? pObName->wszText : NULL), (pObName ? pObName->cwszText : 0), &pe->wszText, &pe->cwszText);
+        Ob_DECREF_NULL(&pObName);
+    }
+    fResult = ObStrMap_FinalizeAllocW_DECREF_NULL(&psmOb, &pHandleMap->wszMultiText, &pHandleMap->cbMultiText);
+fail:
+    Ob_DECREF(psmOb);
+    Ob_DECREF(psObObject);
+    Ob_DECREF(pmObObjectName);
+    if(!fResult) {
+        VmmWinHandle_InitializeText_Resolve(pSystemProcess, pHandleMap);
+    }
+}
+
 VOID VmmWinHandle_InitializeCore_DoWork(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pProcess)
 {
     BOOL fResult = FALSE;
@@ -2306,12 +2717,13 @@ PVMMOB_MAP_USER VmmWinUser_Initialize_DoWork()
         DWORD cchUser;
         WCHAR wszUser[MAX_PATH];
     } VMMWINUSER_CONTEXT_ENTRY, *PVMMWINUSER_CONTEXT_ENTRY;
-    DWORD i, dwType, cchUserTotal = 1, oMultiText = 1;
+    DWORD i, dwType;
     LPSTR szNtdat, szUser;
     LPWSTR wszSymlinkSid, wszSymlinkUser;
     WCHAR wszSymlinkValue[MAX_PATH];
     POB_REGISTRY_HIVE pObHive = NULL;
     POB_SET pObSet = NULL;
+    POB_STRMAP psmOb = NULL;
     PVMMWINUSER_CONTEXT_ENTRY e = NULL;
     PVMMOB_MAP_USER pObMapUser = NULL;
     PVMM_MAP_USERENTRY pe;
@@ -2362,7 +2774,6 @@ PVMMOB_MAP_USER VmmWinUser_Initialize_DoWork()
         e->dwHashSID = Util_HashStringA(e->szSID);
         // store context in map
         e->cchUser = (DWORD)wcslen(e->wszUser);
-        cchUserTotal += e->cchUser + 1;
         ObSet_Push(pObSet, (QWORD)e);
         e = NULL;
     }
@@ -2370,8 +2781,7 @@ PVMMOB_MAP_USER VmmWinUser_Initialize_DoWork()
     // 2: create user map and assign data
     if(!(pObMapUser = Ob_Alloc(OB_TAG_MAP_USER, LMEM_ZEROINIT, sizeof(VMMOB_MAP_USER) + ObSet_Size(pObSet) * sizeof(VMM_MAP_USERENTRY), VmmWinUser_CloseObCallback, NULL))) { goto fail; }
     pObMapUser->cMap = ObSet_Size(pObSet);
-    pObMapUser->cbMultiText = cchUserTotal * sizeof(WCHAR);
-    if(!(pObMapUser->wszMultiText = LocalAlloc(LMEM_ZEROINIT, pObMapUser->cbMultiText))) { goto fail; }
+    if(!(psmOb = ObStrMap_New())) { goto fail; }
     for(i = 0; i < pObMapUser->cMap; i++) {
         if(!(e = (PVMMWINUSER_CONTEXT_ENTRY)ObSet_Pop(pObSet))) { goto fail; }
         pe = pObMapUser->pMap + i;
@@ -2380,16 +2790,15 @@ PVMMOB_MAP_USER VmmWinUser_Initialize_DoWork()
         pe->szSID = e->szSID;
         pe->dwHashSID = e->dwHashSID;
         pe->vaRegHive = e->vaHive;
-        pe->cwszText = e->cchUser;
-        pe->wszText = pObMapUser->wszMultiText + oMultiText;
-        memcpy(pe->wszText, e->wszUser, pe->cwszText * sizeof(WCHAR));
-        oMultiText += e->cchUser + 1;
+        ObStrMap_PushPtrW(psmOb, e->wszUser, e->cchUser, &pe->wszText, &pe->cwszText);
         LocalFree(e);
     }
+    if(!ObStrMap_FinalizeAllocW_DECREF_NULL(&psmOb, &pObMapUser->wszMultiText, &pObMapUser->cbMultiText)) { goto fail; }
     // finish & return
     Ob_DECREF(pObSet);
     return pObMapUser;
 fail:
+    Ob_DECREF(psmOb);
     Ob_DECREF(pObMapUser);
     if(pObSet) {
         while((e = (PVMMWINUSER_CONTEXT_ENTRY)ObSet_Pop(pObSet))) {
@@ -2822,6 +3231,29 @@ VOID VmmWinProcess_Enum64_Post(_In_ PVMM_PROCESS pSystemProcess, _In_opt_ PVMMWI
     ctx->cProc++;
 }
 
+/*
+* Try load the EPROCESS offsets from the offset profile of the kernel build.
+* The loaded offsets are sanity checked against the SYSTEM process before use.
+* -- pSystemProcess
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinProcess_OffsetProfileLoad(_In_ PVMM_PROCESS pSystemProcess)
+{
+    BYTE pb[VMMPROC_EPROCESS64_MAX_SIZE];
+    QWORD paDTB;
+    PVMM_OFFSET_EPROCESS po = &ctxVmm->offset.EPROCESS;
+    if(!VmmWinProfile_Get(VMMWINPROFILE_ID_EPROCESS, po, sizeof(VMM_OFFSET_EPROCESS))) { return FALSE; }
+    if(!po->fValid || (po->cbMaxOffset > sizeof(pb)) || (po->PID + 8 > po->cbMaxOffset) || (po->DTB + 8 > po->cbMaxOffset)) { goto fail; }
+    if(!VmmRead(pSystemProcess, pSystemProcess->win.EPROCESS.va, pb, po->cbMaxOffset)) { goto fail; }
+    paDTB = ctxVmm->f32 ? (*(PDWORD)(pb + po->DTB) & 0xffffffe0) : (*(PQWORD)(pb + po->DTB) & ~0xfff);
+    if((*(PDWORD)(pb + po->PID) != 4) || (paDTB != pSystemProcess->paDTB)) { goto fail; }
+    return TRUE;
+fail:
+    ZeroMemory(po, sizeof(VMM_OFFSET_EPROCESS));
+    return FALSE;
+}
+
 /*
 * Try walk the EPROCESS list in the Windows kernel to enumerate processes into
 * the VMM/PROC file system.
@@ -2834,7 +3266,7 @@ BOOL VmmWinProcess_Enum64(_In_ PVMM_PROCESS pSystemProcess, _In_ BOOL fTotalRefr
     PVMM_OFFSET_EPROCESS po = &ctxVmm->offset.EPROCESS;
     VMMWIN_ENUMERATE_EPROCESS_CONTEXT ctx = { 0 };
     // retrieve offsets
-    if(!po->fValid) {
+    if(!po->fValid && !VmmWinProcess_OffsetProfileLoad(pSystemProcess)) {
         VmmWinProcess_OffsetLocator64(pSystemProcess);
         if(!po->fValid || ctxMain->cfg.fVerboseExtra) {
             VmmWinProcess_OffsetLocator_Print();
@@ -2843,6 +3275,7 @@ BOOL VmmWinProcess_Enum64(_In_ PVMM_PROCESS pSystemProcess, _In_ BOOL fTotalRefr
             vmmprintf("VmmWin: Unable to locate EPROCESS offsets.\n");
             return FALSE;
         }
+        VmmWinProfile_Set(VMMWINPROFILE_ID_EPROCESS, po, sizeof(VMM_OFFSET_EPROCESS));
     }
     vmmprintfvv_fn("SYSTEM DTB: %016llx EPROCESS: %016llx\n", pSystemProcess->paDTB, pSystemProcess->win.EPROCESS.va);
     // set up context
@@ -3124,7 +3557,7 @@ BOOL VmmWinProcess_Enum32(_In_ PVMM_PROCESS pSystemProcess, _In_ BOOL fTotalRefr
     PVMM_OFFSET_EPROCESS po = &ctxVmm->offset.EPROCESS;
     VMMWIN_ENUMERATE_EPROCESS_CONTEXT ctx = { 0 };
     // retrieve offsets
-    if(!po->fValid) {
+    if(!po->fValid && !VmmWinProcess_OffsetProfileLoad(pSystemProcess)) {
         VmmWinProcess_OffsetLocator32(pSystemProcess);
         if(!po->fValid || ctxMain->cfg.fVerboseExtra) {
             VmmWinProcess_OffsetLocator_Print();
@@ -3133,6 +3566,7 @@ BOOL VmmWinProcess_Enum32(_In_ PVMM_PROCESS pSystemProcess, _In_ BOOL fTotalRefr
             vmmprintf("VmmWin: Unable to locate EPROCESS offsets.\n");
             return FALSE;
         }
+        VmmWinProfile_Set(VMMWINPROFILE_ID_EPROCESS, po, sizeof(VMM_OFFSET_EPROCESS));
     }
     vmmprintfvv_fn("SYSTEM DTB: %016llx EPROCESS: %08x\n", pSystemProcess->paDTB, (DWORD)pSystemProcess->win.EPROCESS.va);
     // set up context
@@ -3185,70 +3619,117 @@ BOOL VmmWinProcess_Enumerate(_In_ PVMM_PROCESS pSystemProcess, _In_ BOOL fRefres
 #define VMMWIN_LISTTRAVERSEPREFETCH_LOOPPROTECT_MAX         0x1000
 
 /*
-* Walk a windows linked list in an efficient way that minimize IO requests to
-* the the device. This is advantageous for latency reasons. The function return
-* a set of the addresses used - this may be used to prefetch pages in advance
-* if the list should be walked again at a later time.
-* The callback function must only return FALSE on severe errors when the list
-* should no longer be continued to be walked in the direction.
-* CALLER_DECREF: return
+* Retrieve the data of a list entry. If the entry is fully contained within a
+* single physical page a pointer into the referenced cache page is returned -
+* avoiding a copy - otherwise the data is read into the supplied buffer.
+* -- pProcess
+* -- vaData
+* -- cbData
+* -- pbBuffer = buffer of cbData bytes used if entry cannot be retrieved from cache.
+* -- flags
+* -- ppObMEM = receives the referenced cache page (if any) - CALLER DECREF.
+* -- return = pointer to entry data on success, NULL on fail.
+*/
+PBYTE VmmWin_ListTraversePrefetch_Read(_In_ PVMM_PROCESS pProcess, _In_ QWORD vaData, _In_ DWORD cbData, _Out_writes_(cbData) PBYTE pbBuffer, _In_ QWORD flags, _Out_ PVMMOB_MEM *ppObMEM)
+{
+    DWORD cbRead;
+    if(((vaData & 0xfff) + cbData <= 0x1000) && (*ppObMEM = VmmReadPageOb(pProcess, vaData, flags))) {
+        return (*ppObMEM)->pb + (vaData & 0xfff);
+    }
+    *ppObMEM = NULL;
+    VmmReadEx(pProcess, vaData, pbBuffer, cbData, &cbRead, flags);
+    return (cbRead == cbData) ? pbBuffer : NULL;
+}
+
+/*
+* Walk many independent windows linked lists in the same address space at the
+* same time. The lists are walked breadth-first as one combined frontier and
+* each step of the walk is one batched prefetch across all lists - the number
+* of device round trips is the depth of the deepest list rather than the sum
+* of the depths of all lists.
+* The callback functions are called with the ctx of the list the entry belongs
+* to. The callback function must only return FALSE on severe errors when the
+* list should no longer be continued to be walked in the direction.
 * -- pProcess
 * -- f32
-* -- ctx = ctx to pass along to callback function (if any)
-* -- cvaDataStart
-* -- pvaDataStart
+* -- cList
+* -- pList = the lists to walk.
 * -- oListStart = offset (in bytes) to _LIST_ENTRY from vaDataStart
 * -- cbData
 * -- pfnCallback_Pre = optional callback function to gather additional addresses.
 * -- pfnCallback_Post = optional callback function called after all pages fetched into cache.
-* -- pContainerPrefetch = optional pointer to a PVMMOBCONTAINER containing a POB_VSET of prefetch addresses to use/update.
 */
-VOID VmmWin_ListTraversePrefetch(
+VOID VmmWin_ListTraversePrefetchMulti(
     _In_ PVMM_PROCESS pProcess,
     _In_ BOOL f32,
-    _In_opt_ PVOID ctx,
-    _In_ DWORD cvaDataStart,
-    _In_ PQWORD pvaDataStart,
+    _In_ DWORD cList,
+    _In_reads_(cList) PVMMWIN_LISTTRAVERSE_LIST pList,
     _In_ DWORD oListStart,
     _In_ DWORD cbData,
     _In_opt_ VOID(*pfnCallback_Pre)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx, _In_ QWORD va, _In_ PBYTE pb, _In_ DWORD cb, _In_ QWORD vaFLink, _In_ QWORD vaBLink, _In_ POB_SET pVSetAddress, _Inout_ PBOOL pfValidEntry, _Inout_ PBOOL pfValidFLink, _Inout_ PBOOL pfValidBLink),
-    _In_opt_ VOID(*pfnCallback_Post)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx, _In_ QWORD va, _In_ PBYTE pb, _In_ DWORD cb),
-    _In_opt_ POB_CONTAINER pPrefetchAddressContainer)
+    _In_opt_ VOID(*pfnCallback_Post)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx, _In_ QWORD va, _In_ PBYTE pb, _In_ DWORD cb))
 {
+    DWORD i, iList, c;
     QWORD vaData;
-    DWORD cbReadData;
-    PBYTE pbData = NULL;
+    PBYTE pbData, pbBuffer = NULL;
+    PVMMOB_MEM pObMEM = NULL;
     QWORD vaFLink, vaBLink;
+    PDWORD pcMerged = NULL;
+    POB_SET *ppObSet_vaList = NULL;
     POB_SET pObSet_vaAll = NULL, pObSet_vaTry1 = NULL, pObSet_vaTry2 = NULL, pObSet_vaValid = NULL;
+    POB_MAP pmObList = NULL;
     BOOL fValidEntry, fValidFLink, fValidBLink, fTry1;
-    // 1: Prefetch any addresses stored in optional address container
-    pObSet_vaAll = ObContainer_GetOb(pPrefetchAddressContainer);
-    VmmCachePrefetchPages3(pProcess, pObSet_vaAll, cbData, 0);
-    Ob_DECREF_NULL(&pObSet_vaAll);
-    // 2: Prepare/Allocate and set up initial entry
+    if(!cList) { return; }
+    // 1: Prefetch any addresses stored in optional address containers - all
+    //    lists in one batch.
     if(!(pObSet_vaAll = ObSet_New())) { goto fail; }
+    for(iList = 0; iList < cList; iList++) {
+        if((pObSet_vaTry1 = ObContainer_GetOb(pList[iList].pPrefetchAddressContainer))) {
+            ObSet_PushSet(pObSet_vaAll, pObSet_vaTry1);
+            Ob_DECREF_NULL(&pObSet_vaTry1);
+        }
+    }
+    VmmCachePrefetchPages3(pProcess, pObSet_vaAll, cbData, 0);
+    ObSet_Clear(pObSet_vaAll);
+    // 2: Prepare/Allocate and set up initial entries. Each list keeps its own
+    //    set of addresses (for its prefetch container and pre callback) which
+    //    are merged into the combined set pObSet_vaAll upon change. The map
+    //    pmObList keeps track of which list an entry belongs to (index + 1).
     if(!(pObSet_vaTry1 = ObSet_New())) { goto fail; }
     if(!(pObSet_vaTry2 = ObSet_New())) { goto fail; }
     if(!(pObSet_vaValid = ObSet_New())) { goto fail; }
-    if(!(pbData = LocalAlloc(0, cbData))) { goto fail; }
-    while(cvaDataStart) {
-        cvaDataStart--;
-        ObSet_Push(pObSet_vaAll, pvaDataStart[cvaDataStart]);
-        ObSet_Push(pObSet_vaTry1, pvaDataStart[cvaDataStart]);
+    if(!(pmObList = ObMap_New(0))) { goto fail; }
+    if(!(pbBuffer = LocalAlloc(0, cbData))) { goto fail; }
+    if(!(pcMerged = LocalAlloc(LMEM_ZEROINIT, cList * sizeof(DWORD)))) { goto fail; }
+    if(!(ppObSet_vaList = LocalAlloc(LMEM_ZEROINIT, cList * sizeof(POB_SET)))) { goto fail; }
+    for(iList = 0; iList < cList; iList++) {
+        if(!(ppObSet_vaList[iList] = ObSet_New())) { goto fail; }
+        for(i = pList[iList].cvaDataStart; i; i--) {
+            vaData = pList[iList].pvaDataStart[i - 1];
+            if(ObMap_Push(pmObList, vaData, (PVOID)(SIZE_T)(iList + 1))) {
+                ObSet_Push(ppObSet_vaList[iList], vaData);
+                ObSet_Push(pObSet_vaTry1, vaData);
+            }
+        }
     }
     // 3: Initial list walk
     fTry1 = TRUE;
     while(TRUE) {
+        Ob_DECREF_NULL(&pObMEM);
         if(fTry1) {
             vaData = ObSet_Pop(pObSet_vaTry1);
             if(!vaData && (0 == ObSet_Size(pObSet_vaTry2))) { break; }
             if(!vaData) {
+                for(iList = 0; iList < cList; iList++) {
+                    for(c = ObSet_Size(ppObSet_vaList[iList]); pcMerged[iList] < c; pcMerged[iList]++) {
+                        ObSet_Push(pObSet_vaAll, ObSet_Get(ppObSet_vaList[iList], pcMerged[iList]));
+                    }
+                }
                 VmmCachePrefetchPages3(pProcess, pObSet_vaAll, cbData, 0);
                 fTry1 = FALSE;
                 continue;
             }
-            VmmReadEx(pProcess, vaData, pbData, cbData, &cbReadData, VMM_FLAG_FORCECACHE_READ);
-            if(cbReadData != cbData) {
+            if(!(pbData = VmmWin_ListTraversePrefetch_Read(pProcess, vaData, cbData, pbBuffer, VMM_FLAG_FORCECACHE_READ, &pObMEM))) {
                 ObSet_Push(pObSet_vaTry2, vaData);
                 continue;
             }
@@ -3256,13 +3737,14 @@ VOID VmmWin_ListTraversePrefetch(
             vaData = ObSet_Pop(pObSet_vaTry2);
             if(!vaData && (0 == ObSet_Size(pObSet_vaTry1))) { break; }
             if(!vaData) { fTry1 = TRUE; continue; }
-            if(!VmmRead(pProcess, vaData, pbData, cbData)) { continue; }
+            if(!(pbData = VmmWin_ListTraversePrefetch_Read(pProcess, vaData, cbData, pbBuffer, 0, &pObMEM))) { continue; }
         }
+        iList = (DWORD)(SIZE_T)ObMap_GetByKey(pmObList, vaData) - 1;
         vaFLink = f32 ? *(PDWORD)(pbData + oListStart + 0) : *(PQWORD)(pbData + oListStart + 0);
         vaBLink = f32 ? *(PDWORD)(pbData + oListStart + 4) : *(PQWORD)(pbData + oListStart + 8);
         if(pfnCallback_Pre) {
             fValidEntry = FALSE; fValidFLink = FALSE; fValidBLink = FALSE;
-            pfnCallback_Pre(pProcess, ctx, vaData, pbData, cbData, vaFLink, vaBLink, pObSet_vaAll, &fValidEntry, &fValidFLink, &fValidBLink);
+            pfnCallback_Pre(pProcess, pList[iList].ctx, vaData, pbData, cbData, vaFLink, vaBLink, ppObSet_vaList[iList], &fValidEntry, &fValidFLink, &fValidBLink);
         } else {
             if(f32) {
                 fValidFLink = !(vaFLink & 0x03);
@@ -3278,35 +3760,94 @@ VOID VmmWin_ListTraversePrefetch(
         }
         vaFLink -= oListStart;
         vaBLink -= oListStart;
-        if(fValidFLink && !ObSet_Exists(pObSet_vaAll, vaFLink)) {
-            ObSet_Push(pObSet_vaAll, vaFLink);
+        if(fValidFLink && ObMap_Push(pmObList, vaFLink, (PVOID)(SIZE_T)(iList + 1))) {
+            ObSet_Push(ppObSet_vaList[iList], vaFLink);
             ObSet_Push(pObSet_vaTry1, vaFLink);
         }
-        if(fValidBLink && !ObSet_Exists(pObSet_vaAll, vaBLink)) {
-            ObSet_Push(pObSet_vaAll, vaBLink);
+        if(fValidBLink && ObMap_Push(pmObList, vaBLink, (PVOID)(SIZE_T)(iList + 1))) {
+            ObSet_Push(ppObSet_vaList[iList], vaBLink);
             ObSet_Push(pObSet_vaTry1, vaBLink);
         }
     }
     // 4: Prefetch additional gathered addresses into cache.
+    for(iList = 0; iList < cList; iList++) {
+        for(c = ObSet_Size(ppObSet_vaList[iList]); pcMerged[iList] < c; pcMerged[iList]++) {
+            ObSet_Push(pObSet_vaAll, ObSet_Get(ppObSet_vaList[iList], pcMerged[iList]));
+        }
+    }
     VmmCachePrefetchPages3(pProcess, pObSet_vaAll, cbData, 0);
     // 5: 2nd main list walk. Call into optional pfnCallback_Post to do the main
     //    processing of the list items.
     if(pfnCallback_Post) {
         while((vaData = ObSet_Pop(pObSet_vaValid))) {
-            if(VmmRead(pProcess, vaData, pbData, cbData)) {
-                pfnCallback_Post(pProcess, ctx, vaData, pbData, cbData);
+            if((pbData = VmmWin_ListTraversePrefetch_Read(pProcess, vaData, cbData, pbBuffer, 0, &pObMEM))) {
+                iList = (DWORD)(SIZE_T)ObMap_GetByKey(pmObList, vaData) - 1;
+                pfnCallback_Post(pProcess, pList[iList].ctx, vaData, pbData, cbData);
             }
+            Ob_DECREF_NULL(&pObMEM);
         }
     }
-    // 6: Store/Update the optional container with the newly prefetch addresses (if possible and desirable).
-    if(pPrefetchAddressContainer && ctxMain->dev.fVolatile && ctxVmm->ThreadProcCache.fEnabled) {
-        ObContainer_SetOb(pPrefetchAddressContainer, pObSet_vaAll);
+    // 6: Store/Update the optional containers with the newly prefetch addresses (if possible and desirable).
+    if(ctxMain->dev.fVolatile && ctxVmm->ThreadProcCache.fEnabled) {
+        for(iList = 0; iList < cList; iList++) {
+            if(pList[iList].pPrefetchAddressContainer) {
+                ObContainer_SetOb(pList[iList].pPrefetchAddressContainer, ppObSet_vaList[iList]);
+            }
+        }
     }
 fail:
     // 7: Cleanup
+    if(ppObSet_vaList) {
+        for(iList = 0; iList < cList; iList++) {
+            Ob_DECREF(ppObSet_vaList[iList]);
+        }
+        LocalFree(ppObSet_vaList);
+    }
     Ob_DECREF_NULL(&pObSet_vaAll);
     Ob_DECREF_NULL(&pObSet_vaTry1);
     Ob_DECREF_NULL(&pObSet_vaTry2);
     Ob_DECREF_NULL(&pObSet_vaValid);
-    LocalFree(pbData);
+    Ob_DECREF(pmObList);
+    Ob_DECREF(pObMEM);
+    LocalFree(pcMerged);
+    LocalFree(pbBuffer);
+}
+
+/*
+* Walk a windows linked list in an efficient way that minimize IO requests to
+* the the device. This is advantageous for latency reasons. The function return
+* a set of the addresses used - this may be used to prefetch pages in advance
+* if the list should be walked again at a later time.
+* The callback function must only return FALSE on severe errors when the list
+* should no longer be continued to be walked in the direction.
+* CALLER_DECREF: return
+* -- pProcess
+* -- f32
+* -- ctx = ctx to pass along to callback function (if any)
+* -- cvaDataStart
+* -- pvaDataStart
+* -- oListStart = offset (in bytes) to _LIST_ENTRY from vaDataStart
+* -- cbData
+* -- pfnCallback_Pre = optional callback function to gather additional addresses.
+* -- pfnCallback_Post = optional callback function called after all pages fetched into cache.
+* -- pContainerPrefetch = optional pointer to a PVMMOBCONTAINER containing a POB_VSET of prefetch addresses to use/update.
+*/
+VOID VmmWin_ListTraversePrefetch(
+    _In_ PVMM_PROCESS pProcess,
+    _In_ BOOL f32,
+    _In_opt_ PVOID ctx,
+    _In_ DWORD cvaDataStart,
+    _In_ PQWORD pvaDataStart,
+    _In_ DWORD oListStart,
+    _In_ DWORD cbData,
+    _In_opt_ VOID(*pfnCallback_Pre)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx, _In_ QWORD va, _In_ PBYTE pb, _In_ DWORD cb, _In_ QWORD vaFLink, _In_ QWORD vaBLink, _In_ POB_SET pVSetAddress, _Inout_ PBOOL pfValidEntry, _Inout_ PBOOL pfValidFLink, _Inout_ PBOOL pfValidBLink),
+    _In_opt_ VOID(*pfnCallback_Post)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx, _In_ QWORD va, _In_ PBYTE pb, _In_ DWORD cb),
+    _In_opt_ POB_CONTAINER pPrefetchAddressContainer)
+{
+    VMMWIN_LISTTRAVERSE_LIST List = { 0 };
+    List.ctx = ctx;
+    List.cvaDataStart = cvaDataStart;
+    List.pvaDataStart = pvaDataStart;
+    List.pPrefetchAddressContainer = pPrefetchAddressContainer;
+    VmmWin_ListTraversePrefetchMulti(pProcess, f32, 1, &List, oListStart, cbData, pfnCallback_Pre, pfnCallback_Post);
 }
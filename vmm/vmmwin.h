@@ -93,6 +93,28 @@ BOOL VmmWinHeap_Initialize(_In_ PVMM_PROCESS pProcess);
 */
 BOOL VmmWinThread_Initialize(_In_ PVMM_PROCESS pProcess, _In_ BOOL fNonBlocking);
 
+/*
+* Initialize the thread maps of multiple processes at once. The thread lists
+* of all processes are walked together which is a lot faster than one process
+* at a time on high latency devices. Processes with a thread map initializing
+* in another thread are skipped (non-blocking).
+* -- cProcess
+* -- ppProcess
+*/
+VOID VmmWinThread_InitializeMulti(_In_ DWORD cProcess, _In_reads_(cProcess) PVMM_PROCESS *ppProcess);
+
+/*
+* Initialize the thread maps of all active processes at once. Page tables are
+* spidered in parallel, all thread lists are walked together and the TEBs and
+* trap frames of all processes are read in one batch each. Processes already
+* initializing in another thread are skipped. The optional pfnContinue budget
+* callback is checked between the phases - once the combined traversal has
+* started it is completed so that no partial thread maps are published.
+* -- ctxContinue = optional context forwarded to pfnContinue.
+* -- pfnContinue = optional callback - return FALSE to stop.
+*/
+VOID VmmWinThread_InitializeAll(_In_opt_ PVOID ctxContinue, _In_opt_ BOOL(*pfnContinue)(_In_opt_ PVOID ctx));
+
 /*
 * Initialize Handles for a specific process. Extended information text may take
 * extra time to initialize.
@@ -103,6 +125,42 @@ BOOL VmmWinThread_Initialize(_In_ PVMM_PROCESS pProcess, _In_ BOOL fNonBlocking)
 _Success_(return)
 BOOL VmmWinHandle_Initialize(_In_ PVMM_PROCESS pProcess, _In_ BOOL fExtendedText);
 
+/*
+* Refresh the handle sub-system. Clears the object name cache shared between
+* the handle maps of all processes.
+*/
+VOID VmmWinHandle_Refresh();
+
+typedef struct tdVMMWIN_OB_OBJECTNAME {
+    OB ObHdr;
+    VMM_MAP_HANDLEENTRY e;          // resolved object information (handle specific fields unused)
+    DWORD cwszText;
+    WCHAR wszText[];
+} VMMWIN_OB_OBJECTNAME, *PVMMWIN_OB_OBJECTNAME;
+
+/*
+* Resolve kernel objects into the object name cache. The cache is shared by all
+* consumers and is cleared on total refresh - objects are only read from memory
+* once per refresh period. Already cached objects are skipped. Objects are
+* resolved in parallel through VmmWorkParallel - the caller only waits for
+* objects in progress on other threads and may be a worker thread itself.
+* -- pSystemProcess
+* -- psvaObject = set of object virtual addresses (address after _OBJECT_HEADER).
+*/
+VOID VmmWinHandle_ObjectNameResolve(_In_ PVMM_PROCESS pSystemProcess, _In_ POB_SET psvaObject);
+
+/*
+* Retrieve resolved object information - such as type index, pool tag and name
+* - from the object name cache. No memory is read; objects not yet resolved by
+* a previous call to VmmWinHandle_ObjectNameResolve (or by handle map text
+* initialization) will fail.
+* CALLER DECREF: return
+* -- vaObject
+* -- return
+*/
+_Success_(return != NULL)
+PVMMWIN_OB_OBJECTNAME VmmWinHandle_ObjectNameGet(_In_ QWORD vaObject);
+
 /*
 * Retrieve a pointer to a VMMWIN_OBJECT_TYPE if possible. Initialization of the
 * table takes place on first use. The table only exists in Win7+ and is is
@@ -155,6 +213,39 @@ VOID VmmWin_ListTraversePrefetch(
     _In_opt_ POB_CONTAINER pPrefetchAddressContainer
 );
 
+typedef struct tdVMMWIN_LISTTRAVERSE_LIST {
+    PVOID ctx;                                  // ctx to pass along to callback functions (if any)
+    DWORD cvaDataStart;
+    PQWORD pvaDataStart;
+    POB_CONTAINER pPrefetchAddressContainer;    // optional container of a POB_SET of prefetch addresses to use/update
+} VMMWIN_LISTTRAVERSE_LIST, *PVMMWIN_LISTTRAVERSE_LIST;
+
+/*
+* Walk many independent windows linked lists (of the same entry type) in the
+* same address space at the same time - such as the thread lists of all
+* processes. The walk is breadth-first over all lists with one batched device
+* read per step - the number of round trips is the depth of the deepest list
+* rather than the sum of the depths of all lists.
+* -- pProcess
+* -- f32 = TRUE if 32-bit, FALSE if 64-bit
+* -- cList
+* -- pList = the lists to walk - callbacks receive the ctx of the entry list.
+* -- oListStart = offset (in bytes) to _LIST_ENTRY from vaDataStart
+* -- cbData
+* -- pfnCallback_Pre = optional callback function to gather additional addresses.
+* -- pfnCallback_Post = optional callback function called after all pages fetched into cache.
+*/
+VOID VmmWin_ListTraversePrefetchMulti(
+    _In_ PVMM_PROCESS pProcess,
+    _In_ BOOL f32,
+    _In_ DWORD cList,
+    _In_reads_(cList) PVMMWIN_LISTTRAVERSE_LIST pList,
+    _In_ DWORD oListStart,
+    _In_ DWORD cbData,
+    _In_opt_ VOID(*pfnCallback_Pre)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx, _In_ QWORD va, _In_ PBYTE pb, _In_ DWORD cb, _In_ QWORD vaFLink, _In_ QWORD vaBLink, _In_ POB_SET pVSetAddress, _Inout_ PBOOL pfValidEntry, _Inout_ PBOOL pfValidFLink, _Inout_ PBOOL pfValidBLink),
+    _In_opt_ VOID(*pfnCallback_Post)(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx, _In_ QWORD va, _In_ PBYTE pb, _In_ DWORD cb)
+);
+
 /*
 * Retrieve user process parameters - such as the command line (if existing).
 * NB! PVMMWIN_USER_PROCESS_PARAMETERS points into pProcess and must not be
@@ -11,19 +11,27 @@
 #include "mm_pfn.h"
 #include "pe.h"
 #include "pdb.h"
+#include "statistics.h"
 #include "util.h"
+#include "vmmdevtrace.h"
 #include "vmmwin.h"
 #include "vmmwinobj.h"
 #include "vmmwinreg.h"
+#include "vmmwinprofile.h"
 
 /*
-* Try initialize threading - this is dependent on available PDB symbols.
+* Try initialize threading - this is dependent on available PDB symbols or on
+* a previously saved offset profile of the same kernel build.
 */
 VOID VmmWinInit_TryInitializeThreading()
 {
     BOOL f;
     DWORD cbEThread = 0;
     PVMM_OFFSET_ETHREAD pti = &ctxVmm->offset.ETHREAD;
+    if(VmmWinProfile_Get(VMMWINPROFILE_ID_ETHREAD, pti, sizeof(VMM_OFFSET_ETHREAD))) {
+        ctxVmm->fThreadMapEnabled = TRUE;
+        return;
+    }
     f = PDB_GetTypeChildOffsetShort(PDB_HANDLE_KERNEL, "_EPROCESS", L"ThreadListHead", &pti->oThreadListHeadKP) &&
         PDB_GetTypeChildOffsetShort(PDB_HANDLE_KERNEL, "_KTHREAD", L"StackBase", &pti->oStackBase) &&
         PDB_GetTypeChildOffsetShort(PDB_HANDLE_KERNEL, "_KTHREAD", L"StackLimit", &pti->oStackLimit) &&
@@ -50,6 +58,9 @@ VOID VmmWinInit_TryInitializeThreading()
     pti->oMax = (WORD)(cbEThread + 8);
     pti->oTebStackBase = ctxVmm->f32 ? 0x004 : 0x008;
     pti->oTebStackLimit = ctxVmm->f32 ? 0x008 : 0x010;
+    if(f) {
+        VmmWinProfile_Set(VMMWINPROFILE_ID_ETHREAD, pti, sizeof(VMM_OFFSET_ETHREAD));
+    }
     ctxVmm->fThreadMapEnabled = f;
 }
 
@@ -93,9 +104,12 @@ VOID VmmWinInit_TryInitializeKernelOptionalValues()
         PDB_GetTypeChildOffsetShort(PDB_HANDLE_KERNEL, "_TOKEN", L"UserAndGroups", &ctxVmm->offset.EPROCESS.opt.TOKEN_UserAndGroups);
         PDB_GetTypeChildOffsetShort(PDB_HANDLE_KERNEL, "_TOKEN", L"SessionId", &ctxVmm->offset.EPROCESS.opt.TOKEN_SessionId);
         PDB_GetTypeChildOffsetShort(PDB_HANDLE_KERNEL, "_TOKEN", L"TokenId", &ctxVmm->offset.EPROCESS.opt.TOKEN_TokenId);
+        if(ctxVmm->offset.EPROCESS.fValid && ctxVmm->offset.EPROCESS.opt.Token) {
+            VmmWinProfile_Set(VMMWINPROFILE_ID_EPROCESS, &ctxVmm->offset.EPROCESS, sizeof(VMM_OFFSET_EPROCESS));
+        }
     }
     // Optional _FILE_OBJECT related offsets
-    if(!ctxVmm->offset.FILE.fValid) {
+    if(!ctxVmm->offset.FILE.fValid && !VmmWinProfile_Get(VMMWINPROFILE_ID_FILE, &ctxVmm->offset.FILE, sizeof(VMM_OFFSET_FILE))) {
         pof = &ctxVmm->offset.FILE;
         // _FILE_OBJECT
         PDB_GetTypeSizeShort(PDB_HANDLE_KERNEL, "_FILE_OBJECT", &pof->_FILE_OBJECT.cb);
@@ -138,6 +152,9 @@ VOID VmmWinInit_TryInitializeKernelOptionalValues()
         PDB_GetTypeChildOffsetShort(PDB_HANDLE_KERNEL, "_SUBSECTION", L"StartingSector", &pof->_SUBSECTION.oStartingSector);
         PDB_GetTypeChildOffsetShort(PDB_HANDLE_KERNEL, "_SUBSECTION", L"SubsectionBase", &pof->_SUBSECTION.oSubsectionBase);
         pof->fValid = pof->_SUBSECTION.cb ? TRUE : FALSE;
+        if(pof->fValid) {
+            VmmWinProfile_Set(VMMWINPROFILE_ID_FILE, pof, sizeof(VMM_OFFSET_FILE));
+        }
     }
     // cpu count
     if(!ctxVmm->kernel.opt.cCPUs) {
@@ -457,13 +474,33 @@ DWORD VmmWinInit_FindNtosScan32(_In_ PVMM_PROCESS pSystemProcess)
     return vaNtosTry;      // on fail try return NtosTry derived from MZ + POOLCODE only.
 }
 
+/*
+* Verify that an address is the base of 'ntoskrnl.exe'.
+* -- pSystemProcess
+* -- vaBase
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinInit_FindNtosVerify(_In_ PVMM_PROCESS pSystemProcess, _In_ QWORD vaBase)
+{
+    BYTE pb[0x1000];
+    CHAR szModuleName[MAX_PATH] = { 0 };
+    PIMAGE_DOS_HEADER pDosHeader = (PIMAGE_DOS_HEADER)pb;
+    if(!vaBase || (vaBase & 0xfff) || !VmmRead(pSystemProcess, vaBase, pb, 0x1000)) { return FALSE; }
+    if(pDosHeader->e_magic != IMAGE_DOS_SIGNATURE) { return FALSE; }
+    if(pDosHeader->e_lfanew > 0x800) { return FALSE; }
+    if(((PIMAGE_NT_HEADERS)(pb + pDosHeader->e_lfanew))->Signature != IMAGE_NT_SIGNATURE) { return FALSE; }
+    return PE_GetModuleNameEx(pSystemProcess, vaBase, FALSE, pb, szModuleName, _countof(szModuleName), NULL) && !_stricmp(szModuleName, "ntoskrnl.exe");
+}
+
 /*
 * Scan for the 'ntoskrnl.exe' by using the DTB and memory model information
 * from the ctxVmm. Return the system process (if found).
 * CALLER DECREF: return
+* -- vaKernelBaseHint = optional unverified kernel base from a startup hint.
 * -- return = system process - NB! CALLER must DECREF!
 */
-PVMM_PROCESS VmmWinInit_FindNtosScan()
+PVMM_PROCESS VmmWinInit_FindNtosScan(_In_opt_ QWORD vaKernelBaseHint)
 {
     QWORD vaKernelBase = 0, cbKernelSize, vaKernelHint;
     PVMM_PROCESS pObSystemProcess = NULL;
@@ -474,7 +511,9 @@ PVMM_PROCESS VmmWinInit_FindNtosScan()
     // 2: Spider DTB to speed things up.
     VmmTlbSpider(pObSystemProcess);
     // 3: Find the base of 'ntoskrnl.exe'
-    if(VMM_MEMORYMODEL_X64 == ctxVmm->tpMemoryModel) {
+    if(vaKernelBaseHint && VmmWinInit_FindNtosVerify(pObSystemProcess, vaKernelBaseHint)) {
+        vaKernelBase = vaKernelBaseHint;
+    } else if(VMM_MEMORYMODEL_X64 == ctxVmm->tpMemoryModel) {
         LcGetOption(ctxMain->hLC, LC_OPT_MEMORYINFO_OS_KERNELBASE, &vaKernelBase);
         if(!vaKernelBase) {
             vaKernelHint = ctxVmm->kernel.vaEntry;
@@ -600,7 +639,7 @@ BOOL VmmWinInit_DTB_FindValidate()
     if(!(pb16M = LocalAlloc(LMEM_ZEROINIT, 0x01000000))) { return FALSE; }
     // 1: try locate DTB via X64 low stub in lower 1MB -
     //    avoiding normally reserved memory at a0000-fffff.
-    LcRead(ctxMain->hLC, 0x1000, 0x9f000, pb16M + 0x1000);
+    VmmDevTrace_Read(0x1000, 0x9f000, pb16M + 0x1000);
     if(VmmWinInit_DTB_FindValidate_X64_LowStub(pb16M)) {
         VmmInitializeMemoryModel(VMM_MEMORYMODEL_X64);
         paDTB = ctxVmm->kernel.paDTB;
@@ -610,7 +649,7 @@ BOOL VmmWinInit_DTB_FindValidate()
     if(!paDTB) {
         for(pa = 0; pa < 0x01000000; pa += 0x1000) {
             if(pa == 0x00100000) {
-                LcRead(ctxMain->hLC, 0x00100000, 0x00f00000, pb16M + 0x00100000);
+                VmmDevTrace_Read(0x00100000, 0x00f00000, pb16M + 0x00100000);
             }
             if(VmmWinInit_DTB_FindValidate_X64(pa, pb16M + pa)) {
                 VmmInitializeMemoryModel(VMM_MEMORYMODEL_X64);
@@ -655,7 +694,7 @@ BOOL VmmWinInit_DTB_Validate(QWORD paDTB)
 {
     BYTE pb[0x1000];
     paDTB = paDTB & ~0xfff;
-    if(!LcRead(ctxMain->hLC, paDTB, 0x1000, pb)) { return FALSE; }
+    if(!VmmDevTrace_Read(paDTB, 0x1000, pb)) { return FALSE; }
     if(VmmWinInit_DTB_FindValidate_X64(paDTB, pb)) {
         VmmInitializeMemoryModel(VMM_MEMORYMODEL_X64);
         ctxVmm->kernel.paDTB = paDTB;
@@ -783,14 +822,22 @@ VOID VmmWinInit_VersionNumber(_In_ PVMM_PROCESS pProcessSMSS)
 * Helper fucntion to VmmWinInit_TryInitialize. Tries to locate the EPROCESS of
 * the SYSTEM process and return it.
 * -- pSystemProcess
+* -- vaSystemEPROCESSHint = optional unverified EPROCESS from a startup hint.
 * -- return
 */
-QWORD VmmWinInit_FindSystemEPROCESS(_In_ PVMM_PROCESS pSystemProcess)
+QWORD VmmWinInit_FindSystemEPROCESS(_In_ PVMM_PROCESS pSystemProcess, _In_opt_ QWORD vaSystemEPROCESSHint)
 {
     BOOL f32 = ctxVmm->f32;
     IMAGE_SECTION_HEADER SectionHeader;
     BYTE pbALMOSTRO[0x80], pbSYSTEM[0x300];
     QWORD i, vaPsInitialSystemProcess, vaSystemEPROCESS;
+    // 0: try startup hint - verify DTB at fixed EPROCESS offset
+    if(vaSystemEPROCESSHint && VmmRead(pSystemProcess, vaSystemEPROCESSHint, pbSYSTEM, sizeof(pbSYSTEM))) {
+        if((f32 && ((*(PDWORD)(pbSYSTEM + 0x18) & ~0xf) == ctxVmm->kernel.paDTB)) || (!f32 && ((*(PQWORD)(pbSYSTEM + 0x28) & ~0xf) == ctxVmm->kernel.paDTB))) {
+            vaSystemEPROCESS = vaSystemEPROCESSHint;
+            goto success;
+        }
+    }
     // 1: try locate System EPROCESS by PsInitialSystemProcess exported symbol (works on all win versions)
     vaPsInitialSystemProcess = PE_GetProcAddress(pSystemProcess, ctxVmm->kernel.vaBase, "PsInitialSystemProcess");
     if(VmmRead(pSystemProcess, vaPsInitialSystemProcess, (PBYTE)& vaSystemEPROCESS, 8)) {
@@ -826,16 +873,184 @@ success:
 }
 
 /*
-* Async initialization of remaining actions in VmmWinInit_TryInitialize.
+* Queue the PDBs of commonly used non-kernel modules for async prefetch. This
+* is done to avoid blocking later callers on the symbol server download.
+* Win32k is only mapped in session space - use a csrss.exe clone with kernel
+* paging to read its debug information.
+*/
+VOID VmmWinInit_TryInitializePdbPrefetch()
+{
+    DWORD i;
+    LPWSTR wszKernelModules[] = { L"win32k.sys", L"tcpip.sys" };
+    PVMM_PROCESS pObProcess = NULL, pObProcessClone = NULL, pObSystemProcess = NULL;
+    PVMMOB_MAP_MODULE pObModuleMap = NULL;
+    PVMM_MAP_MODULEENTRY pe;
+    while((pObProcess = VmmProcessGetNext(pObProcess, 0))) {
+        if(pObProcess->fUserOnly && !strcmp(pObProcess->szName, "csrss.exe")) { break; }
+    }
+    if(!pObProcess || !(pObProcessClone = VmmProcessClone(pObProcess))) { goto fail; }
+    pObProcessClone->fUserOnly = FALSE;
+    // kernel modules
+    if((pObSystemProcess = VmmProcessGet(4)) && VmmMap_GetModule(pObSystemProcess, &pObModuleMap)) {
+        for(i = 0; i < sizeof(wszKernelModules) / sizeof(LPWSTR); i++) {
+            if((pe = VmmMap_GetModuleEntry(pObModuleMap, wszKernelModules[i]))) {
+                PDB_Prefetch(PDB_GetHandleFromModuleAddress(pObProcessClone, pe->vaBase));
+            }
+        }
+    }
+    Ob_DECREF_NULL(&pObModuleMap);
+    // user mode modules
+    if(VmmMap_GetModule(pObProcess, &pObModuleMap) && (pe = VmmMap_GetModuleEntry(pObModuleMap, L"ntdll.dll"))) {
+        PDB_Prefetch(PDB_GetHandleFromModuleAddress(pObProcess, pe->vaBase));
+    }
+fail:
+    Ob_DECREF(pObModuleMap);
+    Ob_DECREF(pObSystemProcess);
+    Ob_DECREF(pObProcessClone);
+    Ob_DECREF(pObProcess);
+}
+
+// ----------------------------------------------------------------------------
+// ASYNC POST-KERNEL INITIALIZATION STAGES:
+// The remaining initialization is expressed as a small dependency graph which
+// is driven by the async initialization thread. A stage is dispatched onto the
+// VmmWork pool as soon as all stages it depends upon have completed - allowing
+// independent stages to overlap their device reads.
+// Stages which build otherwise lazily initialized maps (registry, net, users,
+// physical memory map) are run to have them ready at first use.
+// ----------------------------------------------------------------------------
+
+#define VMMWININIT_STAGE_PDB                0
+#define VMMWININIT_STAGE_PAGING             1
+#define VMMWININIT_STAGE_THREADING          2
+#define VMMWININIT_STAGE_PDBPREFETCH        3
+#define VMMWININIT_STAGE_REGISTRY           4
+#define VMMWININIT_STAGE_NET                5
+#define VMMWININIT_STAGE_KERNELOPT          6
+#define VMMWININIT_STAGE_USER               7
+#define VMMWININIT_STAGE_PHYSMEM            8
+#define VMMWININIT_STAGE_MAX                8
+
+#define VMMWININIT_STAGE_BIT(i)             (1 << (i))
+
+typedef struct tdVMMWININIT_STAGE {
+    LPCSTR szName;
+    VOID(*pfn)();
+    DWORD fDependency;      // VMMWININIT_STAGE_BIT() of stages which must complete first
+} VMMWININIT_STAGE, *PVMMWININIT_STAGE;
+
+VOID VmmWinInit_Stage_Paging()
+{
+    MmWin_PagingInitialize(TRUE);   // initialize full paging (memcompression)
+}
+
+VOID VmmWinInit_Stage_Registry()
+{
+    VmmWinReg_HiveCount();
+}
+
+VOID VmmWinInit_Stage_Net()
+{
+    PVMMOB_MAP_NET pObNetMap = NULL;
+    VmmMap_GetNet(&pObNetMap);
+    Ob_DECREF(pObNetMap);
+}
+
+VOID VmmWinInit_Stage_User()
+{
+    PVMMOB_MAP_USER pObUserMap = NULL;
+    VmmMap_GetUser(&pObUserMap);
+    Ob_DECREF(pObUserMap);
+}
+
+VOID VmmWinInit_Stage_PhysMem()
+{
+    PVMMOB_MAP_PHYSMEM pObPhysMemMap = NULL;
+    VmmMap_GetPhysMem(&pObPhysMemMap);
+    Ob_DECREF(pObPhysMemMap);
+}
+
+// Stages reading kernel memory depend on full paging to not fail permanently
+// on compressed pages. The kernel optional values read the registry.
+// NB! entries must be in VMMWININIT_STAGE_* order.
+static VMMWININIT_STAGE g_VmmWinInit_Stages[VMMWININIT_STAGE_MAX + 1] = {
+    { "PDB kernel",               PDB_Initialize_WaitComplete,                    0 },
+    { "Paging full",              VmmWinInit_Stage_Paging,                        VMMWININIT_STAGE_BIT(VMMWININIT_STAGE_PDB) },
+    { "Threading",                VmmWinInit_TryInitializeThreading,              VMMWININIT_STAGE_BIT(VMMWININIT_STAGE_PDB) },
+    { "PDB prefetch queue",       VmmWinInit_TryInitializePdbPrefetch,            VMMWININIT_STAGE_BIT(VMMWININIT_STAGE_PAGING) },
+    { "Registry",                 VmmWinInit_Stage_Registry,                      VMMWININIT_STAGE_BIT(VMMWININIT_STAGE_PAGING) },
+    { "Network",                  VmmWinInit_Stage_Net,                           VMMWININIT_STAGE_BIT(VMMWININIT_STAGE_PAGING) },
+    { "Kernel optional values",   VmmWinInit_TryInitializeKernelOptionalValues,   VMMWININIT_STAGE_BIT(VMMWININIT_STAGE_PAGING) | VMMWININIT_STAGE_BIT(VMMWININIT_STAGE_REGISTRY) },
+    { "Users",                    VmmWinInit_Stage_User,                          VMMWININIT_STAGE_BIT(VMMWININIT_STAGE_REGISTRY) },
+    { "Physical memory map",      VmmWinInit_Stage_PhysMem,                       VMMWININIT_STAGE_BIT(VMMWININIT_STAGE_REGISTRY) },
+};
+
+/*
+* Worker function executing a single initialization stage.
+* -- pStage
+* -- return
+*/
+DWORD VmmWinInit_Stage_ThreadProc(_In_ PVMMWININIT_STAGE pStage)
+{
+    DWORD iPhase = Statistics_StartupPhaseBegin(pStage->szName);
+    pStage->pfn();
+    Statistics_StartupPhaseEnd(iPhase);
+    return 1;
+}
+
+/*
+* Async initialization of remaining actions in VmmWinInit_TryInitialize. Ready
+* stages are dispatched onto the VmmWork pool - if the pool is not accepting
+* work the stage is run inline, unless the pool is shutting down in which case
+* the stage (and all dependent stages) are skipped.
 * -- lpParameter
 * -- return
 */
 DWORD VmmWinInit_TryInitialize_Async(LPVOID lpParameter)
 {
-    PDB_Initialize_WaitComplete();
-    MmWin_PagingInitialize(TRUE);   // initialize full paging (memcompression)
-    VmmWinInit_TryInitializeThreading();
-    VmmWinInit_TryInitializeKernelOptionalValues();
+    BOOL fRescan;
+    DWORD i, iPhase, cWait, dwWait, fDispatched = 0, fCompleted = 0;
+    const DWORD fAll = VMMWININIT_STAGE_BIT(VMMWININIT_STAGE_MAX + 1) - 1;
+    HANDLE hEvent[VMMWININIT_STAGE_MAX + 1] = { 0 }, hWait[VMMWININIT_STAGE_MAX + 1];
+    DWORD iWait[VMMWININIT_STAGE_MAX + 1];
+    PVMMWININIT_STAGE pStage;
+    iPhase = Statistics_StartupPhaseBegin("WinInit async");
+    for(i = 0; i <= VMMWININIT_STAGE_MAX; i++) {
+        hEvent[i] = CreateEvent(NULL, TRUE, FALSE, NULL);
+    }
+    while(fCompleted != fAll) {
+        // 1: dispatch stages with all dependencies completed
+        do {
+            fRescan = FALSE;
+            for(i = 0; i <= VMMWININIT_STAGE_MAX; i++) {
+                pStage = g_VmmWinInit_Stages + i;
+                if(fDispatched & VMMWININIT_STAGE_BIT(i)) { continue; }
+                if((fCompleted & pStage->fDependency) != pStage->fDependency) { continue; }
+                fDispatched |= VMMWININIT_STAGE_BIT(i);
+                if(hEvent[i] && VmmWorkEx((LPTHREAD_START_ROUTINE)VmmWinInit_Stage_ThreadProc, pStage, hEvent[i], VMMWORK_PRIORITY_NORMAL)) { continue; }
+                if(ctxVmm->Work.fEnabled) {
+                    VmmWinInit_Stage_ThreadProc(pStage);
+                }
+                fCompleted |= VMMWININIT_STAGE_BIT(i);
+                fRescan = TRUE;     // completed inline - dependent stages may now be ready
+            }
+        } while(fRescan);
+        // 2: wait for any in-progress stage to complete
+        for(i = 0, cWait = 0; i <= VMMWININIT_STAGE_MAX; i++) {
+            if((fDispatched & ~fCompleted) & VMMWININIT_STAGE_BIT(i)) {
+                iWait[cWait] = i;
+                hWait[cWait++] = hEvent[i];
+            }
+        }
+        if(!cWait) { break; }
+        dwWait = WaitForMultipleObjects(cWait, hWait, FALSE, INFINITE) - WAIT_OBJECT_0;
+        if(dwWait >= cWait) { break; }
+        fCompleted |= VMMWININIT_STAGE_BIT(iWait[dwWait]);
+    }
+    for(i = 0; i <= VMMWININIT_STAGE_MAX; i++) {
+        if(hEvent[i]) { CloseHandle(hEvent[i]); }
+    }
+    Statistics_StartupPhaseEnd(iPhase);
     return 1;
 }
 
@@ -846,9 +1061,14 @@ DWORD VmmWinInit_TryInitialize_Async(LPVOID lpParameter)
 */
 BOOL VmmWinInit_TryInitialize(_In_opt_ QWORD paDTBOpt)
 {
+    BOOL fHint = FALSE;
+    DWORD iPhase;
+    QWORD qwHintFingerprint = 0;
     HANDLE hThreadInitializeAsync;
+    VMMWINPROFILE_HINT Hint = { 0 };
     PVMM_PROCESS pObSystemProcess = NULL, pObProcess = NULL;
     // Fetch Directory Base (DTB (PML4)) and initialize Memory Model.
+    iPhase = Statistics_StartupPhaseBegin("DTB / memory model");
     if(paDTBOpt) {
         if(!VmmWinInit_DTB_Validate(paDTBOpt)) {
             vmmprintfv("VmmWinInit_TryInitialize: Initialization Failed. Unable to verify user-supplied (0x%016llx) DTB. #1\n", paDTBOpt);
@@ -860,31 +1080,57 @@ BOOL VmmWinInit_TryInitialize(_In_opt_ QWORD paDTBOpt)
             goto fail;
         }
     } else if(!ctxVmm->kernel.paDTB) {
-        if(!VmmWinInit_DTB_FindValidate()) {
-            vmmprintfv("VmmWinInit_TryInitialize: Initialization Failed. Unable to locate valid DTB. #2\n");
-            goto fail;
+        // static memory image: try startup hint before scanning for the DTB.
+        fHint = VmmWinProfile_HintFingerprint(&qwHintFingerprint);
+        if(fHint && VmmWinProfile_HintGet(qwHintFingerprint, &Hint) && VmmWinInit_DTB_Validate(Hint.paDTB) && (ctxVmm->tpMemoryModel == Hint.tpMemoryModel)) {
+            vmmprintfvv_fn("INFO: DTB  located from startup hint.\n");
+        } else {
+            ZeroMemory(&Hint, sizeof(VMMWINPROFILE_HINT));
+            if(!VmmWinInit_DTB_FindValidate()) {
+                vmmprintfv("VmmWinInit_TryInitialize: Initialization Failed. Unable to locate valid DTB. #2\n");
+                goto fail;
+            }
         }
     }
+    Statistics_StartupPhaseEnd(iPhase);
     vmmprintfvv_fn("INFO: DTB  located at: %016llx. MemoryModel: %s\n", ctxVmm->kernel.paDTB, VMM_MEMORYMODEL_TOSTRING[ctxVmm->tpMemoryModel]);
     // Fetch 'ntoskrnl.exe' base address
-    if(!(pObSystemProcess = VmmWinInit_FindNtosScan())) {
+    iPhase = Statistics_StartupPhaseBegin("NTOS locate");
+    if(!(pObSystemProcess = VmmWinInit_FindNtosScan(Hint.vaKernelBase))) {
         vmmprintfv("VmmWinInit_TryInitialize: Initialization Failed. Unable to locate ntoskrnl.exe. #3\n");
         goto fail;
     }
+    Statistics_StartupPhaseEnd(iPhase);
     vmmprintfvv_fn("INFO: NTOS located at: %016llx.\n", ctxVmm->kernel.vaBase);
+    // Load offset profile (if any) of the kernel build
+    iPhase = Statistics_StartupPhaseBegin("Offset profile");
+    VmmWinProfile_Initialize(pObSystemProcess);
+    Statistics_StartupPhaseEnd(iPhase);
     // Initialize Paging (Limited Mode)
     MmWin_PagingInitialize(FALSE);
     // Locate System EPROCESS
-    pObSystemProcess->win.EPROCESS.va = VmmWinInit_FindSystemEPROCESS(pObSystemProcess);
+    iPhase = Statistics_StartupPhaseBegin("EPROCESS locate");
+    pObSystemProcess->win.EPROCESS.va = VmmWinInit_FindSystemEPROCESS(pObSystemProcess, Hint.vaSystemEPROCESS);
     if(!pObSystemProcess->win.EPROCESS.va) {
         vmmprintfv_fn("Initialization Failed. Unable to locate EPROCESS. #4\n");
         goto fail;
     }
+    Statistics_StartupPhaseEnd(iPhase);
     // Enumerate processes
+    iPhase = Statistics_StartupPhaseBegin("Process enumerate");
     if(!VmmWinProcess_Enumerate(pObSystemProcess, TRUE)) {
         vmmprintfv("VmmWinInit: Initialization Failed. Unable to walk EPROCESS. #5\n");
         goto fail;
     }
+    Statistics_StartupPhaseEnd(iPhase);
+    // Save startup hint of static memory image (if changed)
+    if(fHint) {
+        Hint.tpMemoryModel = ctxVmm->tpMemoryModel;
+        Hint.paDTB = ctxVmm->kernel.paDTB;
+        Hint.vaKernelBase = ctxVmm->kernel.vaBase;
+        Hint.vaSystemEPROCESS = pObSystemProcess->win.EPROCESS.va;
+        VmmWinProfile_HintSet(qwHintFingerprint, &Hint);
+    }
     ctxVmm->tpSystem = (VMM_MEMORYMODEL_X64 == ctxVmm->tpMemoryModel) ? VMM_SYSTEM_WINDOWS_X64 : VMM_SYSTEM_WINDOWS_X86;
     // Retrieve operating system version information from 'smss.exe' process
     // Optionally retrieve PID of Registry process
@@ -900,7 +1146,9 @@ BOOL VmmWinInit_TryInitialize(_In_opt_ QWORD paDTBOpt)
     }
     // Initialization functionality:
     PDB_Initialize(NULL, TRUE);                                 // Async init of PDB subsystem.
+    iPhase = Statistics_StartupPhaseBegin("PsLoadedModuleList / KDBG");
     VmmWinInit_FindPsLoadedModuleListKDBG(pObSystemProcess);    // Find PsLoadedModuleList and possibly KDBG.
+    Statistics_StartupPhaseEnd(iPhase);
     VmmWinObj_Initialize();                                     // Windows Objects Manager.
     VmmWinReg_Initialize();                                     // Registry.
     // Async Initialization functionality:
@@ -921,6 +1169,7 @@ BOOL VmmWinInit_TryInitialize(_In_opt_ QWORD paDTBOpt)
         ctxVmm->kernel.dwVersionBuild);
     return TRUE;
 fail:
+    Statistics_StartupPhaseEnd(iPhase);
     VmmInitializeMemoryModel(VMM_MEMORYMODEL_NA); // clean memory model
     ZeroMemory(&ctxVmm->kernel, sizeof(VMM_KERNELINFO));
     Ob_DECREF(pObSystemProcess);
@@ -7,6 +7,7 @@
 #include <ws2tcpip.h>
 #include "vmmwinnet.h"
 #include "pe.h"
+#include "statistics.h"
 #include "util.h"
 
 #define AF_INET6        23      // Ws2tcpip.h
@@ -113,7 +114,7 @@ fail:
 */
 VOID VmmWinTcpIp_GetPartitionTable64(_In_ PVMM_PROCESS pSystemProcess)
 {
-    DWORD cbData;
+    DWORD cbData, iPhase;
     PBYTE pbData = NULL;
     PVMMOB_MAP_MODULE pObModuleMap = NULL;
     PVMM_MAP_MODULEENTRY pModuleMapEntry;
@@ -124,6 +125,7 @@ VOID VmmWinTcpIp_GetPartitionTable64(_In_ PVMM_PROCESS pSystemProcess)
         LeaveCriticalSection(&ctxVmm->TcpIp.LockUpdate);
         return;
     }
+    iPhase = Statistics_StartupPhaseBegin("Network TcpIp locate");
     // 1: fetch tcpip.sys .data section - it contains a pointer to tcpip!PartitionTable [TcPt]
     if(!(VmmMap_GetModule(pSystemProcess, &pObModuleMap) && (pModuleMapEntry = VmmMap_GetModuleEntry(pObModuleMap, L"tcpip.sys")))) {
         vmmprintfv_fn("CANNOT LOCATE tcpip.sys.\n")
@@ -143,6 +145,7 @@ VOID VmmWinTcpIp_GetPartitionTable64(_In_ PVMM_PROCESS pSystemProcess)
         ctxVmm->TcpIp.vaPartitionTable = VmmWinTcpIp_GetPartitionTable64_PoolHdr(pSystemProcess, pbData, cbData);
     }
 fail:
+    Statistics_StartupPhaseEnd(iPhase);
     LeaveCriticalSection(&ctxVmm->TcpIp.LockUpdate);
     ctxVmm->TcpIp.fInitialized = TRUE;
     Ob_DECREF(pObModuleMap);
@@ -154,8 +157,20 @@ fail:
 
 // ----------------------------------------------------------------------------
 // TCP ENDPOINT FUNCTIONALITY BELOW:
+// The endpoints of the previous build are kept together with the raw TcpE
+// struct they were parsed from. An endpoint with an unchanged TcpE struct is
+// carried over to the next build as-is - only new and changed endpoints have
+// their address family / address objects read.
 // ----------------------------------------------------------------------------
 
+#define VMMWINTCPIP_FUZZ_MAX            0x10
+#define VMMWINTCPIP_TCPE_MAX            0x00040000
+
+typedef struct tdVMMWIN_TCPIP_TCPE_PREVIOUS {
+    VMMWIN_TCPIP_ENTRY e;
+    BYTE pb[];                      // raw TcpE struct (OTcpE._Size bytes)
+} VMMWIN_TCPIP_TCPE_PREVIOUS, *PVMMWIN_TCPIP_TCPE_PREVIOUS;
+
 /*
 * qsort compare function for sorting the TCP connection list
 */
@@ -174,12 +189,12 @@ int VmmWinTcpIp_TcpE_CmpSort(PVMMWIN_TCPIP_ENTRY a, PVMMWIN_TCPIP_ENTRY b)
 }
 
 /*
-* Fuzz offsets in TcpE if required. Upon a successful fuzz values will be stored
+* Fuzz offsets in a single TcpE. Upon a successful fuzz values will be stored
 * in the ctxVmm global context.
 * -- pSystemProcess
 * -- vaTcpE - virtual address of a TCP ENDPOINT entry (TcpE).
 */
-VOID VmmWinTcpIp_TcpE_Fuzz(_In_ PVMM_PROCESS pSystemProcess, _In_ QWORD vaTcpE)
+VOID VmmWinTcpIp_TcpE_FuzzEntry(_In_ PVMM_PROCESS pSystemProcess, _In_ QWORD vaTcpE)
 {
     BOOL f;
     QWORD o, va;
@@ -187,9 +202,7 @@ VOID VmmWinTcpIp_TcpE_Fuzz(_In_ PVMM_PROCESS pSystemProcess, _In_ QWORD vaTcpE)
     BYTE pb[0x300];
     PVMM_PROCESS pObProcess = NULL;
     PVMMWIN_TCPIP_OFFSET_TcpE po = &ctxVmm->TcpIp.OTcpE;
-    if(po->_fValid || po->_fProcessedTry) { goto fail; }
-    po->_fProcessedTry = TRUE;
-    if(!VmmRead(pSystemProcess, vaTcpE, pb, 0x300)) { goto fail; }
+    if(!VmmRead2(pSystemProcess, vaTcpE, pb, 0x300, VMM_FLAG_FORCECACHE_READ)) { goto fail; }
     // Search for EPROCESS value in TcpE struct
     while((pObProcess = VmmProcessGetNext(pObProcess, VMM_FLAG_PROCESS_SHOW_TERMINATED))) {
         for(o = 0x80; o < 0x300; o += 8) {
@@ -236,6 +249,30 @@ fail:
     Ob_DECREF(pObProcess);
 }
 
+/*
+* Fuzz offsets in TcpE if required. The offsets only depend on the kernel build
+* and are fuzzed once - from the first of up to VMMWINTCPIP_FUZZ_MAX endpoints
+* which are prefetched in one batch - and then kept in the ctxVmm context.
+* -- pSystemProcess
+* -- pSet_TcpE - set of TCP ENDPOINT entry (TcpE) addresses.
+*/
+VOID VmmWinTcpIp_TcpE_Fuzz(_In_ PVMM_PROCESS pSystemProcess, _In_ POB_SET pSet_TcpE)
+{
+    DWORD i, c;
+    QWORD pva[VMMWINTCPIP_FUZZ_MAX];
+    PVMMWIN_TCPIP_OFFSET_TcpE po = &ctxVmm->TcpIp.OTcpE;
+    if(po->_fValid || po->_fProcessedTry) { return; }
+    po->_fProcessedTry = TRUE;
+    c = min(VMMWINTCPIP_FUZZ_MAX, ObSet_Size(pSet_TcpE));
+    for(i = 0; i < c; i++) {
+        pva[i] = ObSet_Get(pSet_TcpE, i);
+    }
+    VmmCachePrefetchPages4(pSystemProcess, c, pva, 0x300, 0);
+    for(i = 0; (i < c) && !po->_fValid; i++) {
+        VmmWinTcpIp_TcpE_FuzzEntry(pSystemProcess, pva[i]);
+    }
+}
+
 /*
 * Retrieve the virtual addresses of the TCP ENDPOINT structs in memory (TcpE).
 * The virtual addresses will be put into the pObSet_TcpEndpoints set upon success.
@@ -251,12 +288,15 @@ BOOL VmmWinTcpIp_TcpE_GetAddressEPs(_In_ PVMM_PROCESS pSystemProcess, _Inout_ PO
     DWORD i, o, oStartHT, oListPT = 0, cbRead, cbTcpHT;
     BYTE pb[0x810] = { 0 }, pbTcHT[0x400];
     PBYTE pbPartitionTable;
-    POB_SET pObTcHT = NULL, pObHTab = NULL, pObTcpE = NULL;
+    POB_SET pObTcHT = NULL, pObHTab = NULL, pObTcpE = NULL, pObBucket = NULL, pObLink = NULL, pObLinkNext = NULL, pObSwap;
     PRTL_DYNAMIC_HASH_TABLE pTcpHT;
     if(!(pbPartitionTable = LocalAlloc(LMEM_ZEROINIT, 0x4000))) { goto fail; }
     if(!(pObTcHT = ObSet_New())) { goto fail; }
     if(!(pObHTab = ObSet_New())) { goto fail; }
     if(!(pObTcpE = ObSet_New())) { goto fail; }
+    if(!(pObBucket = ObSet_New())) { goto fail; }
+    if(!(pObLink = ObSet_New())) { goto fail; }
+    if(!(pObLinkNext = ObSet_New())) { goto fail; }
     // 1: load partition table
     if(!ctxVmm->TcpIp.fInitialized) {
         VmmWinTcpIp_GetPartitionTable64(pSystemProcess);
@@ -311,13 +351,34 @@ BOOL VmmWinTcpIp_TcpE_GetAddressEPs(_In_ PVMM_PROCESS pSystemProcess, _Inout_ PO
             continue;
         }
         for(o = 0x10; o < 0x800; o += 0x10) {
+            ObSet_Push(pObBucket, va + o);
             va2 = *(PQWORD)(pb + o);
             if((va + o == va2) || !VMM_KADDR64_16(va2)) { continue; }
             ObSet_Push(pObTcpE, va2 - 0x50);
+            ObSet_Push(pObLink, va2);
             va3 = *(PQWORD)(pb + o + 8);
             if((va + o == va3) || (va2 == va3) || !VMM_KADDR64_16(va2)) { continue; }
             ObSet_Push(pObTcpE, va3 - 0x50);
+            ObSet_Push(pObLink, va3);
+        }
+    }
+    // 4.1: walk the bucket chains beyond their first and last entries. all
+    //      chains are walked together - one batched read per chain depth.
+    while(ObSet_Size(pObLink) && (ObSet_Size(pObTcpE) < VMMWINTCPIP_TCPE_MAX)) {
+        VmmCachePrefetchPages3(pSystemProcess, pObLink, 0x10, 0);
+        while((va = ObSet_Pop(pObLink))) {
+            VmmReadEx(pSystemProcess, va, pb, 0x10, &cbRead, VMM_FLAG_FORCECACHE_READ);
+            if(0x10 != cbRead) { continue; }
+            for(i = 0; i < 2; i++) {
+                va2 = *(PQWORD)(pb + i * 8);
+                if(!VMM_KADDR64_16(va2) || ObSet_Exists(pObBucket, va2) || ObSet_Exists(pObTcpE, va2 - 0x50)) { continue; }
+                ObSet_Push(pObTcpE, va2 - 0x50);
+                ObSet_Push(pObLinkNext, va2);
+            }
         }
+        pObSwap = pObLink;
+        pObLink = pObLinkNext;
+        pObLinkNext = pObSwap;
     }
     if(0 == ObSet_Size(pObTcpE)) { goto fail; }
     VmmCachePrefetchPages3(pSystemProcess, pObTcpE, 0x10, 0);
@@ -337,6 +398,9 @@ fail:
     Ob_DECREF(pObTcHT);
     Ob_DECREF(pObHTab);
     Ob_DECREF(pObTcpE);
+    Ob_DECREF(pObBucket);
+    Ob_DECREF(pObLink);
+    Ob_DECREF(pObLinkNext);
     LocalFree(pbPartitionTable);
     return fResult;
 }
@@ -356,10 +420,12 @@ BOOL VmmWinTcpIp_TcpE_Enumerate(_In_ PVMM_PROCESS pSystemProcess, _In_ POB_SET p
 {
     BOOL f;
     QWORD va;
-    DWORD cbRead, c = 0, i, j;
+    DWORD cbRead, c = 0, cReuse = 0, i, j;
     BYTE pb[0x400] = { 0 };
     PVMMWIN_TCPIP_ENTRY pE;
+    PVMMWIN_TCPIP_TCPE_PREVIOUS pPrev, pNext;
     POB_SET pObPrefetch = NULL;
+    POB_MAP pmObPrev = NULL, pmObNext = NULL;
     PVMM_PROCESS pObProcess = NULL;
     PVMMWIN_TCPIP_OFFSET_TcpE po = &ctxVmm->TcpIp.OTcpE;
     LPCSTR szSTATES[] = {
@@ -376,12 +442,27 @@ BOOL VmmWinTcpIp_TcpE_Enumerate(_In_ PVMM_PROCESS pSystemProcess, _In_ POB_SET p
         "TIME_WAIT"
     };
     if(cTcpEs < ObSet_Size(pSet_TcpE)) { goto fail; }
+    if(po->_Size > sizeof(pb)) { goto fail; }
     if(!(pObPrefetch = ObSet_New())) { goto fail; }
+    if(!(pmObNext = ObMap_New(OB_MAP_FLAGS_OBJECT_LOCALFREE))) { goto fail; }
+    pmObPrev = ObContainer_GetOb(ctxVmm->TcpIp.pObCTcpE);
     VmmCachePrefetchPages3(pSystemProcess, pSet_TcpE, po->_Size, 0);
     // 1: retrieve general info from main struct (TcpE)
+    //    new entries are put at the start of pTcpEs and entries carried over
+    //    from the previous build are put at the end of pTcpEs.
     while((va = ObSet_Pop(pSet_TcpE))) {
         VmmReadEx(pSystemProcess, va, pb, po->_Size, &cbRead, VMM_FLAG_FORCECACHE_READ);
         if(po->_Size != cbRead) { continue; }
+        // 1.1: carry over resolved entry from previous build if TcpE is unchanged
+        if((pPrev = ObMap_GetByKey(pmObPrev, va)) && pPrev->e.Src.fValid && pPrev->e.Dst.fValid && !memcmp(pPrev->pb, pb, po->_Size)) {
+            cReuse++;
+            memcpy(pTcpEs + cTcpEs - cReuse, &pPrev->e, sizeof(VMMWIN_TCPIP_ENTRY));
+            if((pNext = LocalAlloc(0, sizeof(VMMWIN_TCPIP_TCPE_PREVIOUS) + po->_Size))) {
+                memcpy(pNext, pPrev, sizeof(VMMWIN_TCPIP_TCPE_PREVIOUS) + po->_Size);
+                if(!ObMap_Push(pmObNext, va, pNext)) { LocalFree(pNext); }
+            }
+            continue;
+        }
         pE = pTcpEs + c;
         pE->Dst.wPort = _byteswap_ushort(*(PWORD)(pb + po->PortDst));
         pE->Src.wPort = _byteswap_ushort(*(PWORD)(pb + po->PortSrc));
@@ -397,6 +478,10 @@ BOOL VmmWinTcpIp_TcpE_Enumerate(_In_ PVMM_PROCESS pSystemProcess, _In_ POB_SET p
         if(!VMM_KADDR64_8(pE->vaEPROCESS) || !VMM_KADDR64_8(pE->_Reserved_vaINET_AF) || !VMM_KADDR64_8(pE->_Reserved_vaINET_Addr)) { continue; }
         ObSet_Push(pObPrefetch, pE->_Reserved_vaINET_AF - 0x10);
         ObSet_Push(pObPrefetch, pE->_Reserved_vaINET_Addr);
+        if((pNext = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMWIN_TCPIP_TCPE_PREVIOUS) + po->_Size))) {
+            memcpy(pNext->pb, pb, po->_Size);
+            if(!ObMap_Push(pmObNext, va, pNext)) { LocalFree(pNext); }
+        }
         c++;
     }
     // 2: retrieve address family and ptr to address
@@ -452,8 +537,22 @@ BOOL VmmWinTcpIp_TcpE_Enumerate(_In_ PVMM_PROCESS pSystemProcess, _In_ POB_SET p
                 }
             }
         }
+        // 3.3 save resolved entry for carry over to next build
+        if(pE->Src.fValid && pE->Dst.fValid && (pNext = ObMap_GetByKey(pmObNext, pE->vaTcpE))) {
+            memcpy(&pNext->e, pE, sizeof(VMMWIN_TCPIP_ENTRY));
+        }
         pE->_Reserved_fPidSearch = FALSE;
     }
+    // 3.4: append entries carried over from the previous build
+    if(cReuse) {
+        memmove(pTcpEs + c, pTcpEs + cTcpEs - cReuse, cReuse * sizeof(VMMWIN_TCPIP_ENTRY));
+        for(i = c; i < c + cReuse; i++) {
+            pTcpEs[i]._Reserved_fPidSearch = FALSE;
+        }
+        c += cReuse;
+        vmmprintfvv_fn("TcpE carried over from previous build: %i/%i\n", cReuse, c);
+    }
+    ObContainer_SetOb(ctxVmm->TcpIp.pObCTcpE, pmObNext);
     // 4: set process pids and sort list
     for(i = 0; i < c; i++) {
         pE = pTcpEs + i;
@@ -474,9 +573,13 @@ BOOL VmmWinTcpIp_TcpE_Enumerate(_In_ PVMM_PROCESS pSystemProcess, _In_ POB_SET p
     }
     qsort(pTcpEs, c, sizeof(VMMWIN_TCPIP_ENTRY), (int(*)(const void*, const void*))VmmWinTcpIp_TcpE_CmpSort);
     *pcTcpEs = c;
+    Ob_DECREF(pmObPrev);
+    Ob_DECREF(pmObNext);
     return TRUE;
 fail:
     Ob_DECREF(pObPrefetch);
+    Ob_DECREF(pmObPrev);
+    Ob_DECREF(pmObNext);
     return FALSE;
 }
 
@@ -498,7 +601,7 @@ BOOL VmmWinTcpIp_TcpE_Get(_Out_ PPVMMWIN_TCPIP_ENTRY ppTcpE, _Out_ PDWORD pcTcpE
     if(!(pObTcpE = ObSet_New())) { goto fail; }
     if(!(pObSystemProcess = VmmProcessGet(4))) { goto fail; }
     if(!VmmWinTcpIp_TcpE_GetAddressEPs(pObSystemProcess, pObTcpE)) { goto fail; }
-    VmmWinTcpIp_TcpE_Fuzz(pObSystemProcess, ObSet_Get(pObTcpE, 0));
+    VmmWinTcpIp_TcpE_Fuzz(pObSystemProcess, pObTcpE);
     if(!ctxVmm->TcpIp.OTcpE._fValid) { goto fail; }
     cTcpEs = ObSet_Size(pObTcpE);
     if(!(pTcpEs = LocalAlloc(LMEM_ZEROINIT, cTcpEs * sizeof(VMMWIN_TCPIP_ENTRY)))) { goto fail; }
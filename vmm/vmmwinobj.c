@@ -5,6 +5,7 @@
 //
 
 #include "vmmwinobj.h"
+#include "vmmwin.h"
 #include "vmmwindef.h"
 #include "vmm.h"
 #include "util.h"
@@ -100,8 +101,39 @@ POB_VMMWINOBJ_OBJECT VmmWinObj_Get(_In_ QWORD va)
 //       _SEGMENT
 // ----------------------------------------------------------------------------
 
+#define VMMWINOBJ_FILE_CACHE_PTE_MAX    0x01000000      // max size of prototype PTE cache per subsection (bytes)
+#define VMMWINOBJ_FILE_CACHE_VACB_MAX   0x00010000      // max # of VACBs in page source cache per file
+
+/*
+* Retrieve the allocation size of the prototype PTE cache of a subsection - the
+* PTEs followed by one valid flag per page of PTEs.
+* -- pss
+* -- return
+*/
+QWORD VmmWinObjFile_CacheSizePte(_In_ PVMMWINOBJ_FILE_SUBSECTION pss)
+{
+    QWORD cbPte = (ctxVmm->tpMemoryModel == VMMDLL_MEMORYMODEL_X86) ? 4 : 8;
+    QWORD cb = pss->dwPtesInSubsection * cbPte;
+    return cb + ((cb + 0xfff) >> 12);
+}
+
 VOID VmmWinObj_CallbackCleanup_ObObjFile(POB_VMMWINOBJ_FILE pOb)
 {
+    DWORD i;
+    LONG64 cbCache = 0;
+    for(i = 0; i < pOb->cSUBSECTION; i++) {
+        if(pOb->pSUBSECTION[i].pbPte) {
+            cbCache += (LONG64)VmmWinObjFile_CacheSizePte(pOb->pSUBSECTION + i);
+            LocalFree(pOb->pSUBSECTION[i].pbPte);
+        }
+    }
+    if(pOb->_Cache.pvaVacb) {
+        cbCache += pOb->_Cache.cVacb * sizeof(QWORD);
+        LocalFree(pOb->_Cache.pvaVacb);
+    }
+    if(cbCache) {
+        Ob_AccountingCharge(OB_TAG_OBJ_FILE, -cbCache);
+    }
     LocalFree(pOb->wszPath);
     LocalFree(pOb->pSUBSECTION);
 }
@@ -161,7 +193,7 @@ BOOL VmmWinObjFile_Initialize_ControlArea_Subsection(_In_ PVMM_PROCESS pSystemPr
     BOOL f = TRUE, fSoft;
     BYTE pb[0x80] = { 0 };
     DWORD i = 0, dwStartingSectorNext = 0;
-    VMMWINOBJ_FILE_SUBSECTION ps[VMMWINOBJ_FILE_OBJECT_SUBSECTION_MAX];
+    VMMWINOBJ_FILE_SUBSECTION ps[VMMWINOBJ_FILE_OBJECT_SUBSECTION_MAX] = { 0 };
     PVMM_OFFSET_FILE po = &ctxVmm->offset.FILE;
     // 1: Fetch # _SUBSECTION
     va = pf->vaControlArea + po->_CONTROL_AREA.cb;
@@ -279,6 +311,7 @@ VOID VmmWinObjFile_Initialize_FileObjects(_In_ PVMM_PROCESS pSystemProcess, _Ino
     BYTE pb[0x100];
     POB_MAP pmObFiles = NULL;
     POB_VMMWINOBJ_FILE peObFile = NULL;
+    PVMMWIN_OB_OBJECTNAME pObName = NULL;
     WCHAR wszNameBuffer[MAX_PATH + 1] = { 0 };
     PVMMWINOBJ_CONTEXT ctx = ctxVmm->pObjects;
     PVMM_OFFSET_FILE po = &ctxVmm->offset.FILE;
@@ -299,6 +332,13 @@ VOID VmmWinObjFile_Initialize_FileObjects(_In_ PVMM_PROCESS pSystemProcess, _Ino
             peObFile->vaSectionObjectPointers = vaSectionObjectPointers;
             peObFile->_Reserved1 = cbPath;
             peObFile->_Reserved2 = vaFileNameBuffer;
+            // file name may already be resolved by the object name cache (from handles)
+            pObName = VmmWinHandle_ObjectNameGet(va);
+            if(pObName && pObName->cwszText && ((pObName->e.dwPoolTag & 0x00ffffff) == 'liF') && (peObFile->wszPath = LocalAlloc(0, (pObName->cwszText + 1ULL) << 1))) {
+                memcpy(peObFile->wszPath, pObName->wszText, (pObName->cwszText + 1ULL) << 1);
+                peObFile->_Reserved2 = 0;
+            }
+            Ob_DECREF_NULL(&pObName);
             ObMap_Push(pmObFiles, va, peObFile);
             Ob_DECREF_NULL(&peObFile);
         } else {
@@ -310,13 +350,15 @@ VOID VmmWinObjFile_Initialize_FileObjects(_In_ PVMM_PROCESS pSystemProcess, _Ino
     // 4: fill _UNICODE_STRING and _SECTION_OBJECT_POINTERS
     while((peObFile = ObMap_GetNext(pmObFiles, peObFile))) {
         // _UNICODE_STRING
-        cbPath = peObFile->_Reserved1;
-        vaFileNameBuffer = peObFile->_Reserved2;
-        if(cbPath > MAX_PATH * 2) {
-            vaFileNameBuffer += cbPath - MAX_PATH * 2;
-            cbPath = MAX_PATH * 2;
+        if(!peObFile->wszPath) {
+            cbPath = peObFile->_Reserved1;
+            vaFileNameBuffer = peObFile->_Reserved2;
+            if(cbPath > MAX_PATH * 2) {
+                vaFileNameBuffer += cbPath - MAX_PATH * 2;
+                cbPath = MAX_PATH * 2;
+            }
+            if(!VmmReadAlloc(pSystemProcess, vaFileNameBuffer, (PBYTE*)&peObFile->wszPath, cbPath, VMM_FLAG_FORCECACHE_READ)) { continue; }
         }
-        if(!VmmReadAlloc(pSystemProcess, vaFileNameBuffer, (PBYTE*)&peObFile->wszPath, cbPath, VMM_FLAG_FORCECACHE_READ)) { continue; }
         peObFile->wszName = Util_PathSplitLastW(peObFile->wszPath);
         peObFile->dwNameHash = Util_HashStringUpperW(peObFile->wszName);
         // _SECTION_OBJECT_POINTERS
@@ -479,37 +521,137 @@ QWORD VmmWinObjFile_ReadSubsectionAndSharedCache_GetPteSubsection(_In_ PVMM_PROC
 }
 
 /*
-* Helper function to retrieve the virtual address of a _SHARED_CACHE_MAP entry.
-* Retrieval is done in a performance intensive (non-cached) way, but it's
-* assumed this function won't be heavily called.
+* Resolve the page sources of the file pages [iPteBase, iPteBase + cPte) into
+* the page source cache of the file object. VACBs of the _SHARED_CACHE_MAP and
+* pages of prototype PTEs of the _SUBSECTION not already cached are fetched in
+* one batch each. Resolved sources are kept until the file object is dropped
+* at refresh.
+* NB! MUST BE CALLED WITH pFile->_Cache.LockSRW HELD EXCLUSIVE!
 * -- pSystemProcess
 * -- pFile
-* -- iPte
+* -- iSubsection = subsection to resolve PTEs for, or (DWORD)-1 for none.
+* -- iPteBase
+* -- cPte
 * -- fVmmRead
-* -- return = the virtual address or 0 on fail.
+* -- fSharedCache = resolve VACBs of the _SHARED_CACHE_MAP.
 */
-QWORD VmmWinObjFile_ReadSubsectionAndSharedCache_GetVaSharedCache(_In_ PVMM_PROCESS pSystemProcess, _In_ POB_VMMWINOBJ_FILE pFile, _In_ QWORD iPte, _In_ QWORD fVmmRead)
+VOID VmmWinObjFile_ReadSubsectionAndSharedCache_Resolve(_In_ PVMM_PROCESS pSystemProcess, _In_ POB_VMMWINOBJ_FILE pFile, _In_ DWORD iSubsection, _In_ QWORD iPteBase, _In_ DWORD cPte, _In_ QWORD fVmmRead, _In_ BOOL fSharedCache)
 {
     BOOL f;
     BYTE pbVacb[0x40];
-    QWORD va, iVacb, vaVacbs, vaVacb;
+    DWORD i, c, cbRead;
+    QWORD iVacb, iVacbLast, iPg, iPgLast, va, vaVacb, cbPte, cbPteAll, *pva = NULL, *piv;
+    PVMMWINOBJ_FILE_SUBSECTION pss;
     PVMM_OFFSET_FILE po = &ctxVmm->offset.FILE;
+    if(!cPte || !(pva = LocalAlloc(0, 2 * cPte * sizeof(QWORD)))) { return; }
+    piv = pva + cPte;
+    // 1: _SHARED_CACHE_MAP: resolve VACB base addresses
+    if(fSharedCache && pFile->_SHARED_CACHE_MAP.cbSectionSize) {
+        if(!pFile->_Cache.pvaVacb) {
+            c = (DWORD)min(VMMWINOBJ_FILE_CACHE_VACB_MAX, (((pFile->cb + 0xfff) & ~0xfff) / pFile->_SHARED_CACHE_MAP.cbSectionSize) + 1);
+            if((pFile->_Cache.pvaVacb = LocalAlloc(LMEM_ZEROINIT, c * sizeof(QWORD)))) {
+                pFile->_Cache.cVacb = c;
+                Ob_AccountingCharge(OB_TAG_OBJ_FILE, c * sizeof(QWORD));
+            }
+        }
+        for(i = 0, c = 0, iVacbLast = (QWORD)-1; pFile->_Cache.pvaVacb && (i < cPte); i++) {
+            iVacb = ((iPteBase + i) << 12) / pFile->_SHARED_CACHE_MAP.cbSectionSize;
+            if((iVacb == iVacbLast) || (iVacb >= pFile->_Cache.cVacb) || pFile->_Cache.pvaVacb[iVacb]) { continue; }
+            iVacbLast = iVacb;
+            piv[c] = iVacb;
+            pva[c++] = pFile->_SHARED_CACHE_MAP.vaVacbs + iVacb * (ctxVmm->f32 ? 4 : 8);
+        }
+        if(c) {
+            VmmCachePrefetchPages4(pSystemProcess, c, pva, 8, fVmmRead);
+            for(i = 0; i < c; i++) {
+                f = VmmRead2(pSystemProcess, pva[i], pbVacb, 8, fVmmRead | VMM_FLAG_FORCECACHE_READ) &&
+                    (vaVacb = VMM_PTR_OFFSET(ctxVmm->f32, pbVacb, 0)) &&
+                    VMM_KADDR_4_8(vaVacb);
+                pva[i] = f ? vaVacb : 0;
+            }
+            VmmCachePrefetchPages4(pSystemProcess, c, pva, po->_VACB.cb, fVmmRead);
+            for(i = 0; i < c; i++) {
+                f = pva[i] &&
+                    VmmRead2(pSystemProcess, pva[i], pbVacb, po->_VACB.cb, fVmmRead | VMM_FLAG_FORCECACHE_READ) &&
+                    (pFile->_SHARED_CACHE_MAP.va == VMM_PTR_OFFSET(ctxVmm->f32, pbVacb, po->_VACB.oSharedCacheMap)) &&
+                    (va = VMM_PTR_OFFSET(ctxVmm->f32, pbVacb, po->_VACB.oBaseAddress));
+                pFile->_Cache.pvaVacb[piv[i]] = f ? va : 1;
+            }
+        }
+    }
+    // 2: _SUBSECTION: resolve pages of prototype PTEs
+    if(iSubsection < pFile->cSUBSECTION) {
+        pss = pFile->pSUBSECTION + iSubsection;
+        cbPte = (ctxVmm->tpMemoryModel == VMMDLL_MEMORYMODEL_X86) ? 4 : 8;
+        cbPteAll = pss->dwPtesInSubsection * cbPte;
+        if(!pss->pbPte && (VmmWinObjFile_CacheSizePte(pss) <= VMMWINOBJ_FILE_CACHE_PTE_MAX)) {
+            if((pss->pbPte = LocalAlloc(LMEM_ZEROINIT, (SIZE_T)VmmWinObjFile_CacheSizePte(pss)))) {
+                Ob_AccountingCharge(OB_TAG_OBJ_FILE, (LONG64)VmmWinObjFile_CacheSizePte(pss));
+                pss->pbPteValid = pss->pbPte + cbPteAll;
+            }
+        }
+        for(i = 0, c = 0, iPgLast = (QWORD)-1; pss->pbPte && (i < cPte) && (iPteBase + i < pss->dwPtesInSubsection); i++) {
+            iPg = ((iPteBase + i) * cbPte) >> 12;
+            if((iPg == iPgLast) || pss->pbPteValid[iPg]) { continue; }
+            iPgLast = iPg;
+            piv[c] = iPg;
+            pva[c++] = pss->vaSubsectionBase + (iPg << 12);
+        }
+        if(c) {
+            VmmCachePrefetchPages4(pSystemProcess, c, pva, 0x1000, fVmmRead);
+            for(i = 0; i < c; i++) {
+                iPg = piv[i];
+                VmmReadEx(pSystemProcess, pva[i], pss->pbPte + (iPg << 12), (DWORD)min(0x1000, cbPteAll - (iPg << 12)), &cbRead, fVmmRead | VMM_FLAG_FORCECACHE_READ | VMM_FLAG_ZEROPAD_ON_FAIL);
+                pss->pbPteValid[iPg] = TRUE;
+            }
+        }
+    }
+    LocalFree(pva);
+}
+
+/*
+* Retrieve the virtual address of a page in the _SHARED_CACHE_MAP. The VACB of
+* the page must previously have been resolved into the page source cache.
+* -- pFile
+* -- iPte
+* -- return = the virtual address or 0 if absent.
+*/
+QWORD VmmWinObjFile_ReadSubsectionAndSharedCache_GetVaSharedCache(_In_ POB_VMMWINOBJ_FILE pFile, _In_ QWORD iPte)
+{
+    QWORD iVacb, vaVacb;
     iVacb = (iPte << 12) / pFile->_SHARED_CACHE_MAP.cbSectionSize;
-    vaVacbs = pFile->_SHARED_CACHE_MAP.vaVacbs + iVacb * (ctxVmm->f32 ? 4 : 8);
-    f = VmmRead2(pSystemProcess, vaVacbs, pbVacb, 8, fVmmRead) &&
-        (vaVacb = VMM_PTR_OFFSET(ctxVmm->f32, pbVacb, 0)) &&
-        VMM_KADDR_4_8(vaVacb) &&
-        VmmRead2(pSystemProcess, vaVacb, pbVacb, po->_VACB.cb, fVmmRead) &&
-        (pFile->_SHARED_CACHE_MAP.va == VMM_PTR_OFFSET(ctxVmm->f32, pbVacb, po->_VACB.oSharedCacheMap)) &&
-        (va = VMM_PTR_OFFSET(ctxVmm->f32, pbVacb, po->_VACB.oBaseAddress));
-    return f ? (va + (iPte << 12)) : 0;
+    if(!pFile->_Cache.pvaVacb || (iVacb >= pFile->_Cache.cVacb)) { return 0; }
+    vaVacb = pFile->_Cache.pvaVacb[iVacb];
+    return (vaVacb > 1) ? (vaVacb + (iPte << 12)) : 0;
+}
+
+/*
+* Retrieve the prototype PTE of a page in a _SUBSECTION - from the page source
+* cache if possible, otherwise from memory.
+* -- pSystemProcess
+* -- pss
+* -- iPte
+* -- fVmmRead
+* -- return = the PTE or 0 on fail.
+*/
+QWORD VmmWinObjFile_ReadSubsectionAndSharedCache_GetPte(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMMWINOBJ_FILE_SUBSECTION pss, _In_ QWORD iPte, _In_ QWORD fVmmRead)
+{
+    if(iPte >= pss->dwPtesInSubsection) { return 0; }
+    if(!pss->pbPte) {
+        return VmmWinObjFile_ReadSubsectionAndSharedCache_GetPteSubsection(pSystemProcess, pss->vaSubsectionBase, iPte, fVmmRead);
+    }
+    if(ctxVmm->tpMemoryModel == VMMDLL_MEMORYMODEL_X86) {
+        return ((PDWORD)pss->pbPte)[iPte];
+    }
+    return ((PQWORD)pss->pbPte)[iPte];
 }
 
 /*
 * Read data from a single _FILE_OBJECT _SUBSECTION and/or a _SHARED_CACHE_MAP.
-* Function is very similar to the VmmReadEx() function. Reading is not yet
-* optimized, but the assumption is the function won't be called frequently so
-* any inefficencies should only have a minor performance impact.
+* Function is very similar to the VmmReadEx() function. Page sources are taken
+* from the page source cache of the file object - only pages not previously
+* resolved are resolved (in one batch). Data is then read with one scatter read
+* per source - pages not found are zero-filled.
 * -- pSystemProcess
 * -- pFile
 * -- iSubsection
@@ -552,11 +694,16 @@ VOID VmmWinObjFile_ReadSubsectionAndSharedCache(_In_ PVMM_PROCESS pSystemProcess
     if(cMEMs > 1) {
         pMEMs[cMEMs - 1].pb = pbBuffer + 0x1000;
     }
+    // Resolve page sources not already in the page source cache
+    fSharedCache = fSharedCache && pFile->_SHARED_CACHE_MAP.cbSectionSize;
+    AcquireSRWLockExclusive(&pFile->_Cache.LockSRW);
+    VmmWinObjFile_ReadSubsectionAndSharedCache_Resolve(pSystemProcess, pFile, iSubsection, (cbOffset - oA) >> 12, cMEMs, fVmmRead, fSharedCache);
+    ReleaseSRWLockExclusive(&pFile->_Cache.LockSRW);
     // Read from _SHARED_CACHE_MAP
     if(fSharedCache) {
         for(i = 0; i < cMEMs; i++) {
             iPte = i + ((cbOffset - oA) >> 12);
-            pMEMs[i].qwA = VmmWinObjFile_ReadSubsectionAndSharedCache_GetVaSharedCache(pSystemProcess, pFile, iPte, fVmmRead);
+            pMEMs[i].qwA = VmmWinObjFile_ReadSubsectionAndSharedCache_GetVaSharedCache(pFile, iPte);
             if(pMEMs[i].qwA) {
                 fReadSharedCacheMap = TRUE;
             }
@@ -570,7 +717,7 @@ VOID VmmWinObjFile_ReadSubsectionAndSharedCache(_In_ PVMM_PROCESS pSystemProcess
         for(i = 0; i < cMEMs; i++) {
             if(pMEMs[i].f) { continue; }
             iPte = i + ((cbOffset - oA) >> 12);
-            pMEMs[i].qwA = (iPte < pFile->pSUBSECTION[iSubsection].dwPtesInSubsection) ? VmmWinObjFile_ReadSubsectionAndSharedCache_GetPteSubsection(pSystemProcess, pFile->pSUBSECTION[iSubsection].vaSubsectionBase, iPte, fVmmRead) : 0;
+            pMEMs[i].qwA = VmmWinObjFile_ReadSubsectionAndSharedCache_GetPte(pSystemProcess, pFile->pSUBSECTION + iSubsection, iPte, fVmmRead);
             fReadSubsection = TRUE;
         }
         if(fReadSubsection) {
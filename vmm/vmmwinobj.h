@@ -27,6 +27,8 @@ typedef struct tVMMWINOBJ_FILE_SUBSECTION {
     DWORD dwStartingSector;         // Sector = 512bytes
     DWORD dwNumberOfFullSectors;
     DWORD dwPtesInSubsection;
+    PBYTE pbPte;                    // cached prototype PTEs (lazy - fetched one page of PTEs at a time)
+    PBYTE pbPteValid;               // per page of prototype PTEs: TRUE if cached in pbPte
 } VMMWINOBJ_FILE_SUBSECTION, *PVMMWINOBJ_FILE_SUBSECTION;
 
 typedef struct tdOB_VMMWINOBJ_FILE {
@@ -61,6 +63,11 @@ typedef struct tdOB_VMMWINOBJ_FILE {
     DWORD _Reserved1;
     DWORD cSUBSECTION;
     PVMMWINOBJ_FILE_SUBSECTION pSUBSECTION;
+    struct {                        // page source cache - valid for the lifetime of the object (until refresh)
+        SRWLOCK LockSRW;
+        DWORD cVacb;
+        PQWORD pvaVacb;             // per VACB: 0 = unresolved, 1 = absent, otherwise VACB base address
+    } _Cache;
 } OB_VMMWINOBJ_FILE, *POB_VMMWINOBJ_FILE;
 
 /*
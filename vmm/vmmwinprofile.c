@@ -0,0 +1,304 @@
+// vmmwinprofile.c : implementation of the persistent per-build kernel offset
+//                   profile.
+//
+// Kernel offsets are derived on each startup by fuzzing (EPROCESS, registry)
+// or by querying the kernel PDB (ETHREAD, FILE). The offsets only depend on
+// the kernel build - they are saved in a small profile file keyed on the PDB
+// GUID/age of the kernel and loaded instantly on later startups of the same
+// build. The profile is stored in the 'Profiles' sub-directory of vmm.dll.
+// Sections are raw offset structs - the profile version must be increased on
+// any change of the layout of the offset structs.
+//
+// Startup hints are kept in the same directory for static memory images. The
+// hints are keyed on a fingerprint of the physical memory of the image and
+// allow the DTB / kernel scans to be skipped on re-opening the same image.
+//
+// (c) MemProcFS contributors, 2020
+// Author: MemProcFS contributors
+//
+
+#include "vmmwinprofile.h"
+#include "vmmdevtrace.h"
+#include "pe.h"
+#include "util.h"
+
+#define VMMWINPROFILE_MAGIC                 0x666f7250      // 'Prof'
+#define VMMWINPROFILE_VERSION               1
+#define VMMWINPROFILE_SECTION_MAX           0x100
+#define VMMWINPROFILE_DIRECTORY             "Profiles"
+#define VMMWINPROFILE_HINT_MAGIC            0x746e6948      // 'Hint'
+#define VMMWINPROFILE_HINT_VERSION          1
+#define VMMWINPROFILE_HINT_SAMPLES          16
+
+typedef struct tdVMMWINPROFILE_FILE {
+    DWORD dwMagic;
+    DWORD dwVersion;
+    BYTE pbGUID[16];
+    DWORD dwAge;
+    DWORD f32;
+    struct {
+        DWORD cb;                           // zero = section does not exist
+        BYTE pb[VMMWINPROFILE_SECTION_MAX];
+    } Section[VMMWINPROFILE_ID_MAX + 1];    // index 0 unused
+} VMMWINPROFILE_FILE, *PVMMWINPROFILE_FILE;
+
+typedef struct tdVMMWINPROFILE_HINT_FILE {
+    DWORD dwMagic;
+    DWORD dwVersion;
+    QWORD qwFingerprint;
+    VMMWINPROFILE_HINT Hint;
+} VMMWINPROFILE_HINT_FILE, *PVMMWINPROFILE_HINT_FILE;
+
+typedef struct tdVMMWINPROFILE_CONTEXT {
+    CRITICAL_SECTION Lock;
+    CHAR szDirectory[MAX_PATH];
+    CHAR szFileName[MAX_PATH];
+    VMMWINPROFILE_FILE Profile;
+} VMMWINPROFILE_CONTEXT, *PVMMWINPROFILE_CONTEXT;
+
+/*
+* Write the profile to disk. Failures are silently ignored - the profile is an
+* optimization only.
+* NB! profile lock must be held.
+* -- ctx
+*/
+VOID VmmWinProfile_Save(_In_ PVMMWINPROFILE_CONTEXT ctx)
+{
+    FILE *hFile = NULL;
+    CreateDirectoryA(ctx->szDirectory, NULL);
+    if(fopen_s(&hFile, ctx->szFileName, "wb") || !hFile) { return; }
+    if(1 != fwrite(&ctx->Profile, sizeof(VMMWINPROFILE_FILE), 1, hFile)) {
+        fclose(hFile);
+        DeleteFileA(ctx->szFileName);
+        return;
+    }
+    fclose(hFile);
+    vmmprintfvv_fn("Saved offset profile '%s'.\n", ctx->szFileName);
+}
+
+/*
+* Load the profile from disk. The loaded profile is discarded unless it
+* exactly matches the version and kernel of the current profile.
+* -- ctx
+*/
+VOID VmmWinProfile_Load(_In_ PVMMWINPROFILE_CONTEXT ctx)
+{
+    DWORD i;
+    FILE *hFile = NULL;
+    PVMMWINPROFILE_FILE pf;
+    if(!(pf = LocalAlloc(0, sizeof(VMMWINPROFILE_FILE)))) { return; }
+    if(fopen_s(&hFile, ctx->szFileName, "rb") || !hFile) { goto fail; }
+    if(1 != fread(pf, sizeof(VMMWINPROFILE_FILE), 1, hFile)) { goto fail; }
+    if((pf->dwMagic != ctx->Profile.dwMagic) || (pf->dwVersion != ctx->Profile.dwVersion) || (pf->dwAge != ctx->Profile.dwAge) || (pf->f32 != ctx->Profile.f32)) { goto fail; }
+    if(memcmp(pf->pbGUID, ctx->Profile.pbGUID, 16)) { goto fail; }
+    for(i = 0; i <= VMMWINPROFILE_ID_MAX; i++) {
+        if(pf->Section[i].cb > VMMWINPROFILE_SECTION_MAX) { goto fail; }
+    }
+    memcpy(&ctx->Profile, pf, sizeof(VMMWINPROFILE_FILE));
+    vmmprintfv_fn("Loaded offset profile '%s'.\n", ctx->szFileName);
+fail:
+    if(hFile) { fclose(hFile); }
+    LocalFree(pf);
+}
+
+/*
+* Initialize the offset profile for the running kernel. The profile is keyed
+* on the kernel PDB GUID/age and loaded from disk if it already exists from a
+* previous analysis of the same build.
+* -- pSystemProcess
+*/
+VOID VmmWinProfile_Initialize(_In_ PVMM_PROCESS pSystemProcess)
+{
+    DWORD i;
+    CHAR ch, szPdbName[32] = { 0 };
+    PE_CODEVIEW_INFO CodeViewInfo = { 0 };
+    PVMMWINPROFILE_CONTEXT ctx;
+    VmmWinProfile_Close();
+    if(ctxMain->cfg.fDisableProfile) { return; }
+    if(!PE_GetCodeViewInfo(pSystemProcess, ctxVmm->kernel.vaBase, NULL, &CodeViewInfo)) {
+        vmmprintfvv_fn("Unable to locate kernel debug information - offset profile disabled.\n");
+        return;
+    }
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMWINPROFILE_CONTEXT)))) { return; }
+    ctx->Profile.dwMagic = VMMWINPROFILE_MAGIC;
+    ctx->Profile.dwVersion = VMMWINPROFILE_VERSION;
+    ctx->Profile.dwAge = CodeViewInfo.CodeView.Age;
+    ctx->Profile.f32 = ctxVmm->f32 ? 1 : 0;
+    memcpy(ctx->Profile.pbGUID, CodeViewInfo.CodeView.Guid, 16);
+    // file name: <dll path>\Profiles\<pdbname>-<guid><age>.profile
+    for(i = 0; i < sizeof(szPdbName) - 1; i++) {
+        ch = CodeViewInfo.CodeView.PdbFileName[i];
+        if(!((ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z'))) { break; }
+        szPdbName[i] = ch;
+    }
+    Util_GetPathDll(ctx->szDirectory, ctxVmm->hModuleVmm);
+    strncat_s(ctx->szDirectory, _countof(ctx->szDirectory), VMMWINPROFILE_DIRECTORY, _TRUNCATE);
+    _snprintf_s(ctx->szFileName, _countof(ctx->szFileName), _TRUNCATE, "%s\\%s-%016llX%016llX%X.profile",
+        ctx->szDirectory,
+        (szPdbName[0] ? szPdbName : "kernel"),
+        _byteswap_uint64(*(PQWORD)ctx->Profile.pbGUID),
+        _byteswap_uint64(*(PQWORD)(ctx->Profile.pbGUID + 8)),
+        ctx->Profile.dwAge);
+    VmmWinProfile_Load(ctx);
+    InitializeCriticalSection(&ctx->Lock);
+    ctxVmm->pProfileContext = ctx;
+}
+
+/*
+* Retrieve a profile section. The section is only returned if it exists in
+* the loaded profile and is of the exact size requested.
+* -- dwId = VMMWINPROFILE_ID_*
+* -- pb
+* -- cb
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinProfile_Get(_In_ DWORD dwId, _Out_writes_(cb) PVOID pb, _In_ DWORD cb)
+{
+    BOOL fResult = FALSE;
+    PVMMWINPROFILE_CONTEXT ctx = (PVMMWINPROFILE_CONTEXT)ctxVmm->pProfileContext;
+    if(!ctx || !dwId || (dwId > VMMWINPROFILE_ID_MAX) || !cb) { return FALSE; }
+    EnterCriticalSection(&ctx->Lock);
+    if(ctx->Profile.Section[dwId].cb == cb) {
+        memcpy(pb, ctx->Profile.Section[dwId].pb, cb);
+        fResult = TRUE;
+    }
+    LeaveCriticalSection(&ctx->Lock);
+    return fResult;
+}
+
+/*
+* Store a profile section of successfully derived offsets. The profile is
+* written to disk if the section is new or changed.
+* -- dwId = VMMWINPROFILE_ID_*
+* -- pb
+* -- cb
+*/
+VOID VmmWinProfile_Set(_In_ DWORD dwId, _In_reads_(cb) PVOID pb, _In_ DWORD cb)
+{
+    PVMMWINPROFILE_CONTEXT ctx = (PVMMWINPROFILE_CONTEXT)ctxVmm->pProfileContext;
+    if(!ctx || !dwId || (dwId > VMMWINPROFILE_ID_MAX) || !cb || (cb > VMMWINPROFILE_SECTION_MAX)) { return; }
+    EnterCriticalSection(&ctx->Lock);
+    if((ctx->Profile.Section[dwId].cb != cb) || memcmp(ctx->Profile.Section[dwId].pb, pb, cb)) {
+        ctx->Profile.Section[dwId].cb = cb;
+        memcpy(ctx->Profile.Section[dwId].pb, pb, cb);
+        VmmWinProfile_Save(ctx);
+    }
+    LeaveCriticalSection(&ctx->Lock);
+}
+
+/*
+* Close the offset profile functionality.
+*/
+VOID VmmWinProfile_Close()
+{
+    PVMMWINPROFILE_CONTEXT ctx = (PVMMWINPROFILE_CONTEXT)ctxVmm->pProfileContext;
+    if(!ctx) { return; }
+    ctxVmm->pProfileContext = NULL;
+    DeleteCriticalSection(&ctx->Lock);
+    LocalFree(ctx);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// STARTUP HINT FUNCTIONALITY BELOW:
+// ----------------------------------------------------------------------------
+
+/*
+* Calculate the fingerprint of the physical memory of the static memory image.
+* The fingerprint is a hash of the low 64kB and of pages sampled over the
+* whole physical address space.
+* -- pqwFingerprint
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinProfile_HintFingerprint(_Out_ PQWORD pqwFingerprint)
+{
+    DWORD i, o;
+    QWORD qwHash = 0xcbf29ce484222325, pa;
+    PBYTE pb;
+    if(ctxMain->cfg.fDisableProfile || ctxMain->dev.fVolatile || !ctxMain->dev.paMax) { return FALSE; }
+    if(!(pb = LocalAlloc(LMEM_ZEROINIT, 0x00010000 + VMMWINPROFILE_HINT_SAMPLES * 0x1000))) { return FALSE; }
+    VmmDevTrace_Read(0x1000, 0x00010000, pb);
+    for(i = 0; i < VMMWINPROFILE_HINT_SAMPLES; i++) {
+        pa = ((ctxMain->dev.paMax / VMMWINPROFILE_HINT_SAMPLES) * i + 0x00100000) & ~0xfff;
+        VmmDevTrace_Read(pa, 0x1000, pb + 0x00010000 + i * 0x1000);
+    }
+    qwHash ^= ctxMain->dev.paMax;
+    for(o = 0; o < 0x00010000 + VMMWINPROFILE_HINT_SAMPLES * 0x1000; o += 8) {
+        qwHash = (qwHash ^ *(PQWORD)(pb + o)) * 0x100000001b3;
+    }
+    LocalFree(pb);
+    *pqwFingerprint = qwHash;
+    return TRUE;
+}
+
+/*
+* Retrieve the directory and the file name of the hint file of a fingerprint.
+* -- qwFingerprint
+* -- szDirectory
+* -- szFileName
+*/
+VOID VmmWinProfile_HintFileName(_In_ QWORD qwFingerprint, _Out_writes_(MAX_PATH) LPSTR szDirectory, _Out_writes_(MAX_PATH) LPSTR szFileName)
+{
+    Util_GetPathDll(szDirectory, ctxVmm->hModuleVmm);
+    strncat_s(szDirectory, MAX_PATH, VMMWINPROFILE_DIRECTORY, _TRUNCATE);
+    _snprintf_s(szFileName, MAX_PATH, _TRUNCATE, "%s\\image-%016llX.hint", szDirectory, qwFingerprint);
+}
+
+/*
+* Read a hint file.
+* -- szFileName
+* -- qwFingerprint
+* -- pHint
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinProfile_HintRead(_In_ LPSTR szFileName, _In_ QWORD qwFingerprint, _Out_ PVMMWINPROFILE_HINT pHint)
+{
+    BOOL fResult = FALSE;
+    FILE *hFile = NULL;
+    VMMWINPROFILE_HINT_FILE f;
+    if(fopen_s(&hFile, szFileName, "rb") || !hFile) { return FALSE; }
+    if((1 == fread(&f, sizeof(VMMWINPROFILE_HINT_FILE), 1, hFile)) && (f.dwMagic == VMMWINPROFILE_HINT_MAGIC) && (f.dwVersion == VMMWINPROFILE_HINT_VERSION) && (f.qwFingerprint == qwFingerprint)) {
+        memcpy(pHint, &f.Hint, sizeof(VMMWINPROFILE_HINT));
+        fResult = TRUE;
+    }
+    fclose(hFile);
+    return fResult;
+}
+
+_Success_(return)
+BOOL VmmWinProfile_HintGet(_In_ QWORD qwFingerprint, _Out_ PVMMWINPROFILE_HINT pHint)
+{
+    CHAR szDirectory[MAX_PATH], szFileName[MAX_PATH];
+    ZeroMemory(pHint, sizeof(VMMWINPROFILE_HINT));
+    VmmWinProfile_HintFileName(qwFingerprint, szDirectory, szFileName);
+    if(!VmmWinProfile_HintRead(szFileName, qwFingerprint, pHint)) { return FALSE; }
+    vmmprintfvv_fn("Loaded startup hint '%s'.\n", szFileName);
+    return TRUE;
+}
+
+VOID VmmWinProfile_HintSet(_In_ QWORD qwFingerprint, _In_ PVMMWINPROFILE_HINT pHint)
+{
+    FILE *hFile = NULL;
+    CHAR szDirectory[MAX_PATH], szFileName[MAX_PATH];
+    VMMWINPROFILE_HINT HintOld;
+    VMMWINPROFILE_HINT_FILE f = { 0 };
+    f.qwFingerprint = qwFingerprint;
+    VmmWinProfile_HintFileName(qwFingerprint, szDirectory, szFileName);
+    if(VmmWinProfile_HintRead(szFileName, f.qwFingerprint, &HintOld) && !memcmp(&HintOld, pHint, sizeof(VMMWINPROFILE_HINT))) { return; }
+    f.dwMagic = VMMWINPROFILE_HINT_MAGIC;
+    f.dwVersion = VMMWINPROFILE_HINT_VERSION;
+    memcpy(&f.Hint, pHint, sizeof(VMMWINPROFILE_HINT));
+    CreateDirectoryA(szDirectory, NULL);
+    if(fopen_s(&hFile, szFileName, "wb") || !hFile) { return; }
+    if(1 != fwrite(&f, sizeof(VMMWINPROFILE_HINT_FILE), 1, hFile)) {
+        fclose(hFile);
+        DeleteFileA(szFileName);
+        return;
+    }
+    fclose(hFile);
+    vmmprintfvv_fn("Saved startup hint '%s'.\n", szFileName);
+}
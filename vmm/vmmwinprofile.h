@@ -0,0 +1,87 @@
+// vmmwinprofile.h : declarations of the persistent per-build kernel offset
+//                   profile.
+//
+// (c) MemProcFS contributors, 2020
+// Author: MemProcFS contributors
+//
+
+#ifndef __VMMWINPROFILE_H__
+#define __VMMWINPROFILE_H__
+#include "vmm.h"
+
+#define VMMWINPROFILE_ID_EPROCESS           1       // VMM_OFFSET_EPROCESS
+#define VMMWINPROFILE_ID_ETHREAD            2       // VMM_OFFSET_ETHREAD
+#define VMMWINPROFILE_ID_FILE               3       // VMM_OFFSET_FILE
+#define VMMWINPROFILE_ID_REGISTRY           4       // VMMWIN_REGISTRY_OFFSET (excl. per-boot address hint)
+#define VMMWINPROFILE_ID_MAX                4
+
+/*
+* Initialize the offset profile for the running kernel. The profile is keyed
+* on the kernel PDB GUID/age and loaded from disk if it already exists from a
+* previous analysis of the same build.
+* -- pSystemProcess
+*/
+VOID VmmWinProfile_Initialize(_In_ PVMM_PROCESS pSystemProcess);
+
+/*
+* Retrieve a profile section. The section is only returned if it exists in
+* the loaded profile and is of the exact size requested.
+* -- dwId = VMMWINPROFILE_ID_*
+* -- pb
+* -- cb
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinProfile_Get(_In_ DWORD dwId, _Out_writes_(cb) PVOID pb, _In_ DWORD cb);
+
+/*
+* Store a profile section of successfully derived offsets. The profile is
+* written to disk if the section is new or changed.
+* -- dwId = VMMWINPROFILE_ID_*
+* -- pb
+* -- cb
+*/
+VOID VmmWinProfile_Set(_In_ DWORD dwId, _In_reads_(cb) PVOID pb, _In_ DWORD cb);
+
+/*
+* Close the offset profile functionality.
+*/
+VOID VmmWinProfile_Close();
+
+typedef struct tdVMMWINPROFILE_HINT {
+    DWORD tpMemoryModel;
+    DWORD _Reserved;
+    QWORD paDTB;
+    QWORD vaKernelBase;
+    QWORD vaSystemEPROCESS;
+} VMMWINPROFILE_HINT, *PVMMWINPROFILE_HINT;
+
+/*
+* Calculate the fingerprint of the physical memory of a static memory image.
+* The fingerprint keys the startup hint and should be calculated once only
+* and passed to VmmWinProfile_HintGet() / VmmWinProfile_HintSet().
+* -- pqwFingerprint
+* -- return = FALSE if the device is volatile or profiles are disabled.
+*/
+_Success_(return)
+BOOL VmmWinProfile_HintFingerprint(_Out_ PQWORD pqwFingerprint);
+
+/*
+* Retrieve the startup hint (DTB, kernel base and SYSTEM EPROCESS) of a static
+* memory image. The hint is unverified - the caller must verify it before use.
+* -- qwFingerprint
+* -- pHint
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinProfile_HintGet(_In_ QWORD qwFingerprint, _Out_ PVMMWINPROFILE_HINT pHint);
+
+/*
+* Store the startup hint of a static memory image. The hint is only written
+* to disk if it differs from an already existing hint.
+* -- qwFingerprint
+* -- pHint
+*/
+VOID VmmWinProfile_HintSet(_In_ QWORD qwFingerprint, _In_ PVMMWINPROFILE_HINT pHint);
+
+#endif /* __VMMWINPROFILE_H__ */
@@ -10,11 +10,16 @@
 #include "vmmwinreg.h"
 #include "leechcore.h"
 #include "pe.h"
+#include "statistics.h"
 #include "util.h"
 #include "vmmwin.h"
+#include "vmmwinprofile.h"
 
 #define REG_SIGNATURE_HBIN      0x6e696268
 
+#define REG_SNAPSHOT_LAZY_CHUNK 0x10000         // lazy snapshot fetch granularity (max hbin size)
+#define REG_PATHINDEX_MAX       0x4000          // max number of paths in a hive path index
+
 typedef struct tdVMMWIN_REGISTRY_OFFSET {
     QWORD vaHintCMHIVE;
     struct {
@@ -46,10 +51,18 @@ typedef struct tdVMMWIN_REGISTRY_OFFSET {
 
 typedef struct tdVMMWIN_REGISTRY_CONTEXT {
     POB_CONTAINER pObCHiveMap;
+    POB_MAP pmObPathIndex;          // POB_REGISTRY_PATHINDEX by vaCMHIVE of most recent hive map
     CRITICAL_SECTION LockUpdate;
     VMMWIN_REGISTRY_OFFSET Offset;
 } VMMWIN_REGISTRY_CONTEXT, *PVMMWIN_REGISTRY_CONTEXT;
 
+typedef struct tdOB_REGISTRY_PATHINDEX {
+    OB ObHdr;
+    DWORD cbLength;
+    DWORD dwSequence[2];            // _HBASE_BLOCK.Sequence1/Sequence2
+    POB_MAP pmOffset;               // path hash -> key cell offset (incl. static/volatile bit)
+} OB_REGISTRY_PATHINDEX, *POB_REGISTRY_PATHINDEX;
+
 //-----------------------------------------------------------------------------
 // READ & WRITE TO REGISTRY "MEMORY SPACE" BELOW:
 // Each individual registry hive may be addressed with an addressing scheme
@@ -591,6 +604,54 @@ BOOL VmmWinReg_FuzzHiveOffsets32(_In_ PVMM_PROCESS pProcessSystem, _In_ QWORD va
     return TRUE;
 }
 
+/*
+* Verify registry offsets previously loaded from the offset profile against a
+* potential CMHIVE. This is a much cheaper check than the fuzzers above since
+* only a few pointers are dereferenced. Upon success the CMHIVE virtual address
+* hint is set.
+* -- pProcessSystem
+* -- vaCMHIVE = virtual address of pbCMHIVE (or zero if unknown).
+* -- pbCMHIVE
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinReg_VerifyHiveOffsets(_In_ PVMM_PROCESS pProcessSystem, _In_ QWORD vaCMHIVE, _In_reads_(0x1000) PBYTE pbCMHIVE)
+{
+    BOOL f32 = ctxVmm->f32;
+    DWORD o, dw;
+    QWORD vaBaseBlock, vaFLink, vaFLinkBLink = 0;
+    PVMMWIN_REGISTRY_OFFSET po = &ctxVmm->pRegistry->Offset;
+    // _CMHIVE BASE (optionally after pool header)
+    for(o = 0; o < 0x40; o += 8) {
+        if(*(PDWORD)(pbCMHIVE + o) == 0xBEE0BEE0) { break; }
+    }
+    if((o == 0x40) || (o + po->CM.FLink + 0x10 > 0x1000) || (o + po->CM.BaseBlock + 8 > 0x1000)) { return FALSE; }
+    pbCMHIVE += o;
+    if(vaCMHIVE) { vaCMHIVE += o; }
+    // _CMHIVE.BaseBlock & _CMHIVE _LIST_ENTRY
+    vaBaseBlock = f32 ? *(PDWORD)(pbCMHIVE + po->CM.BaseBlock) : *(PQWORD)(pbCMHIVE + po->CM.BaseBlock);
+    vaFLink = f32 ? *(PDWORD)(pbCMHIVE + po->CM.FLink) : *(PQWORD)(pbCMHIVE + po->CM.FLink);
+    if(!VMM_KADDR_PAGE(vaBaseBlock) || !VMM_KADDR_4_8(vaFLink)) { return FALSE; }
+    if(!VmmRead(pProcessSystem, vaFLink + (f32 ? 4 : 8), (PBYTE)&vaFLinkBLink, f32 ? sizeof(DWORD) : sizeof(QWORD))) { return FALSE; }
+    if(vaCMHIVE && (vaFLinkBLink - po->CM.FLink != vaCMHIVE)) { return FALSE; }
+    if(!VmmRead(pProcessSystem, vaFLink - po->CM.FLink, (PBYTE)&dw, sizeof(DWORD)) || (dw != 0xBEE0BEE0)) { return FALSE; }
+    po->vaHintCMHIVE = vaCMHIVE ? vaCMHIVE : (vaFLink - po->CM.FLink);
+    return TRUE;
+}
+
+/*
+* Try locate a registry hive by either verifying offsets loaded from the offset
+* profile (fast) or by fuzzing the offsets (slow).
+*/
+_Success_(return)
+BOOL VmmWinReg_LocateRegistryHive_TryHive(_In_ PVMM_PROCESS pProcessSystem, _In_ BOOL fProfile, _In_ QWORD vaCMHIVE, _In_reads_(0x1000) PBYTE pbCMHIVE)
+{
+    if(fProfile) {
+        return VmmWinReg_VerifyHiveOffsets(pProcessSystem, vaCMHIVE, pbCMHIVE);
+    }
+    return ctxVmm->f32 ? VmmWinReg_FuzzHiveOffsets32(pProcessSystem, vaCMHIVE, pbCMHIVE) : VmmWinReg_FuzzHiveOffsets64(pProcessSystem, vaCMHIVE, pbCMHIVE);
+}
+
 /*
 * Locate a registry hive. Once a single registry hive is located the linked
 * list may be traversed to enumerate the remaining registry hives.
@@ -604,13 +665,22 @@ BOOL VmmWinReg_LocateRegistryHive()
 {
     BOOL result = FALSE;
     BOOL f32 = ctxVmm->f32;
+    BOOL fProfile = FALSE;
+    VMMWIN_REGISTRY_OFFSET Profile;
     PVMM_PROCESS pObProcessSystem = VmmProcessGet(4);
     IMAGE_SECTION_HEADER SectionHeader;
     DWORD iSection, cbSectionSize, cbPoolHdr, cbPoolHdrMax, cPotentialHive, o, p, i;
     QWORD vaPotentialHive[MAX_NUM_POTENTIAL_HIVE_HINT];
     PBYTE pb = NULL;
     PPMEM_SCATTER ppMEMs = NULL;
-    if(!VmmProcessGet(4) || !(pb = LocalAlloc(0, 0x01000000))) { goto cleanup; }
+    if(!pObProcessSystem || !(pb = LocalAlloc(0, 0x01000000))) { goto cleanup; }
+    // 0: Try load offsets from the offset profile of the kernel build. If the
+    //    loaded offsets cannot be verified fall back to the offset fuzzer.
+    fProfile = VmmWinProfile_Get(VMMWINPROFILE_ID_REGISTRY, &Profile, sizeof(VMMWIN_REGISTRY_OFFSET));
+    if(fProfile) {
+        memcpy(&ctxVmm->pRegistry->Offset, &Profile, sizeof(VMMWIN_REGISTRY_OFFSET));
+    }
+retry:
     // 1: Try locate registry by scanning ntoskrnl.exe .data section.
     for(iSection = 0; iSection < 2; iSection++) {    // 1st check '.data' section, then PAGEDATA' for pointers.
         if(!PE_SectionGetFromName(pObProcessSystem, ctxVmm->kernel.vaBase, iSection ? "PAGEDATA" : ".data", &SectionHeader)) { goto cleanup; }
@@ -630,6 +700,8 @@ BOOL VmmWinReg_LocateRegistryHive()
                 }
             }
             if(!cPotentialHive) { continue; }
+            LcMemFree(ppMEMs);
+            ppMEMs = NULL;
             if(!LcAllocScatter1(cPotentialHive, &ppMEMs)) { continue; }
             for(i = 0; i < cPotentialHive; i++) {
                 ppMEMs[i]->qwA = vaPotentialHive[i] & ~0xfff;
@@ -637,13 +709,19 @@ BOOL VmmWinReg_LocateRegistryHive()
             VmmReadScatterVirtual(pObProcessSystem, ppMEMs, cPotentialHive, 0);
             for(i = 0; i < cPotentialHive; i++) {
                 if(ppMEMs[i]->f) {
-                    if((result = f32 ? VmmWinReg_FuzzHiveOffsets32(pObProcessSystem, ppMEMs[i]->qwA, ppMEMs[i]->pb) : VmmWinReg_FuzzHiveOffsets64(pObProcessSystem, ppMEMs[i]->qwA, ppMEMs[i]->pb))) {
+                    if((result = VmmWinReg_LocateRegistryHive_TryHive(pObProcessSystem, fProfile, ppMEMs[i]->qwA, ppMEMs[i]->pb))) {
                         goto cleanup;
                     }
                 }
             }
         }
     }
+    if(fProfile) {
+        vmmprintfv_fn("Unable to verify registry offsets from offset profile - fuzzing offsets.\n");
+        fProfile = FALSE;
+        ZeroMemory(&ctxVmm->pRegistry->Offset, sizeof(VMMWIN_REGISTRY_OFFSET));
+        goto retry;
+    }
     // 2: As a fallback - try locate registry by scanning lower physical memory.
     //    This is much slower, but will work sometimes when the above method fail.
     for(o = 0x00000000; o < 0x08000000; o += 0x01000000) {
@@ -655,6 +733,12 @@ BOOL VmmWinReg_LocateRegistryHive()
         }
     }
 cleanup:
+    if(result && !fProfile) {
+        // store fuzzed offsets in the offset profile (excl. per-boot address hint)
+        memcpy(&Profile, &ctxVmm->pRegistry->Offset, sizeof(VMMWIN_REGISTRY_OFFSET));
+        Profile.vaHintCMHIVE = 0;
+        VmmWinProfile_Set(VMMWINPROFILE_ID_REGISTRY, &Profile, sizeof(VMMWIN_REGISTRY_OFFSET));
+    }
     LocalFree(pb);
     LcMemFree(ppMEMs);
     Ob_DECREF(pObProcessSystem);
@@ -672,13 +756,42 @@ cleanup:
 // Enumeration/ListTraversal is done both 'efficiently' and 'lazy' on-demand.
 //-----------------------------------------------------------------------------
 
+VOID VmmWinReg_CallbackCleanup_ObPathIndex(POB_REGISTRY_PATHINDEX pOb)
+{
+    Ob_DECREF(pOb->pmOffset);
+}
+
+/*
+* Retrieve the number of bytes allocated for the snapshot data of a hive.
+* -- pHive
+* -- return
+*/
+QWORD VmmWinReg_HiveSnapshotSize(_In_ POB_REGISTRY_HIVE pHive)
+{
+    DWORD i;
+    QWORD cb = 0;
+    for(i = 0; i < 2; i++) {
+        cb += pHive->Snapshot._DUAL[i].cb;
+        if(pHive->Snapshot._DUAL[i].pbChunkValid) {
+            cb += pHive->Snapshot._DUAL[i].cb / REG_SNAPSHOT_LAZY_CHUNK + 1;
+        }
+    }
+    return cb;
+}
+
 VOID VmmWinReg_CallbackCleanup_ObRegistryHive(POB_REGISTRY_HIVE pOb)
 {
+    if(pOb->Snapshot.fInitialized) {
+        Ob_AccountingCharge(OB_TAG_REG_HIVE, -(LONG64)VmmWinReg_HiveSnapshotSize(pOb));
+    }
     DeleteCriticalSection(&pOb->LockUpdate);
+    Ob_DECREF(pOb->pObPathIndex);
     Ob_DECREF(pOb->Snapshot.pmKeyHash);
     Ob_DECREF(pOb->Snapshot.pmKeyOffset);
     LocalFree(pOb->Snapshot._DUAL[0].pb);
     LocalFree(pOb->Snapshot._DUAL[1].pb);
+    LocalFree(pOb->Snapshot._DUAL[0].pbChunkValid);
+    LocalFree(pOb->Snapshot._DUAL[1].pbChunkValid);
 }
 
 /*
@@ -728,6 +841,34 @@ VOID VmmWinReg_HiveGetShortName(_In_ POB_REGISTRY_HIVE pHive, _Out_writes_(32) L
     }
 }
 
+/*
+* Attach a path index to a new hive object. The path index of the previous hive
+* object (before refresh) is re-used if the hive is unchanged - i.e. the hive
+* length and hive base block sequence numbers are identical.
+* -- pProcess
+* -- pHive
+*/
+VOID VmmWinReg_PathIndexAttach(_In_ PVMM_PROCESS pProcess, _In_ POB_REGISTRY_HIVE pHive)
+{
+    BOOL fValid;
+    DWORD dwSequence[2] = { 0 };
+    POB_REGISTRY_PATHINDEX pObIndex;
+    fValid = VmmRead(pProcess, pHive->vaHBASE_BLOCK + 4, (PBYTE)dwSequence, sizeof(dwSequence)) && (dwSequence[0] == dwSequence[1]);
+    pObIndex = ObMap_GetByKey(ctxVmm->pRegistry->pmObPathIndex, pHive->vaCMHIVE);
+    if(pObIndex && (!fValid || (pObIndex->cbLength != pHive->cbLength) || (pObIndex->dwSequence[0] != dwSequence[0]))) {
+        Ob_DECREF_NULL(&pObIndex);
+    }
+    if(!pObIndex && (pObIndex = Ob_Alloc(OB_TAG_REG_PATHINDEX, LMEM_ZEROINIT, sizeof(OB_REGISTRY_PATHINDEX), VmmWinReg_CallbackCleanup_ObPathIndex, NULL))) {
+        pObIndex->cbLength = pHive->cbLength;
+        pObIndex->dwSequence[0] = fValid ? dwSequence[0] : 0;
+        pObIndex->dwSequence[1] = fValid ? dwSequence[1] : -1;
+        if(!(pObIndex->pmOffset = ObMap_New(0))) {
+            Ob_DECREF_NULL(&pObIndex);
+        }
+    }
+    pHive->pObPathIndex = pObIndex;
+}
+
 /*
 * Callback function from VmmWin_ListTraversePrefetch[32|64].
 * Set up a single Registry Hive.
@@ -769,6 +910,7 @@ VOID VmmWinReg_EnumHive64_Post(_In_ PVMM_PROCESS pProcess, _In_opt_ POB_MAP pHiv
             (PBYTE)pObHive->wszHiveRootPath,
             min(*(PWORD)(pbData + po->CM.HiveRootPathOpt), sizeof(pObHive->wszHiveRootPath) - 2));
     }
+    VmmWinReg_PathIndexAttach(pProcess, pObHive);
     // 3: Post processing
     if(pObHive->wszHiveRootPath[0] && WideCharToMultiByte(CP_ACP, 0, pObHive->wszHiveRootPath + 10, -1, szHiveFileNameLong, sizeof(szHiveFileNameLong) - 1, &chDefault, &fBoolTrue)) {
         Util_AsciiFileNameFix(szHiveFileNameLong, '_');
@@ -825,6 +967,7 @@ VOID VmmWinReg_EnumHive32_Post(_In_ PVMM_PROCESS pProcess, _In_opt_ POB_MAP pHiv
             (PBYTE)pObHive->wszHiveRootPath,
             min(*(PWORD)(pbData + po->CM.HiveRootPathOpt), sizeof(pObHive->wszHiveRootPath) - 2));
     }
+    VmmWinReg_PathIndexAttach(pProcess, pObHive);
     // 3: Post processing
     if(pObHive->wszHiveRootPath[0] && WideCharToMultiByte(CP_ACP, 0, pObHive->wszHiveRootPath + 10, -1, szHiveFileNameLong, sizeof(szHiveFileNameLong) - 1, &chDefault, &fBoolTrue)) {
         Util_AsciiFileNameFix(szHiveFileNameLong, '_');
@@ -850,12 +993,18 @@ VOID VmmWinReg_EnumHive32_Post(_In_ PVMM_PROCESS pProcess, _In_opt_ POB_MAP pHiv
 */
 POB_MAP VmmWinReg_HiveMap_New()
 {
-    BOOL f32 = ctxVmm->f32;
-    POB_MAP pObHiveMap = NULL;
+    BOOL fResult, f32 = ctxVmm->f32;
+    DWORD iPhase;
+    POB_MAP pObHiveMap = NULL, pmObPathIndex = NULL;
     POB_REGISTRY_HIVE pHiveCurrent = NULL;
     PVMM_PROCESS pObProcessSystem = NULL;
     if(!(pObProcessSystem = VmmProcessGet(4))) { goto fail; }    
-    if(!ctxVmm->pRegistry->Offset.vaHintCMHIVE && !VmmWinReg_LocateRegistryHive()) { goto fail; }
+    if(!ctxVmm->pRegistry->Offset.vaHintCMHIVE) {
+        iPhase = Statistics_StartupPhaseBegin("Registry hive locate");
+        fResult = VmmWinReg_LocateRegistryHive();
+        Statistics_StartupPhaseEnd(iPhase);
+        if(!fResult) { goto fail; }
+    }
     if(!(pObHiveMap = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) { goto fail; }
     // Traverse the CMHIVE linked list in an efficient way
     VmmWin_ListTraversePrefetch(
@@ -869,6 +1018,16 @@ POB_MAP VmmWinReg_HiveMap_New()
         f32 ? VmmWinReg_EnumHive32_Pre : VmmWinReg_EnumHive64_Pre,
         f32 ? VmmWinReg_EnumHive32_Post : VmmWinReg_EnumHive64_Post,
         ctxVmm->pObCCachePrefetchRegistry);
+    // Keep the path indexes of current hives only for re-use on next refresh
+    if((pmObPathIndex = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) {
+        while((pHiveCurrent = ObMap_GetNext(pObHiveMap, pHiveCurrent))) {
+            ObMap_Push(pmObPathIndex, pHiveCurrent->vaCMHIVE, pHiveCurrent->pObPathIndex);
+        }
+        ObMap_Freeze(pmObPathIndex);
+        Ob_DECREF(ctxVmm->pRegistry->pmObPathIndex);
+        ctxVmm->pRegistry->pmObPathIndex = pmObPathIndex;
+    }
+    ObMap_Freeze(pObHiveMap);
     ObContainer_SetOb(ctxVmm->pRegistry->pObCHiveMap, pObHiveMap);
     Ob_DECREF(pObProcessSystem);
     return pObHiveMap;
@@ -902,6 +1061,49 @@ POB_MAP VmmWinReg_HiveMap()
 
 _Success_(return)
 BOOL VmmWinReg_KeyInitialize(_In_ POB_REGISTRY_HIVE pHive);
+VOID VmmWinReg_KeyInitializeScan(_In_ POB_REGISTRY_HIVE pHive);
+
+/*
+* Ensure a range of the hive snapshot is fetched. In a lazy snapshot missing
+* REG_SNAPSHOT_LAZY_CHUNK sized chunks of the range are read from the hive
+* with one scatter read. In a full snapshot this is a bounds check only.
+* -- pHive
+* -- iSV = static/volatile storage.
+* -- oRaw = raw offset (excl. static/volatile bit).
+* -- cb
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinReg_HiveSnapshotFetch(_In_ POB_REGISTRY_HIVE pHive, _In_ DWORD iSV, _In_ DWORD oRaw, _In_ DWORD cb)
+{
+    DWORD iChunk, iChunkLast, cChunk, oChunk, cbChunk;
+    PBYTE pbValid;
+    if(!cb) { return TRUE; }
+    if((QWORD)oRaw + cb > pHive->Snapshot._DUAL[iSV].cb) { return FALSE; }
+    if(!pHive->Snapshot.fLazy) { return TRUE; }
+    pbValid = pHive->Snapshot._DUAL[iSV].pbChunkValid;
+    iChunk = oRaw / REG_SNAPSHOT_LAZY_CHUNK;
+    iChunkLast = (oRaw + cb - 1) / REG_SNAPSHOT_LAZY_CHUNK;
+    while((iChunk <= iChunkLast) && pbValid[iChunk]) {
+        iChunk++;
+    }
+    if(iChunk > iChunkLast) { return TRUE; }
+    EnterCriticalSection(&pHive->LockUpdate);
+    for(; iChunk <= iChunkLast; iChunk++) {
+        if(pbValid[iChunk]) { continue; }
+        cChunk = 1;
+        while((iChunk + cChunk <= iChunkLast) && !pbValid[iChunk + cChunk]) {
+            cChunk++;
+        }
+        oChunk = iChunk * REG_SNAPSHOT_LAZY_CHUNK;
+        cbChunk = min(cChunk * REG_SNAPSHOT_LAZY_CHUNK, pHive->Snapshot._DUAL[iSV].cb - oChunk);
+        VmmWinReg_HiveReadEx(pHive, (iSV ? 0x80000000 : 0) + oChunk, pHive->Snapshot._DUAL[iSV].pb + oChunk, cbChunk, NULL, VMM_FLAG_ZEROPAD_ON_FAIL);
+        memset(pbValid + iChunk, 1, cChunk);
+        iChunk += cChunk - 1;
+    }
+    LeaveCriticalSection(&pHive->LockUpdate);
+    return TRUE;
+}
 
 /*
 * Ensure a registry hive snapshot is taken of the hive and stored within the
@@ -909,6 +1111,9 @@ BOOL VmmWinReg_KeyInitialize(_In_ POB_REGISTRY_HIVE pHive);
 * memory and performing analysis on it to generate a key tree for convenient
 * parsing of the keys. Any keys derived from the hive must never be used after
 * Ob_DECREF has been called on the hive.
+* If lazy registry snapshots are enabled (ctxMain->cfg.fRegistryLazy), or if the
+* path index of the hive is re-used after a refresh, hive data is instead fetched
+* on access and keys are built only for visited sub-trees.
 * -- pHive
 * -- return
 */
@@ -930,26 +1135,68 @@ BOOL VmmWinReg_HiveSnapshotEnsure(_In_ POB_REGISTRY_HIVE pHive)
     pHive->Snapshot.pmKeyHash = ObMap_New(OB_MAP_FLAGS_OBJECT_OB);
     pHive->Snapshot.pmKeyOffset = ObMap_New(OB_MAP_FLAGS_OBJECT_OB);
     if(!pHive->Snapshot.pmKeyHash || !pHive->Snapshot.pmKeyOffset) { goto fail; }
+    // a non-empty path index is re-used from before a refresh of the unchanged
+    // hive - build keys on demand from the path index instead of a re-snapshot.
+    pHive->Snapshot.fLazy = ctxMain->cfg.fRegistryLazy || (pHive->pObPathIndex && ObMap_Size(pHive->pObPathIndex->pmOffset));
     for(i = 0; i < 2; i++) {
         pHive->Snapshot._DUAL[i].cb = pHive->_DUAL[i].cb;
         if(!(pHive->Snapshot._DUAL[i].pb = LocalAlloc(0, pHive->Snapshot._DUAL[i].cb))) { goto fail; }
-        VmmWinReg_HiveReadEx(pHive, (i ? 0x80000000 : 0), pHive->Snapshot._DUAL[i].pb, pHive->Snapshot._DUAL[i].cb, &cbRead, VMM_FLAG_ZEROPAD_ON_FAIL);
+        if(pHive->Snapshot.fLazy) {
+            if(!(pHive->Snapshot._DUAL[i].pbChunkValid = LocalAlloc(LMEM_ZEROINIT, pHive->Snapshot._DUAL[i].cb / REG_SNAPSHOT_LAZY_CHUNK + 1))) { goto fail; }
+        } else {
+            VmmWinReg_HiveReadEx(pHive, (i ? 0x80000000 : 0), pHive->Snapshot._DUAL[i].pb, pHive->Snapshot._DUAL[i].cb, &cbRead, VMM_FLAG_ZEROPAD_ON_FAIL);
+        }
     }
     if(!VmmWinReg_KeyInitialize(pHive)) { goto fail; }
+    if(!pHive->Snapshot.fLazy) {
+        // fully built snapshot - key lookups are lock-free from here on.
+        ObMap_Freeze(pHive->Snapshot.pmKeyHash);
+        ObMap_Freeze(pHive->Snapshot.pmKeyOffset);
+    }
+    Ob_AccountingCharge(OB_TAG_REG_HIVE, VmmWinReg_HiveSnapshotSize(pHive));
     pHive->Snapshot.fInitialized = TRUE;
     LeaveCriticalSection(&pHive->LockUpdate);
     return TRUE;
 fail:
     Ob_DECREF_NULL(&pHive->Snapshot.pmKeyHash);
     Ob_DECREF_NULL(&pHive->Snapshot.pmKeyOffset);
-    LocalFree(pHive->Snapshot._DUAL[0].pb);
-    LocalFree(pHive->Snapshot._DUAL[1].pb);
-    pHive->Snapshot._DUAL[0].pb = NULL;
-    pHive->Snapshot._DUAL[1].pb = NULL;
+    for(i = 0; i < 2; i++) {
+        LocalFree(pHive->Snapshot._DUAL[i].pb);
+        LocalFree(pHive->Snapshot._DUAL[i].pbChunkValid);
+        pHive->Snapshot._DUAL[i].pb = NULL;
+        pHive->Snapshot._DUAL[i].pbChunkValid = NULL;
+    }
     LeaveCriticalSection(&pHive->LockUpdate);
     return FALSE;
 }
 
+/*
+* Ensure a full registry hive snapshot exists. A lazy snapshot is upgraded by
+* fetching all remaining hive data and indexing all keys - including orphan
+* keys which are not reachable from the root key.
+* -- pHive
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinReg_HiveSnapshotEnsureFull(_In_ POB_REGISTRY_HIVE pHive)
+{
+    DWORD i;
+    if(!VmmWinReg_HiveSnapshotEnsure(pHive)) { return FALSE; }
+    if(!pHive->Snapshot.fLazy) { return TRUE; }
+    EnterCriticalSection(&pHive->LockUpdate);
+    if(pHive->Snapshot.fLazy) {
+        for(i = 0; i < 2; i++) {
+            VmmWinReg_HiveSnapshotFetch(pHive, i, 0, pHive->Snapshot._DUAL[i].cb);
+        }
+        VmmWinReg_KeyInitializeScan(pHive);
+        ObMap_Freeze(pHive->Snapshot.pmKeyHash);
+        ObMap_Freeze(pHive->Snapshot.pmKeyOffset);
+        pHive->Snapshot.fLazy = FALSE;
+    }
+    LeaveCriticalSection(&pHive->LockUpdate);
+    return TRUE;
+}
+
 
 
 //-----------------------------------------------------------------------------
@@ -975,6 +1222,7 @@ VOID VmmWinReg_Close()
 {
     if(ctxVmm->pRegistry) {
         Ob_DECREF(ctxVmm->pRegistry->pObCHiveMap);
+        Ob_DECREF(ctxVmm->pRegistry->pmObPathIndex);
         DeleteCriticalSection(&ctxVmm->pRegistry->LockUpdate);
         LocalFree(ctxVmm->pRegistry);
         ctxVmm->pRegistry = NULL;
@@ -1049,6 +1297,9 @@ POB_REGISTRY_HIVE VmmWinReg_HiveGetByName(_In_ LPSTR szName)
 #define REG_CM_KEY_SIGNATURE_KEYNODE        0x6B6E  // 'nk'-key
 #define REG_CM_KEY_SIGNATURE_KEYVALUE       0x6B76  // 'vk'-key
 #define REG_CM_HASH_LEAF_SIGNATURE          0x686C  // 'hl'-key
+#define REG_CM_FAST_LEAF_SIGNATURE          0x666C  // 'lf'-key
+#define REG_CM_INDEX_LEAF_SIGNATURE         0x696C  // 'li'-key
+#define REG_CM_INDEX_ROOT_SIGNATURE         0x6972  // 'ri'-key
 #define REG_CM_KEY_SIGNATURE_BIGDATA        0x6264  // 'db'-key
 
 #define REG_CM_KEY_VALUE_FLAGS_COMP_NAME    0x01
@@ -1134,6 +1385,7 @@ typedef struct tdOB_REGISTRY_KEY {
     QWORD qwHashKeyParent;          // parent key hash (calculated on file system compatible hash)
     QWORD qwHashKeyThis;            // this key hash (calculated on file system compatible hash)
     PREG_CM_KEY_NODE pKey;          // points into pHive->Snapshot.pb (must not be free'd)
+    BOOL fChildExpanded;            // lazy snapshot: child keys are built from the sub-key lists
     struct {
         DWORD c;
         DWORD cMax;
@@ -1208,9 +1460,9 @@ BOOL VmmWinReg_KeyValidateCellSize(_In_ POB_REGISTRY_HIVE pHive, _In_ DWORD oCel
     DWORD iSV, cbCell;
     iSV = oCell >> 31;
     oCell = oCell & 0x7fffffff;
-    if(oCell + 4 > pHive->Snapshot._DUAL[iSV].cb) { return FALSE; }
+    if(!VmmWinReg_HiveSnapshotFetch(pHive, iSV, oCell, 4)) { return FALSE; }
     cbCell = REG_CELL_SIZE_EX(pHive->Snapshot._DUAL[iSV].pb, oCell);
-    if((cbCell < cbCellSizeMin) || (cbCell > cbCellSizeMax) || (oCell + cbCell > pHive->Snapshot._DUAL[iSV].cb)) { return FALSE; }
+    if((cbCell < cbCellSizeMin) || (cbCell > cbCellSizeMax) || !VmmWinReg_HiveSnapshotFetch(pHive, iSV, oCell, cbCell)) { return FALSE; }
     if(((oCell & 0xfff) + cbCell > 0x1000) && (REG_SIGNATURE_HBIN == *(PDWORD)(pHive->Snapshot._DUAL[iSV].pb + ((oCell + 0xfff) & ~0xfff)))) { return FALSE; }
     return TRUE;
 }
@@ -1369,6 +1621,7 @@ BOOL VmmWinReg_KeyInitializeRootKey(_In_ POB_REGISTRY_HIVE pHive)
 	QWORD qwKeyRootHash = 0;
     // 1: get root key offset from regf-header (this is most often 0x20)
     if(!(pObSystemProcess = VmmProcessGet(4))) { return FALSE; }
+    VmmWinReg_HiveSnapshotFetch(pHive, 0, 0, min(0x1000, pHive->Snapshot._DUAL[0].cb));
     if(!VmmRead(pObSystemProcess, pHive->vaHBASE_BLOCK + 0x24, (PBYTE)&oRootKey, sizeof(DWORD)) || !oRootKey || (oRootKey > pHive->Snapshot._DUAL[0].cb - REG_CM_KEY_NODE_SIZEOF)) {
         // regf base block unreadable or corrupt - try locate root key in 1st hive page
         i = 0x20;
@@ -1391,18 +1644,14 @@ BOOL VmmWinReg_KeyInitializeRootKey(_In_ POB_REGISTRY_HIVE pHive)
 }
 
 /*
-* Initialize the registry key functionality by first "snapshotting" the hive
-* contents into memory then walking the complete hive to try to find and index
-* relations beteen parent-child registry keys - which are then stored into
-* hash maps for faster lookups.
+* Walk the complete hive snapshot to try to find and index relations between
+* parent-child registry keys - which are then stored into hash maps for faster
+* lookups. Keys already indexed (i.e. by a lazy snapshot) are kept as-is.
 * -- pHive
-* -- return
 */
-_Success_(return)
-BOOL VmmWinReg_KeyInitialize(_In_ POB_REGISTRY_HIVE pHive)
+VOID VmmWinReg_KeyInitializeScan(_In_ POB_REGISTRY_HIVE pHive)
 {
 	DWORD oCell, dwSignature, cbCell, cbHbin, iSV, iHbin;
-    if(!VmmWinReg_KeyInitializeRootKey(pHive)) { return FALSE; }
     for(iSV = 0; iSV < 2; iSV++) {
         iHbin = 0;
         while(iHbin < (pHive->Snapshot._DUAL[iSV].cb & ~0xfff)) {
@@ -1437,9 +1686,87 @@ BOOL VmmWinReg_KeyInitialize(_In_ POB_REGISTRY_HIVE pHive)
             iHbin += cbHbin;
         }
     }
+}
+
+/*
+* Initialize the registry key functionality of a hive snapshot. The root keys
+* are always created. A full snapshot is also walked completely to index all
+* keys - a lazy snapshot builds keys on demand by VmmWinReg_KeyLazyExpand().
+* -- pHive
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinReg_KeyInitialize(_In_ POB_REGISTRY_HIVE pHive)
+{
+    if(!VmmWinReg_KeyInitializeRootKey(pHive)) { return FALSE; }
+    if(!pHive->Snapshot.fLazy) {
+        VmmWinReg_KeyInitializeScan(pHive);
+    }
     return TRUE;
 }
 
+/*
+* Lazy snapshot: build the keys referenced by a sub-key index cell. Leaf lists
+* (lf/lh/li) reference key nodes and index roots (ri) reference leaf lists.
+* -- pHive
+* -- oList = sub-key index cell offset (incl. static/volatile bit).
+* -- fIndexRoot = allow an index root ('ri') - only valid at top-level.
+*/
+VOID VmmWinReg_KeyLazyExpandList(_In_ POB_REGISTRY_HIVE pHive, _In_ DWORD oList, _In_ BOOL fIndexRoot)
+{
+    PBYTE pbList;
+    WORD wSignature;
+    DWORD i, c, cbEntry, oEntry;
+    if(!VmmWinReg_KeyValidateCellSize(pHive, oList, 8, REG_SNAPSHOT_LAZY_CHUNK)) { return; }
+    pbList = pHive->Snapshot._DUAL[REG_CELL_SV(oList)].pb + REG_CELL_ORAW(oList);
+    wSignature = *(PWORD)(pbList + 4);
+    if((wSignature == REG_CM_FAST_LEAF_SIGNATURE) || (wSignature == REG_CM_HASH_LEAF_SIGNATURE)) {
+        cbEntry = 8;
+    } else if((wSignature == REG_CM_INDEX_LEAF_SIGNATURE) || (fIndexRoot && (wSignature == REG_CM_INDEX_ROOT_SIGNATURE))) {
+        cbEntry = 4;
+    } else {
+        return;
+    }
+    c = min(*(PWORD)(pbList + 6), (REG_CELL_SIZE_EX(pbList, 0) - 8) / cbEntry);
+    for(i = 0; i < c; i++) {
+        oEntry = *(PDWORD)(pbList + 8 + i * cbEntry);
+        if(wSignature == REG_CM_INDEX_ROOT_SIGNATURE) {
+            VmmWinReg_KeyLazyExpandList(pHive, oEntry, FALSE);
+        } else {
+            Ob_DECREF(VmmWinReg_KeyInitializeCreateKey(pHive, oEntry, 0));
+        }
+    }
+}
+
+/*
+* Lazy snapshot: ensure the direct child keys of a key are built by walking its
+* persistent and volatile sub-key lists. No-op for full snapshots.
+* -- pHive
+* -- pKey
+*/
+VOID VmmWinReg_KeyLazyExpand(_In_ POB_REGISTRY_HIVE pHive, _In_ POB_REGISTRY_KEY pKey)
+{
+    DWORD iSV;
+    PREG_CM_KEY_NODE pnk;
+    if(!pHive->Snapshot.fLazy || pKey->fChildExpanded) { return; }
+    EnterCriticalSection(&pHive->LockUpdate);
+    if(pHive->Snapshot.fLazy && !pKey->fChildExpanded) {
+        // read the key node from the hive since 'ROOT' is a dummy key object.
+        if(VmmWinReg_KeyValidateCellSize(pHive, pKey->oCell, REG_CM_KEY_NODE_SIZEOF + 4, 0x1000)) {
+            pnk = (PREG_CM_KEY_NODE)(pHive->Snapshot._DUAL[REG_CELL_SV(pKey->oCell)].pb + REG_CELL_ORAW(pKey->oCell) + 4);
+            if(pnk->Signature == REG_CM_KEY_SIGNATURE_KEYNODE) {
+                for(iSV = 0; iSV < 2; iSV++) {
+                    if(pnk->SubKeyCounts[iSV]) {
+                        VmmWinReg_KeyLazyExpandList(pHive, pnk->SubKeyLists[iSV], TRUE);
+                    }
+                }
+            }
+        }
+        pKey->fChildExpanded = TRUE;
+    }
+    LeaveCriticalSection(&pHive->LockUpdate);
+}
+
 /*
 * Try to create a key-value object manager object from the given cell offset.
 * -- pHive
@@ -1486,8 +1813,10 @@ POB_REGISTRY_VALUE VmmWinReg_ValueByKeyAndName(_In_ POB_REGISTRY_HIVE pHive, _In
     DWORD cbSnapshot = pHive->Snapshot._DUAL[REG_CELL_SV(pKey->pKey->ValueList.List)].cb;
     PBYTE pbSnapshot = pHive->Snapshot._DUAL[REG_CELL_SV(pKey->pKey->ValueList.List)].pb;
     if(!pKey->pKey->ValueList.Count || (oListCellRaw + 8 > cbSnapshot)) { return NULL; }
+    if(!VmmWinReg_HiveSnapshotFetch(pHive, REG_CELL_SV(pKey->pKey->ValueList.List), oListCellRaw, 8)) { return NULL; }
     cbListCell = REG_CELL_SIZE_EX(pbSnapshot, oListCellRaw);
     if((cbListCell < 8) || (oListCellRaw & 0xfff) + cbListCell > 0x1000) { return NULL; }
+    if(!VmmWinReg_HiveSnapshotFetch(pHive, REG_CELL_SV(pKey->pKey->ValueList.List), oListCellRaw, cbListCell)) { return NULL; }
     cValues = min(pKey->pKey->ValueList.Count, (cbListCell - 4) >> 2);
     praValues = (PDWORD)(pbSnapshot + oListCellRaw + 4);
     for(iValues = 0; iValues < cValues; iValues++) {
@@ -1517,11 +1846,14 @@ VOID VmmWinReg_ValueQueryInternal_BigDataCell(_In_ POB_REGISTRY_HIVE pHive, _In_
     if(!pbData) { return; }
     iDataCellSV = REG_CELL_SV(oDataCell);
     oDataCellRaw = REG_CELL_ORAW(oDataCell);
-    cbDataCell = REG_CELL_SIZE_EX(pHive->Snapshot._DUAL[iDataCellSV].pb, oDataCellRaw);
-    f = (oDataCellRaw + cbDataCell <= pHive->Snapshot._DUAL[iDataCellSV].cb) &&
+    f = VmmWinReg_HiveSnapshotFetch(pHive, iDataCellSV, oDataCellRaw, 4);
+    cbDataCell = f ? REG_CELL_SIZE_EX(pHive->Snapshot._DUAL[iDataCellSV].pb, oDataCellRaw) : 0;
+    f = f &&
+        (oDataCellRaw + cbDataCell <= pHive->Snapshot._DUAL[iDataCellSV].cb) &&
         (fDataCellLast || (cbDataCell == 16344 + 8)) &&
         (cbDataCell <= 16344 + 8) &&
-        (cbDataCell > 8);
+        (cbDataCell > 8) &&
+        VmmWinReg_HiveSnapshotFetch(pHive, iDataCellSV, oDataCellRaw, cbDataCell);
     if(f) {
         memcpy(pbData, pHive->Snapshot._DUAL[iDataCellSV].pb + oDataCellRaw + 4 + cbDataOffset, min(cbData, cbDataCell));
     } else {
@@ -1555,6 +1887,7 @@ BOOL VmmWinReg_ValueQueryInternal_BigDataList(_In_ POB_REGISTRY_HIVE pHive, _In_
     iListCellSV = REG_CELL_SV(oListCell);
     oListCellRaw = REG_CELL_ORAW(oListCell);
     if(oListCellRaw + 4 + cNumSegments * 4 > pHive->Snapshot._DUAL[iListCellSV].cb) { return FALSE; }
+    if(!VmmWinReg_HiveSnapshotFetch(pHive, iListCellSV, oListCellRaw, 4 + cNumSegments * 4)) { return FALSE; }
     cbListCell = REG_CELL_SIZE_EX(pHive->Snapshot._DUAL[iListCellSV].pb, oListCellRaw);
     if(oListCellRaw + cbListCell > pHive->Snapshot._DUAL[iListCellSV].cb) { return FALSE; }
     if(cbListCell < 4 + cNumSegments * 4UL) { return FALSE; }
@@ -1606,7 +1939,7 @@ BOOL VmmWinReg_ValueQueryInternal(_In_ POB_REGISTRY_HIVE pHive, _In_ POB_REGISTR
     }
     iCellSV = REG_CELL_SV(pKeyValue->pValue->Data);
     oCellRaw = REG_CELL_ORAW(pKeyValue->pValue->Data);
-    if(oCellRaw + 0x10 > pHive->Snapshot._DUAL[iCellSV].cb) { return FALSE; }
+    if(!VmmWinReg_HiveSnapshotFetch(pHive, iCellSV, oCellRaw, 0x10)) { return FALSE; }
     cbCell = REG_CELL_SIZE_EX(pHive->Snapshot._DUAL[iCellSV].pb, oCellRaw);
     if(cbCell < 8) { return FALSE; }
     // "big data" table
@@ -1621,6 +1954,7 @@ BOOL VmmWinReg_ValueQueryInternal(_In_ POB_REGISTRY_HIVE pHive, _In_ POB_REGISTR
     if(cbDataOffset > cbCell - 4) { return FALSE; }
     cbDataRead = min(cbDataRead, cbCell - 4 - cbDataOffset);
     if(oCellRaw + 4ULL + cbDataOffset + cbDataRead > pHive->Snapshot._DUAL[iCellSV].cb) { return FALSE; }
+    if(!VmmWinReg_HiveSnapshotFetch(pHive, iCellSV, oCellRaw + 4 + cbDataOffset, cbDataRead)) { return FALSE; }
     memcpy(pbData, pHive->Snapshot._DUAL[iCellSV].pb + oCellRaw + 4 + cbDataOffset, cbDataRead);
 success:
     if(pcbDataRead) { *pcbDataRead = cbDataRead; }
@@ -1737,9 +2071,36 @@ BOOL VmmWinReg_KeyHiveGetByFullPath(_In_ LPWSTR wszPathFull, _Out_ POB_REGISTRY_
     return FALSE;
 }
 
+/*
+* Retrieve a registry key by its path (lazy snapshot). The path is walked and
+* the child keys of each key along the path are built.
+* CALLER DECREF: return
+* -- pHive
+* -- wszPath
+* -- return
+*/
+_Success_(return != NULL)
+POB_REGISTRY_KEY VmmWinReg_KeyGetByPathLazy(_In_ POB_REGISTRY_HIVE pHive, _In_ LPWSTR wszPath)
+{
+    QWORD qwHash = 0;
+    WCHAR wsz1[MAX_PATH];
+    POB_REGISTRY_KEY pObKey = NULL;
+    while(wszPath && wszPath[0]) {
+        if(pObKey) {
+            VmmWinReg_KeyLazyExpand(pHive, pObKey);
+            Ob_DECREF_NULL(&pObKey);
+        }
+        wszPath = Util_PathSplit2_ExWCHAR(wszPath, wsz1, _countof(wsz1));
+        qwHash = Util_HashNameW_Registry(wsz1, 0) + ((qwHash >> 13) | (qwHash << 51));
+        if(!(pObKey = ObMap_GetByKey(pHive->Snapshot.pmKeyHash, qwHash))) { return NULL; }
+    }
+    return pObKey;
+}
+
 /*
 * Retrieve a registry key by its path. If no registry key is found then NULL
-* will be returned.
+* will be returned. Resolved paths are stored in the path index of the hive
+* which is kept over refreshes as long as the hive is unchanged.
 * CALLER DECREF: return
 * -- pHive
 * -- wszPath
@@ -1748,8 +2109,33 @@ BOOL VmmWinReg_KeyHiveGetByFullPath(_In_ LPWSTR wszPathFull, _Out_ POB_REGISTRY_
 _Success_(return != NULL)
 POB_REGISTRY_KEY VmmWinReg_KeyGetByPath(_In_ POB_REGISTRY_HIVE pHive, _In_ LPWSTR wszPath)
 {
+    DWORD oCell;
+    QWORD qwHash;
+    POB_REGISTRY_KEY pObKey = NULL;
+    POB_REGISTRY_PATHINDEX pIndex = pHive ? pHive->pObPathIndex : NULL;
     if(!VmmWinReg_HiveSnapshotEnsure(pHive)) { return NULL; }
-    return (POB_REGISTRY_KEY)ObMap_GetByKey(pHive->Snapshot.pmKeyHash, Util_HashPathW_Registry(wszPath));
+    qwHash = Util_HashPathW_Registry(wszPath);
+    // 1: path index - key is verified since the index may be stale (i.e. volatile keys).
+    if(pIndex && (oCell = (DWORD)(QWORD)ObMap_GetByKey(pIndex->pmOffset, qwHash))) {
+        if((pObKey = VmmWinReg_KeyGetByCellOffset(pHive, oCell)) && (pObKey->qwHashKeyThis == qwHash)) {
+            return pObKey;
+        }
+        Ob_DECREF_NULL(&pObKey);
+        ObMap_RemoveByKey(pIndex->pmOffset, qwHash);
+    }
+    // 2: resolve path by snapshot
+    if(pHive->Snapshot.fLazy && !_wcsnicmp(wszPath, L"ORPHAN", 6) && (!wszPath[6] || (wszPath[6] == '\\'))) {
+        VmmWinReg_HiveSnapshotEnsureFull(pHive);
+    }
+    if(pHive->Snapshot.fLazy) {
+        pObKey = VmmWinReg_KeyGetByPathLazy(pHive, wszPath);
+    } else {
+        pObKey = (POB_REGISTRY_KEY)ObMap_GetByKey(pHive->Snapshot.pmKeyHash, qwHash);
+    }
+    if(pObKey && pIndex && (ObMap_Size(pIndex->pmOffset) < REG_PATHINDEX_MAX)) {
+        ObMap_Push(pIndex->pmOffset, qwHash, (PVOID)(QWORD)pObKey->oCell);
+    }
+    return pObKey;
 }
 
 /*
@@ -1764,6 +2150,7 @@ _Success_(return != NULL)
 POB_REGISTRY_KEY VmmWinReg_KeyGetByChildName(_In_ POB_REGISTRY_HIVE pHive, _In_ POB_REGISTRY_KEY pParentKey, _In_ LPWSTR wszChildName)
 {
     if(!VmmWinReg_HiveSnapshotEnsure(pHive)) { return NULL; }
+    VmmWinReg_KeyLazyExpand(pHive, pParentKey);
     return (POB_REGISTRY_KEY)ObMap_GetByKey(pHive->Snapshot.pmKeyHash, VmmWinReg_KeyHashChildName(pParentKey, wszChildName));
 }
 
@@ -1778,7 +2165,19 @@ POB_REGISTRY_KEY VmmWinReg_KeyGetByChildName(_In_ POB_REGISTRY_HIVE pHive, _In_
 _Success_(return != NULL)
 POB_REGISTRY_KEY VmmWinReg_KeyGetByCellOffset(_In_ POB_REGISTRY_HIVE pHive, _In_ DWORD raCellOffset)
 {
+    POB_REGISTRY_KEY pObKey = NULL;
+    BOOL fLazy = FALSE;
     if(!VmmWinReg_HiveSnapshotEnsure(pHive)) { return NULL; }
+    if(pHive->Snapshot.fLazy) {
+        // lazy snapshot: build the key (and its parent keys) if not yet built.
+        // the snapshot may have been completed (and frozen) while waiting.
+        EnterCriticalSection(&pHive->LockUpdate);
+        if((fLazy = pHive->Snapshot.fLazy)) {
+            pObKey = VmmWinReg_KeyInitializeCreateKey(pHive, raCellOffset, 0);
+        }
+        LeaveCriticalSection(&pHive->LockUpdate);
+        if(fLazy) { return pObKey; }
+    }
     return (POB_REGISTRY_KEY)ObMap_GetByKey(pHive->Snapshot.pmKeyOffset, raCellOffset);
 }
 
@@ -1794,16 +2193,28 @@ POB_REGISTRY_KEY VmmWinReg_KeyGetByCellOffset(_In_ POB_REGISTRY_HIVE pHive, _In_
 POB_MAP VmmWinReg_KeyList(_In_ POB_REGISTRY_HIVE pHive, _In_opt_ POB_REGISTRY_KEY pKeyParent)
 {
     DWORD i;
+    BOOL fLazy;
     POB_MAP pmObSubkeys;
     POB_REGISTRY_KEY pKeyChild;
     if(!VmmWinReg_HiveSnapshotEnsure(pHive)) { return NULL; }
     if(!(pmObSubkeys = ObMap_New(OB_MAP_FLAGS_OBJECT_OB | OB_MAP_FLAGS_NOKEY))) { return NULL; }
     if(pKeyParent) {
+        if(pHive->Snapshot.fLazy && (pKeyParent->oCell == 0x7ffffffe)) {
+            VmmWinReg_HiveSnapshotEnsureFull(pHive);        // 'ORPHAN' keys are only found by a full walk
+        }
+        VmmWinReg_KeyLazyExpand(pHive, pKeyParent);
+        // lazy snapshot: child lists may grow - i.e. by VmmWinReg_KeyGetByCellOffset.
+        if((fLazy = pHive->Snapshot.fLazy)) {
+            EnterCriticalSection(&pHive->LockUpdate);
+        }
         for(i = 0; i < pKeyParent->Child.c; i++) {
             pKeyChild = ObMap_GetByKey(pHive->Snapshot.pmKeyOffset, pKeyParent->Child.po[i]);
             ObMap_Push(pmObSubkeys, 0, pKeyChild);
             Ob_DECREF(pKeyChild);
         }
+        if(fLazy) {
+            LeaveCriticalSection(&pHive->LockUpdate);
+        }
     } else {
         for(i = 0; i < 2; i++) {
             pKeyChild = ObMap_GetByIndex(pHive->Snapshot.pmKeyOffset, i);
@@ -2010,6 +2421,83 @@ BOOL VmmWinReg_ValueQuery2(_In_ LPWSTR wszFullPathKeyValue, _Out_opt_ PDWORD pdw
     return f;
 }
 
+typedef struct tdVMMWINREG_QUERYBATCH_ENTRY {
+    PVMMWINREG_QUERYVALUE pv;
+    POB_REGISTRY_HIVE pObHive;
+    DWORD oValueName;               // offset of value name in wszPathKey (in chars) - 0 on bad path
+    DWORD cbBuffer;
+    WCHAR wszPathKey[MAX_PATH];
+} VMMWINREG_QUERYBATCH_ENTRY, *PVMMWINREG_QUERYBATCH_ENTRY;
+
+int VmmWinReg_ValueQueryBatch_CmpSort(PVMMWINREG_QUERYBATCH_ENTRY p1, PVMMWINREG_QUERYBATCH_ENTRY p2)
+{
+    QWORD va1 = p1->pObHive ? p1->pObHive->vaCMHIVE : 0;
+    QWORD va2 = p2->pObHive ? p2->pObHive->vaCMHIVE : 0;
+    if(va1 != va2) { return (va1 < va2) ? -1 : 1; }
+    return _wcsicmp(p1->wszPathKey, p2->wszPathKey);
+}
+
+/*
+* Read multiple registry values given their full key/value paths. Values are
+* grouped by hive and key so that each key is only resolved once.
+* -- pValues
+* -- cValues
+* -- return = number of successfully read values.
+*/
+DWORD VmmWinReg_ValueQueryBatch(_Inout_updates_(cValues) PVMMWINREG_QUERYVALUE pValues, _In_ DWORD cValues)
+{
+    DWORD i, cSuccess = 0;
+    LPWSTR wszValueName;
+    WCHAR wszPathKeyValue[MAX_PATH];
+    PVMMWINREG_QUERYVALUE pv;
+    PVMMWINREG_QUERYBATCH_ENTRY pe, pe0, peKey = NULL;
+    POB_REGISTRY_KEY pObKey = NULL;
+    POB_REGISTRY_VALUE pObKeyValue = NULL;
+    if(!cValues || !(pe0 = LocalAlloc(LMEM_ZEROINIT, cValues * sizeof(VMMWINREG_QUERYBATCH_ENTRY)))) { return 0; }
+    // 1: resolve hive and split key/value per entry
+    for(i = 0; i < cValues; i++) {
+        pe = pe0 + i;
+        pe->pv = pv = pValues + i;
+        pe->cbBuffer = pv->pbData ? pv->cbData : 0;
+        pv->cbData = 0;
+        pv->dwType = 0;
+        pv->fResult = FALSE;
+        if(pv->wszFullPathKeyValue && VmmWinReg_PathHiveGetByFullPath(pv->wszFullPathKeyValue, &pe->pObHive, wszPathKeyValue)) {
+            // store the value name as an offset - entries are moved by the sort.
+            if((wszValueName = Util_PathFileSplitW(wszPathKeyValue, pe->wszPathKey))) {
+                pe->oValueName = (DWORD)(wszValueName - pe->wszPathKey);
+            }
+        }
+    }
+    // 2: sort on hive and key and read values - resolving each key once
+    qsort(pe0, cValues, sizeof(VMMWINREG_QUERYBATCH_ENTRY), (_CoreCrtNonSecureSearchSortCompareFunction)VmmWinReg_ValueQueryBatch_CmpSort);
+    for(i = 0; i < cValues; i++) {
+        pe = pe0 + i;
+        if(!pe->oValueName) { continue; }
+        if(!peKey || (peKey->pObHive != pe->pObHive) || _wcsicmp(peKey->wszPathKey, pe->wszPathKey)) {
+            Ob_DECREF_NULL(&pObKey);
+            peKey = pe;
+            if(VmmWinReg_HiveSnapshotEnsure(pe->pObHive)) {
+                pObKey = VmmWinReg_KeyGetByPath(pe->pObHive, pe->wszPathKey);
+            }
+        }
+        if(pObKey && (pObKeyValue = VmmWinReg_ValueByKeyAndName(pe->pObHive, pObKey, pe->wszPathKey + pe->oValueName))) {
+            pv = pe->pv;
+            pv->fResult = pv->pbData ?
+                VmmWinReg_ValueQueryInternal(pe->pObHive, pObKeyValue, &pv->dwType, NULL, pv->pbData, pe->cbBuffer, &pv->cbData, 0) :
+                VmmWinReg_ValueQueryInternal(pe->pObHive, pObKeyValue, &pv->dwType, &pv->cbData, NULL, 0, NULL, 0);
+            if(pv->fResult) { cSuccess++; }
+            Ob_DECREF_NULL(&pObKeyValue);
+        }
+    }
+    Ob_DECREF(pObKey);
+    for(i = 0; i < cValues; i++) {
+        Ob_DECREF(pe0[i].pObHive);
+    }
+    LocalFree(pe0);
+    return cSuccess;
+}
+
 /*
 * Read a registry value - similar to WINAPI function 'RegQueryValueEx'.
 * -- pHive
@@ -2112,7 +2600,7 @@ VOID VmmWinReg_ForensicGetAllKeys(_In_ POB_REGISTRY_HIVE pHive, _In_ HANDLE hCal
     WCHAR wszFullPath[2048];
     LPWSTR wszHiveName;
     POB_REGISTRY_KEY pObKey;
-    if(VmmWinReg_HiveSnapshotEnsure(pHive)) {
+    if(VmmWinReg_HiveSnapshotEnsureFull(pHive)) {
         wszHiveName = pHive->wszHiveRootPath + (wcsncmp(pHive->wszHiveRootPath, L"\\REGISTRY", 9) ? 0 : 9);
         c = ObMap_Size(pHive->Snapshot.pmKeyOffset);
         for(i = 0; i < c; i++) {
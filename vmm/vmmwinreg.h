@@ -24,14 +24,17 @@ typedef struct tdOB_REGISTRY_HIVE {
         QWORD vaHMAP_TABLE_SmallDir;
     } _DUAL[2];
     CRITICAL_SECTION LockUpdate;
+    struct tdOB_REGISTRY_PATHINDEX *pObPathIndex;   // path hash -> key cell offset - kept over refreshes of unchanged hive
     // snapshot functionality below - VmmWinReg_EnsureSnapshot() must be called before access!
     struct {
         BOOL fInitialized;
+        BOOL fLazy;             // lazy snapshot - hive data is fetched and keys are built on demand
         POB_MAP pmKeyHash;      // object map for POB_REG_KEY keyed by hash
         POB_MAP pmKeyOffset;    // object map for POB_REG_KEY keyed by offset
         struct {
             DWORD cb;
             PBYTE pb;
+            PBYTE pbChunkValid; // lazy snapshot: per-chunk fetched flag
         } _DUAL[2];
     } Snapshot;
 } OB_REGISTRY_HIVE, *POB_REGISTRY_HIVE;
@@ -293,6 +296,36 @@ BOOL VmmWinReg_ValueQuery3(_In_ POB_REGISTRY_HIVE pHive, _In_ LPWSTR wszPathKeyV
 _Success_(return)
 BOOL VmmWinReg_ValueQuery4(_In_ POB_REGISTRY_HIVE pHive, _In_ POB_REGISTRY_VALUE pKeyValue, _Out_opt_ PDWORD pdwType, _Out_writes_opt_(cbData) PBYTE pbData, _In_ DWORD cbData, _Out_opt_ PDWORD pcbData);
 
+typedef struct tdVMMWINREG_QUERYVALUE {
+    LPWSTR wszFullPathKeyValue;
+    PBYTE pbData;
+    DWORD cbData;
+    DWORD dwType;
+    BOOL fResult;
+} VMMWINREG_QUERYVALUE, *PVMMWINREG_QUERYVALUE;
+
+/*
+* Read multiple registry values given their full key/value paths. Values are
+* grouped by hive and key so that each key is only resolved once. Each entry
+* is handled as in VmmWinReg_ValueQuery2 - with cbData as in/out buffer size.
+* -- pValues
+* -- cValues
+* -- return = number of successfully read values.
+*/
+DWORD VmmWinReg_ValueQueryBatch(_Inout_updates_(cValues) PVMMWINREG_QUERYVALUE pValues, _In_ DWORD cValues);
+
+/*
+* Ensure a full snapshot of the registry hive exists - i.e. that all hive data
+* is read and all keys are indexed. The snapshot is otherwise taken on first
+* use - calling this function up front allows hives to be snapshotted in
+* parallel. This function is thread-safe and may be called on multiple hives
+* concurrently.
+* -- pHive
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinReg_HiveSnapshotEnsureFull(_In_ POB_REGISTRY_HIVE pHive);
+
 /*
 * Function to allow the forensic sub-system to request extraction of all keys
 * from a specific hive. The key information will be delivered back to the
@@ -0,0 +1,655 @@
+// vmm_bench.c - MemProcFS C/C++ VMM API benchmark
+//
+// Runs a fixed set of workloads against a device or memory dump and reports
+// throughput and latency percentiles as text or JSON. Random workloads use a
+// seeded pseudo random generator so that runs against the same memory image
+// are reproducible and comparable between builds.
+//
+// Syntax: vmm_bench.exe [bench options] <vmm initialization options>
+//   -json                  : output results as JSON instead of text.
+//   -iter <n>              : workload iteration base count (default 256).
+//   -seed <n>              : pseudo random seed (default 1).
+//   -pid <pid>             : process for virtual memory workloads (default explorer.exe, else 4).
+//   -workload <w1,w2,...>  : run only the listed workloads (default all).
+// The ob_* workloads micro-benchmark the object manager containers which are
+// compiled into vmm_bench from the vmm sources - they do not touch the target.
+// Example: vmm_bench.exe -json -device c:\dumps\WIN10-X64.raw
+//
+// (c) MemProcFS contributors, 2020
+// Author: MemProcFS contributors
+//
+
+#include <Windows.h>
+#include <stdio.h>
+#include <leechcore.h>
+#include <vmmdll.h>
+#include "../vmm/ob.h"
+
+#pragma comment(lib, "leechcore")
+#pragma comment(lib, "vmm")
+
+#define BENCH_ITER_DEFAULT          256
+#define BENCH_VIRT_PAGES_MAX        0x00100000
+#define BENCH_PHYS_SEQ_PAGES        0x100
+#define BENCH_REG_DEPTH_MAX         32
+#define BENCH_OB_VALUES             0x4000
+
+typedef struct tdBENCH_RESULT {
+    LPSTR szName;
+    QWORD cOps;
+    QWORD cOpsFail;
+    QWORD cb;                       // bytes read (0 = not applicable)
+    QWORD tmUs;                     // total wall clock time in uS
+    QWORD cPhysCacheMiss;           // physical memory cache misses during workload
+    QWORD cSampleMax;
+    PQWORD pqwSampleUs;             // per operation latency in uS
+} BENCH_RESULT, *PBENCH_RESULT;
+
+typedef struct tdBENCH_CONTEXT {
+    BOOL fJson;
+    BOOL fFirstResult;
+    DWORD cIter;
+    QWORD qwRandom;
+    DWORD dwPID;
+    LPSTR szWorkloads;
+    QWORD qwPerfFreq;
+    DWORD cPhysMap;
+    PVMMDLL_MAP_PHYSMEMENTRY pPhysMap;
+    QWORD cPhysPages;
+    DWORD cVirtPages;
+    PQWORD pvaVirtPages;
+} BENCH_CONTEXT, *PBENCH_CONTEXT;
+
+BENCH_CONTEXT ctxBench = { 0 };
+
+// ----------------------------------------------------------------------------
+// Utility functions below:
+// ----------------------------------------------------------------------------
+
+/*
+* xorshift64* pseudo random generator - reproducible given the seed.
+*/
+QWORD Bench_Random()
+{
+    ctxBench.qwRandom ^= ctxBench.qwRandom >> 12;
+    ctxBench.qwRandom ^= ctxBench.qwRandom << 25;
+    ctxBench.qwRandom ^= ctxBench.qwRandom >> 27;
+    return ctxBench.qwRandom * 0x2545F4914F6CDD1DULL;
+}
+
+QWORD Bench_TimeNow()
+{
+    QWORD tm;
+    QueryPerformanceCounter((PLARGE_INTEGER)&tm);
+    return tm;
+}
+
+QWORD Bench_TimeUs(_In_ QWORD tmStart)
+{
+    return (Bench_TimeNow() - tmStart) * 1000000ULL / ctxBench.qwPerfFreq;
+}
+
+QWORD Bench_PhysCacheMiss()
+{
+    ULONG64 qw = 0;
+    VMMDLL_ConfigGet(VMMDLL_OPT_CONFIG_STAT_CACHE_MISS | 1, &qw);
+    return qw;
+}
+
+/*
+* Drop the read, page table and paging caches so that the next workload
+* starts cold.
+*/
+VOID Bench_CacheClear()
+{
+    VMMDLL_ConfigSet(VMMDLL_OPT_REFRESH_READ, 1);
+    VMMDLL_ConfigSet(VMMDLL_OPT_REFRESH_TLB, 1);
+    VMMDLL_ConfigSet(VMMDLL_OPT_REFRESH_PAGING, 1);
+}
+
+/*
+* Check whether a workload is selected by the -workload option.
+*/
+BOOL Bench_IsSelected(_In_ LPSTR szName)
+{
+    SIZE_T cch = strlen(szName);
+    LPSTR sz = ctxBench.szWorkloads;
+    if(!sz) { return TRUE; }
+    while(sz && *sz) {
+        if(!_strnicmp(sz, szName, cch) && ((sz[cch] == ',') || (sz[cch] == 0))) { return TRUE; }
+        if((sz = strchr(sz, ','))) { sz++; }
+    }
+    return FALSE;
+}
+
+_Success_(return)
+BOOL Bench_ResultInitialize(_Out_ PBENCH_RESULT pr, _In_ LPSTR szName, _In_ QWORD cSampleMax)
+{
+    ZeroMemory(pr, sizeof(BENCH_RESULT));
+    pr->szName = szName;
+    pr->cSampleMax = max(1, cSampleMax);
+    if(!(pr->pqwSampleUs = LocalAlloc(0, pr->cSampleMax * sizeof(QWORD)))) { return FALSE; }
+    Bench_CacheClear();
+    pr->cPhysCacheMiss = Bench_PhysCacheMiss();
+    pr->tmUs = Bench_TimeNow();
+    return TRUE;
+}
+
+VOID Bench_ResultSample(_Inout_ PBENCH_RESULT pr, _In_ QWORD tmStart, _In_ BOOL fSuccess, _In_ QWORD cb)
+{
+    QWORD qwUs = Bench_TimeUs(tmStart);
+    if(pr->cOps < pr->cSampleMax) {
+        pr->pqwSampleUs[pr->cOps] = qwUs;
+    }
+    pr->cOps++;
+    if(fSuccess) {
+        pr->cb += cb;
+    } else {
+        pr->cOpsFail++;
+    }
+}
+
+int Bench_ResultSampleCompare(_In_ const void *p1, _In_ const void *p2)
+{
+    QWORD q1 = *(PQWORD)p1, q2 = *(PQWORD)p2;
+    return (q1 < q2) ? -1 : ((q1 > q2) ? 1 : 0);
+}
+
+QWORD Bench_ResultPercentile(_In_ PBENCH_RESULT pr, _In_ QWORD cSample, _In_ DWORD dwPercentile)
+{
+    if(!cSample) { return 0; }
+    return pr->pqwSampleUs[min(cSample - 1, (cSample * dwPercentile) / 100)];
+}
+
+/*
+* Finalize a workload result - print it and free the latency samples.
+*/
+VOID Bench_ResultFinish(_Inout_ PBENCH_RESULT pr)
+{
+    QWORD cSample = min(pr->cOps, pr->cSampleMax);
+    QWORD p50, p90, p99, pmax;
+    double dSec, dOpsPerSec, dMBPerSec;
+    pr->tmUs = (Bench_TimeNow() - pr->tmUs) * 1000000ULL / ctxBench.qwPerfFreq;
+    pr->cPhysCacheMiss = Bench_PhysCacheMiss() - pr->cPhysCacheMiss;
+    qsort(pr->pqwSampleUs, (SIZE_T)cSample, sizeof(QWORD), Bench_ResultSampleCompare);
+    p50 = Bench_ResultPercentile(pr, cSample, 50);
+    p90 = Bench_ResultPercentile(pr, cSample, 90);
+    p99 = Bench_ResultPercentile(pr, cSample, 99);
+    pmax = cSample ? pr->pqwSampleUs[cSample - 1] : 0;
+    dSec = pr->tmUs ? (pr->tmUs / 1000000.0) : 0.000001;
+    dOpsPerSec = pr->cOps / dSec;
+    dMBPerSec = pr->cb / dSec / (1024.0 * 1024.0);
+    if(ctxBench.fJson) {
+        printf(
+            "%s\n    { \"workload\": \"%s\", \"ops\": %lli, \"ops_fail\": %lli, \"bytes\": %lli, \"time_us\": %lli, \"ops_per_sec\": %.1f, \"mb_per_sec\": %.2f, \"p50_us\": %lli, \"p90_us\": %lli, \"p99_us\": %lli, \"max_us\": %lli, \"phys_cache_miss\": %lli }",
+            ctxBench.fFirstResult ? "" : ",",
+            pr->szName, pr->cOps, pr->cOpsFail, pr->cb, pr->tmUs, dOpsPerSec, dMBPerSec, p50, p90, p99, pmax, pr->cPhysCacheMiss);
+    } else {
+        printf(
+            "%-18s %9lli %7lli %10.1f %9.2f %9lli %9lli %9lli %10lli %10lli\n",
+            pr->szName, pr->cOps, pr->cOpsFail, dOpsPerSec, dMBPerSec, p50, p90, p99, pmax, pr->cPhysCacheMiss);
+    }
+    ctxBench.fFirstResult = FALSE;
+    LocalFree(pr->pqwSampleUs);
+    pr->pqwSampleUs = NULL;
+}
+
+/*
+* Retrieve a random physical page address from the physical memory map.
+*/
+QWORD Bench_PhysRandomPage()
+{
+    DWORD i;
+    QWORD iPage = Bench_Random() % ctxBench.cPhysPages;
+    for(i = 0; i < ctxBench.cPhysMap; i++) {
+        if(iPage < (ctxBench.pPhysMap[i].cb >> 12)) {
+            return (ctxBench.pPhysMap[i].pa & ~0xfff) + (iPage << 12);
+        }
+        iPage -= ctxBench.pPhysMap[i].cb >> 12;
+    }
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Setup functions below:
+// ----------------------------------------------------------------------------
+
+/*
+* Load the physical memory map - fall back to a single range up to the max
+* physical address if no memory map is available.
+*/
+_Success_(return)
+BOOL Bench_SetupPhys()
+{
+    DWORD i, cb = 0;
+    ULONG64 paMax = 0;
+    PVMMDLL_MAP_PHYSMEM pPhysMemMap = NULL;
+    if(VMMDLL_Map_GetPhysMem(NULL, &cb) && cb && (pPhysMemMap = LocalAlloc(0, cb)) && VMMDLL_Map_GetPhysMem(pPhysMemMap, &cb) && pPhysMemMap->cMap) {
+        ctxBench.cPhysMap = pPhysMemMap->cMap;
+        if(!(ctxBench.pPhysMap = LocalAlloc(0, ctxBench.cPhysMap * sizeof(VMMDLL_MAP_PHYSMEMENTRY)))) { goto fail; }
+        memcpy(ctxBench.pPhysMap, pPhysMemMap->pMap, ctxBench.cPhysMap * sizeof(VMMDLL_MAP_PHYSMEMENTRY));
+    } else {
+        if(!VMMDLL_ConfigGet(VMMDLL_OPT_CORE_MAX_NATIVE_ADDRESS, &paMax) || (paMax < 0x1000)) { goto fail; }
+        if(!(ctxBench.pPhysMap = LocalAlloc(0, sizeof(VMMDLL_MAP_PHYSMEMENTRY)))) { goto fail; }
+        ctxBench.cPhysMap = 1;
+        ctxBench.pPhysMap[0].pa = 0;
+        ctxBench.pPhysMap[0].cb = (paMax + 1) & ~0xfff;
+    }
+    for(i = 0; i < ctxBench.cPhysMap; i++) {
+        ctxBench.cPhysPages += ctxBench.pPhysMap[i].cb >> 12;
+    }
+    LocalFree(pPhysMemMap);
+    return ctxBench.cPhysPages > 0;
+fail:
+    LocalFree(pPhysMemMap);
+    return FALSE;
+}
+
+/*
+* Collect the virtual addresses of the mapped pages of the benchmark process.
+*/
+_Success_(return)
+BOOL Bench_SetupVirt()
+{
+    DWORD i, cb = 0;
+    QWORD iPage;
+    PVMMDLL_MAP_PTE pPteMap = NULL;
+    PVMMDLL_MAP_PTEENTRY pe;
+    if(!ctxBench.dwPID && !VMMDLL_PidGetFromName("explorer.exe", &ctxBench.dwPID)) {
+        ctxBench.dwPID = 4;
+    }
+    if(!VMMDLL_ProcessMap_GetPte(ctxBench.dwPID, NULL, &cb, FALSE) || !cb) { goto fail; }
+    if(!(pPteMap = LocalAlloc(0, cb))) { goto fail; }
+    if(!VMMDLL_ProcessMap_GetPte(ctxBench.dwPID, pPteMap, &cb, FALSE)) { goto fail; }
+    if(!(ctxBench.pvaVirtPages = LocalAlloc(0, BENCH_VIRT_PAGES_MAX * sizeof(QWORD)))) { goto fail; }
+    for(i = 0; (i < pPteMap->cMap) && (ctxBench.cVirtPages < BENCH_VIRT_PAGES_MAX); i++) {
+        pe = pPteMap->pMap + i;
+        for(iPage = 0; (iPage < pe->cPages) && (ctxBench.cVirtPages < BENCH_VIRT_PAGES_MAX); iPage++) {
+            ctxBench.pvaVirtPages[ctxBench.cVirtPages++] = pe->vaBase + (iPage << 12);
+        }
+    }
+    LocalFree(pPteMap);
+    return ctxBench.cVirtPages > 0;
+fail:
+    LocalFree(pPteMap);
+    return FALSE;
+}
+
+// ----------------------------------------------------------------------------
+// Workloads below:
+// ----------------------------------------------------------------------------
+
+VOID Bench_PhysRandom()
+{
+    DWORD i, cOps = ctxBench.cIter * 16;
+    QWORD tmStart;
+    BOOL fResult;
+    BYTE pbPage[0x1000];
+    BENCH_RESULT r;
+    if(!ctxBench.cPhysPages || !Bench_ResultInitialize(&r, "phys_random", cOps)) { return; }
+    for(i = 0; i < cOps; i++) {
+        tmStart = Bench_TimeNow();
+        fResult = VMMDLL_MemReadEx((DWORD)-1, Bench_PhysRandomPage(), pbPage, 0x1000, NULL, VMMDLL_FLAG_NOCACHE);
+        Bench_ResultSample(&r, tmStart, fResult, 0x1000);
+    }
+    Bench_ResultFinish(&r);
+}
+
+VOID Bench_PhysSequential()
+{
+    DWORD i, iMap = 0, cRead, cOps = ctxBench.cIter;
+    QWORD tmStart, pa, paEnd;
+    PPMEM_SCATTER ppMEMs = NULL;
+    BENCH_RESULT r;
+    if(!ctxBench.cPhysPages || !LcAllocScatter1(BENCH_PHYS_SEQ_PAGES, &ppMEMs)) { return; }
+    if(!Bench_ResultInitialize(&r, "phys_sequential", cOps)) { goto fail; }
+    pa = ctxBench.pPhysMap[0].pa & ~0xfff;
+    while(r.cOps < cOps) {
+        paEnd = ctxBench.pPhysMap[iMap].pa + ctxBench.pPhysMap[iMap].cb;
+        for(i = 0; (i < BENCH_PHYS_SEQ_PAGES) && (pa < paEnd); i++, pa += 0x1000) {
+            ppMEMs[i]->qwA = pa;
+            ppMEMs[i]->f = FALSE;
+        }
+        if(pa >= paEnd) {
+            iMap = (iMap + 1) % ctxBench.cPhysMap;
+            pa = ctxBench.pPhysMap[iMap].pa & ~0xfff;
+        }
+        if(!i) { continue; }
+        tmStart = Bench_TimeNow();
+        cRead = VMMDLL_MemReadScatter((DWORD)-1, ppMEMs, i, VMMDLL_FLAG_NOCACHE);
+        Bench_ResultSample(&r, tmStart, cRead > 0, (QWORD)cRead << 12);
+    }
+    Bench_ResultFinish(&r);
+fail:
+    LcMemFree(ppMEMs);
+}
+
+VOID Bench_VirtScatter(_In_ LPSTR szName, _In_ DWORD cBatch)
+{
+    DWORD i, iOp, cRead, cOps = ctxBench.cIter;
+    QWORD tmStart;
+    PPMEM_SCATTER ppMEMs = NULL;
+    BENCH_RESULT r;
+    if(!ctxBench.cVirtPages || !LcAllocScatter1(cBatch, &ppMEMs)) { return; }
+    if(!Bench_ResultInitialize(&r, szName, cOps)) { goto fail; }
+    for(iOp = 0; iOp < cOps; iOp++) {
+        for(i = 0; i < cBatch; i++) {
+            ppMEMs[i]->qwA = ctxBench.pvaVirtPages[Bench_Random() % ctxBench.cVirtPages];
+            ppMEMs[i]->f = FALSE;
+        }
+        tmStart = Bench_TimeNow();
+        cRead = VMMDLL_MemReadScatter(ctxBench.dwPID, ppMEMs, cBatch, 0);
+        Bench_ResultSample(&r, tmStart, cRead > 0, (QWORD)cRead << 12);
+    }
+    Bench_ResultFinish(&r);
+fail:
+    LcMemFree(ppMEMs);
+}
+
+VOID Bench_Virt2Phys()
+{
+    DWORD i, cOps = ctxBench.cIter * 16;
+    QWORD tmStart;
+    ULONG64 pa;
+    BOOL fResult;
+    BENCH_RESULT r;
+    if(!ctxBench.cVirtPages || !Bench_ResultInitialize(&r, "virt2phys", cOps)) { return; }
+    for(i = 0; i < cOps; i++) {
+        tmStart = Bench_TimeNow();
+        fResult = VMMDLL_MemVirt2Phys(ctxBench.dwPID, ctxBench.pvaVirtPages[Bench_Random() % ctxBench.cVirtPages], &pa);
+        Bench_ResultSample(&r, tmStart, fResult, 0);
+    }
+    Bench_ResultFinish(&r);
+}
+
+typedef BOOL(*PFN_BENCH_MAP)(_In_ DWORD dwPID, _Out_writes_bytes_opt_(*pcb) PBYTE pb, _Inout_ PDWORD pcb);
+
+BOOL Bench_MapPte(_In_ DWORD dwPID, _Out_writes_bytes_opt_(*pcb) PBYTE pb, _Inout_ PDWORD pcb) { return VMMDLL_ProcessMap_GetPte(dwPID, (PVMMDLL_MAP_PTE)pb, pcb, TRUE); }
+BOOL Bench_MapVad(_In_ DWORD dwPID, _Out_writes_bytes_opt_(*pcb) PBYTE pb, _Inout_ PDWORD pcb) { return VMMDLL_ProcessMap_GetVad(dwPID, (PVMMDLL_MAP_VAD)pb, pcb, TRUE); }
+BOOL Bench_MapModule(_In_ DWORD dwPID, _Out_writes_bytes_opt_(*pcb) PBYTE pb, _Inout_ PDWORD pcb) { return VMMDLL_ProcessMap_GetModule(dwPID, (PVMMDLL_MAP_MODULE)pb, pcb); }
+BOOL Bench_MapHeap(_In_ DWORD dwPID, _Out_writes_bytes_opt_(*pcb) PBYTE pb, _Inout_ PDWORD pcb) { return VMMDLL_ProcessMap_GetHeap(dwPID, (PVMMDLL_MAP_HEAP)pb, pcb); }
+BOOL Bench_MapThread(_In_ DWORD dwPID, _Out_writes_bytes_opt_(*pcb) PBYTE pb, _Inout_ PDWORD pcb) { return VMMDLL_ProcessMap_GetThread(dwPID, (PVMMDLL_MAP_THREAD)pb, pcb); }
+BOOL Bench_MapHandle(_In_ DWORD dwPID, _Out_writes_bytes_opt_(*pcb) PBYTE pb, _Inout_ PDWORD pcb) { return VMMDLL_ProcessMap_GetHandle(dwPID, (PVMMDLL_MAP_HANDLE)pb, pcb); }
+
+/*
+* Build a map type for all processes - one operation per process. Process
+* maps are cleared by a full refresh before the workload starts.
+*/
+VOID Bench_Map(_In_ LPSTR szName, _In_ PFN_BENCH_MAP pfn)
+{
+    DWORD i, cb;
+    ULONG64 cPIDs = 0;
+    PDWORD pPIDs = NULL;
+    PBYTE pb;
+    QWORD tmStart;
+    BOOL fResult;
+    BENCH_RESULT r;
+    VMMDLL_ConfigSet(VMMDLL_OPT_REFRESH_ALL, 1);
+    if(!VMMDLL_PidList(NULL, &cPIDs) || !cPIDs) { return; }
+    if(!(pPIDs = LocalAlloc(0, (SIZE_T)cPIDs * sizeof(DWORD)))) { return; }
+    if(!VMMDLL_PidList(pPIDs, &cPIDs)) { goto fail; }
+    if(!Bench_ResultInitialize(&r, szName, cPIDs)) { goto fail; }
+    for(i = 0; i < cPIDs; i++) {
+        cb = 0;
+        pb = NULL;
+        tmStart = Bench_TimeNow();
+        fResult = pfn(pPIDs[i], NULL, &cb) && cb && (pb = LocalAlloc(0, cb)) && pfn(pPIDs[i], pb, &cb);
+        Bench_ResultSample(&r, tmStart, fResult, 0);
+        LocalFree(pb);
+    }
+    Bench_ResultFinish(&r);
+fail:
+    LocalFree(pPIDs);
+}
+
+/*
+* Build the PTE map for all processes with the vectorized or the scalar x64
+* page table verify function so that both can be compared in the same run.
+* The previous verify mode is restored afterwards. Skipped if not x64.
+*/
+VOID Bench_TlbVerify(_In_ LPSTR szName, _In_ BOOL fVector)
+{
+    ULONG64 qwVectorPrevious = 1;
+    VMMDLL_ConfigGet(VMMDLL_OPT_CONFIG_TLB_VERIFY_VECTOR, &qwVectorPrevious);
+    if(!VMMDLL_ConfigSet(VMMDLL_OPT_CONFIG_TLB_VERIFY_VECTOR, fVector ? 1 : 0)) { return; }
+    Bench_Map(szName, Bench_MapPte);
+    VMMDLL_ConfigSet(VMMDLL_OPT_CONFIG_TLB_VERIFY_VECTOR, qwVectorPrevious);
+}
+
+/*
+* Unique, non-zero and well spread container test value.
+*/
+#define BENCH_OB_VALUE(i)           ((QWORD)((i) + 1) * 0x9E3779B97F4A7C15ULL)
+
+/*
+* Fill a new ObSet with BENCH_OB_VALUES values (growing it into large mode),
+* look up all values and as many absent values, then remove all values. One
+* operation per set.
+*/
+VOID Bench_ObSet(_In_ LPSTR szName, _In_ QWORD flags)
+{
+    DWORD i, iOp, cHit, cOps = max(16, ctxBench.cIter / 4);
+    QWORD tmStart;
+    POB_SET pObSet;
+    BENCH_RESULT r;
+    if(!Bench_ResultInitialize(&r, szName, cOps)) { return; }
+    for(iOp = 0; iOp < cOps; iOp++) {
+        tmStart = Bench_TimeNow();
+        cHit = 0;
+        if((pObSet = ObSet_NewEx(flags))) {
+            for(i = 0; i < BENCH_OB_VALUES; i++) {
+                ObSet_Push(pObSet, BENCH_OB_VALUE(i));
+            }
+            for(i = 0; i < 2 * BENCH_OB_VALUES; i++) {
+                if(ObSet_Exists(pObSet, BENCH_OB_VALUE(i))) { cHit++; }
+            }
+            for(i = 0; i < BENCH_OB_VALUES; i++) {
+                ObSet_Remove(pObSet, BENCH_OB_VALUE(i));
+            }
+            cHit = ObSet_Size(pObSet) ? 0 : cHit;
+            Ob_DECREF(pObSet);
+        }
+        Bench_ResultSample(&r, tmStart, (cHit == BENCH_OB_VALUES), 0);
+    }
+    Bench_ResultFinish(&r);
+}
+
+/*
+* Same pattern as Bench_ObSet for a keyed ObMap: lookups are done both by key
+* and by value.
+*/
+VOID Bench_ObMap()
+{
+    DWORD i, iOp, cHit, cOps = max(16, ctxBench.cIter / 4);
+    QWORD tmStart;
+    POB_MAP pObMap;
+    BENCH_RESULT r;
+    if(!Bench_ResultInitialize(&r, "ob_map", cOps)) { return; }
+    for(iOp = 0; iOp < cOps; iOp++) {
+        tmStart = Bench_TimeNow();
+        cHit = 0;
+        if((pObMap = ObMap_New(0))) {
+            for(i = 0; i < BENCH_OB_VALUES; i++) {
+                ObMap_Push(pObMap, i, (PVOID)BENCH_OB_VALUE(i));
+            }
+            for(i = 0; i < 2 * BENCH_OB_VALUES; i++) {
+                if(ObMap_ExistsKey(pObMap, i)) { cHit++; }
+                if(ObMap_Exists(pObMap, (PVOID)BENCH_OB_VALUE(i))) { cHit++; }
+            }
+            for(i = 0; i < BENCH_OB_VALUES; i++) {
+                ObMap_RemoveByKey(pObMap, i);
+            }
+            cHit = ObMap_Size(pObMap) ? 0 : cHit;
+            Ob_DECREF(pObMap);
+        }
+        Bench_ResultSample(&r, tmStart, (cHit == 2 * BENCH_OB_VALUES), 0);
+    }
+    Bench_ResultFinish(&r);
+}
+
+VOID Bench_Refresh()
+{
+    DWORD i, cOps = max(4, ctxBench.cIter / 16);
+    QWORD tmStart;
+    BOOL fResult;
+    BENCH_RESULT r;
+    if(!Bench_ResultInitialize(&r, "refresh", cOps)) { return; }
+    for(i = 0; i < cOps; i++) {
+        tmStart = Bench_TimeNow();
+        fResult = VMMDLL_ConfigSet(VMMDLL_OPT_REFRESH_ALL, 1);
+        Bench_ResultSample(&r, tmStart, fResult, 0);
+    }
+    Bench_ResultFinish(&r);
+}
+
+/*
+* Recursively enumerate all sub-keys and values of a registry key. Each key
+* (sub-key and value enumeration) is one operation.
+*/
+VOID Bench_RegistryKey(_Inout_ PBENCH_RESULT pr, _In_ LPWSTR wszPath, _In_ DWORD dwDepth)
+{
+    DWORD i, cch, cchPath;
+    QWORD tmStart;
+    WCHAR wszName[MAX_PATH];
+    LPWSTR wszSubPath;
+    tmStart = Bench_TimeNow();
+    for(i = 0; ; i++) {
+        cch = _countof(wszName);
+        if(!VMMDLL_WinReg_EnumValueW(wszPath, i, wszName, &cch, NULL, NULL, NULL)) { break; }
+    }
+    Bench_ResultSample(pr, tmStart, TRUE, 0);
+    if(dwDepth >= BENCH_REG_DEPTH_MAX) { return; }
+    cchPath = (DWORD)wcslen(wszPath);
+    if(!(wszSubPath = LocalAlloc(0, (cchPath + 1 + MAX_PATH) * sizeof(WCHAR)))) { return; }
+    for(i = 0; ; i++) {
+        cch = _countof(wszName);
+        if(!VMMDLL_WinReg_EnumKeyExW(wszPath, i, wszName, &cch, NULL)) { break; }
+        _snwprintf_s(wszSubPath, cchPath + 1 + MAX_PATH, _TRUNCATE, L"%s\\%s", wszPath, wszName);
+        Bench_RegistryKey(pr, wszSubPath, dwDepth + 1);
+    }
+    LocalFree(wszSubPath);
+}
+
+VOID Bench_Registry()
+{
+    DWORD i, cHives = 0;
+    PVMMDLL_REGISTRY_HIVE_INFORMATION pHives = NULL;
+    WCHAR wszPath[MAX_PATH];
+    BENCH_RESULT r;
+    if(!VMMDLL_WinReg_HiveList(NULL, 0, &cHives) || !cHives) { return; }
+    if(!(pHives = LocalAlloc(0, cHives * sizeof(VMMDLL_REGISTRY_HIVE_INFORMATION)))) { return; }
+    if(!VMMDLL_WinReg_HiveList(pHives, cHives, &cHives)) { goto fail; }
+    if(!Bench_ResultInitialize(&r, "registry", 0x00100000)) { goto fail; }
+    for(i = 0; i < cHives; i++) {
+        _snwprintf_s(wszPath, _countof(wszPath), _TRUNCATE, L"0x%llx\\ROOT", pHives[i].vaCMHIVE);
+        Bench_RegistryKey(&r, wszPath, 0);
+    }
+    Bench_ResultFinish(&r);
+fail:
+    LocalFree(pHives);
+}
+
+/*
+* Forensic mode scan (in-memory database) - one operation. The forensic mode
+* cannot be reset once started - this workload should be run last.
+*/
+VOID Bench_Forensic()
+{
+    QWORD tmStart;
+    ULONG64 qwStatus = 0;
+    BENCH_RESULT r;
+    if(!VMMDLL_ConfigGet(VMMDLL_OPT_FORENSIC_INIT_STATUS, &qwStatus) || qwStatus) { return; }
+    if(!Bench_ResultInitialize(&r, "forensic", 1)) { return; }
+    tmStart = Bench_TimeNow();
+    if(VMMDLL_ConfigSet(VMMDLL_OPT_FORENSIC_MODE, 1)) {
+        while(VMMDLL_ConfigGet(VMMDLL_OPT_FORENSIC_INIT_STATUS, &qwStatus) && (qwStatus == 1)) {
+            Sleep(10);
+        }
+    }
+    Bench_ResultSample(&r, tmStart, (qwStatus == 2), 0);
+    Bench_ResultFinish(&r);
+}
+
+// ----------------------------------------------------------------------------
+// Main entry point:
+// ----------------------------------------------------------------------------
+
+int main(_In_ int argc, _In_ char* argv[])
+{
+    int i, cArgVmm = 1;
+    LPSTR *pszArgVmm;
+    ctxBench.cIter = BENCH_ITER_DEFAULT;
+    ctxBench.qwRandom = 1;
+    ctxBench.fFirstResult = TRUE;
+    QueryPerformanceFrequency((PLARGE_INTEGER)&ctxBench.qwPerfFreq);
+    // 1: parse benchmark options - remaining options are forwarded to vmm.
+    if(!(pszArgVmm = LocalAlloc(LMEM_ZEROINIT, (argc + 1) * sizeof(LPSTR)))) { return 1; }
+    pszArgVmm[0] = argv[0];
+    for(i = 1; i < argc; i++) {
+        if(!_stricmp(argv[i], "-json")) {
+            ctxBench.fJson = TRUE;
+        } else if(!_stricmp(argv[i], "-iter") && (i + 1 < argc)) {
+            ctxBench.cIter = max(1, strtoul(argv[++i], NULL, 0));
+        } else if(!_stricmp(argv[i], "-seed") && (i + 1 < argc)) {
+            ctxBench.qwRandom = max(1, _strtoui64(argv[++i], NULL, 0));
+        } else if(!_stricmp(argv[i], "-pid") && (i + 1 < argc)) {
+            ctxBench.dwPID = strtoul(argv[++i], NULL, 0);
+        } else if(!_stricmp(argv[i], "-workload") && (i + 1 < argc)) {
+            ctxBench.szWorkloads = argv[++i];
+        } else {
+            pszArgVmm[cArgVmm++] = argv[i];
+        }
+    }
+    if(cArgVmm == 1) {
+        printf(
+            "Syntax: vmm_bench.exe [-json] [-iter <n>] [-seed <n>] [-pid <pid>] [-workload <w1,w2,...>] <vmm options>\n" \
+            "Workloads: phys_random, phys_sequential, virt_scatter_1, virt_scatter_16, virt_scatter_256,\n" \
+            "           virt2phys, map_pte, map_vad, map_module, map_heap, map_thread, map_handle,\n" \
+            "           tlb_verify_scalar, tlb_verify_vector, ob_set, ob_set_nolock, ob_map,\n" \
+            "           refresh, registry, forensic\n");
+        return 1;
+    }
+    // 2: initialize vmm and benchmark targets.
+    if(!VMMDLL_Initialize(cArgVmm, pszArgVmm)) {
+        printf("FAIL: VMMDLL_Initialize\n");
+        return 1;
+    }
+    Bench_SetupPhys();
+    Bench_SetupVirt();
+    if(ctxBench.fJson) {
+        printf("{\n  \"iter\": %i, \"seed\": %lli, \"pid\": %i, \"phys_pages\": %lli, \"virt_pages\": %i,\n  \"results\": [", ctxBench.cIter, ctxBench.qwRandom, ctxBench.dwPID, ctxBench.cPhysPages, ctxBench.cVirtPages);
+    } else {
+        printf("iter: %i  seed: %lli  pid: %i  phys_pages: %lli  virt_pages: %i\n", ctxBench.cIter, ctxBench.qwRandom, ctxBench.dwPID, ctxBench.cPhysPages, ctxBench.cVirtPages);
+        printf("%-18s %9s %7s %10s %9s %9s %9s %9s %10s %10s\n", "WORKLOAD", "OPS", "FAIL", "OPS/S", "MB/S", "P50_US", "P90_US", "P99_US", "MAX_US", "CACHEMISS");
+    }
+    // 3: run workloads.
+    if(Bench_IsSelected("phys_random")) { Bench_PhysRandom(); }
+    if(Bench_IsSelected("phys_sequential")) { Bench_PhysSequential(); }
+    if(Bench_IsSelected("virt_scatter_1")) { Bench_VirtScatter("virt_scatter_1", 1); }
+    if(Bench_IsSelected("virt_scatter_16")) { Bench_VirtScatter("virt_scatter_16", 16); }
+    if(Bench_IsSelected("virt_scatter_256")) { Bench_VirtScatter("virt_scatter_256", 256); }
+    if(Bench_IsSelected("virt2phys")) { Bench_Virt2Phys(); }
+    if(Bench_IsSelected("map_pte")) { Bench_Map("map_pte", Bench_MapPte); }
+    if(Bench_IsSelected("map_vad")) { Bench_Map("map_vad", Bench_MapVad); }
+    if(Bench_IsSelected("map_module")) { Bench_Map("map_module", Bench_MapModule); }
+    if(Bench_IsSelected("map_heap")) { Bench_Map("map_heap", Bench_MapHeap); }
+    if(Bench_IsSelected("map_thread")) { Bench_Map("map_thread", Bench_MapThread); }
+    if(Bench_IsSelected("map_handle")) { Bench_Map("map_handle", Bench_MapHandle); }
+    if(Bench_IsSelected("tlb_verify_scalar")) { Bench_TlbVerify("tlb_verify_scalar", FALSE); }
+    if(Bench_IsSelected("tlb_verify_vector")) { Bench_TlbVerify("tlb_verify_vector", TRUE); }
+    if(Bench_IsSelected("ob_set")) { Bench_ObSet("ob_set", 0); }
+    if(Bench_IsSelected("ob_set_nolock")) { Bench_ObSet("ob_set_nolock", OB_SET_FLAGS_NOLOCK); }
+    if(Bench_IsSelected("ob_map")) { Bench_ObMap(); }
+    if(Bench_IsSelected("refresh")) { Bench_Refresh(); }
+    if(Bench_IsSelected("registry")) { Bench_Registry(); }
+    if(Bench_IsSelected("forensic")) { Bench_Forensic(); }
+    if(ctxBench.fJson) {
+        printf("\n  ]\n}\n");
+    }
+    // 4: cleanup.
+    VMMDLL_Close();
+    LocalFree(ctxBench.pPhysMap);
+    LocalFree(ctxBench.pvaVirtPages);
+    LocalFree(pszArgVmm);
+    return 0;
+}
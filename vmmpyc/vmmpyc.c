@@ -190,12 +190,10 @@ VMMPYC_MemReadScatter(PyObject *self, PyObject *args)
     if(!PyArg_ParseTuple(args, "kO!|k", &dwPID, &PyList_Type, &pyListSrc, &flags)) { return NULL; } // borrowed reference
     cMEMs = (DWORD)PyList_Size(pyListSrc);
     if(cMEMs == 0) { 
-        Py_DECREF(pyListSrc);
         return PyList_New(0);
     }
     // allocate
     if(!LcAllocScatter1(cMEMs, &ppMEMs)) {
-        Py_DECREF(pyListSrc);
         return PyErr_NoMemory();
     }
     // iterate over # entries and build scatter data structure
@@ -203,13 +201,11 @@ VMMPYC_MemReadScatter(PyObject *self, PyObject *args)
         pMEM = ppMEMs[i];
         pyListItemSrc = PyList_GetItem(pyListSrc, i); // borrowed reference
         if(!pyListItemSrc || !PyLong_Check(pyListItemSrc)) {
-            Py_DECREF(pyListSrc);
             LcMemFree(ppMEMs);
             return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemReadScatter: Argument list contains non numeric item.");
         }
         pMEM->qwA = PyLong_AsUnsignedLongLong(pyListItemSrc);
     }
-    Py_DECREF(pyListSrc);
     // call c-dll for vmm
     Py_BEGIN_ALLOW_THREADS;
     result = VMMDLL_MemReadScatter(dwPID, ppMEMs, cMEMs, flags);
@@ -236,31 +232,262 @@ VMMPYC_MemReadScatter(PyObject *self, PyObject *args)
     return pyListDst;
 }
 
+// (DWORD, [(ULONG64, DWORD)], (DWORD)) -> [PBYTE]
+static PyObject*
+VMMPYC_MemReadScatterEx(PyObject *self, PyObject *args)
+{
+    PyObject *pyListSrc, *pyListItemSrc, *pyListDst;
+    BOOL result;
+    DWORD dwPID, cItems, flags = 0, cb, cbMax = 0;
+    ULONG64 i, va;
+    PBYTE pb = NULL;
+    VMMDLL_SCATTER_HANDLE hS;
+    if(!PyArg_ParseTuple(args, "kO!|k", &dwPID, &PyList_Type, &pyListSrc, &flags)) { return NULL; } // borrowed reference
+    cItems = (DWORD)PyList_Size(pyListSrc);
+    if(cItems == 0) {
+        return PyList_New(0);
+    }
+    if(!(hS = VMMDLL_Scatter_Initialize(dwPID, flags))) {
+        return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemReadScatterEx: Failed.");
+    }
+    // iterate over # entries and prepare scatter handle
+    for(i = 0; i < cItems; i++) {
+        pyListItemSrc = PyList_GetItem(pyListSrc, i); // borrowed reference
+        if(!pyListItemSrc || !PyArg_ParseTuple(pyListItemSrc, "Kk", &va, &cb)) {
+            VMMDLL_Scatter_CloseHandle(hS);
+            PyErr_Clear();
+            return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemReadScatterEx: Argument list contains non (address, size) item.");
+        }
+        if(cb > 0x01000000) {
+            VMMDLL_Scatter_CloseHandle(hS);
+            return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemReadScatterEx: Read larger than maximum supported (0x01000000) bytes requested.");
+        }
+        if(cb) { VMMDLL_Scatter_Prepare(hS, va, cb); }
+        cbMax = max(cbMax, cb);
+    }
+    // call c-dll for vmm
+    Py_BEGIN_ALLOW_THREADS;
+    result = VMMDLL_Scatter_Execute(hS);
+    Py_END_ALLOW_THREADS;
+    if(!result) {
+        VMMDLL_Scatter_CloseHandle(hS);
+        return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemReadScatterEx: Failed.");
+    }
+    if(!(pb = LocalAlloc(0, max(1, cbMax))) || !(pyListDst = PyList_New(0))) {
+        VMMDLL_Scatter_CloseHandle(hS);
+        LocalFree(pb);
+        return PyErr_NoMemory();
+    }
+    for(i = 0; i < cItems; i++) {
+        PyArg_ParseTuple(PyList_GetItem(pyListSrc, i), "Kk", &va, &cb);
+        VMMDLL_Scatter_Read(hS, va, cb, pb, NULL);
+        PyList_Append_DECREF(pyListDst, PyBytes_FromStringAndSize(pb, cb));
+    }
+    VMMDLL_Scatter_CloseHandle(hS);
+    LocalFree(pb);
+    return pyListDst;
+}
+
 // (DWORD, ULONG64, DWORD, (ULONG64)) -> PBYTE
 static PyObject*
 VMMPYC_MemRead(PyObject *self, PyObject *args)
 {
-    PyObject *pyBytes;
+    PyObject *pyBytes, *pyBytesResult;
     BOOL result;
     DWORD dwPID, cb, cbRead = 0;
     ULONG64 qwA, flags = 0;
     PBYTE pb;
     if(!PyArg_ParseTuple(args, "kKk|K", &dwPID, &qwA, &cb, &flags)) { return NULL; }
     if(cb > 0x01000000) { return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemRead: Read larger than maximum supported (0x01000000) bytes requested."); }
-    pb = LocalAlloc(0, cb);
-    if(!pb) { return PyErr_NoMemory(); }
+    // read directly into the not yet shared result bytes object to avoid a copy
+    if(!(pyBytes = PyBytes_FromStringAndSize(NULL, cb))) { return NULL; }
+    pb = (PBYTE)PyBytes_AsString(pyBytes);
     Py_BEGIN_ALLOW_THREADS;
     result = VMMDLL_MemReadEx(dwPID, qwA, pb, cb, &cbRead, flags);
     Py_END_ALLOW_THREADS;
     if(!result) { 
-        LocalFree(pb);
+        Py_DECREF(pyBytes);
         return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemRead: Failed.");
     }
-    pyBytes = PyBytes_FromStringAndSize(pb, cbRead);
-    LocalFree(pb);
+    if(cbRead != cb) {
+        // partial read - resize is unavailable in the limited api -> copy.
+        pyBytesResult = PyBytes_FromStringAndSize(pb, cbRead);
+        Py_DECREF(pyBytes);
+        return pyBytesResult;
+    }
     return pyBytes;
 }
 
+// The buffer protocol (Py_buffer) is not part of the limited api (3.6) targeted
+// by vmmpyc - read-into functions therefore fill a caller supplied bytearray.
+// Memory is read directly into the bytearray storage without intermediate
+// copies. Without the buffer protocol the storage can't be locked against
+// resizing by other python threads - the GIL is therefore kept during reads.
+
+// (DWORD, ULONG64, BYTEARRAY, (ULONG64)) -> DWORD
+static PyObject*
+VMMPYC_MemReadInto(PyObject *self, PyObject *args)
+{
+    PyObject *pyByteArray;
+    BOOL result;
+    DWORD dwPID, cb, cbRead = 0;
+    ULONG64 qwA, flags = 0;
+    Py_ssize_t len;
+    PBYTE pb;
+    if(!PyArg_ParseTuple(args, "kKO!|K", &dwPID, &qwA, &PyByteArray_Type, &pyByteArray, &flags)) { return NULL; }   // borrowed reference
+    len = PyByteArray_Size(pyByteArray);
+    if(len > 0x01000000) { return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemReadInto: Read larger than maximum supported (0x01000000) bytes requested."); }
+    if(!(cb = (DWORD)len)) { return PyLong_FromUnsignedLong(0); }
+    if(!(pb = (PBYTE)PyByteArray_AsString(pyByteArray))) { return NULL; }
+    // NB! GIL is kept - the bytearray storage must not be resized during read.
+    result = VMMDLL_MemReadEx(dwPID, qwA, pb, cb, &cbRead, flags);
+    if(!result) {
+        return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemReadInto: Failed.");
+    }
+    return PyLong_FromUnsignedLong(cbRead);
+}
+
+// (DWORD, [ULONG64], BYTEARRAY, (DWORD)) -> [BOOL]
+static PyObject*
+VMMPYC_MemReadScatterInto(PyObject *self, PyObject *args)
+{
+    PyObject *pyListSrc, *pyListItemSrc, *pyListDst, *pyByteArray;
+    DWORD dwPID, cMEMs, flags = 0;
+    ULONG64 i;
+    PBYTE pb;
+    PPMEM_SCATTER ppMEMs = NULL;
+    if(!PyArg_ParseTuple(args, "kO!O!|k", &dwPID, &PyList_Type, &pyListSrc, &PyByteArray_Type, &pyByteArray, &flags)) { return NULL; } // borrowed reference
+    cMEMs = (DWORD)PyList_Size(pyListSrc);
+    if(cMEMs == 0) {
+        return PyList_New(0);
+    }
+    if((ULONG64)PyByteArray_Size(pyByteArray) < (ULONG64)cMEMs * 0x1000) {
+        return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemReadScatterInto: Buffer too small - 0x1000 bytes per address required.");
+    }
+    // pages are read directly into the caller supplied bytearray.
+    if(!(pb = (PBYTE)PyByteArray_AsString(pyByteArray))) { return NULL; }
+    if(!LcAllocScatter2(cMEMs * 0x1000, pb, cMEMs, &ppMEMs)) {
+        return PyErr_NoMemory();
+    }
+    for(i = 0; i < cMEMs; i++) {
+        pyListItemSrc = PyList_GetItem(pyListSrc, i); // borrowed reference
+        if(!pyListItemSrc || !PyLong_Check(pyListItemSrc)) {
+            LcMemFree(ppMEMs);
+            return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemReadScatterInto: Argument list contains non numeric item.");
+        }
+        ppMEMs[i]->qwA = PyLong_AsUnsignedLongLong(pyListItemSrc) & ~0xfff;
+    }
+    // NB! GIL is kept - the bytearray storage must not be resized during read.
+    VMMDLL_MemReadScatter(dwPID, ppMEMs, cMEMs, flags);
+    if(!(pyListDst = PyList_New(0))) {
+        LcMemFree(ppMEMs);
+        return PyErr_NoMemory();
+    }
+    for(i = 0; i < cMEMs; i++) {
+        PyList_Append_DECREF(pyListDst, PyBool_FromLong(ppMEMs[i]->f));
+    }
+    LcMemFree(ppMEMs);
+    return pyListDst;
+}
+
+typedef struct tdVMMPYC_MEMSEARCH_RESULT {
+    DWORD cMax;
+    DWORD c;
+    struct {
+        DWORD dwPID;
+        DWORD iSearch;
+        QWORD va;
+    } *pe;
+} VMMPYC_MEMSEARCH_RESULT, *PVMMPYC_MEMSEARCH_RESULT;
+
+// search result callback - called with the GIL released but never concurrently.
+BOOL VMMPYC_MemSearch_ResultCB(_In_ PVMMDLL_MEM_SEARCH_CONTEXT ctx, _In_ DWORD dwPID, _In_ QWORD va, _In_ DWORD iSearch)
+{
+    PVMMPYC_MEMSEARCH_RESULT pr = (PVMMPYC_MEMSEARCH_RESULT)ctx->pvUserPtrOpt;
+    if(pr->c >= pr->cMax) { return FALSE; }
+    pr->pe[pr->c].dwPID = dwPID;
+    pr->pe[pr->c].iSearch = iSearch;
+    pr->pe[pr->c].va = va;
+    pr->c++;
+    return pr->c < pr->cMax;
+}
+
+// (DWORD, [PBYTE|(PBYTE, (PBYTE), (DWORD))], (ULONG64), (ULONG64), (DWORD), (DWORD), (BOOL), (BOOL)) -> [(DWORD, ULONG64, DWORD)]
+static PyObject*
+VMMPYC_MemSearch(PyObject *self, PyObject *args)
+{
+    PyObject *pyListSrc, *pyListItemSrc, *pyPattern, *pyMask, *pyListDst;
+    BOOL result, fForceW = FALSE, fForceX = FALSE;
+    DWORD i, dwPID, cbAlign, cMaxResult = 0x10000, flags = 0;
+    ULONG64 vaMin = 0, vaMax = 0;
+    char *pb;
+    Py_ssize_t cb;
+    PVMMDLL_MEM_SEARCH_CONTEXT ctx = NULL;
+    VMMPYC_MEMSEARCH_RESULT Result = { 0 };
+    if(!PyArg_ParseTuple(args, "kO!|KKkkpp", &dwPID, &PyList_Type, &pyListSrc, &vaMin, &vaMax, &cMaxResult, &flags, &fForceW, &fForceX)) { return NULL; } // borrowed reference
+    if(!cMaxResult || (cMaxResult > 0x01000000)) { return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemSearch: Invalid max results (1-0x01000000)."); }
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMDLL_MEM_SEARCH_CONTEXT)))) { return PyErr_NoMemory(); }
+    ctx->dwVersion = VMMDLL_MEM_SEARCH_VERSION;
+    ctx->cSearch = (DWORD)PyList_Size(pyListSrc);
+    if(!ctx->cSearch || (ctx->cSearch > VMMDLL_MEM_SEARCH_MAX)) {
+        LocalFree(ctx);
+        return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemSearch: Search list must contain 1-%i items.", VMMDLL_MEM_SEARCH_MAX);
+    }
+    for(i = 0; i < ctx->cSearch; i++) {
+        pyListItemSrc = PyList_GetItem(pyListSrc, i);   // borrowed reference
+        pyPattern = pyListItemSrc;
+        pyMask = NULL;
+        cbAlign = 0;
+        if(pyListItemSrc && PyTuple_Check(pyListItemSrc) && !PyArg_ParseTuple(pyListItemSrc, "O|Ok", &pyPattern, &pyMask, &cbAlign)) { pyPattern = NULL; }
+        if(!pyPattern || !PyBytes_Check(pyPattern) || PyBytes_AsStringAndSize(pyPattern, &pb, &cb) || !cb || (cb > VMMDLL_MEM_SEARCH_MAXLENGTH)) {
+            LocalFree(ctx);
+            PyErr_Clear();
+            return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemSearch: Search item %i is not bytes of length 1-%i or (bytes, mask, align) tuple.", i, VMMDLL_MEM_SEARCH_MAXLENGTH);
+        }
+        ctx->search[i].cb = (DWORD)cb;
+        ctx->search[i].cbAlign = cbAlign;
+        memcpy(ctx->search[i].pb, pb, cb);
+        if(pyMask && (pyMask != Py_None)) {
+            if(!PyBytes_Check(pyMask) || PyBytes_AsStringAndSize(pyMask, &pb, &cb) || (cb != ctx->search[i].cb)) {
+                LocalFree(ctx);
+                PyErr_Clear();
+                return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemSearch: Search item %i mask is not bytes of pattern length.", i);
+            }
+            memcpy(ctx->search[i].pbSkipMask, pb, cb);
+        }
+    }
+    ctx->vaMin = vaMin;
+    ctx->vaMax = vaMax;
+    ctx->ReadFlags = flags;
+    ctx->fForceW = fForceW;
+    ctx->fForceX = fForceX;
+    ctx->cMaxResult = cMaxResult;
+    ctx->pvUserPtrOpt = &Result;
+    ctx->pfnResultOptCB = VMMPYC_MemSearch_ResultCB;
+    Result.cMax = cMaxResult;
+    if(!(Result.pe = LocalAlloc(0, cMaxResult * sizeof(Result.pe[0])))) {
+        LocalFree(ctx);
+        return PyErr_NoMemory();
+    }
+    Py_BEGIN_ALLOW_THREADS;
+    result = VMMDLL_MemSearch(dwPID, ctx);
+    Py_END_ALLOW_THREADS;
+    LocalFree(ctx);
+    if(!result) {
+        LocalFree(Result.pe);
+        return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MemSearch: Failed.");
+    }
+    if(!(pyListDst = PyList_New(0))) {
+        LocalFree(Result.pe);
+        return PyErr_NoMemory();
+    }
+    for(i = 0; i < Result.c; i++) {
+        PyList_Append_DECREF(pyListDst, Py_BuildValue("kKk", Result.pe[i].dwPID, Result.pe[i].va, Result.pe[i].iSearch));
+    }
+    LocalFree(Result.pe);
+    return pyListDst;
+}
+
 // (DWORD, ULONG64, PBYTE) -> None
 static PyObject*
 VMMPYC_MemWrite(PyObject *self, PyObject *args)
@@ -736,24 +963,20 @@ VMMPYC_MapGetPfns(PyObject *self, PyObject *args)
     if(!PyArg_ParseTuple(args, "O!", &PyList_Type, &pyListSrc)) { return NULL; }    // borrowed reference
     cPfns = (DWORD)PyList_Size(pyListSrc);
     if(cPfns == 0) {
-        Py_DECREF(pyListSrc);
         return PyDict_New();
     }
     pPfns = LocalAlloc(0, cPfns * sizeof(DWORD));
     if(!pPfns) {
-        Py_DECREF(pyListSrc);
         return PyErr_NoMemory();
     }
     for(i = 0; i < cPfns; i++) {
         pyListItemSrc = PyList_GetItem(pyListSrc, i);   // borrowed reference
         if(!pyListItemSrc || !PyLong_Check(pyListItemSrc) || (-1 == (dwPfn = PyLong_AsUnsignedLong(pyListItemSrc)))) {
-            Py_DECREF(pyListSrc);
             LocalFree(pPfns);
             return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MapGetPfns: Argument list contains non numeric item or PFN exceeding 0xffffffff.");
         }
         pPfns[i] = dwPfn;
     }
-    Py_DECREF(pyListSrc);
     // call c-dll for vmm
     Py_BEGIN_ALLOW_THREADS;
     result =
@@ -785,6 +1008,240 @@ VMMPYC_MapGetPfns(PyObject *self, PyObject *args)
     return pyDictDst;
 }
 
+
+//-----------------------------------------------------------------------------
+// PACKED MAP FUNCTIONALITY BELOW:
+// Large maps are returned as a single bytes object of fixed size little endian
+// entries without text. The layout of each entry is given by the python
+// struct format in the comment (numpy.frombuffer / struct.iter_unpack).
+//-----------------------------------------------------------------------------
+
+typedef struct tdVMMPYC_PACKED_PTEENTRY {       // '<QQQII' (32 bytes)
+    QWORD vaBase;
+    QWORD cPages;
+    QWORD fPage;
+    DWORD cSoftware;
+    DWORD fWoW64;
+} VMMPYC_PACKED_PTEENTRY, *PVMMPYC_PACKED_PTEENTRY;
+
+typedef struct tdVMMPYC_PACKED_VADENTRY {       // '<QQQIIIIQQQ' (64 bytes)
+    QWORD vaStart;
+    QWORD vaEnd;
+    QWORD vaVad;
+    DWORD dw0;                                  // raw VMMDLL_MAP_VADENTRY DWORD 0 bitfield (VadType, Protection, ...)
+    DWORD dw1;                                  // raw VMMDLL_MAP_VADENTRY DWORD 1 bitfield (CommitCharge, MemCommit)
+    DWORD u2;
+    DWORD cbPrototypePte;
+    QWORD vaPrototypePte;
+    QWORD vaSubsection;
+    QWORD vaFileObject;
+} VMMPYC_PACKED_VADENTRY, *PVMMPYC_PACKED_VADENTRY;
+
+typedef struct tdVMMPYC_PACKED_HANDLEENTRY {    // '<QQQQQIIIIII' (64 bytes)
+    QWORD vaObject;
+    QWORD qwHandleCount;
+    QWORD qwPointerCount;
+    QWORD vaObjectCreateInfo;
+    QWORD vaSecurityDescriptor;
+    DWORD dwHandle;
+    DWORD dwGrantedAccess;
+    DWORD iType;
+    DWORD dwPID;
+    DWORD dwPoolTag;
+    DWORD _Reserved;
+} VMMPYC_PACKED_HANDLEENTRY, *PVMMPYC_PACKED_HANDLEENTRY;
+
+typedef struct tdVMMPYC_PACKED_PFNENTRY {       // '<IIQQQIIII' (48 bytes)
+    DWORD dwPfn;
+    DWORD dwPID;
+    QWORD va;
+    QWORD vaPte;
+    QWORD OriginalPte;
+    DWORD tp;                                   // VMMDLL_MAP_PFN_TYPE
+    DWORD tpExtended;                           // VMMDLL_MAP_PFN_TYPEEXTENDED
+    DWORD u3;                                   // raw ReferenceCount / MMPFNENTRY flags
+    DWORD _Reserved;
+} VMMPYC_PACKED_PFNENTRY, *PVMMPYC_PACKED_PFNENTRY;
+
+// (DWORD) -> PBYTE
+static PyObject*
+VMMPYC_ProcessGetPteMapPacked(PyObject *self, PyObject *args)
+{
+    PyObject *pyBytes;
+    BOOL result;
+    DWORD dwPID, i;
+    DWORD cbPteMap = 0;
+    PVMMDLL_MAP_PTEENTRY pe;
+    PVMMDLL_MAP_PTE pPteMap = NULL;
+    PVMMPYC_PACKED_PTEENTRY pp;
+    if(!PyArg_ParseTuple(args, "k", &dwPID)) { return NULL; }
+    Py_BEGIN_ALLOW_THREADS;
+    result =
+        VMMDLL_ProcessMap_GetPte(dwPID, NULL, &cbPteMap, FALSE) &&
+        cbPteMap &&
+        (pPteMap = LocalAlloc(0, cbPteMap)) &&
+        VMMDLL_ProcessMap_GetPte(dwPID, pPteMap, &cbPteMap, FALSE);
+    Py_END_ALLOW_THREADS;
+    if(!result || (pPteMap->dwVersion != VMMDLL_MAP_PTE_VERSION)) {
+        LocalFree(pPteMap);
+        return PyErr_Format(PyExc_RuntimeError, "VMMPYC_ProcessGetPteMapPacked: Failed.");
+    }
+    if(!(pyBytes = PyBytes_FromStringAndSize(NULL, pPteMap->cMap * sizeof(VMMPYC_PACKED_PTEENTRY)))) {
+        LocalFree(pPteMap);
+        return NULL;
+    }
+    pp = (PVMMPYC_PACKED_PTEENTRY)PyBytes_AsString(pyBytes);
+    for(i = 0; i < pPteMap->cMap; i++, pp++) {
+        pe = pPteMap->pMap + i;
+        pp->vaBase = pe->vaBase;
+        pp->cPages = pe->cPages;
+        pp->fPage = pe->fPage;
+        pp->cSoftware = pe->cSoftware;
+        pp->fWoW64 = pe->fWoW64;
+    }
+    LocalFree(pPteMap);
+    return pyBytes;
+}
+
+// (DWORD) -> PBYTE
+static PyObject*
+VMMPYC_ProcessGetVadMapPacked(PyObject *self, PyObject *args)
+{
+    PyObject *pyBytes;
+    BOOL result;
+    DWORD dwPID, i;
+    DWORD cbVadMap = 0;
+    PVMMDLL_MAP_VADENTRY pe;
+    PVMMDLL_MAP_VAD pVadMap = NULL;
+    PVMMPYC_PACKED_VADENTRY pp;
+    if(!PyArg_ParseTuple(args, "k", &dwPID)) { return NULL; }
+    Py_BEGIN_ALLOW_THREADS;
+    result =
+        VMMDLL_ProcessMap_GetVad(dwPID, NULL, &cbVadMap, FALSE) &&
+        cbVadMap &&
+        (pVadMap = LocalAlloc(0, cbVadMap)) &&
+        VMMDLL_ProcessMap_GetVad(dwPID, pVadMap, &cbVadMap, FALSE);
+    Py_END_ALLOW_THREADS;
+    if(!result || (pVadMap->dwVersion != VMMDLL_MAP_VAD_VERSION)) {
+        LocalFree(pVadMap);
+        return PyErr_Format(PyExc_RuntimeError, "VMMPYC_ProcessGetVadMapPacked: Failed.");
+    }
+    if(!(pyBytes = PyBytes_FromStringAndSize(NULL, pVadMap->cMap * sizeof(VMMPYC_PACKED_VADENTRY)))) {
+        LocalFree(pVadMap);
+        return NULL;
+    }
+    pp = (PVMMPYC_PACKED_VADENTRY)PyBytes_AsString(pyBytes);
+    for(i = 0; i < pVadMap->cMap; i++, pp++) {
+        pe = pVadMap->pMap + i;
+        pp->vaStart = pe->vaStart;
+        pp->vaEnd = pe->vaEnd;
+        pp->vaVad = pe->vaVad;
+        memcpy(&pp->dw0, (PBYTE)&pe->vaVad + sizeof(QWORD), 2 * sizeof(DWORD));
+        pp->u2 = pe->u2;
+        pp->cbPrototypePte = pe->cbPrototypePte;
+        pp->vaPrototypePte = pe->vaPrototypePte;
+        pp->vaSubsection = pe->vaSubsection;
+        pp->vaFileObject = pe->vaFileObject;
+    }
+    LocalFree(pVadMap);
+    return pyBytes;
+}
+
+// (DWORD) -> PBYTE
+static PyObject*
+VMMPYC_ProcessGetHandleMapPacked(PyObject *self, PyObject *args)
+{
+    PyObject *pyBytes;
+    BOOL result;
+    DWORD dwPID, cbHandleMap = 0;
+    ULONG64 i;
+    PVMMDLL_MAP_HANDLE pHandleMap = NULL;
+    PVMMDLL_MAP_HANDLEENTRY pe;
+    PVMMPYC_PACKED_HANDLEENTRY pp;
+    if(!PyArg_ParseTuple(args, "k", &dwPID)) { return NULL; }
+    Py_BEGIN_ALLOW_THREADS;
+    result =
+        VMMDLL_ProcessMap_GetHandle(dwPID, NULL, &cbHandleMap) &&
+        cbHandleMap &&
+        (pHandleMap = LocalAlloc(0, cbHandleMap)) &&
+        VMMDLL_ProcessMap_GetHandle(dwPID, pHandleMap, &cbHandleMap);
+    Py_END_ALLOW_THREADS;
+    if(!result || (pHandleMap->dwVersion != VMMDLL_MAP_HANDLE_VERSION)) {
+        LocalFree(pHandleMap);
+        return PyErr_Format(PyExc_RuntimeError, "VMMPYC_ProcessGetHandleMapPacked: Failed.");
+    }
+    if(!(pyBytes = PyBytes_FromStringAndSize(NULL, pHandleMap->cMap * sizeof(VMMPYC_PACKED_HANDLEENTRY)))) {
+        LocalFree(pHandleMap);
+        return NULL;
+    }
+    pp = (PVMMPYC_PACKED_HANDLEENTRY)PyBytes_AsString(pyBytes);
+    for(i = 0; i < pHandleMap->cMap; i++, pp++) {
+        pe = pHandleMap->pMap + i;
+        pp->vaObject = pe->vaObject;
+        pp->qwHandleCount = pe->qwHandleCount;
+        pp->qwPointerCount = pe->qwPointerCount;
+        pp->vaObjectCreateInfo = pe->vaObjectCreateInfo;
+        pp->vaSecurityDescriptor = pe->vaSecurityDescriptor;
+        pp->dwHandle = pe->dwHandle;
+        pp->dwGrantedAccess = pe->dwGrantedAccess;
+        pp->iType = pe->iType;
+        pp->dwPID = pe->dwPID;
+        pp->dwPoolTag = pe->dwPoolTag;
+        pp->_Reserved = 0;
+    }
+    LocalFree(pHandleMap);
+    return pyBytes;
+}
+
+// (DWORD, DWORD) -> PBYTE
+static PyObject*
+VMMPYC_MapGetPfnsPacked(PyObject *self, PyObject *args)
+{
+    PyObject *pyBytes;
+    BOOL result;
+    DWORD i, dwPfnStart, cPfns, cbPfnMap = 0, *pPfns = NULL;
+    PVMMDLL_MAP_PFN pPfnMap = NULL;
+    PVMMDLL_MAP_PFNENTRY pe;
+    PVMMPYC_PACKED_PFNENTRY pp;
+    if(!PyArg_ParseTuple(args, "kk", &dwPfnStart, &cPfns)) { return NULL; }
+    if(cPfns > 0x01000000) { return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MapGetPfnsPacked: More than maximum supported (0x01000000) PFNs requested."); }
+    if(!cPfns) { return PyBytes_FromStringAndSize(NULL, 0); }
+    if(!(pPfns = LocalAlloc(0, cPfns * sizeof(DWORD)))) { return PyErr_NoMemory(); }
+    for(i = 0; i < cPfns; i++) {
+        pPfns[i] = dwPfnStart + i;
+    }
+    Py_BEGIN_ALLOW_THREADS;
+    result =
+        VMMDLL_Map_GetPfn(pPfns, cPfns, NULL, &cbPfnMap) &&
+        (pPfnMap = LocalAlloc(0, cbPfnMap)) &&
+        VMMDLL_Map_GetPfn(pPfns, cPfns, pPfnMap, &cbPfnMap);
+    Py_END_ALLOW_THREADS;
+    LocalFree(pPfns);
+    if(!result || (pPfnMap->dwVersion != VMMDLL_MAP_PFN_VERSION)) {
+        LocalFree(pPfnMap);
+        return PyErr_Format(PyExc_RuntimeError, "VMMPYC_MapGetPfnsPacked: Failed.");
+    }
+    if(!(pyBytes = PyBytes_FromStringAndSize(NULL, pPfnMap->cMap * sizeof(VMMPYC_PACKED_PFNENTRY)))) {
+        LocalFree(pPfnMap);
+        return NULL;
+    }
+    pp = (PVMMPYC_PACKED_PFNENTRY)PyBytes_AsString(pyBytes);
+    for(i = 0; i < pPfnMap->cMap; i++, pp++) {
+        pe = pPfnMap->pMap + i;
+        pp->dwPfn = pe->dwPfn;
+        pp->dwPID = pe->AddressInfo.dwPid;
+        pp->va = pe->AddressInfo.va;
+        pp->vaPte = pe->vaPte;
+        pp->OriginalPte = pe->OriginalPte;
+        pp->tp = pe->PageLocation;
+        pp->tpExtended = pe->tpExtended;
+        pp->u3 = pe->_u3;
+        pp->_Reserved = 0;
+    }
+    LocalFree(pPfnMap);
+    return pyBytes;
+}
+
 // () -> [{...}]
 static PyObject*
 VMMPYC_GetUsers(PyObject* self, PyObject* args)
@@ -1466,6 +1923,66 @@ fail:
     return PyErr_Format(PyExc_RuntimeError, "VMMPYC_WinReg_QueryValue: Failed parse key/value path.");
 }
 
+// ([WSTR]) -> {WSTR: {...}}
+static PyObject*
+VMMPYC_WinReg_QueryValueBatch(PyObject *self, PyObject *args)
+{
+    PyObject *pyListSrc, *pyListItemSrc, *pyDictDst, *pyDict, *pyKey;
+    BOOL result = TRUE;
+    DWORD i, cValues;
+    QWORD cbTotal = 0;
+    PBYTE pbData = NULL;
+    PVMMDLL_WINREG_QUERYVALUE pValues = NULL, pv;
+    if(!PyArg_ParseTuple(args, "O!", &PyList_Type, &pyListSrc)) { return NULL; }    // borrowed reference
+    if(!(cValues = (DWORD)PyList_Size(pyListSrc))) { return PyDict_New(); }
+    if(!(pValues = LocalAlloc(LMEM_ZEROINIT, cValues * sizeof(VMMDLL_WINREG_QUERYVALUE)))) { return PyErr_NoMemory(); }
+    for(i = 0; i < cValues; i++) {
+        pyListItemSrc = PyList_GetItem(pyListSrc, i);   // borrowed reference
+        if(!pyListItemSrc || !PyUnicode_Check(pyListItemSrc) || !(pValues[i].wszFullPathKeyValue = PyUnicode_AsWideCharString(pyListItemSrc, NULL))) {
+            PyErr_Clear();
+            for(i = 0; i < cValues; i++) {
+                PyMem_Free(pValues[i].wszFullPathKeyValue);
+            }
+            LocalFree(pValues);
+            return PyErr_Format(PyExc_RuntimeError, "VMMPYC_WinReg_QueryValueBatch: Argument list contains non string item.");
+        }
+    }
+    // call c-dll for vmm - 1st pass retrieves sizes, 2nd pass reads data.
+    Py_BEGIN_ALLOW_THREADS;
+    if(VMMDLL_WinReg_QueryValueBatchW(pValues, cValues)) {
+        for(i = 0; i < cValues; i++) {
+            cbTotal += pValues[i].cbData;
+        }
+        if((cbTotal < 0x80000000) && (pbData = LocalAlloc(0, (SIZE_T)max(1, cbTotal)))) {
+            for(i = 0, cbTotal = 0; i < cValues; i++) {
+                pValues[i].pbData = pbData + cbTotal;
+                cbTotal += pValues[i].cbData;
+            }
+            VMMDLL_WinReg_QueryValueBatchW(pValues, cValues);
+        } else {
+            result = FALSE;
+        }
+    }
+    Py_END_ALLOW_THREADS;
+    pyDictDst = result ? PyDict_New() : NULL;
+    for(i = 0; i < cValues; i++) {
+        pv = pValues + i;
+        if(pyDictDst && pv->fResult && (pyDict = PyDict_New())) {
+            PyDict_SetItemString_DECREF(pyDict, "type", PyLong_FromUnsignedLong(pv->dwType));
+            PyDict_SetItemString_DECREF(pyDict, "data", PyBytes_FromStringAndSize(pv->pbData, pv->cbData));
+            if((pyKey = PyUnicode_FromWideChar(pv->wszFullPathKeyValue, -1))) {
+                PyDict_SetItem(pyDictDst, pyKey, pyDict);
+                Py_DECREF(pyKey);
+            }
+            Py_DECREF(pyDict);
+        }
+        PyMem_Free(pv->wszFullPathKeyValue);
+    }
+    LocalFree(pbData);
+    LocalFree(pValues);
+    return pyDictDst ? pyDictDst : PyErr_NoMemory();
+}
+
 
 
 // (DWORD, ULONG64) -> STR
@@ -1559,30 +2076,50 @@ VMMPYC_PdbTypeChildOffset(PyObject *self, PyObject *args)
 
 
 
+#define VMMPYC_VFSLIST_BLOCK_ITEMS       16
+#define VMMPYC_VFSLIST_BLOCK_ITEMS_MAX   0x1000
+
 typedef struct tdVMMPYC_VFSLIST {
-    struct tdVMMPYC_VFSLIST *FLink;
     WCHAR wszName[MAX_PATH];
     BOOL fIsDir;
     ULONG64 qwSize;
 } VMMPYC_VFSLIST, *PVMMPYC_VFSLIST;
 
+// entries are bump-allocated from a chain of blocks of growing size. The
+// chain is walked backwards to keep the most-recently-added-first ordering.
+typedef struct tdVMMPYC_VFSLIST_BLOCK {
+    struct tdVMMPYC_VFSLIST_BLOCK *BLink;
+    DWORD c;
+    DWORD cMax;
+    VMMPYC_VFSLIST e[];
+} VMMPYC_VFSLIST_BLOCK, *PVMMPYC_VFSLIST_BLOCK;
+
+typedef struct tdVMMPYC_VFSLIST_ARENA {
+    PVMMPYC_VFSLIST_BLOCK pLast;
+} VMMPYC_VFSLIST_ARENA, *PVMMPYC_VFSLIST_ARENA;
 
 VOID VMMPYC_VfsList_AddInternal(_Inout_ HANDLE h, _In_ LPWSTR wszName, _In_ ULONG64 size, _In_ BOOL fIsDirectory)
 {
-    DWORD i = 0;
+    DWORD i = 0, cMax;
     PVMMPYC_VFSLIST pE;
-    PVMMPYC_VFSLIST *ppE = (PVMMPYC_VFSLIST*)h;
-    if((pE = LocalAlloc(0, sizeof(VMMPYC_VFSLIST)))) {
-        while(i < MAX_PATH && wszName && wszName[i]) {
-            pE->wszName[i] = wszName[i];
-            i++;
-        }
-        pE->wszName[min(i, MAX_PATH - 1)] = 0;
-        pE->fIsDir = fIsDirectory;
-        pE->qwSize = size;
-        pE->FLink = *ppE;
-        *ppE = pE;
-    }
+    PVMMPYC_VFSLIST_BLOCK pBlock;
+    PVMMPYC_VFSLIST_ARENA pArena = (PVMMPYC_VFSLIST_ARENA)h;
+    if(!pArena->pLast || (pArena->pLast->c == pArena->pLast->cMax)) {
+        cMax = pArena->pLast ? min(2 * pArena->pLast->cMax, VMMPYC_VFSLIST_BLOCK_ITEMS_MAX) : VMMPYC_VFSLIST_BLOCK_ITEMS;
+        if(!(pBlock = LocalAlloc(0, sizeof(VMMPYC_VFSLIST_BLOCK) + cMax * sizeof(VMMPYC_VFSLIST)))) { return; }
+        pBlock->BLink = pArena->pLast;
+        pBlock->c = 0;
+        pBlock->cMax = cMax;
+        pArena->pLast = pBlock;
+    }
+    pE = pArena->pLast->e + pArena->pLast->c++;
+    while(i < MAX_PATH && wszName && wszName[i]) {
+        pE->wszName[i] = wszName[i];
+        i++;
+    }
+    pE->wszName[min(i, MAX_PATH - 1)] = 0;
+    pE->fIsDir = fIsDirectory;
+    pE->qwSize = size;
 }
 
 VOID VMMPYC_VfsList_AddFile(_Inout_ HANDLE h, _In_ LPWSTR wszName, _In_ ULONG64 size, _In_opt_ PVMMDLL_VFS_FILELIST_EXINFO pExInfo)
@@ -1603,33 +2140,37 @@ VMMPYC_VfsList(PyObject *self, PyObject *args)
     PyObject *pyDict, *PyDict_Attr;
     PyObject *pyKeyName, *pyUnicodePath;
     BOOL result;
+    DWORD i;
     LPWSTR wszPath = NULL;
     VMMDLL_VFS_FILELIST hFileList;
-    PVMMPYC_VFSLIST pE = NULL, pE_Next;
+    VMMPYC_VFSLIST_ARENA Arena = { 0 };
+    PVMMPYC_VFSLIST_BLOCK pBlock, pBlockPrev;
+    PVMMPYC_VFSLIST pE;
     if(!PyArg_ParseTuple(args, "O!", &PyUnicode_Type, &pyUnicodePath)) { return NULL; }     // pyUnicodePath == borrowed reference - do not decrement
     if(!(wszPath = PyUnicode_AsWideCharString(pyUnicodePath, NULL))) { return NULL; }       // wszPath PyMem_Free() required 
     if(!(pyDict = PyDict_New())) { return PyErr_NoMemory(); }
     Py_BEGIN_ALLOW_THREADS;
-    hFileList.h = &pE;
+    hFileList.h = &Arena;
     hFileList.pfnAddFile = VMMPYC_VfsList_AddFile;
     hFileList.pfnAddDirectory = VMMPYC_VfsList_AddDirectory;
     hFileList.dwVersion = VMMDLL_VFS_FILELIST_VERSION;
     result = VMMDLL_VfsList(wszPath, &hFileList);
-    pE = *(PVMMPYC_VFSLIST*)hFileList.h;
     Py_END_ALLOW_THREADS;
     PyMem_Free(wszPath); wszPath = NULL;
-    while(pE) {
-        if((PyDict_Attr = PyDict_New())) {
-            PyDict_SetItemString_DECREF(PyDict_Attr, "f_isdir", PyBool_FromLong(pE->fIsDir ? 1 : 0));
-            PyDict_SetItemString_DECREF(PyDict_Attr, "size", PyLong_FromUnsignedLongLong(pE->qwSize));
-            pyKeyName = PyUnicode_FromWideChar(pE->wszName, -1);
-            PyDict_SetItem(pyDict, pyKeyName, PyDict_Attr);
-            Py_DECREF(pyKeyName);
-            Py_DECREF(PyDict_Attr);
+    for(pBlock = Arena.pLast; pBlock; pBlock = pBlockPrev) {
+        for(i = pBlock->c; i > 0; i--) {
+            pE = pBlock->e + i - 1;
+            if((PyDict_Attr = PyDict_New())) {
+                PyDict_SetItemString_DECREF(PyDict_Attr, "f_isdir", PyBool_FromLong(pE->fIsDir ? 1 : 0));
+                PyDict_SetItemString_DECREF(PyDict_Attr, "size", PyLong_FromUnsignedLongLong(pE->qwSize));
+                pyKeyName = PyUnicode_FromWideChar(pE->wszName, -1);
+                PyDict_SetItem(pyDict, pyKeyName, PyDict_Attr);
+                Py_DECREF(pyKeyName);
+                Py_DECREF(PyDict_Attr);
+            }
         }
-        pE_Next = pE->FLink;
-        LocalFree(pE);
-        pE = pE_Next;
+        pBlockPrev = pBlock->BLink;
+        LocalFree(pBlock);
     }
     if(!result) {
         Py_DECREF(pyDict);
@@ -1649,7 +2190,11 @@ static PyMethodDef VMMPYC_EmbMethods[] = {
     {"VMMPYC_ConfigGet", VMMPYC_ConfigGet, METH_VARARGS, "Get a device specific option value."},
     {"VMMPYC_ConfigSet", VMMPYC_ConfigSet, METH_VARARGS, "Set a device specific option value."},
     {"VMMPYC_MemReadScatter", VMMPYC_MemReadScatter, METH_VARARGS, "Read multiple 4kB page sized and aligned chunks of memory given as an address list."},
+    {"VMMPYC_MemReadScatterInto", VMMPYC_MemReadScatterInto, METH_VARARGS, "Read multiple 4kB page sized and aligned chunks of memory given as an address list directly into a bytearray (GIL is held during read)."},
+    {"VMMPYC_MemSearch", VMMPYC_MemSearch, METH_VARARGS, "Search memory for byte patterns."},
+    {"VMMPYC_MemReadScatterEx", VMMPYC_MemReadScatterEx, METH_VARARGS, "Read multiple arbitrary sized and aligned chunks of memory given as an (address, size) list."},
     {"VMMPYC_MemRead", VMMPYC_MemRead, METH_VARARGS, "Read memory."},
+    {"VMMPYC_MemReadInto", VMMPYC_MemReadInto, METH_VARARGS, "Read memory directly into a bytearray (GIL is held during read)."},
     {"VMMPYC_MemWrite", VMMPYC_MemWrite, METH_VARARGS, "Write memory."},
     {"VMMPYC_MemVirt2Phys", VMMPYC_MemVirt2Phys, METH_VARARGS, "Translate a virtual address into a physical address."},
     {"VMMPYC_PidGetFromName", VMMPYC_PidGetFromName, METH_VARARGS, "Locate a process by name and return the PID."},
@@ -1665,6 +2210,10 @@ static PyMethodDef VMMPYC_EmbMethods[] = {
     {"VMMPYC_MapGetPhysMem", VMMPYC_MapGetPhysMem, METH_VARARGS, "Retrieve the physical memory map from the system."},
     {"VMMPYC_GetUsers", VMMPYC_GetUsers, METH_VARARGS, "Retrieve the non-well known users from the system."},
     {"VMMPYC_MapGetPfns", VMMPYC_MapGetPfns, METH_VARARGS, "Retrieve page frame number (PFN) information for select page frame numbers."},
+    {"VMMPYC_ProcessGetPteMapPacked", VMMPYC_ProcessGetPteMapPacked, METH_VARARGS, "Retrieve the PTE memory map for a given process as packed bytes."},
+    {"VMMPYC_ProcessGetVadMapPacked", VMMPYC_ProcessGetVadMapPacked, METH_VARARGS, "Retrieve the VAD memory map for a given process as packed bytes."},
+    {"VMMPYC_ProcessGetHandleMapPacked", VMMPYC_ProcessGetHandleMapPacked, METH_VARARGS, "Retrieve the handle map for a given process as packed bytes."},
+    {"VMMPYC_MapGetPfnsPacked", VMMPYC_MapGetPfnsPacked, METH_VARARGS, "Retrieve page frame number (PFN) information for a PFN range as packed bytes."},
     {"VMMPYC_ProcessGetInformation", VMMPYC_ProcessGetInformation, METH_VARARGS, "Retrieve process information for a specific process."},
     {"VMMPYC_ProcessGetDirectories", VMMPYC_ProcessGetDirectories, METH_VARARGS, "Retrieve the data directories for a specific process and module."},
     {"VMMPYC_ProcessGetSections", VMMPYC_ProcessGetSections, METH_VARARGS, "Retrieve the sections for a specific process and module."},
@@ -1679,6 +2228,7 @@ static PyMethodDef VMMPYC_EmbMethods[] = {
     {"VMMPYC_WinReg_HiveWrite", VMMPYC_WinReg_HiveWrite, METH_VARARGS, "Write raw registry hive."},
     {"VMMPYC_WinReg_EnumKey", VMMPYC_WinReg_EnumKey, METH_VARARGS, "Enumerate registry sub-keys."},
     {"VMMPYC_WinReg_QueryValue", VMMPYC_WinReg_QueryValue, METH_VARARGS, "Query registry value."},
+    {"VMMPYC_WinReg_QueryValueBatch", VMMPYC_WinReg_QueryValueBatch, METH_VARARGS, "Query multiple registry values."},
     {"VMMPYC_PdbLoad", VMMPYC_PdbLoad, METH_VARARGS, "Load PDB symbol files from the Microsoft Symbol Server."},
     {"VMMPYC_PdbSymbolName", VMMPYC_PdbSymbolName, METH_VARARGS, "Retrieve module symbol name closest to given offset."},
     {"VMMPYC_PdbSymbolAddress", VMMPYC_PdbSymbolAddress, METH_VARARGS, "Retrieve debugging information - symbol address."},
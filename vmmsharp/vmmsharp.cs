@@ -266,12 +266,46 @@ namespace vmmsharp
         public static ulong OPT_CONFIG_VMM_VERSION_REVISION =    0x2000000B00000000;  // R
         public static ulong OPT_CONFIG_STATISTICS_FUNCTIONCALL = 0x2000000C00000000; // RW - enable function call statistics (.status/statistics_fncall file)
         public static ulong OPT_CONFIG_IS_PAGING_ENABLED =       0x2000000D00000000;  // RW - 1/0
+        public static ulong OPT_CONFIG_CACHESIZE_PHYS =          0x2000000E00000000;  // RW - physical memory cache size (in MB)
+        public static ulong OPT_CONFIG_CACHESIZE_TLB =           0x2000000F00000000;  // RW - page table (tlb) cache size (in MB)
+        public static ulong OPT_CONFIG_CACHESIZE_PAGING =        0x2000001000000000;  // RW - virtual memory 'paging' cache size (in MB)
+        public static ulong OPT_CONFIG_CACHE_PHYS_2Q =           0x2000001100000000;  // RW - 1/0 - scan resistant physical memory cache
+        public static ulong OPT_CONFIG_READAHEAD_MAX =           0x2000001200000000;  // RW - max physical memory read-ahead (in pages), 0 = disabled
+        public static ulong OPT_CONFIG_TLBCACHE_REVALIDATE =     0x2000001300000000;  // RW - 1/0 - revalidate page table (tlb) cache on refresh instead of clear
+        public static ulong OPT_CONFIG_STAT_CACHE_HIT =          0x2000001400000000;  // R - cache hits - low dword = cache table: 1=PHYS 2=TLB 3=PAGING
+        public static ulong OPT_CONFIG_STAT_CACHE_MISS =         0x2000001500000000;  // R - cache misses - low dword = cache table
+        public static ulong OPT_CONFIG_STAT_CACHE_EVICT =        0x2000001600000000;  // R - cache evictions - low dword = cache table
+        public static ulong OPT_CONFIG_STAT_CACHE_RESFAIL =      0x2000001700000000;  // R - cache reserve failures - low dword = cache table
+        public static ulong OPT_CONFIG_STAT_CACHE_INUSE =        0x2000001800000000;  // R - cache entries in use - low dword = cache table
+        public static ulong OPT_CONFIG_STAT_DEVICE_LATENCY =     0x2000001900000000;  // R - device reads with latency < 2^n uS - low dword = n [0-15]
+        public static ulong OPT_CONFIG_READ_COALESCE_US =        0x2000001A00000000;  // RW - small read coalescing window in uS - 0 = disabled
+        public static ulong OPT_CONFIG_CACHE_COMPRESS_MB =       0x2000001B00000000;  // RW - compressed physical memory cache tier budget in MB - 0 = disabled
+        public static ulong OPT_CONFIG_PHYS2VIRT_INDEX =         0x2000001C00000000;  // R/W: global phys2virt reverse index enabled (0/1)
+        public static ulong OPT_CONFIG_CACHE_PROTOTYPEPTE_MB =   0x2000001D00000000;  // RW - prototype pte array cache budget in MB - 0 = default
+        public static ulong OPT_CONFIG_WARMUP_MAPS =             0x2000001E00000000;  // RW - map types to pre-build after process refresh - bitmask: 1=vad 2=module 4=handle 8=thread
+        public static ulong OPT_CONFIG_REGISTRY_LAZY =           0x2000001F00000000;  // RW - 1/0 - lazy registry hive snapshots - hive data fetched and keys built on demand
+        public static ulong OPT_CONFIG_PLUGIN_LAZY =             0x2000002000000000;  // RW - 1/0 - lazy plugin loading - set before VMMDLL_InitializePlugins
+        public static ulong OPT_CONFIG_REMOTE_PROFILE =          0x2000002100000000;  // RW - 1/0 - remote device profile - pipelined bulk reads and round-trip time tuned coalescing and read-ahead
+        public static ulong OPT_CONFIG_STAT_DEVICE_RTT_US =      0x2000002200000000;  // R - smoothed round-trip time of small device reads in uS (remote profile only)
+        public static ulong OPT_CONFIG_STAT_FNCALL_COUNT =       0x2000002300000000;  // R - function call count - low dword = id as in statistics_fncall.json
+        public static ulong OPT_CONFIG_STAT_FNCALL_P50_US =      0x2000002400000000;  // R - function call median latency in uS - low dword = STATISTICS_ID
+        public static ulong OPT_CONFIG_STAT_FNCALL_P95_US =      0x2000002500000000;  // R - function call 95th percentile latency in uS - low dword = STATISTICS_ID
+        public static ulong OPT_CONFIG_STAT_FNCALL_P99_US =      0x2000002600000000;  // R - function call 99th percentile latency in uS - low dword = STATISTICS_ID
+        public static ulong OPT_CONFIG_STAT_FNCALL_MAX_US =      0x2000002700000000;  // R - function call max latency in uS - low dword = STATISTICS_ID
+        public static ulong OPT_CONFIG_MEMORY_BUDGET_MB =        0x2000002800000000;  // RW - global memory budget in MB - 0 = no budget
+        public static ulong OPT_CONFIG_STAT_MEMORY_USAGE =       0x2000002900000000;  // R - memory in use by budgeted subsystems in bytes
+        public static ulong OPT_CONFIG_TLB_VERIFY_VECTOR =       0x2000002A00000000;  // RW - 1/0 - vectorized x64 page table verify (0 = scalar, x64 only)
 
         public static ulong OPT_WIN_VERSION_MAJOR =              0x2000010100000000;  // R
         public static ulong OPT_WIN_VERSION_MINOR =              0x2000010200000000;  // R
         public static ulong OPT_WIN_VERSION_BUILD =              0x2000010300000000;  // R
 
-        public static ulong OPT_FORENSIC_MODE =                  0x2000020100000000;  // RW - enable/retrieve forensic mode type [0-4].
+        public static ulong OPT_FORENSIC_MODE =                  0x2000020100000000;  // RW - enable/retrieve forensic mode type [0-5].
+        public static ulong OPT_FORENSIC_SCAN_CHUNKS =           0x2000020200000000;  // RW - forensic physical memory scan pipeline depth (# chunks in flight) - 0 = default (4)
+        public static ulong OPT_FORENSIC_SCAN_CHUNK_MB =         0x2000020300000000;  // RW - forensic physical memory scan chunk size in MB - 0 = default (16)
+        public static ulong OPT_FORENSIC_MEMORY_BUDGET_MB =      0x2000020400000000;  // RW - in-memory forensic database (mode 5) spill-to-disk budget in MB - 0 = default (4096)
+        public static ulong OPT_FORENSIC_DATABASE_SAVE =         0x2000020500000000;  // W - save in-memory forensic database (mode 5) to its temp file
+        public static ulong OPT_FORENSIC_INIT_STATUS =           0x2000020600000000;  // R - forensic initialization status - 0 = not started, 1 = in progress, 2 = completed
 
         public static ulong OPT_REFRESH_ALL =                    0x2001ffff00000000;  // W - refresh all caches
         public static ulong OPT_REFRESH_PROCESS =                0x2001000100000000;  // W - refresh process listings
@@ -390,6 +424,7 @@ namespace vmmsharp
         public static uint FLAG_NOPAGING =                  0x0010;  // do not try to retrieve memory from paged out memory from pagefile/compressed (even if possible)
         public static uint FLAG_NOPAGING_IO =               0x0020;  // do not try to retrieve memory from paged out memory if read would incur additional I/O (even if possible).
         public static uint FLAG_NOCACHEPUT =                0x0100;  // do not write back to the data cache upon successful read from memory acquisition device.
+        public static uint FLAG_PRIORITY_BULK =             0x0200;  // low priority bulk read - device reads are sliced and yield to interactive (normal) reads.
         public static uint FLAG_CACHE_RECENT_ONLY =         0x0200;  // only fetch from the most recent active cache region when reading.
 
         public static unsafe MEM_SCATTER[] MemReadScatter(uint pid, uint flags, params ulong[] qwA)
@@ -423,6 +458,60 @@ namespace vmmsharp
             return MEMs;
         }
 
+        public static IntPtr Scatter_Initialize(uint pid, uint flags = 0)
+        {
+            return vmmi.VMMDLL_Scatter_Initialize(pid, flags);
+        }
+
+        public static bool Scatter_Prepare(IntPtr hS, ulong va, uint cb)
+        {
+            return vmmi.VMMDLL_Scatter_Prepare(hS, va, cb);
+        }
+
+        public static bool Scatter_Execute(IntPtr hS)
+        {
+            return vmmi.VMMDLL_Scatter_Execute(hS);
+        }
+
+        public static unsafe byte[] Scatter_Read(IntPtr hS, ulong va, uint cb)
+        {
+            uint cbRead;
+            byte[] data = new byte[cb];
+            fixed (byte* pb = data)
+            {
+                vmmi.VMMDLL_Scatter_Read(hS, va, cb, pb, out cbRead);
+            }
+            return data;
+        }
+
+        public static unsafe bool Scatter_Read(IntPtr hS, ulong va, byte* pb, uint cb, out uint cbRead)
+        {
+            return vmmi.VMMDLL_Scatter_Read(hS, va, cb, pb, out cbRead);
+        }
+
+        public static unsafe bool Scatter_Read(IntPtr hS, ulong va, byte[] data, int offset, uint cb, out uint cbRead)
+        {
+            cbRead = 0;
+            if ((offset < 0) || ((ulong)offset + cb > (ulong)data.Length))
+            {
+                return false;
+            }
+            fixed (byte* pb = data)
+            {
+                return vmmi.VMMDLL_Scatter_Read(hS, va, cb, pb + offset, out cbRead);
+            }
+        }
+
+        public static bool Scatter_Clear(IntPtr hS, uint pid, uint flags = 0)
+        {
+            return vmmi.VMMDLL_Scatter_Clear(hS, pid, flags);
+        }
+
+        public static void Scatter_CloseHandle(IntPtr hS)
+        {
+            vmmi.VMMDLL_Scatter_CloseHandle(hS);
+        }
+
         public static unsafe byte[] MemRead(uint pid, ulong qwA, uint cb, uint flags = 0)
         {
             uint cbRead;
@@ -441,6 +530,115 @@ namespace vmmsharp
             return data;
         }
 
+        public static unsafe bool MemRead(uint pid, ulong qwA, byte* pb, uint cb, out uint cbRead, uint flags = 0)
+        {
+            return vmmi.VMMDLL_MemReadEx(pid, qwA, pb, cb, out cbRead, flags);
+        }
+
+        public static unsafe bool MemRead(uint pid, ulong qwA, byte[] data, int offset, uint cb, out uint cbRead, uint flags = 0)
+        {
+            cbRead = 0;
+            if ((offset < 0) || ((ulong)offset + cb > (ulong)data.Length))
+            {
+                return false;
+            }
+            fixed (byte* pb = data)
+            {
+                return vmmi.VMMDLL_MemReadEx(pid, qwA, pb + offset, cb, out cbRead, flags);
+            }
+        }
+
+        // Read page sized and aligned memory directly into data at offset i * 0x1000 for each address. Returns number of pages read.
+        public static unsafe uint MemReadScatter(uint pid, uint flags, ulong[] qwA, byte[] data, bool[] fSuccess = null)
+        {
+            uint i, cMEMs = (uint)qwA.Length;
+            IntPtr pppMEMs;
+            byte* pMEM;
+            if ((cMEMs == 0) || ((ulong)data.Length < (ulong)cMEMs * 0x1000) || ((fSuccess != null) && (fSuccess.Length < cMEMs)))
+            {
+                return 0;
+            }
+            fixed (byte* pb = data)
+            {
+                if (!lci.LcAllocScatter2(cMEMs * 0x1000, pb, cMEMs, out pppMEMs))
+                {
+                    return 0;
+                }
+                for (i = 0; i < cMEMs; i++)
+                {
+                    pMEM = ((byte**)pppMEMs.ToPointer())[i];
+                    *(ulong*)(pMEM + 8) = qwA[i] & ~(ulong)0xfff;
+                }
+                uint cRead = vmmi.VMMDLL_MemReadScatter(pid, pppMEMs, cMEMs, flags);
+                if (fSuccess != null)
+                {
+                    for (i = 0; i < cMEMs; i++)
+                    {
+                        pMEM = ((byte**)pppMEMs.ToPointer())[i];
+                        fSuccess[i] = *(int*)(pMEM + 4) != 0;
+                    }
+                }
+                lci.LcMemFree(pppMEMs);
+                return cRead;
+            }
+        }
+
+        public static uint MEMSEARCH_PID_ALL =              0xfffffffe;  // search all processes in MemSearch.
+
+        public struct MEMSEARCH_HIT
+        {
+            public uint dwPID;
+            public ulong va;
+            public uint iSearch;
+        }
+
+        // Search memory for up to 16 patterns of max 32 bytes in one parallel pass. masks[i] (optional) must be of pattern length - bits set are wildcards.
+        public static unsafe MEMSEARCH_HIT[] MemSearch(uint pid, byte[][] patterns, byte[][] masks = null, ulong vaMin = 0, ulong vaMax = 0, uint cMaxResult = 0x10000, uint flags = 0, bool fWritable = false, bool fExecutable = false)
+        {
+            int i;
+            vmmi.VMMDLL_MEM_SEARCH_CONTEXT ctx = new vmmi.VMMDLL_MEM_SEARCH_CONTEXT();
+            List<MEMSEARCH_HIT> hits = new List<MEMSEARCH_HIT>();
+            if ((patterns.Length == 0) || (patterns.Length > vmmi.VMMDLL_MEM_SEARCH_MAX))
+            {
+                return null;
+            }
+            ctx.dwVersion = vmmi.VMMDLL_MEM_SEARCH_VERSION;
+            ctx.cSearch = (uint)patterns.Length;
+            for (i = 0; i < patterns.Length; i++)
+            {
+                byte* pe = ctx.search + i * vmmi.VMMDLL_MEM_SEARCH_ENTRY_SIZE;
+                if ((patterns[i].Length == 0) || (patterns[i].Length > vmmi.VMMDLL_MEM_SEARCH_MAXLENGTH))
+                {
+                    return null;
+                }
+                *(uint*)(pe + 4) = (uint)patterns[i].Length;
+                Marshal.Copy(patterns[i], 0, new IntPtr(pe + 8), patterns[i].Length);
+                if ((masks != null) && (i < masks.Length) && (masks[i] != null))
+                {
+                    if (masks[i].Length != patterns[i].Length)
+                    {
+                        return null;
+                    }
+                    Marshal.Copy(masks[i], 0, new IntPtr(pe + 8 + vmmi.VMMDLL_MEM_SEARCH_MAXLENGTH), masks[i].Length);
+                }
+            }
+            ctx.vaMin = vaMin;
+            ctx.vaMax = vaMax;
+            ctx.ReadFlags = flags;
+            ctx.fForceW = fWritable ? 1 : 0;
+            ctx.fForceX = fExecutable ? 1 : 0;
+            ctx.cMaxResult = cMaxResult;
+            vmmi.MemSearchCB cb = (IntPtr pctx, uint dwPID, ulong va, uint iSearch) =>
+            {
+                hits.Add(new MEMSEARCH_HIT { dwPID = dwPID, va = va, iSearch = iSearch });
+                return true;
+            };
+            ctx.pfnResultOptCB = Marshal.GetFunctionPointerForDelegate(cb);
+            bool result = vmmi.VMMDLL_MemSearch(pid, &ctx);
+            GC.KeepAlive(cb);
+            return result ? hits.ToArray() : null;
+        }
+
         public static unsafe bool MemPrefetchPages(uint pid, ulong[] qwA)
         {
             byte[] data = new byte[qwA.Length * sizeof(ulong)];
@@ -1542,6 +1740,94 @@ namespace vmmsharp
 
 
 
+    /*
+     * Reusable native array of page sized MEM_SCATTER entries to be used for
+     * repeated scatter reads without per-read allocations. Page data is valid
+     * until the next Read or Dispose.
+     * LC_MEM_SCATTER layout: version +0, f +4, qwA +8, pb +16, cb +24.
+     */
+    public sealed class MemScatterArray : IDisposable
+    {
+        private IntPtr pppMEMs;
+        private readonly uint cMEMs;
+
+        public MemScatterArray(uint count)
+        {
+            if ((count == 0) || !lci.LcAllocScatter1(count, out pppMEMs))
+            {
+                throw new OutOfMemoryException("MemScatterArray: allocation failed.");
+            }
+            cMEMs = count;
+        }
+
+        ~MemScatterArray()
+        {
+            Dispose();
+        }
+
+        public void Dispose()
+        {
+            if (pppMEMs != IntPtr.Zero)
+            {
+                lci.LcMemFree(pppMEMs);
+                pppMEMs = IntPtr.Zero;
+            }
+            GC.SuppressFinalize(this);
+        }
+
+        public uint Count { get { return cMEMs; } }
+
+        private unsafe byte* MEM(uint i)
+        {
+            if ((pppMEMs == IntPtr.Zero) || (i >= cMEMs))
+            {
+                throw new ArgumentOutOfRangeException("i");
+            }
+            return ((byte**)pppMEMs.ToPointer())[i];
+        }
+
+        public unsafe ulong this[uint i]
+        {
+            get { return *(ulong*)(MEM(i) + 8); }
+            set { *(ulong*)(MEM(i) + 8) = value & ~(ulong)0xfff; }
+        }
+
+        public unsafe bool IsSuccess(uint i)
+        {
+            return *(int*)(MEM(i) + 4) != 0;
+        }
+
+        // Pointer to the 0x1000 byte page buffer of entry i.
+        public unsafe byte* Page(uint i)
+        {
+            return *(byte**)(MEM(i) + 16);
+        }
+
+        public unsafe bool CopyTo(uint i, byte[] data, int offset)
+        {
+            if (!IsSuccess(i) || (offset < 0) || (offset + 0x1000 > data.Length))
+            {
+                return false;
+            }
+            Marshal.Copy(new IntPtr(Page(i)), data, offset, 0x1000);
+            return true;
+        }
+
+        // Read the first count entries. Returns number of pages read.
+        public unsafe uint Read(uint pid, uint count, uint flags = 0)
+        {
+            uint i;
+            count = Math.Min(count, cMEMs);
+            for (i = 0; i < count; i++)
+            {
+                *(int*)(MEM(i) + 4) = 0;    // reset success flag - already successful entries are skipped by vmm.
+            }
+            return (count == 0) ? 0 : vmmi.VMMDLL_MemReadScatter(pid, pppMEMs, count, flags);
+        }
+    }
+
+
+
     internal static class lci
     {
         [System.Runtime.InteropServices.StructLayoutAttribute(System.Runtime.InteropServices.LayoutKind.Sequential)]
@@ -1562,6 +1848,9 @@ namespace vmmsharp
         [DllImport("leechcore.dll", EntryPoint = "LcAllocScatter1")]
         internal static extern unsafe bool LcAllocScatter1(uint cMEMs, out IntPtr pppMEMs);
 
+        [DllImport("leechcore.dll", EntryPoint = "LcAllocScatter2")]
+        internal static extern unsafe bool LcAllocScatter2(uint cbData, byte* pbData, uint cMEMs, out IntPtr pppMEMs);
+
         [DllImport("leechcore.dll", EntryPoint = "LcRead")]
         internal static extern unsafe bool LcRead(ulong hLC, ulong pa, uint cb, byte* pb);
 
@@ -1654,6 +1943,71 @@ namespace vmmsharp
             uint cpMEMs,
             uint flags);
 
+        [DllImport("vmm.dll", EntryPoint = "VMMDLL_Scatter_Initialize")]
+        internal static extern IntPtr VMMDLL_Scatter_Initialize(
+            uint dwPID,
+            uint flags);
+
+        [DllImport("vmm.dll", EntryPoint = "VMMDLL_Scatter_Prepare")]
+        internal static extern bool VMMDLL_Scatter_Prepare(
+            IntPtr hS,
+            ulong va,
+            uint cb);
+
+        [DllImport("vmm.dll", EntryPoint = "VMMDLL_Scatter_Execute")]
+        internal static extern bool VMMDLL_Scatter_Execute(
+            IntPtr hS);
+
+        [DllImport("vmm.dll", EntryPoint = "VMMDLL_Scatter_Read")]
+        internal static extern unsafe bool VMMDLL_Scatter_Read(
+            IntPtr hS,
+            ulong va,
+            uint cb,
+            byte* pb,
+            out uint pcbRead);
+
+        [DllImport("vmm.dll", EntryPoint = "VMMDLL_Scatter_Clear")]
+        internal static extern bool VMMDLL_Scatter_Clear(
+            IntPtr hS,
+            uint dwPID,
+            uint flags);
+
+        [DllImport("vmm.dll", EntryPoint = "VMMDLL_Scatter_CloseHandle")]
+        internal static extern void VMMDLL_Scatter_CloseHandle(
+            IntPtr hS);
+
+        internal static uint VMMDLL_MEM_SEARCH_VERSION =    0xfe3e0001;
+        internal const int VMMDLL_MEM_SEARCH_MAX =          16;
+        internal const int VMMDLL_MEM_SEARCH_MAXLENGTH =    32;
+        internal const int VMMDLL_MEM_SEARCH_ENTRY_SIZE =   8 + 2 * VMMDLL_MEM_SEARCH_MAXLENGTH;
+
+        [System.Runtime.InteropServices.StructLayoutAttribute(System.Runtime.InteropServices.LayoutKind.Sequential)]
+        internal unsafe struct VMMDLL_MEM_SEARCH_CONTEXT
+        {
+            internal uint dwVersion;
+            internal uint cSearch;
+            internal fixed byte search[VMMDLL_MEM_SEARCH_MAX * VMMDLL_MEM_SEARCH_ENTRY_SIZE];   // cbAlign, cb, pb[32], pbSkipMask[32]
+            internal ulong vaMin;
+            internal ulong vaMax;
+            internal uint ReadFlags;
+            internal int fForceW;
+            internal int fForceX;
+            internal uint cMaxResult;
+            internal int fAbortRequested;
+            internal uint cResult;
+            internal ulong cbReadTotal;
+            internal IntPtr pvUserPtrOpt;
+            internal IntPtr pfnResultOptCB;
+        }
+
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        internal delegate bool MemSearchCB(IntPtr ctx, uint dwPID, ulong va, uint iSearch);
+
+        [DllImport("vmm.dll", EntryPoint = "VMMDLL_MemSearch")]
+        internal static extern unsafe bool VMMDLL_MemSearch(
+            uint dwPID,
+            VMMDLL_MEM_SEARCH_CONTEXT* ctx);
+
         [DllImport("vmm.dll", EntryPoint = "VMMDLL_MemReadEx")]
         internal static extern unsafe bool VMMDLL_MemReadEx(
             uint dwPID,